@@ -82,6 +82,8 @@ struct acm_provider {
 	int	(*query)(void *addr_context, struct acm_msg *msg, uint64_t id);
 	int	(*handle_event)(void *port_context, enum ibv_event_type type);
 	void	(*query_perf)(void *ep_context, uint64_t *values, uint8_t *cnt);
+	void	(*query_stats)(void *ep_context, uint8_t op,
+			struct acm_stats_data *data);
 };
 
 int provider_query(struct acm_provider **info, uint32_t *version);
@@ -101,6 +103,13 @@ extern __be64 acm_path_comp_mask(struct ibv_path_record *path);
 
 extern int acm_resolve_response(uint64_t id, struct acm_msg *msg);
 extern int acm_query_response(uint64_t id, struct acm_msg *msg);
+/*
+ * Offer a successful address resolution to the shared path cache, from
+ * which clients may answer the same request without contacting ibacm.
+ * lifetime is how long, in seconds, the provider will keep the result.
+ */
+extern void acm_publish_path(const struct acm_msg *req,
+			     const struct acm_msg *resp, unsigned int lifetime);
 
 extern enum ibv_rate acm_get_rate(uint8_t width, uint8_t speed);
 extern enum ibv_mtu acm_convert_mtu(int mtu);
@@ -48,7 +48,6 @@
 #include <infiniband/umad_sa_mcm.h>
 #include <ifaddrs.h>
 #include <dlfcn.h>
-#include <search.h>
 #include <netdb.h>
 #include <net/if.h>
 #include <sys/ioctl.h>
@@ -57,6 +56,11 @@
 #include <linux/netlink.h>
 #include <linux/rtnetlink.h>
 #include <inttypes.h>
+#include <libgen.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <ccan/list.h>
 #include "acm_util.h"
 #include "acm_mad.h"
@@ -103,9 +107,54 @@ enum acmp_addr_preload {
  */
 struct acmp_ep;
 
+/*
+ * Hierarchical timer wheel, one per endpoint and protected by the ep lock.
+ * Level 0 has a slot per millisecond and each slot of a higher level spans
+ * a full turn of the level below.  A timer sits in the lowest level that
+ * reaches its expiration and moves down a level when its slot comes due, so
+ * adding, cancelling and expiring timers costs the same however many are
+ * pending.
+ */
+#define ACMP_WHEEL_BITS   6
+#define ACMP_WHEEL_SLOTS  (1 << ACMP_WHEEL_BITS)
+#define ACMP_WHEEL_MASK   (ACMP_WHEEL_SLOTS - 1)
+#define ACMP_WHEEL_LEVELS 5
+
+struct acmp_timer {
+	struct list_node       entry;
+	uint64_t               expires;
+	void                   (*expire)(struct acmp_ep *ep,
+					 struct acmp_timer *timer);
+};
+
+struct acmp_wheel {
+	uint64_t               now;
+	unsigned int           count;
+	struct list_head       slot[ACMP_WHEEL_LEVELS][ACMP_WHEEL_SLOTS];
+};
+
+/*
+ * Latency histogram of one operation, in the layout of acm_stats_data.
+ * Samples are recorded without a lock, each field on its own, so a query
+ * racing with a sample may see it counted in some fields and not others.
+ */
+struct acmp_hist {
+	uint64_t               count;
+	uint64_t               total_us;
+	uint64_t               max_us;
+	uint64_t               bucket[ACM_STAT_BUCKETS];
+};
+
 struct acmp_dest {
 	uint8_t                address[ACM_MAX_ADDRESS]; /* keep first */
 	char                   name[ACM_MAX_ADDRESS];
+	struct list_node       hash_entry;
+	struct list_node       lru_entry;
+	struct acmp_timer      timer;
+	uint64_t               neg_expires;
+	uint8_t                neg_status;
+	unsigned int           route_gen;
+	uint64_t               query_start;
 	struct ibv_ah          *ah;
 	struct ibv_ah_attr     av;
 	struct ibv_path_record path;
@@ -134,6 +183,7 @@ struct acmp_port {
 	enum ibv_mtu        mtu;
 	enum ibv_rate       rate;
 	int                 subnet_timeout;
+	uint8_t             packet_lifetime;
 	uint16_t            default_pkey_ix;
 	uint16_t            lid;
 	uint16_t            lid_mask;
@@ -178,7 +228,11 @@ struct acmp_ep {
 	uint8_t               *recv_bufs;
 	struct list_node      entry;
 	char		      id_string[IBV_SYSFS_NAME_MAX + 11];
-	void                  *dest_map[ACM_ADDRESS_RESERVED - 1];
+	/* Destination cache and timers, protected by lock */
+	struct list_head      *dest_hash;
+	struct list_head      dest_lru;
+	unsigned int          dest_cnt;
+	struct acmp_wheel     wheel;
 	struct acmp_dest      mc_dest[MAX_EP_MC];
 	int                   mc_cnt;
 	uint16_t              pkey_index;
@@ -195,6 +249,8 @@ struct acmp_ep {
 	int		      nmbr_ep_addrs;
 	struct acmp_addr      *addr_info;
 	atomic_t              counters[ACM_MAX_COUNTER];
+	atomic_t              gauges[ACM_MAX_GAUGE];
+	struct acmp_hist      stats[ACM_MAX_STAT];
 };
 
 struct acmp_send_msg {
@@ -209,18 +265,53 @@ struct acmp_send_msg {
 	struct ibv_mr        *mr;
 	struct ibv_send_wr   wr;
 	struct ibv_sge       sge;
-	uint64_t             expires;
+	struct acmp_timer    timer;
 	int                  tries;
 	uint8_t              data[ACM_SEND_SIZE];
 };
 
 struct acmp_request {
 	uint64_t	id;
+	uint64_t	start;
 	struct list_node entry;
 	struct acm_msg	msg;
 	struct acmp_ep	*ep;
 };
 
+/*
+ * Paths preloaded from an OpenSM full v1 dump.  Only the paths from local
+ * ports are kept, indexed by destination LID, and destinations are created
+ * from them on demand.  Each reload of the dump builds a new generation,
+ * which replaces the old one under routes_lock.
+ */
+struct acmp_route_rec {
+	uint8_t               valid;
+	uint8_t               sl;
+	uint8_t               mtu;
+	uint8_t               rate;
+};
+
+struct acmp_route_sect {
+	uint64_t              guid;
+	uint16_t              lid;
+	int                   found;
+	struct acmp_route_rec *path;	/* indexed by DLID */
+};
+
+struct acmp_guid_lid {
+	uint64_t              guid;
+	uint16_t              lid;
+};
+
+struct acmp_routes {
+	unsigned int          gen;
+	__be64                *lid2guid;
+	struct acmp_guid_lid  *guids;	/* sorted by GUID */
+	size_t                guid_cnt;
+	int                   sect_cnt;
+	struct acmp_route_sect sect[];
+};
+
 static int acmp_open_dev(const struct acm_device *device, void **dev_context);
 static void acmp_close_dev(void *dev_context);
 static int acmp_open_port(const struct acm_port *port, void *dev_context,
@@ -236,6 +327,8 @@ static int acmp_resolve(void *addr_context, struct acm_msg *msg, uint64_t id);
 static int acmp_query(void *addr_context, struct acm_msg *msg, uint64_t id);
 static int acmp_handle_event(void *port_context, enum ibv_event_type type);
 static void acmp_query_perf(void *ep_context, uint64_t *values, uint8_t *cnt);
+static void acmp_query_stats(void *ep_context, uint8_t op,
+			     struct acm_stats_data *data);
 
 static struct acm_provider def_prov = {
 	.size = sizeof(struct acm_provider),
@@ -253,6 +346,7 @@ static struct acm_provider def_prov = {
 	.query = acmp_query,
 	.handle_event = acmp_handle_event,
 	.query_perf = acmp_query_perf,
+	.query_stats = acmp_query_stats,
 };
 
 static LIST_HEAD(acmp_dev_list);
@@ -261,7 +355,7 @@ static pthread_mutex_t acmp_dev_lock;
 static atomic_t g_tid;
 static LIST_HEAD(timeout_list);
 static event_t timeout_event;
-static atomic_t wait_cnt;
+static uint64_t retry_wake = (uint64_t) -1;
 static pthread_t retry_thread_id;
 static int retry_thread_started = 0;
 
@@ -279,6 +373,9 @@ static int route_timeout = -1;
 static enum acmp_loopback_prot loopback_prot = ACMP_LOOPBACK_PROT_LOCAL;
 static int timeout = 2000;
 static int retries = 2;
+static int dest_cache_size = 65536;
+static int negative_timeout = 5000;
+static unsigned int dest_hash_size;
 static int resolve_depth = 1;
 static int send_depth = 1;
 static int recv_depth = 1024;
@@ -289,9 +386,159 @@ static enum acmp_addr_preload addr_preload;
 
 static int acmp_initialized = 0;
 
-static int acmp_compare_dest(const void *dest1, const void *dest2)
+static struct acmp_routes *routes;
+static unsigned int routes_gen;
+static pthread_rwlock_t routes_lock = PTHREAD_RWLOCK_INITIALIZER;
+static pthread_mutex_t routes_load_lock = PTHREAD_MUTEX_INITIALIZER;
+/*
+ * Set once a load of the dump succeeded.  Until then every endpoint
+ * preload and route lookup tries again; afterwards the watcher reloads it.
+ */
+static int routes_loaded;
+static pthread_t routes_thread_id;
+
+static int acmp_route_fill(struct acmp_ep *ep, struct acmp_dest *dest);
+static void acmp_load_routes(int wait);
+
+static void acmp_wheel_init(struct acmp_wheel *wheel)
+{
+	int i, j;
+
+	wheel->now = time_stamp_ms();
+	wheel->count = 0;
+	for (i = 0; i < ACMP_WHEEL_LEVELS; i++)
+		for (j = 0; j < ACMP_WHEEL_SLOTS; j++)
+			list_head_init(&wheel->slot[i][j]);
+}
+
+/* Queue a timer that expires no earlier than the wheel's current time */
+static void acmp_wheel_place(struct acmp_wheel *wheel, struct acmp_timer *timer)
+{
+	uint64_t block;
+	int level, shift;
+
+	for (level = 0; level < ACMP_WHEEL_LEVELS; level++) {
+		shift = level * ACMP_WHEEL_BITS;
+		block = timer->expires >> shift;
+		if (block - (wheel->now >> shift) < ACMP_WHEEL_SLOTS)
+			break;
+	}
+
+	/* Beyond the top level: park in its last slot, and re-place from there */
+	if (level == ACMP_WHEEL_LEVELS) {
+		level--;
+		block = (wheel->now >> shift) + ACMP_WHEEL_SLOTS - 1;
+	}
+	list_add_tail(&wheel->slot[level][block & ACMP_WHEEL_MASK], &timer->entry);
+}
+
+/* Caller must hold ep lock */
+static void acmp_timer_add(struct acmp_ep *ep, struct acmp_timer *timer,
+			   uint64_t expires)
+{
+	struct acmp_wheel *wheel = &ep->wheel;
+
+	/* An empty wheel may skip ahead without walking the idle slots */
+	if (!wheel->count)
+		wheel->now = max(wheel->now, time_stamp_ms());
+
+	timer->expires = max(expires, wheel->now + 1);
+	acmp_wheel_place(wheel, timer);
+	wheel->count++;
+
+	if (timer->expires < __atomic_load_n(&retry_wake, __ATOMIC_RELAXED))
+		event_signal(&timeout_event);
+}
+
+static int acmp_timer_pending(struct acmp_timer *timer)
+{
+	return timer->entry.next != &timer->entry;
+}
+
+/* Caller must hold ep lock */
+static void acmp_timer_cancel(struct acmp_ep *ep, struct acmp_timer *timer)
+{
+	if (acmp_timer_pending(timer)) {
+		list_del_init(&timer->entry);
+		ep->wheel.count--;
+	}
+}
+
+/* Time of the next slot that needs processing, or -1 if none are pending */
+static uint64_t acmp_wheel_next(struct acmp_wheel *wheel)
+{
+	uint64_t block, next = (uint64_t) -1;
+	int level, shift, i;
+
+	if (!wheel->count)
+		return next;
+
+	for (level = 0; level < ACMP_WHEEL_LEVELS; level++) {
+		shift = level * ACMP_WHEEL_BITS;
+		block = wheel->now >> shift;
+		for (i = 1; i < ACMP_WHEEL_SLOTS; i++) {
+			if (!list_empty(&wheel->slot[level][(block + i) &
+							   ACMP_WHEEL_MASK])) {
+				next = min(next, (block + i) << shift);
+				break;
+			}
+		}
+	}
+	return next;
+}
+
+/*
+ * Caller must hold ep lock.  Expires every timer due by now.  The expire
+ * callbacks run with the lock held and may add or cancel timers.
+ */
+static void acmp_wheel_run(struct acmp_ep *ep, uint64_t now)
+{
+	struct acmp_wheel *wheel = &ep->wheel;
+	struct acmp_timer *timer;
+	LIST_HEAD(cascade);
+	LIST_HEAD(expired);
+	uint64_t next;
+	int level, shift;
+
+	while (wheel->now < now) {
+		next = acmp_wheel_next(wheel);
+		if (next > now) {
+			wheel->now = now;
+			break;
+		}
+		wheel->now = next;
+
+		/* Move down the timers of every level whose slot starts now */
+		for (level = 1; level < ACMP_WHEEL_LEVELS; level++) {
+			shift = level * ACMP_WHEEL_BITS;
+			if (wheel->now & ((1ULL << shift) - 1))
+				break;
+			list_append_list(&cascade, &wheel->slot[level]
+					 [(wheel->now >> shift) & ACMP_WHEEL_MASK]);
+		}
+		while ((timer = list_pop(&cascade, struct acmp_timer, entry)))
+			acmp_wheel_place(wheel, timer);
+
+		list_append_list(&expired,
+				 &wheel->slot[0][wheel->now & ACMP_WHEEL_MASK]);
+		while ((timer = list_pop(&expired, struct acmp_timer, entry))) {
+			list_node_init(&timer->entry);
+			wheel->count--;
+			timer->expire(ep, timer);
+		}
+	}
+}
+
+static unsigned int acmp_dest_hash(uint8_t addr_type, const uint8_t *addr)
 {
-	return memcmp(dest1, dest2, ACM_MAX_ADDRESS);
+	uint64_t hash = addr_type, word;
+	int i;
+
+	for (i = 0; i < ACM_MAX_ADDRESS; i += sizeof(word)) {
+		memcpy(&word, addr + i, sizeof(word));
+		hash = (hash ^ word) * 0x9e3779b97f4a7c15ULL;
+	}
+	return (unsigned int) (hash >> 32) & (dest_hash_size - 1);
 }
 
 static void
@@ -308,6 +555,7 @@ acmp_init_dest(struct acmp_dest *dest, uint8_t addr_type,
 	       const uint8_t *addr, size_t size)
 {
 	list_head_init(&dest->req_queue);
+	list_node_init(&dest->timer.entry);
 	atomic_init(&dest->refcnt);
 	atomic_set(&dest->refcnt, 1);
 	pthread_mutex_init(&dest->lock, NULL);
@@ -336,20 +584,25 @@ acmp_alloc_dest(uint8_t addr_type, const uint8_t *addr)
 static struct acmp_dest *
 acmp_get_dest(struct acmp_ep *ep, uint8_t addr_type, const uint8_t *addr)
 {
-	struct acmp_dest *dest, **tdest;
+	struct list_head *bucket;
+	struct acmp_dest *dest;
 
-	tdest = tfind(addr, &ep->dest_map[addr_type - 1], acmp_compare_dest);
-	if (tdest) {
-		dest = *tdest;
-		(void) atomic_inc(&dest->refcnt);
-		acm_log(2, "%s\n", dest->name);
-	} else {
-		dest = NULL;
-		acm_format_name(2, log_data, sizeof log_data,
-				addr_type, addr, ACM_MAX_ADDRESS);
-		acm_log(2, "%s not found\n", log_data);
+	bucket = &ep->dest_hash[acmp_dest_hash(addr_type, addr)];
+	list_for_each(bucket, dest, hash_entry) {
+		if (dest->addr_type == addr_type &&
+		    !memcmp(dest->address, addr, ACM_MAX_ADDRESS)) {
+			(void) atomic_inc(&dest->refcnt);
+			list_del(&dest->lru_entry);
+			list_add_tail(&ep->dest_lru, &dest->lru_entry);
+			acm_log(2, "%s\n", dest->name);
+			return dest;
+		}
 	}
-	return dest;
+
+	acm_format_name(2, log_data, sizeof log_data,
+			addr_type, addr, ACM_MAX_ADDRESS);
+	acm_log(2, "%s not found\n", log_data);
+	return NULL;
 }
 
 static void
@@ -366,13 +619,132 @@ static void
 acmp_remove_dest(struct acmp_ep *ep, struct acmp_dest *dest)
 {
 	acm_log(2, "%s\n", dest->name);
-	if (!tdelete(dest->address, &ep->dest_map[dest->addr_type - 1],
-		     acmp_compare_dest))
-		acm_log(0, "ERROR: %s not found!!\n", dest->name);
-
+	list_del(&dest->hash_entry);
+	list_del(&dest->lru_entry);
+	ep->dest_cnt--;
+	acmp_timer_cancel(ep, &dest->timer);
 	acmp_put_dest(dest);
 }
 
+/*
+ * Caller must hold ep lock.  Only the cache references an idle destination,
+ * so nothing else can look at it until the ep lock is released.  Permanent
+ * entries, such as local addresses, are never dropped.
+ */
+static int acmp_dest_idle(struct acmp_dest *dest)
+{
+	return atomic_get(&dest->refcnt) == 1 &&
+	       list_empty(&dest->req_queue) &&
+	       dest->addr_timeout != (uint64_t) ~0ULL;
+}
+
+static void acmp_dest_count(struct acmp_ep *ep, int type)
+{
+	acm_increment_counter(type);
+	atomic_inc(&ep->counters[type]);
+}
+
+/* Add the time since start to the latency histogram of op */
+static void acmp_record_latency(struct acmp_ep *ep, int op, uint64_t start)
+{
+	struct acmp_hist *hist = &ep->stats[op];
+	uint64_t us = time_stamp_us() - start;
+	uint64_t max = __atomic_load_n(&hist->max_us, __ATOMIC_RELAXED);
+	int i;
+
+	i = us ? min_t(int, 64 - __builtin_clzll(us), ACM_STAT_BUCKETS - 1) : 0;
+	__atomic_fetch_add(&hist->bucket[i], 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&hist->total_us, us, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&hist->count, 1, __ATOMIC_RELAXED);
+	while (us > max &&
+	       !__atomic_compare_exchange_n(&hist->max_us, &max, us, 1,
+					    __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
+
+static int acmp_resolve_stat(struct acm_msg *msg)
+{
+	return msg->resolve_data[0].type == ACM_EP_INFO_PATH ?
+	       ACM_STAT_RESOLVE_PATH : ACM_STAT_RESOLVE_ADDR;
+}
+
+/*
+ * Caller must hold ep lock.  Destinations that are still valid, or are in
+ * use, are checked again later; others are dropped from the cache.
+ */
+static void acmp_dest_expire(struct acmp_ep *ep, struct acmp_timer *timer)
+{
+	struct acmp_dest *dest = container_of(timer, struct acmp_dest, timer);
+	uint64_t now = time_stamp_ms();
+
+	if (dest->addr_timeout == (uint64_t) ~0ULL)
+		return;
+
+	if (!acmp_dest_idle(dest)) {
+		acmp_timer_add(ep, timer, now + timeout);
+		return;
+	}
+
+	if (dest->state == ACMP_READY || dest->state == ACMP_ADDR_RESOLVED) {
+		if (dest->addr_timeout > now / 60000) {
+			acmp_timer_add(ep, timer, dest->addr_timeout * 60000);
+			return;
+		}
+	} else if (dest->neg_expires > now) {
+		acmp_timer_add(ep, timer, dest->neg_expires);
+		return;
+	}
+
+	acm_log(2, "%s expired\n", dest->name);
+	acmp_dest_count(ep, ACM_CNTR_DEST_EXPIRE);
+	acmp_remove_dest(ep, dest);
+}
+
+/*
+ * Caller must hold ep lock.  Bound the cache by dropping idle destinations
+ * from the least recently used end.  Busy ones are passed over, and moved
+ * to the other end so that they are not scanned again right away.
+ */
+#define ACMP_EVICT_SCAN 16
+static void acmp_trim_dests(struct acmp_ep *ep)
+{
+	struct acmp_dest *dest;
+	int scan = ACMP_EVICT_SCAN;
+
+	while (ep->dest_cnt > (unsigned int) dest_cache_size && scan--) {
+		dest = list_top(&ep->dest_lru, struct acmp_dest, lru_entry);
+		if (!dest)
+			break;
+
+		if (!acmp_dest_idle(dest)) {
+			list_del(&dest->lru_entry);
+			list_add_tail(&ep->dest_lru, &dest->lru_entry);
+			continue;
+		}
+
+		acm_log(2, "evicting %s\n", dest->name);
+		acmp_dest_count(ep, ACM_CNTR_DEST_EVICT);
+		acmp_remove_dest(ep, dest);
+	}
+}
+
+/* Caller must hold ep lock. */
+static void acmp_insert_dest(struct acmp_ep *ep, struct acmp_dest *dest)
+{
+	dest->ep = ep;
+	list_add_tail(&ep->dest_hash[acmp_dest_hash(dest->addr_type,
+						    dest->address)],
+		      &dest->hash_entry);
+	list_add_tail(&ep->dest_lru, &dest->lru_entry);
+	ep->dest_cnt++;
+
+	/* The first check decides how long the entry stays cached */
+	dest->timer.expire = acmp_dest_expire;
+	acmp_timer_add(ep, &dest->timer, time_stamp_ms() + timeout);
+
+	acmp_trim_dests(ep);
+}
+
 static struct acmp_dest *
 acmp_acquire_dest(struct acmp_ep *ep, uint8_t addr_type, const uint8_t *addr)
 {
@@ -389,19 +761,24 @@ acmp_acquire_dest(struct acmp_ep *ep, uint8_t addr_type, const uint8_t *addr)
 		rec_expr_minutes = dest->addr_timeout - time_stamp_min();
 		if (rec_expr_minutes <= 0) {
 			acm_log(2, "Record expired\n");
+			acmp_dest_count(ep, ACM_CNTR_DEST_EXPIRE);
 			acmp_remove_dest(ep, dest);
+			acmp_put_dest(dest);
 			dest = NULL;
 		} else {
 			acm_log(2, "Record valid for the next %" PRId64 " minute(s)\n",
 				rec_expr_minutes);
 		}
 	}
-	if (!dest) {
+	if (dest) {
+		acmp_dest_count(ep, ACM_CNTR_DEST_HIT);
+	} else {
+		acmp_dest_count(ep, ACM_CNTR_DEST_MISS);
 		dest = acmp_alloc_dest(addr_type, addr);
 		if (dest) {
-			dest->ep = ep;
-			tsearch(dest, &ep->dest_map[addr_type - 1], acmp_compare_dest);
 			(void) atomic_inc(&dest->refcnt);
+			acmp_route_fill(ep, dest);
+			acmp_insert_dest(ep, dest);
 		}
 	}
 	pthread_mutex_unlock(&ep->lock);
@@ -430,6 +807,8 @@ static void acmp_free_req(struct acmp_request *req)
 	free(req);
 }
 
+static void acmp_send_expire(struct acmp_ep *ep, struct acmp_timer *timer);
+
 static struct acmp_send_msg *
 acmp_alloc_send(struct acmp_ep *ep, struct acmp_dest *dest, size_t size)
 {
@@ -442,6 +821,8 @@ acmp_alloc_send(struct acmp_ep *ep, struct acmp_dest *dest, size_t size)
 	}
 
 	msg->ep = ep;
+	list_node_init(&msg->timer.entry);
+	msg->timer.expire = acmp_send_expire;
 	msg->mr = ibv_reg_mr(ep->port->dev->pd, msg->data, size, 0);
 	if (!msg->mr) {
 		acm_log(0, "ERROR - failed to register send buffer\n");
@@ -521,6 +902,7 @@ static void acmp_post_send(struct acmp_send_queue *queue, struct acmp_send_msg *
 	} else {
 		acm_log(2, "no sends available, queuing message\n");
 		list_add_tail(&queue->pending, &msg->entry);
+		atomic_inc(&ep->gauges[ACM_GAUGE_SEND_PENDING]);
 	}
 	pthread_mutex_unlock(&ep->lock);
 }
@@ -551,6 +933,7 @@ static void acmp_send_available(struct acmp_ep *ep, struct acmp_send_queue *queu
 	msg = list_pop(&queue->pending, struct acmp_send_msg, entry);
 	if (msg) {
 		acm_log(2, "posting queued send message\n");
+		atomic_dec(&ep->gauges[ACM_GAUGE_SEND_PENDING]);
 		list_add_tail(&ep->active_queue, &msg->entry);
 		ibv_post_send(ep->qp, &msg->wr, &bad_wr);
 	} else {
@@ -566,10 +949,10 @@ static void acmp_complete_send(struct acmp_send_msg *msg)
 	list_del(&msg->entry);
 	if (msg->tries) {
 		acm_log(2, "waiting for response\n");
-		msg->expires = time_stamp_ms() + ep->port->subnet_timeout + timeout;
 		list_add_tail(&ep->wait_queue, &msg->entry);
-		if (atomic_inc(&wait_cnt) == 1)
-			event_signal(&timeout_event);
+		atomic_inc(&ep->gauges[ACM_GAUGE_SEND_WAIT]);
+		acmp_timer_add(ep, &msg->timer, time_stamp_ms() +
+			       ep->port->subnet_timeout + timeout);
 	} else {
 		acm_log(2, "freeing\n");
 		acmp_send_available(ep, msg->req_queue);
@@ -591,7 +974,8 @@ static struct acmp_send_msg *acmp_get_request(struct acmp_ep *ep, __be64 tid, in
 			acm_log(2, "match found in wait queue\n");
 			req = msg;
 			list_del(&msg->entry);
-			(void) atomic_dec(&wait_cnt);
+			atomic_dec(&ep->gauges[ACM_GAUGE_SEND_WAIT]);
+			acmp_timer_cancel(ep, &msg->timer);
 			acmp_send_available(ep, msg->req_queue);
 			*free = 1;
 			goto unlock;
@@ -711,6 +1095,7 @@ static void acmp_process_join_resp(struct acm_sa_mad *sa_mad)
 	mad = (struct ib_sa_mad *) &sa_mad->sa_mad;
 	acm_log(1, "response status: 0x%x, mad status: 0x%x\n",
 		sa_mad->umad.status, mad->status);
+	atomic_dec(&ep->gauges[ACM_GAUGE_SA_QUERY]);
 	pthread_mutex_lock(&ep->lock);
 	if (sa_mad->umad.status) {
 		acm_log(0, "ERROR - send join failed 0x%x\n", sa_mad->umad.status);
@@ -729,6 +1114,7 @@ static void acmp_process_join_resp(struct acm_sa_mad *sa_mad)
 	}
 
 	dest = &ep->mc_dest[index];
+	acmp_record_latency(ep, ACM_STAT_MC_JOIN, dest->query_start);
 	dest->remote_qpn = IB_MC_QPN;
 	dest->mgid = mc_rec->mgid;
 	acmp_record_mc_av(ep->port, mc_rec, dest);
@@ -818,6 +1204,10 @@ static uint8_t acmp_resolve_path_sa(struct acmp_ep *ep, struct acmp_dest *dest,
 	acm_increment_counter(ACM_CNTR_ROUTE_QUERY);
 	atomic_inc(&ep->counters[ACM_CNTR_ROUTE_QUERY]);
 	dest->state = ACMP_QUERY_ROUTE;
+	dest->query_start = time_stamp_us();
+	/* The query holds a reference, dropped by acmp_dest_sa_resp() */
+	(void) atomic_inc(&dest->refcnt);
+	atomic_inc(&ep->gauges[ACM_GAUGE_SA_QUERY]);
 	if (acm_send_sa_mad(sa_mad)) {
 		acm_log(0, "Error - Failed to send sa mad\n");
 		ret = ACM_STATUS_ENODATA;
@@ -825,6 +1215,8 @@ static uint8_t acmp_resolve_path_sa(struct acmp_ep *ep, struct acmp_dest *dest,
 	}
 	return ACM_STATUS_SUCCESS;
 free_mad:
+	atomic_dec(&ep->gauges[ACM_GAUGE_SA_QUERY]);
+	(void) atomic_dec(&dest->refcnt);
 	acm_free_sa_mad(sa_mad);
 err:
 	dest->state = ACMP_INIT;
@@ -931,6 +1323,17 @@ acmp_send_addr_resp(struct acmp_ep *ep, struct acmp_dest *dest)
 	acmp_post_send(&ep->resp_queue, msg);
 }
 
+/* Seconds until the dest must be resolved again */
+static unsigned int acmp_dest_lifetime(struct acmp_dest *dest)
+{
+	uint64_t expires = min(dest->addr_timeout, dest->route_timeout);
+	uint64_t now = time_stamp_min();
+
+	if (expires <= now)
+		return 0;
+	return min_t(uint64_t, expires - now, UINT_MAX / 60) * 60;
+}
+
 static int
 acmp_resolve_response(uint64_t id, struct acm_msg *req_msg,
 		      struct acmp_dest *dest, uint8_t status)
@@ -964,6 +1367,10 @@ acmp_resolve_response(uint64_t id, struct acm_msg *req_msg,
 				&req_msg->resolve_data[req_msg->hdr.src_index],
 				ACM_MSG_EP_LENGTH);
 		}
+
+		if (dest->state == ACMP_READY)
+			acm_publish_path(req_msg, &msg,
+					 acmp_dest_lifetime(dest));
 	}
 
 	return acm_resolve_response(id, &msg);
@@ -976,11 +1383,20 @@ acmp_complete_queued_req(struct acmp_dest *dest, uint8_t status)
 
 	acm_log(2, "status %d\n", status);
 	pthread_mutex_lock(&dest->lock);
+	if (status && dest->state == ACMP_INIT) {
+		dest->neg_status = status;
+		dest->neg_expires = time_stamp_ms() + negative_timeout;
+	} else {
+		dest->neg_expires = 0;
+	}
 	while ((req = list_pop(&dest->req_queue, struct acmp_request, entry))) {
 		pthread_mutex_unlock(&dest->lock);
 
 		acm_log(2, "completing request, client %" PRIu64 "\n", req->id);
+		atomic_dec(&req->ep->gauges[ACM_GAUGE_QUEUED_REQ]);
 		acmp_resolve_response(req->id, &req->msg, dest, status);
+		acmp_record_latency(req->ep, acmp_resolve_stat(&req->msg),
+				    req->start);
 		acmp_free_req(req);
 
 		pthread_mutex_lock(&dest->lock);
@@ -1001,6 +1417,7 @@ acmp_dest_sa_resp(struct acm_sa_mad *mad)
 		status = ACM_STATUS_ETIMEDOUT;
 	}
 	acm_log(2, "%s status=0x%x\n", dest->name, status);
+	atomic_dec(&dest->ep->gauges[ACM_GAUGE_SA_QUERY]);
 
 	pthread_mutex_lock(&dest->lock);
 	if (dest->state != ACMP_QUERY_ROUTE) {
@@ -1008,6 +1425,7 @@ acmp_dest_sa_resp(struct acm_sa_mad *mad)
 		pthread_mutex_unlock(&dest->lock);
 		goto out;
 	}
+	acmp_record_latency(dest->ep, ACM_STAT_SA_QUERY, dest->query_start);
 
 	if (!status) {
 		memcpy(&dest->path, sa_mad->data, sizeof(dest->path));
@@ -1025,6 +1443,7 @@ acmp_dest_sa_resp(struct acm_sa_mad *mad)
 	acmp_complete_queued_req(dest, status);
 out:
 	acm_free_sa_mad(mad);
+	acmp_put_dest(dest);
 }
 
 static void
@@ -1034,6 +1453,7 @@ acmp_resolve_sa_resp(struct acm_sa_mad *mad)
 	int send_resp;
 
 	acm_log(2, "\n");
+	(void) atomic_inc(&dest->refcnt);
 	acmp_dest_sa_resp(mad);
 
 	pthread_mutex_lock(&dest->lock);
@@ -1042,6 +1462,7 @@ acmp_resolve_sa_resp(struct acm_sa_mad *mad)
 
 	if (send_resp)
 		acmp_send_addr_resp(dest->ep, dest);
+	acmp_put_dest(dest);
 }
 
 static struct acmp_addr *
@@ -1239,6 +1660,8 @@ acmp_sa_resp(struct acm_sa_mad *mad)
 	}
 	acm_log(2, "status 0x%x\n", req->msg.hdr.status);
 
+	atomic_dec(&req->ep->gauges[ACM_GAUGE_SA_QUERY]);
+	acmp_record_latency(req->ep, ACM_STAT_SA_QUERY, req->start);
 	if (req->msg.hdr.status)
 		atomic_inc(&req->ep->counters[ACM_CNTR_ERROR]);
 	acm_query_response(req->id, &req->msg);
@@ -1426,9 +1849,12 @@ static void acmp_join_group(struct acmp_ep *ep, union ibv_gid *port_gid,
 	acmp_set_dest_addr(&ep->mc_dest[ep->mc_cnt++], ACM_ADDRESS_GID,
 		mc_rec->mgid.raw, sizeof(mc_rec->mgid));
 	ep->mc_dest[ep->mc_cnt - 1].state = ACMP_INIT;
+	ep->mc_dest[ep->mc_cnt - 1].query_start = time_stamp_us();
 
+	atomic_inc(&ep->gauges[ACM_GAUGE_SA_QUERY]);
 	if (acm_send_sa_mad(sa_mad)) {
 		acm_log(0, "Error - Failed to send sa mad\n");
+		atomic_dec(&ep->gauges[ACM_GAUGE_SA_QUERY]);
 		acm_free_sa_mad(sa_mad);
 	}
 }
@@ -1515,28 +1941,23 @@ static void acmp_process_timeouts(void)
 	}
 }
 
-static void acmp_process_wait_queue(struct acmp_ep *ep, uint64_t *next_expire)
+/* Caller must hold ep lock */
+static void acmp_send_expire(struct acmp_ep *ep, struct acmp_timer *timer)
 {
-	struct acmp_send_msg *msg, *next;
+	struct acmp_send_msg *msg =
+		container_of(timer, struct acmp_send_msg, timer);
 	struct ibv_send_wr *bad_wr;
 
-	list_for_each_safe(&ep->wait_queue, msg, next, entry) {
-		if (msg->expires <= time_stamp_ms()) {
-			list_del(&msg->entry);
-			(void) atomic_dec(&wait_cnt);
-			if (--msg->tries) {
-				acm_log(1, "notice - retrying request\n");
-				list_add_tail(&ep->active_queue, &msg->entry);
-				ibv_post_send(ep->qp, &msg->wr, &bad_wr);
-			} else {
-				acm_log(0, "notice - failing request\n");
-				acmp_send_available(ep, msg->req_queue);
-				list_add_tail(&timeout_list, &msg->entry);
-			}
-		} else {
-			*next_expire = min(*next_expire, msg->expires);
-			break;
-		}
+	list_del(&msg->entry);
+	atomic_dec(&ep->gauges[ACM_GAUGE_SEND_WAIT]);
+	if (--msg->tries) {
+		acm_log(1, "notice - retrying request\n");
+		list_add_tail(&ep->active_queue, &msg->entry);
+		ibv_post_send(ep->qp, &msg->wr, &bad_wr);
+	} else {
+		acm_log(0, "notice - failing request\n");
+		acmp_send_available(ep, msg->req_queue);
+		list_add_tail(&timeout_list, &msg->entry);
 	}
 }
 
@@ -1549,8 +1970,8 @@ static void *acmp_retry_handler(void *context)
 	struct acmp_device *dev;
 	struct acmp_port *port;
 	struct acmp_ep *ep;
-	uint64_t next_expire;
-	int i, wait;
+	uint64_t next_expire, now;
+	int i;
 
 	acm_log(0, "started\n");
 	if (pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL)) {
@@ -1564,11 +1985,6 @@ static void *acmp_retry_handler(void *context)
 	retry_thread_started = 1;
 
 	while (1) {
-		while (!atomic_get(&wait_cnt)) {
-			pthread_testcancel();
-			event_wait(&timeout_event, -1);
-		}
-
 		next_expire = -1;
 		pthread_mutex_lock(&acmp_dev_lock);
 		list_for_each(&acmp_dev_list, dev, entry) {
@@ -1581,8 +1997,9 @@ static void *acmp_retry_handler(void *context)
 				list_for_each(&port->ep_list, ep, entry) {
 					pthread_mutex_unlock(&port->lock);
 					pthread_mutex_lock(&ep->lock);
-					if (!list_empty(&ep->wait_queue))
-						acmp_process_wait_queue(ep, &next_expire);
+					acmp_wheel_run(ep, time_stamp_ms());
+					next_expire = min(next_expire,
+							  acmp_wheel_next(&ep->wheel));
 					pthread_mutex_unlock(&ep->lock);
 					pthread_mutex_lock(&port->lock);
 				}
@@ -1593,12 +2010,18 @@ static void *acmp_retry_handler(void *context)
 		pthread_mutex_unlock(&acmp_dev_lock);
 
 		acmp_process_timeouts();
-		if (next_expire != -1) {
-			wait = (int) (next_expire - time_stamp_ms());
-			if (wait > 0 && atomic_get(&wait_cnt)) {
-				pthread_testcancel();
-				event_wait(&timeout_event, wait);
-			}
+
+		/*
+		 * Adding a timer that is due sooner signals the event, but a
+		 * signal sent before event_wait() starts waiting is lost, so
+		 * never sleep longer than one request timeout.
+		 */
+		now = time_stamp_ms();
+		next_expire = min(next_expire, now + timeout);
+		__atomic_store_n(&retry_wake, next_expire, __ATOMIC_RELAXED);
+		if (next_expire > now) {
+			pthread_testcancel();
+			event_wait(&timeout_event, next_expire - now);
 		}
 	}
 
@@ -1626,6 +2049,7 @@ __acmp_query(struct acmp_ep *ep, struct acm_msg *msg, uint64_t id)
 		goto resp;
 	}
 	req->ep = ep;
+	req->start = time_stamp_us();
 
 	sa_mad = acm_alloc_sa_mad(ep->endpoint, req, acmp_sa_resp);
 	if (!sa_mad) {
@@ -1643,6 +2067,7 @@ __acmp_query(struct acmp_ep *ep, struct acm_msg *msg, uint64_t id)
 
 	acm_increment_counter(ACM_CNTR_ROUTE_QUERY);
 	atomic_inc(&ep->counters[ACM_CNTR_ROUTE_QUERY]);
+	atomic_inc(&ep->gauges[ACM_GAUGE_SA_QUERY]);
 	if (acm_send_sa_mad(sa_mad)) {
 		acm_log(0, "Error - Failed to send sa mad\n");
 		status = ACM_STATUS_ENODATA;
@@ -1651,6 +2076,7 @@ __acmp_query(struct acmp_ep *ep, struct acm_msg *msg, uint64_t id)
 	return ACM_STATUS_SUCCESS;
 
 free_mad:
+	atomic_dec(&ep->gauges[ACM_GAUGE_SA_QUERY]);
 	acm_free_sa_mad(sa_mad);
 free_req:
 	acmp_free_req(req);
@@ -1725,7 +2151,8 @@ acmp_send_resolve(struct acmp_ep *ep, struct acmp_dest *dest,
 }
 
 /* Caller must hold dest lock */
-static uint8_t acmp_queue_req(struct acmp_dest *dest, uint64_t id, struct acm_msg *msg)
+static uint8_t acmp_queue_req(struct acmp_dest *dest, uint64_t id,
+			      struct acm_msg *msg, uint64_t start)
 {
 	struct acmp_request *req;
 
@@ -1735,8 +2162,10 @@ static uint8_t acmp_queue_req(struct acmp_dest *dest, uint64_t id, struct acm_ms
 		return ACM_STATUS_ENOMEM;
 	}
 	req->ep = dest->ep;
+	req->start = start;
 
 	list_add_tail(&dest->req_queue, &req->entry);
+	atomic_inc(&req->ep->gauges[ACM_GAUGE_QUEUED_REQ]);
 	return ACM_STATUS_SUCCESS;
 }
 
@@ -1756,6 +2185,18 @@ static int acmp_dest_timeout(struct acmp_dest *dest)
 	return 0;
 }
 
+/* Caller must hold dest lock.  Fail lookups that recently failed at once. */
+static int acmp_dest_negative(struct acmp_ep *ep, struct acmp_dest *dest)
+{
+	if (dest->neg_expires <= time_stamp_ms())
+		return 0;
+
+	acm_log(2, "%s failed recently, status 0x%x\n", dest->name,
+		dest->neg_status);
+	acmp_dest_count(ep, ACM_CNTR_DEST_NEGATIVE);
+	return 1;
+}
+
 static int
 acmp_check_addr_match(struct ifaddrs *iap, struct acm_ep_addr_data *saddr,
 		      unsigned int d_family)
@@ -1824,7 +2265,8 @@ acmp_acquire_sgid(struct acm_ep_addr_data *saddr,
 }
 
 static int
-acmp_resolve_dest(struct acmp_ep *ep, struct acm_msg *msg, uint64_t id)
+acmp_resolve_dest(struct acmp_ep *ep, struct acm_msg *msg, uint64_t id,
+		  uint64_t start)
 {
 	struct acmp_dest *dest;
 	struct acm_ep_addr_data *saddr, *daddr;
@@ -1866,6 +2308,10 @@ test:
 		}
 		goto queue;
 	case ACMP_INIT:
+		if (acmp_dest_negative(ep, dest)) {
+			status = dest->neg_status;
+			break;
+		}
 		acm_log(2, "sending resolve msg to dest\n");
 		status = acmp_send_resolve(ep, dest, saddr);
 		if (status) {
@@ -1880,7 +2326,7 @@ queue:
 			status = ACM_STATUS_ENODATA;
 			break;
 		}
-		status = acmp_queue_req(dest, id, msg);
+		status = acmp_queue_req(dest, id, msg, start);
 		if (status) {
 			break;
 		}
@@ -1890,13 +2336,15 @@ queue:
 	}
 	pthread_mutex_unlock(&dest->lock);
 	ret = acmp_resolve_response(id, msg, dest, status);
+	acmp_record_latency(ep, ACM_STAT_RESOLVE_ADDR, start);
 put:
 	acmp_put_dest(dest);
 	return ret;
 }
 
 static int
-acmp_resolve_path(struct acmp_ep *ep, struct acm_msg *msg, uint64_t id)
+acmp_resolve_path(struct acmp_ep *ep, struct acm_msg *msg, uint64_t id,
+		  uint64_t start)
 {
 	struct acmp_dest *dest;
 	struct ibv_path_record *path;
@@ -1932,6 +2380,10 @@ test:
 		status = ACM_STATUS_SUCCESS;
 		break;
 	case ACMP_INIT:
+		if (acmp_dest_negative(ep, dest)) {
+			status = dest->neg_status;
+			break;
+		}
 		acm_log(2, "have path, bypassing address resolution\n");
 		acmp_record_path_addr(ep, dest, path);
 		/* fall through */
@@ -1948,7 +2400,7 @@ test:
 			status = ACM_STATUS_ENODATA;
 			break;
 		}
-		status = acmp_queue_req(dest, id, msg);
+		status = acmp_queue_req(dest, id, msg, start);
 		if (status) {
 			break;
 		}
@@ -1958,6 +2410,7 @@ test:
 	}
 	pthread_mutex_unlock(&dest->lock);
 	ret = acmp_resolve_response(id, msg, dest, status);
+	acmp_record_latency(ep, ACM_STAT_RESOLVE_PATH, start);
 put:
 	acmp_put_dest(dest);
 	return ret;
@@ -1969,6 +2422,7 @@ acmp_resolve(void *addr_context, struct acm_msg *msg, uint64_t id)
 	struct acmp_addr_ctx *addr_ctx = addr_context;
 	struct acmp_addr *address = addr_ctx->ep->addr_info + addr_ctx->addr_inx;
 	struct acmp_ep *ep = address->ep;
+	uint64_t start = time_stamp_us();
 
 	if (ep->state != ACMP_READY) {
 		atomic_inc(&ep->counters[ACM_CNTR_NODATA]);
@@ -1977,9 +2431,9 @@ acmp_resolve(void *addr_context, struct acm_msg *msg, uint64_t id)
 
 	atomic_inc(&ep->counters[ACM_CNTR_RESOLVE]);
 	if (msg->resolve_data[0].type == ACM_EP_INFO_PATH)
-		return acmp_resolve_path(ep, msg, id);
+		return acmp_resolve_path(ep, msg, id, start);
 	else
-		return acmp_resolve_dest(ep, msg, id);
+		return acmp_resolve_dest(ep, msg, id, start);
 }
 
 static void acmp_query_perf(void *ep_context, uint64_t *values, uint8_t *cnt)
@@ -1992,6 +2446,30 @@ static void acmp_query_perf(void *ep_context, uint64_t *values, uint8_t *cnt)
 	*cnt = ACM_MAX_COUNTER;
 }
 
+static void acmp_query_stats(void *ep_context, uint8_t op,
+			     struct acm_stats_data *data)
+{
+	struct acmp_ep *ep = ep_context;
+	struct acmp_hist *hist = &ep->stats[op];
+	int i;
+
+	data->op = op;
+	data->bucket_cnt = ACM_STAT_BUCKETS;
+	data->gauge_cnt = ACM_MAX_GAUGE;
+	data->count = htobe64(__atomic_load_n(&hist->count, __ATOMIC_RELAXED));
+	data->total_us = htobe64(__atomic_load_n(&hist->total_us,
+						  __ATOMIC_RELAXED));
+	data->max_us = htobe64(__atomic_load_n(&hist->max_us, __ATOMIC_RELAXED));
+	for (i = 0; i < ACM_STAT_BUCKETS; i++)
+		data->bucket[i] = htobe64(__atomic_load_n(&hist->bucket[i],
+							  __ATOMIC_RELAXED));
+
+	data->gauge[ACM_GAUGE_DEST] =
+		htobe64(__atomic_load_n(&ep->dest_cnt, __ATOMIC_RELAXED));
+	for (i = ACM_GAUGE_QUEUED_REQ; i < ACM_MAX_GAUGE; i++)
+		data->gauge[i] = htobe64((uint64_t) atomic_get(&ep->gauges[i]));
+}
+
 static enum acmp_addr_prot acmp_convert_addr_prot(char *param)
 {
 	if (!strcasecmp("acm", param))
@@ -2068,221 +2546,463 @@ err:
 	return -1;
 }
 
-/* Parse "opensm full v1" file to build LID to GUID table */
-static void acmp_parse_osm_fullv1_lid2guid(FILE *f, __be64 *lid2guid)
+/* Parsing helpers for a memory mapped dump, which is not NUL terminated */
+static const char *acmp_next_line(const char *p, const char *end)
 {
-	char s[128];
-	char *p, *ptr, *p_guid, *p_lid;
-	uint64_t guid;
-	uint16_t lid;
-
-	while (fgets(s, sizeof s, f)) {
-		if (s[0] == '#')
-			continue;
-		if (!(p = strtok_r(s, " \n", &ptr)))
-			continue;	/* ignore blank lines */
-
-		if (strncmp(p, "Switch", sizeof("Switch") - 1) &&
-		    strncmp(p, "Channel", sizeof("Channel") - 1) &&
-		    strncmp(p, "Router", sizeof("Router") - 1))
-			continue;
-
-		if (!strncmp(p, "Channel", sizeof("Channel") - 1)) {
-			p = strtok_r(NULL, " ", &ptr); /* skip 'Adapter' */
-			if (!p)
-				continue;
-		}
+	p = memchr(p, '\n', end - p);
+	return p ? p + 1 : end;
+}
 
-		p_guid = strtok_r(NULL, ",", &ptr);
-		if (!p_guid)
-			continue;
+static const char *acmp_skip_space(const char *p, const char *end)
+{
+	while (p < end && (*p == ' ' || *p == '\t'))
+		p++;
+	return p;
+}
 
-		guid = (uint64_t) strtoull(p_guid, NULL, 16);
+static int acmp_parse_num(const char **pp, const char *end, uint64_t *val)
+{
+	const char *p = acmp_skip_space(*pp, end);
+	int base = 10, digit, n = 0;
 
-		ptr = strstr(ptr, "base LID");
-		if (!ptr)
-			continue;
-		ptr += sizeof("base LID");
-		p_lid = strtok_r(NULL, ",", &ptr);
-		if (!p_lid)
-			continue;
+	if (end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+		base = 16;
+		p += 2;
+	}
 
-		lid = (uint16_t) strtoul(p_lid, NULL, 0);
-		if (lid >= IB_LID_MCAST_START)
-			continue;
-		if (lid2guid[lid])
-			acm_log(0, "ERROR - duplicate lid %u\n", lid);
+	for (*val = 0; p < end; p++, n++) {
+		if (*p >= '0' && *p <= '9')
+			digit = *p - '0';
+		else if (base == 16 && *p >= 'a' && *p <= 'f')
+			digit = *p - 'a' + 10;
+		else if (base == 16 && *p >= 'A' && *p <= 'F')
+			digit = *p - 'A' + 10;
 		else
-			lid2guid[lid] = htobe64(guid);
+			break;
+		*val = *val * base + digit;
 	}
+	*pp = p;
+	return n ? 0 : -1;
 }
 
-/* Parse 'opensm full v1' file to populate PR cache */
-static int acmp_parse_osm_fullv1_paths(FILE *f, __be64 *lid2guid, struct acmp_ep *ep)
+static int acmp_is_port_line(const char *p, const char *end)
 {
-	union ibv_gid sgid, dgid;
-	struct ibv_port_attr attr = {};
-	struct acmp_dest *dest;
-	char s[128];
-	char *p, *ptr, *p_guid, *p_lid;
-	uint64_t guid;
-	uint16_t lid, dlid;
-	__be16 net_dlid;
-	int sl, mtu, rate;
-	int ret = 1, i;
-	uint8_t addr[ACM_MAX_ADDRESS];
-	uint8_t addr_type;
+	return (end - p > 6 && !memcmp(p, "Switch", 6)) ||
+	       (end - p > 7 && !memcmp(p, "Channel", 7)) ||
+	       (end - p > 6 && !memcmp(p, "Router", 6));
+}
 
-	acm_get_gid((struct acm_port *)ep->port->port, 0, &sgid);
+/*
+ * Parse "Channel Adapter 0x0002c903000e0b73, base LID 1, ..." or the
+ * Switch / Router equivalent.
+ */
+static int acmp_parse_port_line(const char *p, const char *end,
+				uint64_t *guid, uint16_t *lid)
+{
+	const char *eol = memchr(p, '\n', end - p);
+	uint64_t val;
 
-	/* Search for endpoint's SLID */
-	while (fgets(s, sizeof s, f)) {
-		if (s[0] == '#')
-			continue;
-		if (!(p = strtok_r(s, " \n", &ptr)))
-			continue;	/* ignore blank lines */
+	if (!eol)
+		eol = end;
 
-		if (strncmp(p, "Switch", sizeof("Switch") - 1) &&
-		    strncmp(p, "Channel", sizeof("Channel") - 1) &&
-		    strncmp(p, "Router", sizeof("Router") - 1))
-			continue;
+	p = memchr(p, ' ', eol - p);
+	if (!p)
+		return -1;
+	p = acmp_skip_space(p, eol);
+	if (eol - p > 7 && !memcmp(p, "Adapter", 7))
+		p += 7;
+	if (acmp_parse_num(&p, eol, guid))
+		return -1;
 
-		if (!strncmp(p, "Channel", sizeof("Channel") - 1)) {
-			p = strtok_r(NULL, " ", &ptr); /* skip 'Adapter' */
-			if (!p)
-				continue;
+	for (; eol - p > 8; p++) {
+		if (!memcmp(p, "base LID", 8)) {
+			p += 8;
+			if (acmp_parse_num(&p, eol, &val) ||
+			    val >= IB_LID_MCAST_START)
+				return -1;
+			*lid = val;
+			return 0;
 		}
+	}
+	return -1;
+}
 
-		p_guid = strtok_r(NULL, ",", &ptr);
-		if (!p_guid)
-			continue;
-
-		guid = (uint64_t) strtoull(p_guid, NULL, 16);
-		if (guid != be64toh(sgid.global.interface_id))
-			continue;
-
-		ptr = strstr(ptr, "base LID");
-		if (!ptr)
-			continue;
-		ptr += sizeof("base LID");
-		p_lid = strtok_r(NULL, ",", &ptr);
-		if (!p_lid)
-			continue;
-
-		lid = (uint16_t) strtoul(p_lid, NULL, 0);
-		if (lid != ep->port->lid)
-			continue;
+/* Parse "0x0002 : 0 : 4 : 3", the DLID, SL, MTU and rate */
+static int acmp_parse_path_line(const char *p, const char *end,
+				uint16_t *dlid, struct acmp_route_rec *rec)
+{
+	uint64_t val[4];
+	int i;
 
-		ibv_query_port(ep->port->dev->verbs, ep->port->port_num, &attr);
-		ret = 0;
-		break;
+	for (i = 0; i < 4; i++) {
+		if (i) {
+			p = acmp_skip_space(p, end);
+			if (p == end || *p != ':')
+				return -1;
+			p++;
+		}
+		if (acmp_parse_num(&p, end, &val[i]))
+			return -1;	/* includes UNREACHABLE */
 	}
 
-	while (fgets(s, sizeof s, f)) {
-		if (s[0] == '#')
-			continue;
-		if (!(p = strtok_r(s, " \n", &ptr)))
-			continue;	/* ignore blank lines */
+	if (val[0] >= IB_LID_MCAST_START)
+		return -1;
+	*dlid = val[0];
+	rec->valid = 1;
+	rec->sl = val[1] & 0xF;
+	rec->mtu = val[2];
+	rec->rate = val[3];
+	return 0;
+}
 
-		if (!strncmp(p, "Switch", sizeof("Switch") - 1) ||
-		    !strncmp(p, "Channel", sizeof("Channel") - 1) ||
-		    !strncmp(p, "Router", sizeof("Router") - 1))
-			break;
+struct acmp_route_chunk {
+	pthread_t             thread;
+	const char            *start;
+	const char            *end;
+	struct acmp_routes    *routes;
+	size_t                guid_cnt;
+	struct acmp_guid_lid  *guids;
+};
 
-		dlid = strtoul(p, NULL, 0);
-		net_dlid = htobe16(dlid);
+/*
+ * Parse one slice of the dump.  Slices start on a port line, so each port's
+ * paths are parsed by a single thread and no locking is needed.  The paths
+ * from ports that are not local are skipped without being parsed.
+ */
+static void *acmp_parse_route_chunk(void *arg)
+{
+	struct acmp_route_chunk *chunk = arg;
+	struct acmp_routes *r = chunk->routes;
+	struct acmp_route_sect *sect = NULL;
+	struct acmp_route_rec rec;
+	const char *p, *end = chunk->end;
+	size_t guid_max = 0;
+	uint64_t guid;
+	uint16_t lid;
+	__be64 old;
+	void *tmp;
+	int i;
 
-		p = strtok_r(NULL, ":", &ptr);
-		if (!p)
-			continue;
-		if (strcmp(p, "UNREACHABLE") == 0)
+	for (p = chunk->start; p < end; p = acmp_next_line(p, end)) {
+		if (*p == '#' || *p == '\n')
 			continue;
-		sl = atoi(p);
 
-		p = strtok_r(NULL, ":", &ptr);
-		if (!p)
+		if (!acmp_is_port_line(p, end)) {
+			if (sect && !acmp_parse_path_line(p, end, &lid, &rec))
+				sect->path[lid] = rec;
 			continue;
-		mtu = atoi(p);
+		}
 
-		p = strtok_r(NULL, ":", &ptr);
-		if (!p)
+		sect = NULL;
+		if (acmp_parse_port_line(p, end, &guid, &lid))
 			continue;
-		rate = atoi(p);
 
-		if (!lid2guid[dlid]) {
-			acm_log(0, "ERROR - dlid %u not found in lid2guid table\n", dlid);
+		old = 0;
+		if (!__atomic_compare_exchange_n(&r->lid2guid[lid], &old,
+						 htobe64(guid), false,
+						 __ATOMIC_RELAXED,
+						 __ATOMIC_RELAXED)) {
+			acm_log(0, "ERROR - duplicate lid %u\n", lid);
 			continue;
 		}
 
-		dgid.global.subnet_prefix = sgid.global.subnet_prefix;
-		dgid.global.interface_id = lid2guid[dlid];
+		if (chunk->guid_cnt == guid_max) {
+			guid_max = guid_max ? guid_max * 2 : 1024;
+			tmp = realloc(chunk->guids, guid_max * sizeof(*chunk->guids));
+			if (!tmp)
+				break;
+			chunk->guids = tmp;
+		}
+		chunk->guids[chunk->guid_cnt].guid = guid;
+		chunk->guids[chunk->guid_cnt++].lid = lid;
 
-		for (i = 0; i < 2; i++) {
-			memset(addr, 0, ACM_MAX_ADDRESS);
-			if (i == 0) {
-				addr_type = ACM_ADDRESS_LID;
-				memcpy(addr, &net_dlid, sizeof net_dlid);
-			} else {
-				addr_type = ACM_ADDRESS_GID;
-				memcpy(addr, &dgid, sizeof(dgid));
-			}
-			dest = acmp_acquire_dest(ep, addr_type, addr);
-			if (!dest) {
-				acm_log(0, "ERROR - unable to create dest\n");
+		for (i = 0; i < r->sect_cnt; i++) {
+			if (r->sect[i].guid == guid && r->sect[i].lid == lid) {
+				sect = &r->sect[i];
+				sect->found = 1;
 				break;
 			}
+		}
+	}
+	return NULL;
+}
 
-			dest->path.sgid = sgid;
-			dest->path.slid = htobe16(ep->port->lid);
-			dest->path.dgid = dgid;
-			dest->path.dlid = net_dlid;
-			dest->path.reversible_numpath = IBV_PATH_RECORD_REVERSIBLE;
-			dest->path.pkey = htobe16(ep->pkey);
-			dest->path.mtu = (uint8_t) mtu;
-			dest->path.rate = (uint8_t) rate;
-			dest->path.qosclass_sl = htobe16((uint16_t) sl & 0xF);
-			if (dlid == ep->port->lid) {
-				dest->path.packetlifetime = 0;
-				dest->addr_timeout = (uint64_t)~0ULL;
-				dest->route_timeout = (uint64_t)~0ULL;
-			} else {
-				dest->path.packetlifetime = attr.subnet_timeout;
-				dest->addr_timeout = time_stamp_min() + (unsigned) addr_timeout;
-				dest->route_timeout = time_stamp_min() + (unsigned) route_timeout;
+static int acmp_compare_guid(const void *a, const void *b)
+{
+	const struct acmp_guid_lid *ga = a, *gb = b;
+
+	return ga->guid < gb->guid ? -1 : ga->guid > gb->guid;
+}
+
+static void acmp_free_routes(struct acmp_routes *r)
+{
+	int i;
+
+	if (!r)
+		return;
+
+	for (i = 0; i < r->sect_cnt; i++)
+		free(r->sect[i].path);
+	free(r->guids);
+	free(r->lid2guid);
+	free(r);
+}
+
+/* Sections to keep: the GUID and LID of every local port that is up */
+static struct acmp_routes *acmp_alloc_routes(void)
+{
+	struct acmp_routes *r;
+	struct acmp_device *dev;
+	struct acmp_port *port;
+	union ibv_gid gid;
+	int i, cnt = 0;
+
+	pthread_mutex_lock(&acmp_dev_lock);
+	list_for_each(&acmp_dev_list, dev, entry)
+		cnt += dev->port_cnt;
+
+	r = calloc(1, sizeof(*r) + cnt * sizeof(r->sect[0]));
+	if (!r)
+		goto unlock;
+
+	list_for_each(&acmp_dev_list, dev, entry) {
+		for (i = 0; i < dev->port_cnt; i++) {
+			port = &dev->port[i];
+			pthread_mutex_lock(&port->lock);
+			if (port->port && port->lid &&
+			    !acm_get_gid((struct acm_port *) port->port, 0, &gid)) {
+				r->sect[r->sect_cnt].guid =
+					be64toh(gid.global.interface_id);
+				r->sect[r->sect_cnt++].lid = port->lid;
 			}
-			dest->remote_qpn = 1;
-			dest->state = ACMP_READY;
-			acmp_put_dest(dest);
-			acm_log(1, "added cached dest %s\n", dest->name);
+			pthread_mutex_unlock(&port->lock);
 		}
 	}
-	return ret;
+unlock:
+	pthread_mutex_unlock(&acmp_dev_lock);
+	if (!r)
+		return NULL;
+
+	r->lid2guid = calloc(IB_LID_MCAST_START, sizeof(*r->lid2guid));
+	if (!r->lid2guid)
+		goto err;
+
+	for (i = 0; i < r->sect_cnt; i++) {
+		r->sect[i].path = calloc(IB_LID_MCAST_START,
+					 sizeof(*r->sect[i].path));
+		if (!r->sect[i].path)
+			goto err;
+	}
+	return r;
+
+err:
+	acmp_free_routes(r);
+	return NULL;
 }
 
-static int acmp_parse_osm_fullv1(struct acmp_ep *ep)
+#define ACMP_ROUTE_MAX_THREADS 8
+#define ACMP_ROUTE_MIN_CHUNK   (4 << 20)
+
+/* Parse the 'opensm full v1' file into a new route generation */
+static struct acmp_routes *acmp_parse_osm_fullv1(void)
 {
-	FILE *f;
-	__be64 *lid2guid;
-	int ret = 1;
+	struct acmp_route_chunk chunk[ACMP_ROUTE_MAX_THREADS] = {};
+	struct acmp_routes *r = NULL;
+	const char *map, *p, *end;
+	struct stat st;
+	size_t size;
+	int fd, i, cnt;
+	long cpus;
 
-	if (!(f = fopen(route_data_file, "r"))) {
+	fd = open(route_data_file, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
 		acm_log(0, "ERROR - couldn't open %s\n", route_data_file);
-		return ret;
+		return NULL;
 	}
+	if (fstat(fd, &st) || !st.st_size) {
+		acm_log(0, "ERROR - %s is empty\n", route_data_file);
+		goto close;
+	}
+	size = st.st_size;
+
+	map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		acm_log(0, "ERROR - couldn't map %s\n", route_data_file);
+		goto close;
+	}
+	end = map + size;
 
-	lid2guid = calloc(IB_LID_MCAST_START, sizeof(*lid2guid));
-	if (!lid2guid) {
+	r = acmp_alloc_routes();
+	if (!r) {
 		acm_log(0, "ERROR - no memory for path record parsing\n");
-		goto err;
+		goto unmap;
 	}
 
-	acmp_parse_osm_fullv1_lid2guid(f, lid2guid);
-	rewind(f);
-	ret = acmp_parse_osm_fullv1_paths(f, lid2guid, ep);
-	free(lid2guid);
-err:
-	fclose(f);
-	return ret;
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	cnt = cpus > 0 ? min_t(long, cpus, ACMP_ROUTE_MAX_THREADS) : 1;
+	cnt = min_t(size_t, cnt, size / ACMP_ROUTE_MIN_CHUNK + 1);
+
+	/* Cut the file into slices that each begin with a port line */
+	for (i = 0, p = map; i < cnt; i++) {
+		chunk[i].start = p;
+		chunk[i].routes = r;
+		p = i + 1 < cnt ? map + size / cnt * (i + 1) : end;
+		if (p < chunk[i].start)
+			p = chunk[i].start;
+		while (p < end && (p[-1] != '\n' || !acmp_is_port_line(p, end)))
+			p = acmp_next_line(p, end);
+		chunk[i].end = p;
+	}
+
+	for (i = 1; i < cnt; i++) {
+		if (pthread_create(&chunk[i].thread, NULL,
+				   acmp_parse_route_chunk, &chunk[i]))
+			acmp_parse_route_chunk(&chunk[i]);
+	}
+	acmp_parse_route_chunk(&chunk[0]);
+	for (i = 1; i < cnt; i++) {
+		if (chunk[i].thread)
+			pthread_join(chunk[i].thread, NULL);
+	}
+
+	for (i = 0; i < cnt; i++)
+		r->guid_cnt += chunk[i].guid_cnt;
+	r->guids = malloc(max_t(size_t, r->guid_cnt, 1) * sizeof(*r->guids));
+	if (!r->guids) {
+		acm_log(0, "ERROR - no memory for path record parsing\n");
+		acmp_free_routes(r);
+		r = NULL;
+		goto free;
+	}
+	for (i = 0, size = 0; i < cnt; i++) {
+		memcpy(&r->guids[size], chunk[i].guids,
+		       chunk[i].guid_cnt * sizeof(*r->guids));
+		size += chunk[i].guid_cnt;
+	}
+	qsort(r->guids, r->guid_cnt, sizeof(*r->guids), acmp_compare_guid);
+
+	for (i = 0; i < r->sect_cnt; i++) {
+		if (!r->sect[i].found)
+			acm_log(0, "ERROR - no paths for port 0x%" PRIx64
+				" lid %u\n", r->sect[i].guid, r->sect[i].lid);
+	}
+	acm_log(1, "parsed %zu ports with %d threads\n", r->guid_cnt, cnt);
+
+free:
+	for (i = 0; i < cnt; i++)
+		free(chunk[i].guids);
+unmap:
+	munmap((void *) map, st.st_size);
+close:
+	close(fd);
+	return r;
+}
+
+/* Caller must hold routes_lock */
+static struct acmp_route_sect *
+acmp_route_sect(struct acmp_ep *ep, union ibv_gid *sgid)
+{
+	int i;
+
+	if (!routes ||
+	    acm_get_gid((struct acm_port *) ep->port->port, 0, sgid))
+		return NULL;
+
+	for (i = 0; i < routes->sect_cnt; i++) {
+		if (routes->sect[i].found &&
+		    routes->sect[i].guid == be64toh(sgid->global.interface_id) &&
+		    routes->sect[i].lid == ep->port->lid)
+			return &routes->sect[i];
+	}
+	return NULL;
+}
+
+/*
+ * Look up a LID or GID destination in the preloaded paths.  Returns the
+ * route generation the path came from, or 0 if there is none.
+ */
+static unsigned int acmp_route_lookup(struct acmp_ep *ep, uint8_t addr_type,
+				      const uint8_t *addr,
+				      struct ibv_path_record *path)
+{
+	struct acmp_guid_lid key, *found;
+	struct acmp_route_sect *sect;
+	struct acmp_route_rec *rec;
+	union ibv_gid sgid, dgid;
+	unsigned int gen = 0;
+	uint16_t dlid;
+
+	if (addr_type != ACM_ADDRESS_LID && addr_type != ACM_ADDRESS_GID)
+		return 0;
+
+	pthread_rwlock_rdlock(&routes_lock);
+	if (!routes_loaded && route_preload == ACMP_ROUTE_PRELOAD_OSM_FULL_V1) {
+		pthread_rwlock_unlock(&routes_lock);
+		acmp_load_routes(0);
+		pthread_rwlock_rdlock(&routes_lock);
+	}
+	sect = acmp_route_sect(ep, &sgid);
+	if (!sect)
+		goto unlock;
+
+	if (addr_type == ACM_ADDRESS_LID) {
+		dlid = be16toh(*(__be16 *) addr);
+		if (dlid >= IB_LID_MCAST_START)
+			goto unlock;
+	} else {
+		memcpy(&dgid, addr, sizeof(dgid));
+		if (dgid.global.subnet_prefix != sgid.global.subnet_prefix)
+			goto unlock;
+		key.guid = be64toh(dgid.global.interface_id);
+		found = bsearch(&key, routes->guids, routes->guid_cnt,
+				sizeof(key), acmp_compare_guid);
+		if (!found)
+			goto unlock;
+		dlid = found->lid;
+	}
+
+	rec = &sect->path[dlid];
+	if (!rec->valid || !routes->lid2guid[dlid])
+		goto unlock;
+
+	memset(path, 0, sizeof(*path));
+	path->sgid = sgid;
+	path->slid = htobe16(ep->port->lid);
+	path->dgid.global.subnet_prefix = sgid.global.subnet_prefix;
+	path->dgid.global.interface_id = routes->lid2guid[dlid];
+	path->dlid = htobe16(dlid);
+	path->reversible_numpath = IBV_PATH_RECORD_REVERSIBLE;
+	path->pkey = htobe16(ep->pkey);
+	path->mtu = rec->mtu;
+	path->rate = rec->rate;
+	path->qosclass_sl = htobe16(rec->sl);
+	path->packetlifetime = dlid == ep->port->lid ? 0 :
+			       ep->port->packet_lifetime;
+	gen = routes->gen;
+unlock:
+	pthread_rwlock_unlock(&routes_lock);
+	return gen;
+}
+
+/* Caller must hold ep lock.  Set up a new destination from the dump. */
+static int acmp_route_fill(struct acmp_ep *ep, struct acmp_dest *dest)
+{
+	dest->route_gen = acmp_route_lookup(ep, dest->addr_type, dest->address,
+					    &dest->path);
+	if (!dest->route_gen)
+		return -1;
+
+	if (be16toh(dest->path.dlid) == ep->port->lid) {
+		dest->addr_timeout = (uint64_t)~0ULL;
+		dest->route_timeout = (uint64_t)~0ULL;
+	} else {
+		dest->addr_timeout = time_stamp_min() + (unsigned) addr_timeout;
+		dest->route_timeout = time_stamp_min() + (unsigned) route_timeout;
+	}
+	dest->remote_qpn = 1;
+	dest->state = ACMP_READY;
+	acm_log(1, "added cached dest %s\n", dest->name);
+	return 0;
 }
 
 static void acmp_parse_hosts_file(struct acmp_ep *ep)
@@ -2292,7 +3012,8 @@ static void acmp_parse_hosts_file(struct acmp_ep *ep)
 	char addr[INET6_ADDRSTRLEN], gid[INET6_ADDRSTRLEN];
 	uint8_t name[ACM_MAX_ADDRESS];
 	struct in6_addr ip_addr, ib_addr;
-	struct acmp_dest *dest, *gid_dest;
+	struct ibv_path_record path;
+	struct acmp_dest *dest;
 	uint8_t addr_type;
 
 	if (!(f = fopen(addr_data_file, "r"))) {
@@ -2332,11 +3053,10 @@ static void acmp_parse_hosts_file(struct acmp_ep *ep)
 
 		memset(name, 0, ACM_MAX_ADDRESS);
 		memcpy(name, &ib_addr, sizeof(ib_addr));
-		gid_dest = acmp_get_dest(ep, ACM_ADDRESS_GID, name);
-		if (gid_dest) {
-			dest->path = gid_dest->path;
+		pthread_mutex_lock(&dest->lock);
+		if (acmp_route_lookup(ep, ACM_ADDRESS_GID, name, &path)) {
+			dest->path = path;
 			dest->state = ACMP_READY;
-			acmp_put_dest(gid_dest);
 		} else {
 			memcpy(&dest->path.dgid, &ib_addr, 16);
 			//ibv_query_gid(ep->port->dev->verbs, ep->port->port_num,
@@ -2350,6 +3070,7 @@ static void acmp_parse_hosts_file(struct acmp_ep *ep)
 		dest->remote_qpn = 1;
 		dest->addr_timeout = time_stamp_min() + (unsigned) addr_timeout;
 		dest->route_timeout = time_stamp_min() + (unsigned) route_timeout;
+		pthread_mutex_unlock(&dest->lock);
 		acmp_put_dest(dest);
 		acm_log(1, "added host %s address type %d IB GID %s\n",
 			addr, addr_type, gid);
@@ -2358,6 +3079,196 @@ static void acmp_parse_hosts_file(struct acmp_ep *ep)
 	fclose(f);
 }
 
+/*
+ * Build a new route generation off to the side and swap it in.  Returns
+ * the new generation, or 0 if the dump could not be parsed.  Caller must
+ * hold routes_load_lock.
+ */
+static unsigned int acmp_swap_routes(void)
+{
+	struct acmp_routes *r, *old;
+	uint64_t start;
+
+	start = time_stamp_ms();
+	r = acmp_parse_osm_fullv1();
+	if (!r)
+		return 0;
+
+	pthread_rwlock_wrlock(&routes_lock);
+	r->gen = ++routes_gen;
+	old = routes;
+	routes = r;
+	routes_loaded = 1;
+	pthread_rwlock_unlock(&routes_lock);
+	acmp_free_routes(old);
+	acm_log(0, "loaded %s generation %u in %" PRIu64 " ms\n",
+		route_data_file, r->gen, time_stamp_ms() - start);
+	return r->gen;
+}
+
+/*
+ * Load the dump unless a load already succeeded.  Route lookups hold an
+ * ep lock, which acmp_reload_routes() takes under routes_load_lock, so
+ * they pass wait = 0 and leave the retry to a later lookup while another
+ * load is in progress.
+ */
+static void acmp_load_routes(int wait)
+{
+	if (wait)
+		pthread_mutex_lock(&routes_load_lock);
+	else if (pthread_mutex_trylock(&routes_load_lock))
+		return;
+
+	if (!routes_loaded)
+		acmp_swap_routes();
+	pthread_mutex_unlock(&routes_load_lock);
+}
+
+/*
+ * Swap in a new route generation.  Cached destinations created from the
+ * old generation are dropped, so that they are recreated from the new one
+ * on their next lookup.
+ */
+static void acmp_reload_routes(void)
+{
+	struct acmp_dest *dest, *next;
+	struct acmp_device *dev;
+	struct acmp_port *port;
+	struct acmp_ep *ep;
+	unsigned int gen;
+	int i, cnt;
+
+	pthread_mutex_lock(&routes_load_lock);
+	gen = acmp_swap_routes();
+	if (!gen) {
+		pthread_mutex_unlock(&routes_load_lock);
+		return;
+	}
+
+	pthread_mutex_lock(&acmp_dev_lock);
+	list_for_each(&acmp_dev_list, dev, entry) {
+		pthread_mutex_unlock(&acmp_dev_lock);
+
+		for (i = 0; i < dev->port_cnt; i++) {
+			port = &dev->port[i];
+
+			pthread_mutex_lock(&port->lock);
+			list_for_each(&port->ep_list, ep, entry) {
+				pthread_mutex_unlock(&port->lock);
+				cnt = 0;
+				pthread_mutex_lock(&ep->lock);
+				list_for_each_safe(&ep->dest_lru, dest, next,
+						   lru_entry) {
+					if (dest->route_gen &&
+					    dest->route_gen != gen) {
+						acmp_remove_dest(ep, dest);
+						cnt++;
+					}
+				}
+				pthread_mutex_unlock(&ep->lock);
+				if (cnt)
+					acm_log(1, "%s dropped %d stale dests\n",
+						ep->id_string, cnt);
+				pthread_mutex_lock(&port->lock);
+			}
+			pthread_mutex_unlock(&port->lock);
+		}
+		pthread_mutex_lock(&acmp_dev_lock);
+	}
+	pthread_mutex_unlock(&acmp_dev_lock);
+	pthread_mutex_unlock(&routes_load_lock);
+}
+
+static void acmp_reload_hosts(void)
+{
+	struct acmp_device *dev;
+	struct acmp_port *port;
+	struct acmp_ep *ep;
+	int i;
+
+	pthread_mutex_lock(&acmp_dev_lock);
+	list_for_each(&acmp_dev_list, dev, entry) {
+		pthread_mutex_unlock(&acmp_dev_lock);
+
+		for (i = 0; i < dev->port_cnt; i++) {
+			port = &dev->port[i];
+
+			pthread_mutex_lock(&port->lock);
+			list_for_each(&port->ep_list, ep, entry) {
+				pthread_mutex_unlock(&port->lock);
+				if (ep->endpoint)
+					acmp_parse_hosts_file(ep);
+				pthread_mutex_lock(&port->lock);
+			}
+			pthread_mutex_unlock(&port->lock);
+		}
+		pthread_mutex_lock(&acmp_dev_lock);
+	}
+	pthread_mutex_unlock(&acmp_dev_lock);
+}
+
+/*
+ * Watch the directory holding the route data file, since tools commonly
+ * replace the file rather than rewrite it.  Wait for writes to settle,
+ * then reload.
+ */
+#define ACMP_ROUTE_SETTLE_MS 500
+static void *acmp_route_watcher(void *context)
+{
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	char dir[sizeof(route_data_file)], base[sizeof(route_data_file)];
+	const struct inotify_event *event;
+	struct pollfd fds;
+	int fd, changed, settle;
+	ssize_t len;
+	char *p;
+
+	strcpy(dir, route_data_file);
+	strcpy(base, route_data_file);
+	p = basename(base);
+
+	fd = inotify_init1(IN_CLOEXEC);
+	if (fd < 0 || inotify_add_watch(fd, dirname(dir), IN_CLOSE_WRITE |
+					IN_MOVED_TO | IN_CREATE) < 0) {
+		acm_log(0, "ERROR - unable to watch %s\n", route_data_file);
+		if (fd >= 0)
+			close(fd);
+		return NULL;
+	}
+
+	fds.fd = fd;
+	fds.events = POLLIN;
+	changed = 0;
+	while (1) {
+		settle = changed ? ACMP_ROUTE_SETTLE_MS : -1;
+		if (poll(&fds, 1, settle) == 0) {
+			acm_log(1, "%s changed, reloading\n", route_data_file);
+			acmp_reload_routes();
+			if (addr_preload == ACMP_ADDR_PRELOAD_HOSTS)
+				acmp_reload_hosts();
+			changed = 0;
+			continue;
+		}
+
+		len = read(fd, buf, sizeof(buf));
+		if (len <= 0) {
+			if (len < 0 && errno == EINTR)
+				continue;
+			break;
+		}
+
+		for (event = (void *) buf; (char *) event < buf + len;
+		     event = (void *) ((char *) event + sizeof(*event) +
+				       event->len)) {
+			if (event->len && !strcmp(event->name, p))
+				changed = 1;
+		}
+	}
+
+	close(fd);
+	return NULL;
+}
+
 /*
  * We currently require that the routing data be preloaded in order to
  * load the address data.  This is backwards from normal operation, which
@@ -2365,10 +3276,18 @@ static void acmp_parse_hosts_file(struct acmp_ep *ep)
  */
 static void acmp_ep_preload(struct acmp_ep *ep)
 {
+	union ibv_gid sgid;
+
 	switch (route_preload) {
 	case ACMP_ROUTE_PRELOAD_OSM_FULL_V1:
-		if (acmp_parse_osm_fullv1(ep))
-			acm_log(0, "ERROR - failed to preload EP\n");
+		/* The dump is parsed once for all local ports */
+		acmp_load_routes(1);
+
+		pthread_rwlock_rdlock(&routes_lock);
+		if (!acmp_route_sect(ep, &sgid))
+			acm_log(0, "ERROR - %s not found in %s\n",
+				ep->id_string, route_data_file);
+		pthread_rwlock_unlock(&routes_lock);
 		break;
 	default:
 		break;
@@ -2495,13 +3414,14 @@ static void acmp_remove_addr(void *addr_context)
 			pthread_mutex_lock(&port->lock);
 			list_for_each(&port->ep_list, ep, entry) {
 				pthread_mutex_unlock(&port->lock);
+				pthread_mutex_lock(&ep->lock);
 				dest = acmp_get_dest(ep, address->type, address->addr.info.addr);
 				if (dest) {
 					acm_log(2, "Found a dest addr, deleting it\n");
-					pthread_mutex_lock(&ep->lock);
 					acmp_remove_dest(ep, dest);
-					pthread_mutex_unlock(&ep->lock);
+					acmp_put_dest(dest);
 				}
+				pthread_mutex_unlock(&ep->lock);
 				pthread_mutex_lock(&port->lock);
 			}
 			pthread_mutex_unlock(&port->lock);
@@ -2594,11 +3514,22 @@ acmp_alloc_ep(struct acmp_port *port, struct acm_endpoint *endpoint)
 	list_head_init(&ep->resp_queue.pending);
 	list_head_init(&ep->active_queue);
 	list_head_init(&ep->wait_queue);
+	list_head_init(&ep->dest_lru);
+	acmp_wheel_init(&ep->wheel);
 	pthread_mutex_init(&ep->lock, NULL);
 	sprintf(ep->id_string, "%s-%d-0x%x", port->dev->verbs->device->name,
 		port->port_num, endpoint->pkey);
 
+	ep->dest_hash = malloc(sizeof(*ep->dest_hash) * dest_hash_size);
+	if (!ep->dest_hash) {
+		free(ep);
+		return NULL;
+	}
+	for (i = 0; i < dest_hash_size; i++)
+		list_head_init(&ep->dest_hash[i]);
+
 	if (pthread_rwlock_init(&ep->rwlock, NULL)) {
+		free(ep->dest_hash);
 		free(ep);
 		return NULL;
 	}
@@ -2607,6 +3538,8 @@ acmp_alloc_ep(struct acmp_port *port, struct acm_endpoint *endpoint)
 
 	for (i = 0; i < ACM_MAX_COUNTER; i++)
 		atomic_init(&ep->counters[i]);
+	for (i = 0; i < ACM_MAX_GAUGE; i++)
+		atomic_init(&ep->gauges[i]);
 
 	return ep;
 }
@@ -2712,6 +3645,7 @@ err2:
 err1:
 	ibv_destroy_cq(ep->cq);
 err0:
+	free(ep->dest_hash);
 	free(ep);
 	return -1;
 }
@@ -2736,6 +3670,7 @@ static void acmp_port_up(struct acmp_port *port)
 	port->rate = acm_get_rate(attr.active_width, attr.active_speed);
 	if (attr.subnet_timeout >= 8)
 		port->subnet_timeout = 1 << (attr.subnet_timeout - 8);
+	port->packet_lifetime = attr.subnet_timeout;
 
 	port->lid = attr.lid;
 	port->lid_mask = 0xffff - ((1 << attr.lmc) - 1);
@@ -2969,6 +3904,10 @@ static void acmp_set_options(void)
 			timeout = atoi(value);
 		else if (!strcasecmp("retries", opt))
 			retries = atoi(value);
+		else if (!strcasecmp("dest_cache_size", opt))
+			dest_cache_size = atoi(value);
+		else if (!strcasecmp("negative_timeout", opt))
+			negative_timeout = atoi(value);
 		else if (!strcasecmp("resolve_depth", opt))
 			resolve_depth = atoi(value);
 		else if (!strcasecmp("send_depth", opt))
@@ -3001,6 +3940,9 @@ static void acmp_log_options(void)
 	acm_log(0, "loopback resolution %d\n", loopback_prot);
 	acm_log(0, "timeout %d ms\n", timeout);
 	acm_log(0, "retries %d\n", retries);
+	acm_log(0, "destination cache size %d (%zu KB)\n", dest_cache_size,
+		dest_cache_size * sizeof(struct acmp_dest) / 1024);
+	acm_log(0, "negative timeout %d ms\n", negative_timeout);
 	acm_log(0, "resolve depth %d\n", resolve_depth);
 	acm_log(0, "send depth %d\n", send_depth);
 	acm_log(0, "receive depth %d\n", recv_depth);
@@ -3016,15 +3958,30 @@ static void __attribute__((constructor)) acmp_init(void)
 {
 	acmp_set_options();
 
+	if (dest_cache_size < 1)
+		dest_cache_size = 1;
+	if (negative_timeout < 0)
+		negative_timeout = 0;
+	/* Aim for about four destinations per hash bucket */
+	for (dest_hash_size = 16; dest_hash_size < dest_cache_size / 4;
+	     dest_hash_size <<= 1)
+		;
+
 	acmp_log_options();
 
 	atomic_init(&g_tid);
-	atomic_init(&wait_cnt);
 	pthread_mutex_init(&acmp_dev_lock, NULL);
 	event_init(&timeout_event);
 
 	umad_init();
 
+	if (route_preload == ACMP_ROUTE_PRELOAD_OSM_FULL_V1) {
+		acm_log(1, "watching %s for changes\n", route_data_file);
+		if (pthread_create(&routes_thread_id, NULL,
+				   acmp_route_watcher, NULL))
+			acm_log(0, "Error: failed to create the route watcher\n");
+	}
+
 	acm_log(1, "starting timeout/retry thread\n");
 	if (pthread_create(&retry_thread_id, NULL, acmp_retry_handler, NULL)) {
 		acm_log(0, "Error: failed to create the retry thread");
@@ -53,6 +53,7 @@
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <sys/epoll.h>
 #include <net/if_arp.h>
 #include <linux/netlink.h>
 #include <linux/rtnetlink.h>
@@ -69,7 +70,7 @@
 
 #define NL_MSG_BUF_SIZE 4096
 #define ACM_PROV_NAME_SIZE 64
-#define NL_CLIENT_INDEX 0
+#define ACM_MAX_EVENTS 64
 
 struct acmc_subnet {
 	struct list_node       entry;
@@ -92,6 +93,11 @@ struct acmc_prov_context {
 
 struct acmc_device;
 
+/* Anything the server loop waits on, registered as epoll_event.data.ptr */
+struct acmc_event_src {
+	void (*handler)(struct acmc_event_src *src);
+};
+
 struct acmc_port {
 	struct acmc_device  *dev;
 	struct acm_port     port;
@@ -119,6 +125,7 @@ struct acmc_device {
 	struct acm_device       device;
 	struct list_node        entry;
 	struct list_head        prov_dev_context_list;
+	struct acmc_event_src   event_src;
 	int                     port_cnt;
 	struct acmc_port        port[0];
 };
@@ -141,11 +148,27 @@ struct acmc_ep {
 	struct list_node      entry;
 };
 
+/*
+ * Clients are allocated on accept and freed when the last reference is
+ * dropped.  The connection holds one reference and every request handed to
+ * a provider holds another, which the response releases.  The client address
+ * is the id passed to the providers.
+ */
 struct acmc_client {
 	pthread_mutex_t lock;   /* acquire ep lock first */
 	int      sock;
 	int      index;
 	atomic_t refcnt;
+	struct acmc_event_src event_src;
+	/* Bytes received and not yet dispatched, server thread only */
+	struct acm_msg rbuf;
+	size_t   rlen;
+};
+
+struct acmc_work {
+	struct list_node	entry;
+	struct acmc_client	*client;
+	struct acm_msg		*msg;
 };
 
 union socket_addr {
@@ -184,7 +207,15 @@ static LIST_HEAD(dev_list);
 
 static int listen_socket;
 static int ip_mon_socket;
-static struct acmc_client client_array[FD_SETSIZE - 1];
+static int epoll_fd;
+static struct acmc_client *nl_client;
+static int client_index;
+
+/*
+ * Protects the endpoint address tables.  The server thread is the only
+ * writer; the workers hold it for read while resolving.
+ */
+static pthread_rwlock_t ep_rwlock = PTHREAD_RWLOCK_INITIALIZER;
 
 static FILE *flog;
 static pthread_mutex_t log_lock;
@@ -198,6 +229,7 @@ static int acm_ep_insert_addr(struct acmc_ep *ep, const char *name, uint8_t *add
 			      uint8_t addr_type);
 static void acm_event_handler(struct acmc_device *dev);
 static int acm_nl_send(int sock, struct acm_msg *msg);
+static void acm_client_handler(struct acmc_event_src *src);
 
 static struct sa_data {
 	int		timeout;
@@ -209,6 +241,21 @@ static struct sa_data {
 	int		nfds;
 } sa = { 2000, 2, 1, 0, NULL, NULL, 0};
 
+static struct worker_data {
+	int		count;
+	pthread_t	*thread_ids;
+	int		nthreads;
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;
+	struct list_head queue;
+	bool		stop;
+} workers = {
+	.count = 4,
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+	.queue = LIST_HEAD_INIT(workers.queue),
+};
+
 /*
  * Service options - may be set through ibacm_opts.cfg file.
  */
@@ -224,6 +271,8 @@ static int server_mode = IBACM_SERVER_MODE_DEFAULT;
 static int acme_plus_kernel_only = IBACM_ACME_PLUS_KERNEL_ONLY_DEFAULT;
 static int support_ips_in_addr_cfg = 0;
 static char prov_lib_path[256] = IBACM_LIB_PATH;
+static unsigned int path_cache_size = 256;
+static unsigned int path_cache_timeout = 300;
 
 void acm_write(int level, const char *format, ...)
 {
@@ -496,9 +545,45 @@ __be64 acm_path_comp_mask(struct ibv_path_record *path)
 	return comp_mask;
 }
 
+static struct acmc_client *acm_alloc_client(int sock)
+{
+	struct acmc_client *client;
+
+	client = calloc(1, sizeof(*client));
+	if (!client)
+		return NULL;
+
+	pthread_mutex_init(&client->lock, NULL);
+	client->sock = sock;
+	client->index = client_index++;
+	atomic_init(&client->refcnt);
+	atomic_set(&client->refcnt, 1);
+	client->event_src.handler = acm_client_handler;
+	return client;
+}
+
+static void acm_put_client(struct acmc_client *client)
+{
+	if (atomic_dec(&client->refcnt))
+		return;
+
+	acm_log(2, "releasing client %d\n", client->index);
+	pthread_mutex_destroy(&client->lock);
+	free(client);
+}
+
+/* Tell stream clients they may pipeline, see ACM_CAP_PIPELINE */
+static void acm_set_resolve_caps(struct acmc_client *client,
+				 struct acm_msg *msg)
+{
+	if (client != nl_client &&
+	    (msg->hdr.opcode & ACM_OP_MASK) == ACM_OP_RESOLVE)
+		msg->hdr.data[0] |= ACM_CAP_PIPELINE;
+}
+
 int acm_resolve_response(uint64_t id, struct acm_msg *msg)
 {
-	struct acmc_client *client = &client_array[id];
+	struct acmc_client *client = (struct acmc_client *) (uintptr_t) id;
 	int ret;
 
 	acm_log(2, "client %d, status 0x%x\n", client->index, msg->hdr.status);
@@ -515,7 +600,8 @@ int acm_resolve_response(uint64_t id, struct acm_msg *msg)
 		goto release;
 	}
 
-	if (id == NL_CLIENT_INDEX)
+	acm_set_resolve_caps(client, msg);
+	if (client == nl_client)
 		ret = acm_nl_send(client->sock, msg);
 	else
 		ret = send(client->sock, (char *) msg, msg->hdr.length, 0);
@@ -527,12 +613,34 @@ int acm_resolve_response(uint64_t id, struct acm_msg *msg)
 
 release:
 	pthread_mutex_unlock(&client->lock);
-	(void) atomic_dec(&client->refcnt);
+	acm_put_client(client);
 	return ret;
 }
 
+void acm_publish_path(const struct acm_msg *req, const struct acm_msg *resp,
+		      unsigned int lifetime)
+{
+	const struct acm_ep_addr_data *saddr, *daddr;
+
+	if (resp->hdr.status || !lifetime ||
+	    req->resolve_data[0].type == ACM_EP_INFO_PATH)
+		return;
+
+	saddr = &req->resolve_data[req->hdr.src_index];
+	daddr = &req->resolve_data[req->hdr.dst_index];
+	if ((daddr->type != ACM_EP_INFO_ADDRESS_IP &&
+	     daddr->type != ACM_EP_INFO_ADDRESS_IP6) ||
+	    saddr->type != daddr->type)
+		return;
+
+	acm_shm_insert(daddr->type, saddr->info.addr, daddr->info.addr,
+		       req->hdr.src_out ? ACM_SHM_SRC_SELECTED : 0, resp,
+		       min(lifetime, path_cache_timeout));
+}
+
 static int
-acmc_resolve_response(uint64_t id, struct acm_msg *req_msg, uint8_t status)
+acmc_resolve_response(struct acmc_client *client, struct acm_msg *req_msg,
+		      uint8_t status)
 {
 	req_msg->hdr.opcode |= ACM_OP_ACK;
 	req_msg->hdr.status = status;
@@ -540,12 +648,12 @@ acmc_resolve_response(uint64_t id, struct acm_msg *req_msg, uint8_t status)
 		req_msg->hdr.length = ACM_MSG_HDR_LENGTH;
 	memset(req_msg->hdr.data, 0, sizeof(req_msg->hdr.data));
 
-	return acm_resolve_response(id, req_msg);
+	return acm_resolve_response((uintptr_t) client, req_msg);
 }
 
 int acm_query_response(uint64_t id, struct acm_msg *msg)
 {
-	struct acmc_client *client = &client_array[id];
+	struct acmc_client *client = (struct acmc_client *) (uintptr_t) id;
 	int ret;
 
 	acm_log(2, "status 0x%x\n", msg->hdr.status);
@@ -556,6 +664,7 @@ int acm_query_response(uint64_t id, struct acm_msg *msg)
 		goto release;
 	}
 
+	acm_set_resolve_caps(client, msg);
 	ret = send(client->sock, (char *) msg, msg->hdr.length, 0);
 	if (ret != msg->hdr.length)
 		acm_log(0, "ERROR - failed to send response\n");
@@ -564,29 +673,22 @@ int acm_query_response(uint64_t id, struct acm_msg *msg)
 
 release:
 	pthread_mutex_unlock(&client->lock);
-	(void) atomic_dec(&client->refcnt);
+	acm_put_client(client);
 	return ret;
 }
 
-static int acmc_query_response(uint64_t id, struct acm_msg *msg, uint8_t status)
+static int acmc_query_response(struct acmc_client *client, struct acm_msg *msg,
+			       uint8_t status)
 {
 	acm_log(2, "status 0x%x\n", status);
 	msg->hdr.opcode |= ACM_OP_ACK;
 	msg->hdr.status = status;
-	return acm_query_response(id, msg);
+	return acm_query_response((uintptr_t) client, msg);
 }
 
 static void acm_init_server(void)
 {
 	FILE *f;
-	int i;
-
-	for (i = 0; i < FD_SETSIZE - 1; i++) {
-		pthread_mutex_init(&client_array[i].lock, NULL);
-		client_array[i].index = i;
-		client_array[i].sock = -1;
-		atomic_init(&client_array[i].refcnt);
-	}
 
 	if (server_mode != IBACM_SERVER_MODE_UNIX) {
 		f = fopen(IBACM_IBACME_PORT_FILE, "w");
@@ -681,7 +783,7 @@ static int acm_listen(void)
 		}
 	}
 
-	ret = listen(listen_socket, 0);
+	ret = listen(listen_socket, SOMAXCONN);
 	if (ret == -1) {
 		acm_log(0, "ERROR - unable to start listen\n");
 		return errno;
@@ -713,12 +815,17 @@ static int acm_listen_systemd(void)
 			/* ListenNetlink for RDMA_NL_GROUP_LS multicast
 			 * messages from the kernel
 			 */
-			if (client_array[NL_CLIENT_INDEX].sock != -1) {
+			if (nl_client) {
 				fprintf(stderr,
 					"sd_listen_fds returned more than one netlink socket\n");
 				return -1;
 			}
-			client_array[NL_CLIENT_INDEX].sock = fd;
+			nl_client = acm_alloc_client(fd);
+			if (!nl_client) {
+				fprintf(stderr,
+					"Unable to allocate netlink client\n");
+				return -1;
+			}
 
 			/* systemd sets NONBLOCK on the netlink socket, while
 			 * we want blocking send to the kernel.
@@ -747,20 +854,36 @@ static int acm_listen_systemd(void)
 	return 0;
 }
 
+static int acm_epoll_add(int fd, struct acmc_event_src *src)
+{
+	struct epoll_event event = {
+		.events = EPOLLIN,
+		.data.ptr = src,
+	};
+
+	return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+}
+
+/*
+ * Only called from the server thread, so the socket is never closed while
+ * the loop may still report it.  Responses still queued for the client see
+ * sock == -1 and drop their reference.
+ */
 static void acm_disconnect_client(struct acmc_client *client)
 {
 	pthread_mutex_lock(&client->lock);
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client->sock, NULL);
 	shutdown(client->sock, SHUT_RDWR);
 	close(client->sock);
 	client->sock = -1;
 	pthread_mutex_unlock(&client->lock);
-	(void) atomic_dec(&client->refcnt);
+	acm_put_client(client);
 }
 
-static void acm_svr_accept(void)
+static void acm_svr_accept(struct acmc_event_src *src)
 {
+	struct acmc_client *client;
 	int s;
-	int i;
 
 	acm_log(2, "\n");
 	s = accept(listen_socket, NULL, NULL);
@@ -769,22 +892,21 @@ static void acm_svr_accept(void)
 		return;
 	}
 
-	for (i = 0; i < FD_SETSIZE - 1; i++) {
-		if (i == NL_CLIENT_INDEX)
-			continue;
-		if (!atomic_get(&client_array[i].refcnt))
-			break;
+	client = acm_alloc_client(s);
+	if (!client) {
+		acm_log(0, "ERROR - unable to allocate client - rejecting\n");
+		close(s);
+		return;
 	}
 
-	if (i == FD_SETSIZE - 1) {
-		acm_log(0, "ERROR - all connections busy - rejecting\n");
+	if (acm_epoll_add(s, &client->event_src)) {
+		acm_log(0, "ERROR - unable to poll client - rejecting\n");
 		close(s);
+		acm_put_client(client);
 		return;
 	}
 
-	client_array[i].sock = s;
-	atomic_set(&client_array[i].refcnt, 1);
-	acm_log(2, "assigned client %d\n", i);
+	acm_log(2, "assigned client %d\n", client->index);
 }
 
 static int
@@ -919,17 +1041,18 @@ acm_svr_query_path(struct acmc_client *client, struct acm_msg *msg)
 	acm_log(2, "client %d\n", client->index);
 	if (msg->hdr.length != ACM_MSG_HDR_LENGTH + ACM_MSG_EP_LENGTH) {
 		acm_log(0, "ERROR - invalid length: 0x%x\n", msg->hdr.length);
-		return acmc_query_response(client->index, msg, ACM_STATUS_EINVAL);
+		return acmc_query_response(client, msg, ACM_STATUS_EINVAL);
 	}
 
 	addr = acm_get_ep_address(&msg->resolve_data[0]);
 	if (!addr) {
 		acm_log(1, "notice - could not find local end point address\n");
-		return acmc_query_response(client->index, msg, ACM_STATUS_ESRCADDR);
+		return acmc_query_response(client, msg, ACM_STATUS_ESRCADDR);
 	}
 
 	ep = container_of(addr->addr.endpoint, struct acmc_ep, endpoint);
-	return ep->port->prov->query(addr->prov_addr_context, msg, client->index);
+	return ep->port->prov->query(addr->prov_addr_context, msg,
+				     (uintptr_t) client);
 }
 
 static int acm_svr_select_src(struct acm_ep_addr_data *src, struct acm_ep_addr_data *dst)
@@ -1062,7 +1185,7 @@ acm_svr_resolve_dest(struct acmc_client *client, struct acm_msg *msg)
 	status = acm_svr_verify_resolve(msg);
 	if (status) {
 		acm_log(0, "notice - misformatted or unsupported request\n");
-		return acmc_resolve_response(client->index, msg, status);
+		return acmc_resolve_response(client, msg, status);
 	}
 
 	saddr = &msg->resolve_data[msg->hdr.src_index];
@@ -1071,7 +1194,7 @@ acm_svr_resolve_dest(struct acmc_client *client, struct acm_msg *msg)
 		status = acm_svr_select_src(saddr, daddr);
 		if (status) {
 			acm_log(0, "notice - unable to select suitable source address\n");
-			return acmc_resolve_response(client->index, msg, status);
+			return acmc_resolve_response(client, msg, status);
 		}
 	}
 
@@ -1081,11 +1204,12 @@ acm_svr_resolve_dest(struct acmc_client *client, struct acm_msg *msg)
 	addr = acm_get_ep_address(saddr);
 	if (!addr) {
 		acm_log(0, "notice - unknown local end point address\n");
-		return acmc_resolve_response(client->index, msg, ACM_STATUS_ESRCADDR);
+		return acmc_resolve_response(client, msg, ACM_STATUS_ESRCADDR);
 	}
 
 	ep = container_of(addr->addr.endpoint, struct acmc_ep, endpoint);
-	return ep->port->prov->resolve(addr->prov_addr_context, msg, client->index);
+	return ep->port->prov->resolve(addr->prov_addr_context, msg,
+				       (uintptr_t) client);
 }
 
 /*
@@ -1103,13 +1227,13 @@ acm_svr_resolve_path(struct acmc_client *client, struct acm_msg *msg)
 	acm_log(2, "client %d\n", client->index);
 	if (msg->hdr.length < (ACM_MSG_HDR_LENGTH + ACM_MSG_EP_LENGTH)) {
 		acm_log(0, "notice - invalid msg hdr length %d\n", msg->hdr.length);
-		return acmc_resolve_response(client->index, msg, ACM_STATUS_EINVAL);
+		return acmc_resolve_response(client, msg, ACM_STATUS_EINVAL);
 	}
 
 	path = &msg->resolve_data[0].info.path;
 	if (!path->dlid && ib_any_gid(&path->dgid)) {
 		acm_log(0, "notice - no destination specified\n");
-		return acmc_resolve_response(client->index, msg,
+		return acmc_resolve_response(client, msg,
 					     ACM_STATUS_EDESTADDR);
 	}
 
@@ -1119,28 +1243,129 @@ acm_svr_resolve_path(struct acmc_client *client, struct acm_msg *msg)
 	addr = acm_get_ep_address(&msg->resolve_data[0]);
 	if (!addr) {
 		acm_log(0, "notice - unknown local end point address\n");
-		return acmc_resolve_response(client->index, msg,
+		return acmc_resolve_response(client, msg,
 					     ACM_STATUS_ESRCADDR);
 	}
 
 	ep = container_of(addr->addr.endpoint, struct acmc_ep, endpoint);
 	return ep->port->prov->resolve(addr->prov_addr_context, msg,
-				       client->index);
+				       (uintptr_t) client);
 }
 
 static int acm_svr_resolve(struct acmc_client *client, struct acm_msg *msg)
 {
+	int ret;
+
 	(void) atomic_inc(&client->refcnt);
 
+	pthread_rwlock_rdlock(&ep_rwlock);
 	if (msg->resolve_data[0].type == ACM_EP_INFO_PATH) {
 		if (msg->resolve_data[0].flags & ACM_FLAGS_QUERY_SA) {
-			return acm_svr_query_path(client, msg);
+			ret = acm_svr_query_path(client, msg);
 		} else {
-			return acm_svr_resolve_path(client, msg);
+			ret = acm_svr_resolve_path(client, msg);
 		}
 	} else {
-		return acm_svr_resolve_dest(client, msg);
+		ret = acm_svr_resolve_dest(client, msg);
+	}
+	pthread_rwlock_unlock(&ep_rwlock);
+	return ret;
+}
+
+static void *acm_worker(void *context)
+{
+	struct acmc_work *work;
+
+	while (1) {
+		pthread_mutex_lock(&workers.lock);
+		while (list_empty(&workers.queue) && !workers.stop)
+			pthread_cond_wait(&workers.cond, &workers.lock);
+		work = list_pop(&workers.queue, struct acmc_work, entry);
+		pthread_mutex_unlock(&workers.lock);
+		if (!work)
+			break;
+
+		/*
+		 * A failed send leaves the socket broken, and the server
+		 * thread disconnects the client once it sees the hangup.
+		 */
+		if (acm_svr_resolve(work->client, work->msg))
+			acm_log(1, "notice - client %d resolve failed\n",
+				work->client->index);
+		acm_put_client(work->client);
+		free(work->msg);
+		free(work);
 	}
+
+	return NULL;
+}
+
+/*
+ * Resolve a request from the server thread.  Ownership of msg passes to this
+ * call.  Without workers the request is resolved inline and the result
+ * returned; otherwise it is queued and 0 is returned.
+ */
+static int acm_svr_dispatch_resolve(struct acmc_client *client,
+				    struct acm_msg *msg)
+{
+	struct acmc_work *work;
+	int ret;
+
+	work = workers.nthreads ? malloc(sizeof(*work)) : NULL;
+	if (!work) {
+		ret = acm_svr_resolve(client, msg);
+		free(msg);
+		return ret;
+	}
+
+	(void) atomic_inc(&client->refcnt);
+	work->client = client;
+	work->msg = msg;
+
+	pthread_mutex_lock(&workers.lock);
+	list_add_tail(&workers.queue, &work->entry);
+	pthread_cond_signal(&workers.cond);
+	pthread_mutex_unlock(&workers.lock);
+	return 0;
+}
+
+static void acm_start_workers(void)
+{
+	int i;
+
+	if (workers.count <= 0)
+		return;
+
+	workers.thread_ids = calloc(workers.count, sizeof(*workers.thread_ids));
+	if (!workers.thread_ids) {
+		acm_log(0, "ERROR - unable to allocate worker threads\n");
+		return;
+	}
+
+	for (i = 0; i < workers.count; i++) {
+		if (pthread_create(&workers.thread_ids[i], NULL, acm_worker,
+				   NULL)) {
+			acm_log(0, "ERROR - unable to start worker %d\n", i);
+			break;
+		}
+		workers.nthreads++;
+	}
+	acm_log(1, "started %d worker threads\n", workers.nthreads);
+}
+
+static void acm_stop_workers(void)
+{
+	int i;
+
+	pthread_mutex_lock(&workers.lock);
+	workers.stop = true;
+	pthread_cond_broadcast(&workers.cond);
+	pthread_mutex_unlock(&workers.lock);
+
+	for (i = 0; i < workers.nthreads; i++)
+		pthread_join(workers.thread_ids[i], NULL);
+	free(workers.thread_ids);
+	workers.nthreads = 0;
 }
 
 static int acm_svr_perf_query(struct acmc_client *client, struct acm_msg *msg)
@@ -1187,7 +1412,59 @@ static int acm_svr_perf_query(struct acmc_client *client, struct acm_msg *msg)
 	}
 	msg->hdr.length = htobe16(len);
 
+	pthread_mutex_lock(&client->lock);
+	ret = send(client->sock, (char *) msg, len, 0);
+	pthread_mutex_unlock(&client->lock);
+	if (ret != len)
+		acm_log(0, "ERROR - failed to send response\n");
+	else
+		ret = 0;
+
+	return ret;
+}
+
+static int acm_svr_stats_query(struct acmc_client *client, struct acm_msg *msg)
+{
+	struct acm_provider *prov;
+	struct acmc_ep *ep;
+	uint8_t op;
+	uint16_t len;
+	int ret;
+
+	acm_log(2, "client %d\n", client->index);
+	op = msg->hdr.dst_index;
+	ep = acm_get_ep(msg->hdr.src_out - 1, msg->hdr.src_index);
+	msg->hdr.opcode |= ACM_OP_ACK;
+	msg->hdr.src_out = 0;
+	msg->hdr.src_index = 0;
+	msg->hdr.dst_index = 0;
+
+	if (!ep) {
+		msg->hdr.status = ACM_STATUS_ESRCADDR;
+		len = ACM_MSG_HDR_LENGTH;
+		goto send;
+	}
+
+	prov = ep->port->prov;
+	if (op >= ACM_MAX_STAT ||
+	    prov->size <= offsetof(struct acm_provider, query_stats) ||
+	    !prov->query_stats) {
+		msg->hdr.status = op >= ACM_MAX_STAT ?
+				  ACM_STATUS_EINVAL : ACM_STATUS_ENODATA;
+		len = ACM_MSG_HDR_LENGTH;
+		goto send;
+	}
+
+	memset(&msg->stats_data[0], 0, sizeof(msg->stats_data[0]));
+	prov->query_stats(ep->prov_ep_context, op, &msg->stats_data[0]);
+	msg->hdr.status = ACM_STATUS_SUCCESS;
+	len = ACM_MSG_HDR_LENGTH + sizeof(msg->stats_data[0]);
+
+send:
+	msg->hdr.length = htobe16(len);
+	pthread_mutex_lock(&client->lock);
 	ret = send(client->sock, (char *) msg, len, 0);
+	pthread_mutex_unlock(&client->lock);
 	if (ret != len)
 		acm_log(0, "ERROR - failed to send response\n");
 	else
@@ -1272,7 +1549,9 @@ static int acm_svr_ep_query(struct acmc_client *client, struct acm_msg **_msg)
 	msg->hdr.dst_index = 0;
 	msg->hdr.length = htobe16(len);
 
+	pthread_mutex_lock(&client->lock);
 	ret = send(client->sock, (char *) msg, len, 0);
+	pthread_mutex_unlock(&client->lock);
 	if (ret != len)
 		acm_log(0, "ERROR - failed to send response\n");
 	else
@@ -1287,50 +1566,90 @@ static int acm_msg_length(struct acm_msg *msg)
 		msg->hdr.length : be16toh(msg->hdr.length);
 }
 
-static void acm_svr_receive(struct acmc_client *client)
+static int acm_svr_process(struct acmc_client *client, struct acm_msg *msg)
 {
-	struct acm_msg *msg = malloc(sizeof(*msg));
 	int ret;
 
-	if (!msg) {
-		acm_log(0, "ERROR - Unable to alloc acm_msg\n");
-		ret = ENOMEM;
-		goto out;
-	}
-
-	acm_log(2, "client %d\n", client->index);
-	ret = recv(client->sock, (char *)msg, sizeof(*msg), 0);
-	if (ret <= 0 || ret != acm_msg_length(msg)) {
-		acm_log(2, "client disconnected\n");
-		ret = ACM_STATUS_ENOTCONN;
-		goto out;
-	}
-
 	if (msg->hdr.version != ACM_VERSION) {
 		acm_log(0, "ERROR - unsupported version %d\n", msg->hdr.version);
-		goto out;
+		free(msg);
+		return ACM_STATUS_EINVAL;
 	}
 
 	switch (msg->hdr.opcode & ACM_OP_MASK) {
 	case ACM_OP_RESOLVE:
 		atomic_inc(&counter[ACM_CNTR_RESOLVE]);
-		ret = acm_svr_resolve(client, msg);
-		break;
+		return acm_svr_dispatch_resolve(client, msg);
 	case ACM_OP_PERF_QUERY:
 		ret = acm_svr_perf_query(client, msg);
 		break;
 	case ACM_OP_EP_QUERY:
 		ret = acm_svr_ep_query(client, &msg);
 		break;
+	case ACM_OP_STATS_QUERY:
+		ret = acm_svr_stats_query(client, msg);
+		break;
 	default:
 		acm_log(0, "ERROR - unknown opcode 0x%x\n", msg->hdr.opcode);
+		ret = ACM_STATUS_EINVAL;
 		break;
 	}
 
-out:
 	free(msg);
-	if (ret)
-		acm_disconnect_client(client);
+	return ret;
+}
+
+/*
+ * Clients may pipeline requests and a request may arrive in pieces, so
+ * take what the socket holds without waiting, keep a partial request in the
+ * client buffer for the next call and dispatch every complete one.  A client
+ * that stalls in the middle of a request then only stalls itself.
+ */
+static void acm_svr_receive(struct acmc_client *client)
+{
+	uint8_t *buf = (uint8_t *)&client->rbuf;
+	struct acm_msg *msg;
+	ssize_t ret;
+	int len;
+
+	acm_log(2, "client %d\n", client->index);
+	ret = recv(client->sock, buf + client->rlen,
+		   sizeof(client->rbuf) - client->rlen, MSG_DONTWAIT);
+	if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK ||
+			errno == EINTR))
+		return;
+	if (ret <= 0) {
+		acm_log(2, "client disconnected\n");
+		goto disconnect;
+	}
+	client->rlen += ret;
+
+	while (client->rlen >= ACM_MSG_HDR_LENGTH) {
+		len = acm_msg_length(&client->rbuf);
+		if (len < ACM_MSG_HDR_LENGTH || len > sizeof(*msg)) {
+			acm_log(0, "ERROR - client %d sent bad length %d\n",
+				client->index, len);
+			goto disconnect;
+		}
+		if (client->rlen < len)
+			return;
+
+		msg = malloc(sizeof(*msg));
+		if (!msg) {
+			acm_log(0, "ERROR - Unable to alloc acm_msg\n");
+			goto disconnect;
+		}
+		memcpy(msg, buf, len);
+		client->rlen -= len;
+		memmove(buf, buf + len, client->rlen);
+
+		if (acm_svr_process(client, msg))
+			goto disconnect;
+	}
+	return;
+
+disconnect:
+	acm_disconnect_client(client);
 }
 
 static int acm_nl_to_addr_data(struct acm_ep_addr_data *ad,
@@ -1730,7 +2049,7 @@ static void acm_nl_process_invalid_request(struct acmc_client *client,
 static void acm_nl_process_resolve(struct acmc_client *client,
 				   struct acm_nl_msg *acmnlmsg)
 {
-	struct acm_msg msg;
+	struct acm_msg msg, *req;
 	struct nlattr *attr;
 	int payload_len;
 	int resolve_hdr_len;
@@ -1780,8 +2099,15 @@ static void acm_nl_process_resolve(struct acmc_client *client,
 		attr = (struct nlattr *) ((char *) attr + total_attr_len);
 	}
 
+	req = malloc(sizeof(*req));
+	if (!req) {
+		acm_nl_process_invalid_request(client, acmnlmsg);
+		return;
+	}
+	memcpy(req, &msg, sizeof(msg));
+
 	atomic_inc(&counter[ACM_CNTR_RESOLVE]);
-	acm_svr_resolve(client, &msg);
+	acm_svr_dispatch_resolve(client, req);
 }
 
 static int acm_nl_is_valid_resolve_request(struct acm_nl_msg *acmnlmsg)
@@ -1874,20 +2200,66 @@ static int acm_init_nl(void)
 	}
 
 	/* init nl client structure */
-	client_array[NL_CLIENT_INDEX].sock = nl_rcv_socket;
+	nl_client = acm_alloc_client(nl_rcv_socket);
+	if (!nl_client) {
+		acm_log(0, "ERROR - unable to allocate netlink client\n");
+		close(nl_rcv_socket);
+		return ENOMEM;
+	}
 	return 0;
 }
 
+static void acm_client_handler(struct acmc_event_src *src)
+{
+	struct acmc_client *client =
+		container_of(src, struct acmc_client, event_src);
+
+	acm_log(2, "receiving from client %d\n", client->index);
+	if (client == nl_client)
+		acm_nl_receive(client);
+	else
+		acm_svr_receive(client);
+}
+
+/* Address and port changes rewrite the endpoint tables the workers read */
+static void acm_ipnl_event(struct acmc_event_src *src)
+{
+	pthread_rwlock_wrlock(&ep_rwlock);
+	acm_ipnl_handler();
+	acm_shm_flush();
+	pthread_rwlock_unlock(&ep_rwlock);
+}
+
+static void acm_device_event(struct acmc_event_src *src)
+{
+	struct acmc_device *dev =
+		container_of(src, struct acmc_device, event_src);
+
+	acm_log(2, "handling event from %s\n", dev->device.verbs->device->name);
+	pthread_rwlock_wrlock(&ep_rwlock);
+	acm_event_handler(dev);
+	acm_shm_flush();
+	pthread_rwlock_unlock(&ep_rwlock);
+}
+
 static void acm_server(bool systemd)
 {
-	fd_set readfds;
+	static struct acmc_event_src listen_src = { acm_svr_accept };
+	static struct acmc_event_src ip_mon_src = { acm_ipnl_event };
+	struct epoll_event events[ACM_MAX_EVENTS];
+	struct acmc_event_src *src;
 	int i, n, ret;
 	struct acmc_device *dev;
 
 	acm_log(0, "started\n");
 	acm_init_server();
 
-	client_array[NL_CLIENT_INDEX].sock = -1;
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd == -1) {
+		acm_log(0, "ERROR - unable to create epoll fd\n");
+		return;
+	}
+
 	listen_socket = -1;
 	if (systemd) {
 		ret = acm_listen_systemd();
@@ -1905,63 +2277,51 @@ static void acm_server(bool systemd)
 		}
 	}
 
-	if (client_array[NL_CLIENT_INDEX].sock == -1) {
+	if (!nl_client) {
 		ret = acm_init_nl();
 		if (ret)
 			acm_log(1, "Warn - Netlink init failed\n");
 	}
 
-	if (systemd)
-		sd_notify(0, "READY=1");
+	if (acm_epoll_add(listen_socket, &listen_src)) {
+		acm_log(0, "ERROR - unable to poll listen socket\n");
+		return;
+	}
 
-	while (1) {
-		n = (int) listen_socket;
-		FD_ZERO(&readfds);
-		FD_SET(listen_socket, &readfds);
-		n = max(n, (int) ip_mon_socket);
-		FD_SET(ip_mon_socket, &readfds);
-
-		for (i = 0; i < FD_SETSIZE - 1; i++) {
-			if (client_array[i].sock != -1) {
-				FD_SET(client_array[i].sock, &readfds);
-				n = max(n, (int) client_array[i].sock);
-			}
-		}
+	if (ip_mon_socket != -1 && acm_epoll_add(ip_mon_socket, &ip_mon_src))
+		acm_log(0, "ERROR - unable to poll IP netlink socket\n");
 
-		list_for_each(&dev_list, dev, entry) {
-			FD_SET(dev->device.verbs->async_fd, &readfds);
-			n = max(n, (int) dev->device.verbs->async_fd);
-		}
+	if (nl_client && acm_epoll_add(nl_client->sock, &nl_client->event_src))
+		acm_log(0, "ERROR - unable to poll netlink socket\n");
 
-		ret = select(n + 1, &readfds, NULL, NULL, NULL);
-		if (ret == -1) {
-			acm_log(0, "ERROR - server select error\n");
-			continue;
-		}
+	list_for_each(&dev_list, dev, entry) {
+		dev->event_src.handler = acm_device_event;
+		if (acm_epoll_add(dev->device.verbs->async_fd, &dev->event_src))
+			acm_log(0, "ERROR - unable to poll %s events\n",
+				dev->device.verbs->device->name);
+	}
 
-		if (FD_ISSET(listen_socket, &readfds))
-			acm_svr_accept();
+	/* The cache serves the same clients as the librdmacm socket */
+	if (path_cache_size && !acme_plus_kernel_only &&
+	    acm_shm_open(IBACM_PATH_CACHE_FILE, path_cache_size))
+		acm_log(0, "notice - path cache disabled\n");
 
-		if (FD_ISSET(ip_mon_socket, &readfds))
-			acm_ipnl_handler();
+	acm_start_workers();
 
-		for (i = 0; i < FD_SETSIZE - 1; i++) {
-			if (client_array[i].sock != -1 &&
-				FD_ISSET(client_array[i].sock, &readfds)) {
-				acm_log(2, "receiving from client %d\n", i);
-				if (i == NL_CLIENT_INDEX)
-					acm_nl_receive(&client_array[i]);
-				else
-					acm_svr_receive(&client_array[i]);
-			}
+	if (systemd)
+		sd_notify(0, "READY=1");
+
+	while (1) {
+		n = epoll_wait(epoll_fd, events, ACM_MAX_EVENTS, -1);
+		if (n == -1) {
+			if (errno != EINTR)
+				acm_log(0, "ERROR - server epoll error\n");
+			continue;
 		}
 
-		list_for_each(&dev_list, dev, entry) {
-			if (FD_ISSET(dev->device.verbs->async_fd, &readfds)) {
-				acm_log(2, "handling event from %s\n",
-					dev->device.verbs->device->name);
-				acm_event_handler(dev);
-			}
+		for (i = 0; i < n; i++) {
+			src = events[i].data.ptr;
+			src->handler(src);
 		}
 	}
 }
@@ -2902,8 +3262,11 @@ static int acm_open_providers(void)
 			continue;
 		}
 
+		/* Providers built before query_stats was added are accepted */
 		if (version != ACM_PROV_VERSION ||
-		    provider->size != sizeof(struct acm_provider)) {
+		    (provider->size != sizeof(struct acm_provider) &&
+		     provider->size != offsetof(struct acm_provider,
+						query_stats))) {
 			acm_log(0, "Error -unmatched provider version 0x%08x (size %zd)"
 				" core 0x%08x (size %zd)\n", version, provider->size,
 				ACM_PROV_VERSION, sizeof(struct acm_provider));
@@ -3220,6 +3583,12 @@ static void acm_set_options(void)
 			sa.retries = atoi(value);
 		else if (!strcasecmp("sa_depth", opt))
 			sa.depth = atoi(value);
+		else if (!strcasecmp("worker_threads", opt))
+			workers.count = atoi(value);
+		else if (!strcasecmp("path_cache_size", opt))
+			path_cache_size = strtoul(value, NULL, 0);
+		else if (!strcasecmp("path_cache_timeout", opt))
+			path_cache_timeout = strtoul(value, NULL, 0);
 	}
 
 	fclose(f);
@@ -3244,6 +3613,9 @@ static void acm_log_options(void)
 	acm_log(0, "timeout %d ms\n", sa.timeout);
 	acm_log(0, "retries %d\n", sa.retries);
 	acm_log(0, "sa depth %d\n", sa.depth);
+	acm_log(0, "worker threads %d\n", workers.count);
+	acm_log(0, "path cache size %u\n", path_cache_size);
+	acm_log(0, "path cache timeout %u s\n", path_cache_timeout);
 	acm_log(0, "options file %s\n", opts_file);
 	acm_log(0, "addr file %s\n", addr_file);
 	acm_log(0, "provider lib path %s\n", prov_lib_path);
@@ -3390,8 +3762,10 @@ int main(int argc, char **argv)
 	acm_server(systemd);
 
 	acm_log(0, "shutting down\n");
-	if (client_array[NL_CLIENT_INDEX].sock != -1)
-		close(client_array[NL_CLIENT_INDEX].sock);
+	acm_stop_workers();
+	acm_shm_close();
+	if (nl_client)
+		close(nl_client->sock);
 	acm_close_providers();
 	acm_stop_sa_handler();
 	umad_done();
@@ -0,0 +1,198 @@
+/* GPLv2 or OpenIB.org BSD (MIT) See COPYING file */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <osd.h>
+#include <infiniband/acm.h>
+#include "acm_util.h"
+
+/*
+ * Writer side of the shared path cache described in acm.h.  Entries are
+ * only written here, serialized by shm_lock; clients never write.
+ */
+
+static struct acm_shm_hdr *shm;
+static size_t shm_size;
+static char shm_path[128];
+static pthread_mutex_t shm_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Detach clients still mapping a file left by an earlier instance */
+static void acm_shm_retire(const char *path)
+{
+	struct acm_shm_hdr *old;
+	struct stat st;
+	int fd;
+
+	fd = open(path, O_RDWR | O_CLOEXEC);
+	if (fd < 0)
+		return;
+
+	if (!fstat(fd, &st) && st.st_size >= sizeof(*old)) {
+		old = mmap(NULL, sizeof(*old), PROT_READ | PROT_WRITE,
+			   MAP_SHARED, fd, 0);
+		if (old != MAP_FAILED) {
+			__atomic_store_n(&old->magic, 0, __ATOMIC_RELEASE);
+			munmap(old, sizeof(*old));
+		}
+	}
+	close(fd);
+	unlink(path);
+}
+
+int acm_shm_open(const char *path, unsigned int bucket_cnt)
+{
+	int fd, ret;
+
+	if (!bucket_cnt || (bucket_cnt & (bucket_cnt - 1))) {
+		acm_log(0, "ERROR - path cache size %u is not a power of 2\n",
+			bucket_cnt);
+		return EINVAL;
+	}
+
+	acm_shm_retire(path);
+
+	fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		ret = errno;
+		acm_log(0, "ERROR - unable to create path cache %s\n", path);
+		return ret;
+	}
+
+	/* Clients of any user read the cache */
+	if (fchmod(fd, 0644))
+		acm_log(0, "notice - unable to set path cache permissions\n");
+
+	shm_size = sizeof(*shm) + (size_t) bucket_cnt * ACM_SHM_WAYS *
+		   sizeof(struct acm_shm_entry);
+	if (ftruncate(fd, shm_size)) {
+		ret = errno;
+		acm_log(0, "ERROR - unable to size path cache\n");
+		goto err;
+	}
+
+	shm = mmap(NULL, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (shm == MAP_FAILED) {
+		ret = errno;
+		shm = NULL;
+		acm_log(0, "ERROR - unable to map path cache\n");
+		goto err;
+	}
+	close(fd);
+
+	shm->version = ACM_SHM_VERSION;
+	shm->bucket_cnt = bucket_cnt;
+	shm->entry_size = sizeof(struct acm_shm_entry);
+	__atomic_store_n(&shm->magic, ACM_SHM_MAGIC, __ATOMIC_RELEASE);
+
+	snprintf(shm_path, sizeof(shm_path), "%s", path);
+	acm_log(1, "path cache %s, %u entries\n", path,
+		bucket_cnt * ACM_SHM_WAYS);
+	return 0;
+
+err:
+	close(fd);
+	unlink(path);
+	return ret;
+}
+
+void acm_shm_close(void)
+{
+	if (!shm)
+		return;
+
+	__atomic_store_n(&shm->magic, 0, __ATOMIC_RELEASE);
+	munmap(shm, shm_size);
+	unlink(shm_path);
+	shm = NULL;
+}
+
+static void acm_shm_write_begin(struct acm_shm_entry *entry)
+{
+	__atomic_store_n(&entry->seq, entry->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void acm_shm_write_end(struct acm_shm_entry *entry)
+{
+	__atomic_store_n(&entry->seq, entry->seq + 1, __ATOMIC_RELEASE);
+}
+
+void acm_shm_insert(uint16_t type, const uint8_t *src, const uint8_t *dst,
+		    uint16_t flags, const struct acm_msg *resp,
+		    unsigned int lifetime)
+{
+	struct acm_shm_entry *bucket, *way, *entry = NULL;
+	struct acm_shm_entry *unused = NULL, *oldest = NULL;
+	uint64_t now;
+	int i, len;
+
+	if (!shm || resp->hdr.length < ACM_MSG_HDR_LENGTH ||
+	    resp->hdr.length > ACM_MSG_HDR_LENGTH + ACM_MSG_DATA_LENGTH)
+		return;
+
+	len = acm_shm_addr_len(type);
+	bucket = &shm->entries[(acm_shm_hash(type, dst) &
+				(shm->bucket_cnt - 1)) * ACM_SHM_WAYS];
+	now = time_stamp_sec();
+
+	pthread_mutex_lock(&shm_lock);
+	/* Replace the same key, else a free or expired way, else the oldest */
+	for (i = 0; i < ACM_SHM_WAYS; i++) {
+		way = &bucket[i];
+		if (way->type == type && way->flags == flags &&
+		    !memcmp(way->dst, dst, len) && !memcmp(way->src, src, len)) {
+			entry = way;
+			break;
+		}
+		if (!way->type || way->expires <= now) {
+			if (!unused)
+				unused = way;
+		} else if (!oldest || way->expires < oldest->expires) {
+			oldest = way;
+		}
+	}
+	if (!entry)
+		entry = unused ? unused : oldest;
+
+	acm_shm_write_begin(entry);
+	entry->type = type;
+	entry->flags = flags;
+	entry->expires = now + lifetime;
+	memset(entry->src, 0, sizeof(entry->src));
+	memcpy(entry->src, src, len);
+	memset(entry->dst, 0, sizeof(entry->dst));
+	memcpy(entry->dst, dst, len);
+	entry->length = resp->hdr.length - ACM_MSG_HDR_LENGTH;
+	memcpy(entry->data, resp->data, entry->length);
+	acm_shm_write_end(entry);
+	pthread_mutex_unlock(&shm_lock);
+}
+
+void acm_shm_flush(void)
+{
+	struct acm_shm_entry *entry;
+	size_t i;
+
+	if (!shm)
+		return;
+
+	acm_log(2, "\n");
+	pthread_mutex_lock(&shm_lock);
+	for (i = 0; i < (size_t) shm->bucket_cnt * ACM_SHM_WAYS; i++) {
+		entry = &shm->entries[i];
+		if (!entry->type)
+			continue;
+		acm_shm_write_begin(entry);
+		entry->type = 0;
+		acm_shm_write_end(entry);
+	}
+	pthread_mutex_unlock(&shm_lock);
+}
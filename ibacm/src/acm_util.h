@@ -63,6 +63,13 @@ typedef void (*acm_if_iter_cb)(char *ifname, union ibv_gid *gid, uint16_t pkey,
 				char *ip_str, void *ctx);
 int acm_if_iter_sys(acm_if_iter_cb cb, void *ctx);
 
+int acm_shm_open(const char *path, unsigned int bucket_cnt);
+void acm_shm_close(void);
+void acm_shm_insert(uint16_t type, const uint8_t *src, const uint8_t *dst,
+		    uint16_t flags, const struct acm_msg *resp,
+		    unsigned int lifetime);
+void acm_shm_flush(void);
+
 
 char **parse(const char *args, int *count);
 
@@ -63,6 +63,7 @@ static int nodelay;
 static int repetitions = 1;
 static int ep_index;
 static int enum_ep;
+static int stats_query;
 
 enum perf_query_output {
 	PERF_QUERY_NONE,
@@ -100,6 +101,9 @@ static void show_usage(char *program)
 	printf("                        all: output data for all endpoints\n");
 	printf("                        s: output data for the endpoint with the\n");
 	printf("                           address specified in -s option\n");
+	printf("   [-L [N]]         - query latency histograms and queue depths as CSV:\n");
+	printf("                        No index: all endpoints\n");
+	printf("                        N: endpoint N (N = 1, 2, ...)\n");
 	printf("   [-S svc_addr]    - address of ACM service, default: local service\n");
 	printf("   [-C repetitions] - repeat count for resolution\n");
 	printf("usage 2: %s\n", program);
@@ -235,6 +239,29 @@ static void gen_opts_temp(FILE *f)
 #else
 	fprintf(f, "acme_plus_kernel_only no\n");
 #endif
+	fprintf(f, "\n");
+	fprintf(f, "# worker_threads:\n");
+	fprintf(f, "# Number of threads that resolve client requests.  Connections are\n");
+	fprintf(f, "# accepted and read by a single thread, which hands resolve and path\n");
+	fprintf(f, "# queries to the workers.  Set to 0 to resolve all requests on the\n");
+	fprintf(f, "# server thread.\n");
+	fprintf(f, "\n");
+	fprintf(f, "worker_threads 4\n");
+	fprintf(f, "\n");
+	fprintf(f, "# path_cache_size:\n");
+	fprintf(f, "# Number of buckets, a power of 2, in the path cache shared with\n");
+	fprintf(f, "# librdmacm.  Each bucket holds 4 resolved addresses.  Clients look up\n");
+	fprintf(f, "# cached addresses directly and only contact ibacm on a miss.\n");
+	fprintf(f, "# Set to 0 to disable the shared cache.\n");
+	fprintf(f, "\n");
+	fprintf(f, "path_cache_size 256\n");
+	fprintf(f, "\n");
+	fprintf(f, "# path_cache_timeout:\n");
+	fprintf(f, "# Maximum time, in seconds, that a resolution stays in the shared path\n");
+	fprintf(f, "# cache.  Entries also expire with the provider's address and route\n");
+	fprintf(f, "# timeouts, and the cache is flushed on port and IP address changes.\n");
+	fprintf(f, "\n");
+	fprintf(f, "path_cache_timeout 300\n");
 	fprintf(f, "\n");
 	fprintf(f, "# timeout:\n");
 	fprintf(f, "# Additional time, in milliseconds, that the ACM service will wait for a\n");
@@ -249,6 +276,21 @@ static void gen_opts_temp(FILE *f)
 	fprintf(f, "\n");
 	fprintf(f, "retries 2\n");
 	fprintf(f, "\n");
+	fprintf(f, "# dest_cache_size:\n");
+	fprintf(f, "# Maximum number of destinations cached per endpoint.  When the cache\n");
+	fprintf(f, "# is full, the least recently used destinations that are not being\n");
+	fprintf(f, "# resolved are dropped.  Local and preloaded permanent entries are\n");
+	fprintf(f, "# never dropped.\n");
+	fprintf(f, "\n");
+	fprintf(f, "dest_cache_size 65536\n");
+	fprintf(f, "\n");
+	fprintf(f, "# negative_timeout:\n");
+	fprintf(f, "# Time, in milliseconds, that a failed resolution is remembered.  Requests\n");
+	fprintf(f, "# for the same destination fail immediately during that time instead of\n");
+	fprintf(f, "# querying the subnet again.  Set to 0 to disable negative caching.\n");
+	fprintf(f, "\n");
+	fprintf(f, "negative_timeout 5000\n");
+	fprintf(f, "\n");
 	fprintf(f, "# resolve_depth:\n");
 	fprintf(f, "# Specifies the maximum number of outstanding requests that can be in\n");
 	fprintf(f, "# progress simultaneously.  A larger resolve depth allows for greater\n");
@@ -315,6 +357,9 @@ static void gen_opts_temp(FILE *f)
 	fprintf(f, "# Specifies the location of the route data file to use when preloading\n");
 	fprintf(f, "# the ACM cache.  This option is only valid if route_preload\n");
 	fprintf(f, "# indicates that routing data should be read from a file.\n");
+	fprintf(f, "# The file is watched for changes and reloaded in the background.\n");
+	fprintf(f, "# Resolution continues from the previous contents until the new\n");
+	fprintf(f, "# contents have been loaded.\n");
 	fprintf(f, "# Default is %s/ibacm_route.data\n", ACM_CONF_DIR);
 	fprintf(f, "# route_data_file %s/ibacm_route.data\n", ACM_CONF_DIR);
 	fprintf(f, "\n");
@@ -912,6 +957,12 @@ static int query_perf_one(char *svc, int index)
 			printf("%s : ", ib_acm_cntr_name(i));
 			printf("%llu\n", (unsigned long long) counters[i]);
 		}
+		if (cnt > ACM_CNTR_DEST_MISS &&
+		    counters[ACM_CNTR_DEST_HIT] + counters[ACM_CNTR_DEST_MISS])
+			printf("Dest Cache Hit Rate : %.1f%%\n",
+			       100.0 * counters[ACM_CNTR_DEST_HIT] /
+			       (counters[ACM_CNTR_DEST_HIT] +
+				counters[ACM_CNTR_DEST_MISS]));
 	}
 	ib_acm_free_perf(counters);
 
@@ -975,6 +1026,124 @@ static void enumerate_eps(char *svc)
 	}
 }
 
+/* Upper bound, in microseconds, of the bucket holding percentile pct */
+static uint64_t stats_percentile(struct acm_stats_data *stats, int pct)
+{
+	uint64_t rank, sum = 0;
+	int i;
+
+	if (!stats->count)
+		return 0;
+
+	rank = (stats->count * pct + 99) / 100;
+	for (i = 0; i < ACM_STAT_BUCKETS - 1; i++) {
+		sum += stats->bucket[i];
+		if (sum >= rank)
+			return min_t(uint64_t, 1ULL << i, stats->max_us);
+	}
+	return stats->max_us;
+}
+
+static void print_latency(char *svc, int index,
+			  struct acm_ep_config_data *ep_data)
+{
+	static int labels;
+	struct acm_stats_data stats;
+	int op, i;
+
+	if (!labels) {
+		printf("svc,guid,port,pkey,ep_index,op,count,avg_us,max_us,"
+		       "p50_us,p99_us,lt_1us");
+		for (i = 1; i < ACM_STAT_BUCKETS - 1; i++)
+			printf(",lt_%lluus", 1ULL << i);
+		printf(",ge_%lluus\n", 1ULL << (ACM_STAT_BUCKETS - 2));
+		labels = 1;
+	}
+
+	for (op = 0; op < ACM_MAX_STAT; op++) {
+		if (ib_acm_query_stats(index, ep_data->port_num, op, &stats))
+			return;
+
+		printf("%s,0x%016" PRIx64 ",%d,0x%04x,%d,%s,%" PRIu64 ",%" PRIu64
+		       ",%" PRIu64 ",%" PRIu64 ",%" PRIu64, svc,
+		       ep_data->dev_guid, ep_data->port_num, ep_data->pkey,
+		       index, ib_acm_stat_name(op), stats.count,
+		       stats.count ? stats.total_us / stats.count : 0,
+		       stats.max_us, stats_percentile(&stats, 50),
+		       stats_percentile(&stats, 99));
+		for (i = 0; i < ACM_STAT_BUCKETS; i++)
+			printf(",%" PRIu64, stats.bucket[i]);
+		printf("\n");
+	}
+}
+
+static void print_queues(char *svc, int index,
+			 struct acm_ep_config_data *ep_data)
+{
+	static int labels;
+	struct acm_stats_data stats;
+	int i;
+
+	if (!labels) {
+		printf("svc,guid,port,pkey,ep_index");
+		for (i = 0; i < ACM_MAX_GAUGE; i++)
+			printf(",%s", ib_acm_gauge_name(i));
+		printf("\n");
+		labels = 1;
+	}
+
+	if (ib_acm_query_stats(index, ep_data->port_num, 0, &stats))
+		return;
+
+	printf("%s,0x%016" PRIx64 ",%d,0x%04x,%d", svc, ep_data->dev_guid,
+	       ep_data->port_num, ep_data->pkey, index);
+	for (i = 0; i < ACM_MAX_GAUGE; i++)
+		printf(",%" PRIu64, stats.gauge[i]);
+	printf("\n");
+}
+
+static int query_stats_ep(char *svc, int index,
+			  void (*print)(char *svc, int index,
+					struct acm_ep_config_data *ep_data))
+{
+	struct acm_ep_config_data *ep_data;
+	int phys_port_cnt = 255;
+	int found = 0;
+	int port;
+
+	for (port = 1; port <= phys_port_cnt; ++port) {
+		if (ib_acm_enum_ep(index, &ep_data, port))
+			continue;
+
+		found = 1;
+		print(svc, index, ep_data);
+		phys_port_cnt = ep_data->phys_port_cnt;
+		ib_acm_free_ep_data(ep_data);
+	}
+
+	return !found;
+}
+
+/* Latencies of all endpoints first, then their queue depths */
+static void query_stats(char *svc)
+{
+	int index;
+
+	if (ep_index > 0) {
+		if (query_stats_ep(svc, ep_index, print_latency))
+			printf(" Endpoint %d is not available\n", ep_index);
+		else
+			query_stats_ep(svc, ep_index, print_queues);
+	} else {
+		for (index = 1; !query_stats_ep(svc, index, print_latency);
+		     index++)
+			;
+		for (index = 1; !query_stats_ep(svc, index, print_queues);
+		     index++)
+			;
+	}
+}
+
 static int query_svcs(void)
 {
 	char **svc_list;
@@ -1003,6 +1172,9 @@ static int query_svcs(void)
 		if (enum_ep)
 			enumerate_eps(svc_list[i]);
 
+		if (stats_query)
+			query_stats(svc_list[i]);
+
 		ib_acm_disconnect();
 	}
 
@@ -1044,7 +1216,7 @@ int main(int argc, char **argv)
 	int make_addr = 0;
 	int make_opts = 0;
 
-	while ((op = getopt(argc, argv, "e::f:s:d:vcA::O::D:P::S:C:V")) != -1) {
+	while ((op = getopt(argc, argv, "e::f:s:d:vcA::O::D:P::L::S:C:V")) != -1) {
 		switch (op) {
 		case 'e':
 			enum_ep = 1;
@@ -1088,6 +1260,11 @@ int main(int argc, char **argv)
 			else
 				perf_query = PERF_QUERY_ROW;
 			break;
+		case 'L':
+			stats_query = 1;
+			if (opt_arg(argc, argv))
+				ep_index = atoi(opt_arg(argc, argv));
+			break;
 		case 'S':
 			svc_arg = optarg;
 			break;
@@ -1107,10 +1284,10 @@ int main(int argc, char **argv)
 	if ((src_arg && (!dest_arg && perf_query != PERF_QUERY_EP_ADDR)) ||
 	    (perf_query == PERF_QUERY_EP_ADDR && !src_arg) ||
 	    (!src_arg && !dest_arg && !perf_query && !make_addr && !make_opts &&
-	     !enum_ep))
+	     !enum_ep && !stats_query))
 		goto show_use;
 
-	if (dest_arg || perf_query || enum_ep)
+	if (dest_arg || perf_query || enum_ep || stats_query)
 		ret = query_svcs();
 
 	if (!ret && make_addr)
@@ -513,6 +513,83 @@ out:
 	return ret;
 }
 
+int ib_acm_query_stats(int index, uint8_t port, int op,
+		       struct acm_stats_data *stats)
+{
+	struct acm_msg msg;
+	int ret, i;
+
+	pthread_mutex_lock(&acm_lock);
+	memset(&msg, 0, sizeof msg);
+	msg.hdr.version = ACM_VERSION;
+	msg.hdr.opcode = ACM_OP_STATS_QUERY;
+	msg.hdr.src_out = index;
+	msg.hdr.src_index = port;
+	msg.hdr.dst_index = op;
+	msg.hdr.length = htobe16(ACM_MSG_HDR_LENGTH);
+
+	ret = send(sock, (char *) &msg, ACM_MSG_HDR_LENGTH, 0);
+	if (ret != ACM_MSG_HDR_LENGTH)
+		goto out;
+
+	ret = recv(sock, (char *) &msg, sizeof msg, 0);
+	if (ret < ACM_MSG_HDR_LENGTH || ret != be16toh(msg.hdr.length)) {
+		ret = ACM_STATUS_EINVAL;
+		goto out;
+	}
+
+	if (msg.hdr.status) {
+		ret = acm_error(msg.hdr.status);
+		goto out;
+	}
+
+	if (ret != ACM_MSG_HDR_LENGTH + sizeof(*stats)) {
+		ret = ACM_STATUS_EINVAL;
+		goto out;
+	}
+
+	*stats = msg.stats_data[0];
+	stats->count = be64toh(stats->count);
+	stats->total_us = be64toh(stats->total_us);
+	stats->max_us = be64toh(stats->max_us);
+	for (i = 0; i < ACM_MAX_GAUGE; i++)
+		stats->gauge[i] = be64toh(stats->gauge[i]);
+	for (i = 0; i < ACM_STAT_BUCKETS; i++)
+		stats->bucket[i] = be64toh(stats->bucket[i]);
+	ret = 0;
+out:
+	pthread_mutex_unlock(&acm_lock);
+	return ret;
+}
+
+const char *ib_acm_stat_name(int op)
+{
+	static const char *const stat_name[] = {
+		[ACM_STAT_RESOLVE_ADDR]	= "resolve_addr",
+		[ACM_STAT_RESOLVE_PATH]	= "resolve_path",
+		[ACM_STAT_SA_QUERY]	= "sa_query",
+		[ACM_STAT_MC_JOIN]	= "mc_join",
+	};
+
+	if (op < 0 || op >= ACM_MAX_STAT)
+		return "Unknown";
+	return stat_name[op];
+}
+
+const char *ib_acm_gauge_name(int index)
+{
+	static const char *const gauge_name[] = {
+		[ACM_GAUGE_DEST]	 = "dest",
+		[ACM_GAUGE_QUEUED_REQ]	 = "queued_req",
+		[ACM_GAUGE_SEND_PENDING] = "send_pending",
+		[ACM_GAUGE_SEND_WAIT]	 = "send_wait",
+		[ACM_GAUGE_SA_QUERY]	 = "sa_query",
+	};
+
+	if (index < 0 || index >= ACM_MAX_GAUGE)
+		return "Unknown";
+	return gauge_name[index];
+}
 
 const char *ib_acm_cntr_name(int index)
 {
@@ -524,9 +601,14 @@ const char *ib_acm_cntr_name(int index)
 		[ACM_CNTR_ADDR_CACHE]	= "Addr Cache Count",
 		[ACM_CNTR_ROUTE_QUERY]	= "Route Query Count",
 		[ACM_CNTR_ROUTE_CACHE]	= "Route Cache Count",
+		[ACM_CNTR_DEST_HIT]	= "Dest Cache Hit",
+		[ACM_CNTR_DEST_MISS]	= "Dest Cache Miss",
+		[ACM_CNTR_DEST_NEGATIVE]	= "Dest Negative Hit",
+		[ACM_CNTR_DEST_EVICT]	= "Dest Cache Evict",
+		[ACM_CNTR_DEST_EXPIRE]	= "Dest Cache Expire",
 	};
 
-	if (index < ACM_CNTR_ERROR || index > ACM_MAX_COUNTER)
+	if (index < ACM_CNTR_ERROR || index >= ACM_MAX_COUNTER)
 		return "Unknown";
 
 	return cntr_name[index];
@@ -0,0 +1,203 @@
+/* GPLv2 or OpenIB.org BSD (MIT) See COPYING file */
+
+/*
+ * Load generator for the ibacm daemon.  Forks one process per client, since
+ * libacm keeps a single connection per process, connects them all before any
+ * traffic starts and then issues resolve requests as fast as the daemon
+ * answers.  Reports the aggregate request rate and latency.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "libacm.h"
+
+struct load_result {
+	unsigned long	done;
+	unsigned long	failed;
+	double		total_ns;
+	double		max_ns;
+};
+
+static char *dest_svc;
+static struct sockaddr_storage src_addr, dst_addr;
+static int have_src;
+static unsigned long requests = 1000;
+static int clients = 16;
+static uint32_t flags;
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int get_addr(const char *name, struct sockaddr_storage *addr)
+{
+	struct addrinfo hint = { .ai_flags = AI_NUMERICHOST }, *res;
+	int ret;
+
+	ret = getaddrinfo(name, NULL, &hint, &res);
+	if (ret) {
+		fprintf(stderr, "%s: %s\n", name, gai_strerror(ret));
+		return -1;
+	}
+
+	memcpy(addr, res->ai_addr, res->ai_addrlen);
+	freeaddrinfo(res);
+	return 0;
+}
+
+static void run_client(int go_fd, int result_fd)
+{
+	struct load_result result = {};
+	struct ibv_path_data *paths;
+	unsigned long i;
+	double start, ns;
+	int count;
+	char c;
+
+	if (ib_acm_connect(dest_svc)) {
+		perror("ib_acm_connect");
+		exit(1);
+	}
+
+	/* Wait until every client holds its connection */
+	if (read(go_fd, &c, 1) < 0)
+		exit(1);
+
+	for (i = 0; i < requests; i++) {
+		start = now_ns();
+		if (ib_acm_resolve_ip(have_src ? (struct sockaddr *)&src_addr :
+				      NULL, (struct sockaddr *)&dst_addr,
+				      &paths, &count, flags, 0)) {
+			result.failed++;
+			continue;
+		}
+		ns = now_ns() - start;
+		ib_acm_free_paths(paths);
+
+		result.done++;
+		result.total_ns += ns;
+		if (ns > result.max_ns)
+			result.max_ns = ns;
+	}
+
+	ib_acm_disconnect();
+	if (write(result_fd, &result, sizeof(result)) != sizeof(result))
+		exit(1);
+	exit(0);
+}
+
+static void show_usage(char *program)
+{
+	printf("usage: %s -d dest_addr [options]\n", program);
+	printf("   -d dest_addr     - destination IP address to resolve\n");
+	printf("   [-s src_addr]    - source IP address\n");
+	printf("   [-S svc_addr]    - ibacm server address or unix socket path\n");
+	printf("   [-c clients]     - number of concurrent connections (default 16)\n");
+	printf("   [-n requests]    - requests per connection (default 1000)\n");
+	printf("   [-N]             - do not wait for uncached paths (ACM_FLAGS_NODELAY)\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct load_result result, total = {};
+	int go[2], res[2];
+	int i, op, started = 0, reported = 0;
+	double start, elapsed;
+	pid_t pid;
+
+	while ((op = getopt(argc, argv, "d:s:S:c:n:N")) != -1) {
+		switch (op) {
+		case 'd':
+			if (get_addr(optarg, &dst_addr))
+				exit(1);
+			break;
+		case 's':
+			if (get_addr(optarg, &src_addr))
+				exit(1);
+			have_src = 1;
+			break;
+		case 'S':
+			dest_svc = optarg;
+			break;
+		case 'c':
+			clients = atoi(optarg);
+			break;
+		case 'n':
+			requests = strtoul(optarg, NULL, 0);
+			break;
+		case 'N':
+			flags |= ACM_FLAGS_NODELAY;
+			break;
+		default:
+			show_usage(argv[0]);
+			exit(1);
+		}
+	}
+
+	if (!dst_addr.ss_family || clients <= 0) {
+		show_usage(argv[0]);
+		exit(1);
+	}
+
+	if (pipe(go) || pipe(res)) {
+		perror("pipe");
+		exit(1);
+	}
+
+	for (i = 0; i < clients; i++) {
+		pid = fork();
+		if (pid < 0) {
+			perror("fork");
+			break;
+		}
+		if (!pid) {
+			close(go[1]);
+			close(res[0]);
+			run_client(go[0], res[1]);
+		}
+		started++;
+	}
+
+	close(go[0]);
+	close(res[1]);
+
+	/* Give the clients time to connect, then release them all at once */
+	sleep(1);
+	start = now_ns();
+	close(go[1]);
+
+	while (read(res[0], &result, sizeof(result)) == sizeof(result)) {
+		reported++;
+		total.done += result.done;
+		total.failed += result.failed;
+		total.total_ns += result.total_ns;
+		if (result.max_ns > total.max_ns)
+			total.max_ns = result.max_ns;
+	}
+	elapsed = now_ns() - start;
+
+	for (i = 0; i < started; i++)
+		wait(NULL);
+
+	printf("clients %d, requests %lu, failed %lu\n", reported, total.done,
+	       total.failed);
+	if (total.done)
+		printf("%.0f requests/s, latency avg %.1f us max %.1f us\n",
+		       total.done * 1e9 / elapsed,
+		       total.total_ns / total.done / 1e3, total.max_ns / 1e3);
+
+	return total.failed || reported != clients;
+}
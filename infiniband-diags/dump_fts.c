@@ -48,18 +48,24 @@
 #include <infiniband/ibnetdisc.h>
 
 #include "ibdiag_common.h"
+#include "ibdiag_fdb.h"
 
 static struct ibmad_port *srcport;
 
 static unsigned startlid, endlid;
 
-static int brief, dump_all, multicast;
+static int brief, dump_all, multicast, format;
+
+/* same default as OpenSM's max_wire_smps */
+#define DEF_OUTSTANDING_SMPS	4
+/* switches whose tables are fetched concurrently */
+#define SWITCHES_IN_FLIGHT	16
+
+static unsigned outstanding_smps;
 
 static char *node_name_map_file = NULL;
 static nn_map_t *node_name_map = NULL;
 
-#define IB_MLIDS_IN_BLOCK	(IB_SMP_DATA_SIZE/2)
-
 static int dump_mlid(char *str, int strlen, unsigned mlid, unsigned nports,
 		     __be16 mft[16][IB_MLIDS_IN_BLOCK])
 {
@@ -103,25 +109,10 @@ static int dump_mlid(char *str, int strlen, unsigned mlid, unsigned nports,
 	return i * 2;
 }
 
-static __be16 mft[16][IB_MLIDS_IN_BLOCK];
-
-static void dump_multicast_tables(ibnd_node_t *node, unsigned startl,
-				  unsigned endl, struct ibmad_port *mad_port)
+static void setup_multicast_fdb(ibnd_node_t *node, unsigned startl,
+				unsigned endl, struct ibdiag_fdb *fdb)
 {
-	ib_portid_t *portid = &node->path_portid;
-	char nd[IB_SMP_DATA_SIZE] = { 0 };
-	char str[512];
-	char *s;
-	uint64_t nodeguid;
-	uint32_t mod;
-	unsigned block, i, j, e, nports, cap, chunks, startblock, lastblock,
-	    top;
-	char *mapnd = NULL;
-	int n = 0;
-
-	memcpy(nd, node->nodedesc, strlen(node->nodedesc));
-	nports = node->numports;
-	nodeguid = node->guid;
+	unsigned cap, top;
 
 	mad_decode_field(node->switchinfo, IB_SW_MCAST_FDB_CAP_F, &cap);
 	mad_decode_field(node->switchinfo, IB_SW_MCAST_FDB_TOP_F, &top);
@@ -149,6 +140,30 @@ static void dump_multicast_tables(ibnd_node_t *node, unsigned startl,
 		endl = IB_MAX_MCAST_LID;
 	}
 
+	fdb->start = startl;
+	fdb->end = endl;
+}
+
+static void dump_multicast_tables(ibnd_node_t *node, struct ibdiag_fdb *fdb)
+{
+	ib_portid_t *portid = &node->path_portid;
+	char nd[IB_SMP_DATA_SIZE] = { 0 };
+	char str[512];
+	char *s;
+	uint64_t nodeguid;
+	unsigned block, i, e, nports, cap, startblock, lastblock, top, mod;
+	unsigned startl = fdb->start, endl = fdb->end;
+	__be16 (*mft)[IB_MLIDS_IN_BLOCK];
+	char *mapnd = NULL;
+	int n = 0, status;
+
+	memcpy(nd, node->nodedesc, strlen(node->nodedesc));
+	nports = node->numports;
+	nodeguid = node->guid;
+
+	mad_decode_field(node->switchinfo, IB_SW_MCAST_FDB_CAP_F, &cap);
+	mad_decode_field(node->switchinfo, IB_SW_MCAST_FDB_TOP_F, &top);
+
 	mapnd = remap_node_name(node_name_map, nodeguid, nd);
 
 	printf("Multicast mlids [0x%x-0x%x] of switch %s guid 0x%016" PRIx64
@@ -175,31 +190,9 @@ static void dump_multicast_tables(ibnd_node_t *node, unsigned startl,
 		printf("Switch multicast mlid capability is %d top is 0x%x\n",
 		       cap, top);
 
-	chunks = ALIGN(nports + 1, 16) / 16;
-
 	startblock = startl / IB_MLIDS_IN_BLOCK;
 	lastblock = endl / IB_MLIDS_IN_BLOCK;
 	for (block = startblock; block <= lastblock; block++) {
-		for (j = 0; j < chunks; j++) {
-			int status;
-			mod = (block - IB_MIN_MCAST_LID / IB_MLIDS_IN_BLOCK)
-			    | (j << 28);
-
-			DEBUG("reading block %x chunk %d mod %x", block, j,
-			      mod);
-			if (!smp_query_status_via
-			    (mft + j, portid, IB_ATTR_MULTICASTFORWTBL, mod, 0,
-			     &status, mad_port)) {
-				fprintf(stderr, "SubnGet(MFT) failed on switch "
-						"'%s' %s Node GUID 0x%"PRIx64
-						" SMA LID %d; MAD status 0x%x "
-						"AM 0x%x\n",
-						mapnd, portid2str(portid),
-						node->guid, node->smalid,
-						status, mod);
-			}
-		}
-
 		i = block * IB_MLIDS_IN_BLOCK;
 		e = i + IB_MLIDS_IN_BLOCK;
 		if (i < startl)
@@ -207,6 +200,18 @@ static void dump_multicast_tables(ibnd_node_t *node, unsigned startl,
 		if (e > endl + 1)
 			e = endl + 1;
 
+		mft = ibdiag_fdb_block(fdb, i, &status, &mod);
+		if (!mft) {
+			fprintf(stderr, "SubnGet(MFT) failed on switch "
+					"'%s' %s Node GUID 0x%"PRIx64
+					" SMA LID %d; MAD status 0x%x "
+					"AM 0x%x\n",
+					mapnd, portid2str(portid),
+					node->guid, node->smalid,
+					status, mod);
+			continue;
+		}
+
 		for (; i < e; i++) {
 			if (dump_mlid(str, sizeof str, i, nports, mft) == 0)
 				continue;
@@ -296,60 +301,59 @@ static int dump_lid(char *str, int str_len, int lid, int valid,
 	return rc;
 }
 
-static void dump_unicast_tables(ibnd_node_t *node, int startl, int endl,
-				struct ibmad_port *mad_port,
+static void setup_unicast_fdb(ibnd_node_t *node, unsigned startl,
+			      unsigned endl, struct ibdiag_fdb *fdb)
+{
+	unsigned top;
+
+	mad_decode_field(node->switchinfo, IB_SW_LINEAR_FDB_TOP_F, &top);
+
+	if (!endl || endl > top)
+		endl = top;
+
+	if (endl > IB_MAX_UCAST_LID) {
+		IBWARN("illegal lft top %d, truncate to %d", endl,
+		       IB_MAX_UCAST_LID);
+		endl = IB_MAX_UCAST_LID;
+	}
+
+	DEBUG("Switch top is 0x%x\n", top);
+
+	fdb->start = startl;
+	fdb->end = endl;
+}
+
+static void dump_unicast_tables(ibnd_node_t *node, struct ibdiag_fdb *fdb,
 				ibnd_fabric_t *fabric)
 {
 	ib_portid_t * portid = &node->path_portid;
-	char lft[IB_SMP_DATA_SIZE] = { 0 };
+	uint8_t *lft;
 	char nd[IB_SMP_DATA_SIZE] = { 0 };
 	char str[200];
 	uint64_t nodeguid;
-	int block, i, e, top;
-	unsigned nports;
+	int block, i, e, status;
+	int startl = fdb->start, endl = fdb->end;
+	unsigned nports, mod;
 	int n = 0, startblock, endblock;
 	char *mapnd = NULL;
 	int last_port_lid = 0, base_port_lid = 0;
 	uint64_t portguid = 0;
 
-	mad_decode_field(node->switchinfo, IB_SW_LINEAR_FDB_TOP_F, &top);
 	nodeguid = node->guid;
 	nports = node->numports;
 	memcpy(nd, node->nodedesc, strlen(node->nodedesc));
 
-	if (!endl || endl > top)
-		endl = top;
-
-	if (endl > IB_MAX_UCAST_LID) {
-		IBWARN("illegal lft top %d, truncate to %d", endl,
-		       IB_MAX_UCAST_LID);
-		endl = IB_MAX_UCAST_LID;
-	}
-
 	mapnd = remap_node_name(node_name_map, nodeguid, nd);
 
 	printf("Unicast lids [0x%x-0x%x] of switch %s guid 0x%016" PRIx64
 	       " (%s):\n", startl, endl, portid2str(portid), nodeguid,
 	       mapnd);
 
-	DEBUG("Switch top is 0x%x\n", top);
-
 	printf("  Lid  Out   Destination\n");
 	printf("       Port     Info \n");
 	startblock = startl / IB_SMP_DATA_SIZE;
-	endblock = ALIGN(endl, IB_SMP_DATA_SIZE) / IB_SMP_DATA_SIZE;
-	for (block = startblock; block < endblock; block++) {
-		int status;
-		DEBUG("reading block %d", block);
-		if (!smp_query_status_via(lft, portid, IB_ATTR_LINEARFORWTBL, block,
-				   0, &status, mad_port)) {
-			fprintf(stderr, "SubnGet(LFT) failed on switch "
-					"'%s' %s Node GUID 0x%"PRIx64
-					" SMA LID %d; MAD status 0x%x AM 0x%x\n",
-					mapnd, portid2str(portid),
-					node->guid, node->smalid,
-					status, block);
-		}
+	endblock = endl / IB_SMP_DATA_SIZE;
+	for (block = startblock; block <= endblock; block++) {
 		i = block * IB_SMP_DATA_SIZE;
 		e = i + IB_SMP_DATA_SIZE;
 		if (i < startl)
@@ -357,6 +361,17 @@ static void dump_unicast_tables(ibnd_node_t *node, int startl, int endl,
 		if (e > endl + 1)
 			e = endl + 1;
 
+		lft = ibdiag_fdb_block(fdb, i, &status, &mod);
+		if (!lft) {
+			fprintf(stderr, "SubnGet(LFT) failed on switch "
+					"'%s' %s Node GUID 0x%"PRIx64
+					" SMA LID %d; MAD status 0x%x AM 0x%x\n",
+					mapnd, portid2str(portid),
+					node->guid, node->smalid,
+					status, mod);
+			continue;
+		}
+
 		for (; i < e; i++) {
 			unsigned outport = lft[i % IB_SMP_DATA_SIZE];
 			unsigned valid = (outport <= nports);
@@ -374,19 +389,91 @@ static void dump_unicast_tables(ibnd_node_t *node, int startl, int endl,
 	free(mapnd);
 }
 
-static void dump_node(ibnd_node_t *node, struct ibmad_port *mad_port,
-		      ibnd_fabric_t *fabric)
+static void fetch_node(ibnd_node_t *node, struct ibdiag_fdb *fdb)
 {
+	memset(fdb, 0, sizeof(*fdb));
+	fdb->portid = node->path_portid;
+	fdb->guid = node->guid;
+	fdb->nports = node->numports;
+	fdb->multicast = multicast;
+
 	if (multicast)
-		dump_multicast_tables(node, startlid, endlid, mad_port);
+		setup_multicast_fdb(node, startlid, endlid, fdb);
 	else
-		dump_unicast_tables(node, startlid, endlid,
-						mad_port, fabric);
+		setup_unicast_fdb(node, startlid, endlid, fdb);
+
+	if (ibdiag_fdb_fetch(srcport, fdb))
+		IBEXIT("out of memory");
 }
 
-static void process_switch(ibnd_node_t *node, void *fabric)
+static void dump_node(ibnd_node_t *node, struct ibdiag_fdb *fdb,
+		      ibnd_fabric_t *fabric)
 {
-	dump_node(node, srcport, (ibnd_fabric_t *)fabric);
+	char nd[IB_SMP_DATA_SIZE] = { 0 };
+	char *mapnd;
+
+	if (ibdiag_fdb_wait(srcport, fdb))
+		IBEXIT("SubnGet(%s) failed", multicast ? "MFT" : "LFT");
+
+	switch (format) {
+	case IBDIAG_FDB_JSON:
+		memcpy(nd, node->nodedesc, strlen(node->nodedesc));
+		mapnd = remap_node_name(node_name_map, node->guid, nd);
+		ibdiag_fdb_dump_json(stdout, fdb, mapnd, dump_all);
+		free(mapnd);
+		break;
+	case IBDIAG_FDB_BINARY:
+		ibdiag_fdb_dump_binary(stdout, fdb);
+		break;
+	default:
+		if (multicast)
+			dump_multicast_tables(node, fdb);
+		else
+			dump_unicast_tables(node, fdb, fabric);
+	}
+	ibdiag_fdb_free(fdb);
+}
+
+struct switch_list {
+	ibnd_node_t **nodes;
+	unsigned num, max;
+};
+
+static void add_switch(ibnd_node_t *node, void *user_data)
+{
+	struct switch_list *list = user_data;
+
+	if (list->num == list->max) {
+		list->max = list->max ? list->max * 2 : 64;
+		list->nodes = realloc(list->nodes,
+				      list->max * sizeof(*list->nodes));
+		if (!list->nodes)
+			IBEXIT("out of memory");
+	}
+	list->nodes[list->num++] = node;
+}
+
+/*
+ * The tables of up to SWITCHES_IN_FLIGHT switches are fetched concurrently
+ * while they are printed in discovery order.
+ */
+static void dump_switches(ibnd_fabric_t *fabric)
+{
+	struct ibdiag_fdb fdbs[SWITCHES_IN_FLIGHT];
+	struct switch_list list = { 0 };
+	unsigned i, next = 0;
+
+	ibnd_iter_nodes_type(fabric, add_switch, IB_NODE_SWITCH, &list);
+
+	for (i = 0; i < list.num; i++) {
+		for (; next < list.num && next < i + SWITCHES_IN_FLIGHT; next++)
+			fetch_node(list.nodes[next],
+				   &fdbs[next % SWITCHES_IN_FLIGHT]);
+		dump_node(list.nodes[i], &fdbs[i % SWITCHES_IN_FLIGHT],
+			  fabric);
+	}
+
+	free(list.nodes);
 }
 
 static int process_opt(void *context, int ch)
@@ -406,6 +493,13 @@ static int process_opt(void *context, int ch)
 		if (node_name_map_file == NULL)
 			IBEXIT("out of memory, strdup for node_name_map_file name failed");
 		break;
+	case 2:
+		if ((format = ibdiag_fdb_parse_format(optarg)) < 0)
+			IBEXIT("unknown format '%s'", optarg);
+		break;
+	case 'o':
+		outstanding_smps = strtoul(optarg, NULL, 0);
+		break;
 	default:
 		return -1;
 	}
@@ -427,6 +521,11 @@ int main(int argc, char **argv)
 		 "do not try to resolve destinations"},
 		{"Multicast", 'M', 0, NULL, "show multicast forwarding tables"},
 		{"node-name-map", 1, 1, "<file>", "node name map file"},
+		{"outstanding_smps", 'o', 1, NULL,
+		 "specify the number of outstanding SMP's which should be "
+		 "issued during the scan and the dump"},
+		{"format", 2, 1, "<json|binary>",
+		 "dump the tables as JSON lines or in binary"},
 		{}
 	};
 	char usage_args[] = "[<dest dr_path|lid|guid> [<startlid> [<endlid>]]]";
@@ -440,6 +539,9 @@ int main(int argc, char **argv)
 		"-M\t# dump all non empty mlids of switch with lid 4",
 		"-M 0xc010 0xc020\t# same, but with range",
 		"-M -n\t# simple dump format",
+		" -- Machine readable output:",
+		"--format json\t# one JSON object per switch",
+		"--format binary > fts.bin\t# binary records, see dump_fts(8)",
 		NULL,
 	};
 
@@ -461,6 +563,7 @@ int main(int argc, char **argv)
 
 	config.flags = ibd_ibnetdisc_flags;
 	config.mkey = ibd_mkey;
+	config.max_smps = outstanding_smps;
 
 	if ((fabric = ibnd_discover_fabric(ibd_ca, ibd_ca_port, NULL,
 						&config)) != NULL) {
@@ -478,7 +581,12 @@ int main(int argc, char **argv)
 			mad_rpc_set_timeout(srcport, ibd_timeout);
 		}
 
-		ibnd_iter_nodes_type(fabric, process_switch, IB_NODE_SWITCH, fabric);
+		if (mad_rpc_async_set_window(srcport, outstanding_smps ?
+					     outstanding_smps :
+					     DEF_OUTSTANDING_SMPS) < 0)
+			IBEXIT("can't set the number of outstanding SMPs");
+
+		dump_switches(fabric);
 
 		mad_rpc_close_port(srcport);
 
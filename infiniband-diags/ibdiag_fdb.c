@@ -0,0 +1,289 @@
+/* GPLv2 or OpenIB.org BSD (MIT) See COPYING file */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <endian.h>
+
+#include <infiniband/mad.h>
+
+#include "ibdiag_common.h"
+#include "ibdiag_fdb.h"
+
+static void fdb_done(struct ibmad_port *port, ib_rpc_t *rpc, void *data,
+		     int status, void *context)
+{
+	struct ibdiag_fdb *fdb = context;
+
+	if (status) {
+		DEBUG("SubnGet(%s) AM 0x%x on %s failed; %s",
+		      fdb->multicast ? "MFT" : "LFT", rpc->attr.mod,
+		      portid2str(&fdb->portid), strerror(status));
+		fdb->failed[rpc - fdb->rpcs] = 1;
+	}
+	fdb->pending--;
+}
+
+int ibdiag_fdb_fetch(struct ibmad_port *srcport, struct ibdiag_fdb *fdb)
+{
+	unsigned i, n, block, lastblock, chunk;
+	ib_rpc_t *rpc;
+	int mgtclass;
+
+	if (fdb->multicast) {
+		fdb->chunks = ALIGN(fdb->nports + 1, 16) / 16;
+		fdb->startblock = fdb->start / IB_MLIDS_IN_BLOCK;
+		lastblock = fdb->end / IB_MLIDS_IN_BLOCK;
+	} else {
+		fdb->chunks = 1;
+		fdb->startblock = fdb->start / IB_SMP_DATA_SIZE;
+		lastblock = fdb->end / IB_SMP_DATA_SIZE;
+	}
+	fdb->nblocks = lastblock >= fdb->startblock ?
+		       lastblock - fdb->startblock + 1 : 0;
+
+	n = fdb->nblocks * fdb->chunks;
+	fdb->data = calloc(n, IB_SMP_DATA_SIZE);
+	fdb->failed = calloc(n, sizeof(*fdb->failed));
+	fdb->rpcs = calloc(n, sizeof(*fdb->rpcs));
+	if (n && (!fdb->data || !fdb->failed || !fdb->rpcs)) {
+		ibdiag_fdb_free(fdb);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	/* same addressing as smp_query_via() */
+	if ((fdb->portid.lid <= 0) ||
+	    (fdb->portid.drpath.drslid == 0xffff) ||
+	    (fdb->portid.drpath.drdlid == 0xffff))
+		mgtclass = IB_SMI_DIRECT_CLASS;
+	else
+		mgtclass = IB_SMI_CLASS;
+	fdb->portid.sl = 0;
+	fdb->portid.qp = 0;
+
+	fdb->pending = 0;
+	for (i = 0; i < n; i++) {
+		block = fdb->startblock + i / fdb->chunks;
+		chunk = i % fdb->chunks;
+
+		rpc = &fdb->rpcs[i];
+		rpc->mgtclass = mgtclass;
+		rpc->method = IB_MAD_METHOD_GET;
+		rpc->datasz = IB_SMP_DATA_SIZE;
+		rpc->dataoffs = IB_SMP_DATA_OFFS;
+		rpc->mkey = smp_mkey_get(srcport);
+		if (fdb->multicast) {
+			rpc->attr.id = IB_ATTR_MULTICASTFORWTBL;
+			rpc->attr.mod = (block - IB_MIN_MCAST_LID /
+					 IB_MLIDS_IN_BLOCK) | (chunk << 28);
+		} else {
+			rpc->attr.id = IB_ATTR_LINEARFORWTBL;
+			rpc->attr.mod = block;
+		}
+
+		DEBUG("reading block %x chunk %d mod %x", block, chunk,
+		      rpc->attr.mod);
+		if (mad_rpc_async_submit(srcport, rpc, &fdb->portid, NULL,
+					 fdb->data + i * IB_SMP_DATA_SIZE, 0,
+					 fdb_done, fdb) < 0) {
+			fdb->failed[i] = 1;
+			continue;
+		}
+		fdb->pending++;
+	}
+	return 0;
+}
+
+int ibdiag_fdb_wait(struct ibmad_port *srcport, struct ibdiag_fdb *fdb)
+{
+	while (fdb->pending)
+		if (mad_rpc_async_poll(srcport, -1) < 0)
+			return -1;
+	return 0;
+}
+
+void ibdiag_fdb_free(struct ibdiag_fdb *fdb)
+{
+	free(fdb->data);
+	free(fdb->failed);
+	free(fdb->rpcs);
+	fdb->data = NULL;
+	fdb->failed = NULL;
+	fdb->rpcs = NULL;
+}
+
+void *ibdiag_fdb_block(struct ibdiag_fdb *fdb, unsigned lid, int *rstatus,
+		       unsigned *mod)
+{
+	unsigned i, block, first;
+
+	block = lid / (fdb->multicast ? IB_MLIDS_IN_BLOCK : IB_SMP_DATA_SIZE);
+	*rstatus = 0;
+	*mod = block;
+	if (block < fdb->startblock || block >= fdb->startblock + fdb->nblocks)
+		return NULL;
+
+	first = (block - fdb->startblock) * fdb->chunks;
+
+	for (i = first; i < first + fdb->chunks; i++) {
+		if (fdb->failed[i]) {
+			*rstatus = fdb->rpcs[i].rstatus;
+			*mod = fdb->rpcs[i].attr.mod;
+			return NULL;
+		}
+	}
+	return fdb->data + first * IB_SMP_DATA_SIZE;
+}
+
+int ibdiag_fdb_parse_format(const char *str)
+{
+	if (!strcmp(str, "json"))
+		return IBDIAG_FDB_JSON;
+	if (!strcmp(str, "binary"))
+		return IBDIAG_FDB_BINARY;
+	return -1;
+}
+
+static void json_string(FILE *f, const char *s)
+{
+	fputc('"', f);
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			fprintf(f, "\\%c", *s);
+		else if ((unsigned char)*s < 0x20)
+			fprintf(f, "\\u%04x", *s);
+		else
+			fputc(*s, f);
+	}
+	fputc('"', f);
+}
+
+static uint16_t mft_mask(void *block, unsigned mlid, unsigned chunk)
+{
+	__be16 (*mft)[IB_MLIDS_IN_BLOCK] = block;
+
+	return be16toh(mft[chunk][mlid % IB_MLIDS_IN_BLOCK]);
+}
+
+/*
+ * One JSON object per switch and line.  LFT entries are listed for every
+ * lid of the range, null where the block could not be read.  MFT entries
+ * list the member ports of each mlid, empty mlids only with dump_all.
+ */
+void ibdiag_fdb_dump_json(FILE *f, struct ibdiag_fdb *fdb, const char *name,
+			  int dump_all)
+{
+	unsigned lid, chunk, bit, mod, n = 0;
+	uint8_t *block;
+	int rstatus;
+
+	fprintf(f, "{\"guid\":\"0x%016" PRIx64 "\",\"lid\":%u,\"name\":",
+		fdb->guid, fdb->portid.lid);
+	json_string(f, name);
+	fprintf(f, ",\"nports\":%u,\"table\":\"%s\",\"start\":%u,\"end\":%u,",
+		fdb->nports, fdb->multicast ? "mft" : "lft", fdb->start,
+		fdb->end);
+
+	if (!fdb->multicast) {
+		fprintf(f, "\"ports\":[");
+		for (lid = fdb->start; lid <= fdb->end; lid++) {
+			block = ibdiag_fdb_block(fdb, lid, &rstatus, &mod);
+			fprintf(f, lid == fdb->start ? "" : ",");
+			if (block)
+				fprintf(f, "%u", block[lid % IB_SMP_DATA_SIZE]);
+			else
+				fprintf(f, "null");
+		}
+		fprintf(f, "]}\n");
+		return;
+	}
+
+	fprintf(f, "\"mlids\":[");
+	for (lid = fdb->start; lid <= fdb->end; lid++) {
+		unsigned members = 0;
+
+		block = ibdiag_fdb_block(fdb, lid, &rstatus, &mod);
+		if (!block)
+			continue;
+		for (chunk = 0; chunk < fdb->chunks; chunk++)
+			if (mft_mask(block, lid, chunk))
+				members++;
+		if (!members && !dump_all)
+			continue;
+
+		fprintf(f, "%s{\"mlid\":%u,\"ports\":[", n++ ? "," : "", lid);
+		members = 0;
+		for (bit = 0; bit <= fdb->nports; bit++)
+			if (mft_mask(block, lid, bit / 16) & (1 << (bit % 16)))
+				fprintf(f, "%s%u", members++ ? "," : "", bit);
+		fprintf(f, "]}");
+	}
+	fprintf(f, "]}\n");
+}
+
+/*
+ * Binary dump, one record per switch, all fields big endian:
+ *
+ *   0  magic "IBFT"
+ *   4  be16 version (1)
+ *   6  u8   table (0 LFT, 1 MFT)
+ *   7  u8   number of ports
+ *   8  be64 node guid
+ *  16  be16 lid the switch was queried at, 0 if directed route only
+ *  18  be16 first lid
+ *  20  be16 last lid
+ *  22  be16 MFT port mask words per mlid, 0 for LFT
+ *
+ * followed for the LFT by one output port byte per lid (0xff where the
+ * block could not be read) and for the MFT by the port mask words of each
+ * mlid, ports 0-15 first (0 where the block could not be read).
+ */
+struct fdb_bin_hdr {
+	char magic[4];
+	__be16 version;
+	uint8_t table;
+	uint8_t nports;
+	__be64 guid;
+	__be16 lid;
+	__be16 start;
+	__be16 end;
+	__be16 chunks;
+} __attribute__((packed));
+
+void ibdiag_fdb_dump_binary(FILE *f, struct ibdiag_fdb *fdb)
+{
+	struct fdb_bin_hdr hdr = {
+		.magic = "IBFT",
+		.version = htobe16(1),
+		.table = fdb->multicast,
+		.nports = fdb->nports,
+		.guid = htobe64(fdb->guid),
+		.lid = htobe16(fdb->portid.lid),
+		.start = htobe16(fdb->start),
+		.end = htobe16(fdb->end),
+		.chunks = htobe16(fdb->multicast ? fdb->chunks : 0),
+	};
+	unsigned lid, chunk, mod;
+	uint8_t *block;
+	__be16 mask;
+	int rstatus;
+
+	fwrite(&hdr, sizeof(hdr), 1, f);
+
+	for (lid = fdb->start; lid <= fdb->end; lid++) {
+		block = ibdiag_fdb_block(fdb, lid, &rstatus, &mod);
+		if (!fdb->multicast) {
+			fputc(block ? block[lid % IB_SMP_DATA_SIZE] : 0xff, f);
+			continue;
+		}
+		for (chunk = 0; chunk < fdb->chunks; chunk++) {
+			mask = htobe16(block ? mft_mask(block, lid, chunk) : 0);
+			fwrite(&mask, sizeof(mask), 1, f);
+		}
+	}
+}
@@ -0,0 +1,60 @@
+/* GPLv2 or OpenIB.org BSD (MIT) See COPYING file */
+
+#ifndef _IBDIAG_FDB_H_
+#define _IBDIAG_FDB_H_
+
+#include <stdio.h>
+#include <infiniband/mad.h>
+
+#define IB_MLIDS_IN_BLOCK	(IB_SMP_DATA_SIZE/2)
+
+/*
+ * Pipelined LinearForwardingTable/MulticastForwardingTable fetch.
+ *
+ * The caller fills in the switch and the lid (or mlid) range,
+ * ibdiag_fdb_fetch() submits a SubnGet() for every block (and, for the MFT,
+ * every port mask chunk) through the asynchronous libibmad API and
+ * ibdiag_fdb_wait() collects them.  Several switches can be in flight at the
+ * same time; the number of SMPs on the wire is bounded by the srcport
+ * window, see mad_rpc_async_set_window().
+ */
+struct ibdiag_fdb {
+	/* filled in by the caller */
+	ib_portid_t portid;
+	uint64_t guid;
+	unsigned nports;
+	int multicast;
+	unsigned start, end;
+
+	/* private */
+	unsigned startblock, nblocks, chunks;
+	uint8_t *data;
+	uint8_t *failed;
+	ib_rpc_t *rpcs;
+	unsigned pending;
+};
+
+enum ibdiag_fdb_format {
+	IBDIAG_FDB_TEXT,
+	IBDIAG_FDB_JSON,
+	IBDIAG_FDB_BINARY,
+};
+
+int ibdiag_fdb_fetch(struct ibmad_port *srcport, struct ibdiag_fdb *fdb);
+int ibdiag_fdb_wait(struct ibmad_port *srcport, struct ibdiag_fdb *fdb);
+void ibdiag_fdb_free(struct ibdiag_fdb *fdb);
+
+/*
+ * The LFT block holding lid, or the MFT port mask chunks holding mlid as a
+ * __be16 [chunks][IB_MLIDS_IN_BLOCK] array.  NULL if a query for the block
+ * failed, in which case *rstatus and *mod describe the failure.
+ */
+void *ibdiag_fdb_block(struct ibdiag_fdb *fdb, unsigned lid, int *rstatus,
+		       unsigned *mod);
+
+int ibdiag_fdb_parse_format(const char *str);
+void ibdiag_fdb_dump_json(FILE *f, struct ibdiag_fdb *fdb, const char *name,
+			  int dump_all);
+void ibdiag_fdb_dump_binary(FILE *f, struct ibdiag_fdb *fdb);
+
+#endif /* _IBDIAG_FDB_H_ */
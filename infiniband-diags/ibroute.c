@@ -44,10 +44,16 @@
 #include <util/node_name_map.h>
 
 #include "ibdiag_common.h"
+#include "ibdiag_fdb.h"
 
 static struct ibmad_port *srcport;
 
-static int brief, dump_all, multicast;
+static int brief, dump_all, multicast, format;
+
+/* same default as OpenSM's max_wire_smps */
+#define DEF_OUTSTANDING_SMPS	4
+
+static unsigned outstanding_smps = DEF_OUTSTANDING_SMPS;
 
 static char *node_name_map_file = NULL;
 static nn_map_t *node_name_map = NULL;
@@ -83,8 +89,6 @@ static const char *check_switch(ib_portid_t *portid, unsigned int *nports,
 	return NULL;
 }
 
-#define IB_MLIDS_IN_BLOCK	(IB_SMP_DATA_SIZE/2)
-
 static int dump_mlid(char *str, int strlen, unsigned mlid, unsigned nports,
 		     __be16 mft[16][IB_MLIDS_IN_BLOCK])
 {
@@ -128,7 +132,39 @@ static int dump_mlid(char *str, int strlen, unsigned mlid, unsigned nports,
 	return i * 2;
 }
 
-static __be16 mft[16][IB_MLIDS_IN_BLOCK];
+/* Fetch all blocks of the table at once, returns NULL if one failed */
+static struct ibdiag_fdb *fetch_fdb(struct ibdiag_fdb *fdb, ib_portid_t *portid,
+				    uint64_t guid, unsigned nports,
+				    unsigned start, unsigned end)
+{
+	fdb->portid = *portid;
+	fdb->guid = guid;
+	fdb->nports = nports;
+	fdb->multicast = multicast;
+	fdb->start = start;
+	fdb->end = end;
+
+	if (ibdiag_fdb_fetch(srcport, fdb) || ibdiag_fdb_wait(srcport, fdb)) {
+		ibdiag_fdb_free(fdb);
+		return NULL;
+	}
+	return fdb;
+}
+
+/* JSON and binary output, returns 0 if the text dump is wanted */
+static int dump_fdb(struct ibdiag_fdb *fdb, const char *name)
+{
+	switch (format) {
+	case IBDIAG_FDB_JSON:
+		ibdiag_fdb_dump_json(stdout, fdb, name, dump_all);
+		return 1;
+	case IBDIAG_FDB_BINARY:
+		ibdiag_fdb_dump_binary(stdout, fdb);
+		return 1;
+	default:
+		return 0;
+	}
+}
 
 static const char *dump_multicast_tables(ib_portid_t *portid, unsigned startlid,
 					 unsigned endlid)
@@ -138,11 +174,12 @@ static const char *dump_multicast_tables(ib_portid_t *portid, unsigned startlid,
 	char str[512], *s;
 	const char *err;
 	uint64_t nodeguid;
-	uint32_t mod;
-	unsigned block, i, j, e, nports, cap, chunks, startblock, lastblock,
-	    top;
+	unsigned mod;
+	unsigned block, i, e, nports, cap, startblock, lastblock, top;
+	struct ibdiag_fdb fdb = { 0 };
+	__be16 (*mft)[IB_MLIDS_IN_BLOCK];
 	char *mapnd = NULL;
-	int n = 0;
+	int n = 0, status;
 
 	if ((err = check_switch(portid, &nports, &nodeguid, sw, nd)))
 		return err;
@@ -173,8 +210,14 @@ static const char *dump_multicast_tables(ib_portid_t *portid, unsigned startlid,
 		endlid = IB_MAX_MCAST_LID;
 	}
 
+	if (!fetch_fdb(&fdb, portid, nodeguid, nports, startlid, endlid))
+		return "reading the forwarding table failed";
+
 	mapnd = remap_node_name(node_name_map, nodeguid, nd);
 
+	if (dump_fdb(&fdb, mapnd))
+		goto out;
+
 	printf("Multicast mlids [0x%x-0x%x] of switch %s guid 0x%016" PRIx64
 	       " (%s):\n", startlid, endlid, portid2str(portid), nodeguid,
 	       mapnd);
@@ -199,29 +242,9 @@ static const char *dump_multicast_tables(ib_portid_t *portid, unsigned startlid,
 		printf("Switch multicast mlid capability is %d top is 0x%x\n",
 		       cap, top);
 
-	chunks = ALIGN(nports + 1, 16) / 16;
-
 	startblock = startlid / IB_MLIDS_IN_BLOCK;
 	lastblock = endlid / IB_MLIDS_IN_BLOCK;
 	for (block = startblock; block <= lastblock; block++) {
-		for (j = 0; j < chunks; j++) {
-			int status;
-			mod = (block - IB_MIN_MCAST_LID / IB_MLIDS_IN_BLOCK)
-			    | (j << 28);
-
-			DEBUG("reading block %x chunk %d mod %x", block, j,
-			      mod);
-			if (!smp_query_status_via
-			    (mft + j, portid, IB_ATTR_MULTICASTFORWTBL, mod, 0,
-			     &status, srcport)) {
-				fprintf(stderr, "SubnGet() failed"
-						"; MAD status 0x%x AM 0x%x\n",
-						status, mod);
-				free(mapnd);
-				return NULL;
-			}
-		}
-
 		i = block * IB_MLIDS_IN_BLOCK;
 		e = i + IB_MLIDS_IN_BLOCK;
 		if (i < startlid)
@@ -229,6 +252,14 @@ static const char *dump_multicast_tables(ib_portid_t *portid, unsigned startlid,
 		if (e > endlid + 1)
 			e = endlid + 1;
 
+		mft = ibdiag_fdb_block(&fdb, i, &status, &mod);
+		if (!mft) {
+			fprintf(stderr, "SubnGet() failed"
+					"; MAD status 0x%x AM 0x%x\n",
+					status, mod);
+			goto out;
+		}
+
 		for (; i < e; i++) {
 			if (dump_mlid(str, sizeof str, i, nports, mft) == 0)
 				continue;
@@ -239,6 +270,8 @@ static const char *dump_multicast_tables(ib_portid_t *portid, unsigned startlid,
 
 	printf("%d %smlids dumped \n", n, dump_all ? "" : "valid ");
 
+out:
+	ibdiag_fdb_free(&fdb);
 	free(mapnd);
 	return NULL;
 }
@@ -321,15 +354,16 @@ static int dump_lid(char *str, int strlen, int lid, int valid)
 static const char *dump_unicast_tables(ib_portid_t *portid, int startlid,
 				       int endlid)
 {
-	uint8_t lft[IB_SMP_DATA_SIZE] = { 0 };
+	uint8_t *lft;
 	char nd[IB_SMP_DATA_SIZE] = { 0 };
 	uint8_t sw[IB_SMP_DATA_SIZE] = { 0 };
 	char str[200];
 	const char *s;
 	uint64_t nodeguid;
-	int block, i, e, top;
-	unsigned nports;
+	int block, i, e, top, status;
+	unsigned nports, mod;
 	int n = 0, startblock, endblock;
+	struct ibdiag_fdb fdb = { 0 };
 	char *mapnd = NULL;
 
 	if ((s = check_switch(portid, &nports, &nodeguid, sw, nd)))
@@ -346,8 +380,14 @@ static const char *dump_unicast_tables(ib_portid_t *portid, int startlid,
 		endlid = IB_MAX_UCAST_LID;
 	}
 
+	if (!fetch_fdb(&fdb, portid, nodeguid, nports, startlid, endlid))
+		return "reading the forwarding table failed";
+
 	mapnd = remap_node_name(node_name_map, nodeguid, nd);
 
+	if (dump_fdb(&fdb, mapnd))
+		goto out;
+
 	printf("Unicast lids [0x%x-0x%x] of switch %s guid 0x%016" PRIx64
 	       " (%s):\n", startlid, endlid, portid2str(portid), nodeguid,
 	       mapnd);
@@ -357,18 +397,8 @@ static const char *dump_unicast_tables(ib_portid_t *portid, int startlid,
 	printf("  Lid  Out   Destination\n");
 	printf("       Port     Info \n");
 	startblock = startlid / IB_SMP_DATA_SIZE;
-	endblock = ALIGN(endlid, IB_SMP_DATA_SIZE) / IB_SMP_DATA_SIZE;
-	for (block = startblock; block < endblock; block++) {
-		int status;
-		DEBUG("reading block %d", block);
-		if (!smp_query_status_via(lft, portid, IB_ATTR_LINEARFORWTBL, block,
-				   0, &status, srcport)) {
-			fprintf(stderr, "SubnGet() failed"
-					"; MAD status 0x%x AM 0x%x\n",
-					status, block);
-			free(mapnd);
-			return NULL;
-		}
+	endblock = endlid / IB_SMP_DATA_SIZE;
+	for (block = startblock; block <= endblock; block++) {
 		i = block * IB_SMP_DATA_SIZE;
 		e = i + IB_SMP_DATA_SIZE;
 		if (i < startlid)
@@ -376,6 +406,14 @@ static const char *dump_unicast_tables(ib_portid_t *portid, int startlid,
 		if (e > endlid + 1)
 			e = endlid + 1;
 
+		lft = ibdiag_fdb_block(&fdb, i, &status, &mod);
+		if (!lft) {
+			fprintf(stderr, "SubnGet() failed"
+					"; MAD status 0x%x AM 0x%x\n",
+					status, mod);
+			goto out;
+		}
+
 		for (; i < e; i++) {
 			unsigned outport = lft[i % IB_SMP_DATA_SIZE];
 			unsigned valid = (outport <= nports);
@@ -389,6 +427,8 @@ static const char *dump_unicast_tables(ib_portid_t *portid, int startlid,
 	}
 
 	printf("%d %slids dumped \n", n, dump_all ? "" : "valid ");
+out:
+	ibdiag_fdb_free(&fdb);
 	free(mapnd);
 	return NULL;
 }
@@ -410,6 +450,13 @@ static int process_opt(void *context, int ch)
 		if (node_name_map_file == NULL)
 			IBEXIT("out of memory, strdup for node_name_map_file name failed");
 		break;
+	case 2:
+		if ((format = ibdiag_fdb_parse_format(optarg)) < 0)
+			IBEXIT("unknown format '%s'", optarg);
+		break;
+	case 'o':
+		outstanding_smps = strtoul(optarg, NULL, 0);
+		break;
 	default:
 		return -1;
 	}
@@ -430,6 +477,11 @@ int main(int argc, char **argv)
 		 "do not try to resolve destinations"},
 		{"Multicast", 'M', 0, NULL, "show multicast forwarding tables"},
 		{"node-name-map", 1, 1, "<file>", "node name map file"},
+		{"outstanding_smps", 'o', 1, NULL,
+		 "specify the number of outstanding SMP's which should be "
+		 "issued while reading the table"},
+		{"format", 2, 1, "<json|binary>",
+		 "dump the table as JSON or in binary"},
 		{}
 	};
 	char usage_args[] = "[<dest dr_path|lid|guid> [<startlid> [<endlid>]]]";
@@ -446,6 +498,8 @@ int main(int argc, char **argv)
 		"-M 4\t# dump all non empty mlids of switch with lid 4",
 		"-M 4 0xc010 0xc020\t# same, but with range",
 		"-M -n 4\t# simple dump format",
+		" -- Machine readable output:",
+		"--format json 4\t# the lft of switch with lid 4 as JSON",
 		NULL,
 	};
 
@@ -471,6 +525,9 @@ int main(int argc, char **argv)
 
 	smp_mkey_set(srcport, ibd_mkey);
 
+	if (mad_rpc_async_set_window(srcport, outstanding_smps) < 0)
+		IBEXIT("invalid number of outstanding SMPs");
+
 	if (resolve_portid_str(ibd_ca, ibd_ca_port, &portid, argv[0],
 			       ibd_dest_type, ibd_sm_id, srcport) < 0)
 		IBEXIT("can't resolve destination port %s", argv[0]);
@@ -37,10 +37,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <inttypes.h>
 #include <netinet/in.h>
 
 #include <infiniband/umad.h>
 #include <infiniband/mad.h>
+#include <ccan/array_size.h>
 
 #include "ibdiag_common.h"
 
@@ -479,7 +484,11 @@ static struct
 		slrcvfecn, slrcvbecn, xmitcc, vlxmittimecc;
 	int ports[MAX_PORTS];
 	int ports_count;
-} info;
+	unsigned interval_ms, sample_count, max_outstanding;
+	int sample_format, fabric;
+} info = {
+	.max_outstanding = 32,
+};
 
 static void common_func(ib_portid_t * portid, int port_num, int mask,
 			unsigned query, unsigned reset,
@@ -733,8 +742,591 @@ static void dump_portsamples_control(ib_portid_t *portid, int port)
 	       port, buf);
 }
 
+/*
+ * Continuous sampling mode
+ *
+ * Instead of a single query, the selected ports (or every linked port in
+ * the fabric) are polled every interval and the difference to the previous
+ * sample is reported as rates and deltas.  Only PortCounters or
+ * PortCountersExtended (with -x) are queried and all queries of one sweep
+ * are kept on the wire concurrently, up to the max_outstanding window.
+ */
+
+enum sample_format {
+	SAMPLE_FORMAT_JSON,
+	SAMPLE_FORMAT_PROM,
+};
+
+enum sample_kind {
+	SAMPLE_XMT_DATA,
+	SAMPLE_RCV_DATA,
+	SAMPLE_XMT_PKTS,
+	SAMPLE_RCV_PKTS,
+	SAMPLE_DELTA,
+};
+
+/* Counters only present if the PMA advertises them in ClassPortInfo */
+#define SAMPLE_CAP_EXT_WIDTH	(1 << 0)
+#define SAMPLE_CAP_ADDL_EXT	(1 << 1)
+#define SAMPLE_CAP_EXT_DATA	(1 << 2)
+
+struct sample_field {
+	enum MAD_FIELDS field;
+	unsigned width;
+	enum sample_kind kind;
+	unsigned cap;
+};
+
+static const struct sample_field sample_fields[] = {
+	{IB_PC_ERR_SYM_F, 16, SAMPLE_DELTA, 0},
+	{IB_PC_LINK_RECOVERS_F, 8, SAMPLE_DELTA, 0},
+	{IB_PC_LINK_DOWNED_F, 8, SAMPLE_DELTA, 0},
+	{IB_PC_ERR_RCV_F, 16, SAMPLE_DELTA, 0},
+	{IB_PC_ERR_PHYSRCV_F, 16, SAMPLE_DELTA, 0},
+	{IB_PC_ERR_SWITCH_REL_F, 16, SAMPLE_DELTA, 0},
+	{IB_PC_XMT_DISCARDS_F, 16, SAMPLE_DELTA, 0},
+	{IB_PC_ERR_XMTCONSTR_F, 8, SAMPLE_DELTA, 0},
+	{IB_PC_ERR_RCVCONSTR_F, 8, SAMPLE_DELTA, 0},
+	{IB_PC_ERR_LOCALINTEG_F, 4, SAMPLE_DELTA, 0},
+	{IB_PC_ERR_EXCESS_OVR_F, 4, SAMPLE_DELTA, 0},
+	{IB_PC_VL15_DROPPED_F, 16, SAMPLE_DELTA, 0},
+	{IB_PC_QP1_DROP_F, 16, SAMPLE_DELTA, 0},
+	{IB_PC_XMT_WAIT_F, 32, SAMPLE_DELTA, 0},
+	{IB_PC_XMT_BYTES_F, 32, SAMPLE_XMT_DATA, 0},
+	{IB_PC_RCV_BYTES_F, 32, SAMPLE_RCV_DATA, 0},
+	{IB_PC_XMT_PKTS_F, 32, SAMPLE_XMT_PKTS, 0},
+	{IB_PC_RCV_PKTS_F, 32, SAMPLE_RCV_PKTS, 0},
+};
+
+static const struct sample_field sample_fields_ext[] = {
+	{IB_PC_EXT_XMT_BYTES_F, 64, SAMPLE_XMT_DATA, SAMPLE_CAP_EXT_DATA},
+	{IB_PC_EXT_RCV_BYTES_F, 64, SAMPLE_RCV_DATA, SAMPLE_CAP_EXT_DATA},
+	{IB_PC_EXT_XMT_PKTS_F, 64, SAMPLE_XMT_PKTS, SAMPLE_CAP_EXT_DATA},
+	{IB_PC_EXT_RCV_PKTS_F, 64, SAMPLE_RCV_PKTS, SAMPLE_CAP_EXT_DATA},
+	{IB_PC_EXT_XMT_UPKTS_F, 64, SAMPLE_DELTA, SAMPLE_CAP_EXT_WIDTH},
+	{IB_PC_EXT_RCV_UPKTS_F, 64, SAMPLE_DELTA, SAMPLE_CAP_EXT_WIDTH},
+	{IB_PC_EXT_XMT_MPKTS_F, 64, SAMPLE_DELTA, SAMPLE_CAP_EXT_WIDTH},
+	{IB_PC_EXT_RCV_MPKTS_F, 64, SAMPLE_DELTA, SAMPLE_CAP_EXT_WIDTH},
+	{IB_PC_EXT_ERR_SYM_F, 64, SAMPLE_DELTA, SAMPLE_CAP_ADDL_EXT},
+	{IB_PC_EXT_LINK_RECOVERS_F, 64, SAMPLE_DELTA, SAMPLE_CAP_ADDL_EXT},
+	{IB_PC_EXT_LINK_DOWNED_F, 64, SAMPLE_DELTA, SAMPLE_CAP_ADDL_EXT},
+	{IB_PC_EXT_ERR_RCV_F, 64, SAMPLE_DELTA, SAMPLE_CAP_ADDL_EXT},
+	{IB_PC_EXT_ERR_PHYSRCV_F, 64, SAMPLE_DELTA, SAMPLE_CAP_ADDL_EXT},
+	{IB_PC_EXT_ERR_SWITCH_REL_F, 64, SAMPLE_DELTA, SAMPLE_CAP_ADDL_EXT},
+	{IB_PC_EXT_XMT_DISCARDS_F, 64, SAMPLE_DELTA, SAMPLE_CAP_ADDL_EXT},
+	{IB_PC_EXT_ERR_XMTCONSTR_F, 64, SAMPLE_DELTA, SAMPLE_CAP_ADDL_EXT},
+	{IB_PC_EXT_ERR_RCVCONSTR_F, 64, SAMPLE_DELTA, SAMPLE_CAP_ADDL_EXT},
+	{IB_PC_EXT_ERR_LOCALINTEG_F, 64, SAMPLE_DELTA, SAMPLE_CAP_ADDL_EXT},
+	{IB_PC_EXT_ERR_EXCESS_OVR_F, 64, SAMPLE_DELTA, SAMPLE_CAP_ADDL_EXT},
+	{IB_PC_EXT_VL15_DROPPED_F, 64, SAMPLE_DELTA, SAMPLE_CAP_ADDL_EXT},
+	{IB_PC_EXT_XMT_WAIT_F, 64, SAMPLE_DELTA, SAMPLE_CAP_ADDL_EXT},
+	{IB_PC_EXT_QP1_DROP_F, 64, SAMPLE_DELTA, SAMPLE_CAP_ADDL_EXT},
+};
+
+struct sample_target {
+	ib_rpc_t rpc;
+	uint8_t query[IB_PC_DATA_SZ];
+	uint8_t data[IB_PC_DATA_SZ];
+	ib_portid_t portid;
+	int port;
+	uint64_t guid;
+	unsigned caps;
+	int valid;		/* cur holds a sample from the last sweep */
+	int have_prev;
+	struct timespec prev_ts;
+	struct timespec cur_ts;
+	uint64_t *values;	/* backing store for prev and cur */
+	uint64_t *prev;
+	uint64_t *cur;
+};
+
+static struct {
+	const struct sample_field *fields;
+	unsigned num_fields;
+	unsigned attr;
+	struct sample_target *targets;
+	unsigned num_targets;
+	unsigned max_targets;
+} sampler;
+
+static unsigned sample_caps(__be16 cap_mask, uint32_t cap_mask2)
+{
+	unsigned caps = 0;
+
+	/*
+	 * 1.2 errata: bit 9 is extended counter support, bit 10 is extended
+	 * counter NoIETF, which has the data and packet counters only
+	 */
+	if (cap_mask & IB_PM_EXT_WIDTH_SUPPORTED)
+		caps |= SAMPLE_CAP_EXT_WIDTH | SAMPLE_CAP_EXT_DATA;
+	else if (cap_mask & IB_PM_EXT_WIDTH_NOIETF_SUP)
+		caps |= SAMPLE_CAP_EXT_DATA;
+	if (htonl(cap_mask2) & IB_PM_IS_ADDL_PORT_CTRS_EXT_SUP)
+		caps |= SAMPLE_CAP_ADDL_EXT;
+	return caps;
+}
+
+static void sample_add_target(ib_portid_t *portid, int port, uint64_t guid,
+			      unsigned caps)
+{
+	struct sample_target *t;
+
+	if (sampler.num_targets == sampler.max_targets) {
+		sampler.max_targets = sampler.max_targets ?
+				      sampler.max_targets * 2 : 64;
+		sampler.targets = realloc(sampler.targets,
+					  sampler.max_targets *
+					  sizeof(*sampler.targets));
+		if (!sampler.targets)
+			IBEXIT("out of memory");
+	}
+
+	t = &sampler.targets[sampler.num_targets++];
+	memset(t, 0, sizeof(*t));
+	t->portid = *portid;
+	t->portid.qp = 1;
+	if (!t->portid.qkey)
+		t->portid.qkey = IB_DEFAULT_QP1_QKEY;
+	t->port = port;
+	t->guid = guid;
+	t->caps = caps;
+	t->values = calloc(2 * sampler.num_fields, sizeof(*t->values));
+	if (!t->values)
+		IBEXIT("out of memory");
+	t->prev = t->values;
+	t->cur = t->values + sampler.num_fields;
+}
+
+static void sample_add_node(ibnd_node_t *node, void *user_data)
+{
+	ib_portid_t portid = { 0 };
+	ibnd_port_t *port;
+	int p;
+
+	for (p = 1; p <= node->numports; p++) {
+		port = node->ports[p];
+		/* Only ports with a link carry traffic worth sampling */
+		if (!port || !port->remoteport)
+			continue;
+		if (node->type == IB_NODE_SWITCH)
+			ib_portid_set(&portid, node->smalid, 0, 0);
+		else
+			ib_portid_set(&portid, port->base_lid, 0, 0);
+		sample_add_target(&portid, p, node->guid, 0);
+	}
+}
+
+static void sample_decode(struct sample_target *t, uint8_t *data,
+			  unsigned attr)
+{
+	uint32_t val;
+	uint64_t val64;
+	__be16 cap_mask;
+	__be32 cap_mask2_be;
+	unsigned i;
+
+	if (attr == CLASS_PORT_INFO) {
+		memcpy(&cap_mask, data + 2, sizeof(cap_mask));
+		memcpy(&cap_mask2_be, data + 4, sizeof(cap_mask2_be));
+		t->caps = sample_caps(cap_mask, ntohl(cap_mask2_be) >> 5);
+		return;
+	}
+
+	for (i = 0; i < sampler.num_fields; i++) {
+		if (sampler.fields[i].width == 64) {
+			mad_decode_field(data, sampler.fields[i].field, &val64);
+			t->cur[i] = val64;
+		} else {
+			mad_decode_field(data, sampler.fields[i].field, &val);
+			t->cur[i] = val;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t->cur_ts);
+	t->valid = 1;
+}
+
+static void sample_done(struct ibmad_port *port, ib_rpc_t *rpc,
+			void *data, int status, void *context)
+{
+	struct sample_target *t = context;
+
+	if (status == EIO)
+		IBWARN("%s port %d: attr 0x%x bad status 0x%x",
+		       portid2str(&t->portid), t->port, rpc->attr.id,
+		       rpc->rstatus);
+	else if (status)
+		IBWARN("%s port %d: attr 0x%x failed; %s",
+		       portid2str(&t->portid), t->port, rpc->attr.id,
+		       strerror(status));
+	else
+		sample_decode(t, data, rpc->attr.id);
+}
+
+static void sample_send(struct sample_target *t, unsigned attr)
+{
+	memset(&t->rpc, 0, sizeof(t->rpc));
+	t->rpc.mgtclass = IB_PERFORMANCE_CLASS;
+	t->rpc.method = IB_MAD_METHOD_GET;
+	t->rpc.attr.id = attr;
+	t->rpc.timeout = ibd_timeout;
+	t->rpc.datasz = IB_PC_DATA_SZ;
+	t->rpc.dataoffs = IB_PC_DATA_OFFS;
+
+	memset(t->query, 0, sizeof(t->query));
+	mad_set_field(t->query, 0, IB_PC_PORT_SELECT_F, t->port);
+
+	if (mad_rpc_async_submit(srcport, &t->rpc, &t->portid, t->query,
+				 t->data, 0, sample_done, t) < 0)
+		IBWARN("send to %s port %d failed; %s",
+		       portid2str(&t->portid), t->port, strerror(errno));
+}
+
+/*
+ * Query attr on all targets for which skip() is false.  libibmad keeps at
+ * most max_outstanding queries on the wire and queues the rest.
+ */
+static void sample_sweep(unsigned attr,
+			 int skip(struct sample_target *t, unsigned idx))
+{
+	unsigned i;
+
+	for (i = 0; i < sampler.num_targets; i++) {
+		sampler.targets[i].valid = 0;
+		if (skip && skip(&sampler.targets[i], i))
+			continue;
+		sample_send(&sampler.targets[i], attr);
+	}
+
+	while (mad_rpc_async_outstanding(srcport))
+		if (mad_rpc_async_poll(srcport, -1) < 0)
+			IBEXIT("sampling failed");
+}
+
+/* ClassPortInfo only needs to be read once per LID */
+static int sample_skip_same_lid(struct sample_target *t, unsigned idx)
+{
+	return idx && sampler.targets[idx - 1].portid.lid == t->portid.lid;
+}
+
+static void sample_query_caps(void)
+{
+	unsigned i;
+
+	sample_sweep(CLASS_PORT_INFO, sample_skip_same_lid);
+	for (i = 1; i < sampler.num_targets; i++)
+		if (sample_skip_same_lid(&sampler.targets[i], i))
+			sampler.targets[i].caps = sampler.targets[i - 1].caps;
+}
+
+/*
+ * IB counters stop at their maximum value instead of wrapping, so a value
+ * below the previous sample means the counter was cleared in between.
+ */
+static uint64_t sample_delta(uint64_t prev, uint64_t cur)
+{
+	if (cur >= prev)
+		return cur - prev;
+	return cur;
+}
+
+static int sample_saturated(const struct sample_field *f, uint64_t val)
+{
+	if (f->width == 64)
+		return val == UINT64_MAX;
+	return val == (1ULL << f->width) - 1;
+}
+
+static double sample_elapsed(struct sample_target *t)
+{
+	return (t->cur_ts.tv_sec - t->prev_ts.tv_sec) +
+	       (t->cur_ts.tv_nsec - t->prev_ts.tv_nsec) / 1e9;
+}
+
+static int sample_field_present(struct sample_target *t, unsigned i)
+{
+	return (sampler.fields[i].cap & t->caps) == sampler.fields[i].cap;
+}
+
+static double sample_rate(struct sample_target *t, enum sample_kind kind)
+{
+	double elapsed = sample_elapsed(t);
+	uint64_t delta;
+	unsigned i;
+
+	if (elapsed <= 0)
+		return 0;
+
+	for (i = 0; i < sampler.num_fields; i++) {
+		if (sampler.fields[i].kind != kind)
+			continue;
+		if (!sample_field_present(t, i))
+			return 0;
+		delta = sample_delta(t->prev[i], t->cur[i]);
+		/* PortXmitData and PortRcvData count octets divided by 4 */
+		if (kind == SAMPLE_XMT_DATA || kind == SAMPLE_RCV_DATA)
+			delta *= 4;
+		return delta / elapsed;
+	}
+	return 0;
+}
+
+static int sample_reportable(struct sample_target *t)
+{
+	return t->valid && t->have_prev;
+}
+
+static void sample_output_json(struct timespec *now)
+{
+	struct sample_target *t;
+	const char *sep;
+	unsigned i, j;
+
+	for (i = 0; i < sampler.num_targets; i++) {
+		t = &sampler.targets[i];
+		if (!sample_reportable(t))
+			continue;
+
+		printf("{\"timestamp\":%ld.%03ld,\"lid\":%d,\"port\":%d",
+		       (long)now->tv_sec, now->tv_nsec / 1000000,
+		       t->portid.lid, t->port);
+		if (t->guid)
+			printf(",\"guid\":\"0x%016" PRIx64 "\"", t->guid);
+		printf(",\"interval\":%.3f", sample_elapsed(t));
+		printf(",\"xmit_bytes_per_sec\":%.1f",
+		       sample_rate(t, SAMPLE_XMT_DATA));
+		printf(",\"rcv_bytes_per_sec\":%.1f",
+		       sample_rate(t, SAMPLE_RCV_DATA));
+		printf(",\"xmit_pkts_per_sec\":%.1f",
+		       sample_rate(t, SAMPLE_XMT_PKTS));
+		printf(",\"rcv_pkts_per_sec\":%.1f",
+		       sample_rate(t, SAMPLE_RCV_PKTS));
+
+		printf(",\"deltas\":{");
+		for (j = 0, sep = ""; j < sampler.num_fields; j++) {
+			if (sampler.fields[j].kind != SAMPLE_DELTA ||
+			    !sample_field_present(t, j))
+				continue;
+			printf("%s\"%s\":%" PRIu64, sep,
+			       mad_field_name(sampler.fields[j].field),
+			       sample_delta(t->prev[j], t->cur[j]));
+			sep = ",";
+		}
+
+		printf("},\"saturated\":[");
+		for (j = 0, sep = ""; j < sampler.num_fields; j++) {
+			if (!sample_field_present(t, j) ||
+			    !sample_saturated(&sampler.fields[j], t->cur[j]))
+				continue;
+			printf("%s\"%s\"", sep,
+			       mad_field_name(sampler.fields[j].field));
+			sep = ",";
+		}
+		printf("]}\n");
+	}
+}
+
+static void sample_prom_labels(struct sample_target *t)
+{
+	printf("{lid=\"%d\",port=\"%d\"", t->portid.lid, t->port);
+	if (t->guid)
+		printf(",guid=\"0x%016" PRIx64 "\"", t->guid);
+}
+
+static void sample_output_prom_rate(struct timespec *now, const char *name,
+				    const char *help, enum sample_kind kind)
+{
+	uint64_t ts = now->tv_sec * 1000ULL + now->tv_nsec / 1000000;
+	struct sample_target *t;
+	unsigned i;
+
+	printf("# HELP %s %s\n# TYPE %s gauge\n", name, help, name);
+	for (i = 0; i < sampler.num_targets; i++) {
+		t = &sampler.targets[i];
+		if (!sample_reportable(t))
+			continue;
+		printf("%s", name);
+		sample_prom_labels(t);
+		printf("} %.1f %" PRIu64 "\n", sample_rate(t, kind), ts);
+	}
+}
+
+static void sample_output_prom(struct timespec *now)
+{
+	uint64_t ts = now->tv_sec * 1000ULL + now->tv_nsec / 1000000;
+	struct sample_target *t;
+	unsigned i, j;
+
+	sample_output_prom_rate(now, "ib_port_xmit_bytes_per_second",
+				"Transmitted octets per second",
+				SAMPLE_XMT_DATA);
+	sample_output_prom_rate(now, "ib_port_rcv_bytes_per_second",
+				"Received octets per second",
+				SAMPLE_RCV_DATA);
+	sample_output_prom_rate(now, "ib_port_xmit_packets_per_second",
+				"Transmitted packets per second",
+				SAMPLE_XMT_PKTS);
+	sample_output_prom_rate(now, "ib_port_rcv_packets_per_second",
+				"Received packets per second",
+				SAMPLE_RCV_PKTS);
+
+	printf("# HELP ib_port_counter_delta Counter increase since the previous sample\n"
+	       "# TYPE ib_port_counter_delta gauge\n");
+	for (i = 0; i < sampler.num_targets; i++) {
+		t = &sampler.targets[i];
+		if (!sample_reportable(t))
+			continue;
+		for (j = 0; j < sampler.num_fields; j++) {
+			if (sampler.fields[j].kind != SAMPLE_DELTA ||
+			    !sample_field_present(t, j))
+				continue;
+			printf("ib_port_counter_delta");
+			sample_prom_labels(t);
+			printf(",counter=\"%s\"} %" PRIu64 " %" PRIu64 "\n",
+			       mad_field_name(sampler.fields[j].field),
+			       sample_delta(t->prev[j], t->cur[j]), ts);
+		}
+	}
+
+	printf("# HELP ib_port_counter_saturated Counter stuck at its maximum value\n"
+	       "# TYPE ib_port_counter_saturated gauge\n");
+	for (i = 0; i < sampler.num_targets; i++) {
+		t = &sampler.targets[i];
+		if (!sample_reportable(t))
+			continue;
+		for (j = 0; j < sampler.num_fields; j++) {
+			if (!sample_field_present(t, j) ||
+			    !sample_saturated(&sampler.fields[j], t->cur[j]))
+				continue;
+			printf("ib_port_counter_saturated");
+			sample_prom_labels(t);
+			printf(",counter=\"%s\"} 1 %" PRIu64 "\n",
+			       mad_field_name(sampler.fields[j].field), ts);
+		}
+	}
+	printf("\n");
+}
+
+static void sample_counters(void)
+{
+	struct timespec next, now;
+	struct sample_target *t;
+	unsigned n, i;
+	uint64_t *tmp;
+
+	for (n = 0; !info.sample_count || n <= info.sample_count; n++) {
+		if (n == 0)
+			clock_gettime(CLOCK_MONOTONIC, &next);
+
+		sample_sweep(sampler.attr, NULL);
+		clock_gettime(CLOCK_REALTIME, &now);
+
+		if (info.sample_format == SAMPLE_FORMAT_PROM)
+			sample_output_prom(&now);
+		else
+			sample_output_json(&now);
+		fflush(stdout);
+
+		for (i = 0; i < sampler.num_targets; i++) {
+			t = &sampler.targets[i];
+			if (!t->valid) {
+				/* no reference point across a missed sample */
+				t->have_prev = 0;
+				continue;
+			}
+			tmp = t->prev;
+			t->prev = t->cur;
+			t->cur = tmp;
+			t->prev_ts = t->cur_ts;
+			t->have_prev = 1;
+		}
+
+		if (info.sample_count && n == info.sample_count)
+			break;
+
+		next.tv_sec += info.interval_ms / 1000;
+		next.tv_nsec += (info.interval_ms % 1000) * 1000000;
+		if (next.tv_nsec >= 1000000000) {
+			next.tv_sec++;
+			next.tv_nsec -= 1000000000;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+	}
+}
+
+static void sample_init(int extended)
+{
+	if (extended) {
+		sampler.fields = sample_fields_ext;
+		sampler.num_fields = ARRAY_SIZE(sample_fields_ext);
+		sampler.attr = IB_GSI_PORT_COUNTERS_EXT;
+	} else {
+		sampler.fields = sample_fields;
+		sampler.num_fields = ARRAY_SIZE(sample_fields);
+		sampler.attr = IB_GSI_PORT_COUNTERS;
+	}
+
+	if (mad_rpc_async_set_window(srcport, info.max_outstanding) < 0)
+		IBEXIT("can't set the async window");
+}
+
+static void sample_cleanup(void)
+{
+	unsigned i;
+
+	for (i = 0; i < sampler.num_targets; i++)
+		free(sampler.targets[i].values);
+	free(sampler.targets);
+}
+
+static void sample_fabric(int extended)
+{
+	struct ibnd_config config = { 0 };
+	ibnd_fabric_t *fabric;
+
+	config.timeout_ms = ibd_timeout;
+	config.flags = ibd_ibnetdisc_flags;
+	config.mkey = ibd_mkey;
+
+	if (!(fabric = ibnd_discover_fabric(ibd_ca, ibd_ca_port, NULL,
+					    &config)))
+		IBEXIT("discover failed");
+
+	sample_init(extended);
+	ibnd_iter_nodes(fabric, sample_add_node, NULL);
+	ibnd_destroy_fabric(fabric);
+
+	if (!sampler.num_targets)
+		IBEXIT("no linked ports found in fabric");
+
+	sample_query_caps();
+	sample_counters();
+	sample_cleanup();
+}
+
+static void sample_ports(int extended, ib_portid_t *portid, int *ports,
+			 int num_ports, __be16 cap_mask, uint32_t cap_mask2)
+{
+	int i;
+
+	if (extended && !(cap_mask & IB_PM_EXT_WIDTH_SUPPORTED) &&
+	    !(cap_mask & IB_PM_EXT_WIDTH_NOIETF_SUP))
+		IBWARN
+		    ("PerfMgt ClassPortInfo CapMask 0x%02X; No extended counter support indicated\n",
+		     ntohs(cap_mask));
+
+	sample_init(extended);
+	for (i = 0; i < num_ports; i++)
+		sample_add_target(portid, ports[i], 0,
+				  sample_caps(cap_mask, cap_mask2));
+	sample_counters();
+	sample_cleanup();
+}
+
 static int process_opt(void *context, int ch)
 {
+	char *endp;
+	double secs;
+
 	switch (ch) {
 	case 'x':
 		info.extended = 1;
@@ -793,6 +1385,37 @@ static int process_opt(void *context, int ch)
 	case 12:
 		info.vlxmittimecc = 1;
 		break;
+	case 13:
+		secs = strtod(optarg, &endp);
+		if (*endp || secs <= 0) {
+			fprintf(stderr, "invalid interval '%s'\n", optarg);
+			return -1;
+		}
+		info.interval_ms = secs * 1000;
+		if (!info.interval_ms)
+			info.interval_ms = 1;
+		break;
+	case 14:
+		info.sample_count = strtoul(optarg, NULL, 0);
+		break;
+	case 15:
+		if (!strcmp(optarg, "json"))
+			info.sample_format = SAMPLE_FORMAT_JSON;
+		else if (!strcmp(optarg, "prom"))
+			info.sample_format = SAMPLE_FORMAT_PROM;
+		else {
+			fprintf(stderr, "unknown format '%s'\n", optarg);
+			return -1;
+		}
+		break;
+	case 16:
+		info.fabric = 1;
+		break;
+	case 17:
+		info.max_outstanding = strtoul(optarg, NULL, 0);
+		if (!info.max_outstanding)
+			info.max_outstanding = 1;
+		break;
 	case 'a':
 		info.all_ports++;
 		info.port = ALL_PORTS;
@@ -849,6 +1472,11 @@ int main(int argc, char **argv)
 		{"xmitcc", 11, 0, NULL, "show Xmit congestion control counters"},
 		{"vlxmittimecc", 12, 0, NULL, "show VL Xmit Time congestion control counters"},
 		{"smplctl", 'c', 0, NULL, "show samples control"},
+		{"interval", 13, 1, "<sec>", "sample counters every <sec> seconds and report rates"},
+		{"count", 14, 1, "<n>", "stop sampling after <n> reports (default: run forever)"},
+		{"format", 15, 1, "<json|prom>", "sample output format (default: json)"},
+		{"fabric", 16, 0, NULL, "sample all linked ports in the fabric"},
+		{"max_outstanding", 17, 1, "<n>", "max queries on the wire while sampling (default: 32)"},
 		{"all_ports", 'a', 0, NULL, "show aggregated counters"},
 		{"loop_ports", 'l', 0, NULL, "iterate through each port"},
 		{"reset_after_read", 'r', 0, NULL, "reset counters after read"},
@@ -872,6 +1500,8 @@ int main(int argc, char **argv)
 		"-l 32 1-10\t# read performance counters from lid 32, port 1-10, output each port",
 		"-a 32 1,4,8\t# read performance counters from lid 32, port 1, 4, and 8, aggregate output",
 		"-l 32 1,4,8\t# read performance counters from lid 32, port 1, 4, and 8, output each port",
+		"-x --interval 10 32 1-10\t# report rates of lid 32, port 1-10 every 10 seconds",
+		"-x --interval 60 --fabric --format prom\t# report rates of the whole fabric every minute",
 		NULL,
 	};
 
@@ -881,6 +1511,11 @@ int main(int argc, char **argv)
 	argc -= optind;
 	argv += optind;
 
+	if ((info.fabric || info.sample_count) && !info.interval_ms)
+		IBEXIT("--fabric and --count require --interval");
+	if (info.interval_ms && (info.reset || info.reset_only))
+		IBEXIT("--interval cannot be combined with reset");
+
 	if (argc > 1) {
 		if (strchr(argv[1], ',')) {
 			tmpstr = strtok(argv[1], ",");
@@ -922,6 +1557,11 @@ int main(int argc, char **argv)
 
 	smp_mkey_set(srcport, ibd_mkey);
 
+	if (info.fabric) {
+		sample_fabric(info.extended);
+		goto done;
+	}
+
 	if (argc) {
 		if (resolve_portid_str(ibd_ca, ibd_ca_port, &portid, argv[0],
 				       ibd_dest_type, ibd_sm_id, srcport) < 0)
@@ -1063,6 +1703,21 @@ int main(int argc, char **argv)
 			    ("Emulating AllPortSelect by iterating through all ports");
 	}
 
+	if (info.interval_ms) {
+		if (all_ports_loop ||
+		    (info.loop_ports && (info.all_ports || info.port == ALL_PORTS))) {
+			info.ports_count = 0;
+			for (i = start_port; i <= num_ports; i++)
+				info.ports[info.ports_count++] = i;
+		} else if (info.ports_count <= 1) {
+			info.ports[0] = info.port;
+			info.ports_count = 1;
+		}
+		sample_ports(info.extended, &portid, info.ports,
+			     info.ports_count, cap_mask, cap_mask2);
+		goto done;
+	}
+
 	if (info.reset_only)
 		goto do_reset;
 
@@ -40,7 +40,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <sys/socket.h>
-#include <sys/select.h>
+#include <sys/epoll.h>
 #include <sys/stat.h>
 #include <arpa/inet.h>
 #include <errno.h>
@@ -52,6 +52,7 @@
 #include <syslog.h>
 #include <netlink/msg.h>
 #include <ccan/list.h>
+#include <ccan/array_size.h>
 #include <rdma/rdma_netlink.h>
 #include <stdatomic.h>
 
@@ -80,6 +81,10 @@
 #define IWPM_MAP_REQ_TIMEOUT  10 /* sec */
 #define IWPM_SEND_MSG_RETRIES 3
 
+/* Buckets of the mapped port and mapping request hash tables */
+#define IWPM_HASH_BITS  12
+#define IWPM_HASH_SIZE  (1 << IWPM_HASH_BITS)
+
 #define IWPM_ULIB_NAME  "iWarpPortMapperUser"
 #define IWPM_ULIBNAME_SIZE 32
 #define IWPM_DEVNAME_SIZE  32
@@ -135,6 +140,8 @@ typedef union sockaddr_union {
 
 typedef struct iwpm_mapped_port {
 	struct list_node	    entry;
+	struct list_node	    local_entry;  /* hashed by local TCP port */
+	struct list_node	    mapped_entry; /* hashed by mapped TCP port */
 	int			    owner_client;
 	int			    sd;
 	struct sockaddr_storage	    local_addr;
@@ -165,6 +172,7 @@ typedef struct iwpm_send_msg {
 
 typedef struct iwpm_mapping_request {
 	struct list_node		entry;
+	struct list_node		hash_entry;     /* hashed by assochandle */
 	struct sockaddr_storage		src_addr;
 	struct sockaddr_storage		remote_addr;
 	__u16 				nlmsg_type;     /* Message content */
@@ -237,6 +245,8 @@ int is_wcard_ipaddr(struct sockaddr_storage *);
 
 /* iwarp_pm_helper.c */
 
+void init_iwpm_hash_tables(void);
+
 iwpm_mapped_port *create_iwpm_mapped_port(struct sockaddr_storage *, int, __u32 flags);
 
 iwpm_mapped_port *reopen_iwpm_mapped_port(struct sockaddr_storage *, struct sockaddr_storage *, int,
@@ -35,6 +35,45 @@
 
 static LIST_HEAD(mapped_ports);		/* list of mapped ports */
 
+/*
+ * The mapped ports are also hashed by their local and by their mapped TCP
+ * port.  A lookup only matches a port object with the same TCP port, which
+ * the wild card matching of find_iwpm_mapping() requires as well, so each
+ * lookup walks a single bucket.  Objects enter a bucket at its head, as they
+ * enter mapped_ports, so a lookup still finds the most recent match first.
+ */
+static struct list_head local_port_hash[IWPM_HASH_SIZE];
+static struct list_head mapped_port_hash[IWPM_HASH_SIZE];
+
+/* Mapping requests hashed by assochandle, protected by map_req_mutex */
+static struct list_head map_req_hash[IWPM_HASH_SIZE];
+
+/**
+ * init_iwpm_hash_tables - Initialize the mapped port and map request tables
+ */
+void init_iwpm_hash_tables(void)
+{
+	int i;
+
+	for (i = 0; i < IWPM_HASH_SIZE; i++) {
+		list_head_init(&local_port_hash[i]);
+		list_head_init(&mapped_port_hash[i]);
+		list_head_init(&map_req_hash[i]);
+	}
+}
+
+static struct list_head *iwpm_port_bucket(struct sockaddr_storage *addr, int not_mapped)
+{
+	unsigned int idx = be16toh(get_sockaddr_port(addr)) & (IWPM_HASH_SIZE - 1);
+
+	return not_mapped ? &local_port_hash[idx] : &mapped_port_hash[idx];
+}
+
+static struct list_head *iwpm_map_req_bucket(__u64 assochandle)
+{
+	return &map_req_hash[(assochandle * 0x9e3779b97f4a7c15ULL) >> (64 - IWPM_HASH_BITS)];
+}
+
 /**
  * create_iwpm_map_request - Create a new map request tracking object
  * @req_nlh: netlink header of the received client message
@@ -89,6 +128,7 @@ void add_iwpm_map_request(iwpm_mapping_request *iwpm_map_req)
 {
 	pthread_mutex_lock(&map_req_mutex);
 	list_add(&mapping_reqs, &iwpm_map_req->entry);
+	list_add(iwpm_map_req_bucket(iwpm_map_req->assochandle), &iwpm_map_req->hash_entry);
 	/* if not wake, signal the thread that a new request has been posted */
 	if (!wake)
 		pthread_cond_signal(&cond_req_complete);
@@ -109,6 +149,7 @@ void remove_iwpm_map_request(iwpm_mapping_request *iwpm_map_req)
 			iwpm_map_req->msg_type, iwpm_map_req->nlmsg_pid);
 	}
 	list_del(&iwpm_map_req->entry);
+	list_del(&iwpm_map_req->hash_entry);
 	if (iwpm_map_req->send_msg)
 		free(iwpm_map_req->send_msg);
 	free(iwpm_map_req);
@@ -129,8 +170,8 @@ int update_iwpm_map_request(__u64 assochandle, struct sockaddr_storage *src_addr
 	int ret = -EINVAL;
 
 	pthread_mutex_lock(&map_req_mutex);
-	/* look for a matching entry in the list */
-	list_for_each(&mapping_reqs, iwpm_map_req, entry) {
+	/* look for a matching entry in the assochandle bucket */
+	list_for_each(iwpm_map_req_bucket(assochandle), iwpm_map_req, hash_entry) {
 		if (assochandle == iwpm_map_req->assochandle &&
 				(msg_type & iwpm_map_req->msg_type) &&
 				check_same_sockaddr(src_addr, &iwpm_map_req->src_addr)) {
@@ -341,6 +382,8 @@ void add_iwpm_mapped_port(iwpm_mapped_port *iwpm_port)
 		return;
 	iwpm_debug(IWARP_PM_ALL_DBG, "add_iwpm_mapped_port: Adding a new mapping #%d\n", dbg_idx++);
 	list_add(&mapped_ports, &iwpm_port->entry);
+	list_add(iwpm_port_bucket(&iwpm_port->local_addr, 1), &iwpm_port->local_entry);
+	list_add(iwpm_port_bucket(&iwpm_port->mapped_addr, 0), &iwpm_port->mapped_entry);
 }
 
 /**
@@ -382,6 +425,13 @@ int check_same_sockaddr(struct sockaddr_storage *sockaddr_a, struct sockaddr_sto
 	return ret;
 }
 
+/* Offset of the hash table entry, which the mapped port bucket is linked by */
+static size_t iwpm_port_entry_off(int not_mapped)
+{
+	return not_mapped ? offsetof(iwpm_mapped_port, local_entry) :
+			    offsetof(iwpm_mapped_port, mapped_entry);
+}
+
 /**
  * find_iwpm_mapping - Find saved mapped port object
  * @search_addr: IP address and port to search for in the list
@@ -396,13 +446,17 @@ iwpm_mapped_port *find_iwpm_mapping(struct sockaddr_storage *search_addr,
 {
 	iwpm_mapped_port *iwpm_port, *saved_iwpm_port = NULL;
 	struct sockaddr_storage *current_addr;
+	struct list_head *bucket = iwpm_port_bucket(search_addr, not_mapped);
+	size_t off = iwpm_port_entry_off(not_mapped);
+	__be16 search_port = get_sockaddr_port(search_addr);
+	int search_wcard = is_wcard_ipaddr(search_addr);
 
-	list_for_each(&mapped_ports, iwpm_port, entry) {
+	list_for_each_off(bucket, iwpm_port, off) {
 		current_addr = (not_mapped)? &iwpm_port->local_addr : &iwpm_port->mapped_addr;
 
-		if (get_sockaddr_port(search_addr) == get_sockaddr_port(current_addr)) {
+		if (search_port == get_sockaddr_port(current_addr)) {
 			if (check_same_sockaddr(search_addr, current_addr) ||
-					iwpm_port->wcard || is_wcard_ipaddr(search_addr)) {
+					iwpm_port->wcard || search_wcard) {
 				saved_iwpm_port = iwpm_port;
 				goto find_mapping_exit;
 			}
@@ -425,8 +479,10 @@ iwpm_mapped_port *find_iwpm_same_mapping(struct sockaddr_storage *search_addr,
 {
 	iwpm_mapped_port *iwpm_port, *saved_iwpm_port = NULL;
 	struct sockaddr_storage *current_addr;
+	struct list_head *bucket = iwpm_port_bucket(search_addr, not_mapped);
+	size_t off = iwpm_port_entry_off(not_mapped);
 
-	list_for_each(&mapped_ports, iwpm_port, entry) {
+	list_for_each_off(bucket, iwpm_port, off) {
 		current_addr = (not_mapped)? &iwpm_port->local_addr : &iwpm_port->mapped_addr;
 		if (check_same_sockaddr(search_addr, current_addr)) {
 			saved_iwpm_port = iwpm_port;
@@ -460,6 +516,8 @@ void remove_iwpm_mapped_port(iwpm_mapped_port *iwpm_port)
 	iwpm_debug(IWARP_PM_ALL_DBG, "remove_iwpm_mapped_port: index = %d\n", dbg_idx++);
 
 	list_del(&iwpm_port->entry);
+	list_del(&iwpm_port->local_entry);
+	list_del(&iwpm_port->mapped_entry);
 }
 
 void print_iwpm_mapped_ports(void)
@@ -515,6 +573,9 @@ void free_iwpm_mapped_ports(void)
 {
 	iwpm_mapped_port *iwpm_port;
 
-	while ((iwpm_port = list_pop(&mapped_ports, iwpm_mapped_port, entry)))
+	while ((iwpm_port = list_pop(&mapped_ports, iwpm_mapped_port, entry))) {
+		list_del(&iwpm_port->local_entry);
+		list_del(&iwpm_port->mapped_entry);
 		free_iwpm_port(iwpm_port);
+	}
 }
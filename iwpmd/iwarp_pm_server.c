@@ -1386,84 +1386,74 @@ static void iwpm_cleanup(void)
 	closelog();
 }
 
+/**
+ * add_iwpm_epoll_socket - Add a socket to the iwarp port mapper epoll set
+ */
+static int add_iwpm_epoll_socket(int epoll_fd, int sock)
+{
+	struct epoll_event event = {
+		.events = EPOLLIN,
+		.data.fd = sock,
+	};
+
+	if (sock < 0)
+		return 0;
+	return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sock, &event);
+}
+
 /**
  * iwarp_port_mapper - Distribute work orders for processing different types of iwpm messages
  */
 static int iwarp_port_mapper(void)
 {
-	fd_set select_fdset; /* read fdset */
-	struct timeval select_timeout;
-	int select_rc, max_sock = 0, ret = 0;
-
-	if (pmv4_sock > max_sock)
-		max_sock = pmv4_sock;
-	if (pmv6_sock > max_sock)
-		max_sock = pmv6_sock;
-	if (netlink_sock > max_sock)
-		max_sock = netlink_sock;
-	if (pmv4_client_sock > max_sock)
-		max_sock = pmv4_client_sock;
-	if (pmv6_client_sock > max_sock)
-		max_sock = pmv6_client_sock;
+	struct epoll_event events[8];
+	int epoll_fd, nevents, i, ret = 0;
+
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd < 0) {
+		syslog(LOG_WARNING, "iwarp_port_mapper: Unable to create epoll (%s).\n",
+				strerror(errno));
+		return -errno;
+	}
+	/* add the UDP and Netlink sockets to the epoll set */
+	if (add_iwpm_epoll_socket(epoll_fd, pmv4_sock) ||
+			add_iwpm_epoll_socket(epoll_fd, pmv4_client_sock) ||
+			add_iwpm_epoll_socket(epoll_fd, pmv6_sock) ||
+			add_iwpm_epoll_socket(epoll_fd, pmv6_client_sock) ||
+			add_iwpm_epoll_socket(epoll_fd, netlink_sock)) {
+		syslog(LOG_WARNING, "iwarp_port_mapper: Unable to add socket to epoll (%s).\n",
+				strerror(errno));
+		ret = -errno;
+		goto iwarp_port_mapper_exit;
+	}
 
 	/* poll a set of sockets */
 	do {
-		do {
-			if (print_mappings) {
-				print_iwpm_mapped_ports();
-				print_mappings = 0;
-			}
-			/* initialize the file sets for select */
-			FD_ZERO(&select_fdset);
-			/* add the UDP and Netlink sockets to the file set */
-			if (pmv4_sock >= 0) {
-				FD_SET(pmv4_sock, &select_fdset);
-				FD_SET(pmv4_client_sock, &select_fdset);
-			}
-			if (pmv6_sock >= 0) {
-				FD_SET(pmv6_sock, &select_fdset);
-				FD_SET(pmv6_client_sock, &select_fdset);
-			}
-			FD_SET(netlink_sock, &select_fdset);
-
-			/* set the timeout for select */
-			select_timeout.tv_sec = 10;
-			select_timeout.tv_usec = 0;
-			/* timeout is an upper bound of time elapsed before select returns */
-			select_rc = select(max_sock + 1, &select_fdset, NULL, NULL, &select_timeout);
-		} while (select_rc == 0);
-		/* select_rc is the number of fds ready for IO ( IO won't block) */
-
-		if (select_rc == -1) {
+		if (print_mappings) {
+			print_iwpm_mapped_ports();
+			print_mappings = 0;
+		}
+		/* timeout is an upper bound of time elapsed before epoll returns */
+		nevents = epoll_wait(epoll_fd, events, ARRAY_SIZE(events), 10000);
+		if (nevents == -1) {
 			if (errno == EINTR)
 				continue;
-			syslog(LOG_WARNING, "iwarp_port_mapper: Select failed (%s).\n", strerror(errno));
+			syslog(LOG_WARNING, "iwarp_port_mapper: Epoll wait failed (%s).\n",
+					strerror(errno));
 			ret = -errno;
 			goto iwarp_port_mapper_exit;
 		}
 
-		if (pmv4_sock >= 0) {
-			if (FD_ISSET(pmv4_sock, &select_fdset))
-				ret = process_iwpm_msg(pmv4_sock);
-
-			if (FD_ISSET(pmv4_client_sock, &select_fdset))
-				ret = process_iwpm_msg(pmv4_client_sock);
+		for (i = 0; i < nevents; i++) {
+			if (events[i].data.fd == netlink_sock)
+				ret = process_iwpm_netlink_msg(netlink_sock);
+			else
+				ret = process_iwpm_msg(events[i].data.fd);
 		}
-
-		if (pmv6_sock >= 0) {
-			if (FD_ISSET(pmv6_sock, &select_fdset))
-				ret = process_iwpm_msg(pmv6_sock);
-
-			if (FD_ISSET(pmv6_client_sock, &select_fdset))
-				ret = process_iwpm_msg(pmv6_client_sock);
-		}
-
-		if (FD_ISSET(netlink_sock, &select_fdset))
-			ret = process_iwpm_netlink_msg(netlink_sock);
-
 	} while (1);
 
 iwarp_port_mapper_exit:
+	close(epoll_fd);
 	return ret;
 }
 
@@ -1520,6 +1510,7 @@ int main(int argc, char *argv[])
 		fclose(fp);
 	}
 	memset(client_list, 0, sizeof(client_list));
+	init_iwpm_hash_tables();
 	pmv4_client_sock = -1;
 	pmv6_sock = -1;
 	pmv6_client_sock = pmv6_sock;
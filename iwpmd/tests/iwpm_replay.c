@@ -0,0 +1,233 @@
+/* GPLv2 or OpenIB.org BSD (MIT) See COPYING file */
+
+/*
+ * Netlink replay benchmark for iwpmd.  Registers with a running iwpmd as a
+ * port mapper client, the way the kernel iWARP connection manager does, then
+ * replays add mapping requests for a growing number of local addresses and
+ * the matching remove mapping requests.  Reports the add latency as the
+ * mapping table grows and the overall request rates.
+ *
+ * Netlink unicast between user sockets needs CAP_NET_ADMIN, so this runs as
+ * root, and it needs the pid of the iwpmd process, which iwpmd binds its
+ * netlink socket to.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <netlink/msg.h>
+#include <netlink/attr.h>
+#include <rdma/rdma_netlink.h>
+
+#define REPLAY_ULIB_NAME "iWarpPortMapperUser"
+
+static int nl_sock;
+static pid_t iwpmd_pid;
+static int client = 63;
+static unsigned int mappings = 10000;
+static unsigned int window = 1000;
+static __u32 seq;
+
+static double now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static struct nl_msg *alloc_request(int op, int seq_attr)
+{
+	struct nl_msg *msg;
+
+	msg = nlmsg_alloc();
+	if (!msg)
+		return NULL;
+	if (!nlmsg_put(msg, getpid(), ++seq, RDMA_NL_GET_TYPE(client, op), 0,
+		       NLM_F_REQUEST) ||
+	    nla_put_u32(msg, seq_attr, seq)) {
+		nlmsg_free(msg);
+		return NULL;
+	}
+	return msg;
+}
+
+static int send_request(struct nl_msg *msg)
+{
+	struct sockaddr_nl dest = {
+		.nl_family = AF_NETLINK,
+		.nl_pid = iwpmd_pid,
+	};
+	struct nlmsghdr *nlh = nlmsg_hdr(msg);
+	int ret;
+
+	ret = sendto(nl_sock, nlh, nlh->nlmsg_len, 0, (struct sockaddr *)&dest,
+		     sizeof(dest));
+	nlmsg_free(msg);
+	return ret == nlh->nlmsg_len ? 0 : -1;
+}
+
+/* Wait for the reply to a request, returns its netlink operation */
+static int recv_reply(void)
+{
+	char buf[NLMSG_SPACE(4096)];
+	struct nlmsghdr *nlh = (struct nlmsghdr *)buf;
+	int len;
+
+	len = recv(nl_sock, buf, sizeof(buf), 0);
+	if (len < (int)sizeof(*nlh) || !NLMSG_OK(nlh, len))
+		return -1;
+	if (nlh->nlmsg_type == NLMSG_ERROR)
+		return -1;
+	return RDMA_NL_GET_OP(nlh->nlmsg_type);
+}
+
+static int register_client(void)
+{
+	struct nl_msg *msg;
+
+	msg = alloc_request(RDMA_NL_IWPM_REG_PID, IWPM_NLA_REG_PID_SEQ);
+	if (!msg || nla_put_string(msg, IWPM_NLA_REG_IF_NAME, "replay0") ||
+	    nla_put_string(msg, IWPM_NLA_REG_IBDEV_NAME, "replay0") ||
+	    nla_put_string(msg, IWPM_NLA_REG_ULIB_NAME, REPLAY_ULIB_NAME))
+		return -1;
+	if (send_request(msg))
+		return -1;
+	return recv_reply() == RDMA_NL_IWPM_REG_PID ? 0 : -1;
+}
+
+/* Distinct local addresses, each on its own TCP port */
+static void local_addr(unsigned int i, struct sockaddr_storage *addr)
+{
+	struct sockaddr_in *in4 = (struct sockaddr_in *)addr;
+
+	memset(addr, 0, sizeof(*addr));
+	in4->sin_family = AF_INET;
+	in4->sin_addr.s_addr = htonl(0x0a000000 | i);
+	in4->sin_port = htons(1024 + i);
+}
+
+static int add_mapping(unsigned int i)
+{
+	struct sockaddr_storage addr;
+	struct nl_msg *msg;
+
+	local_addr(i, &addr);
+	msg = alloc_request(RDMA_NL_IWPM_ADD_MAPPING,
+			    IWPM_NLA_MANAGE_MAPPING_SEQ);
+	if (!msg || nla_put(msg, IWPM_NLA_MANAGE_ADDR, sizeof(addr), &addr) ||
+	    nla_put_u32(msg, IWPM_NLA_MANAGE_FLAGS, IWPM_FLAGS_NO_PORT_MAP))
+		return -1;
+	if (send_request(msg))
+		return -1;
+	return recv_reply() == RDMA_NL_IWPM_ADD_MAPPING ? 0 : -1;
+}
+
+/* iwpmd does not answer remove mapping requests */
+static int remove_mapping(unsigned int i)
+{
+	struct sockaddr_storage addr;
+	struct nl_msg *msg;
+
+	local_addr(i, &addr);
+	msg = alloc_request(RDMA_NL_IWPM_REMOVE_MAPPING,
+			    IWPM_NLA_MANAGE_MAPPING_SEQ);
+	if (!msg || nla_put(msg, IWPM_NLA_MANAGE_ADDR, sizeof(addr), &addr))
+		return -1;
+	return send_request(msg);
+}
+
+static void show_usage(char *program)
+{
+	printf("usage: %s -p iwpmd_pid [options]\n", program);
+	printf("   -p pid           - pid of the running iwpmd\n");
+	printf("   [-n mappings]    - number of mappings to add (default 10000)\n");
+	printf("   [-w window]      - report add latency every window mappings\n");
+	printf("                      (default 1000)\n");
+	printf("   [-c client]      - port mapper client index (default 63)\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct sockaddr_nl addr = { .nl_family = AF_NETLINK };
+	double start, win_start, add_time, remove_time;
+	unsigned int i, failed = 0;
+	int op;
+
+	while ((op = getopt(argc, argv, "p:n:w:c:")) != -1) {
+		switch (op) {
+		case 'p':
+			iwpmd_pid = atoi(optarg);
+			break;
+		case 'n':
+			mappings = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			window = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			client = atoi(optarg);
+			break;
+		default:
+			show_usage(argv[0]);
+			exit(1);
+		}
+	}
+
+	if (iwpmd_pid <= 0 || !window || client <= 0 || client >= 64 ||
+	    mappings > 64000) {
+		show_usage(argv[0]);
+		exit(1);
+	}
+
+	nl_sock = socket(AF_NETLINK, SOCK_RAW, NETLINK_RDMA);
+	if (nl_sock < 0 ||
+	    bind(nl_sock, (struct sockaddr *)&addr, sizeof(addr))) {
+		perror("netlink socket");
+		exit(1);
+	}
+
+	if (register_client()) {
+		fprintf(stderr, "unable to register with iwpmd %d: %s\n",
+			iwpmd_pid, strerror(errno));
+		exit(1);
+	}
+
+	printf("mappings,add_avg_us\n");
+	start = win_start = now_us();
+	for (i = 0; i < mappings; i++) {
+		if (add_mapping(i))
+			failed++;
+		if ((i + 1) % window == 0) {
+			printf("%u,%.1f\n", i + 1,
+			       (now_us() - win_start) / window);
+			win_start = now_us();
+		}
+	}
+	add_time = now_us() - start;
+
+	start = now_us();
+	for (i = 0; i < mappings; i++) {
+		if (remove_mapping(i))
+			failed++;
+	}
+	/* Requests are served in order, so a reply marks the removes done */
+	if (register_client())
+		failed++;
+	remove_time = now_us() - start;
+
+	printf("%u mappings, %u failed requests\n", mappings, failed);
+	if (mappings)
+		printf("add %.0f/s, remove %.0f/s\n", mappings * 1e6 / add_time,
+		       mappings * 1e6 / remove_time);
+
+	close(nl_sock);
+	return failed ? 1 : 0;
+}
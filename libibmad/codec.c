@@ -0,0 +1,122 @@
+/* GPLv2 or OpenIB.org BSD (MIT) See COPYING file */
+
+#include <endian.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <infiniband/mad.h>
+
+#include "mad_codec.h"
+
+/*
+ * Whole-attribute codecs.
+ *
+ * mad_get_field() looks up the field in ib_mad_f[] and assembles the value
+ * byte by byte.  Here the attribute is loaded once as an array of host
+ * order 32 bit words and every field is extracted with a shift and a mask
+ * known at compile time.  The layout tables live in mad_codec.h and name
+ * the fields only; ib_mad_f[] is a constant table visible here, so its
+ * normalized offsets fold into the code: a field of up to 32 bits occupies
+ * bits [bitoffs % 32, bitoffs % 32 + bitlen) of word bitoffs / 32, a 64 bit
+ * field is two consecutive words, most significant first.
+ */
+
+static inline void codec_load(uint32_t *w, const void *buf, unsigned words)
+{
+	const uint8_t *p = buf;
+	uint32_t be;
+	unsigned i;
+
+	for (i = 0; i < words; i++) {
+		memcpy(&be, p + i * 4, sizeof(be));
+		w[i] = be32toh(be);
+	}
+}
+
+static inline void codec_store(void *buf, const uint32_t *w, unsigned words)
+{
+	uint8_t *p = buf;
+	uint32_t be;
+	unsigned i;
+
+	for (i = 0; i < words; i++) {
+		be = htobe32(w[i]);
+		memcpy(p + i * 4, &be, sizeof(be));
+	}
+}
+
+static inline uint64_t codec_get(const uint32_t *w, unsigned bitoffs,
+				 unsigned bitlen)
+{
+	if (bitlen == 64)
+		return ((uint64_t)w[bitoffs / 32] << 32) | w[bitoffs / 32 + 1];
+	if (bitlen == 32)
+		return w[bitoffs / 32];
+	return (w[bitoffs / 32] >> (bitoffs & 31)) & ((1u << bitlen) - 1);
+}
+
+static inline void codec_set(uint32_t *w, unsigned bitoffs, unsigned bitlen,
+			     uint64_t val)
+{
+	uint32_t mask;
+
+	if (bitlen == 64) {
+		w[bitoffs / 32] = val >> 32;
+		w[bitoffs / 32 + 1] = val;
+		return;
+	}
+	if (bitlen == 32) {
+		w[bitoffs / 32] = val;
+		return;
+	}
+	mask = ((1u << bitlen) - 1) << (bitoffs & 31);
+	w[bitoffs / 32] = (w[bitoffs / 32] & ~mask) |
+			  (((uint32_t)val << (bitoffs & 31)) & mask);
+}
+
+#define CODEC_GET(member, field)					\
+	out->member = codec_get(w, ib_mad_f[field].bitoffs,		\
+				ib_mad_f[field].bitlen);
+#define CODEC_SET(member, field)					\
+	codec_set(w, ib_mad_f[field].bitoffs, ib_mad_f[field].bitlen,	\
+		  in->member);
+
+#define DEFINE_CODEC(name, type, words, LAYOUT)				\
+void mad_decode_##name(const void *buf, type *out)			\
+{									\
+	uint32_t w[words];						\
+									\
+	codec_load(w, buf, words);					\
+	LAYOUT(CODEC_GET)						\
+}									\
+									\
+void mad_encode_##name(void *buf, const type *in)			\
+{									\
+	uint32_t w[words];						\
+									\
+	/* reserved bits between fields are preserved */		\
+	codec_load(w, buf, words);					\
+	LAYOUT(CODEC_SET)						\
+	codec_store(buf, w, words);					\
+}
+
+DEFINE_CODEC(node_info, struct ibmad_node_info, IB_NODE_INFO_WORDS,
+	     IB_NODE_INFO_CODEC)
+DEFINE_CODEC(port_info, struct ibmad_port_info, IB_PORT_INFO_WORDS,
+	     IB_PORT_INFO_CODEC)
+DEFINE_CODEC(switch_info, struct ibmad_switch_info, IB_SWITCH_INFO_WORDS,
+	     IB_SWITCH_INFO_CODEC)
+DEFINE_CODEC(port_counters, struct ibmad_port_counters,
+	     IB_PORT_COUNTERS_WORDS, IB_PORT_COUNTERS_CODEC)
+DEFINE_CODEC(port_counters_ext, struct ibmad_port_counters_ext,
+	     IB_PORT_COUNTERS_EXT_WORDS, IB_PORT_COUNTERS_EXT_CODEC)
+
+void mad_decode_lft_block(const void *buf, uint8_t ports[IB_LFT_BLOCK_SIZE])
+{
+	memcpy(ports, buf, IB_LFT_BLOCK_SIZE);
+}
+
+void mad_encode_lft_block(void *buf, const uint8_t ports[IB_LFT_BLOCK_SIZE])
+{
+	memcpy(buf, ports, IB_LFT_BLOCK_SIZE);
+}
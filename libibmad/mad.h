@@ -1428,6 +1428,156 @@ enum MAD_NODE_TYPE {
 	IB_NODE_MAX = NODE_RNIC
 };
 
+/*
+ * Decoded attributes for the whole-attribute codecs in codec.c.  Each member
+ * holds the value mad_get_field() returns for the corresponding MAD_FIELDS
+ * entry, e.g. ibmad_port_info.lid is IB_PORT_LID_F.
+ */
+struct ibmad_node_info {
+	uint8_t base_vers;
+	uint8_t class_vers;
+	uint8_t node_type;
+	uint8_t num_ports;
+	uint64_t system_guid;
+	uint64_t node_guid;
+	uint64_t port_guid;
+	uint16_t partition_cap;
+	uint16_t device_id;
+	uint32_t revision;
+	uint8_t local_port;
+	uint32_t vendor_id;
+};
+
+struct ibmad_port_info {
+	uint64_t mkey;
+	uint64_t gid_prefix;
+	uint16_t lid;
+	uint16_t sm_lid;
+	uint32_t cap_mask;
+	uint16_t diag_code;
+	uint16_t mkey_lease_period;
+	uint8_t local_port;
+	uint8_t link_width_enabled;
+	uint8_t link_width_supported;
+	uint8_t link_width_active;
+	uint8_t link_speed_supported;
+	uint8_t state;
+	uint8_t phys_state;
+	uint8_t link_down_def_state;
+	uint8_t mkey_prot_bits;
+	uint8_t lmc;
+	uint8_t link_speed_active;
+	uint8_t link_speed_enabled;
+	uint8_t neighbor_mtu;
+	uint8_t sm_sl;
+	uint8_t vl_cap;
+	uint8_t init_type;
+	uint8_t vl_high_limit;
+	uint8_t vl_arb_high_cap;
+	uint8_t vl_arb_low_cap;
+	uint8_t init_type_reply;
+	uint8_t mtu_cap;
+	uint8_t vl_stall_count;
+	uint8_t hoq_life;
+	uint8_t oper_vls;
+	uint8_t part_enforce_inb;
+	uint8_t part_enforce_outb;
+	uint8_t filter_raw_inb;
+	uint8_t filter_raw_outb;
+	uint16_t mkey_violations;
+	uint16_t pkey_violations;
+	uint16_t qkey_violations;
+	uint8_t guid_cap;
+	uint8_t client_reregister;
+	uint8_t mcast_pkey_trap_suppr;
+	uint8_t subnet_timeout;
+	uint8_t resp_time_val;
+	uint8_t local_phys_err;
+	uint8_t overrun_err;
+	uint16_t max_credit_hint;
+	uint32_t link_round_trip;
+	uint16_t cap_mask2;
+	uint8_t link_speed_ext_active;
+	uint8_t link_speed_ext_supported;
+	uint8_t link_speed_ext_enabled;
+};
+
+struct ibmad_switch_info {
+	uint16_t linear_fdb_cap;
+	uint16_t random_fdb_cap;
+	uint16_t mcast_fdb_cap;
+	uint16_t linear_fdb_top;
+	uint8_t def_port;
+	uint8_t def_mcast_prim_port;
+	uint8_t def_mcast_not_prim_port;
+	uint8_t life_time;
+	uint8_t state_change;
+	uint8_t opt_sl2vl_mapping;
+	uint16_t lids_per_port;
+	uint16_t partition_enforce_cap;
+	uint8_t inbound_part_enf;
+	uint8_t outbound_part_enf;
+	uint8_t filter_raw_inb;
+	uint8_t filter_raw_outb;
+	uint8_t enhanced_port0;
+	uint16_t mcast_fdb_top;
+};
+
+struct ibmad_port_counters {
+	uint8_t port_select;
+	uint16_t counter_select;
+	uint16_t symbol_errors;
+	uint8_t link_recovers;
+	uint8_t link_downed;
+	uint16_t rcv_errors;
+	uint16_t rcv_remote_phys_errors;
+	uint16_t rcv_switch_relay_errors;
+	uint16_t xmt_discards;
+	uint8_t xmt_constraint_errors;
+	uint8_t rcv_constraint_errors;
+	uint8_t counter_select2;
+	uint8_t link_integrity_errors;
+	uint8_t excessive_buffer_overrun_errors;
+	uint16_t qp1_dropped;
+	uint16_t vl15_dropped;
+	uint32_t xmt_data;
+	uint32_t rcv_data;
+	uint32_t xmt_pkts;
+	uint32_t rcv_pkts;
+	uint32_t xmt_wait;
+};
+
+struct ibmad_port_counters_ext {
+	uint8_t port_select;
+	uint16_t counter_select;
+	uint32_t counter_select2;
+	uint64_t xmt_data;
+	uint64_t rcv_data;
+	uint64_t xmt_pkts;
+	uint64_t rcv_pkts;
+	uint64_t unicast_xmt_pkts;
+	uint64_t unicast_rcv_pkts;
+	uint64_t multicast_xmt_pkts;
+	uint64_t multicast_rcv_pkts;
+	uint64_t symbol_errors;
+	uint64_t link_recovers;
+	uint64_t link_downed;
+	uint64_t rcv_errors;
+	uint64_t rcv_remote_phys_errors;
+	uint64_t rcv_switch_relay_errors;
+	uint64_t xmt_discards;
+	uint64_t xmt_constraint_errors;
+	uint64_t rcv_constraint_errors;
+	uint64_t link_integrity_errors;
+	uint64_t excessive_buffer_overrun_errors;
+	uint64_t vl15_dropped;
+	uint64_t xmt_wait;
+	uint64_t qp1_dropped;
+};
+
+/* One SwitchLinearForwardingTable block: the egress port of 64 LIDs */
+#define IB_LFT_BLOCK_SIZE	64
+
 /******************************************************************************/
 
 /* portid.c */
@@ -1463,6 +1613,24 @@ char *mad_dump_field(enum MAD_FIELDS field, char *buf, int bufsz, void *val);
 char *mad_dump_val(enum MAD_FIELDS field, char *buf, int bufsz, void *val);
 const char *mad_field_name(enum MAD_FIELDS field);
 
+/* codec.c */
+void mad_decode_node_info(const void *buf, struct ibmad_node_info *info);
+void mad_encode_node_info(void *buf, const struct ibmad_node_info *info);
+void mad_decode_port_info(const void *buf, struct ibmad_port_info *info);
+void mad_encode_port_info(void *buf, const struct ibmad_port_info *info);
+void mad_decode_switch_info(const void *buf, struct ibmad_switch_info *info);
+void mad_encode_switch_info(void *buf, const struct ibmad_switch_info *info);
+void mad_decode_port_counters(const void *buf,
+			      struct ibmad_port_counters *pc);
+void mad_encode_port_counters(void *buf,
+			      const struct ibmad_port_counters *pc);
+void mad_decode_port_counters_ext(const void *buf,
+				  struct ibmad_port_counters_ext *pc);
+void mad_encode_port_counters_ext(void *buf,
+				  const struct ibmad_port_counters_ext *pc);
+void mad_decode_lft_block(const void *buf, uint8_t ports[IB_LFT_BLOCK_SIZE]);
+void mad_encode_lft_block(void *buf, const uint8_t ports[IB_LFT_BLOCK_SIZE]);
+
 /* mad.c */
 void *mad_encode(void *buf, ib_rpc_t *rpc, ib_dr_path_t *drpath, void *data);
 uint64_t mad_trid(void);
@@ -1495,6 +1663,35 @@ int mad_rpc_class_agent(struct ibmad_port *srcport, int cls);
 int mad_get_timeout(const struct ibmad_port *srcport, int override_ms);
 int mad_get_retries(const struct ibmad_port *srcport);
 
+/*
+ * Asynchronous RPCs.  mad_rpc_async_submit() sends the request, or queues it
+ * when the port already has "window" requests on the wire, and returns
+ * immediately.  Completions are reported from mad_rpc_async_poll() through
+ * cb; status is 0 on success, ETIMEDOUT once the retries are exhausted, EIO
+ * on a non zero MAD status (see rpc->rstatus) and ECANCELED from
+ * mad_rpc_async_cancel() or mad_rpc_close_port().  rpc, dport, payload and
+ * rcvdata must stay valid until cb runs; rpc->trid is assigned internally.
+ * A retries of 0 uses the port default, rpc->timeout overrides the port
+ * timeout as for mad_rpc().  RMPP is not supported.
+ *
+ * mad_rpc_portid() becomes readable when a completion is pending, so the
+ * port can be driven from an event loop by calling mad_rpc_async_poll()
+ * with a zero timeout.  Synchronous mad_rpc() calls on the same port discard
+ * responses to outstanding asynchronous requests and must not be mixed
+ * with them.
+ */
+typedef void (*mad_rpc_async_cb_t)(struct ibmad_port *port, ib_rpc_t *rpc,
+				   void *rcvdata, int status, void *context);
+
+int mad_rpc_async_set_window(struct ibmad_port *port, unsigned window);
+int mad_rpc_async_submit(struct ibmad_port *port, ib_rpc_t *rpc,
+			 ib_portid_t *dport, void *payload, void *rcvdata,
+			 int retries, mad_rpc_async_cb_t cb, void *context);
+/* Returns the number of completions, waits up to timeout_ms for the first */
+int mad_rpc_async_poll(struct ibmad_port *port, int timeout_ms);
+int mad_rpc_async_outstanding(struct ibmad_port *port);
+void mad_rpc_async_cancel(struct ibmad_port *port);
+
 /* register.c */
 int mad_register_port_client(int port_id, int mgmt, uint8_t rmpp_version);
 int mad_register_client(int mgmt, uint8_t rmpp_version)
@@ -0,0 +1,159 @@
+/* GPLv2 or OpenIB.org BSD (MIT) See COPYING file */
+
+#ifndef _MAD_CODEC_H_
+#define _MAD_CODEC_H_
+
+#include "mad_fields.h"
+
+/*
+ * Attribute layouts for the whole-attribute codecs in codec.c.
+ *
+ * Each entry is X(member, field): the codec moves field between the
+ * attribute and member, at the offset and width given by ib_mad_f[field],
+ * so the codecs produce exactly what mad_get_field()/mad_set_field() do.
+ * The matching _WORDS define is the attribute size in 32 bit words.
+ */
+
+#define IB_NODE_INFO_CODEC(X)						\
+	X(base_vers, IB_NODE_BASE_VERS_F)				\
+	X(class_vers, IB_NODE_CLASS_VERS_F)				\
+	X(node_type, IB_NODE_TYPE_F)					\
+	X(num_ports, IB_NODE_NPORTS_F)					\
+	X(system_guid, IB_NODE_SYSTEM_GUID_F)				\
+	X(node_guid, IB_NODE_GUID_F)					\
+	X(port_guid, IB_NODE_PORT_GUID_F)				\
+	X(partition_cap, IB_NODE_PARTITION_CAP_F)			\
+	X(device_id, IB_NODE_DEVID_F)					\
+	X(revision, IB_NODE_REVISION_F)					\
+	X(local_port, IB_NODE_LOCAL_PORT_F)				\
+	X(vendor_id, IB_NODE_VENDORID_F)
+#define IB_NODE_INFO_WORDS	10
+
+#define IB_PORT_INFO_CODEC(X)						\
+	X(mkey, IB_PORT_MKEY_F)						\
+	X(gid_prefix, IB_PORT_GID_PREFIX_F)				\
+	X(lid, IB_PORT_LID_F)						\
+	X(sm_lid, IB_PORT_SMLID_F)					\
+	X(cap_mask, IB_PORT_CAPMASK_F)					\
+	X(diag_code, IB_PORT_DIAG_F)					\
+	X(mkey_lease_period, IB_PORT_MKEY_LEASE_F)			\
+	X(local_port, IB_PORT_LOCAL_PORT_F)				\
+	X(link_width_enabled, IB_PORT_LINK_WIDTH_ENABLED_F)		\
+	X(link_width_supported, IB_PORT_LINK_WIDTH_SUPPORTED_F)		\
+	X(link_width_active, IB_PORT_LINK_WIDTH_ACTIVE_F)		\
+	X(link_speed_supported, IB_PORT_LINK_SPEED_SUPPORTED_F)		\
+	X(state, IB_PORT_STATE_F)					\
+	X(phys_state, IB_PORT_PHYS_STATE_F)				\
+	X(link_down_def_state, IB_PORT_LINK_DOWN_DEF_F)			\
+	X(mkey_prot_bits, IB_PORT_MKEY_PROT_BITS_F)			\
+	X(lmc, IB_PORT_LMC_F)						\
+	X(link_speed_active, IB_PORT_LINK_SPEED_ACTIVE_F)		\
+	X(link_speed_enabled, IB_PORT_LINK_SPEED_ENABLED_F)		\
+	X(neighbor_mtu, IB_PORT_NEIGHBOR_MTU_F)				\
+	X(sm_sl, IB_PORT_SMSL_F)					\
+	X(vl_cap, IB_PORT_VL_CAP_F)					\
+	X(init_type, IB_PORT_INIT_TYPE_F)				\
+	X(vl_high_limit, IB_PORT_VL_HIGH_LIMIT_F)			\
+	X(vl_arb_high_cap, IB_PORT_VL_ARBITRATION_HIGH_CAP_F)		\
+	X(vl_arb_low_cap, IB_PORT_VL_ARBITRATION_LOW_CAP_F)		\
+	X(init_type_reply, IB_PORT_INIT_TYPE_REPLY_F)			\
+	X(mtu_cap, IB_PORT_MTU_CAP_F)					\
+	X(vl_stall_count, IB_PORT_VL_STALL_COUNT_F)			\
+	X(hoq_life, IB_PORT_HOQ_LIFE_F)					\
+	X(oper_vls, IB_PORT_OPER_VLS_F)					\
+	X(part_enforce_inb, IB_PORT_PART_EN_INB_F)			\
+	X(part_enforce_outb, IB_PORT_PART_EN_OUTB_F)			\
+	X(filter_raw_inb, IB_PORT_FILTER_RAW_INB_F)			\
+	X(filter_raw_outb, IB_PORT_FILTER_RAW_OUTB_F)			\
+	X(mkey_violations, IB_PORT_MKEY_VIOL_F)				\
+	X(pkey_violations, IB_PORT_PKEY_VIOL_F)				\
+	X(qkey_violations, IB_PORT_QKEY_VIOL_F)				\
+	X(guid_cap, IB_PORT_GUID_CAP_F)					\
+	X(client_reregister, IB_PORT_CLIENT_REREG_F)			\
+	X(mcast_pkey_trap_suppr, IB_PORT_MCAST_PKEY_SUPR_ENAB_F)	\
+	X(subnet_timeout, IB_PORT_SUBN_TIMEOUT_F)			\
+	X(resp_time_val, IB_PORT_RESP_TIME_VAL_F)			\
+	X(local_phys_err, IB_PORT_LOCAL_PHYS_ERR_F)			\
+	X(overrun_err, IB_PORT_OVERRUN_ERR_F)				\
+	X(max_credit_hint, IB_PORT_MAX_CREDIT_HINT_F)			\
+	X(link_round_trip, IB_PORT_LINK_ROUND_TRIP_F)			\
+	X(cap_mask2, IB_PORT_CAPMASK2_F)				\
+	X(link_speed_ext_active, IB_PORT_LINK_SPEED_EXT_ACTIVE_F)	\
+	X(link_speed_ext_supported, IB_PORT_LINK_SPEED_EXT_SUPPORTED_F)	\
+	X(link_speed_ext_enabled, IB_PORT_LINK_SPEED_EXT_ENABLED_F)
+#define IB_PORT_INFO_WORDS	16
+
+#define IB_SWITCH_INFO_CODEC(X)						\
+	X(linear_fdb_cap, IB_SW_LINEAR_FDB_CAP_F)			\
+	X(random_fdb_cap, IB_SW_RANDOM_FDB_CAP_F)			\
+	X(mcast_fdb_cap, IB_SW_MCAST_FDB_CAP_F)				\
+	X(linear_fdb_top, IB_SW_LINEAR_FDB_TOP_F)			\
+	X(def_port, IB_SW_DEF_PORT_F)					\
+	X(def_mcast_prim_port, IB_SW_DEF_MCAST_PRIM_F)			\
+	X(def_mcast_not_prim_port, IB_SW_DEF_MCAST_NOT_PRIM_F)		\
+	X(life_time, IB_SW_LIFE_TIME_F)					\
+	X(state_change, IB_SW_STATE_CHANGE_F)				\
+	X(opt_sl2vl_mapping, IB_SW_OPT_SLTOVL_MAPPING_F)		\
+	X(lids_per_port, IB_SW_LIDS_PER_PORT_F)				\
+	X(partition_enforce_cap, IB_SW_PARTITION_ENFORCE_CAP_F)		\
+	X(inbound_part_enf, IB_SW_PARTITION_ENF_INB_F)			\
+	X(outbound_part_enf, IB_SW_PARTITION_ENF_OUTB_F)		\
+	X(filter_raw_inb, IB_SW_FILTER_RAW_INB_F)			\
+	X(filter_raw_outb, IB_SW_FILTER_RAW_OUTB_F)			\
+	X(enhanced_port0, IB_SW_ENHANCED_PORT0_F)			\
+	X(mcast_fdb_top, IB_SW_MCAST_FDB_TOP_F)
+#define IB_SWITCH_INFO_WORDS	5
+
+#define IB_PORT_COUNTERS_CODEC(X)					\
+	X(port_select, IB_PC_PORT_SELECT_F)				\
+	X(counter_select, IB_PC_COUNTER_SELECT_F)			\
+	X(symbol_errors, IB_PC_ERR_SYM_F)				\
+	X(link_recovers, IB_PC_LINK_RECOVERS_F)				\
+	X(link_downed, IB_PC_LINK_DOWNED_F)				\
+	X(rcv_errors, IB_PC_ERR_RCV_F)					\
+	X(rcv_remote_phys_errors, IB_PC_ERR_PHYSRCV_F)			\
+	X(rcv_switch_relay_errors, IB_PC_ERR_SWITCH_REL_F)		\
+	X(xmt_discards, IB_PC_XMT_DISCARDS_F)				\
+	X(xmt_constraint_errors, IB_PC_ERR_XMTCONSTR_F)			\
+	X(rcv_constraint_errors, IB_PC_ERR_RCVCONSTR_F)			\
+	X(counter_select2, IB_PC_COUNTER_SELECT2_F)			\
+	X(link_integrity_errors, IB_PC_ERR_LOCALINTEG_F)		\
+	X(excessive_buffer_overrun_errors, IB_PC_ERR_EXCESS_OVR_F)	\
+	X(qp1_dropped, IB_PC_QP1_DROP_F)				\
+	X(vl15_dropped, IB_PC_VL15_DROPPED_F)				\
+	X(xmt_data, IB_PC_XMT_BYTES_F)					\
+	X(rcv_data, IB_PC_RCV_BYTES_F)					\
+	X(xmt_pkts, IB_PC_XMT_PKTS_F)					\
+	X(rcv_pkts, IB_PC_RCV_PKTS_F)					\
+	X(xmt_wait, IB_PC_XMT_WAIT_F)
+#define IB_PORT_COUNTERS_WORDS	11
+
+#define IB_PORT_COUNTERS_EXT_CODEC(X)					\
+	X(port_select, IB_PC_EXT_PORT_SELECT_F)				\
+	X(counter_select, IB_PC_EXT_COUNTER_SELECT_F)			\
+	X(counter_select2, IB_PC_EXT_COUNTER_SELECT2_F)			\
+	X(xmt_data, IB_PC_EXT_XMT_BYTES_F)				\
+	X(rcv_data, IB_PC_EXT_RCV_BYTES_F)				\
+	X(xmt_pkts, IB_PC_EXT_XMT_PKTS_F)				\
+	X(rcv_pkts, IB_PC_EXT_RCV_PKTS_F)				\
+	X(unicast_xmt_pkts, IB_PC_EXT_XMT_UPKTS_F)			\
+	X(unicast_rcv_pkts, IB_PC_EXT_RCV_UPKTS_F)			\
+	X(multicast_xmt_pkts, IB_PC_EXT_XMT_MPKTS_F)			\
+	X(multicast_rcv_pkts, IB_PC_EXT_RCV_MPKTS_F)			\
+	X(symbol_errors, IB_PC_EXT_ERR_SYM_F)				\
+	X(link_recovers, IB_PC_EXT_LINK_RECOVERS_F)			\
+	X(link_downed, IB_PC_EXT_LINK_DOWNED_F)				\
+	X(rcv_errors, IB_PC_EXT_ERR_RCV_F)				\
+	X(rcv_remote_phys_errors, IB_PC_EXT_ERR_PHYSRCV_F)		\
+	X(rcv_switch_relay_errors, IB_PC_EXT_ERR_SWITCH_REL_F)		\
+	X(xmt_discards, IB_PC_EXT_XMT_DISCARDS_F)			\
+	X(xmt_constraint_errors, IB_PC_EXT_ERR_XMTCONSTR_F)		\
+	X(rcv_constraint_errors, IB_PC_EXT_ERR_RCVCONSTR_F)		\
+	X(link_integrity_errors, IB_PC_EXT_ERR_LOCALINTEG_F)		\
+	X(excessive_buffer_overrun_errors, IB_PC_EXT_ERR_EXCESS_OVR_F)	\
+	X(vl15_dropped, IB_PC_EXT_VL15_DROPPED_F)			\
+	X(xmt_wait, IB_PC_EXT_XMT_WAIT_F)				\
+	X(qp1_dropped, IB_PC_EXT_QP1_DROP_F)
+#define IB_PORT_COUNTERS_EXT_WORDS	46
+
+#endif /* _MAD_CODEC_H_ */
@@ -34,13 +34,28 @@
 #ifndef _MAD_INTERNAL_H_
 #define _MAD_INTERNAL_H_
 
+/*
+ * BITSOFFS and BE_OFFS are required due the fact that the bit offsets are inconsistently
+ * encoded in the IB spec - IB headers are encoded such that the bit offsets
+ * are in big endian convention (BE_OFFS), while the SMI/GSI queries data fields bit
+ * offsets are specified using real bit offset (?!)
+ * The following macros normalize everything to big endian offsets.
+ */
+#define BITSOFFS(o, w)	(((o) & ~31) | ((32 - ((o) & 31) - (w)))), (w)
+#define BE_OFFS(o, w)	(o), (w)
+#define BE_TO_BITSOFFS(o, w)	(((o) & ~31) | ((32 - ((o) & 31) - (w))))
+
 #define MAX_CLASS 256
+#define MAD_DEF_ASYNC_WINDOW 32
+
+struct mad_rpc_async;
 
 struct ibmad_port {
 	int port_id;		/* file descriptor returned by umad_open() */
 	int class_agents[MAX_CLASS];	/* class2agent mapper */
 	int timeout, retries;
 	uint64_t smp_mkey;
+	struct mad_rpc_async *async;	/* allocated on first async use */
 };
 
 extern struct ibmad_port *ibmp;
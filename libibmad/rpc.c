@@ -38,6 +38,8 @@
 #include <string.h>
 #include <errno.h>
 
+#include <ccan/container_of.h>
+#include <util/cl_qmap.h>
 #include <infiniband/umad.h>
 #include <infiniband/mad.h>
 
@@ -433,6 +435,313 @@ struct ibmad_port *mad_rpc_open_port(char *dev_name, int dev_port,
 
 void mad_rpc_close_port(struct ibmad_port *port)
 {
+	if (port->async) {
+		mad_rpc_async_cancel(port);
+		free(port->async);
+	}
 	umad_close_port(port->port_id);
 	free(port);
 }
+
+/*
+ * Asynchronous RPCs.
+ *
+ * Requests are matched to responses by the low 32 bits of the TID (the
+ * kernel owns the upper half), the same way _do_madrpc() does.  At most
+ * "window" requests are on the wire, the rest wait on a FIFO and are sent
+ * as earlier ones complete.  Timeouts and retries are left to the kernel
+ * MAD layer: a request that exhausts its retries comes back from
+ * umad_recv() with a non zero umad_status().
+ */
+struct mad_async_req {
+	cl_map_item_t on_wire;
+	struct mad_async_req *next;
+	ib_rpc_t *rpc;
+	ib_portid_t *dport;
+	void *payload;
+	void *rcvdata;
+	int retries;
+	mad_rpc_async_cb_t cb;
+	void *context;
+};
+
+struct mad_rpc_async {
+	cl_qmap_t on_wire;
+	struct mad_async_req *queue_head, *queue_tail;
+	unsigned window;
+	unsigned num_on_wire;
+	unsigned num_queued;
+};
+
+static struct mad_rpc_async *async_get(struct ibmad_port *port)
+{
+	struct mad_rpc_async *async = port->async;
+
+	if (async)
+		return async;
+
+	async = calloc(1, sizeof(*async));
+	if (!async) {
+		errno = ENOMEM;
+		return NULL;
+	}
+	cl_qmap_init(&async->on_wire);
+	async->window = MAD_DEF_ASYNC_WINDOW;
+	port->async = async;
+	return async;
+}
+
+static void async_complete(struct ibmad_port *port, struct mad_async_req *req,
+			   int status)
+{
+	ib_rpc_v1_t *rpcv1 = (ib_rpc_v1_t *)req->rpc;
+
+	if ((req->rpc->mgtclass & IB_MAD_RPC_VERSION_MASK) ==
+	    IB_MAD_RPC_VERSION1)
+		rpcv1->error = status;
+	req->cb(port, req->rpc, req->rcvdata, status, req->context);
+	free(req);
+}
+
+static int async_send(struct ibmad_port *port, struct mad_async_req *req)
+{
+	struct mad_rpc_async *async = port->async;
+	uint8_t sndbuf[1024];
+	ib_rpc_t *rpc = req->rpc;
+	int len;
+
+	memset(sndbuf, 0, umad_size() + IB_MAD_SIZE);
+
+	/* a fresh TID per send, redirected requests included */
+	rpc->trid = mad_trid();
+	if ((len = mad_build_pkt(sndbuf, rpc, req->dport, NULL,
+				 req->payload)) < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (ibdebug > 1) {
+		IBWARN(">>> sending: len %d pktsz %zu", len, umad_size() + len);
+		xdump(stderr, "send buf\n", sndbuf, umad_size() + len);
+	}
+
+	if (umad_send(port->port_id, port->class_agents[rpc->mgtclass & 0xff],
+		      sndbuf, len, mad_get_timeout(port, rpc->timeout),
+		      req->retries - 1) < 0) {
+		IBWARN("send failed; %s", strerror(errno));
+		return -1;
+	}
+
+	cl_qmap_insert(&async->on_wire, (uint32_t)rpc->trid, &req->on_wire);
+	async->num_on_wire++;
+	return 0;
+}
+
+/* Fill the window from the queue, returns the number of failed sends */
+static int async_dispatch(struct ibmad_port *port)
+{
+	struct mad_rpc_async *async = port->async;
+	struct mad_async_req *req;
+	int n = 0;
+
+	while (async->queue_head && async->num_on_wire < async->window) {
+		req = async->queue_head;
+		async->queue_head = req->next;
+		if (!async->queue_head)
+			async->queue_tail = NULL;
+		async->num_queued--;
+
+		if (async_send(port, req) < 0) {
+			async_complete(port, req, errno);
+			n++;
+		}
+	}
+	return n;
+}
+
+/*
+ * Read and process one MAD.  Returns the number of completed requests, or
+ * -ETIMEDOUT if nothing arrived within timeout_ms.
+ */
+static int async_recv(struct ibmad_port *port, int timeout_ms)
+{
+	struct mad_rpc_async *async = port->async;
+	uint8_t rcvbuf[1024], *mad;
+	struct mad_async_req *req;
+	cl_map_item_t *item;
+	int length, status, rc;
+	uint32_t trid;
+
+	if ((rc = umad_poll(port->port_id, timeout_ms)) < 0)
+		return rc;
+
+	length = IB_MAD_SIZE;
+	if (umad_recv(port->port_id, rcvbuf, &length, 0) < 0) {
+		IBWARN("recv failed: %s", strerror(errno));
+		return -errno;
+	}
+
+	mad = umad_get_mad(rcvbuf);
+	if (ibdebug > 1) {
+		IBWARN("rcv buf:");
+		xdump(stderr, "rcv buf\n", mad, IB_MAD_SIZE);
+	}
+
+	trid = (uint32_t)mad_get_field64(mad, 0, IB_MAD_TRID_F);
+	item = cl_qmap_remove(&async->on_wire, trid);
+	if (item == cl_qmap_end(&async->on_wire)) {
+		DEBUG("dropping MAD with unknown trid 0x%x", trid);
+		return 0;
+	}
+	req = container_of(item, struct mad_async_req, on_wire);
+	async->num_on_wire--;
+
+	status = umad_status(rcvbuf);
+	if (status && status != ENOMEM) {
+		ERRS("timeout after %d retries, %d ms; dport (%s)",
+		     req->retries,
+		     mad_get_timeout(port, req->rpc->timeout) * req->retries,
+		     portid2str(req->dport));
+		async_complete(port, req, ETIMEDOUT);
+		return 1 + async_dispatch(port);
+	}
+
+	status = mad_get_field(mad, 0, IB_DRSMP_STATUS_F);
+	if (status == IB_MAD_STS_REDIRECT && !redirect_port(req->dport, mad)) {
+		if (async_send(port, req) == 0)
+			return 0;
+		async_complete(port, req, errno);
+		return 1 + async_dispatch(port);
+	}
+
+	req->rpc->rstatus = status;
+	if (status != 0) {
+		ERRS("MAD completed with error status 0x%x; dport (%s)",
+		     status, portid2str(req->dport));
+		async_complete(port, req, EIO);
+		return 1 + async_dispatch(port);
+	}
+
+	if (req->rcvdata)
+		memcpy(req->rcvdata, mad + req->rpc->dataoffs,
+		       req->rpc->datasz);
+	async_complete(port, req, 0);
+	return 1 + async_dispatch(port);
+}
+
+int mad_rpc_async_set_window(struct ibmad_port *port, unsigned window)
+{
+	struct mad_rpc_async *async;
+
+	if (!window) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (!(async = async_get(port)))
+		return -1;
+	async->window = window;
+	return 0;
+}
+
+int mad_rpc_async_submit(struct ibmad_port *port, ib_rpc_t *rpc,
+			 ib_portid_t *dport, void *payload, void *rcvdata,
+			 int retries, mad_rpc_async_cb_t cb, void *context)
+{
+	struct mad_rpc_async *async;
+	struct mad_async_req *req;
+
+	if (!cb || retries < 0) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (!(async = async_get(port)))
+		return -1;
+
+	req = calloc(1, sizeof(*req));
+	if (!req) {
+		errno = ENOMEM;
+		return -1;
+	}
+	req->rpc = rpc;
+	req->dport = dport;
+	req->payload = payload;
+	req->rcvdata = rcvdata;
+	req->retries = retries ? retries : mad_get_retries(port);
+	req->cb = cb;
+	req->context = context;
+
+	if (async->num_on_wire < async->window && !async->queue_head) {
+		if (async_send(port, req) < 0) {
+			free(req);
+			return -1;
+		}
+		return 0;
+	}
+
+	if (async->queue_tail)
+		async->queue_tail->next = req;
+	else
+		async->queue_head = req;
+	async->queue_tail = req;
+	async->num_queued++;
+	return 0;
+}
+
+int mad_rpc_async_poll(struct ibmad_port *port, int timeout_ms)
+{
+	struct mad_rpc_async *async = port->async;
+	int n, rc;
+
+	if (!async)
+		return 0;
+
+	n = async_dispatch(port);
+	while (async->num_on_wire) {
+		rc = async_recv(port, n ? 0 : timeout_ms);
+		if (rc == -ETIMEDOUT)
+			break;
+		if (rc < 0) {
+			if (n)
+				break;
+			errno = -rc;
+			return -1;
+		}
+		n += rc;
+		/* after the first MAD only drain what is already queued */
+		timeout_ms = 0;
+	}
+	return n;
+}
+
+int mad_rpc_async_outstanding(struct ibmad_port *port)
+{
+	struct mad_rpc_async *async = port->async;
+
+	return async ? async->num_on_wire + async->num_queued : 0;
+}
+
+void mad_rpc_async_cancel(struct ibmad_port *port)
+{
+	struct mad_rpc_async *async = port->async;
+	struct mad_async_req *req;
+	cl_map_item_t *item;
+
+	if (!async)
+		return;
+
+	/* late responses to these are dropped on the TID lookup */
+	while ((item = cl_qmap_head(&async->on_wire)) !=
+	       cl_qmap_end(&async->on_wire)) {
+		cl_qmap_remove_item(&async->on_wire, item);
+		async->num_on_wire--;
+		async_complete(port, container_of(item, struct mad_async_req,
+						  on_wire), ECANCELED);
+	}
+
+	while ((req = async->queue_head)) {
+		async->queue_head = req->next;
+		async->num_queued--;
+		async_complete(port, req, ECANCELED);
+	}
+	async->queue_tail = NULL;
+}
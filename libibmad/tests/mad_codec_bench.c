@@ -0,0 +1,158 @@
+/* GPLv2 or OpenIB.org BSD (MIT) See COPYING file */
+
+/*
+ * Checks that the whole-attribute codecs are bit exact with
+ * mad_get_field()/mad_set_field() and compares their decode throughput.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <infiniband/mad.h>
+
+#include "../mad_codec.h"
+
+static unsigned failures;
+
+static void fill_random(uint8_t *buf, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = random();
+}
+
+static uint64_t get_field(uint8_t *buf, enum MAD_FIELDS field, unsigned bitlen)
+{
+	if (bitlen == 64)
+		return mad_get_field64(buf, 0, field);
+	return mad_get_field(buf, 0, field);
+}
+
+static void set_field(uint8_t *buf, enum MAD_FIELDS field, unsigned bitlen,
+		      uint64_t val)
+{
+	if (bitlen == 64)
+		mad_set_field64(buf, 0, field, val);
+	else
+		mad_set_field(buf, 0, field, val);
+}
+
+#define CHECK_GET(member, field)					\
+	if ((uint64_t)v.member !=					\
+	    get_field(buf, field, ib_mad_f[field].bitlen)) {		\
+		printf("%s: decode mismatch\n", #member);		\
+		failures++;						\
+	}
+#define SET(member, field)						\
+	set_field(ref, field, ib_mad_f[field].bitlen, v.member);
+
+#define CHECK_CODEC(name, type, LAYOUT)					\
+static void check_##name(void)						\
+{									\
+	uint8_t buf[IB_SMP_DATA_SIZE * 4], enc[sizeof(buf)];		\
+	uint8_t ref[sizeof(buf)];					\
+	type v;								\
+	int i;								\
+									\
+	for (i = 0; i < 1000; i++) {					\
+		fill_random(buf, sizeof(buf));				\
+		mad_decode_##name(buf, &v);				\
+		LAYOUT(CHECK_GET)					\
+									\
+		fill_random(enc, sizeof(enc));				\
+		memcpy(ref, enc, sizeof(ref));				\
+		mad_encode_##name(enc, &v);				\
+		LAYOUT(SET)						\
+		if (memcmp(enc, ref, sizeof(ref))) {			\
+			printf("%s: encode mismatch\n", #name);		\
+			failures++;					\
+		}							\
+	}								\
+}
+
+CHECK_CODEC(node_info, struct ibmad_node_info, IB_NODE_INFO_CODEC)
+CHECK_CODEC(port_info, struct ibmad_port_info, IB_PORT_INFO_CODEC)
+CHECK_CODEC(switch_info, struct ibmad_switch_info, IB_SWITCH_INFO_CODEC)
+CHECK_CODEC(port_counters, struct ibmad_port_counters, IB_PORT_COUNTERS_CODEC)
+CHECK_CODEC(port_counters_ext, struct ibmad_port_counters_ext,
+	    IB_PORT_COUNTERS_EXT_CODEC)
+
+#define FIELD_GET(member, field)					\
+	v.member = get_field(buf, field, ib_mad_f[field].bitlen);
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#define BENCH_CODEC(name, type, LAYOUT)					\
+static void bench_##name(unsigned iters)				\
+{									\
+	uint8_t buf[IB_SMP_DATA_SIZE * 4];				\
+	volatile uint64_t sink = 0;					\
+	double start, fields, codec;					\
+	type v;								\
+	unsigned i;							\
+									\
+	fill_random(buf, sizeof(buf));					\
+									\
+	start = now();							\
+	for (i = 0; i < iters; i++) {					\
+		buf[0] = i;						\
+		LAYOUT(FIELD_GET)					\
+		sink += ((uint8_t *)&v)[i % sizeof(v)];			\
+	}								\
+	fields = now() - start;						\
+									\
+	start = now();							\
+	for (i = 0; i < iters; i++) {					\
+		buf[0] = i;						\
+		mad_decode_##name(buf, &v);				\
+		sink += ((uint8_t *)&v)[i % sizeof(v)];			\
+	}								\
+	codec = now() - start;						\
+									\
+	printf("%-20s mad_get_field %8.1f ns  codec %8.1f ns  x%.1f\n",	\
+	       #name, fields * 1e9 / iters, codec * 1e9 / iters,	\
+	       fields / codec);						\
+	(void)sink;							\
+}
+
+BENCH_CODEC(node_info, struct ibmad_node_info, IB_NODE_INFO_CODEC)
+BENCH_CODEC(port_info, struct ibmad_port_info, IB_PORT_INFO_CODEC)
+BENCH_CODEC(switch_info, struct ibmad_switch_info, IB_SWITCH_INFO_CODEC)
+BENCH_CODEC(port_counters, struct ibmad_port_counters, IB_PORT_COUNTERS_CODEC)
+BENCH_CODEC(port_counters_ext, struct ibmad_port_counters_ext,
+	    IB_PORT_COUNTERS_EXT_CODEC)
+
+int main(int argc, char **argv)
+{
+	unsigned iters = argc > 1 ? strtoul(argv[1], NULL, 0) : 1000000;
+
+	srandom(time(NULL));
+
+	check_node_info();
+	check_port_info();
+	check_switch_info();
+	check_port_counters();
+	check_port_counters_ext();
+	if (failures) {
+		printf("%u codec mismatches\n", failures);
+		return 1;
+	}
+	printf("codecs match mad_get_field/mad_set_field\n\n");
+
+	printf("decode time per attribute, %u iterations:\n", iters);
+	bench_node_info(iters);
+	bench_port_info(iters);
+	bench_switch_info(iters);
+	bench_port_counters(iters);
+	bench_port_counters_ext(iters);
+	return 0;
+}
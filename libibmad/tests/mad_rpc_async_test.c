@@ -0,0 +1,249 @@
+/* GPLv2 or OpenIB.org BSD (MIT) See COPYING file */
+
+/*
+ * Checks the asynchronous RPC API of rpc.c against the mock umad port of
+ * umad_mock.c: the window bounds the requests on the wire and the queued
+ * ones follow in order, responses complete the request they belong to,
+ * timeout and retry settings reach umad_send(), and timeouts, error
+ * statuses and cancellation are reported through the callback.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <infiniband/mad.h>
+
+#include "umad_mock.h"
+#include "../mad_internal.h"
+
+#define TEST_AGENT	7
+#define TEST_MAX_REQS	64
+
+struct test_req {
+	ib_rpc_t rpc;
+	ib_portid_t dport;
+	uint8_t payload[IB_PC_DATA_SZ];
+	uint8_t rcvdata[IB_PC_DATA_SZ];
+	int status;
+	unsigned done;		/* completion order, from 1 */
+};
+
+static struct test_req reqs[TEST_MAX_REQS];
+static unsigned num_done;
+static unsigned failures;
+
+#define CHECK(cond)							\
+	do {								\
+		if (!(cond)) {						\
+			printf("%s:%d: check failed: %s\n", __func__,	\
+			       __LINE__, #cond);			\
+			failures++;					\
+		}							\
+	} while (0)
+
+static void test_cb(struct ibmad_port *port, ib_rpc_t *rpc, void *rcvdata,
+		    int status, void *context)
+{
+	struct test_req *req = context;
+
+	CHECK(rpc == &req->rpc);
+	CHECK(rcvdata == req->rcvdata);
+	CHECK(!req->done);
+	req->status = status;
+	req->done = ++num_done;
+}
+
+static struct ibmad_port *open_port(void)
+{
+	struct ibmad_port *port;
+
+	port = calloc(1, sizeof(*port));
+	if (!port) {
+		perror("calloc");
+		exit(1);
+	}
+	port->port_id = 3;
+	port->class_agents[IB_PERFORMANCE_CLASS] = TEST_AGENT;
+	return port;
+}
+
+static int submit(struct ibmad_port *port, unsigned i, int timeout,
+		  int retries)
+{
+	struct test_req *req = &reqs[i];
+
+	memset(req, 0, sizeof(*req));
+	req->rpc.mgtclass = IB_PERFORMANCE_CLASS;
+	req->rpc.method = IB_MAD_METHOD_GET;
+	req->rpc.attr.id = IB_GSI_PORT_COUNTERS;
+	req->rpc.timeout = timeout;
+	req->rpc.datasz = IB_PC_DATA_SZ;
+	req->rpc.dataoffs = IB_PC_DATA_OFFS;
+	ib_portid_set(&req->dport, i + 1, 1, IB_DEFAULT_QP1_QKEY);
+	memset(req->payload, i + 1, sizeof(req->payload));
+
+	return mad_rpc_async_submit(port, &req->rpc, &req->dport,
+				    req->payload, req->rcvdata, retries,
+				    test_cb, req);
+}
+
+/* The request whose MAD is send idx, by the destination LID */
+static struct test_req *sent_req(unsigned idx)
+{
+	const struct umad_mock_send *s = umad_mock_sent(idx);
+	unsigned i;
+
+	for (i = 0; i < TEST_MAX_REQS; i++)
+		if ((uint32_t)reqs[i].rpc.trid == (uint32_t)s->trid)
+			return &reqs[i];
+	return NULL;
+}
+
+static void reset(void)
+{
+	memset(reqs, 0, sizeof(reqs));
+	num_done = 0;
+}
+
+static void test_window(void)
+{
+	struct ibmad_port *port = open_port();
+	unsigned window = 4, n = 10, sent, answered = 0, i;
+	struct test_req *req;
+
+	reset();
+	CHECK(mad_rpc_async_set_window(port, 0) < 0 && errno == EINVAL);
+	CHECK(!mad_rpc_async_set_window(port, window));
+
+	sent = umad_mock_num_sent();
+	for (i = 0; i < n; i++)
+		CHECK(!submit(port, i, 0, 0));
+	CHECK(umad_mock_num_sent() - sent == window);
+	CHECK(mad_rpc_async_outstanding(port) == n);
+
+	/* Nothing answered yet: polling completes nothing, sends nothing */
+	CHECK(mad_rpc_async_poll(port, 0) == 0);
+	CHECK(umad_mock_num_sent() - sent == window);
+
+	/* Answer the second request first, the completions follow the wire */
+	umad_mock_respond(sent + 1, 0);
+	CHECK(mad_rpc_async_poll(port, 0) == 1);
+	CHECK(reqs[1].done == 1 && reqs[0].done == 0);
+	CHECK(umad_mock_num_sent() - sent == window + 1);
+	answered++;
+
+	while (answered < n) {
+		/* Never more than the window unanswered on the wire */
+		CHECK(umad_mock_num_sent() - sent - answered <= window);
+		for (i = sent; i < umad_mock_num_sent(); i++) {
+			req = sent_req(i);
+			if (req && !req->done && i != sent + 1) {
+				umad_mock_respond(i, 0);
+				answered++;
+			}
+		}
+		CHECK(mad_rpc_async_poll(port, 0) > 0);
+	}
+
+	CHECK(umad_mock_num_sent() - sent == n);
+	CHECK(mad_rpc_async_outstanding(port) == 0);
+	CHECK(num_done == n);
+	for (i = 0; i < n; i++) {
+		CHECK(reqs[i].status == 0);
+		CHECK(!memcmp(reqs[i].rcvdata, reqs[i].payload,
+			      sizeof(reqs[i].rcvdata)));
+		/* Queued requests go out in submission order */
+		CHECK(sent_req(sent + i) == &reqs[i]);
+		CHECK(umad_mock_sent(sent + i)->agent == TEST_AGENT);
+	}
+	CHECK(umad_mock_num_pending() == 0);
+	mad_rpc_close_port(port);
+}
+
+static void test_timeout(void)
+{
+	struct ibmad_port *port = open_port();
+	unsigned sent = umad_mock_num_sent();
+
+	reset();
+	port->timeout = 40;
+	port->retries = 5;
+
+	/* The rpc timeout and explicit retries win over the port defaults */
+	CHECK(!submit(port, 0, 250, 3));
+	CHECK(umad_mock_sent(sent)->timeout_ms == 250);
+	CHECK(umad_mock_sent(sent)->retries == 2);
+
+	CHECK(!submit(port, 1, 0, 0));
+	CHECK(umad_mock_sent(sent + 1)->timeout_ms == 40);
+	CHECK(umad_mock_sent(sent + 1)->retries == 4);
+
+	umad_mock_time_out(sent);
+	umad_mock_respond(sent + 1, 0);
+	CHECK(mad_rpc_async_poll(port, 0) == 2);
+	CHECK(reqs[0].status == ETIMEDOUT && reqs[0].done == 1);
+	CHECK(reqs[1].status == 0 && reqs[1].done == 2);
+	CHECK(mad_rpc_async_outstanding(port) == 0);
+
+	/* A non zero MAD status is EIO with the status in rstatus */
+	CHECK(!submit(port, 2, 0, 0));
+	umad_mock_respond(sent + 2, 0x1c);
+	CHECK(mad_rpc_async_poll(port, 0) == 1);
+	CHECK(reqs[2].status == EIO && reqs[2].rpc.rstatus == 0x1c);
+	mad_rpc_close_port(port);
+}
+
+static void test_cancel(void)
+{
+	struct ibmad_port *port = open_port();
+	unsigned sent = umad_mock_num_sent(), i;
+
+	reset();
+	CHECK(!mad_rpc_async_set_window(port, 2));
+	for (i = 0; i < 5; i++)
+		CHECK(!submit(port, i, 0, 0));
+	CHECK(umad_mock_num_sent() - sent == 2);
+
+	mad_rpc_async_cancel(port);
+	CHECK(num_done == 5);
+	for (i = 0; i < 5; i++)
+		CHECK(reqs[i].status == ECANCELED);
+	CHECK(mad_rpc_async_outstanding(port) == 0);
+	/* Cancelled requests that were still queued are never sent */
+	CHECK(umad_mock_num_sent() - sent == 2);
+
+	/* A late response to a cancelled request is dropped */
+	umad_mock_respond(sent, 0);
+	CHECK(mad_rpc_async_poll(port, 0) == 0);
+	CHECK(num_done == 5);
+
+	/* The port works on after a cancel */
+	CHECK(!submit(port, 5, 0, 0));
+	umad_mock_respond(umad_mock_num_sent() - 1, 0);
+	CHECK(mad_rpc_async_poll(port, 0) == 1);
+	CHECK(reqs[5].status == 0);
+
+	/* Closing the port cancels what is outstanding */
+	for (i = 6; i < 9; i++)
+		CHECK(!submit(port, i, 0, 0));
+	mad_rpc_close_port(port);
+	for (i = 6; i < 9; i++)
+		CHECK(reqs[i].status == ECANCELED);
+	CHECK(num_done == 9);
+}
+
+int main(int argc, char **argv)
+{
+	test_window();
+	test_timeout();
+	test_cancel();
+
+	if (failures) {
+		printf("%u checks failed\n", failures);
+		return 1;
+	}
+	printf("async RPC checks passed\n");
+	return 0;
+}
@@ -0,0 +1,132 @@
+/* GPLv2 or OpenIB.org BSD (MIT) See COPYING file */
+
+/*
+ * Mock umad port for the libibmad RPC code.  Records every MAD sent and
+ * answers them only when told to, so a test decides which requests complete
+ * and in what order:
+ *
+ *  - umad_mock_respond() queues the request back as a GetResp with the
+ *    given MAD status, the payload echoed as the response data.
+ *  - umad_mock_time_out() queues the request back with a non zero umad
+ *    status, the way the kernel returns a send whose retries ran out.
+ *
+ * umad_poll() never waits, it reports a timeout when nothing is queued.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <infiniband/umad.h>
+#include <infiniband/mad.h>
+
+#include "umad_mock.h"
+
+#define MOCK_MAX_SENDS	1024
+
+struct mock_response {
+	unsigned idx;
+	int status;
+};
+
+static struct umad_mock_send sends[MOCK_MAX_SENDS];
+static unsigned num_sends;
+
+static struct mock_response responses[MOCK_MAX_SENDS];
+static unsigned resp_head, resp_tail;
+
+unsigned umad_mock_num_sent(void)
+{
+	return num_sends;
+}
+
+const struct umad_mock_send *umad_mock_sent(unsigned idx)
+{
+	if (idx >= num_sends) {
+		fprintf(stderr, "umad mock: no send %u\n", idx);
+		abort();
+	}
+	return &sends[idx];
+}
+
+static void queue_response(unsigned idx, int status)
+{
+	if (resp_tail - resp_head == MOCK_MAX_SENDS) {
+		fprintf(stderr, "umad mock: response queue full\n");
+		abort();
+	}
+	responses[resp_tail % MOCK_MAX_SENDS].idx = idx;
+	responses[resp_tail % MOCK_MAX_SENDS].status = status;
+	resp_tail++;
+}
+
+void umad_mock_respond(unsigned idx, uint16_t mad_status)
+{
+	struct umad_mock_send *s = (struct umad_mock_send *)umad_mock_sent(idx);
+
+	mad_set_field(s->mad, 0, IB_MAD_METHOD_F, IB_MAD_METHOD_GET_RESPONSE);
+	mad_set_field(s->mad, 0, IB_MAD_RESPONSE_F, 1);
+	mad_set_field(s->mad, 0, IB_MAD_STATUS_F, mad_status);
+	queue_response(idx, 0);
+}
+
+void umad_mock_time_out(unsigned idx)
+{
+	umad_mock_sent(idx);
+	queue_response(idx, ETIMEDOUT);
+}
+
+unsigned umad_mock_num_pending(void)
+{
+	return resp_tail - resp_head;
+}
+
+int umad_mock_send(int fd, int agentid, void *umad, int length,
+		   int timeout_ms, int retries)
+{
+	struct umad_mock_send *s;
+
+	if (num_sends == MOCK_MAX_SENDS || length > sizeof(s->mad))
+		return -EINVAL;
+
+	s = &sends[num_sends++];
+	s->agent = agentid;
+	s->timeout_ms = timeout_ms;
+	s->retries = retries;
+	memset(s->mad, 0, sizeof(s->mad));
+	memcpy(s->mad, umad_get_mad(umad), length);
+	s->trid = mad_get_field64(s->mad, 0, IB_MAD_TRID_F);
+	return 0;
+}
+
+int umad_mock_recv(int fd, void *umad, int *length, int timeout_ms)
+{
+	struct mock_response *r;
+	struct umad_mock_send *s;
+
+	if (resp_head == resp_tail)
+		return -EWOULDBLOCK;
+
+	r = &responses[resp_head++ % MOCK_MAX_SENDS];
+	s = &sends[r->idx];
+	if (*length < sizeof(s->mad))
+		return -ENOSPC;
+
+	memset(umad, 0, umad_size());
+	((struct ib_user_mad *)umad)->agent_id = s->agent;
+	((struct ib_user_mad *)umad)->status = r->status;
+	memcpy(umad_get_mad(umad), s->mad, sizeof(s->mad));
+	*length = sizeof(s->mad);
+	return s->agent;
+}
+
+int umad_mock_poll(int fd, int timeout_ms)
+{
+	return resp_head == resp_tail ? -ETIMEDOUT : 0;
+}
+
+int umad_mock_close_port(int fd)
+{
+	return 0;
+}
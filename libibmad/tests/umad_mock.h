@@ -0,0 +1,50 @@
+/* GPLv2 or OpenIB.org BSD (MIT) See COPYING file */
+
+/*
+ * Mock umad port for running the libibmad RPC code without hardware, see
+ * umad_mock.c.  This header is force included in every source of the mock
+ * build, so the MAD send and receive calls reach the mock.
+ */
+
+#ifndef UMAD_MOCK_H
+#define UMAD_MOCK_H
+
+#include <config.h>
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* mad.h first, so its ntohll/htonll stay in effect as in the library */
+#include <infiniband/mad.h>
+#include <infiniband/umad.h>
+
+/* A MAD handed to umad_send() */
+struct umad_mock_send {
+	int agent;
+	int timeout_ms;
+	int retries;
+	uint64_t trid;
+	uint8_t mad[256];
+};
+
+unsigned umad_mock_num_sent(void);
+const struct umad_mock_send *umad_mock_sent(unsigned idx);
+/* Queue the response to send idx: the request echoed with mad_status */
+void umad_mock_respond(unsigned idx, uint16_t mad_status);
+/* Queue send idx back with a timeout status, as once its retries ran out */
+void umad_mock_time_out(unsigned idx);
+/* Responses queued and not read yet */
+unsigned umad_mock_num_pending(void);
+
+int umad_mock_send(int fd, int agentid, void *umad, int length,
+		   int timeout_ms, int retries);
+int umad_mock_recv(int fd, void *umad, int *length, int timeout_ms);
+int umad_mock_poll(int fd, int timeout_ms);
+int umad_mock_close_port(int fd);
+
+#define umad_send(...) umad_mock_send(__VA_ARGS__)
+#define umad_recv(...) umad_mock_recv(__VA_ARGS__)
+#define umad_poll(...) umad_mock_poll(__VA_ARGS__)
+#define umad_close_port(...) umad_mock_close_port(__VA_ARGS__)
+
+#endif
@@ -0,0 +1,104 @@
+/* GPLv2 or OpenIB.org BSD (MIT) See COPYING file */
+
+/*
+ * Measures umad_get_port() and umad_get_ca() latency with the CA cache warm
+ * and, by flushing it with umad_done() before each call, cold.
+ *
+ * usage: umad_port_bench [ca_name [port [iterations]]]
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <infiniband/umad.h>
+
+static char *ca_name;
+static int portnum;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int get_port(int flush)
+{
+	umad_port_t port;
+
+	if (flush)
+		umad_done();
+	if (umad_get_port(ca_name, portnum, &port) < 0)
+		return -1;
+	umad_release_port(&port);
+	return 0;
+}
+
+static int get_ca(int flush)
+{
+	umad_ca_t ca;
+
+	if (flush)
+		umad_done();
+	if (umad_get_ca(ca_name, &ca) < 0)
+		return -1;
+	umad_release_ca(&ca);
+	return 0;
+}
+
+static int bench(const char *name, int (*fn)(int flush), unsigned iters)
+{
+	double start, cold, warm;
+	unsigned i;
+
+	start = now();
+	for (i = 0; i < iters; i++)
+		if (fn(1))
+			goto err;
+	cold = now() - start;
+
+	start = now();
+	for (i = 0; i < iters; i++)
+		if (fn(0))
+			goto err;
+	warm = now() - start;
+
+	printf("%-14s uncached %8.1f us  cached %8.1f us  x%.1f\n", name,
+	       cold * 1e6 / iters, warm * 1e6 / iters, cold / warm);
+	return 0;
+
+err:
+	fprintf(stderr, "%s failed on %s port %d\n", name,
+		ca_name ? ca_name : "(default)", portnum);
+	return -1;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned iters = 1000;
+
+	if (argc > 1)
+		ca_name = argv[1];
+	if (argc > 2)
+		portnum = atoi(argv[2]);
+	if (argc > 3)
+		iters = strtoul(argv[3], NULL, 0);
+
+	if (umad_init() < 0) {
+		fprintf(stderr, "umad_init failed\n");
+		return 1;
+	}
+
+	printf("latency per call, %u iterations:\n", iters);
+	if (bench("umad_get_port", get_port, iters) ||
+	    bench("umad_get_ca", get_ca, iters))
+		return 1;
+
+	umad_done();
+	return 0;
+}
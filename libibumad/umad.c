@@ -46,6 +46,7 @@
 #include <dirent.h>
 #include <ctype.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <util/compiler.h>
 
 #include <infiniband/umad.h>
@@ -116,18 +117,253 @@ static unsigned int get_abi_version(void)
 }
 
 /*************************************
- * Port
+ * CA cache
+ *
+ * Everything that only changes when a device is registered - the CA
+ * attributes, the list of ports, their link layer and the size of the
+ * pkey table - is read from sysfs once and kept here.  Port state, LIDs,
+ * the GID and the pkey values can change at any time without any
+ * notification from the kernel, so those are still read on every call.
+ *
+ * An entry is validated against the inode of the device directory: kernfs
+ * hands out a new one every time a device is registered, so one stat()
+ * catches removal, re-registration and renames.
  */
-static int find_cached_ca(const char *ca_name, umad_ca_t * ca)
+struct cached_port {
+	int present;
+	char link_layer[UMAD_CA_NAME_LEN];
+	unsigned num_pkeys;
+};
+
+struct cached_ca {
+	struct cached_ca *next;
+	unsigned refcnt;
+	dev_t dev;
+	ino_t ino;
+	char ca_name[UMAD_CA_NAME_LEN];
+	unsigned node_type;
+	int numports;
+	char fw_ver[20];
+	char ca_type[40];
+	char hw_ver[20];
+	__be64 node_guid;
+	__be64 system_guid;
+	struct cached_port ports[UMAD_CA_MAX_PORTS];
+};
+
+static pthread_mutex_t ca_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct cached_ca *ca_cache;
+
+static int check_for_digit_name(const struct dirent *dent)
+{
+	const char *p = dent->d_name;
+	while (*p && isdigit(*p))
+		p++;
+	return *p ? 0 : 1;
+}
+
+static void put_ca(struct cached_ca *ca)
 {
-	return 0;		/* caching not implemented yet */
+	pthread_mutex_lock(&ca_cache_lock);
+	if (--ca->refcnt)
+		ca = NULL;
+	pthread_mutex_unlock(&ca_cache_lock);
+	free(ca);
 }
 
-static int put_ca(umad_ca_t * ca)
+/* Must be called with ca_cache_lock held, the caller drops the reference */
+static struct cached_ca *unlink_cached_ca(const char *ca_name)
 {
-	return 0;		/* caching not implemented yet */
+	struct cached_ca *ca, **p;
+
+	for (p = &ca_cache; (ca = *p); p = &ca->next) {
+		if (!strcmp(ca->ca_name, ca_name)) {
+			*p = ca->next;
+			return ca;
+		}
+	}
+	return NULL;
+}
+
+static int load_port(const char *ca_name, const char *dir, int portnum,
+		     struct cached_port *port)
+{
+	char port_dir[256];
+	struct dirent **namelist;
+	int i, len, num_pkeys;
+
+	len = snprintf(port_dir, sizeof(port_dir), "%s/%d", dir, portnum);
+	if (len < 0 || len > sizeof(port_dir))
+		return -EIO;
+
+	if (sys_read_string(port_dir, SYS_PORT_LINK_LAYER,
+	    port->link_layer, UMAD_CA_NAME_LEN) < 0)
+		/* assume IB by default */
+		sprintf(port->link_layer, "IB");
+
+	snprintf(port_dir + len, sizeof(port_dir) - len, "/pkeys");
+	num_pkeys = scandir(port_dir, &namelist, check_for_digit_name, NULL);
+	if (num_pkeys <= 0) {
+		IBWARN("no pkeys found for %s:%u (at dir %s)...",
+		       ca_name, portnum, port_dir);
+		if (!num_pkeys)
+			free(namelist);
+		return -EIO;
+	}
+	for (i = 0; i < num_pkeys; i++)
+		free(namelist[i]);
+	free(namelist);
+
+	port->num_pkeys = num_pkeys;
+	port->present = 1;
+	return 0;
 }
 
+static int load_ca(const char *ca_name, struct cached_ca *ca)
+{
+	char dir_name[256];
+	struct dirent **namelist;
+	int r, i, ret;
+	int portnum;
+
+	strncpy(ca->ca_name, ca_name, sizeof(ca->ca_name) - 1);
+
+	snprintf(dir_name, sizeof(dir_name), "%s/%s", SYS_INFINIBAND,
+		 ca->ca_name);
+
+	if ((r = sys_read_uint(dir_name, SYS_NODE_TYPE, &ca->node_type)) < 0)
+		return r;
+	if (sys_read_string(dir_name, SYS_CA_FW_VERS, ca->fw_ver,
+			    sizeof ca->fw_ver) < 0)
+		ca->fw_ver[0] = '\0';
+	if (sys_read_string(dir_name, SYS_CA_HW_VERS, ca->hw_ver,
+			    sizeof ca->hw_ver) < 0)
+		ca->hw_ver[0] = '\0';
+	if ((r = sys_read_string(dir_name, SYS_CA_TYPE, ca->ca_type,
+				 sizeof ca->ca_type)) < 0)
+		ca->ca_type[0] = '\0';
+	if ((r = sys_read_guid(dir_name, SYS_CA_NODE_GUID, &ca->node_guid)) < 0)
+		return r;
+	if ((r =
+	     sys_read_guid(dir_name, SYS_CA_SYS_GUID, &ca->system_guid)) < 0)
+		return r;
+
+	snprintf(dir_name, sizeof(dir_name), "%s/%s/%s",
+		 SYS_INFINIBAND, ca->ca_name, SYS_CA_PORTS_DIR);
+
+	if ((r = scandir(dir_name, &namelist, NULL, alphasort)) < 0)
+		return errno == ENOENT ? -ENOENT : -EIO;
+
+	ret = 0;
+	for (i = 0; i < r; i++) {
+		portnum = 0;
+		if (!strcmp(".", namelist[i]->d_name) ||
+		    !strcmp("..", namelist[i]->d_name))
+			continue;
+		if (strcmp("0", namelist[i]->d_name) &&
+		    ((portnum = atoi(namelist[i]->d_name)) <= 0 ||
+		     portnum >= UMAD_CA_MAX_PORTS)) {
+			ret = -EIO;
+			break;
+		}
+		if (load_port(ca_name, dir_name, portnum,
+			      &ca->ports[portnum]) < 0) {
+			ret = -EIO;
+			break;
+		}
+		if (ca->numports < portnum)
+			ca->numports = portnum;
+	}
+
+	for (i = 0; i < r; i++)
+		free(namelist[i]);
+	free(namelist);
+
+	return ret;
+}
+
+/*
+ * Return a referenced cache entry for ca_name, reading it from sysfs if it
+ * is missing or stale.  Release it with put_ca().
+ */
+static int find_cached_ca(const char *ca_name, struct cached_ca **out)
+{
+	struct cached_ca *ca, *stale;
+	char dir_name[256];
+	struct stat st;
+	int r;
+
+	snprintf(dir_name, sizeof(dir_name), "%s/%s", SYS_INFINIBAND, ca_name);
+	r = stat(dir_name, &st);
+
+	pthread_mutex_lock(&ca_cache_lock);
+	for (ca = ca_cache; ca; ca = ca->next) {
+		if (strcmp(ca->ca_name, ca_name))
+			continue;
+		if (!r && ca->dev == st.st_dev && ca->ino == st.st_ino) {
+			ca->refcnt++;
+			pthread_mutex_unlock(&ca_cache_lock);
+			*out = ca;
+			return 0;
+		}
+		break;
+	}
+	stale = ca ? unlink_cached_ca(ca_name) : NULL;
+	pthread_mutex_unlock(&ca_cache_lock);
+
+	if (stale) {
+		DEBUG("dropping stale cache entry for %s", ca_name);
+		put_ca(stale);
+	}
+	if (r < 0)
+		return -ENODEV;
+
+	ca = calloc(1, sizeof(*ca));
+	if (!ca)
+		return -ENOMEM;
+	if ((r = load_ca(ca_name, ca)) < 0) {
+		free(ca);
+		return r;
+	}
+	ca->dev = st.st_dev;
+	ca->ino = st.st_ino;
+	ca->refcnt = 2;		/* the cache's and the caller's */
+
+	pthread_mutex_lock(&ca_cache_lock);
+	/* another thread may have loaded it meanwhile */
+	stale = unlink_cached_ca(ca_name);
+	ca->next = ca_cache;
+	ca_cache = ca;
+	pthread_mutex_unlock(&ca_cache_lock);
+
+	if (stale)
+		put_ca(stale);
+
+	DEBUG("cached %s", ca_name);
+	*out = ca;
+	return 0;
+}
+
+static void flush_ca_cache(void)
+{
+	struct cached_ca *ca;
+
+	pthread_mutex_lock(&ca_cache_lock);
+	ca = ca_cache;
+	ca_cache = NULL;
+	pthread_mutex_unlock(&ca_cache_lock);
+
+	while (ca) {
+		struct cached_ca *next = ca->next;
+
+		put_ca(ca);
+		ca = next;
+	}
+}
+
+/*************************************
+ * Port
+ */
 static int release_port(umad_port_t * port)
 {
 	free(port->pkeys);
@@ -136,27 +372,25 @@ static int release_port(umad_port_t * port)
 	return 0;
 }
 
-static int check_for_digit_name(const struct dirent *dent)
-{
-	const char *p = dent->d_name;
-	while (*p && isdigit(*p))
-		p++;
-	return *p ? 0 : 1;
-}
-
-static int get_port(const char *ca_name, const char *dir, int portnum, umad_port_t * port)
+static int get_port(const struct cached_ca *ca, int portnum,
+		    umad_port_t *port)
 {
-	char port_dir[256];
+	char port_dir[256], pkey_name[16];
 	union umad_gid gid;
-	struct dirent **namelist;
-	int i, len, num_pkeys = 0;
+	unsigned i;
+	int len;
 	uint32_t capmask;
 
-	strncpy(port->ca_name, ca_name, sizeof port->ca_name - 1);
+	memcpy(port->ca_name, ca->ca_name, sizeof(port->ca_name));
 	port->portnum = portnum;
 	port->pkeys = NULL;
 
-	len = snprintf(port_dir, sizeof(port_dir), "%s/%d", dir, portnum);
+	if (portnum < 0 || portnum >= UMAD_CA_MAX_PORTS ||
+	    !ca->ports[portnum].present)
+		return -EIO;
+
+	len = snprintf(port_dir, sizeof(port_dir), "%s/%s/%s/%d",
+		       SYS_INFINIBAND, ca->ca_name, SYS_CA_PORTS_DIR, portnum);
 	if (len < 0 || len > sizeof(port_dir))
 		return -EIO;
 
@@ -177,10 +411,8 @@ static int get_port(const char *ca_name, const char *dir, int portnum, umad_port
 	if (sys_read_uint(port_dir, SYS_PORT_CAPMASK, &capmask) < 0)
 		return -EIO;
 
-	if (sys_read_string(port_dir, SYS_PORT_LINK_LAYER,
-	    port->link_layer, UMAD_CA_NAME_LEN) < 0)
-		/* assume IB by default */
-		sprintf(port->link_layer, "IB");
+	memcpy(port->link_layer, ca->ports[portnum].link_layer,
+	       sizeof(port->link_layer));
 
 	port->capmask = htobe32(capmask);
 
@@ -190,43 +422,30 @@ static int get_port(const char *ca_name, const char *dir, int portnum, umad_port
 	port->gid_prefix = gid.global.subnet_prefix;
 	port->port_guid = gid.global.interface_id;
 
+	/* the kernel names the pkey table entries 0 .. num_pkeys - 1 */
 	snprintf(port_dir + len, sizeof(port_dir) - len, "/pkeys");
-	num_pkeys = scandir(port_dir, &namelist, check_for_digit_name, NULL);
-	if (num_pkeys <= 0) {
-		IBWARN("no pkeys found for %s:%u (at dir %s)...",
-		       port->ca_name, port->portnum, port_dir);
-		return -EIO;
-	}
-	port->pkeys = calloc(num_pkeys, sizeof(port->pkeys[0]));
+	port->pkeys = calloc(ca->ports[portnum].num_pkeys,
+			     sizeof(port->pkeys[0]));
 	if (!port->pkeys) {
 		IBWARN("get_port: calloc failed: %s", strerror(errno));
-		goto clean_names;
+		return -EIO;
 	}
-	for (i = 0; i < num_pkeys; i++) {
-		unsigned idx, val;
-
-		idx = strtoul(namelist[i]->d_name, NULL, 0);
-		if (sys_read_uint(port_dir, namelist[i]->d_name, &val) < 0)
-			goto clean_pkeys;
-		port->pkeys[idx] = val;
+	for (i = 0; i < ca->ports[portnum].num_pkeys; i++) {
+		unsigned val;
+
+		snprintf(pkey_name, sizeof(pkey_name), "%u", i);
+		if (sys_read_uint(port_dir, pkey_name, &val) < 0) {
+			free(port->pkeys);
+			port->pkeys = NULL;
+			return -EIO;
+		}
+		port->pkeys[i] = val;
 	}
-	port->pkeys_size = num_pkeys;
-	for (i = 0; i < num_pkeys; i++)
-		free(namelist[i]);
-	free(namelist);
-	port_dir[len] = '\0';
+	port->pkeys_size = ca->ports[portnum].num_pkeys;
 
 	/* FIXME: handle gids */
 
 	return 0;
-
-clean_pkeys:
-	free(port->pkeys);
-clean_names:
-	for (i = 0; i < num_pkeys; i++)
-		free(namelist[i]);
-	free(namelist);
-	return -EIO;
 }
 
 static int release_ca(umad_ca_t * ca)
@@ -251,55 +470,71 @@ static int release_ca(umad_ca_t * ca)
  */
 static int resolve_ca_port(const char *ca_name, int *port)
 {
-	umad_ca_t ca;
+	struct cached_ca *ca;
+	unsigned state[UMAD_CA_MAX_PORTS], phys_state[UMAD_CA_MAX_PORTS];
+	char port_dir[256];
 	int active = -1, up = -1;
 	int i, ret = 0;
 
 	TRACE("checking ca '%s'", ca_name);
 
-	if (umad_get_ca(ca_name, &ca) < 0)
+	if (find_cached_ca(ca_name, &ca) < 0)
 		return -1;
 
-	if (ca.node_type == 2) {
+	if (ca->node_type == 2) {
 		*port = 0;	/* switch sma port 0 */
 		ret = 1;
 		goto Exit;
 	}
 
+	/* only the state is needed here, not a full umad_get_port() */
+	for (i = 0; i <= ca->numports; i++) {
+		if (!ca->ports[i].present)
+			continue;
+		snprintf(port_dir, sizeof(port_dir), "%s/%s/%s/%d",
+			 SYS_INFINIBAND, ca->ca_name, SYS_CA_PORTS_DIR, i);
+		if (sys_read_uint(port_dir, SYS_PORT_STATE, &state[i]) < 0 ||
+		    sys_read_uint(port_dir, SYS_PORT_PHY_STATE,
+				  &phys_state[i]) < 0) {
+			ret = -1;
+			goto Exit;
+		}
+	}
+
 	if (*port > 0) {	/* check only the port the user wants */
-		if (*port > ca.numports) {
+		if (*port > ca->numports) {
 			ret = -1;
 			goto Exit;
 		}
-		if (!ca.ports[*port]) {
+		if (!ca->ports[*port].present) {
 			ret = -1;
 			goto Exit;
 		}
-		if (strcmp(ca.ports[*port]->link_layer, "InfiniBand") &&
-		    strcmp(ca.ports[*port]->link_layer, "IB")) {
+		if (strcmp(ca->ports[*port].link_layer, "InfiniBand") &&
+		    strcmp(ca->ports[*port].link_layer, "IB")) {
 			ret = -1;
 			goto Exit;
 		}
-		if (ca.ports[*port]->state == 4) {
+		if (state[*port] == 4) {
 			ret = 1;
 			goto Exit;
 		}
-		if (ca.ports[*port]->phys_state != 3)
+		if (phys_state[*port] != 3)
 			goto Exit;
 		ret = -1;
 		goto Exit;
 	}
 
-	for (i = 0; i <= ca.numports; i++) {
+	for (i = 0; i <= ca->numports; i++) {
 		DEBUG("checking port %d", i);
-		if (!ca.ports[i])
+		if (!ca->ports[i].present)
 			continue;
-		if (strcmp(ca.ports[i]->link_layer, "InfiniBand") &&
-		    strcmp(ca.ports[i]->link_layer, "IB"))
+		if (strcmp(ca->ports[i].link_layer, "InfiniBand") &&
+		    strcmp(ca->ports[i].link_layer, "IB"))
 			continue;
-		if (up < 0 && ca.ports[i]->phys_state == 5)
+		if (up < 0 && phys_state[i] == 5)
 			up = *port = i;
-		if (ca.ports[i]->state == 4) {
+		if (state[i] == 4) {
 			active = *port = i;
 			DEBUG("found active port %d", i);
 			break;
@@ -307,11 +542,11 @@ static int resolve_ca_port(const char *ca_name, int *port)
 	}
 
 	if (active == -1 && up == -1) {	/* no active or linkup port found */
-		for (i = 0; i <= ca.numports; i++) {
+		for (i = 0; i <= ca->numports; i++) {
 			DEBUG("checking port %d", i);
-			if (!ca.ports[i])
+			if (!ca->ports[i].present)
 				continue;
-			if (ca.ports[i]->phys_state != 3) {
+			if (phys_state[i] != 3) {
 				up = *port = i;
 				break;
 			}
@@ -328,7 +563,7 @@ static int resolve_ca_port(const char *ca_name, int *port)
 	}
 	ret = -1;
 Exit:
-	release_ca(&ca);
+	put_ca(ca);
 	return ret;
 }
 
@@ -426,92 +661,43 @@ static int resolve_ca_name(const char *ca_in, int *best_port,
 
 static int get_ca(const char *ca_name, umad_ca_t * ca)
 {
-	DIR *dir;
-	char dir_name[256];
-	struct dirent **namelist;
-	int r, i, ret;
-	int portnum;
+	struct cached_ca *cached;
+	int r, i;
 
 	ca->numports = 0;
 	memset(ca->ports, 0, sizeof ca->ports);
-	strncpy(ca->ca_name, ca_name, sizeof(ca->ca_name) - 1);
-
-	snprintf(dir_name, sizeof(dir_name), "%s/%s", SYS_INFINIBAND,
-		 ca->ca_name);
 
-	if ((r = sys_read_uint(dir_name, SYS_NODE_TYPE, &ca->node_type)) < 0)
-		return r;
-	if (sys_read_string(dir_name, SYS_CA_FW_VERS, ca->fw_ver,
-			    sizeof ca->fw_ver) < 0)
-		ca->fw_ver[0] = '\0';
-	if (sys_read_string(dir_name, SYS_CA_HW_VERS, ca->hw_ver,
-			    sizeof ca->hw_ver) < 0)
-		ca->hw_ver[0] = '\0';
-	if ((r = sys_read_string(dir_name, SYS_CA_TYPE, ca->ca_type,
-				 sizeof ca->ca_type)) < 0)
-		ca->ca_type[0] = '\0';
-	if ((r = sys_read_guid(dir_name, SYS_CA_NODE_GUID, &ca->node_guid)) < 0)
-		return r;
-	if ((r =
-	     sys_read_guid(dir_name, SYS_CA_SYS_GUID, &ca->system_guid)) < 0)
+	if ((r = find_cached_ca(ca_name, &cached)) < 0)
 		return r;
 
-	snprintf(dir_name, sizeof(dir_name), "%s/%s/%s",
-		 SYS_INFINIBAND, ca->ca_name, SYS_CA_PORTS_DIR);
-
-	if (!(dir = opendir(dir_name)))
-		return -ENOENT;
-
-	if ((r = scandir(dir_name, &namelist, NULL, alphasort)) < 0) {
-		ret = errno < 0 ? errno : -EIO;
-		goto error;
-	}
-
-	ret = 0;
-	for (i = 0; i < r; i++) {
-		portnum = 0;
-		if (!strcmp(".", namelist[i]->d_name) ||
-		    !strcmp("..", namelist[i]->d_name))
+	memcpy(ca->ca_name, cached->ca_name, sizeof(ca->ca_name));
+	ca->node_type = cached->node_type;
+	memcpy(ca->fw_ver, cached->fw_ver, sizeof(ca->fw_ver));
+	memcpy(ca->ca_type, cached->ca_type, sizeof(ca->ca_type));
+	memcpy(ca->hw_ver, cached->hw_ver, sizeof(ca->hw_ver));
+	ca->node_guid = cached->node_guid;
+	ca->system_guid = cached->system_guid;
+	ca->numports = cached->numports;
+
+	for (i = 0; i <= cached->numports; i++) {
+		if (!cached->ports[i].present)
 			continue;
-		if (strcmp("0", namelist[i]->d_name) &&
-		    ((portnum = atoi(namelist[i]->d_name)) <= 0 ||
-		     portnum >= UMAD_CA_MAX_PORTS)) {
-			ret = -EIO;
-			goto clean;
-		}
-		if (!(ca->ports[portnum] =
-		      calloc(1, sizeof(*ca->ports[portnum])))) {
-			ret = -ENOMEM;
-			goto clean;
+		if (!(ca->ports[i] = calloc(1, sizeof(*ca->ports[i])))) {
+			r = -ENOMEM;
+			break;
 		}
-		if (get_port(ca_name, dir_name, portnum, ca->ports[portnum]) <
-		    0) {
-			free(ca->ports[portnum]);
-			ca->ports[portnum] = NULL;
-			ret = -EIO;
-			goto clean;
+		if (get_port(cached, i, ca->ports[i]) < 0) {
+			free(ca->ports[i]);
+			ca->ports[i] = NULL;
+			r = -EIO;
+			break;
 		}
-		if (ca->numports < portnum)
-			ca->numports = portnum;
 	}
 
-	for (i = 0; i < r; i++)
-		free(namelist[i]);
-	free(namelist);
-
-	closedir(dir);
-	put_ca(ca);
-	return 0;
-
-clean:
-	for (i = 0; i < r; i++)
-		free(namelist[i]);
-	free(namelist);
-error:
-	closedir(dir);
-	release_ca(ca);
-
-	return ret;
+	put_ca(cached);
+	if (r < 0)
+		release_ca(ca);
+	return r;
 }
 
 static int umad_id_to_dev(int umad_id, char *dev, unsigned *port)
@@ -573,6 +759,7 @@ int umad_done(void)
 {
 	TRACE("umad_done");
 	/* FIXME - verify that all ports are closed */
+	flush_ca_cache();
 	return 0;
 }
 
@@ -746,9 +933,6 @@ int umad_get_ca(const char *ca_name, umad_ca_t *ca)
 		goto exit;
 	}
 
-	if (find_cached_ca(found_ca_name, ca) > 0)
-		goto exit;
-
 	r = get_ca(found_ca_name, ca);
 	if (r < 0)
 		goto exit;
@@ -777,7 +961,7 @@ int umad_release_ca(umad_ca_t * ca)
 
 int umad_get_port(const char *ca_name, int portnum, umad_port_t *port)
 {
-	char dir_name[256];
+	struct cached_ca *ca;
 	char *found_ca_name;
 	int result;
 
@@ -788,10 +972,11 @@ int umad_get_port(const char *ca_name, int portnum, umad_port_t *port)
 		goto exit;
 	}
 
-	snprintf(dir_name, sizeof(dir_name), "%s/%s/%s",
-		 SYS_INFINIBAND, found_ca_name, SYS_CA_PORTS_DIR);
+	if ((result = find_cached_ca(found_ca_name, &ca)) < 0)
+		goto exit;
 
-	result = get_port(found_ca_name, dir_name, portnum, port);
+	result = get_port(ca, portnum, port);
+	put_ca(ca);
 exit:
 	free(found_ca_name);
 
@@ -33,12 +33,20 @@
 #include <config.h>
 
 #include <stdio.h>
+#include <stdbool.h>
 #include <inttypes.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <netdb.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <ccan/list.h>
 
 #include "cma.h"
 #include "acm.h"
@@ -46,9 +54,33 @@
 #include <infiniband/ib.h>
 #include <infiniband/sa.h>
 
+struct ucma_ib_req {
+	struct list_node	entry;
+	struct rdma_addrinfo	*rai;
+	int			ai_flags;
+	int			status;
+	bool			sent;
+	bool			done;
+	rdma_addrinfo_cb	cb;
+	void			*context;
+	struct acm_msg		msg;	/* request, then response */
+};
+
 static pthread_mutex_t acm_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t send_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t acm_cond = PTHREAD_COND_INITIALIZER;
+static LIST_HEAD(pending);
+static uint64_t next_tid;
+static unsigned int in_flight;	/* requests sent and not answered */
+static bool pipeline;		/* the service reported ACM_CAP_PIPELINE */
+static bool reading;
+static bool broken;
 static int sock = -1;
 static uint16_t server_port;
+static pthread_rwlock_t cache_lock = PTHREAD_RWLOCK_INITIALIZER;
+static struct acm_shm_hdr *path_cache;
+static size_t path_cache_size;
+static time_t cache_retry;
 
 static int ucma_set_server_port(void)
 {
@@ -64,6 +96,72 @@ static int ucma_set_server_port(void)
 	return server_port;
 }
 
+static void ucma_ib_map_cache(void)
+{
+	struct acm_shm_hdr *hdr;
+	struct stat st;
+	int fd;
+
+	fd = open(IBACM_PATH_CACHE_FILE, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return;
+
+	if (fstat(fd, &st) || st.st_size < sizeof(*hdr))
+		goto out;
+
+	hdr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (hdr == MAP_FAILED)
+		goto out;
+
+	if (__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) != ACM_SHM_MAGIC ||
+	    hdr->version != ACM_SHM_VERSION ||
+	    hdr->entry_size != sizeof(struct acm_shm_entry) ||
+	    !hdr->bucket_cnt || (hdr->bucket_cnt & (hdr->bucket_cnt - 1)) ||
+	    st.st_size < sizeof(*hdr) + (size_t) hdr->bucket_cnt *
+			 ACM_SHM_WAYS * sizeof(struct acm_shm_entry)) {
+		munmap(hdr, st.st_size);
+		goto out;
+	}
+
+	path_cache = hdr;
+	path_cache_size = st.st_size;
+out:
+	close(fd);
+}
+
+/* Called with cache_lock held */
+static bool ucma_ib_cache_valid(void)
+{
+	return path_cache &&
+	       __atomic_load_n(&path_cache->magic, __ATOMIC_ACQUIRE) ==
+	       ACM_SHM_MAGIC;
+}
+
+/*
+ * The service clears the magic of a cache it is about to replace, e.g. when
+ * it restarts, and may create the cache only after we connected.  Drop a
+ * stale mapping and map the current file, at most once a second.
+ */
+static void ucma_ib_remap_cache(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if (now.tv_sec < __atomic_load_n(&cache_retry, __ATOMIC_RELAXED))
+		return;
+
+	pthread_rwlock_wrlock(&cache_lock);
+	if (!ucma_ib_cache_valid() && now.tv_sec >= cache_retry) {
+		cache_retry = now.tv_sec + 1;
+		if (path_cache) {
+			munmap(path_cache, path_cache_size);
+			path_cache = NULL;
+		}
+		ucma_ib_map_cache();
+	}
+	pthread_rwlock_unlock(&cache_lock);
+}
+
 void ucma_ib_init(void)
 {
 	union {
@@ -111,6 +209,8 @@ void ucma_ib_init(void)
 			sock = -1;
 		}
 	}
+	if (sock >= 0)
+		ucma_ib_map_cache();
 out:
 	init = 1;
 unlock:
@@ -123,6 +223,8 @@ void ucma_ib_cleanup(void)
 		shutdown(sock, SHUT_RDWR);
 		close(sock);
 	}
+	if (path_cache)
+		munmap(path_cache, path_cache_size);
 }
 
 static int ucma_ib_set_addr(struct rdma_addrinfo *ib_rai,
@@ -319,42 +421,122 @@ static int ucma_ib_addr(struct sockaddr *addr, socklen_t len)
 	return len && addr && (addr->sa_family == AF_IB);
 }
 
-void ucma_ib_resolve(struct rdma_addrinfo **rai,
-		     const struct rdma_addrinfo *hints)
+static bool ucma_ib_read_cache(const struct acm_shm_entry *entry, uint16_t type,
+			       const uint8_t *src, const uint8_t *dst,
+			       struct acm_msg *msg)
 {
-	struct acm_msg msg;
-	struct acm_ep_addr_data *data;
-	int ret;
+	int len = acm_shm_addr_len(type);
+	struct timespec now;
+	uint32_t seq;
+	bool found;
+	int retry;
+
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+	for (retry = 0; retry < 4; retry++) {
+		seq = __atomic_load_n(&entry->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;
+
+		found = entry->type == type &&
+			entry->expires > (uint64_t) now.tv_sec &&
+			entry->length <= sizeof(msg->data) &&
+			!memcmp(entry->dst, dst, len) &&
+			(src ? !memcmp(entry->src, src, len) :
+			       (entry->flags & ACM_SHM_SRC_SELECTED));
+		if (found) {
+			msg->hdr.length = ACM_MSG_HDR_LENGTH + entry->length;
+			memcpy(msg->data, entry->data, entry->length);
+		}
 
-	ucma_ib_init();
-	if (sock < 0)
-		return;
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&entry->seq, __ATOMIC_RELAXED) == seq)
+			return found;
+	}
+
+	return false;
+}
+
+/*
+ * Look up an address resolution published by ibacm.  Only plain address
+ * requests are cached; anything carrying a path goes to the service.
+ */
+static bool ucma_ib_lookup_cache(struct rdma_addrinfo *rai,
+				 const struct rdma_addrinfo *hints,
+				 struct acm_msg *msg)
+{
+	struct acm_ep_addr_data src, dst;
+	const struct acm_shm_entry *bucket;
+	bool found = false;
+	int i;
+
+	if (hints->ai_route_len || !ucma_inet_addr(rai->ai_dst_addr,
+						   rai->ai_dst_len))
+		return false;
+
+	memset(&dst, 0, sizeof(dst));
+	ucma_set_ep_addr(&dst, rai->ai_dst_addr);
+	memset(&src, 0, sizeof(src));
+	if (ucma_inet_addr(rai->ai_src_addr, rai->ai_src_len)) {
+		ucma_set_ep_addr(&src, rai->ai_src_addr);
+		if (src.type != dst.type)
+			return false;
+	} else if (ucma_ib_addr(rai->ai_src_addr, rai->ai_src_len)) {
+		return false;
+	}
+
+	pthread_rwlock_rdlock(&cache_lock);
+	if (!ucma_ib_cache_valid()) {
+		pthread_rwlock_unlock(&cache_lock);
+		if (sock < 0)
+			return false;
+		ucma_ib_remap_cache();
+		pthread_rwlock_rdlock(&cache_lock);
+		if (!ucma_ib_cache_valid())
+			goto out;
+	}
 
-	memset(&msg, 0, sizeof msg);
-	msg.hdr.version = ACM_VERSION;
-	msg.hdr.opcode = ACM_OP_RESOLVE;
-	msg.hdr.length = ACM_MSG_HDR_LENGTH;
+	bucket = &path_cache->entries[(acm_shm_hash(dst.type, dst.info.addr) &
+				       (path_cache->bucket_cnt - 1)) *
+				      ACM_SHM_WAYS];
+	for (i = 0; i < ACM_SHM_WAYS && !found; i++)
+		found = ucma_ib_read_cache(&bucket[i], dst.type,
+					   src.type ? src.info.addr : NULL,
+					   dst.info.addr, msg);
+out:
+	pthread_rwlock_unlock(&cache_lock);
+	return found;
+}
 
-	data = &msg.resolve_data[0];
-	if (ucma_inet_addr((*rai)->ai_src_addr, (*rai)->ai_src_len)) {
+static void ucma_ib_format_req(struct rdma_addrinfo *rai,
+			       const struct rdma_addrinfo *hints,
+			       struct acm_msg *msg)
+{
+	struct acm_ep_addr_data *data;
+
+	msg->hdr.version = ACM_VERSION;
+	msg->hdr.opcode = ACM_OP_RESOLVE;
+	msg->hdr.length = ACM_MSG_HDR_LENGTH;
+
+	data = &msg->resolve_data[0];
+	if (ucma_inet_addr(rai->ai_src_addr, rai->ai_src_len)) {
 		data->flags = ACM_EP_FLAG_SOURCE;
-		ucma_set_ep_addr(data, (*rai)->ai_src_addr);
+		ucma_set_ep_addr(data, rai->ai_src_addr);
 		data++;
-		msg.hdr.length += ACM_MSG_EP_LENGTH;
+		msg->hdr.length += ACM_MSG_EP_LENGTH;
 	}
 
-	if (ucma_inet_addr((*rai)->ai_dst_addr, (*rai)->ai_dst_len)) {
+	if (ucma_inet_addr(rai->ai_dst_addr, rai->ai_dst_len)) {
 		data->flags = ACM_EP_FLAG_DEST;
 		if (hints->ai_flags & (RAI_NUMERICHOST | RAI_NOROUTE))
 			data->flags |= ACM_FLAGS_NODELAY;
-		ucma_set_ep_addr(data, (*rai)->ai_dst_addr);
+		ucma_set_ep_addr(data, rai->ai_dst_addr);
 		data++;
-		msg.hdr.length += ACM_MSG_EP_LENGTH;
+		msg->hdr.length += ACM_MSG_EP_LENGTH;
 	}
 
 	if (hints->ai_route_len ||
-	    ucma_ib_addr((*rai)->ai_src_addr, (*rai)->ai_src_len) ||
-	    ucma_ib_addr((*rai)->ai_dst_addr, (*rai)->ai_dst_len)) {
+	    ucma_ib_addr(rai->ai_src_addr, rai->ai_src_len) ||
+	    ucma_ib_addr(rai->ai_dst_addr, rai->ai_dst_len)) {
 		struct ibv_path_record *path;
 
 		if (hints->ai_route_len == sizeof(struct ibv_path_record))
@@ -367,33 +549,319 @@ void ucma_ib_resolve(struct rdma_addrinfo **rai,
 		if (path)
 			memcpy(&data->info.path, path, sizeof(*path));
 
-		if (ucma_ib_addr((*rai)->ai_src_addr, (*rai)->ai_src_len)) {
+		if (ucma_ib_addr(rai->ai_src_addr, rai->ai_src_len)) {
 			memcpy(&data->info.path.sgid,
-			       &((struct sockaddr_ib *) (*rai)->ai_src_addr)->sib_addr, 16);
+			       &((struct sockaddr_ib *) rai->ai_src_addr)->sib_addr, 16);
 		}
-		if (ucma_ib_addr((*rai)->ai_dst_addr, (*rai)->ai_dst_len)) {
+		if (ucma_ib_addr(rai->ai_dst_addr, rai->ai_dst_len)) {
 			memcpy(&data->info.path.dgid,
-			       &((struct sockaddr_ib *) (*rai)->ai_dst_addr)->sib_addr, 16);
+			       &((struct sockaddr_ib *) rai->ai_dst_addr)->sib_addr, 16);
 		}
 		data->type = ACM_EP_INFO_PATH;
 		data++;
-		msg.hdr.length += ACM_MSG_EP_LENGTH;
+		msg->hdr.length += ACM_MSG_EP_LENGTH;
+	}
+}
+
+static void ucma_ib_complete(struct ucma_ib_req *req)
+{
+	if (req->status || req->msg.hdr.status)
+		return;
+
+	ucma_ib_save_resp(req->rai, &req->msg);
+
+	if (af_ib_support && !(req->ai_flags & RAI_ROUTEONLY) &&
+	    req->rai->ai_route_len)
+		ucma_resolve_af_ib(&req->rai);
+}
+
+/* Called with acm_lock held */
+static void ucma_ib_fail_all(struct list_head *done)
+{
+	struct ucma_ib_req *req, *next;
+
+	list_for_each_safe(&pending, req, next, entry) {
+		list_del(&req->entry);
+		req->status = -1;
+		req->done = true;
+		if (req->cb)
+			list_add_tail(done, &req->entry);
+	}
+	if (sock >= 0)
+		shutdown(sock, SHUT_RDWR);
+	in_flight = 0;
+	broken = true;
+}
+
+static int ucma_ib_send_msg(struct acm_msg *msg)
+{
+	int ret;
+
+	pthread_mutex_lock(&send_lock);
+	ret = send(sock, (char *) msg, msg->hdr.length, MSG_NOSIGNAL);
+	pthread_mutex_unlock(&send_lock);
+	return ret == msg->hdr.length ? 0 : -1;
+}
+
+/*
+ * Until the service reported ACM_CAP_PIPELINE, only one request is on the
+ * socket and the others wait on the pending list unsent.  Send what may go
+ * now.  Called with acm_lock held, which is dropped while sending.
+ */
+static void ucma_ib_send_deferred(struct list_head *done)
+{
+	struct ucma_ib_req *req;
+	struct acm_msg msg;
+
+	while (!broken && (pipeline || !in_flight)) {
+		list_for_each(&pending, req, entry)
+			if (!req->sent)
+				break;
+		if (&req->entry == &pending.n)
+			return;
+
+		/* A failed connection may complete req while we send */
+		req->sent = true;
+		in_flight++;
+		memcpy(&msg, &req->msg, req->msg.hdr.length);
+		pthread_mutex_unlock(&acm_lock);
+		if (ucma_ib_send_msg(&msg)) {
+			pthread_mutex_lock(&acm_lock);
+			ucma_ib_fail_all(done);
+			return;
+		}
+		pthread_mutex_lock(&acm_lock);
+	}
+}
+
+/*
+ * Read one response and hand it to its request.  Called by the thread that
+ * claimed the socket for reading, without acm_lock held.  Asynchronous
+ * requests that complete are added to done for the caller to finish.
+ */
+static int ucma_ib_read_resp(struct list_head *done)
+{
+	struct ucma_ib_req *req;
+	struct acm_msg msg;
+	ssize_t ret;
+
+	ret = recv(sock, &msg, ACM_MSG_HDR_LENGTH, MSG_WAITALL);
+	if (ret != ACM_MSG_HDR_LENGTH || msg.hdr.length < ACM_MSG_HDR_LENGTH ||
+	    msg.hdr.length > sizeof(msg))
+		goto err;
+
+	if (msg.hdr.length > ACM_MSG_HDR_LENGTH) {
+		ret = recv(sock, msg.data, msg.hdr.length - ACM_MSG_HDR_LENGTH,
+			   MSG_WAITALL);
+		if (ret != msg.hdr.length - ACM_MSG_HDR_LENGTH)
+			goto err;
+	}
+
+	pthread_mutex_lock(&acm_lock);
+	list_for_each(&pending, req, entry) {
+		if (!req->sent || req->msg.hdr.tid != msg.hdr.tid)
+			continue;
+
+		list_del(&req->entry);
+		memcpy(&req->msg, &msg, msg.hdr.length);
+		req->done = true;
+		if (req->cb)
+			list_add_tail(done, &req->entry);
+		in_flight--;
+		if (msg.hdr.data[0] & ACM_CAP_PIPELINE)
+			pipeline = true;
+		break;
+	}
+	ucma_ib_send_deferred(done);
+	pthread_mutex_unlock(&acm_lock);
+	return 0;
+
+err:
+	pthread_mutex_lock(&acm_lock);
+	ucma_ib_fail_all(done);
+	pthread_mutex_unlock(&acm_lock);
+	return -1;
+}
+
+static int ucma_ib_finish_async(struct list_head *done)
+{
+	struct ucma_ib_req *req;
+	int cnt = 0;
+
+	while ((req = list_pop(done, struct ucma_ib_req, entry))) {
+		ucma_ib_complete(req);
+		req->cb(req->rai, req->context);
+		free(req);
+		cnt++;
 	}
+	return cnt;
+}
+
+/*
+ * Requests are tagged with a unique tid, so once the service reported
+ * ACM_CAP_PIPELINE any number may be outstanding on the socket.  Before
+ * that, requests queue on the pending list and go out one at a time as the
+ * responses come in.  Sends are serialized by send_lock.  Whichever waiter
+ * finds no other reader active reads responses for everybody.
+ */
+static int ucma_ib_send_req(struct ucma_ib_req *req)
+{
+	LIST_HEAD(done);
 
 	pthread_mutex_lock(&acm_lock);
-	ret = send(sock, (char *) &msg, msg.hdr.length, 0);
-	if (ret != msg.hdr.length) {
+	if (broken) {
 		pthread_mutex_unlock(&acm_lock);
-		return;
+		return -1;
+	}
+	req->msg.hdr.tid = ++next_tid;
+	req->done = false;
+	req->sent = pipeline || !in_flight;
+	list_add_tail(&pending, &req->entry);
+	if (!req->sent) {
+		pthread_mutex_unlock(&acm_lock);
+		return 0;
 	}
+	in_flight++;
+	pthread_mutex_unlock(&acm_lock);
 
-	ret = recv(sock, (char *) &msg, sizeof msg, 0);
+	if (!ucma_ib_send_msg(&req->msg))
+		return 0;
+
+	/* A reader that lost the connection may have failed it already */
+	pthread_mutex_lock(&acm_lock);
+	if (req->done) {
+		pthread_mutex_unlock(&acm_lock);
+		return 0;
+	}
+	list_del(&req->entry);
+	in_flight--;
+	/* A short send lost the framing, nothing more can be answered */
+	ucma_ib_fail_all(&done);
+	pthread_mutex_unlock(&acm_lock);
+
+	ucma_ib_finish_async(&done);
+	return -1;
+}
+
+static void ucma_ib_wait(struct ucma_ib_req *req)
+{
+	LIST_HEAD(done);
+
+	pthread_mutex_lock(&acm_lock);
+	while (!req->done) {
+		if (reading) {
+			pthread_cond_wait(&acm_cond, &acm_lock);
+			continue;
+		}
+
+		reading = true;
+		pthread_mutex_unlock(&acm_lock);
+		ucma_ib_read_resp(&done);
+		pthread_mutex_lock(&acm_lock);
+		reading = false;
+		pthread_cond_broadcast(&acm_cond);
+	}
 	pthread_mutex_unlock(&acm_lock);
-	if (ret < ACM_MSG_HDR_LENGTH || ret != msg.hdr.length || msg.hdr.status)
+
+	ucma_ib_finish_async(&done);
+}
+
+void ucma_ib_resolve(struct rdma_addrinfo **rai,
+		     const struct rdma_addrinfo *hints)
+{
+	struct ucma_ib_req req = {
+		.rai = *rai,
+		.ai_flags = hints->ai_flags,
+	};
+
+	ucma_ib_init();
+	if (sock < 0)
 		return;
 
-	ucma_ib_save_resp(*rai, &msg);
+	if (!ucma_ib_lookup_cache(*rai, hints, &req.msg)) {
+		ucma_ib_format_req(*rai, hints, &req.msg);
+		if (ucma_ib_send_req(&req))
+			return;
+		ucma_ib_wait(&req);
+	}
+
+	ucma_ib_complete(&req);
+	*rai = req.rai;
+}
+
+void ucma_ib_resolve_async(struct rdma_addrinfo *rai,
+			   const struct rdma_addrinfo *hints,
+			   rdma_addrinfo_cb cb, void *context)
+{
+	struct ucma_ib_req *req;
 
-	if (af_ib_support && !(hints->ai_flags & RAI_ROUTEONLY) && (*rai)->ai_route_len)
-		ucma_resolve_af_ib(rai);
+	ucma_ib_init();
+	if (sock < 0)
+		goto complete;
+
+	req = calloc(1, sizeof(*req));
+	if (!req)
+		goto complete;
+
+	req->rai = rai;
+	req->ai_flags = hints->ai_flags;
+	req->cb = cb;
+	req->context = context;
+
+	if (!ucma_ib_lookup_cache(rai, hints, &req->msg)) {
+		ucma_ib_format_req(rai, hints, &req->msg);
+		if (!ucma_ib_send_req(req))
+			return;
+		req->status = -1;
+	}
+
+	ucma_ib_complete(req);
+	rai = req->rai;
+	free(req);
+complete:
+	cb(rai, context);
+}
+
+int ucma_ib_process(int timeout)
+{
+	struct pollfd fds = { .events = POLLIN };
+	LIST_HEAD(done);
+	int ret, cnt = 0;
+
+	ucma_ib_init();
+
+	pthread_mutex_lock(&acm_lock);
+	if (sock < 0 || broken || reading || list_empty(&pending)) {
+		pthread_mutex_unlock(&acm_lock);
+		return 0;
+	}
+	reading = true;
+	pthread_mutex_unlock(&acm_lock);
+
+	fds.fd = sock;
+	while ((ret = poll(&fds, 1, timeout)) > 0) {
+		ret = ucma_ib_read_resp(&done);
+
+		/* Wake synchronous callers whose response was just read */
+		pthread_mutex_lock(&acm_lock);
+		pthread_cond_broadcast(&acm_cond);
+		pthread_mutex_unlock(&acm_lock);
+		if (ret)
+			break;
+		timeout = 0;
+	}
+
+	pthread_mutex_lock(&acm_lock);
+	reading = false;
+	pthread_cond_broadcast(&acm_cond);
+	pthread_mutex_unlock(&acm_lock);
+
+	cnt = ucma_ib_finish_async(&done);
+	return ret < 0 && !cnt ? ret : cnt;
+}
+
+int ucma_ib_fd(void)
+{
+	ucma_ib_init();
+	return sock;
 }
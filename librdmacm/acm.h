@@ -43,6 +43,7 @@ extern "C" {
 #define ACM_OP_RESOLVE          0x01
 #define ACM_OP_PERF_QUERY       0x02
 #define ACM_OP_EP_QUERY         0x03
+#define ACM_OP_STATS_QUERY      0x04
 #define ACM_OP_ACK              0x80
 
 #define ACM_STATUS_SUCCESS      0
@@ -73,6 +74,14 @@ extern "C" {
 #define src_index   data[1]
 #define dst_index   data[2]
 
+/*
+ * Service capabilities, reported in hdr.data[0] of resolve responses, which
+ * older services always clear.  ACM_CAP_PIPELINE: requests are framed by
+ * their length, so a client may send the next before the previous one was
+ * answered.  Older services take each read from the socket as one request.
+ */
+#define ACM_CAP_PIPELINE        (1<<0)
+
 struct acm_hdr {
 	uint8_t                 version;
 	uint8_t                 opcode;
@@ -122,6 +131,11 @@ enum {
 	ACM_CNTR_ADDR_CACHE,
 	ACM_CNTR_ROUTE_QUERY,
 	ACM_CNTR_ROUTE_CACHE,
+	ACM_CNTR_DEST_HIT,
+	ACM_CNTR_DEST_MISS,
+	ACM_CNTR_DEST_NEGATIVE,
+	ACM_CNTR_DEST_EVICT,
+	ACM_CNTR_DEST_EXPIRE,
 	ACM_MAX_COUNTER
 };
 
@@ -152,6 +166,48 @@ struct acm_ep_query_msg {
 	struct acm_ep_config_data  data[];
 };
 
+/* Operations timed by the endpoint latency histograms */
+enum {
+	ACM_STAT_RESOLVE_ADDR,
+	ACM_STAT_RESOLVE_PATH,
+	ACM_STAT_SA_QUERY,
+	ACM_STAT_MC_JOIN,
+	ACM_MAX_STAT
+};
+
+/* Endpoint queue depths, sampled when queried */
+enum {
+	ACM_GAUGE_DEST,
+	ACM_GAUGE_QUEUED_REQ,
+	ACM_GAUGE_SEND_PENDING,
+	ACM_GAUGE_SEND_WAIT,
+	ACM_GAUGE_SA_QUERY,
+	ACM_MAX_GAUGE
+};
+
+#define ACM_STAT_BUCKETS        24
+
+/*
+ * Statistics messages are sent/received in network byte order.  A query
+ * selects the endpoint as an endpoint query does, with the index in
+ * hdr.src_out and the port in hdr.src_index, and the operation in
+ * hdr.dst_index.  The reply holds the latency histogram of that operation
+ * together with the queue depths of the endpoint.  Latencies are in
+ * microseconds: bucket 0 counts samples under 1 us and bucket i those from
+ * 2^(i-1) up to 2^i us, with the last bucket unbounded.
+ */
+struct acm_stats_data {
+	uint8_t                 op;
+	uint8_t                 bucket_cnt;
+	uint8_t                 gauge_cnt;
+	uint8_t                 rsvd[5];
+	uint64_t                count;
+	uint64_t                total_us;
+	uint64_t                max_us;
+	uint64_t                gauge[ACM_MAX_GAUGE];
+	uint64_t                bucket[ACM_STAT_BUCKETS];
+};
+
 struct acm_msg {
 	struct acm_hdr                  hdr;
 	union{
@@ -159,9 +215,66 @@ struct acm_msg {
 		struct acm_ep_addr_data resolve_data[0];
 		uint64_t                perf_data[0];
 		struct acm_ep_config_data ep_data[0];
+		struct acm_stats_data   stats_data[0];
 	};
 };
 
+/*
+ * Path cache published by the ibacm service.  Successful address
+ * resolutions are written to a file that clients map read-only, so a cached
+ * address can be resolved without a round trip to the service.
+ *
+ * The file holds a header followed by bucket_cnt * ACM_SHM_WAYS entries.
+ * bucket_cnt is a power of two and the bucket is selected by
+ * acm_shm_hash() of the destination address.  Each entry is guarded by a
+ * sequence count which is odd while the service rewrites it; readers copy
+ * the entry and discard the copy if the count changed.  The service clears
+ * the magic before it removes or replaces the file.
+ */
+#define ACM_SHM_MAGIC           0x41434d50  /* "ACMP" */
+#define ACM_SHM_VERSION         1
+#define ACM_SHM_WAYS            4
+
+/* The service selected the source address; the request did not give one */
+#define ACM_SHM_SRC_SELECTED    (1<<0)
+
+struct acm_shm_entry {
+	uint32_t                seq;
+	uint16_t                type;       /* ACM_EP_INFO_ADDRESS_IP/IP6 or 0 */
+	uint16_t                flags;
+	uint64_t                expires;    /* CLOCK_MONOTONIC seconds */
+	uint8_t                 src[16];
+	uint8_t                 dst[16];
+	uint16_t                length;     /* bytes of data */
+	uint8_t                 rsvd[6];
+	uint8_t                 data[ACM_MSG_DATA_LENGTH]; /* response data */
+};
+
+struct acm_shm_hdr {
+	uint32_t                magic;
+	uint32_t                version;
+	uint32_t                bucket_cnt;
+	uint32_t                entry_size;
+	uint64_t                rsvd;
+	struct acm_shm_entry    entries[];
+};
+
+static inline int acm_shm_addr_len(uint16_t type)
+{
+	return type == ACM_EP_INFO_ADDRESS_IP ? 4 : 16;
+}
+
+/* FNV-1a */
+static inline uint32_t acm_shm_hash(uint16_t type, const uint8_t *addr)
+{
+	uint32_t hash = 2166136261U ^ type;
+	int i;
+
+	for (i = 0; i < acm_shm_addr_len(type); i++)
+		hash = (hash ^ addr[i]) * 16777619U;
+	return hash;
+}
+
 #ifdef __cplusplus
 }
 #endif
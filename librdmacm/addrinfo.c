@@ -234,9 +234,9 @@ static int ucma_getaddrinfo(const char *node, const char *service,
 	return ret;
 }
 
-int rdma_getaddrinfo(const char *node, const char *service,
-		     const struct rdma_addrinfo *hints,
-		     struct rdma_addrinfo **res)
+static int ucma_build_addrinfo(const char *node, const char *service,
+			       const struct rdma_addrinfo *hints,
+			       struct rdma_addrinfo **res)
 {
 	struct rdma_addrinfo *rai;
 	int ret;
@@ -277,9 +277,6 @@ int rdma_getaddrinfo(const char *node, const char *service,
 			goto err;
 	}
 
-	if (!(rai->ai_flags & RAI_PASSIVE))
-		ucma_ib_resolve(&rai, hints);
-
 	*res = rai;
 	return 0;
 
@@ -288,6 +285,56 @@ err:
 	return ret;
 }
 
+int rdma_getaddrinfo(const char *node, const char *service,
+		     const struct rdma_addrinfo *hints,
+		     struct rdma_addrinfo **res)
+{
+	struct rdma_addrinfo *rai;
+	int ret;
+
+	ret = ucma_build_addrinfo(node, service, hints, &rai);
+	if (ret)
+		return ret;
+
+	if (!(rai->ai_flags & RAI_PASSIVE))
+		ucma_ib_resolve(&rai, hints ? hints : &nohints);
+
+	*res = rai;
+	return 0;
+}
+
+int rdma_getaddrinfo_async(const char *node, const char *service,
+			   const struct rdma_addrinfo *hints,
+			   rdma_addrinfo_cb cb, void *context)
+{
+	struct rdma_addrinfo *rai;
+	int ret;
+
+	if (!cb)
+		return ERR(EINVAL);
+
+	ret = ucma_build_addrinfo(node, service, hints, &rai);
+	if (ret)
+		return ret;
+
+	if (rai->ai_flags & RAI_PASSIVE)
+		cb(rai, context);
+	else
+		ucma_ib_resolve_async(rai, hints ? hints : &nohints, cb,
+				      context);
+	return 0;
+}
+
+int rdma_getaddrinfo_fd(void)
+{
+	return ucma_ib_fd();
+}
+
+int rdma_getaddrinfo_process(int timeout)
+{
+	return ucma_ib_process(timeout);
+}
+
 void rdma_freeaddrinfo(struct rdma_addrinfo *res)
 {
 	struct rdma_addrinfo *rai;
@@ -101,6 +101,11 @@ void ucma_ib_init(void);
 void ucma_ib_cleanup(void);
 void ucma_ib_resolve(struct rdma_addrinfo **rai,
 		     const struct rdma_addrinfo *hints);
+void ucma_ib_resolve_async(struct rdma_addrinfo *rai,
+			   const struct rdma_addrinfo *hints,
+			   rdma_addrinfo_cb cb, void *context);
+int ucma_ib_process(int timeout);
+int ucma_ib_fd(void);
 
 struct ib_connect_hdr {
 	uint8_t  cma_version;
@@ -751,6 +751,39 @@ int rdma_getaddrinfo(const char *node, const char *service,
 
 void rdma_freeaddrinfo(struct rdma_addrinfo *res);
 
+typedef void (*rdma_addrinfo_cb)(struct rdma_addrinfo *res, void *context);
+
+/**
+ * rdma_getaddrinfo_async - Start an RDMA address and route resolution.
+ * @cb: Called with the result, which the callback releases with
+ * rdma_freeaddrinfo.
+ * @context: User context passed to the callback.
+ * Description:
+ *   Resolves the address as rdma_getaddrinfo does, but does not wait for
+ *   the IB ACM service to return route information.  Any number of
+ *   resolutions may be outstanding.  The callback is invoked from a later
+ *   call to rdma_getaddrinfo_process or rdma_getaddrinfo, or before this
+ *   call returns if no route lookup is required.
+ */
+int rdma_getaddrinfo_async(const char *node, const char *service,
+			   const struct rdma_addrinfo *hints,
+			   rdma_addrinfo_cb cb, void *context);
+
+/**
+ * rdma_getaddrinfo_fd - Returns a file descriptor that becomes readable when
+ * asynchronous resolutions may complete, or -1 if none are ever deferred.
+ */
+int rdma_getaddrinfo_fd(void);
+
+/**
+ * rdma_getaddrinfo_process - Complete asynchronous resolutions.
+ * @timeout: Time to wait for a response in milliseconds, -1 waits forever.
+ * Description:
+ *   Invokes the callbacks of completed resolutions and returns how many
+ *   completed, or -1 on error.
+ */
+int rdma_getaddrinfo_process(int timeout);
+
 /**
  * rdma_init_qp_attr - Returns QP attributes.
  * @id: Communication identifier.
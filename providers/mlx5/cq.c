@@ -156,11 +156,146 @@ static void *next_cqe_sw(struct mlx5_cq *cq)
 	return get_sw_cqe(cq, cq->cons_index);
 }
 
+static struct mlx5_cqe64 *get_cqe64(struct mlx5_cq *cq, uint32_t n)
+{
+	void *cqe = get_cqe(cq, n & cq->verbs_cq.cq.cqe);
+
+	return (cq->cqe_sz == 64) ? cqe : cqe + 64;
+}
+
 static void update_cons_index(struct mlx5_cq *cq)
 {
+	/* Slots invalidated by mlx5_next_mini_cqe() before the device reuses them */
+	if (cq->cqe_comp_format)
+		udma_to_device_barrier();
+
 	cq->dbrec[MLX5_CQ_SET_CI] = htobe32(cq->cons_index & 0xffffff);
 }
 
+enum {
+	MLX5_CQE_FORMAT_COMPRESSED = 0x3,
+};
+
+/* CQE fields a mini CQE may carry, by offset in struct mlx5_cqe64 */
+enum {
+	MLX5_CQE_RX_HASH_RESULT_OFFSET = 12,
+	MLX5_CQE_CHECKSUM_OFFSET = 20,
+};
+
+static inline uint8_t mlx5_get_cqe_format(struct mlx5_cqe64 *cqe)
+{
+	return (cqe->op_own >> 2) & 0x3;
+}
+
+/*
+ * With CQE compression the device writes runs of receive completions that
+ * differ only in a few fields as a session: a title CQE in the compressed
+ * format holding the shared fields and, in byte_cnt, the number of
+ * completions, then arrays of MLX5_MINI_CQE_ARRAY_SIZE mini CQEs holding the
+ * rest.  The session takes one slot per completion; the first array is in
+ * the slot after the title, the next ones in every MLX5_MINI_CQE_ARRAY_SIZE'th
+ * slot from the title, and the device leaves the other slots alone.  Each
+ * completion is expanded into cq->title, which the parsers then read as any
+ * CQE.
+ */
+static void mlx5_read_mini_arr(struct mlx5_cq *cq, uint32_t n)
+{
+	struct mlx5_cqe64 *cqe64 = get_cqe64(cq, n);
+
+	VALGRIND_MAKE_MEM_DEFINED(cqe64, sizeof(*cqe64));
+	memcpy(cq->mini_arr, cqe64, sizeof(cq->mini_arr));
+	cq->mini_idx = 0;
+}
+
+static void mlx5_start_mini_cqes(struct mlx5_cq *cq, uint32_t n)
+{
+	cq->title = *get_cqe64(cq, n);
+	cq->title.op_own &= ~(MLX5_CQE_FORMAT_COMPRESSED << 2 |
+			      MLX5_CQE_OWNER_MASK);
+	cq->mini_left = be32toh(cq->title.byte_cnt);
+	cq->mini_wqe_counter = be16toh(cq->title.wqe_counter);
+	mlx5_read_mini_arr(cq, n + 1);
+}
+
+static inline void mlx5_expand_mini_cqe(struct mlx5_cq *cq)
+{
+	struct mlx5_mini_cqe8 *mini = &cq->mini_arr[cq->mini_idx++];
+	void *title = &cq->title;
+
+	cq->title.byte_cnt = mini->byte_cnt;
+
+	switch (cq->cqe_comp_format) {
+	case MLX5DV_CQE_RES_FORMAT_HASH:
+		memcpy(title + MLX5_CQE_RX_HASH_RESULT_OFFSET,
+		       &mini->rx_hash_result, sizeof(mini->rx_hash_result));
+		cq->title.wqe_counter = htobe16(cq->mini_wqe_counter++);
+		break;
+	case MLX5DV_CQE_RES_FORMAT_CSUM_STRIDX:
+		memcpy(title + MLX5_CQE_CHECKSUM_OFFSET, &mini->checksum,
+		       sizeof(mini->checksum));
+		cq->title.wqe_counter = mini->stridx;
+		break;
+	default:
+		memcpy(title + MLX5_CQE_CHECKSUM_OFFSET, &mini->checksum,
+		       sizeof(mini->checksum));
+		cq->title.wqe_counter = htobe16(cq->mini_wqe_counter++);
+		break;
+	}
+
+	cq->mini_left--;
+}
+
+/* Expand the next completion of the session, whose slot is n */
+static inline void mlx5_next_mini_cqe(struct mlx5_cq *cq, uint32_t n)
+{
+	if (cq->mini_idx == MLX5_MINI_CQE_ARRAY_SIZE)
+		mlx5_read_mini_arr(cq, n);
+
+	mlx5_expand_mini_cqe(cq);
+
+	/*
+	 * Array slots hold no valid owner bit, and a later session may not
+	 * write this slot, keep it from passing for a CQE on the next lap.
+	 */
+	get_cqe64(cq, n)->op_own = MLX5_CQE_INVALID << 4;
+}
+
+/*
+ * Rewrite the sessions in the CQ, including the one being polled, as plain
+ * CQEs in their slots, for the code walking the CQ slot by slot.
+ */
+static void mlx5_expand_mini_cqes(struct mlx5_cq *cq)
+{
+	struct mlx5_cqe64 *cqe64;
+	uint32_t n = cq->cons_index;
+
+	if (!cq->cqe_comp_format)
+		return;
+
+	while (n - cq->cons_index <= cq->verbs_cq.cq.cqe) {
+		if (cq->mini_left) {
+			if (cq->mini_idx == MLX5_MINI_CQE_ARRAY_SIZE)
+				mlx5_read_mini_arr(cq, n);
+			mlx5_expand_mini_cqe(cq);
+
+			cqe64 = get_cqe64(cq, n);
+			*cqe64 = cq->title;
+			cqe64->op_own |= !!(n & (cq->verbs_cq.cq.cqe + 1));
+			n++;
+			continue;
+		}
+
+		if (!get_sw_cqe(cq, n))
+			break;
+
+		if (mlx5_get_cqe_format(get_cqe64(cq, n)) ==
+		    MLX5_CQE_FORMAT_COMPRESSED)
+			mlx5_start_mini_cqes(cq, n);
+		else
+			n++;
+	}
+}
+
 static inline void handle_good_req(struct ibv_wc *wc, struct mlx5_cqe64 *cqe, struct mlx5_wq *wq, int idx)
 {
 	switch (be32toh(cqe->sop_drop_qpn) >> 24) {
@@ -540,6 +675,13 @@ static inline int mlx5_get_next_cqe(struct mlx5_cq *cq,
 	void *cqe;
 	struct mlx5_cqe64 *cqe64;
 
+	if (unlikely(cq->mini_left)) {
+		mlx5_next_mini_cqe(cq, cq->cons_index++);
+		cqe64 = &cq->title;
+		cqe = cqe64;
+		goto out;
+	}
+
 	cqe = next_cqe_sw(cq);
 	if (!cqe)
 		return CQ_EMPTY;
@@ -556,6 +698,14 @@ static inline int mlx5_get_next_cqe(struct mlx5_cq *cq,
 	 */
 	udma_from_device_barrier();
 
+	if (unlikely(mlx5_get_cqe_format(cqe64) == MLX5_CQE_FORMAT_COMPRESSED)) {
+		mlx5_start_mini_cqes(cq, cq->cons_index - 1);
+		mlx5_next_mini_cqe(cq, cq->cons_index - 1);
+		cqe64 = &cq->title;
+		cqe = cqe64;
+	}
+
+out:
 #ifdef MLX5_DEBUG
 	{
 		struct mlx5_context *mctx = to_mctx(cq->verbs_cq.cq_ex.context);
@@ -1820,6 +1970,8 @@ void __mlx5_cq_clean(struct mlx5_cq *cq, uint32_t rsn, struct mlx5_srq *srq)
 	if (!cq || cq->flags & MLX5_CQ_FLAGS_DV_OWNED)
 		return;
 
+	mlx5_expand_mini_cqes(cq);
+
 	/*
 	 * First we need to find the current producer index, so we
 	 * know where to start cleaning from.  It doesn't matter if HW
@@ -1891,6 +2043,8 @@ void mlx5_cq_resize_copy_cqes(struct mlx5_context *mctx, struct mlx5_cq *cq)
 	int i;
 	uint8_t sw_own;
 
+	mlx5_expand_mini_cqes(cq);
+
 	ssize = cq->cqe_sz;
 	dsize = cq->resize_cqe_sz;
 
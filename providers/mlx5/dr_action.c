@@ -955,6 +955,233 @@ dr_action_create_generic(enum dr_action_type action_type)
 	return action;
 }
 
+int dr_action_cache_init(struct mlx5dv_dr_domain *dmn)
+{
+	struct dr_action_cache *cache = &dmn->action_cache;
+	int ret, i;
+
+	cache->buckets = calloc(DR_ACTION_CACHE_MIN_BUCKETS,
+				sizeof(*cache->buckets));
+	if (!cache->buckets) {
+		errno = ENOMEM;
+		return errno;
+	}
+
+	for (i = 0; i < DR_ACTION_CACHE_MIN_BUCKETS; i++)
+		list_head_init(&cache->buckets[i]);
+	cache->num_buckets = DR_ACTION_CACHE_MIN_BUCKETS;
+
+	ret = pthread_spin_init(&cache->lock, PTHREAD_PROCESS_PRIVATE);
+	if (ret) {
+		free(cache->buckets);
+		errno = ret;
+		return ret;
+	}
+
+	return 0;
+}
+
+void dr_action_cache_uninit(struct mlx5dv_dr_domain *dmn)
+{
+	/* Every cached action holds a domain reference, none is left here */
+	pthread_spin_destroy(&dmn->action_cache.lock);
+	free(dmn->action_cache.buckets);
+}
+
+static uint32_t dr_action_cache_hash(enum dr_action_type action_type,
+				     uint32_t flags, size_t data_sz,
+				     const void *data)
+{
+	const uint8_t *p = data;
+	uint32_t hash = 2166136261u;
+	size_t i;
+
+	/* FNV-1a */
+	hash = (hash ^ action_type) * 16777619;
+	hash = (hash ^ flags) * 16777619;
+	for (i = 0; i < data_sz; i++)
+		hash = (hash ^ p[i]) * 16777619;
+
+	return hash;
+}
+
+static struct dr_action_cache_entry *
+dr_action_cache_lookup(struct dr_action_cache *cache, uint32_t hash,
+		       enum dr_action_type action_type, uint32_t flags,
+		       size_t data_sz, const void *data)
+{
+	struct list_head *bucket = &cache->buckets[hash & (cache->num_buckets - 1)];
+	struct dr_action_cache_entry *entry;
+
+	list_for_each(bucket, entry, list)
+		if (entry->hash == hash && entry->action_type == action_type &&
+		    entry->flags == flags && entry->data_sz == data_sz &&
+		    !memcmp(entry->data, data, data_sz))
+			return entry;
+
+	return NULL;
+}
+
+/* Double the buckets, the cache keeps working with the old ones on failure */
+static void dr_action_cache_grow(struct dr_action_cache *cache)
+{
+	uint32_t num_buckets = cache->num_buckets * 2;
+	struct dr_action_cache_entry *entry;
+	struct list_head *buckets;
+	uint32_t i;
+
+	buckets = calloc(num_buckets, sizeof(*buckets));
+	if (!buckets)
+		return;
+
+	for (i = 0; i < num_buckets; i++)
+		list_head_init(&buckets[i]);
+
+	for (i = 0; i < cache->num_buckets; i++)
+		while ((entry = list_pop(&cache->buckets[i],
+					 struct dr_action_cache_entry, list)))
+			list_add_tail(&buckets[entry->hash & (num_buckets - 1)],
+				      &entry->list);
+
+	free(cache->buckets);
+	cache->buckets = buckets;
+	cache->num_buckets = num_buckets;
+}
+
+/* Take another owner of an existing action with the same content */
+static struct mlx5dv_dr_action *
+dr_action_cache_get(struct mlx5dv_dr_domain *dmn,
+		    enum dr_action_type action_type, uint32_t flags,
+		    size_t data_sz, const void *data)
+{
+	struct dr_action_cache *cache = &dmn->action_cache;
+	struct dr_action_cache_entry *entry;
+	struct mlx5dv_dr_action *action = NULL;
+	uint32_t hash;
+
+	hash = dr_action_cache_hash(action_type, flags, data_sz, data);
+
+	pthread_spin_lock(&cache->lock);
+	entry = dr_action_cache_lookup(cache, hash, action_type, flags,
+				       data_sz, data);
+	if (entry) {
+		entry->users++;
+		cache->num_dedup++;
+		cache->saved_bytes += entry->mem_size;
+		action = entry->action;
+	}
+	pthread_spin_unlock(&cache->lock);
+
+	return action;
+}
+
+static size_t dr_action_cache_mem_size(struct mlx5dv_dr_action *action,
+				       size_t data_sz)
+{
+	switch (action->action_type) {
+	case DR_ACTION_TYP_MODIFY_HDR:
+		if (!action->rewrite.is_root_level &&
+		    !action->rewrite.single_action_opt)
+			return action->rewrite.chunk->byte_size;
+		break;
+	case DR_ACTION_TYP_TNL_L3_TO_L2:
+		if (!action->reformat.is_root_level)
+			return action->rewrite.chunk->byte_size;
+		break;
+	default:
+		break;
+	}
+
+	return data_sz;
+}
+
+/*
+ * Publish a new action under its content.  If the same content got cached
+ * meanwhile, the new action is dropped and the cached one returned.
+ */
+static struct mlx5dv_dr_action *
+dr_action_cache_add(struct mlx5dv_dr_domain *dmn,
+		    struct mlx5dv_dr_action *action, uint32_t flags,
+		    size_t data_sz, const void *data)
+{
+	struct dr_action_cache *cache = &dmn->action_cache;
+	struct dr_action_cache_entry *entry, *cached;
+
+	/* Not sharing is always correct, so a failure here is not an error */
+	entry = calloc(1, sizeof(*entry) + data_sz);
+	if (!entry)
+		return action;
+
+	entry->dmn = dmn;
+	entry->action = action;
+	entry->hash = dr_action_cache_hash(action->action_type, flags,
+					   data_sz, data);
+	entry->users = 1;
+	entry->action_type = action->action_type;
+	entry->flags = flags;
+	entry->mem_size = dr_action_cache_mem_size(action, data_sz);
+	entry->data_sz = data_sz;
+	memcpy(entry->data, data, data_sz);
+
+	pthread_spin_lock(&cache->lock);
+	cached = dr_action_cache_lookup(cache, entry->hash,
+					entry->action_type, flags,
+					data_sz, data);
+	if (cached) {
+		cached->users++;
+		cache->num_dedup++;
+		cache->saved_bytes += cached->mem_size;
+		pthread_spin_unlock(&cache->lock);
+
+		free(entry);
+		mlx5dv_dr_action_destroy(action);
+		return cached->action;
+	}
+
+	if (cache->num_entries == cache->num_buckets)
+		dr_action_cache_grow(cache);
+
+	list_add_tail(&cache->buckets[entry->hash & (cache->num_buckets - 1)],
+		      &entry->list);
+	cache->num_entries++;
+	action->cache_entry = entry;
+	pthread_spin_unlock(&cache->lock);
+
+	return action;
+}
+
+/*
+ * Drop one owner of a cached action.  Sets shared if other owners remain,
+ * otherwise the action leaves the cache unless rules still use it.
+ */
+static int dr_action_cache_put(struct mlx5dv_dr_action *action, bool *shared)
+{
+	struct dr_action_cache_entry *entry = action->cache_entry;
+	struct dr_action_cache *cache = &entry->dmn->action_cache;
+
+	pthread_spin_lock(&cache->lock);
+	if (entry->users > 1) {
+		entry->users--;
+		pthread_spin_unlock(&cache->lock);
+		*shared = true;
+		return 0;
+	}
+
+	if (atomic_load(&action->refcount) > 1) {
+		pthread_spin_unlock(&cache->lock);
+		return EBUSY;
+	}
+
+	list_del(&entry->list);
+	cache->num_entries--;
+	action->cache_entry = NULL;
+	pthread_spin_unlock(&cache->lock);
+
+	free(entry);
+	*shared = false;
+	return 0;
+}
+
 struct mlx5dv_dr_action *mlx5dv_dr_action_create_drop(void)
 {
 	return dr_action_create_generic(DR_ACTION_TYP_DROP);
@@ -1457,6 +1684,14 @@ mlx5dv_dr_action_create_packet_reformat(struct mlx5dv_dr_domain *dmn,
 		goto dec_ref;
 
 	action_type = dr_action_reformat_to_action_type(reformat_type);
+
+	/* Identical reformat data shares one action */
+	action = dr_action_cache_get(dmn, action_type, flags, data_sz, data);
+	if (action) {
+		atomic_fetch_sub(&dmn->refcount, 1);
+		return action;
+	}
+
 	action = dr_action_create_generic(action_type);
 	if (!action)
 		goto dec_ref;
@@ -1483,7 +1718,7 @@ mlx5dv_dr_action_create_packet_reformat(struct mlx5dv_dr_domain *dmn,
 		goto free_action;
 	}
 
-	return action;
+	return dr_action_cache_add(dmn, action, flags, data_sz, data);
 
 free_action:
 	free(action);
@@ -2045,6 +2280,14 @@ mlx5dv_dr_action_create_modify_header(struct mlx5dv_dr_domain *dmn,
 		goto dec_ref;
 	}
 
+	/* Identical modify actions share one action */
+	action = dr_action_cache_get(dmn, DR_ACTION_TYP_MODIFY_HDR, flags,
+				     actions_sz, actions);
+	if (action) {
+		atomic_fetch_sub(&dmn->refcount, 1);
+		return action;
+	}
+
 	action = dr_action_create_generic(DR_ACTION_TYP_MODIFY_HDR);
 	if (!action)
 		goto dec_ref;
@@ -2071,7 +2314,7 @@ mlx5dv_dr_action_create_modify_header(struct mlx5dv_dr_domain *dmn,
 		goto free_action;
 	}
 
-	return action;
+	return dr_action_cache_add(dmn, action, flags, actions_sz, actions);
 
 free_action:
 	free(action);
@@ -2809,6 +3052,15 @@ dec_ref:
 
 int mlx5dv_dr_action_destroy(struct mlx5dv_dr_action *action)
 {
+	bool shared;
+	int ret;
+
+	if (action->cache_entry) {
+		ret = dr_action_cache_put(action, &shared);
+		if (ret || shared)
+			return ret;
+	}
+
 	if (atomic_load(&action->refcount) > 1)
 		return EBUSY;
 
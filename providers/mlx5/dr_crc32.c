@@ -54,54 +54,54 @@
 
 #include <stdlib.h>
 #include <string.h>
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+#endif
 #include "mlx5dv_dr.h"
 
 #define DR_STE_CRC_POLY		0xEDB88320L
 
+/*
+ * Bit-reflected folding constants for DR_STE_CRC_POLY: x^(128+32) and
+ * x^(128-32) mod P for the 128 bit folds, x^64 mod P for the 64 to 32 bit
+ * fold, then P and floor(x^64 / P) for the Barrett reduction.
+ */
+#define DR_CRC32_FOLD_K3	0x1751997d0ULL
+#define DR_CRC32_FOLD_K4	0x0ccaa009eULL
+#define DR_CRC32_FOLD_K5	0x163cd6124ULL
+#define DR_CRC32_BARRETT_P	0x1db710641ULL
+#define DR_CRC32_BARRETT_MU	0x1f7011641ULL
+
 static uint32_t dr_ste_crc_tab32[8][256];
 
+static uint32_t (*dr_crc32_calc_func)(const void *input_data, size_t length) =
+	dr_crc32_slice8_calc;
+
 static void dr_crc32_calc_lookup_entry(uint32_t (*tbl)[256], uint8_t i,
 				       uint8_t j)
 {
 	tbl[i][j] = (tbl[i-1][j] >> 8) ^ tbl[0][tbl[i-1][j] & 0xff];
 }
 
-void dr_crc32_init_table(void)
+static uint32_t dr_crc32_swab(uint32_t crc)
 {
-	uint32_t crc, i, j;
-
-	for (i = 0; i < 256; i++) {
-		crc = i;
-		for (j = 0; j < 8; j++) {
-			if (crc & 0x00000001L)
-				crc = (crc >> 1) ^ DR_STE_CRC_POLY;
-			else
-				crc = crc >> 1;
-		}
-		dr_ste_crc_tab32[0][i] = crc;
-	}
-
-	/* Init CRC lookup tables according to crc_slice_8 algorithm */
-	for (i = 0; i < 256; i++) {
-		dr_crc32_calc_lookup_entry(dr_ste_crc_tab32, 1, i);
-		dr_crc32_calc_lookup_entry(dr_ste_crc_tab32, 2, i);
-		dr_crc32_calc_lookup_entry(dr_ste_crc_tab32, 3, i);
-		dr_crc32_calc_lookup_entry(dr_ste_crc_tab32, 4, i);
-		dr_crc32_calc_lookup_entry(dr_ste_crc_tab32, 5, i);
-		dr_crc32_calc_lookup_entry(dr_ste_crc_tab32, 6, i);
-		dr_crc32_calc_lookup_entry(dr_ste_crc_tab32, 7, i);
-	}
+	return ((crc>>24) & 0xff) | ((crc<<8) & 0xff0000) |
+		((crc>>8) & 0xff00) | ((crc<<24) & 0xff000000);
 }
 
-/* Compute CRC32 (Slicing-by-8 algorithm) */
-uint32_t dr_crc32_slice8_calc(const void *input_data, size_t length)
+/* Update CRC32 (Slicing-by-8 algorithm) */
+static uint32_t dr_crc32_slice8_update(uint32_t crc, const void *input_data,
+				       size_t length)
 {
 	const uint32_t *current = (const uint32_t *)input_data;
 	const uint8_t *current_char;
-	uint32_t crc = 0, one, two;
-
-	if (!input_data)
-		return 0;
+	uint32_t one, two;
 
 	/* Process eight bytes at once (Slicing-by-8) */
 	while (length >= 8) {
@@ -126,6 +126,181 @@ uint32_t dr_crc32_slice8_calc(const void *input_data, size_t length)
 		crc = (crc >> 8) ^ dr_ste_crc_tab32[0][(crc & 0xff)
 			^ *current_char++];
 
-	return ((crc>>24) & 0xff) | ((crc<<8) & 0xff0000) |
-		((crc>>8) & 0xff00) | ((crc<<24) & 0xff000000);
+	return crc;
+}
+
+/* Compute CRC32 (Slicing-by-8 algorithm) */
+uint32_t dr_crc32_slice8_calc(const void *input_data, size_t length)
+{
+	if (!input_data)
+		return 0;
+
+	return dr_crc32_swab(dr_crc32_slice8_update(0, input_data, length));
+}
+
+#if defined(__x86_64__)
+/*
+ * Compute CRC32 by folding 16 bytes at a time with carry-less multiplication,
+ * the remaining 1 to 15 bytes go through the tables.
+ */
+static uint32_t __attribute__((target("sse4.1,pclmul")))
+dr_crc32_pclmul_calc(const void *input_data, size_t length)
+{
+	const uint8_t *current = input_data;
+	__m128i x, t, k, mask32;
+	uint32_t crc;
+
+	if (!input_data)
+		return 0;
+
+	if (length < 16)
+		return dr_crc32_slice8_calc(input_data, length);
+
+	x = _mm_loadu_si128((const __m128i *)current);
+	current += 16;
+	length -= 16;
+
+	k = _mm_set_epi64x(DR_CRC32_FOLD_K4, DR_CRC32_FOLD_K3);
+	while (length >= 16) {
+		t = _mm_clmulepi64_si128(x, k, 0x11);
+		x = _mm_clmulepi64_si128(x, k, 0x00);
+		x = _mm_xor_si128(x, t);
+		x = _mm_xor_si128(x, _mm_loadu_si128((const __m128i *)current));
+		current += 16;
+		length -= 16;
+	}
+
+	/* Fold 128 to 64 bits */
+	t = _mm_clmulepi64_si128(x, k, 0x10);
+	x = _mm_xor_si128(_mm_srli_si128(x, 8), t);
+
+	/* Fold 64 to 32 bits */
+	mask32 = _mm_set_epi32(0, 0, 0, -1);
+	k = _mm_set_epi64x(0, DR_CRC32_FOLD_K5);
+	t = _mm_clmulepi64_si128(_mm_and_si128(x, mask32), k, 0x00);
+	x = _mm_xor_si128(_mm_srli_si128(x, 4), t);
+
+	/* Barrett reduction */
+	k = _mm_set_epi64x(DR_CRC32_BARRETT_MU, DR_CRC32_BARRETT_P);
+	t = _mm_clmulepi64_si128(_mm_and_si128(x, mask32), k, 0x10);
+	t = _mm_clmulepi64_si128(_mm_and_si128(t, mask32), k, 0x00);
+	x = _mm_xor_si128(x, t);
+	crc = _mm_extract_epi32(x, 1);
+
+	return dr_crc32_swab(dr_crc32_slice8_update(crc, current, length));
+}
+
+static uint32_t (*dr_crc32_select(void))(const void *, size_t)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) &&
+	    (ecx & bit_PCLMUL) && (ecx & bit_SSE4_1))
+		return dr_crc32_pclmul_calc;
+
+	return dr_crc32_slice8_calc;
+}
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+/* Compute CRC32 with the ARMv8 CRC32 instructions, same polynomial */
+static uint32_t dr_crc32_armv8_calc(const void *input_data, size_t length)
+{
+	const uint8_t *current = input_data;
+	uint32_t crc = 0;
+	uint64_t data;
+
+	if (!input_data)
+		return 0;
+
+	while (length >= 8) {
+		memcpy(&data, current, sizeof(data));
+		crc = __crc32d(crc, data);
+		current += 8;
+		length -= 8;
+	}
+
+	while (length-- != 0)
+		crc = __crc32b(crc, *current++);
+
+	return dr_crc32_swab(crc);
+}
+
+static uint32_t (*dr_crc32_select(void))(const void *, size_t)
+{
+	return dr_crc32_armv8_calc;
+}
+#else
+static uint32_t (*dr_crc32_select(void))(const void *, size_t)
+{
+	return dr_crc32_slice8_calc;
+}
+#endif
+
+/* Compute CRC32 with the fastest implementation the CPU supports */
+uint32_t dr_crc32_calc(const void *input_data, size_t length)
+{
+	return dr_crc32_calc_func(input_data, length);
+}
+
+/*
+ * Copy the tag bytes selected by byte_mask, bit per byte with the MSB for
+ * the first byte, and zero the others.
+ */
+void dr_crc32_mask_tag(uint8_t *masked, const uint8_t *tag, uint16_t byte_mask)
+{
+#if defined(__x86_64__)
+	const __m128i sel = _mm_set_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+					 1, 2, 4, 8, 16, 32, 64, -128);
+	__m128i m;
+
+	m = _mm_unpacklo_epi64(_mm_set1_epi8(byte_mask >> 8),
+			       _mm_set1_epi8(byte_mask & 0xff));
+	m = _mm_cmpeq_epi8(_mm_and_si128(m, sel), sel);
+	_mm_storeu_si128((__m128i *)masked,
+			 _mm_and_si128(_mm_loadu_si128((const __m128i *)tag), m));
+#elif defined(__aarch64__)
+	static const uint8_t sel_bits[DR_STE_SIZE_TAG] = {
+		128, 64, 32, 16, 8, 4, 2, 1, 128, 64, 32, 16, 8, 4, 2, 1 };
+	uint8x16_t m;
+
+	m = vcombine_u8(vdup_n_u8(byte_mask >> 8), vdup_n_u8(byte_mask & 0xff));
+	m = vtstq_u8(m, vld1q_u8(sel_bits));
+	vst1q_u8(masked, vandq_u8(vld1q_u8(tag), m));
+#else
+	uint16_t bit = 1 << (DR_STE_SIZE_TAG - 1);
+	int i;
+
+	for (i = 0; i < DR_STE_SIZE_TAG; i++) {
+		masked[i] = (byte_mask & bit) ? tag[i] : 0;
+		bit = bit >> 1;
+	}
+#endif
+}
+
+void dr_crc32_init_table(void)
+{
+	uint32_t crc, i, j;
+
+	for (i = 0; i < 256; i++) {
+		crc = i;
+		for (j = 0; j < 8; j++) {
+			if (crc & 0x00000001L)
+				crc = (crc >> 1) ^ DR_STE_CRC_POLY;
+			else
+				crc = crc >> 1;
+		}
+		dr_ste_crc_tab32[0][i] = crc;
+	}
+
+	/* Init CRC lookup tables according to crc_slice_8 algorithm */
+	for (i = 0; i < 256; i++) {
+		dr_crc32_calc_lookup_entry(dr_ste_crc_tab32, 1, i);
+		dr_crc32_calc_lookup_entry(dr_ste_crc_tab32, 2, i);
+		dr_crc32_calc_lookup_entry(dr_ste_crc_tab32, 3, i);
+		dr_crc32_calc_lookup_entry(dr_ste_crc_tab32, 4, i);
+		dr_crc32_calc_lookup_entry(dr_ste_crc_tab32, 5, i);
+		dr_crc32_calc_lookup_entry(dr_ste_crc_tab32, 6, i);
+		dr_crc32_calc_lookup_entry(dr_ste_crc_tab32, 7, i);
+	}
+
+	dr_crc32_calc_func = dr_crc32_select();
 }
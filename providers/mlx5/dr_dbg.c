@@ -33,8 +33,10 @@
 #include <unistd.h>
 #include <inttypes.h>
 #include "mlx5dv_dr.h"
+#include "dr_dump.h"
 
-#define BUFF_SIZE	1024
+/* Written out between the locked sections of a dump */
+#define DR_DUMP_CHUNK_SIZE	(64 * 1024)
 
 enum dr_dump_rec_type {
 	DR_DUMP_REC_TYPE_DOMAIN = 3000,
@@ -43,6 +45,8 @@ enum dr_dump_rec_type {
 	DR_DUMP_REC_TYPE_DOMAIN_INFO_VPORT = 3003,
 	DR_DUMP_REC_TYPE_DOMAIN_INFO_CAPS = 3004,
 	DR_DUMP_REC_TYPE_DOMAIN_SEND_RING = 3005,
+	DR_DUMP_REC_TYPE_DOMAIN_ACTION_CACHE = 3006,
+	DR_DUMP_REC_TYPE_DOMAIN_MEMORY = 3007,
 
 	DR_DUMP_REC_TYPE_TABLE = 3100,
 	DR_DUMP_REC_TYPE_TABLE_RX = 3101,
@@ -84,164 +88,328 @@ enum dr_dump_rec_type {
 	DR_DUMP_REC_TYPE_ACTION_MISS = 3423,
 };
 
-static uint64_t dr_dump_icm_to_idx(uint64_t icm_addr)
+/*
+ * Records are built in a buffer by the helpers below, as text lines or as
+ * binary records of the same fields, see dr_dump.h.  The buffer is written
+ * out when it fills up and when a dump ends.
+ */
+struct dr_dump_ctx {
+	FILE		*f;
+	bool		binary;
+	char		*buf;
+	size_t		len;
+	size_t		size;
+	/* Start of the open record */
+	size_t		rec;
+	int		err;
+};
+
+static bool dr_dump_reserve(struct dr_dump_ctx *d, size_t len)
 {
-	return (icm_addr >> 6) & 0xffffffff;
+	size_t size;
+	char *buf;
+
+	if (d->err)
+		return false;
+
+	if (d->len + len <= d->size)
+		return true;
+
+	size = max_t(size_t, 2 * d->size, d->len + len);
+	buf = realloc(d->buf, size);
+	if (!buf) {
+		d->err = ENOMEM;
+		return false;
+	}
+
+	d->buf = buf;
+	d->size = size;
+	return true;
 }
 
-static void dump_hex_print(char *dest, char *src, uint32_t size)
+static void dr_dump_rec(struct dr_dump_ctx *d, enum dr_dump_rec_type type)
 {
-	int i;
+	struct dr_dump_bin_rec rec = { .type = htole16(type) };
+
+	if (!dr_dump_reserve(d, DR_DUMP_FIELD_TEXT_MAX(0)))
+		return;
+
+	d->rec = d->len;
+	if (d->binary) {
+		memcpy(d->buf + d->len, &rec, sizeof(rec));
+		d->len += sizeof(rec);
+	} else {
+		d->len += sprintf(d->buf + d->len, "%d", type);
+	}
+}
+
+static void dr_dump_field(struct dr_dump_ctx *d, uint8_t field, uint64_t val,
+			  const void *data, uint16_t len)
+{
+	__le16 le_len = htole16(len);
+	__le64 le_val = htole64(val);
+	char *p;
 
-	for (i = 0; i < size; i++)
-		sprintf(&dest[2 * i], "%02x", (uint8_t)src[i]);
+	if (!dr_dump_reserve(d, DR_DUMP_FIELD_TEXT_MAX(len)))
+		return;
+
+	if (!d->binary) {
+		d->len += dr_dump_field_text(d->buf + d->len, field, val,
+					     data, len);
+		return;
+	}
+
+	p = d->buf + d->len;
+	*p++ = field;
+	switch (field & ~DR_DUMP_FIELD_CONCAT) {
+	case DR_DUMP_FIELD_STR:
+	case DR_DUMP_FIELD_BYTES:
+		memcpy(p, &le_len, sizeof(le_len));
+		memcpy(p + sizeof(le_len), data, len);
+		p += sizeof(le_len) + len;
+		break;
+	default:
+		memcpy(p, &le_val, sizeof(le_val));
+		p += sizeof(le_val);
+		break;
+	}
+	d->len = p - d->buf;
 }
 
-static int dr_dump_rule_action(FILE *f, const uint64_t rule_id,
-			       struct mlx5dv_dr_action *action)
+static void dr_dump_rec_end(struct dr_dump_ctx *d)
+{
+	__le16 len;
+
+	if (!dr_dump_reserve(d, 1))
+		return;
+
+	if (d->binary) {
+		len = htole16(d->len - d->rec - sizeof(struct dr_dump_bin_rec));
+		memcpy(d->buf + d->rec + offsetof(struct dr_dump_bin_rec, len),
+		       &len, sizeof(len));
+	} else {
+		d->buf[d->len++] = '\n';
+	}
+}
+
+static void dr_dump_hex(struct dr_dump_ctx *d, uint64_t val)
+{
+	dr_dump_field(d, DR_DUMP_FIELD_HEX, val, NULL, 0);
+}
+
+static void dr_dump_dec(struct dr_dump_ctx *d, int64_t val)
+{
+	dr_dump_field(d, DR_DUMP_FIELD_DEC, val, NULL, 0);
+}
+
+static void dr_dump_udec(struct dr_dump_ctx *d, uint64_t val)
+{
+	dr_dump_field(d, DR_DUMP_FIELD_UDEC, val, NULL, 0);
+}
+
+static void dr_dump_str(struct dr_dump_ctx *d, const char *str)
+{
+	dr_dump_field(d, DR_DUMP_FIELD_STR, 0, str, strlen(str));
+}
+
+static void dr_dump_bytes(struct dr_dump_ctx *d, const void *data, uint16_t len)
+{
+	dr_dump_field(d, DR_DUMP_FIELD_BYTES, 0, data, len);
+}
+
+static int dr_dump_init(struct dr_dump_ctx *d, FILE *f, bool binary)
+{
+	struct dr_dump_bin_hdr hdr = {
+		.magic = DR_DUMP_BIN_MAGIC,
+		.version = htole16(DR_DUMP_BIN_VERSION),
+		.hdr_len = htole16(sizeof(hdr)),
+	};
+
+	memset(d, 0, sizeof(*d));
+	d->f = f;
+	d->binary = binary;
+
+	if (!dr_dump_reserve(d, DR_DUMP_CHUNK_SIZE))
+		return d->err;
+
+	if (binary) {
+		memcpy(d->buf, &hdr, sizeof(hdr));
+		d->len = sizeof(hdr);
+	}
+	return 0;
+}
+
+static void dr_dump_flush(struct dr_dump_ctx *d)
+{
+	if (!d->err && d->len && fwrite(d->buf, d->len, 1, d->f) != 1)
+		d->err = EIO;
+	d->len = 0;
+}
+
+static bool dr_dump_chunk_full(struct dr_dump_ctx *d)
+{
+	return d->len >= DR_DUMP_CHUNK_SIZE;
+}
+
+static int dr_dump_uninit(struct dr_dump_ctx *d)
+{
+	dr_dump_flush(d);
+	free(d->buf);
+	return d->err;
+}
+
+static uint64_t dr_dump_icm_to_idx(uint64_t icm_addr)
+{
+	return (icm_addr >> 6) & 0xffffffff;
+}
+
+static void dr_dump_rule_action(struct dr_dump_ctx *d, const uint64_t rule_id,
+				struct mlx5dv_dr_action *action)
 {
 	const uint64_t action_id = (uint64_t) (uintptr_t) action;
-	int ret;
 
 	switch (action->action_type) {
 	case DR_ACTION_TYP_DROP:
-		ret = fprintf(f, "%d,0x%" PRIx64 ",0x%" PRIx64 "\n",
-			      DR_DUMP_REC_TYPE_ACTION_DROP, action_id, rule_id);
+		dr_dump_rec(d, DR_DUMP_REC_TYPE_ACTION_DROP);
 		break;
 	case DR_ACTION_TYP_FT:
-		ret = fprintf(f, "%d,0x%" PRIx64 ",0x%" PRIx64 ",0x%x,0x%" PRIx64 "\n",
-			      DR_DUMP_REC_TYPE_ACTION_FT, action_id, rule_id,
-			      action->dest_tbl->devx_obj->object_id,
-			      (uint64_t)(uintptr_t)action->dest_tbl);
+		dr_dump_rec(d, DR_DUMP_REC_TYPE_ACTION_FT);
 		break;
 	case DR_ACTION_TYP_QP:
-		if (action->dest_qp.is_qp)
-			ret = fprintf(f, "%d,0x%" PRIx64 ",0x%" PRIx64 ",0x%x\n",
-				      DR_DUMP_REC_TYPE_ACTION_QP, action_id,
-				      rule_id, action->dest_qp.qp->qp_num);
-		else
-			ret = fprintf(f, "%d,0x%" PRIx64 ",0x%" PRIx64 ",0x%" PRIx64 "\n",
-				      DR_DUMP_REC_TYPE_ACTION_DEVX_TIR, action_id,
-				      rule_id, action->dest_qp.devx_tir->rx_icm_addr);
+		dr_dump_rec(d, action->dest_qp.is_qp ?
+			    DR_DUMP_REC_TYPE_ACTION_QP :
+			    DR_DUMP_REC_TYPE_ACTION_DEVX_TIR);
 		break;
 	case DR_ACTION_TYP_CTR:
-		ret = fprintf(f, "%d,0x%" PRIx64 ",0x%" PRIx64 ",0x%x\n",
-			      DR_DUMP_REC_TYPE_ACTION_CTR, action_id, rule_id,
-			      action->ctr.devx_obj->object_id +
-			      action->ctr.offset);
+		dr_dump_rec(d, DR_DUMP_REC_TYPE_ACTION_CTR);
 		break;
 	case DR_ACTION_TYP_TAG:
-		ret = fprintf(f, "%d,0x%" PRIx64 ",0x%" PRIx64 ",0x%x\n",
-			      DR_DUMP_REC_TYPE_ACTION_TAG, action_id, rule_id,
-			      action->flow_tag);
+		dr_dump_rec(d, DR_DUMP_REC_TYPE_ACTION_TAG);
 		break;
 	case DR_ACTION_TYP_MODIFY_HDR:
-		ret = fprintf(f, "%d,0x%" PRIx64 ",0x%" PRIx64 ",0x%x,%d\n",
-			      DR_DUMP_REC_TYPE_ACTION_MODIFY_HDR, action_id,
-			      rule_id, action->rewrite.index,
-			      action->rewrite.single_action_opt);
+		dr_dump_rec(d, DR_DUMP_REC_TYPE_ACTION_MODIFY_HDR);
 		break;
 	case DR_ACTION_TYP_VPORT:
-		ret = fprintf(f, "%d,0x%" PRIx64 ",0x%" PRIx64 ",0x%x\n",
-			      DR_DUMP_REC_TYPE_ACTION_VPORT, action_id, rule_id,
-			      action->vport.caps->num);
+		dr_dump_rec(d, DR_DUMP_REC_TYPE_ACTION_VPORT);
 		break;
 	case DR_ACTION_TYP_TNL_L2_TO_L2:
-		ret = fprintf(f, "%d,0x%" PRIx64 ",0x%" PRIx64 "\n",
-			      DR_DUMP_REC_TYPE_ACTION_DECAP_L2, action_id,
-			      rule_id);
+		dr_dump_rec(d, DR_DUMP_REC_TYPE_ACTION_DECAP_L2);
 		break;
 	case DR_ACTION_TYP_TNL_L3_TO_L2:
-		ret = fprintf(f, "%d,0x%" PRIx64 ",0x%" PRIx64 ",0x%x\n",
-			      DR_DUMP_REC_TYPE_ACTION_DECAP_L3, action_id,
-			      rule_id, action->rewrite.index);
+		dr_dump_rec(d, DR_DUMP_REC_TYPE_ACTION_DECAP_L3);
 		break;
 	case DR_ACTION_TYP_L2_TO_TNL_L2:
-		ret = fprintf(f, "%d,0x%" PRIx64 ",0x%" PRIx64 ",0x%x\n",
-			      DR_DUMP_REC_TYPE_ACTION_ENCAP_L2, action_id,
-			      rule_id, action->reformat.dvo->object_id);
+		dr_dump_rec(d, DR_DUMP_REC_TYPE_ACTION_ENCAP_L2);
 		break;
 	case DR_ACTION_TYP_L2_TO_TNL_L3:
-		ret = fprintf(f, "%d,0x%" PRIx64 ",0x%" PRIx64 ",0x%x\n",
-			      DR_DUMP_REC_TYPE_ACTION_ENCAP_L3, action_id,
-			      rule_id, action->reformat.dvo->object_id);
+		dr_dump_rec(d, DR_DUMP_REC_TYPE_ACTION_ENCAP_L3);
 		break;
 	case DR_ACTION_TYP_METER:
-		ret = fprintf(f, "%d,0x%" PRIx64 ",0x%" PRIx64 ",0x%" PRIx64 ",0x%x,0x%" PRIx64 ",0x%" PRIx64 "\n",
-			      DR_DUMP_REC_TYPE_ACTION_METER,
-			      action_id,
-			      rule_id,
-			      (uint64_t)(uintptr_t)action->meter.next_ft,
-			      action->meter.devx_obj->object_id,
-			      action->meter.rx_icm_addr,
-			      action->meter.tx_icm_addr);
+		dr_dump_rec(d, DR_DUMP_REC_TYPE_ACTION_METER);
 		break;
 	case DR_ACTION_TYP_SAMPLER:
-		ret = fprintf(f, "%d,0x%" PRIx64 ",0x%" PRIx64 ",0x%" PRIx64 ",0x%x,0x%x,0x%" PRIx64 ",0x%" PRIx64 "\n",
-			      DR_DUMP_REC_TYPE_ACTION_SAMPLER,
-			      action_id,
-			      rule_id,
-			      (uint64_t)(uintptr_t)action->sampler.sampler_default->next_ft,
-			      action->sampler.term_tbl->devx_tbl->ft_dvo->object_id,
-			      action->sampler.sampler_default->devx_obj->object_id,
-			      action->sampler.sampler_default->rx_icm_addr,
-			      (action->sampler.sampler_restore) ?
-					action->sampler.sampler_restore->tx_icm_addr :
-					action->sampler.sampler_default->tx_icm_addr);
+		dr_dump_rec(d, DR_DUMP_REC_TYPE_ACTION_SAMPLER);
 		break;
 	case DR_ACTION_TYP_DEST_ARRAY:
-		ret = fprintf(f, "%d,0x%" PRIx64 ",0x%" PRIx64 ",0x%x,0x%" PRIx64 ",0x%" PRIx64 "\n",
-			      DR_DUMP_REC_TYPE_ACTION_DEST_ARRAY, action_id, rule_id,
-			      action->dest_array.devx_tbl->ft_dvo->object_id,
-			      action->dest_array.rx_icm_addr,
-			      action->dest_array.tx_icm_addr);
+		dr_dump_rec(d, DR_DUMP_REC_TYPE_ACTION_DEST_ARRAY);
 		break;
 	case DR_ACTION_TYP_POP_VLAN:
-		ret = fprintf(f, "%d,0x%" PRIx64 ",0x%" PRIx64 "\n",
-			      DR_DUMP_REC_TYPE_ACTION_POP_VLAN, action_id,
-			      rule_id);
+		dr_dump_rec(d, DR_DUMP_REC_TYPE_ACTION_POP_VLAN);
 		break;
 	case DR_ACTION_TYP_PUSH_VLAN:
-		ret = fprintf(f, "%d,0x%" PRIx64 ",0x%" PRIx64 ",0x%x\n",
-			      DR_DUMP_REC_TYPE_ACTION_PUSH_VLAN, action_id,
-			      rule_id, action->push_vlan.vlan_hdr);
+		dr_dump_rec(d, DR_DUMP_REC_TYPE_ACTION_PUSH_VLAN);
 		break;
 	case DR_ACTION_TYP_ASO_FIRST_HIT:
-		ret = fprintf(f, "%d,0x%" PRIx64 ",0x%" PRIx64 ",0x%x\n",
-			      DR_DUMP_REC_TYPE_ACTION_ASO_FIRST_HIT, action_id,
-			      rule_id, action->aso.devx_obj->object_id);
+		dr_dump_rec(d, DR_DUMP_REC_TYPE_ACTION_ASO_FIRST_HIT);
 		break;
 	case DR_ACTION_TYP_ASO_FLOW_METER:
-		ret = fprintf(f, "%d,0x%" PRIx64 ",0x%" PRIx64 ",0x%x\n",
-			      DR_DUMP_REC_TYPE_ACTION_ASO_FLOW_METER, action_id,
-			      rule_id, action->aso.devx_obj->object_id);
+		dr_dump_rec(d, DR_DUMP_REC_TYPE_ACTION_ASO_FLOW_METER);
 		break;
 	case DR_ACTION_TYP_ASO_CT:
-		ret = fprintf(f, "%d,0x%" PRIx64 ",0x%" PRIx64 ",0x%x\n",
-			      DR_DUMP_REC_TYPE_ACTION_ASO_CT, action_id,
-			      rule_id, action->aso.devx_obj->object_id);
+		dr_dump_rec(d, DR_DUMP_REC_TYPE_ACTION_ASO_CT);
 		break;
 	case DR_ACTION_TYP_MISS:
-		ret = fprintf(f, "%d,0x%" PRIx64 ",0x%" PRIx64 "\n",
-			      DR_DUMP_REC_TYPE_ACTION_MISS, action_id, rule_id);
+		dr_dump_rec(d, DR_DUMP_REC_TYPE_ACTION_MISS);
 		break;
 	default:
-		return 0;
+		return;
 	}
 
-	if (ret < 0)
-		return ret;
+	dr_dump_hex(d, action_id);
+	dr_dump_hex(d, rule_id);
 
-	return 0;
+	switch (action->action_type) {
+	case DR_ACTION_TYP_FT:
+		dr_dump_hex(d, action->dest_tbl->devx_obj->object_id);
+		dr_dump_hex(d, (uint64_t)(uintptr_t)action->dest_tbl);
+		break;
+	case DR_ACTION_TYP_QP:
+		if (action->dest_qp.is_qp)
+			dr_dump_hex(d, action->dest_qp.qp->qp_num);
+		else
+			dr_dump_hex(d, action->dest_qp.devx_tir->rx_icm_addr);
+		break;
+	case DR_ACTION_TYP_CTR:
+		dr_dump_hex(d, (uint32_t)(action->ctr.devx_obj->object_id +
+					  action->ctr.offset));
+		break;
+	case DR_ACTION_TYP_TAG:
+		dr_dump_hex(d, action->flow_tag);
+		break;
+	case DR_ACTION_TYP_MODIFY_HDR:
+		dr_dump_hex(d, action->rewrite.index);
+		dr_dump_dec(d, action->rewrite.single_action_opt);
+		break;
+	case DR_ACTION_TYP_VPORT:
+		dr_dump_hex(d, action->vport.caps->num);
+		break;
+	case DR_ACTION_TYP_TNL_L3_TO_L2:
+		dr_dump_hex(d, action->rewrite.index);
+		break;
+	case DR_ACTION_TYP_L2_TO_TNL_L2:
+	case DR_ACTION_TYP_L2_TO_TNL_L3:
+		dr_dump_hex(d, action->reformat.dvo->object_id);
+		break;
+	case DR_ACTION_TYP_METER:
+		dr_dump_hex(d, (uint64_t)(uintptr_t)action->meter.next_ft);
+		dr_dump_hex(d, action->meter.devx_obj->object_id);
+		dr_dump_hex(d, action->meter.rx_icm_addr);
+		dr_dump_hex(d, action->meter.tx_icm_addr);
+		break;
+	case DR_ACTION_TYP_SAMPLER:
+		dr_dump_hex(d, (uint64_t)(uintptr_t)action->sampler.sampler_default->next_ft);
+		dr_dump_hex(d, action->sampler.term_tbl->devx_tbl->ft_dvo->object_id);
+		dr_dump_hex(d, action->sampler.sampler_default->devx_obj->object_id);
+		dr_dump_hex(d, action->sampler.sampler_default->rx_icm_addr);
+		dr_dump_hex(d, (action->sampler.sampler_restore) ?
+			       action->sampler.sampler_restore->tx_icm_addr :
+			       action->sampler.sampler_default->tx_icm_addr);
+		break;
+	case DR_ACTION_TYP_DEST_ARRAY:
+		dr_dump_hex(d, action->dest_array.devx_tbl->ft_dvo->object_id);
+		dr_dump_hex(d, action->dest_array.rx_icm_addr);
+		dr_dump_hex(d, action->dest_array.tx_icm_addr);
+		break;
+	case DR_ACTION_TYP_PUSH_VLAN:
+		dr_dump_hex(d, action->push_vlan.vlan_hdr);
+		break;
+	case DR_ACTION_TYP_ASO_FIRST_HIT:
+	case DR_ACTION_TYP_ASO_FLOW_METER:
+	case DR_ACTION_TYP_ASO_CT:
+		dr_dump_hex(d, action->aso.devx_obj->object_id);
+		break;
+	default:
+		break;
+	}
+
+	dr_dump_rec_end(d);
 }
 
-static int dr_dump_rule_mem(FILE *f, struct dr_ste *ste,
-			    bool is_rx, const uint64_t rule_id,
-			    enum mlx5_ifc_steering_format_version format_ver)
+static void dr_dump_rule_mem(struct dr_dump_ctx *d, struct dr_ste *ste,
+			     bool is_rx, const uint64_t rule_id,
+			     enum mlx5_ifc_steering_format_version format_ver)
 {
-	char hw_ste_dump[BUFF_SIZE] = {};
 	enum dr_dump_rec_type mem_rec_type;
-	int ret;
 
 	if (format_ver == MLX5_HW_CONNECTX_5) {
 		mem_rec_type = is_rx ? DR_DUMP_REC_TYPE_RULE_RX_ENTRY_V0 :
@@ -251,264 +419,151 @@ static int dr_dump_rule_mem(FILE *f, struct dr_ste *ste,
 				       DR_DUMP_REC_TYPE_RULE_TX_ENTRY_V1;
 	}
 
-	dump_hex_print(hw_ste_dump, (char *)ste->hw_ste, ste->size);
-	ret = fprintf(f, "%d,0x%" PRIx64 ",0x%" PRIx64 ",%s\n",
-		      mem_rec_type,
-		      dr_dump_icm_to_idx(dr_ste_get_icm_addr(ste)),
-		      rule_id,
-		      hw_ste_dump);
-	if (ret < 0)
-		return ret;
-
-	return 0;
+	dr_dump_rec(d, mem_rec_type);
+	dr_dump_hex(d, dr_dump_icm_to_idx(dr_ste_get_icm_addr(ste)));
+	dr_dump_hex(d, rule_id);
+	dr_dump_bytes(d, dr_ste_get_hw_ste(ste), dr_ste_hw_ste_sz(ste));
+	dr_dump_rec_end(d);
 }
 
-static int dr_dump_rule_rx_tx(FILE *f, struct dr_rule_rx_tx *nic_rule,
-			      bool is_rx, const uint64_t rule_id,
-			      enum mlx5_ifc_steering_format_version format_ver)
+static void dr_dump_rule_rx_tx(struct dr_dump_ctx *d,
+			       struct dr_rule_rx_tx *nic_rule,
+			       bool is_rx, const uint64_t rule_id,
+			       enum mlx5_ifc_steering_format_version format_ver)
 {
-	struct dr_ste *ste_arr[DR_RULE_MAX_STES + DR_ACTION_MAX_STES];
+	struct dr_ste *ste_arr[DR_RULE_MAX_STES + DR_ACTION_MAX_STES +
+			       DR_ACTION_ASO_CROSS_GVMI_STES];
 	struct dr_ste *curr_ste = nic_rule->last_rule_ste;
-	int ret, i;
+	int i;
 
 	dr_rule_get_reverse_rule_members(ste_arr, curr_ste, &i);
 
-	while (i--) {
-		ret = dr_dump_rule_mem(f, ste_arr[i], is_rx, rule_id, format_ver);
-		if (ret < 0)
-			return ret;
-	}
-
-	return 0;
+	while (i--)
+		dr_dump_rule_mem(d, ste_arr[i], is_rx, rule_id, format_ver);
 }
 
-static int dr_dump_rule(FILE *f, struct mlx5dv_dr_rule *rule)
+static void dr_dump_rule(struct dr_dump_ctx *d, struct mlx5dv_dr_rule *rule)
 {
 	const uint64_t rule_id = (uint64_t) (uintptr_t) rule;
 	enum mlx5_ifc_steering_format_version format_ver;
 	struct dr_rule_rx_tx *rx = &rule->rx;
 	struct dr_rule_rx_tx *tx = &rule->tx;
-	int ret;
 	int i;
 
 	format_ver = rule->matcher->tbl->dmn->info.caps.sw_format_ver;
 
-	ret = fprintf(f, "%d,0x%" PRIx64 ",0x%" PRIx64 "\n",
-		      DR_DUMP_REC_TYPE_RULE,
-		      rule_id,
-		      (uint64_t) (uintptr_t) rule->matcher);
-	if (ret < 0)
-		return ret;
+	dr_dump_rec(d, DR_DUMP_REC_TYPE_RULE);
+	dr_dump_hex(d, rule_id);
+	dr_dump_hex(d, (uint64_t) (uintptr_t) rule->matcher);
+	dr_dump_rec_end(d);
 
 	if (!dr_is_root_table(rule->matcher->tbl)) {
-		if (rx->nic_matcher) {
-			ret = dr_dump_rule_rx_tx(f, rx, true, rule_id,
-						 format_ver);
-			if (ret < 0)
-				return ret;
-		}
-
-		if (tx->nic_matcher) {
-			ret = dr_dump_rule_rx_tx(f, tx, false, rule_id,
-						 format_ver);
-			if (ret < 0)
-				return ret;
-		}
-	}
+		if (rx->nic_matcher)
+			dr_dump_rule_rx_tx(d, rx, true, rule_id, format_ver);
 
-	for (i = 0; i < rule->num_actions; i++) {
-		ret = dr_dump_rule_action(f, rule_id, rule->actions[i]);
-		if (ret < 0)
-			return ret;
+		if (tx->nic_matcher)
+			dr_dump_rule_rx_tx(d, tx, false, rule_id, format_ver);
 	}
 
-	return 0;
+	for (i = 0; i < rule->num_actions; i++)
+		dr_dump_rule_action(d, rule_id, rule->actions[i]);
 }
 
-static int dr_dump_matcher_mask(FILE *f, struct dr_match_param *mask,
+static void dr_dump_matcher_mask(struct dr_dump_ctx *d,
+				 struct dr_match_param *mask,
 				 uint8_t criteria, const uint64_t matcher_id)
 {
-	char dump[BUFF_SIZE] = {};
-	int ret;
-
-	ret = fprintf(f, "%d,0x%" PRIx64 ",", DR_DUMP_REC_TYPE_MATCHER_MASK, matcher_id);
-	if (ret < 0)
-		return ret;
-
-	if (criteria & DR_MATCHER_CRITERIA_OUTER) {
-		dump_hex_print(dump, (char *)&mask->outer, sizeof(mask->outer));
-		ret = fprintf(f, "%s,", dump);
-	} else {
-		ret = fprintf(f, ",");
-	}
-
-	if (ret < 0)
-		return ret;
-
-	if (criteria & DR_MATCHER_CRITERIA_INNER) {
-		dump_hex_print(dump, (char *)&mask->inner, sizeof(mask->inner));
-		ret = fprintf(f, "%s,", dump);
-	} else {
-		ret = fprintf(f, ",");
-	}
-
-
-	if (ret < 0)
-		return ret;
-
-	if (criteria & DR_MATCHER_CRITERIA_MISC) {
-		dump_hex_print(dump, (char *)&mask->misc, sizeof(mask->misc));
-		ret = fprintf(f, "%s,", dump);
-	} else {
-		ret = fprintf(f, ",");
-	}
-
-	if (ret < 0)
-		return ret;
-
-	if (criteria & DR_MATCHER_CRITERIA_MISC2) {
-		dump_hex_print(dump, (char *)&mask->misc2, sizeof(mask->misc2));
-		ret = fprintf(f, "%s,", dump);
-	} else {
-		ret = fprintf(f, ",");
-	}
-
-	if (ret < 0)
-		return ret;
-
-	if (criteria & DR_MATCHER_CRITERIA_MISC3) {
-		dump_hex_print(dump, (char *)&mask->misc3, sizeof(mask->misc3));
-		ret = fprintf(f, "%s,", dump);
-	} else {
-		ret = fprintf(f, ",");
-	}
-
-	if (criteria & DR_MATCHER_CRITERIA_MISC4) {
-		dump_hex_print(dump, (char *)&mask->misc4, sizeof(mask->misc4));
-		ret = fprintf(f, "%s,", dump);
-	} else {
-		ret = fprintf(f, ",");
-	}
-
+	dr_dump_rec(d, DR_DUMP_REC_TYPE_MATCHER_MASK);
+	dr_dump_hex(d, matcher_id);
+
+	/* Empty fields for the parts left out of the criteria */
+	dr_dump_bytes(d, &mask->outer, criteria & DR_MATCHER_CRITERIA_OUTER ?
+		      sizeof(mask->outer) : 0);
+	dr_dump_bytes(d, &mask->inner, criteria & DR_MATCHER_CRITERIA_INNER ?
+		      sizeof(mask->inner) : 0);
+	dr_dump_bytes(d, &mask->misc, criteria & DR_MATCHER_CRITERIA_MISC ?
+		      sizeof(mask->misc) : 0);
+	dr_dump_bytes(d, &mask->misc2, criteria & DR_MATCHER_CRITERIA_MISC2 ?
+		      sizeof(mask->misc2) : 0);
+	dr_dump_bytes(d, &mask->misc3, criteria & DR_MATCHER_CRITERIA_MISC3 ?
+		      sizeof(mask->misc3) : 0);
+	dr_dump_bytes(d, &mask->misc4, criteria & DR_MATCHER_CRITERIA_MISC4 ?
+		      sizeof(mask->misc4) : 0);
 	if (criteria & DR_MATCHER_CRITERIA_MISC5) {
-		dump_hex_print(dump, (char *)&mask->misc5, sizeof(mask->misc5));
-		ret = fprintf(f, "%s\n", dump);
+		dr_dump_bytes(d, &mask->misc5, sizeof(mask->misc5));
 	} else {
-		ret = fprintf(f, ",\n");
+		/* The text format always ended a missing misc5 with a comma */
+		dr_dump_bytes(d, NULL, 0);
+		dr_dump_bytes(d, NULL, 0);
 	}
-
-	if (ret < 0)
-		return ret;
-
-	return 0;
+	dr_dump_rec_end(d);
 }
 
-static int dr_dump_matcher_builder(FILE *f, struct dr_ste_build *builder,
-				   uint32_t index, bool is_rx,
-				   const uint64_t matcher_id)
+static void dr_dump_matcher_builder(struct dr_dump_ctx *d,
+				    struct dr_ste_build *builder,
+				    uint32_t index, bool is_rx,
+				    const uint64_t matcher_id)
 {
 	bool is_match = builder->htbl_type == DR_STE_HTBL_TYPE_MATCH;
-	int ret;
 
-	ret = fprintf(f, "%d,0x%" PRIx64 "%d,%d,0x%x,%d\n",
-		      DR_DUMP_REC_TYPE_MATCHER_BUILDER,
-		      matcher_id,
-		      index,
-		      is_rx,
-		      builder->lu_type,
-		      is_match ? builder->format_id : -1);
-	if (ret < 0)
-		return ret;
-
-	return 0;
+	dr_dump_rec(d, DR_DUMP_REC_TYPE_MATCHER_BUILDER);
+	dr_dump_hex(d, matcher_id);
+	/* The index always followed the matcher id without a comma */
+	dr_dump_field(d, DR_DUMP_FIELD_DEC | DR_DUMP_FIELD_CONCAT, index,
+		      NULL, 0);
+	dr_dump_dec(d, is_rx);
+	dr_dump_hex(d, builder->lu_type);
+	dr_dump_dec(d, is_match ? builder->format_id : -1);
+	dr_dump_rec_end(d);
 }
 
-static int dr_dump_matcher_rx_tx(FILE *f, bool is_rx,
-				 struct dr_matcher_rx_tx *matcher_rx_tx,
-				 const uint64_t matcher_id)
+static void dr_dump_matcher_rx_tx(struct dr_dump_ctx *d, bool is_rx,
+				  struct dr_matcher_rx_tx *matcher_rx_tx,
+				  const uint64_t matcher_id)
 {
-	enum dr_dump_rec_type rec_type;
-	int i, ret;
-
-	rec_type = is_rx ? DR_DUMP_REC_TYPE_MATCHER_RX :
-			   DR_DUMP_REC_TYPE_MATCHER_TX;
-
-	ret = fprintf(f, "%d,0x%" PRIx64 ",0x%" PRIx64 ",%d,0x%" PRIx64 ",0x%" PRIx64 ",%d\n",
-		      rec_type,
-		      (uint64_t) (uintptr_t) matcher_rx_tx,
-		      matcher_id,
-		      matcher_rx_tx->num_of_builders,
-		      dr_dump_icm_to_idx(matcher_rx_tx->s_htbl->chunk->icm_addr),
-		      dr_dump_icm_to_idx(matcher_rx_tx->e_anchor->chunk->icm_addr),
-		      matcher_rx_tx->fixed_size ? matcher_rx_tx->s_htbl->chunk_size : -1);
-	if (ret < 0)
-		return ret;
-
-	for (i = 0; i < matcher_rx_tx->num_of_builders; i++) {
-		ret = dr_dump_matcher_builder(f, &matcher_rx_tx->ste_builder[i],
-					      i, is_rx, matcher_id);
-		if (ret < 0)
-			return ret;
-	}
+	int i;
 
-	return 0;
+	dr_dump_rec(d, is_rx ? DR_DUMP_REC_TYPE_MATCHER_RX :
+			       DR_DUMP_REC_TYPE_MATCHER_TX);
+	dr_dump_hex(d, (uint64_t) (uintptr_t) matcher_rx_tx);
+	dr_dump_hex(d, matcher_id);
+	dr_dump_dec(d, matcher_rx_tx->num_of_builders);
+	dr_dump_hex(d, dr_dump_icm_to_idx(matcher_rx_tx->s_htbl->chunk->icm_addr));
+	dr_dump_hex(d, dr_dump_icm_to_idx(matcher_rx_tx->e_anchor->chunk->icm_addr));
+	dr_dump_dec(d, matcher_rx_tx->fixed_size ?
+		       (int)matcher_rx_tx->s_htbl->chunk_size : -1);
+	dr_dump_rec_end(d);
+
+	for (i = 0; i < matcher_rx_tx->num_of_builders; i++)
+		dr_dump_matcher_builder(d, &matcher_rx_tx->ste_builder[i],
+					i, is_rx, matcher_id);
 }
 
-static int dr_dump_matcher(FILE *f, struct mlx5dv_dr_matcher *matcher)
+static void dr_dump_matcher(struct dr_dump_ctx *d,
+			    struct mlx5dv_dr_matcher *matcher)
 {
 	struct dr_matcher_rx_tx *rx = &matcher->rx;
 	struct dr_matcher_rx_tx *tx = &matcher->tx;
 	uint64_t matcher_id;
-	int ret;
 
 	matcher_id = (uint64_t) (uintptr_t) matcher;
 
-	ret = fprintf(f, "%d,0x%" PRIx64 ",0x%" PRIx64 ",%d\n",
-		      DR_DUMP_REC_TYPE_MATCHER,
-		      matcher_id,
-		      (uint64_t) (uintptr_t) matcher->tbl,
-		      matcher->prio);
-	if (ret < 0)
-		return ret;
-
+	dr_dump_rec(d, DR_DUMP_REC_TYPE_MATCHER);
+	dr_dump_hex(d, matcher_id);
+	dr_dump_hex(d, (uint64_t) (uintptr_t) matcher->tbl);
+	dr_dump_dec(d, matcher->prio);
+	dr_dump_rec_end(d);
 
 	if (!dr_is_root_table(matcher->tbl)) {
-		ret = dr_dump_matcher_mask(f, &matcher->mask, matcher->match_criteria, matcher_id);
-		if (ret < 0)
-			return ret;
-
-		if (rx->nic_tbl) {
-			ret = dr_dump_matcher_rx_tx(f, true, rx, matcher_id);
-			if (ret < 0)
-				return ret;
-		}
+		dr_dump_matcher_mask(d, &matcher->mask, matcher->match_criteria,
+				     matcher_id);
 
-		if (tx->nic_tbl) {
-			ret = dr_dump_matcher_rx_tx(f, false, tx, matcher_id);
-			if (ret < 0)
-				return ret;
-		}
-	}
-
-	return 0;
-}
+		if (rx->nic_tbl)
+			dr_dump_matcher_rx_tx(d, true, rx, matcher_id);
 
-static int dr_dump_matcher_all(FILE *fout, struct mlx5dv_dr_matcher *matcher)
-{
-	struct mlx5dv_dr_rule *rule;
-	int ret;
-
-	ret = dr_dump_matcher(fout, matcher);
-	if (ret < 0)
-		return ret;
-
-	list_for_each(&matcher->rule_list, rule, rule_list) {
-		ret = dr_dump_rule(fout, rule);
-		if (ret < 0)
-			return ret;
+		if (tx->nic_tbl)
+			dr_dump_matcher_rx_tx(d, false, tx, matcher_id);
 	}
-
-	return 0;
 }
 
 static uint64_t dr_domain_id_calc(enum mlx5dv_dr_domain_type type)
@@ -516,353 +571,405 @@ static uint64_t dr_domain_id_calc(enum mlx5dv_dr_domain_type type)
 	return (getpid() << 8) | (type & 0xff);
 }
 
-static int dr_dump_table_rx_tx(FILE *f, bool is_rx,
-			       struct dr_table_rx_tx *table_rx_tx,
-			       const uint64_t table_id)
+static void dr_dump_table_rx_tx(struct dr_dump_ctx *d, bool is_rx,
+				struct dr_table_rx_tx *table_rx_tx,
+				const uint64_t table_id)
 {
-	enum dr_dump_rec_type rec_type;
-	int ret;
-
-	rec_type = is_rx ? DR_DUMP_REC_TYPE_TABLE_RX : DR_DUMP_REC_TYPE_TABLE_TX;
-
-	ret = fprintf(f, "%d,0x%" PRIx64 ",0x%" PRIx64 "\n",
-		      rec_type,
-		      table_id,
-		      dr_dump_icm_to_idx(table_rx_tx->s_anchor->chunk->icm_addr));
-	if (ret < 0)
-		return ret;
-
-	return 0;
+	dr_dump_rec(d, is_rx ? DR_DUMP_REC_TYPE_TABLE_RX :
+			       DR_DUMP_REC_TYPE_TABLE_TX);
+	dr_dump_hex(d, table_id);
+	dr_dump_hex(d, dr_dump_icm_to_idx(table_rx_tx->s_anchor->chunk->icm_addr));
+	dr_dump_rec_end(d);
 }
 
-static int dr_dump_table(FILE *f, struct mlx5dv_dr_table *table)
+static void dr_dump_table(struct dr_dump_ctx *d, struct mlx5dv_dr_table *table)
 {
 	struct dr_table_rx_tx *rx = &table->rx;
 	struct dr_table_rx_tx *tx = &table->tx;
-	int ret;
 
-	ret = fprintf(f, "%d,0x%" PRIx64 ",0x%" PRIx64 ",%d,%d\n",
-		      DR_DUMP_REC_TYPE_TABLE,
-		      (uint64_t) (uintptr_t) table,
-		      dr_domain_id_calc(table->dmn->type),
-		      table->table_type,
-		      table->level);
-	if (ret < 0)
-		return ret;
+	dr_dump_rec(d, DR_DUMP_REC_TYPE_TABLE);
+	dr_dump_hex(d, (uint64_t) (uintptr_t) table);
+	dr_dump_hex(d, dr_domain_id_calc(table->dmn->type));
+	dr_dump_dec(d, table->table_type);
+	dr_dump_dec(d, table->level);
+	dr_dump_rec_end(d);
 
 	if (!dr_is_root_table(table)) {
-		if (rx->nic_dmn) {
-			ret = dr_dump_table_rx_tx(f, true, rx, (uint64_t) (uintptr_t) table);
-			if (ret < 0)
-				return ret;
-		}
+		if (rx->nic_dmn)
+			dr_dump_table_rx_tx(d, true, rx, (uint64_t) (uintptr_t) table);
 
-		if (tx->nic_dmn) {
-			ret = dr_dump_table_rx_tx(f, false, tx, (uint64_t) (uintptr_t) table);
-			if (ret < 0)
-				return ret;
-		}
+		if (tx->nic_dmn)
+			dr_dump_table_rx_tx(d, false, tx, (uint64_t) (uintptr_t) table);
 	}
-	return 0;
 }
 
-static int dr_dump_table_all(FILE *fout, struct mlx5dv_dr_table *tbl)
+static void dr_dump_send_ring(struct dr_dump_ctx *d, struct dr_send_ring *ring,
+			      const uint64_t domain_id)
 {
-	struct mlx5dv_dr_matcher *matcher;
-	int ret;
-
-	ret = dr_dump_table(fout, tbl);
-	if (ret < 0)
-		return ret;
-
-	if (!dr_is_root_table(tbl)) {
-		list_for_each(&tbl->matcher_list, matcher, matcher_list) {
-			ret = dr_dump_matcher_all(fout, matcher);
-			if (ret < 0)
-				return ret;
-		}
-	}
-	return 0;
+	dr_dump_rec(d, DR_DUMP_REC_TYPE_DOMAIN_SEND_RING);
+	dr_dump_hex(d, (uint64_t) (uintptr_t) ring);
+	dr_dump_hex(d, domain_id);
+	dr_dump_hex(d, ring->cq.cqn);
+	dr_dump_hex(d, ring->qp->obj->object_id);
+	dr_dump_rec_end(d);
 }
 
-static int dr_dump_send_ring(FILE *f, struct dr_send_ring *ring,
-			     const uint64_t domain_id)
+static void dr_dump_action_cache(struct dr_dump_ctx *d,
+				 struct dr_action_cache *cache,
+				 const uint64_t domain_id)
 {
-	int ret;
-
-	ret = fprintf(f, "%d,0x%" PRIx64 ",0x%" PRIx64 ",0x%x,0x%x\n",
-		      DR_DUMP_REC_TYPE_DOMAIN_SEND_RING,
-		      (uint64_t) (uintptr_t) ring,
-		      domain_id,
-		      ring->cq.cqn,
-		      ring->qp->obj->object_id);
-	if (ret < 0)
-		return ret;
-
-	return 0;
+	pthread_spin_lock(&cache->lock);
+	dr_dump_rec(d, DR_DUMP_REC_TYPE_DOMAIN_ACTION_CACHE);
+	dr_dump_hex(d, domain_id);
+	dr_dump_udec(d, cache->num_entries);
+	dr_dump_udec(d, cache->num_dedup);
+	dr_dump_udec(d, cache->saved_bytes);
+	dr_dump_rec_end(d);
+	pthread_spin_unlock(&cache->lock);
 }
 
-static int dr_dump_domain_info_flex_parser(FILE *f, const char *flex_parser_name,
-					   const uint8_t flex_parser_value,
-					   const uint64_t domain_id)
+/* STE memory of the domain, in total and per rule */
+static void dr_dump_domain_memory(struct dr_dump_ctx *d,
+				  struct mlx5dv_dr_domain *dmn,
+				  const uint64_t domain_id)
 {
-	int ret;
-
-	ret = fprintf(f, "%d,0x%" PRIx64 ",%s,0x%x\n",
-		      DR_DUMP_REC_TYPE_DOMAIN_INFO_FLEX_PARSER,
-		      domain_id,
-		      flex_parser_name,
-		      flex_parser_value);
-	if (ret < 0)
-		return ret;
+	uint64_t icm_used, host_used, host_alloc;
+	uint64_t num_rules = dmn->num_rules;
+
+	dr_icm_pool_get_ste_mem(dmn->ste_icm_pool, &icm_used, &host_used,
+				&host_alloc);
+
+	dr_dump_rec(d, DR_DUMP_REC_TYPE_DOMAIN_MEMORY);
+	dr_dump_hex(d, domain_id);
+	dr_dump_udec(d, num_rules);
+	dr_dump_udec(d, icm_used);
+	dr_dump_udec(d, host_used);
+	dr_dump_udec(d, host_alloc);
+	dr_dump_udec(d, num_rules ? icm_used / num_rules : 0);
+	dr_dump_udec(d, num_rules ? host_used / num_rules : 0);
+	dr_dump_rec_end(d);
+}
 
-	return 0;
+static void dr_dump_domain_info_flex_parser(struct dr_dump_ctx *d,
+					    const char *flex_parser_name,
+					    const uint8_t flex_parser_value,
+					    const uint64_t domain_id)
+{
+	dr_dump_rec(d, DR_DUMP_REC_TYPE_DOMAIN_INFO_FLEX_PARSER);
+	dr_dump_hex(d, domain_id);
+	dr_dump_str(d, flex_parser_name);
+	dr_dump_hex(d, flex_parser_value);
+	dr_dump_rec_end(d);
 }
 
-static int dr_dump_vports_table(FILE *f, struct dr_vports_table *vports_tbl,
-				const uint64_t domain_id)
+static void dr_dump_vports_table(struct dr_dump_ctx *d,
+				 struct dr_vports_table *vports_tbl,
+				 const uint64_t domain_id)
 {
 	struct dr_devx_vport_cap *vport_cap;
-	int i, ret;
+	int i;
 
 	if (!vports_tbl)
-		return 0;
+		return;
 
 	for (i = 0; i < DR_VPORTS_BUCKETS; i++) {
 		vport_cap = vports_tbl->buckets[i];
 		while (vport_cap) {
-			ret = fprintf(f, "%d,0x%" PRIx64 ",%d,0x%x,0x%" PRIx64 ",0x%" PRIx64 "\n",
-				      DR_DUMP_REC_TYPE_DOMAIN_INFO_VPORT,
-				      domain_id,
-				      vport_cap->num,
-				      vport_cap->vport_gvmi,
-				      vport_cap->icm_address_rx,
-				      vport_cap->icm_address_tx);
-			if (ret < 0)
-				return ret;
+			dr_dump_rec(d, DR_DUMP_REC_TYPE_DOMAIN_INFO_VPORT);
+			dr_dump_hex(d, domain_id);
+			dr_dump_dec(d, vport_cap->num);
+			dr_dump_hex(d, vport_cap->vport_gvmi);
+			dr_dump_hex(d, vport_cap->icm_address_rx);
+			dr_dump_hex(d, vport_cap->icm_address_tx);
+			dr_dump_rec_end(d);
 
 			vport_cap = vport_cap->next;
 		}
 	}
+}
 
-	return 0;
+static void dr_dump_domain_info_caps(struct dr_dump_ctx *d,
+				     struct dr_devx_caps *caps,
+				     const uint64_t domain_id)
+{
+	dr_dump_rec(d, DR_DUMP_REC_TYPE_DOMAIN_INFO_CAPS);
+	dr_dump_hex(d, domain_id);
+	dr_dump_hex(d, caps->gvmi);
+	dr_dump_hex(d, caps->nic_rx_drop_address);
+	dr_dump_hex(d, caps->nic_tx_drop_address);
+	dr_dump_hex(d, caps->flex_protocols);
+	dr_dump_dec(d, caps->vports.num_ports);
+	dr_dump_dec(d, caps->eswitch_manager);
+	dr_dump_rec_end(d);
+
+	dr_dump_vports_table(d, caps->vports.vports, domain_id);
 }
 
-static int dr_dump_domain_info_caps(FILE *f, struct dr_devx_caps *caps,
+static void dr_dump_domain_info_dev_attr(struct dr_dump_ctx *d,
+					 struct dr_domain_info *info,
 					 const uint64_t domain_id)
 {
-	int ret;
-
-	ret = fprintf(f, "%d,0x%" PRIx64 ",0x%x,0x%" PRIx64 ",0x%" PRIx64 ",0x%x,%d,%d\n",
-		      DR_DUMP_REC_TYPE_DOMAIN_INFO_CAPS,
-		      domain_id,
-		      caps->gvmi,
-		      caps->nic_rx_drop_address,
-		      caps->nic_tx_drop_address,
-		      caps->flex_protocols,
-		      caps->vports.num_ports,
-		      caps->eswitch_manager);
-	if (ret < 0)
-		return ret;
-
-	ret = dr_dump_vports_table(f, caps->vports.vports, domain_id);
-	if (ret < 0)
-		return ret;
-
-	return 0;
+	dr_dump_rec(d, DR_DUMP_REC_TYPE_DOMAIN_INFO_DEV_ATTR);
+	dr_dump_hex(d, domain_id);
+	dr_dump_udec(d, info->caps.vports.num_ports);
+	dr_dump_str(d, info->attr.orig_attr.fw_ver);
+	dr_dump_dec(d, info->use_mqs);
+	dr_dump_rec_end(d);
 }
 
-static int dr_dump_domain_info_dev_attr(FILE *f, struct dr_domain_info *info,
-					const uint64_t domain_id)
+static void dr_dump_domain_info(struct dr_dump_ctx *d,
+				struct dr_domain_info *info,
+				const uint64_t domain_id)
 {
-	int ret;
-
-	ret = fprintf(f, "%d,0x%" PRIx64 ",%u,%s,%d\n",
-		      DR_DUMP_REC_TYPE_DOMAIN_INFO_DEV_ATTR,
-		      domain_id,
-		      info->caps.vports.num_ports,
-		      info->attr.orig_attr.fw_ver,
-		      info->use_mqs);
-	if (ret < 0)
-		return ret;
-
-	return 0;
+	dr_dump_domain_info_dev_attr(d, info, domain_id);
+	dr_dump_domain_info_caps(d, &info->caps, domain_id);
+	dr_dump_domain_info_flex_parser(d, "icmp_dw0", info->caps.flex_parser_id_icmp_dw0, domain_id);
+	dr_dump_domain_info_flex_parser(d, "icmp_dw1", info->caps.flex_parser_id_icmp_dw1, domain_id);
+	dr_dump_domain_info_flex_parser(d, "icmpv6_dw0", info->caps.flex_parser_id_icmpv6_dw0, domain_id);
+	dr_dump_domain_info_flex_parser(d, "icmpv6_dw1", info->caps.flex_parser_id_icmpv6_dw1, domain_id);
 }
-static int dr_dump_domain_info(FILE *f, struct dr_domain_info *info,
-			       const uint64_t domain_id)
-{
-	int ret;
-
-	ret = dr_dump_domain_info_dev_attr(f, info, domain_id);
-	if (ret < 0)
-		return ret;
-
-	ret = dr_dump_domain_info_caps(f, &info->caps, domain_id);
-	if (ret < 0)
-		return ret;
 
-	ret = dr_dump_domain_info_flex_parser(f, "icmp_dw0", info->caps.flex_parser_id_icmp_dw0, domain_id);
-	if (ret < 0)
-		return ret;
+static void dr_dump_domain(struct dr_dump_ctx *d, struct mlx5dv_dr_domain *dmn)
+{
+	enum mlx5dv_dr_domain_type dmn_type = dmn->type;
+	char *dev_name = dmn->ctx->device->dev_name;
+	uint64_t domain_id;
+	int i;
 
-	ret = dr_dump_domain_info_flex_parser(f, "icmp_dw1", info->caps.flex_parser_id_icmp_dw1, domain_id);
-	if (ret < 0)
-		return ret;
+	domain_id = dr_domain_id_calc(dmn_type);
 
-	ret = dr_dump_domain_info_flex_parser(f, "icmpv6_dw0", info->caps.flex_parser_id_icmpv6_dw0, domain_id);
-	if (ret < 0)
-		return ret;
+	dr_dump_rec(d, DR_DUMP_REC_TYPE_DOMAIN);
+	dr_dump_hex(d, domain_id);
+	dr_dump_dec(d, dmn_type);
+	/* The gvmi always came as a 0 and the hex digits */
+	dr_dump_str(d, "0");
+	dr_dump_field(d, DR_DUMP_FIELD_HEX_RAW | DR_DUMP_FIELD_CONCAT,
+		      dmn->info.caps.gvmi, NULL, 0);
+	dr_dump_dec(d, dmn->info.supp_sw_steering);
+	dr_dump_str(d, PACKAGE_VERSION);
+	dr_dump_str(d, dev_name);
+	dr_dump_rec_end(d);
+
+	dr_dump_domain_info(d, &dmn->info, domain_id);
+	dr_dump_action_cache(d, &dmn->action_cache, domain_id);
 
-	ret = dr_dump_domain_info_flex_parser(f, "icmpv6_dw1", info->caps.flex_parser_id_icmpv6_dw1, domain_id);
-	if (ret < 0)
-		return ret;
+	if (dmn->info.supp_sw_steering) {
+		for (i = 0; i < DR_MAX_SEND_RINGS; i++)
+			dr_dump_send_ring(d, dmn->send_ring[i], domain_id);
 
-	return 0;
+		dr_dump_domain_memory(d, dmn, domain_id);
+	}
 }
 
-static int dr_dump_domain(FILE *f, struct mlx5dv_dr_domain *dmn)
+static void dr_dump_lock(struct mlx5dv_dr_domain *dmn)
 {
-	enum mlx5dv_dr_domain_type dmn_type = dmn->type;
-	char *dev_name = dmn->ctx->device->dev_name;
-	uint64_t domain_id;
-	int ret, i;
-
-	domain_id = dr_domain_id_calc(dmn_type);
+	pthread_spin_lock(&dmn->debug_lock);
+	dr_domain_lock(dmn);
+}
 
-	ret = fprintf(f, "%d,0x%" PRIx64 ",%d,0%x,%d,%s,%s\n",
-		      DR_DUMP_REC_TYPE_DOMAIN,
-		      domain_id,
-		      dmn_type,
-		      dmn->info.caps.gvmi,
-		      dmn->info.supp_sw_steering,
-		      PACKAGE_VERSION,
-		      dev_name);
-	if (ret < 0)
-		return ret;
+static void dr_dump_unlock(struct mlx5dv_dr_domain *dmn)
+{
+	dr_domain_unlock(dmn);
+	pthread_spin_unlock(&dmn->debug_lock);
+}
 
-	ret = dr_dump_domain_info(f, &dmn->info, domain_id);
-	if (ret < 0)
-		return ret;
+/*
+ * The domain is locked only while a chunk of records is built, so rules can
+ * be created and destroyed during a dump.  The dump holds a reference on the
+ * table and matcher it is in, and dr_rule_destroy_rule() moves the rule
+ * cursor past a rule that goes away.
+ */
+static void dr_dump_rules_stream(struct dr_dump_ctx *d,
+				 struct mlx5dv_dr_matcher *matcher)
+{
+	struct mlx5dv_dr_domain *dmn = matcher->tbl->dmn;
+	struct mlx5dv_dr_rule *rule;
 
-	if (dmn->info.supp_sw_steering) {
-		for (i = 0; i < DR_MAX_SEND_RINGS; i++) {
-			ret = dr_dump_send_ring(f, dmn->send_ring[i], domain_id);
-			if (ret < 0)
-				return ret;
+	dr_dump_lock(dmn);
+	dmn->dump_rule = list_top(&matcher->rule_list, struct mlx5dv_dr_rule,
+				  rule_list);
+	while (dmn->dump_rule && !d->err) {
+		rule = dmn->dump_rule;
+		dr_dump_rule(d, rule);
+		dmn->dump_rule = list_next(&matcher->rule_list, rule, rule_list);
+
+		if (dr_dump_chunk_full(d)) {
+			dr_dump_unlock(dmn);
+			dr_dump_flush(d);
+			dr_dump_lock(dmn);
 		}
 	}
-
-	return 0;
+	dmn->dump_rule = NULL;
+	dr_dump_unlock(dmn);
 }
 
-static int dr_dump_domain_all(FILE *fout, struct mlx5dv_dr_domain *dmn)
+static void dr_dump_matcher_stream(struct dr_dump_ctx *d,
+				   struct mlx5dv_dr_matcher *matcher)
 {
-	struct mlx5dv_dr_table *tbl;
-	int ret;
+	dr_dump_lock(matcher->tbl->dmn);
+	dr_dump_matcher(d, matcher);
+	dr_dump_unlock(matcher->tbl->dmn);
 
-	ret = dr_dump_domain(fout, dmn);
-	if (ret < 0)
-		return ret;
+	dr_dump_rules_stream(d, matcher);
+	dr_dump_flush(d);
+}
 
-	list_for_each(&dmn->tbl_list, tbl, tbl_list) {
-		ret = dr_dump_table_all(fout, tbl);
-		if (ret < 0)
-			return ret;
+static void dr_dump_table_stream(struct dr_dump_ctx *d,
+				 struct mlx5dv_dr_table *tbl)
+{
+	struct mlx5dv_dr_matcher *matcher, *next;
+
+	dr_dump_lock(tbl->dmn);
+	dr_dump_table(d, tbl);
+	matcher = dr_is_root_table(tbl) ? NULL :
+		  list_top(&tbl->matcher_list, struct mlx5dv_dr_matcher,
+			   matcher_list);
+	if (matcher)
+		atomic_fetch_add(&matcher->refcount, 1);
+	dr_dump_unlock(tbl->dmn);
+	dr_dump_flush(d);
+
+	while (matcher) {
+		if (!d->err)
+			dr_dump_matcher_stream(d, matcher);
+
+		dr_domain_lock(tbl->dmn);
+		next = d->err ? NULL :
+		       list_next(&tbl->matcher_list, matcher, matcher_list);
+		if (next)
+			atomic_fetch_add(&next->refcount, 1);
+		dr_domain_unlock(tbl->dmn);
+
+		atomic_fetch_sub(&matcher->refcount, 1);
+		matcher = next;
 	}
+}
 
-	return 0;
+static void dr_dump_domain_stream(struct dr_dump_ctx *d,
+				  struct mlx5dv_dr_domain *dmn)
+{
+	struct mlx5dv_dr_table *tbl, *next;
+
+	dr_dump_lock(dmn);
+	dr_dump_domain(d, dmn);
+	tbl = list_top(&dmn->tbl_list, struct mlx5dv_dr_table, tbl_list);
+	if (tbl)
+		atomic_fetch_add(&tbl->refcount, 1);
+	dr_dump_unlock(dmn);
+	dr_dump_flush(d);
+
+	while (tbl) {
+		if (!d->err)
+			dr_dump_table_stream(d, tbl);
+
+		dr_domain_lock(dmn);
+		next = d->err ? NULL : list_next(&dmn->tbl_list, tbl, tbl_list);
+		if (next)
+			atomic_fetch_add(&next->refcount, 1);
+		dr_domain_unlock(dmn);
+
+		atomic_fetch_sub(&tbl->refcount, 1);
+		tbl = next;
+	}
 }
 
-int mlx5dv_dump_dr_domain(FILE *fout, struct mlx5dv_dr_domain *dmn)
+int mlx5dv_dump_dr_domain_ex(FILE *fout, struct mlx5dv_dr_domain *dmn,
+			     uint32_t flags)
 {
+	struct dr_dump_ctx d;
 	int ret;
 
 	if (!fout || !dmn)
 		return -EINVAL;
 
-	pthread_spin_lock(&dmn->debug_lock);
-	dr_domain_lock(dmn);
+	if (!check_comp_mask(flags, MLX5DV_DUMP_DR_FLAGS_BINARY))
+		return EOPNOTSUPP;
 
-	ret = dr_dump_domain_all(fout, dmn);
+	ret = dr_dump_init(&d, fout, flags & MLX5DV_DUMP_DR_FLAGS_BINARY);
+	if (ret)
+		return ret;
 
-	dr_domain_unlock(dmn);
-	pthread_spin_unlock(&dmn->debug_lock);
+	pthread_mutex_lock(&dmn->dump_mutex);
+	dr_dump_domain_stream(&d, dmn);
+	pthread_mutex_unlock(&dmn->dump_mutex);
+
+	return dr_dump_uninit(&d);
+}
 
-	return ret;
+int mlx5dv_dump_dr_domain(FILE *fout, struct mlx5dv_dr_domain *dmn)
+{
+	return mlx5dv_dump_dr_domain_ex(fout, dmn, 0);
 }
 
 int mlx5dv_dump_dr_table(FILE *fout, struct mlx5dv_dr_table *tbl)
 {
+	struct dr_dump_ctx d;
 	int ret;
 
 	if (!fout || !tbl)
 		return -EINVAL;
 
-	pthread_spin_lock(&tbl->dmn->debug_lock);
-	dr_domain_lock(tbl->dmn);
+	ret = dr_dump_init(&d, fout, false);
+	if (ret)
+		return ret;
 
-	ret = dr_dump_domain(fout, tbl->dmn);
-	if (ret < 0)
-		goto out;
+	pthread_mutex_lock(&tbl->dmn->dump_mutex);
+	dr_dump_lock(tbl->dmn);
+	dr_dump_domain(&d, tbl->dmn);
+	dr_dump_unlock(tbl->dmn);
 
-	ret = dr_dump_table_all(fout, tbl);
-out:
-	dr_domain_unlock(tbl->dmn);
-	pthread_spin_unlock(&tbl->dmn->debug_lock);
-	return ret;
+	dr_dump_table_stream(&d, tbl);
+	pthread_mutex_unlock(&tbl->dmn->dump_mutex);
+
+	return dr_dump_uninit(&d);
 }
 
 int mlx5dv_dump_dr_matcher(FILE *fout, struct mlx5dv_dr_matcher *matcher)
 {
+	struct mlx5dv_dr_domain *dmn;
+	struct dr_dump_ctx d;
 	int ret;
 
 	if (!fout || !matcher)
 		return -EINVAL;
 
-	pthread_spin_lock(&matcher->tbl->dmn->debug_lock);
-	dr_domain_lock(matcher->tbl->dmn);
+	dmn = matcher->tbl->dmn;
+	ret = dr_dump_init(&d, fout, false);
+	if (ret)
+		return ret;
 
-	ret = dr_dump_domain(fout, matcher->tbl->dmn);
-	if (ret < 0)
-		goto out;
+	pthread_mutex_lock(&dmn->dump_mutex);
+	dr_dump_lock(dmn);
+	dr_dump_domain(&d, dmn);
+	dr_dump_table(&d, matcher->tbl);
+	dr_dump_unlock(dmn);
 
-	ret = dr_dump_table(fout, matcher->tbl);
-	if (ret < 0)
-		goto out;
+	dr_dump_matcher_stream(&d, matcher);
+	pthread_mutex_unlock(&dmn->dump_mutex);
 
-	ret = dr_dump_matcher_all(fout, matcher);
-out:
-	dr_domain_unlock(matcher->tbl->dmn);
-	pthread_spin_unlock(&matcher->tbl->dmn->debug_lock);
-	return ret;
+	return dr_dump_uninit(&d);
 }
 
 int mlx5dv_dump_dr_rule(FILE *fout, struct mlx5dv_dr_rule *rule)
 {
+	struct mlx5dv_dr_domain *dmn;
+	struct dr_dump_ctx d;
 	int ret;
 
 	if (!fout || !rule)
 		return -EINVAL;
 
-	pthread_spin_lock(&rule->matcher->tbl->dmn->debug_lock);
-	dr_domain_lock(rule->matcher->tbl->dmn);
-
-	ret = dr_dump_domain(fout, rule->matcher->tbl->dmn);
-	if (ret < 0)
-		goto out;
-
-	ret = dr_dump_table(fout, rule->matcher->tbl);
-	if (ret < 0)
-		goto out;
+	dmn = rule->matcher->tbl->dmn;
+	ret = dr_dump_init(&d, fout, false);
+	if (ret)
+		return ret;
 
-	ret = dr_dump_matcher(fout, rule->matcher);
-	if (ret < 0)
-		goto out;
+	dr_dump_lock(dmn);
+	dr_dump_domain(&d, dmn);
+	dr_dump_table(&d, rule->matcher->tbl);
+	dr_dump_matcher(&d, rule->matcher);
+	dr_dump_rule(&d, rule);
+	dr_dump_unlock(dmn);
 
-	ret = dr_dump_rule(fout, rule);
-out:
-	dr_domain_unlock(rule->matcher->tbl->dmn);
-	pthread_spin_unlock(&rule->matcher->tbl->dmn->debug_lock);
-	return ret;
+	return dr_dump_uninit(&d);
 }
-
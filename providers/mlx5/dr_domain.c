@@ -427,6 +427,7 @@ mlx5dv_dr_domain_create(struct ibv_context *ctx,
 	dmn->type = type;
 	atomic_init(&dmn->refcount, 1);
 	list_head_init(&dmn->tbl_list);
+	list_head_init(&dmn->async_list);
 
 	ret = pthread_spin_init(&dmn->debug_lock, PTHREAD_PROCESS_PRIVATE);
 	if (ret) {
@@ -434,9 +435,25 @@ mlx5dv_dr_domain_create(struct ibv_context *ctx,
 		goto free_domain;
 	}
 
+	ret = pthread_spin_init(&dmn->async_lock, PTHREAD_PROCESS_PRIVATE);
+	if (ret) {
+		errno = ret;
+		goto free_debug_lock;
+	}
+
+	ret = pthread_mutex_init(&dmn->dump_mutex, NULL);
+	if (ret) {
+		errno = ret;
+		goto free_async_lock;
+	}
+
+	ret = dr_action_cache_init(dmn);
+	if (ret)
+		goto free_dump_mutex;
+
 	ret = dr_domain_nic_lock_init(&dmn->info.rx);
 	if (ret)
-		goto free_debug_lock;
+		goto uninit_action_cache;
 
 	ret = dr_domain_nic_lock_init(&dmn->info.tx);
 	if (ret)
@@ -471,6 +488,12 @@ uninit_tx_locks:
 	dr_domain_nic_lock_uninit(&dmn->info.tx);
 uninit_rx_locks:
 	dr_domain_nic_lock_uninit(&dmn->info.rx);
+uninit_action_cache:
+	dr_action_cache_uninit(dmn);
+free_dump_mutex:
+	pthread_mutex_destroy(&dmn->dump_mutex);
+free_async_lock:
+	pthread_spin_destroy(&dmn->async_lock);
 free_debug_lock:
 	pthread_spin_destroy(&dmn->debug_lock);
 free_domain:
@@ -545,6 +568,10 @@ int mlx5dv_dr_domain_destroy(struct mlx5dv_dr_domain *dmn)
 	if (atomic_load(&dmn->refcount) > 1)
 		return EBUSY;
 
+	/* Async operations not polled yet still own their rules */
+	if (!list_empty(&dmn->async_list))
+		return EBUSY;
+
 	if (dmn->info.supp_sw_steering) {
 		/* make sure resources are not used by the hardware */
 		dr_devx_sync_steering(dmn->ctx);
@@ -555,6 +582,9 @@ int mlx5dv_dr_domain_destroy(struct mlx5dv_dr_domain *dmn)
 
 	dr_domain_nic_lock_uninit(&dmn->info.tx);
 	dr_domain_nic_lock_uninit(&dmn->info.rx);
+	dr_action_cache_uninit(dmn);
+	pthread_mutex_destroy(&dmn->dump_mutex);
+	pthread_spin_destroy(&dmn->async_lock);
 	pthread_spin_destroy(&dmn->debug_lock);
 
 	free(dmn);
@@ -0,0 +1,139 @@
+/* GPLv2 or OpenIB.org BSD (MIT) See COPYING file */
+
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <endian.h>
+#include <ccan/minmax.h>
+
+#include "dr_dump.h"
+
+/* Text of a field including its separator, returns its length */
+size_t dr_dump_field_text(char *dest, uint8_t field, uint64_t val,
+			  const void *data, uint16_t len)
+{
+	static const char hex[] = "0123456789abcdef";
+	const uint8_t *bytes = data;
+	char *p = dest;
+	uint16_t i;
+
+	if (!(field & DR_DUMP_FIELD_CONCAT))
+		*p++ = ',';
+
+	switch (field & ~DR_DUMP_FIELD_CONCAT) {
+	case DR_DUMP_FIELD_HEX:
+		p += sprintf(p, "0x%" PRIx64, val);
+		break;
+	case DR_DUMP_FIELD_HEX_RAW:
+		p += sprintf(p, "%" PRIx64, val);
+		break;
+	case DR_DUMP_FIELD_DEC:
+		p += sprintf(p, "%" PRId64, (int64_t)val);
+		break;
+	case DR_DUMP_FIELD_UDEC:
+		p += sprintf(p, "%" PRIu64, val);
+		break;
+	case DR_DUMP_FIELD_STR:
+		memcpy(p, data, len);
+		p += len;
+		break;
+	case DR_DUMP_FIELD_BYTES:
+		for (i = 0; i < len; i++) {
+			*p++ = hex[bytes[i] >> 4];
+			*p++ = hex[bytes[i] & 0xf];
+		}
+		break;
+	}
+
+	*p = '\0';
+	return p - dest;
+}
+
+/* Text of the fields of one record, returns 0 or EINVAL if malformed */
+static int dr_dump_rec_to_text(char *dest, const uint8_t *fields, size_t len)
+{
+	const uint8_t *end = fields + len;
+	uint16_t data_len;
+	uint64_t val;
+	uint8_t field;
+
+	while (fields < end) {
+		field = *fields++;
+		switch (field & ~DR_DUMP_FIELD_CONCAT) {
+		case DR_DUMP_FIELD_HEX:
+		case DR_DUMP_FIELD_HEX_RAW:
+		case DR_DUMP_FIELD_DEC:
+		case DR_DUMP_FIELD_UDEC:
+			if (end - fields < sizeof(val))
+				return EINVAL;
+			memcpy(&val, fields, sizeof(val));
+			fields += sizeof(val);
+			dest += dr_dump_field_text(dest, field, le64toh(val),
+						   NULL, 0);
+			break;
+		case DR_DUMP_FIELD_STR:
+		case DR_DUMP_FIELD_BYTES:
+			if (end - fields < sizeof(data_len))
+				return EINVAL;
+			memcpy(&data_len, fields, sizeof(data_len));
+			fields += sizeof(data_len);
+			data_len = le16toh(data_len);
+			if (end - fields < data_len)
+				return EINVAL;
+			dest += dr_dump_field_text(dest, field, 0, fields,
+						   data_len);
+			fields += data_len;
+			break;
+		default:
+			return EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Convert a binary dump to the text one would have been, returns 0 or an
+ * errno value, EINVAL for a stream that is not a binary dump of a known
+ * version.
+ */
+int dr_dump_bin_to_text(FILE *in, FILE *out)
+{
+	/* A field of n bytes takes at most 2n + 24 characters in text */
+	static char line[8 * UINT16_MAX + 64];
+	static uint8_t fields[UINT16_MAX];
+	struct dr_dump_bin_hdr hdr;
+	struct dr_dump_bin_rec rec;
+	size_t skip, len;
+	char pad[64];
+	int ret;
+
+	if (fread(&hdr, sizeof(hdr), 1, in) != 1 ||
+	    memcmp(hdr.magic, DR_DUMP_BIN_MAGIC, sizeof(hdr.magic)) ||
+	    le16toh(hdr.version) > DR_DUMP_BIN_VERSION ||
+	    le16toh(hdr.hdr_len) < sizeof(hdr))
+		return EINVAL;
+
+	/* Newer headers may be longer */
+	for (skip = le16toh(hdr.hdr_len) - sizeof(hdr); skip; skip -= len) {
+		len = min_t(size_t, skip, sizeof(pad));
+		if (fread(pad, len, 1, in) != 1)
+			return EINVAL;
+	}
+
+	while (fread(&rec, sizeof(rec), 1, in) == 1) {
+		len = le16toh(rec.len);
+		if (len && fread(fields, len, 1, in) != 1)
+			return EINVAL;
+
+		sprintf(line, "%d", le16toh(rec.type));
+		ret = dr_dump_rec_to_text(line + strlen(line), fields, len);
+		if (ret)
+			return ret;
+
+		if (fprintf(out, "%s\n", line) < 0)
+			return EIO;
+	}
+
+	return ferror(in) ? EIO : 0;
+}
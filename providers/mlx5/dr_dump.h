@@ -0,0 +1,57 @@
+/* GPLv2 or OpenIB.org BSD (MIT) See COPYING file */
+
+#ifndef _DR_DUMP_H_
+#define _DR_DUMP_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <linux/types.h>
+
+/*
+ * Binary format of the DR dumps.  A file header is followed by records, each
+ * a record header and the fields of the record, every field a type byte and
+ * its value.  A record carries the same fields as its text line and converts
+ * to exactly that line, see dr_dump_bin_to_text().  All values are little
+ * endian.
+ */
+#define DR_DUMP_BIN_MAGIC	"MLX5DRDB"
+#define DR_DUMP_BIN_VERSION	1
+
+struct dr_dump_bin_hdr {
+	char		magic[8];
+	__le16		version;
+	/* Bytes up to the first record */
+	__le16		hdr_len;
+	__le32		reserved;
+};
+
+struct dr_dump_bin_rec {
+	__le16		type;
+	/* Bytes of fields after this header */
+	__le16		len;
+};
+
+enum dr_dump_field_type {
+	/* A __le64 value */
+	DR_DUMP_FIELD_HEX,	/* 0x prefixed hex */
+	DR_DUMP_FIELD_HEX_RAW,	/* hex without prefix */
+	DR_DUMP_FIELD_DEC,	/* signed decimal */
+	DR_DUMP_FIELD_UDEC,	/* unsigned decimal */
+	/* A __le16 length and that many bytes */
+	DR_DUMP_FIELD_STR,
+	DR_DUMP_FIELD_BYTES,	/* hex string */
+	DR_DUMP_FIELD_MAX,
+};
+
+/* Field follows the previous one without a comma in text */
+#define DR_DUMP_FIELD_CONCAT	0x80
+
+/* Longest text of a field holding len bytes */
+#define DR_DUMP_FIELD_TEXT_MAX(len)	(2 * (len) + 24)
+
+size_t dr_dump_field_text(char *dest, uint8_t field, uint64_t val,
+			  const void *data, uint16_t len);
+int dr_dump_bin_to_text(FILE *in, FILE *out);
+
+#endif
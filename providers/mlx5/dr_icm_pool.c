@@ -511,6 +511,32 @@ void dr_icm_pool_set_pool_max_log_chunk_sz(struct dr_icm_pool *pool,
 	pthread_spin_unlock(&pool->lock);
 }
 
+/* ICM bytes in use and the host memory shadowing the STE pool: the part
+ * backing the used entries and all that is allocated for the buddies.
+ */
+void dr_icm_pool_get_ste_mem(struct dr_icm_pool *pool, uint64_t *icm_used,
+			     uint64_t *host_used, uint64_t *host_alloc)
+{
+	struct dr_icm_buddy_mem *buddy;
+	size_t entry_sz;
+
+	*icm_used = 0;
+	*host_used = 0;
+	*host_alloc = 0;
+
+	pthread_spin_lock(&pool->lock);
+	list_for_each(&pool->buddy_mem_list, buddy, list_node) {
+		entry_sz = sizeof(struct dr_ste) + buddy->hw_ste_sz +
+			   sizeof(struct list_head);
+
+		*icm_used += buddy->used_memory;
+		*host_used += buddy->used_memory / DR_STE_SIZE * entry_sz;
+		*host_alloc += entry_sz *
+			dr_icm_pool_chunk_size_to_entries(buddy->max_order);
+	}
+	pthread_spin_unlock(&pool->lock);
+}
+
 struct dr_icm_pool *dr_icm_pool_create(struct mlx5dv_dr_domain *dmn,
 				       enum dr_icm_type icm_type)
 {
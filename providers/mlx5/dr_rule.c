@@ -32,11 +32,15 @@
 
 #include <stdlib.h>
 #include <ccan/minmax.h>
+#include <util/bitmap.h>
 #include "mlx5dv_dr.h"
 
 /* +1 for the cross GVMI STE */
 #define DR_RULE_MAX_STE_CHAIN (DR_RULE_MAX_STES + DR_ACTION_MAX_STES + 1)
 
+/* Old buckets moved to a growing hash table on each insertion or deletion */
+#define DR_RULE_GROW_BUCKETS 64
+
 static int dr_rule_append_to_miss_list(struct dr_ste_ctx *ste_ctx,
 				       struct dr_ste *new_last_ste,
 				       struct list_head *miss_list,
@@ -56,13 +60,13 @@ static int dr_rule_append_to_miss_list(struct dr_ste_ctx *ste_ctx,
 	}
 
 	dr_ste_set_miss_addr(ste_ctx,
-			     last_ste->hw_ste,
+			     dr_ste_get_hw_ste(last_ste),
 			     dr_ste_get_icm_addr(new_last_ste));
 
 	list_add_tail(miss_list, &new_last_ste->miss_list_node);
 
 	dr_send_fill_and_append_ste_send_info(last_ste, DR_STE_SIZE_CTRL,
-					      0, last_ste->hw_ste,
+					      0, dr_ste_get_hw_ste(last_ste),
 					      ste_info_last, send_list, true);
 
 	return 0;
@@ -133,7 +137,8 @@ free_tbl:
 
 static int dr_rule_handle_one_ste_in_update_list(struct dr_ste_send_info *ste_info,
 						 struct mlx5dv_dr_domain *dmn,
-						 uint8_t send_ring_idx)
+						 uint8_t send_ring_idx,
+						 bool nowait)
 {
 	int ret;
 
@@ -143,13 +148,22 @@ static int dr_rule_handle_one_ste_in_update_list(struct dr_ste_send_info *ste_in
 	 * is already written to the hw.
 	 */
 	if (ste_info->size == DR_STE_SIZE_CTRL)
-		memcpy(ste_info->ste->hw_ste, ste_info->data, DR_STE_SIZE_CTRL);
+		memcpy(dr_ste_get_hw_ste(ste_info->ste), ste_info->data,
+		       DR_STE_SIZE_CTRL);
 	else
-		memcpy(ste_info->ste->hw_ste, ste_info->data, ste_info->ste->size);
-
-	ret = dr_send_postsend_ste(dmn, ste_info->ste, ste_info->data,
-				   ste_info->size, ste_info->offset,
-				   send_ring_idx);
+		memcpy(dr_ste_get_hw_ste(ste_info->ste), ste_info->data,
+		       dr_ste_hw_ste_sz(ste_info->ste));
+
+	if (nowait)
+		ret = dr_send_postsend_ste_nowait(dmn, ste_info->ste,
+						  ste_info->data,
+						  ste_info->size,
+						  ste_info->offset,
+						  send_ring_idx);
+	else
+		ret = dr_send_postsend_ste(dmn, ste_info->ste, ste_info->data,
+					   ste_info->size, ste_info->offset,
+					   send_ring_idx);
 	if (ret)
 		goto out;
 
@@ -171,7 +185,8 @@ int dr_rule_send_update_list(struct list_head *send_ste_list,
 				       send_list) {
 			ret = dr_rule_handle_one_ste_in_update_list(ste_info,
 								    dmn,
-								    send_ring_idx);
+								    send_ring_idx,
+								    false);
 			if (ret)
 				return ret;
 		}
@@ -180,7 +195,8 @@ int dr_rule_send_update_list(struct list_head *send_ste_list,
 				   send_list) {
 			ret = dr_rule_handle_one_ste_in_update_list(ste_info,
 								    dmn,
-								    send_ring_idx);
+								    send_ring_idx,
+								    false);
 			if (ret)
 				return ret;
 		}
@@ -189,6 +205,238 @@ int dr_rule_send_update_list(struct list_head *send_ste_list,
 	return 0;
 }
 
+/* Send the writes of an async rule, queued when the send ring is full */
+static int dr_rule_send_update_list_nowait(struct list_head *send_ste_list,
+					   struct mlx5dv_dr_domain *dmn,
+					   uint8_t send_ring_idx)
+{
+	struct dr_ste_send_info *ste_info, *tmp_ste_info;
+	int ret;
+
+	list_for_each_rev_safe(send_ste_list, ste_info, tmp_ste_info,
+			       send_list) {
+		ret = dr_rule_handle_one_ste_in_update_list(ste_info, dmn,
+							    send_ring_idx,
+							    true);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/* Pending STE writes queued by bulk insertion before they are flushed */
+#define DR_RULE_BULK_MAX_PENDING 4096
+
+struct dr_rule_bulk_write {
+	struct dr_ste_send_info	*ste_info;
+	uint64_t		mr_addr;
+	uint32_t		rkey;
+	uint32_t		order;
+	uint32_t		seq;
+};
+
+struct dr_rule_bulk {
+	struct mlx5dv_dr_domain	*dmn;
+	/* Per send ring, in the order the single rule path would send */
+	struct list_head	send_list[DR_MAX_SEND_RINGS];
+	uint32_t		num_pending;
+	struct dr_rule_bulk_write *writes;
+	uint8_t			*buf;
+};
+
+static int dr_rule_bulk_init(struct dr_rule_bulk *bulk,
+			     struct mlx5dv_dr_domain *dmn)
+{
+	int i;
+
+	bulk->writes = calloc(DR_RULE_BULK_MAX_PENDING, sizeof(*bulk->writes));
+	if (!bulk->writes)
+		goto err_out;
+
+	bulk->buf = malloc(dmn->info.max_send_size);
+	if (!bulk->buf)
+		goto free_writes;
+
+	for (i = 0; i < DR_MAX_SEND_RINGS; i++)
+		list_head_init(&bulk->send_list[i]);
+
+	bulk->dmn = dmn;
+	bulk->num_pending = 0;
+
+	return 0;
+
+free_writes:
+	free(bulk->writes);
+err_out:
+	errno = ENOMEM;
+	return errno;
+}
+
+static void dr_rule_bulk_uninit(struct dr_rule_bulk *bulk)
+{
+	free(bulk->buf);
+	free(bulk->writes);
+}
+
+static int dr_rule_bulk_write_cmp(const void *a, const void *b)
+{
+	const struct dr_rule_bulk_write *wa = a, *wb = b;
+
+	if (wa->order != wb->order)
+		return wa->order < wb->order ? -1 : 1;
+	if (wa->rkey != wb->rkey)
+		return wa->rkey < wb->rkey ? -1 : 1;
+	if (wa->mr_addr != wb->mr_addr)
+		return wa->mr_addr < wb->mr_addr ? -1 : 1;
+	return wa->seq < wb->seq ? -1 : wa->seq > wb->seq;
+}
+
+/* Full STE writes are sent first, those the HW can't reach yet (collision
+ * and action STEs, linked only by a later control write) before the rest,
+ * and the rest from the last STE of the chain to the first, as the single
+ * rule path does. STEs adjacent in the ICM are merged into one postsend.
+ * Control and partial writes follow in their original order.
+ */
+static int dr_rule_bulk_flush_ring(struct dr_rule_bulk *bulk,
+				   uint8_t ring_idx)
+{
+	struct list_head *send_list = &bulk->send_list[ring_idx];
+	uint32_t max_stes = bulk->dmn->info.max_send_size / DR_STE_SIZE;
+	struct dr_rule_bulk_write *writes = bulk->writes;
+	struct dr_ste_send_info *ste_info, *tmp_ste_info;
+	struct mlx5dv_dr_domain *dmn = bulk->dmn;
+	uint32_t num_writes = 0, seq = 0;
+	uint32_t i, j, num_stes;
+	struct dr_ste *ste;
+	int err, ret = 0;
+
+	list_for_each(send_list, ste_info, send_list) {
+		seq++;
+		if (ste_info->size != DR_STE_SIZE || ste_info->offset)
+			continue;
+
+		ste = ste_info->ste;
+		writes[num_writes].ste_info = ste_info;
+		writes[num_writes].mr_addr = dr_ste_get_mr_addr(ste);
+		writes[num_writes].rkey = ste->htbl->chunk->rkey;
+		writes[num_writes].seq = seq;
+		if (!ste->ste_chain_location || dr_ste_get_miss_list_top(ste) != ste)
+			writes[num_writes].order = 0;
+		else
+			writes[num_writes].order = UINT8_MAX + 1 - ste->ste_chain_location;
+		num_writes++;
+	}
+
+	qsort(writes, num_writes, sizeof(*writes), dr_rule_bulk_write_cmp);
+
+	for (i = 0; i < num_writes; i += num_stes) {
+		memcpy(bulk->buf, writes[i].ste_info->data, DR_STE_SIZE);
+
+		for (j = i + 1, num_stes = 1; j < num_writes && num_stes < max_stes;
+		     j++, num_stes++) {
+			if (writes[j].order != writes[i].order ||
+			    writes[j].rkey != writes[i].rkey ||
+			    writes[j].mr_addr != writes[i].mr_addr + num_stes * DR_STE_SIZE)
+				break;
+
+			memcpy(bulk->buf + num_stes * DR_STE_SIZE,
+			       writes[j].ste_info->data, DR_STE_SIZE);
+		}
+
+		err = dr_send_postsend_ste_arr(dmn, writes[i].ste_info->ste,
+					       bulk->buf, num_stes, ring_idx);
+		if (err && !ret)
+			ret = err;
+	}
+
+	list_for_each_safe(send_list, ste_info, tmp_ste_info, send_list) {
+		list_del(&ste_info->send_list);
+
+		if (ste_info->size != DR_STE_SIZE || ste_info->offset) {
+			err = dr_send_postsend_ste(dmn, ste_info->ste,
+						   ste_info->data,
+						   ste_info->size,
+						   ste_info->offset,
+						   ring_idx);
+			if (err && !ret)
+				ret = err;
+		}
+		free(ste_info);
+	}
+
+	return ret;
+}
+
+/* Send all the pending writes, the queue is empty on return even on error */
+static int dr_rule_bulk_flush(struct dr_rule_bulk *bulk)
+{
+	int i, err, ret = 0;
+
+	if (!bulk->num_pending)
+		return 0;
+
+	for (i = 0; i < DR_MAX_SEND_RINGS; i++) {
+		if (list_empty(&bulk->send_list[i]))
+			continue;
+
+		err = dr_rule_bulk_flush_ring(bulk, i);
+		if (err && !ret)
+			ret = err;
+	}
+
+	bulk->num_pending = 0;
+	if (ret)
+		errno = ret;
+
+	return ret;
+}
+
+/* Queue the writes of a rule instead of sending them. The shadow STEs are
+ * updated right away since the next rules of the bulk are built on them.
+ */
+static int dr_rule_bulk_add(struct dr_rule_bulk *bulk,
+			    struct list_head *send_ste_list,
+			    uint8_t send_ring_idx)
+{
+	struct list_head *bulk_list = &bulk->send_list[send_ring_idx % DR_MAX_SEND_RINGS];
+	struct dr_ste_send_info *ste_info, *tmp_ste_info;
+	uint32_t num_stes = 0;
+	int ret;
+
+	list_for_each(send_ste_list, ste_info, send_list)
+		num_stes++;
+
+	if (bulk->num_pending + num_stes > DR_RULE_BULK_MAX_PENDING) {
+		ret = dr_rule_bulk_flush(bulk);
+		if (ret)
+			return ret;
+	}
+
+	list_for_each_rev_safe(send_ste_list, ste_info, tmp_ste_info,
+			       send_list) {
+		list_del(&ste_info->send_list);
+
+		/* The data may live on the stack of the rule creation */
+		if (ste_info->data != ste_info->data_cont) {
+			memcpy(ste_info->data_cont, ste_info->data, ste_info->size);
+			ste_info->data = ste_info->data_cont;
+		}
+
+		if (ste_info->size == DR_STE_SIZE_CTRL)
+			memcpy(dr_ste_get_hw_ste(ste_info->ste), ste_info->data,
+			       DR_STE_SIZE_CTRL);
+		else
+			memcpy(dr_ste_get_hw_ste(ste_info->ste), ste_info->data,
+			       dr_ste_hw_ste_sz(ste_info->ste));
+
+		list_add_tail(bulk_list, &ste_info->send_list);
+		bulk->num_pending++;
+	}
+
+	return 0;
+}
+
 static struct dr_ste *dr_rule_find_ste_in_miss_list(struct list_head *miss_list,
 						    uint8_t *hw_ste,
 						    uint8_t tag_size)
@@ -197,7 +445,7 @@ static struct dr_ste *dr_rule_find_ste_in_miss_list(struct list_head *miss_list,
 
 	/* Check if hw_ste is present in the list */
 	list_for_each(miss_list, ste, miss_list_node)
-		if (dr_ste_equal_tag(ste->hw_ste, hw_ste, tag_size))
+		if (dr_ste_equal_tag(dr_ste_get_hw_ste(ste), hw_ste, tag_size))
 			return ste;
 
 	return NULL;
@@ -249,7 +497,7 @@ static void dr_rule_rehash_copy_ste_ctrl(struct mlx5dv_dr_matcher *matcher,
 	new_ste->ste_chain_location = cur_ste->ste_chain_location;
 
 	if (new_ste->next_htbl)
-		new_ste->next_htbl->pointing_ste = new_ste;
+		dr_htbl_set_pointing_ste(new_ste->next_htbl, new_ste);
 
 	/*
 	 * We need to copy the refcount since this ste
@@ -281,7 +529,7 @@ static struct dr_ste *dr_rule_rehash_copy_ste(struct mlx5dv_dr_matcher *matcher,
 	sb = &nic_matcher->ste_builder[sb_idx];
 
 	/* Copy STE control, tag and mask on legacy STE */
-	memcpy(hw_ste, cur_ste->hw_ste, cur_ste->size);
+	memcpy(hw_ste, dr_ste_get_hw_ste(cur_ste), dr_ste_hw_ste_sz(cur_ste));
 	dr_ste_set_bit_mask(hw_ste, sb);
 	dr_ste_set_miss_addr(ste_ctx, hw_ste, nic_matcher->e_anchor->chunk->icm_addr);
 
@@ -306,7 +554,7 @@ static struct dr_ste *dr_rule_rehash_copy_ste(struct mlx5dv_dr_matcher *matcher,
 		use_update_list = true;
 	}
 
-	memcpy(new_ste->hw_ste, hw_ste, new_ste->size);
+	memcpy(dr_ste_get_hw_ste(new_ste), hw_ste, dr_ste_hw_ste_sz(new_ste));
 
 	new_htbl->ctrl.num_of_valid_entries++;
 
@@ -478,20 +726,21 @@ static struct dr_ste_htbl *dr_rule_rehash_htbl_common(struct mlx5dv_dr_matcher *
 		 * (48B len) which works only on first 32B
 		 */
 		dr_ste_set_hit_addr(dmn->ste_ctx,
-				    prev_htbl->ste_arr[0].hw_ste,
+				    dr_ste_get_hw_ste(&prev_htbl->ste_arr[0]),
 				    new_htbl->chunk->icm_addr,
 				    new_htbl->chunk->num_of_entries);
 
 		ste_to_update = &prev_htbl->ste_arr[0];
 	} else {
 		dr_ste_set_hit_addr_by_next_htbl(dmn->ste_ctx,
-						 cur_htbl->pointing_ste->hw_ste,
+						 dr_ste_get_hw_ste(cur_htbl->pointing_ste),
 						 new_htbl);
 		ste_to_update = cur_htbl->pointing_ste;
 	}
 
 	dr_send_fill_and_append_ste_send_info(ste_to_update, DR_STE_SIZE_CTRL,
-					      0, ste_to_update->hw_ste, ste_info,
+					      0, dr_ste_get_hw_ste(ste_to_update),
+					      ste_info,
 					      update_list, false);
 
 	return new_htbl;
@@ -511,19 +760,319 @@ free_ste_info:
 	return NULL;
 }
 
-static struct dr_ste_htbl *dr_rule_rehash_htbl(struct mlx5dv_dr_rule *rule,
-					       struct dr_rule_rx_tx *nic_rule,
-					       struct dr_ste_htbl *cur_htbl,
-					       uint8_t ste_location,
-					       struct list_head *update_list,
-					       enum dr_icm_chunk_size new_size)
+/* Start replacing htbl with a larger table, htbl keeps taking entries */
+static int dr_rule_htbl_grow_start(struct mlx5dv_dr_matcher *matcher,
+				   struct dr_matcher_rx_tx *nic_matcher,
+				   struct dr_ste_htbl *htbl,
+				   uint8_t ste_location)
 {
-	struct dr_matcher_rx_tx *nic_matcher = nic_rule->nic_matcher;
-	struct mlx5dv_dr_matcher *matcher = rule->matcher;
+	struct dr_domain_rx_tx *nic_dmn = nic_matcher->nic_tbl->nic_dmn;
+	struct mlx5dv_dr_domain *dmn = matcher->tbl->dmn;
+	struct dr_htbl_connect_info info;
+	struct dr_ste_htbl_grow *grow;
+	enum dr_icm_chunk_size new_size;
+
+	new_size = dr_icm_next_higher_chunk(htbl->chunk_size);
+	new_size = min_t(uint32_t, new_size, dmn->info.max_log_sw_icm_sz);
+
+	if (new_size == htbl->chunk_size)
+		return 0; /* Skip growing, we already at the max size */
+
+	grow = calloc(1, sizeof(*grow));
+	if (!grow) {
+		errno = ENOMEM;
+		return errno;
+	}
+
+	grow->migrated = bitmap_alloc0(htbl->chunk->num_of_entries);
+	if (!grow->migrated) {
+		errno = ENOMEM;
+		goto free_grow;
+	}
+
+	/* The entries are set up by the growth steps, see below */
+	grow->new_htbl = dr_ste_htbl_alloc_lazy(dmn->ste_icm_pool,
+						new_size,
+						htbl->type,
+						htbl->lu_type,
+						htbl->byte_mask);
+	if (!grow->new_htbl) {
+		dr_dbg(dmn, "Failed to allocate new hash table\n");
+		goto free_migrated;
+	}
+
+	info.type = CONNECT_MISS;
+	info.miss_icm_addr = nic_matcher->e_anchor->chunk->icm_addr;
+	dr_ste_set_formated_ste(dmn->ste_ctx,
+				dmn->info.caps.gvmi,
+				nic_dmn->type,
+				grow->new_htbl,
+				grow->formated_ste,
+				&info);
+
+	grow->old_htbl = htbl;
+	grow->ste_location = ste_location;
+	htbl->grow = grow;
+	grow->new_htbl->grow = grow;
+
+	return 0;
+
+free_migrated:
+	free(grow->migrated);
+free_grow:
+	free(grow);
+	return errno;
+}
+
+/* Point lookups at the new table, its entries already miss to the old one */
+static int dr_rule_htbl_grow_connect(struct mlx5dv_dr_matcher *matcher,
+				     struct dr_matcher_rx_tx *nic_matcher,
+				     struct dr_ste_htbl_grow *grow,
+				     uint8_t send_ring_idx)
+{
+	struct mlx5dv_dr_domain *dmn = matcher->tbl->dmn;
+	struct dr_ste_htbl *old_htbl = grow->old_htbl;
+	struct dr_ste_htbl *new_htbl = grow->new_htbl;
+	struct dr_ste *pointing_ste = old_htbl->pointing_ste;
+	uint8_t hw_ste[DR_STE_SIZE] = {};
+	int ret;
+
+	dr_ste_set_hit_addr_by_next_htbl(dmn->ste_ctx,
+					 dr_ste_get_hw_ste(pointing_ste),
+					 new_htbl);
+	memcpy(hw_ste, dr_ste_get_hw_ste(pointing_ste), DR_STE_SIZE_CTRL);
 
-	return dr_rule_rehash_htbl_common(matcher, nic_matcher, cur_htbl,
-					  ste_location, update_list, new_size,
-					  nic_rule->lock_index);
+	ret = dr_send_postsend_ste(dmn, pointing_ste, hw_ste, DR_STE_SIZE_CTRL,
+				   0, send_ring_idx);
+	if (ret) {
+		dr_ste_set_hit_addr_by_next_htbl(dmn->ste_ctx,
+						 dr_ste_get_hw_ste(pointing_ste),
+						 old_htbl);
+		return ret;
+	}
+
+	new_htbl->pointing_ste = pointing_ste;
+	pointing_ste->next_htbl = new_htbl;
+	grow->connected = true;
+
+	if (grow->ste_location == 1) {
+		/* On matcher s_anchor we keep an extra refcount */
+		dr_htbl_get(new_htbl);
+		nic_matcher->s_htbl = new_htbl;
+		dr_htbl_put(old_htbl);
+	}
+
+	return 0;
+}
+
+/* Write the collision entries of a chain, the last one first */
+static int dr_rule_htbl_grow_write_collisions(struct mlx5dv_dr_domain *dmn,
+					      struct dr_matcher_rx_tx *nic_matcher,
+					      struct list_head *miss_list,
+					      uint8_t send_ring_idx)
+{
+	struct dr_ste *head, *ste;
+	int ret;
+
+	head = list_top(miss_list, struct dr_ste, miss_list_node);
+
+	list_for_each_rev(miss_list, ste, miss_list_node) {
+		uint8_t hw_ste[DR_STE_SIZE] = {};
+
+		if (ste == head)
+			break;
+
+		memcpy(hw_ste, dr_ste_get_hw_ste(ste), dr_ste_hw_ste_sz(ste));
+		dr_ste_set_bit_mask(hw_ste,
+				    &nic_matcher->ste_builder[ste->ste_chain_location - 1]);
+
+		ret = dr_send_postsend_ste(dmn, ste, hw_ste, DR_STE_SIZE, 0,
+					   send_ring_idx);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/*
+ * Move num old buckets from first into the new table, then write all the
+ * new entries of these buckets, collision entries before the heads, so a
+ * lookup leaves the old chain only for a complete new one.
+ */
+static int dr_rule_htbl_grow_migrate(struct mlx5dv_dr_matcher *matcher,
+				     struct dr_matcher_rx_tx *nic_matcher,
+				     struct dr_ste_htbl_grow *grow,
+				     uint32_t first, uint32_t num,
+				     uint8_t send_ring_idx)
+{
+	struct dr_ste_htbl *old_htbl = grow->old_htbl;
+	struct dr_ste_htbl *new_htbl = grow->new_htbl;
+	uint32_t old_entries = old_htbl->chunk->num_of_entries;
+	uint32_t new_entries = new_htbl->chunk->num_of_entries;
+	struct mlx5dv_dr_domain *dmn = matcher->tbl->dmn;
+	struct dr_ste_send_info *ste_info, *tmp_ste_info;
+	LIST_HEAD(update_list);
+	uint8_t *mask = NULL;
+	struct dr_ste *ste;
+	uint32_t i, idx;
+	int ret = 0;
+
+	for (i = first; i < first + num; i++) {
+		ste = &old_htbl->ste_arr[i];
+		if (dr_ste_is_not_used(ste)) /* Empty, nothing to copy */
+			continue;
+
+		ret = dr_rule_rehash_copy_miss_list(matcher,
+						    nic_matcher,
+						    dr_ste_get_miss_list(ste),
+						    new_htbl,
+						    &update_list);
+		if (ret)
+			break;
+	}
+
+	/* The shadow STEs are up to date, every entry is written in full */
+	list_for_each_safe(&update_list, ste_info, tmp_ste_info, send_list) {
+		list_del(&ste_info->send_list);
+		free(ste_info);
+	}
+	if (ret)
+		return ret;
+
+	if (new_htbl->type == DR_STE_HTBL_TYPE_LEGACY)
+		mask = nic_matcher->ste_builder[grow->ste_location - 1].bit_mask;
+
+	for (i = first; i < new_entries; i += old_entries) {
+		for (idx = i; idx < i + num; idx++) {
+			ret = dr_rule_htbl_grow_write_collisions(dmn, nic_matcher,
+								 &new_htbl->miss_list[idx],
+								 send_ring_idx);
+			if (ret)
+				return ret;
+		}
+
+		ret = dr_send_postsend_htbl_range(dmn, new_htbl, i, num,
+						  grow->formated_ste, mask,
+						  NULL, send_ring_idx);
+		if (ret)
+			return ret;
+	}
+
+	for (i = first; i < first + num; i++)
+		bitmap_set_bit(grow->migrated, i);
+	grow->num_migrated += num;
+
+	return 0;
+}
+
+static void dr_rule_htbl_grow_done(struct dr_ste_htbl_grow *grow)
+{
+	struct dr_ste_htbl *old_htbl = grow->old_htbl;
+
+	old_htbl->grow = NULL;
+	grow->new_htbl->grow = NULL;
+	free(grow->migrated);
+	free(grow);
+
+	/* All entries moved out, nothing misses to the old table anymore */
+	dr_ste_htbl_free(old_htbl);
+}
+
+/*
+ * Advance the growth of htbl by one insertion worth of work and return the
+ * table the insertion goes to, the new one once the growth is done.  When
+ * hw_ste is given, its bucket is moved to the new table before it is looked
+ * up there.
+ */
+static struct dr_ste_htbl *
+dr_rule_htbl_grow_step(struct mlx5dv_dr_matcher *matcher,
+		       struct dr_matcher_rx_tx *nic_matcher,
+		       struct dr_ste_htbl *htbl,
+		       uint8_t *hw_ste,
+		       uint8_t send_ring_idx,
+		       struct dr_rule_bulk *bulk)
+{
+	struct mlx5dv_dr_domain *dmn = matcher->tbl->dmn;
+	struct dr_ste_htbl_grow *grow = htbl->grow;
+	struct dr_ste_htbl *old_htbl = grow->old_htbl;
+	struct dr_ste_htbl *new_htbl = grow->new_htbl;
+	uint32_t old_entries = old_htbl->chunk->num_of_entries;
+	uint32_t new_entries = new_htbl->chunk->num_of_entries;
+	uint32_t bucket, num;
+
+	if (!grow->connected) {
+		num = min_t(uint32_t, new_entries - grow->init_pos,
+			    dmn->info.max_send_size / DR_STE_SIZE);
+		dr_ste_htbl_init_entries(new_htbl, grow->init_pos, num);
+		if (dr_send_postsend_htbl_range(dmn, new_htbl, grow->init_pos,
+						num, grow->formated_ste, NULL,
+						old_htbl, send_ring_idx)) {
+			dr_dbg(dmn, "Failed writing table to HW\n");
+			return NULL;
+		}
+
+		grow->init_pos += num;
+		if (grow->init_pos < new_entries)
+			return old_htbl;
+	}
+
+	/*
+	 * Queued writes may hold an older copy of the pointing STE, and refer
+	 * to the collision entries freed by moving buckets.
+	 */
+	if (bulk && dr_rule_bulk_flush(bulk))
+		return NULL;
+
+	if (!grow->connected &&
+	    dr_rule_htbl_grow_connect(matcher, nic_matcher, grow, send_ring_idx)) {
+		dr_dbg(dmn, "Failed connecting new table\n");
+		return NULL;
+	}
+
+	if (hw_ste) {
+		bucket = dr_ste_calc_hash_index(hw_ste, old_htbl);
+		if (!bitmap_test_bit(grow->migrated, bucket) &&
+		    dr_rule_htbl_grow_migrate(matcher, nic_matcher, grow,
+					      bucket, 1, send_ring_idx))
+			return NULL;
+	}
+
+	while (grow->migrate_pos < old_entries &&
+	       bitmap_test_bit(grow->migrated, grow->migrate_pos))
+		grow->migrate_pos++;
+
+	for (num = 0; num < DR_RULE_GROW_BUCKETS; num++)
+		if (grow->migrate_pos + num == old_entries ||
+		    bitmap_test_bit(grow->migrated, grow->migrate_pos + num))
+			break;
+
+	if (num && dr_rule_htbl_grow_migrate(matcher, nic_matcher, grow,
+					     grow->migrate_pos, num,
+					     send_ring_idx))
+		return NULL;
+
+	grow->migrate_pos += num;
+	if (grow->num_migrated == old_entries)
+		dr_rule_htbl_grow_done(grow);
+
+	return new_htbl;
+}
+
+/* Complete a growth of the matcher start table right away */
+static int dr_rule_htbl_grow_finish(struct mlx5dv_dr_matcher *matcher,
+				    struct dr_matcher_rx_tx *nic_matcher)
+{
+	struct dr_ste_htbl *htbl = nic_matcher->s_htbl;
+
+	while (htbl->grow) {
+		htbl = dr_rule_htbl_grow_step(matcher, nic_matcher, htbl,
+					      NULL, 0, NULL);
+		if (!htbl)
+			return errno;
+	}
+
+	return 0;
 }
 
 int dr_rule_rehash_matcher_s_anchor(struct mlx5dv_dr_matcher *matcher,
@@ -535,6 +1084,13 @@ int dr_rule_rehash_matcher_s_anchor(struct mlx5dv_dr_matcher *matcher,
 	LIST_HEAD(update_list);
 	int ret;
 
+	/* A growth in progress ends before the table is replaced */
+	if (nic_matcher->s_htbl->grow &&
+	    dr_rule_htbl_grow_finish(matcher, nic_matcher)) {
+		dr_dbg(dmn, "Failed growing matcher s_anchor\n");
+		goto err_out;
+	}
+
 	if (nic_matcher->s_htbl->chunk_size == new_size) {
 		dr_dbg(dmn, "both are with the same size, nothing to do\n");
 		return 0;
@@ -565,25 +1121,6 @@ err_out:
 	return ENOTSUP;
 }
 
-static struct dr_ste_htbl *dr_rule_rehash(struct mlx5dv_dr_rule *rule,
-					  struct dr_rule_rx_tx *nic_rule,
-					  struct dr_ste_htbl *cur_htbl,
-					  uint8_t ste_location,
-					  struct list_head *update_list)
-{
-	struct mlx5dv_dr_domain *dmn = rule->matcher->tbl->dmn;
-	enum dr_icm_chunk_size new_size;
-
-	new_size = dr_icm_next_higher_chunk(cur_htbl->chunk_size);
-	new_size = min_t(uint32_t, new_size, dmn->info.max_log_sw_icm_sz);
-
-	if (new_size == cur_htbl->chunk_size)
-		return NULL; /* Skip rehash, we already at the max size */
-
-	return dr_rule_rehash_htbl(rule, nic_rule, cur_htbl, ste_location,
-				   update_list, new_size);
-}
-
 static struct dr_ste *dr_rule_handle_collision(struct mlx5dv_dr_matcher *matcher,
 					       struct dr_rule_rx_tx *nic_rule,
 					       struct dr_ste *ste,
@@ -839,7 +1376,7 @@ static int dr_rule_handle_cross_action_stes(struct mlx5dv_dr_rule *rule,
 							      ste_info_arr[k],
 							      send_ste_list, false);
 		} else {
-			memcpy(cross_dmn_rule_ste->hw_ste,
+			memcpy(dr_ste_get_hw_ste(cross_dmn_rule_ste),
 			       curr_hw_ste,
 			       DR_STE_SIZE_REDUCED);
 			dr_send_fill_and_append_ste_send_info(cross_dmn_rule_ste,
@@ -1043,20 +1580,25 @@ static struct dr_ste *dr_rule_handle_ste_branch(struct mlx5dv_dr_rule *rule,
 						struct dr_ste_htbl *cur_htbl,
 						uint8_t *hw_ste,
 						uint8_t ste_location,
-						struct dr_ste_htbl **put_htbl)
+						struct dr_rule_bulk *bulk)
 {
 	struct dr_matcher_rx_tx *nic_matcher = nic_rule->nic_matcher;
 	struct dr_domain_rx_tx *nic_dmn = nic_matcher->nic_tbl->nic_dmn;
 	struct mlx5dv_dr_matcher *matcher = rule->matcher;
 	struct mlx5dv_dr_domain *dmn = matcher->tbl->dmn;
-	struct dr_ste_htbl *new_htbl;
 	struct list_head *miss_list;
 	struct dr_ste *matched_ste;
-	bool skip_rehash = nic_matcher->fixed_size;
 	struct dr_ste *ste;
 	int index;
 
-again:
+	if (cur_htbl->grow) {
+		cur_htbl = dr_rule_htbl_grow_step(matcher, nic_matcher, cur_htbl,
+						  hw_ste, nic_rule->lock_index,
+						  bulk);
+		if (!cur_htbl)
+			return NULL;
+	}
+
 	index = dr_ste_calc_hash_index(hw_ste, cur_htbl);
 	miss_list = &cur_htbl->chunk->miss_list[index];
 	ste = &cur_htbl->ste_arr[index];
@@ -1088,40 +1630,24 @@ again:
 			dr_dbg(dmn, "Duplicate rule inserted\n");
 		}
 
-		if (!skip_rehash && dr_rule_need_enlarge_hash(cur_htbl, dmn, nic_dmn)) {
-			/* Hash table index in use, try to resize of the hash */
-			skip_rehash = true;
-
-			/*
-			 * Hold the table till we update.
-			 * Release in dr_rule_create_rule_nr()
-			 */
-			*put_htbl = cur_htbl;
-			dr_htbl_get(cur_htbl);
-
-			new_htbl = dr_rule_rehash(rule, nic_rule, cur_htbl,
-						  ste_location, send_ste_list);
-			if (!new_htbl) {
-				dr_htbl_put(cur_htbl);
-				dr_dbg(dmn, "Failed creating rehash table, htbl-log_size: %d\n",
-				       cur_htbl->chunk_size);
-			} else {
-				cur_htbl = new_htbl;
-			}
-			goto again;
-		} else {
-			/* Hash table index in use, add another collision (miss) */
-			ste = dr_rule_handle_collision(matcher,
-						       nic_rule,
-						       ste,
-						       hw_ste,
-						       miss_list,
-						       send_ste_list);
-			if (!ste) {
-				dr_dbg(dmn, "Failed adding collision entry, index: %d\n",
-				       index);
-				return NULL;
-			}
+		if (!nic_matcher->fixed_size && !cur_htbl->grow &&
+		    dr_rule_need_enlarge_hash(cur_htbl, dmn, nic_dmn) &&
+		    dr_rule_htbl_grow_start(matcher, nic_matcher, cur_htbl,
+					    ste_location))
+			dr_dbg(dmn, "Failed growing hash table, htbl-log_size: %d\n",
+			       cur_htbl->chunk_size);
+
+		/* Hash table index in use, add another collision (miss) */
+		ste = dr_rule_handle_collision(matcher,
+					       nic_rule,
+					       ste,
+					       hw_ste,
+					       miss_list,
+					       send_ste_list);
+		if (!ste) {
+			dr_dbg(dmn, "Failed adding collision entry, index: %d\n",
+			       index);
+			return NULL;
 		}
 	}
 	return ste;
@@ -1237,10 +1763,46 @@ static bool dr_rule_verify(struct mlx5dv_dr_matcher *matcher,
 	return true;
 }
 
-static int dr_rule_destroy_rule_nic(struct mlx5dv_dr_rule *rule,
-				    struct dr_rule_rx_tx *nic_rule)
+/*
+ * Advance the growths of the tables holding the rule STEs, so a table that
+ * only loses rules still completes its growth and drops the old table.
+ */
+static void dr_rule_htbl_grow_delete_step(struct mlx5dv_dr_rule *rule,
+					  struct dr_rule_rx_tx *nic_rule)
 {
-	dr_rule_lock(nic_rule, NULL);
+	struct dr_ste *ste_arr[DR_RULE_MAX_STES + DR_ACTION_MAX_STES +
+			       DR_ACTION_ASO_CROSS_GVMI_STES];
+	struct dr_ste_htbl *htbl_arr[DR_RULE_MAX_STES];
+	struct dr_matcher_rx_tx *nic_matcher = nic_rule->nic_matcher;
+	struct mlx5dv_dr_matcher *matcher = rule->matcher;
+	struct dr_ste_htbl *htbl;
+	int i, num = 0;
+
+	if (nic_matcher->fixed_size)
+		return;
+
+	dr_rule_get_reverse_rule_members(ste_arr, nic_rule->last_rule_ste, &i);
+
+	/* Moving buckets moves STEs, collect the tables before stepping */
+	while (i--) {
+		htbl = dr_ste_get_miss_list_top(ste_arr[i])->htbl;
+		if (htbl->grow && num < DR_RULE_MAX_STES)
+			htbl_arr[num++] = htbl;
+	}
+
+	for (i = 0; i < num; i++)
+		if (!dr_rule_htbl_grow_step(matcher, nic_matcher, htbl_arr[i],
+					    NULL, nic_rule->lock_index, NULL))
+			dr_dbg(matcher->tbl->dmn,
+			       "Failed growing hash table, htbl-log_size: %d\n",
+			       htbl_arr[i]->chunk_size);
+}
+
+static int dr_rule_destroy_rule_nic(struct mlx5dv_dr_rule *rule,
+				    struct dr_rule_rx_tx *nic_rule)
+{
+	dr_rule_lock(nic_rule, NULL);
+	dr_rule_htbl_grow_delete_step(rule, nic_rule);
 	dr_rule_clean_rule_members(rule, nic_rule);
 	dr_rule_unlock(nic_rule);
 	return 0;
@@ -1258,7 +1820,15 @@ static int dr_rule_destroy_rule(struct mlx5dv_dr_rule *rule)
 	struct mlx5dv_dr_domain *dmn = rule->matcher->tbl->dmn;
 
 	pthread_spin_lock(&dmn->debug_lock);
-	list_del(&rule->rule_list);
+	/* A dump in progress continues from the next rule */
+	if (dmn->dump_rule == rule)
+		dmn->dump_rule = list_next(&rule->matcher->rule_list, rule,
+					   rule_list);
+	/* The rules of a failed bulk insertion were never listed */
+	if (rule->rule_list.next != &rule->rule_list) {
+		list_del(&rule->rule_list);
+		dmn->num_rules--;
+	}
 	pthread_spin_unlock(&dmn->debug_lock);
 
 	switch (dmn->type) {
@@ -1279,7 +1849,6 @@ static int dr_rule_destroy_rule(struct mlx5dv_dr_rule *rule)
 
 	dr_rule_remove_action_members(rule);
 
-	free(rule);
 	return 0;
 }
 
@@ -1292,7 +1861,6 @@ static int dr_rule_destroy_rule_root(struct mlx5dv_dr_rule *rule)
 		return ret;
 
 	dr_rule_remove_action_members(rule);
-	free(rule);
 	return 0;
 }
 
@@ -1345,7 +1913,8 @@ dr_rule_create_rule_nic(struct mlx5dv_dr_rule *rule,
 			struct dr_rule_rx_tx *nic_rule,
 			struct dr_match_param *param,
 			size_t num_actions,
-			struct mlx5dv_dr_action *actions[])
+			struct mlx5dv_dr_action *actions[],
+			struct dr_rule_bulk *bulk)
 {
 	uint8_t hw_ste_arr[DR_RULE_MAX_STE_CHAIN * DR_STE_SIZE] = {};
 	struct dr_matcher_rx_tx *nic_matcher = nic_rule->nic_matcher;
@@ -1353,7 +1922,6 @@ dr_rule_create_rule_nic(struct mlx5dv_dr_rule *rule,
 	struct mlx5dv_dr_matcher *matcher = rule->matcher;
 	struct mlx5dv_dr_domain *dmn = matcher->tbl->dmn;
 	struct dr_ste_send_info *ste_info, *tmp_ste_info;
-	struct dr_ste_htbl *htbl = NULL;
 	struct dr_ste_htbl *cur_htbl;
 	uint32_t new_hw_ste_arr_sz = 0;
 	struct cross_dmn_params cross_dmn_p = {};
@@ -1379,7 +1947,12 @@ dr_rule_create_rule_nic(struct mlx5dv_dr_rule *rule,
 	if (ret)
 		return ret;
 
-	dr_rule_lock(nic_rule, hw_ste_arr);
+	/* In bulk the domain is already locked, only the send ring is set */
+	if (!bulk)
+		dr_rule_lock(nic_rule, hw_ste_arr);
+	else if (nic_matcher->fixed_size)
+		nic_rule->lock_index = dr_ste_calc_hash_index(hw_ste_arr, nic_matcher->s_htbl) %
+				       NUM_OF_LOCKS;
 
 	cur_htbl = nic_matcher->s_htbl;
 
@@ -1398,7 +1971,7 @@ dr_rule_create_rule_nic(struct mlx5dv_dr_rule *rule,
 						cur_htbl,
 						cur_hw_ste_ent,
 						i + 1,
-						&htbl);
+						bulk);
 		if (!ste) {
 			dr_dbg(dmn, "Failed creating next branch\n");
 			ret = errno;
@@ -1418,18 +1991,29 @@ dr_rule_create_rule_nic(struct mlx5dv_dr_rule *rule,
 		dr_dbg(dmn, "Failed apply actions\n");
 		goto free_rule;
 	}
-	ret = dr_rule_send_update_list(&send_ste_list, dmn, true, nic_rule->lock_index);
+	if (bulk)
+		ret = dr_rule_bulk_add(bulk, &send_ste_list, nic_rule->lock_index);
+	else if (rule->async)
+		ret = dr_rule_send_update_list_nowait(&send_ste_list, dmn,
+						      nic_rule->lock_index);
+	else
+		ret = dr_rule_send_update_list(&send_ste_list, dmn, true,
+					       nic_rule->lock_index);
 	if (ret) {
 		dr_dbg(dmn, "Failed sending ste!\n");
 		goto free_rule;
 	}
 
-	if (htbl)
-		dr_htbl_put(htbl);
-
 	goto out_unlock;
 
 free_rule:
+	/* STEs released below may still have queued writes */
+	if (bulk)
+		dr_rule_bulk_flush(bulk);
+
+	/* The cleanup isn't tracked by any async op, send it right away */
+	rule->async = false;
+
 	if (cross_dmn_p.cross_dmn_action) {
 		dr_rule_clean_cross_dmn_rule_members(rule, nic_rule,
 						     &send_ste_list,
@@ -1443,7 +2027,8 @@ free_rule:
 		}
 	}
 out_unlock:
-	dr_rule_unlock(nic_rule);
+	if (!bulk)
+		dr_rule_unlock(nic_rule);
 	return ret;
 }
 
@@ -1451,7 +2036,8 @@ static int
 dr_rule_create_rule_fdb(struct mlx5dv_dr_rule *rule,
 			struct dr_match_param *param,
 			size_t num_actions,
-			struct mlx5dv_dr_action *actions[])
+			struct mlx5dv_dr_action *actions[],
+			struct dr_rule_bulk *bulk)
 {
 	struct dr_match_param copy_param = {};
 	int ret;
@@ -1463,19 +2049,23 @@ dr_rule_create_rule_fdb(struct mlx5dv_dr_rule *rule,
 	memcpy(&copy_param, param, sizeof(struct dr_match_param));
 
 	ret = dr_rule_create_rule_nic(rule, &rule->rx, param,
-				      num_actions, actions);
+				      num_actions, actions, bulk);
 	if (ret)
 		return ret;
 
 	ret = dr_rule_create_rule_nic(rule, &rule->tx, &copy_param,
-				      num_actions, actions);
+				      num_actions, actions, bulk);
 	if (ret)
 		goto destroy_rule_nic_rx;
 
 	return 0;
 
 destroy_rule_nic_rx:
-	dr_rule_destroy_rule_nic(rule, &rule->rx);
+	if (bulk)
+		/* Locked and flushed by the failed tx insertion */
+		dr_rule_clean_rule_members(rule, &rule->rx);
+	else
+		dr_rule_destroy_rule_nic(rule, &rule->rx);
 	return ret;
 }
 
@@ -1483,7 +2073,9 @@ static struct mlx5dv_dr_rule *
 dr_rule_create_rule(struct mlx5dv_dr_matcher *matcher,
 		    struct mlx5dv_flow_match_parameters *value,
 		    size_t num_actions,
-		    struct mlx5dv_dr_action *actions[])
+		    struct mlx5dv_dr_action *actions[],
+		    struct dr_rule_bulk *bulk,
+		    bool async)
 {
 	struct mlx5dv_dr_domain *dmn = matcher->tbl->dmn;
 	struct dr_match_param param = {};
@@ -1500,6 +2092,7 @@ dr_rule_create_rule(struct mlx5dv_dr_matcher *matcher,
 	}
 
 	rule->matcher = matcher;
+	rule->async = async;
 
 	list_node_init(&rule->rule_list);
 
@@ -1511,18 +2104,18 @@ dr_rule_create_rule(struct mlx5dv_dr_matcher *matcher,
 	case MLX5DV_DR_DOMAIN_TYPE_NIC_RX:
 		rule->rx.nic_matcher = &matcher->rx;
 		ret = dr_rule_create_rule_nic(rule, &rule->rx, &param,
-					      num_actions, actions);
+					      num_actions, actions, bulk);
 		break;
 	case MLX5DV_DR_DOMAIN_TYPE_NIC_TX:
 		rule->tx.nic_matcher = &matcher->tx;
 		ret = dr_rule_create_rule_nic(rule, &rule->tx, &param,
-					      num_actions, actions);
+					      num_actions, actions, bulk);
 		break;
 	case MLX5DV_DR_DOMAIN_TYPE_FDB:
 		rule->rx.nic_matcher = &matcher->rx;
 		rule->tx.nic_matcher = &matcher->tx;
 		ret = dr_rule_create_rule_fdb(rule, &param,
-					      num_actions, actions);
+					      num_actions, actions, bulk);
 		break;
 	default:
 		ret = EINVAL;
@@ -1533,9 +2126,13 @@ dr_rule_create_rule(struct mlx5dv_dr_matcher *matcher,
 	if (ret)
 		goto remove_action_members;
 
-	pthread_spin_lock(&dmn->debug_lock);
-	list_add_tail(&matcher->rule_list, &rule->rule_list);
-	pthread_spin_unlock(&dmn->debug_lock);
+	/* Bulk insertion adds all its rules at once */
+	if (!bulk) {
+		pthread_spin_lock(&dmn->debug_lock);
+		list_add_tail(&matcher->rule_list, &rule->rule_list);
+		dmn->num_rules++;
+		pthread_spin_unlock(&dmn->debug_lock);
+	}
 
 	return rule;
 
@@ -1622,7 +2219,8 @@ struct mlx5dv_dr_rule *mlx5dv_dr_rule_create(struct mlx5dv_dr_matcher *matcher,
 	if (dr_is_root_table(matcher->tbl))
 		rule = dr_rule_create_rule_root(matcher, value, num_actions, actions);
 	else
-		rule = dr_rule_create_rule(matcher, value, num_actions, actions);
+		rule = dr_rule_create_rule(matcher, value, num_actions, actions,
+					   NULL, false);
 
 	if (!rule)
 		atomic_fetch_sub(&matcher->refcount, 1);
@@ -1630,6 +2228,164 @@ struct mlx5dv_dr_rule *mlx5dv_dr_rule_create(struct mlx5dv_dr_matcher *matcher,
 	return rule;
 }
 
+static void dr_rule_bulk_lock(struct mlx5dv_dr_domain *dmn)
+{
+	if (dmn->type == MLX5DV_DR_DOMAIN_TYPE_NIC_RX)
+		dr_domain_nic_lock(&dmn->info.rx);
+	else if (dmn->type == MLX5DV_DR_DOMAIN_TYPE_NIC_TX)
+		dr_domain_nic_lock(&dmn->info.tx);
+	else
+		dr_domain_lock(dmn);
+}
+
+static void dr_rule_bulk_unlock(struct mlx5dv_dr_domain *dmn)
+{
+	if (dmn->type == MLX5DV_DR_DOMAIN_TYPE_NIC_RX)
+		dr_domain_nic_unlock(&dmn->info.rx);
+	else if (dmn->type == MLX5DV_DR_DOMAIN_TYPE_NIC_TX)
+		dr_domain_nic_unlock(&dmn->info.tx);
+	else
+		dr_domain_unlock(dmn);
+}
+
+static size_t dr_rule_create_bulk_root(struct mlx5dv_dr_matcher *matcher,
+				       size_t num_rules,
+				       struct mlx5dv_dr_rule_bulk_entry *entries)
+{
+	size_t i;
+
+	for (i = 0; i < num_rules; i++) {
+		entries[i].rule = dr_rule_create_rule_root(matcher,
+							   entries[i].value,
+							   entries[i].num_actions,
+							   entries[i].actions);
+		if (!entries[i].rule)
+			break;
+	}
+
+	return i;
+}
+
+/* The domain is locked once for all the rules and their STE writes are
+ * queued and sent together, merged where the STEs are adjacent in the ICM.
+ */
+static size_t dr_rule_create_bulk(struct mlx5dv_dr_matcher *matcher,
+				  size_t num_rules,
+				  struct mlx5dv_dr_rule_bulk_entry *entries)
+{
+	struct mlx5dv_dr_domain *dmn = matcher->tbl->dmn;
+	struct dr_rule_bulk bulk;
+	int ret, err = 0;
+	size_t i, j;
+
+	if (dr_rule_bulk_init(&bulk, dmn))
+		return 0;
+
+	dr_rule_bulk_lock(dmn);
+
+	for (i = 0; i < num_rules; i++) {
+		entries[i].rule = dr_rule_create_rule(matcher, entries[i].value,
+						      entries[i].num_actions,
+						      entries[i].actions,
+						      &bulk, false);
+		if (!entries[i].rule) {
+			err = errno;
+			break;
+		}
+	}
+
+	ret = dr_rule_bulk_flush(&bulk);
+
+	dr_rule_bulk_unlock(dmn);
+	dr_rule_bulk_uninit(&bulk);
+
+	if (ret) {
+		dr_dbg(dmn, "Failed sending bulk rules\n");
+		goto destroy_rules;
+	}
+
+	/* Wait for the HW to complete all the writes */
+	ret = dr_send_ring_force_drain(dmn);
+	if (ret) {
+		dr_dbg(dmn, "Failed draining send rings\n");
+		goto destroy_rules;
+	}
+
+	pthread_spin_lock(&dmn->debug_lock);
+	for (j = 0; j < i; j++)
+		list_add_tail(&matcher->rule_list, &entries[j].rule->rule_list);
+	dmn->num_rules += i;
+	pthread_spin_unlock(&dmn->debug_lock);
+
+	errno = err;
+	return i;
+
+destroy_rules:
+	/* The rules are not known to be in the device, none is returned */
+	while (i--) {
+		dr_rule_destroy_rule(entries[i].rule);
+		free(entries[i].rule);
+		entries[i].rule = NULL;
+	}
+	errno = ret;
+	return 0;
+}
+
+int mlx5dv_dr_rule_create_bulk(struct mlx5dv_dr_matcher *matcher,
+			       size_t num_rules,
+			       struct mlx5dv_dr_rule_bulk_entry *entries)
+{
+	size_t i, created;
+
+	if (!num_rules)
+		return 0;
+
+	atomic_fetch_add(&matcher->refcount, num_rules);
+
+	if (dr_is_root_table(matcher->tbl))
+		created = dr_rule_create_bulk_root(matcher, num_rules, entries);
+	else
+		created = dr_rule_create_bulk(matcher, num_rules, entries);
+
+	if (created == num_rules)
+		return 0;
+
+	atomic_fetch_sub(&matcher->refcount, num_rules - created);
+
+	for (i = created; i < num_rules; i++)
+		entries[i].rule = NULL;
+
+	if (!errno)
+		errno = EINVAL;
+
+	return errno;
+}
+
+struct dr_rule_async_op {
+	struct list_node	list_node;
+	struct mlx5dv_dr_rule	*rule;
+	void			*user_data;
+	enum mlx5dv_dr_rule_op	op;
+	/* The op is done once the rings have completed these writes */
+	uint8_t			num_rings;
+	uint8_t			ring_idx[2];
+	uint64_t		send_seq[2];
+};
+
+/* A rule destroyed before its async create was polled reports no create */
+static void dr_rule_drop_async_op(struct mlx5dv_dr_rule *rule)
+{
+	struct mlx5dv_dr_domain *dmn = rule->matcher->tbl->dmn;
+
+	pthread_spin_lock(&dmn->async_lock);
+	if (rule->async_op) {
+		list_del(&rule->async_op->list_node);
+		free(rule->async_op);
+		rule->async_op = NULL;
+	}
+	pthread_spin_unlock(&dmn->async_lock);
+}
+
 int mlx5dv_dr_rule_destroy(struct mlx5dv_dr_rule *rule)
 {
 	struct mlx5dv_dr_matcher *matcher = rule->matcher;
@@ -1641,7 +2397,407 @@ int mlx5dv_dr_rule_destroy(struct mlx5dv_dr_rule *rule)
 	else
 		ret = dr_rule_destroy_rule(rule);
 
-	if (!ret)
-		atomic_fetch_sub(&matcher->refcount, 1);
+	if (ret)
+		return ret;
+
+	if (rule->async_op)
+		dr_rule_drop_async_op(rule);
+	free(rule);
+	atomic_fetch_sub(&matcher->refcount, 1);
+	return 0;
+}
+
+static bool dr_rule_has_cross_dmn_action(struct mlx5dv_dr_domain *dmn,
+					 size_t num_actions,
+					 struct mlx5dv_dr_action *actions[])
+{
+	int i;
+
+	for (i = 0; i < num_actions; i++)
+		if (actions[i]->action_type == DR_ACTION_TYP_ASO_CT &&
+		    actions[i]->aso.dmn != dmn)
+			return true;
+
+	return false;
+}
+
+static void dr_rule_modify_actions_restore(struct mlx5dv_dr_rule *rule,
+					   struct dr_rule_rx_tx *nic_rule,
+					   struct list_head *send_ste_list,
+					   struct dr_ste *match_ste,
+					   uint8_t *old_hw_ste,
+					   struct dr_ste_htbl *old_next_htbl,
+					   struct dr_ste *old_last_ste)
+{
+	struct dr_ste *ste_arr[DR_RULE_MAX_STES + DR_ACTION_MAX_STES +
+			       DR_ACTION_ASO_CROSS_GVMI_STES] = {};
+	struct dr_ste_send_info *ste_info, *tmp_ste_info;
+	int num_of_stes, i;
+
+	list_for_each_safe(send_ste_list, ste_info, tmp_ste_info, send_list) {
+		list_del(&ste_info->send_list);
+		free(ste_info);
+	}
+
+	/* Release the new action STEs, the HW never reached them */
+	dr_rule_get_reverse_rule_members(ste_arr, nic_rule->last_rule_ste, &num_of_stes);
+	for (i = 0; i < num_of_stes && ste_arr[i] != match_ste; i++)
+		dr_ste_put(ste_arr[i], rule, nic_rule);
+
+	memcpy(dr_ste_get_hw_ste(match_ste), old_hw_ste,
+	       dr_ste_hw_ste_sz(match_ste));
+	match_ste->next_htbl = old_next_htbl;
+	dr_rule_set_last_member(nic_rule, old_last_ste, true);
+}
+
+/*
+ * Replace the actions of one side of a rule. The new action STEs are written
+ * first, then the last match STE is rewritten in one write to hold the new
+ * actions or point at the new action STEs, and only then the old action STEs
+ * are released. The match STEs keep their hash position, so the packets see
+ * either the old or the new actions.
+ */
+static int dr_rule_modify_actions_nic(struct mlx5dv_dr_rule *rule,
+				      struct dr_rule_rx_tx *nic_rule,
+				      size_t num_actions,
+				      struct mlx5dv_dr_action *actions[])
+{
+	struct dr_ste *ste_arr[DR_RULE_MAX_STES + DR_ACTION_MAX_STES +
+			       DR_ACTION_ASO_CROSS_GVMI_STES] = {};
+	uint8_t hw_ste_arr[DR_RULE_MAX_STE_CHAIN * DR_STE_SIZE] = {};
+	struct dr_matcher_rx_tx *nic_matcher = nic_rule->nic_matcher;
+	uint8_t num_of_builders = nic_matcher->num_of_builders;
+	struct mlx5dv_dr_matcher *matcher = rule->matcher;
+	struct mlx5dv_dr_domain *dmn = matcher->tbl->dmn;
+	struct cross_dmn_params cross_dmn_p = {};
+	struct dr_ste *match_ste, *old_last_ste;
+	struct dr_ste_send_info *ste_info;
+	struct dr_ste_htbl *old_next_htbl;
+	uint8_t old_hw_ste[DR_STE_SIZE];
+	uint32_t new_hw_ste_arr_sz;
+	uint8_t *match_hw_ste;
+	LIST_HEAD(send_ste_list);
+	int num_of_stes, i, ret;
+	bool async;
+
+	/* Skipped by dr_rule_skip() on creation */
+	if (!nic_rule->last_rule_ste)
+		return 0;
+
+	cross_dmn_p.cross_dmn_loc = -1;
+	match_hw_ste = hw_ste_arr + (num_of_builders - 1) * DR_STE_SIZE;
+
+	dr_rule_lock(nic_rule, NULL);
+
+	/* The members are listed last first, old action STEs come before */
+	old_last_ste = nic_rule->last_rule_ste;
+	dr_rule_get_reverse_rule_members(ste_arr, old_last_ste, &num_of_stes);
+	for (i = 0; i < num_of_stes; i++)
+		if (ste_arr[i]->ste_chain_location == num_of_builders)
+			break;
+	if (i == num_of_stes) {
+		dr_dbg(dmn, "Rule has no match STE\n");
+		errno = EINVAL;
+		ret = errno;
+		goto out_unlock;
+	}
+	match_ste = ste_arr[i];
+
+	dr_ste_rebuild_match_ste(matcher, nic_matcher, match_ste, match_hw_ste);
+
+	ret = dr_actions_build_ste_arr(matcher, nic_matcher, actions,
+				       num_actions, hw_ste_arr,
+				       &new_hw_ste_arr_sz, &cross_dmn_p);
+	if (ret)
+		goto out_unlock;
+
+	ste_info = calloc(1, sizeof(*ste_info));
+	if (!ste_info) {
+		errno = ENOMEM;
+		ret = errno;
+		goto out_unlock;
+	}
+
+	memcpy(old_hw_ste, dr_ste_get_hw_ste(match_ste),
+	       dr_ste_hw_ste_sz(match_ste));
+	old_next_htbl = match_ste->next_htbl;
+
+	/* Sent in reverse, the match STE goes last */
+	dr_send_fill_and_append_ste_send_info(match_ste, DR_STE_SIZE, 0,
+					      match_hw_ste, ste_info,
+					      &send_ste_list, false);
+
+	dr_rule_set_last_member(nic_rule, match_ste, true);
+	ret = dr_rule_handle_regular_action_stes(rule, nic_rule,
+						 &send_ste_list, match_ste,
+						 hw_ste_arr, new_hw_ste_arr_sz);
+	if (ret) {
+		dr_dbg(dmn, "Failed apply actions\n");
+		goto restore;
+	}
+
+	/* The STEs released here must not outlive this call in the rings */
+	async = rule->async;
+	rule->async = false;
+
+	ret = dr_rule_send_update_list(&send_ste_list, dmn, true,
+				       nic_rule->lock_index);
+	if (ret) {
+		dr_dbg(dmn, "Failed sending ste!\n");
+		rule->async = async;
+		goto restore;
+	}
+
+	/* Nothing points at the old action STEs anymore */
+	while (i--)
+		dr_ste_put(ste_arr[i], rule, nic_rule);
+
+	rule->async = async;
+	goto out_unlock;
+
+restore:
+	dr_rule_modify_actions_restore(rule, nic_rule, &send_ste_list,
+				       match_ste, old_hw_ste, old_next_htbl,
+				       old_last_ste);
+out_unlock:
+	dr_rule_unlock(nic_rule);
 	return ret;
 }
+
+int mlx5dv_dr_rule_modify_actions(struct mlx5dv_dr_rule *rule,
+				  size_t num_actions,
+				  struct mlx5dv_dr_action *actions[])
+{
+	struct mlx5dv_dr_matcher *matcher = rule->matcher;
+	struct mlx5dv_dr_domain *dmn = matcher->tbl->dmn;
+	struct mlx5dv_dr_action **old_actions = rule->actions;
+	uint16_t old_num_actions = rule->num_actions;
+	int i, ret;
+
+	if (dr_is_root_table(matcher->tbl) ||
+	    dr_rule_has_cross_dmn_action(dmn, old_num_actions, old_actions) ||
+	    dr_rule_has_cross_dmn_action(dmn, num_actions, actions)) {
+		dr_dbg(dmn, "Modifying the actions of this rule is not supported\n");
+		errno = EOPNOTSUPP;
+		return errno;
+	}
+
+	/* The new actions are held before the HW may use them */
+	ret = dr_rule_add_action_members(rule, num_actions, actions);
+	if (ret)
+		goto restore_action_members;
+
+	switch (dmn->type) {
+	case MLX5DV_DR_DOMAIN_TYPE_NIC_RX:
+		ret = dr_rule_modify_actions_nic(rule, &rule->rx, num_actions,
+						 actions);
+		break;
+	case MLX5DV_DR_DOMAIN_TYPE_NIC_TX:
+		ret = dr_rule_modify_actions_nic(rule, &rule->tx, num_actions,
+						 actions);
+		break;
+	case MLX5DV_DR_DOMAIN_TYPE_FDB:
+		ret = dr_rule_modify_actions_nic(rule, &rule->rx, num_actions,
+						 actions);
+		if (ret)
+			break;
+
+		ret = dr_rule_modify_actions_nic(rule, &rule->tx, num_actions,
+						 actions);
+		/* Best effort to keep both sides on the same actions */
+		if (ret)
+			dr_rule_modify_actions_nic(rule, &rule->rx,
+						   old_num_actions,
+						   old_actions);
+		break;
+	default:
+		ret = EINVAL;
+		break;
+	}
+
+	if (ret) {
+		dr_rule_remove_action_members(rule);
+		goto restore_action_members;
+	}
+
+	/* Release the old actions */
+	for (i = 0; i < old_num_actions; i++)
+		atomic_fetch_sub(&old_actions[i]->refcount, 1);
+	free(old_actions);
+
+	return 0;
+
+restore_action_members:
+	rule->actions = old_actions;
+	rule->num_actions = old_num_actions;
+	errno = ret;
+	return ret;
+}
+
+static void dr_rule_async_op_set_ring(struct dr_rule_async_op *op,
+				      struct mlx5dv_dr_domain *dmn,
+				      struct dr_rule_rx_tx *nic_rule)
+{
+	uint8_t ring_idx = nic_rule->lock_index % DR_MAX_SEND_RINGS;
+
+	op->ring_idx[op->num_rings] = ring_idx;
+	op->send_seq[op->num_rings] = dr_send_ring_get_seq(dmn, ring_idx);
+	op->num_rings++;
+}
+
+static void dr_rule_async_op_post(struct dr_rule_async_op *op)
+{
+	struct mlx5dv_dr_matcher *matcher = op->rule->matcher;
+	struct mlx5dv_dr_domain *dmn = matcher->tbl->dmn;
+
+	if (!dr_is_root_table(matcher->tbl)) {
+		if (dmn->type != MLX5DV_DR_DOMAIN_TYPE_NIC_TX)
+			dr_rule_async_op_set_ring(op, dmn, &op->rule->rx);
+		if (dmn->type != MLX5DV_DR_DOMAIN_TYPE_NIC_RX)
+			dr_rule_async_op_set_ring(op, dmn, &op->rule->tx);
+	}
+
+	pthread_spin_lock(&dmn->async_lock);
+	list_add_tail(&dmn->async_list, &op->list_node);
+	pthread_spin_unlock(&dmn->async_lock);
+}
+
+struct mlx5dv_dr_rule *
+mlx5dv_dr_rule_create_async(struct mlx5dv_dr_matcher *matcher,
+			    struct mlx5dv_flow_match_parameters *value,
+			    size_t num_actions,
+			    struct mlx5dv_dr_action *actions[],
+			    void *user_data)
+{
+	struct dr_rule_async_op *op;
+	struct mlx5dv_dr_rule *rule;
+
+	op = calloc(1, sizeof(*op));
+	if (!op) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	atomic_fetch_add(&matcher->refcount, 1);
+
+	if (dr_is_root_table(matcher->tbl))
+		rule = dr_rule_create_rule_root(matcher, value, num_actions, actions);
+	else
+		rule = dr_rule_create_rule(matcher, value, num_actions, actions,
+					   NULL, true);
+
+	if (!rule) {
+		atomic_fetch_sub(&matcher->refcount, 1);
+		free(op);
+		return NULL;
+	}
+
+	rule->async = false;
+	rule->async_op = op;
+	op->rule = rule;
+	op->user_data = user_data;
+	op->op = MLX5DV_DR_RULE_OP_CREATE;
+	dr_rule_async_op_post(op);
+
+	return rule;
+}
+
+int mlx5dv_dr_rule_destroy_async(struct mlx5dv_dr_rule *rule, void *user_data)
+{
+	struct dr_rule_async_op *op;
+	int ret;
+
+	op = calloc(1, sizeof(*op));
+	if (!op) {
+		errno = ENOMEM;
+		return errno;
+	}
+
+	if (dr_is_root_table(rule->matcher->tbl)) {
+		ret = dr_rule_destroy_rule_root(rule);
+	} else {
+		rule->async = true;
+		ret = dr_rule_destroy_rule(rule);
+	}
+
+	if (ret) {
+		free(op);
+		return ret;
+	}
+
+	/* The rule and its matcher reference are released once polled */
+	op->rule = rule;
+	op->user_data = user_data;
+	op->op = MLX5DV_DR_RULE_OP_DESTROY;
+	dr_rule_async_op_post(op);
+
+	return 0;
+}
+
+static bool dr_rule_async_op_done(struct dr_rule_async_op *op,
+				  uint64_t *done_seq)
+{
+	int i;
+
+	for (i = 0; i < op->num_rings; i++)
+		if (done_seq[op->ring_idx[i]] < op->send_seq[i])
+			return false;
+
+	return true;
+}
+
+int mlx5dv_dr_domain_poll(struct mlx5dv_dr_domain *dmn,
+			  struct mlx5dv_dr_rule_completion *comp,
+			  int num_comp)
+{
+	uint64_t wait_seq[DR_MAX_SEND_RINGS] = {};
+	uint64_t done_seq[DR_MAX_SEND_RINGS] = {};
+	struct dr_rule_async_op *op, *tmp_op;
+	struct mlx5dv_dr_matcher *matcher;
+	int i, ret, num = 0;
+
+	pthread_spin_lock(&dmn->async_lock);
+
+	list_for_each(&dmn->async_list, op, list_node)
+		for (i = 0; i < op->num_rings; i++)
+			wait_seq[op->ring_idx[i]] = max(wait_seq[op->ring_idx[i]],
+							op->send_seq[i]);
+
+	for (i = 0; i < DR_MAX_SEND_RINGS; i++) {
+		if (!wait_seq[i])
+			continue;
+
+		ret = dr_send_ring_poll(dmn, i, wait_seq[i], &done_seq[i]);
+		if (ret) {
+			num = -ret;
+			goto out_unlock;
+		}
+	}
+
+	list_for_each_safe(&dmn->async_list, op, tmp_op, list_node) {
+		if (num == num_comp)
+			break;
+
+		if (!dr_rule_async_op_done(op, done_seq))
+			continue;
+
+		comp[num].rule = op->rule;
+		comp[num].user_data = op->user_data;
+		comp[num].op = op->op;
+		num++;
+
+		list_del(&op->list_node);
+		if (op->op == MLX5DV_DR_RULE_OP_CREATE)
+			op->rule->async_op = NULL;
+		if (op->op == MLX5DV_DR_RULE_OP_DESTROY) {
+			matcher = op->rule->matcher;
+			free(op->rule);
+			atomic_fetch_sub(&matcher->refcount, 1);
+		}
+		free(op);
+	}
+
+out_unlock:
+	pthread_spin_unlock(&dmn->async_lock);
+	return num;
+}
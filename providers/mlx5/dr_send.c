@@ -622,19 +622,46 @@ static void dr_fill_data_segs(struct dr_send_ring *send_ring,
 		send_info->read.send_flags = 0;
 }
 
-static int dr_postsend_icm_data(struct mlx5dv_dr_domain *dmn,
-				struct postsend_info *send_info,
-				int ring_idx)
+/* A write queued by a nowait postsend, until the send ring has room for it */
+struct dr_send_ring_wr {
+	struct list_node	list_node;
+	uint64_t		remote_addr;
+	uint32_t		rkey;
+	uint32_t		length;
+	uint8_t			data[];
+};
+
+static bool dr_send_ring_has_room(struct dr_send_ring *send_ring)
 {
-	struct dr_send_ring *send_ring =
-		dmn->send_ring[ring_idx % DR_MAX_SEND_RINGS];
-	uint32_t buff_offset;
-	int ret;
+	return send_ring->pending_wqe < send_ring->signal_th * TH_NUMS_TO_DRAIN;
+}
 
-	pthread_spin_lock(&send_ring->lock);
-	ret = dr_handle_pending_wc(dmn, send_ring);
-	if (ret)
-		goto out_unlock;
+/* Consume the available completions without waiting for more */
+static int dr_send_ring_reap(struct mlx5dv_dr_domain *dmn,
+			     struct dr_send_ring *send_ring)
+{
+	int ne;
+
+	while (send_ring->pending_wqe && !dr_is_device_fatal(dmn)) {
+		ne = dr_poll_cq(&send_ring->cq, 1);
+		if (ne < 0) {
+			dr_dbg(dmn, "poll CQ failed\n");
+			return EIO;
+		}
+		if (!ne)
+			break;
+		send_ring->pending_wqe -= send_ring->signal_th;
+	}
+
+	return 0;
+}
+
+/* Must be called with the send ring lock held and room in the ring */
+static void dr_send_ring_post(struct mlx5dv_dr_domain *dmn,
+			      struct dr_send_ring *send_ring,
+			      struct postsend_info *send_info)
+{
+	uint32_t buff_offset;
 
 	if (send_info->write.length > dmn->info.max_inline_size) {
 		buff_offset = (send_ring->tx_head & (send_ring->signal_th - 1)) *
@@ -650,6 +677,189 @@ static int dr_postsend_icm_data(struct mlx5dv_dr_domain *dmn,
 	send_ring->tx_head++;
 	dr_fill_data_segs(send_ring, send_info);
 	dr_post_send(send_ring->qp, send_info);
+	send_ring->posted++;
+}
+
+/*
+ * Post the queued writes in order, waiting for room in the ring when wait is
+ * set, otherwise only as long as there is room.
+ */
+static int dr_send_ring_post_queued(struct mlx5dv_dr_domain *dmn,
+				    struct dr_send_ring *send_ring,
+				    bool wait)
+{
+	struct postsend_info send_info = {};
+	struct dr_send_ring_wr *wr;
+	int ret;
+
+	while ((wr = list_top(&send_ring->wr_list, struct dr_send_ring_wr,
+			      list_node))) {
+		if (wait) {
+			ret = dr_handle_pending_wc(dmn, send_ring);
+			if (ret)
+				return ret;
+		} else if (!dr_send_ring_has_room(send_ring)) {
+			return 0;
+		}
+
+		send_info.write.addr	= (uintptr_t) wr->data;
+		send_info.write.length	= wr->length;
+		send_info.write.lkey	= 0;
+		send_info.remote_addr	= wr->remote_addr;
+		send_info.rkey		= wr->rkey;
+
+		dr_send_ring_post(dmn, send_ring, &send_info);
+		list_del(&wr->list_node);
+		free(wr);
+	}
+
+	return 0;
+}
+
+static int dr_postsend_icm_data(struct mlx5dv_dr_domain *dmn,
+				struct postsend_info *send_info,
+				int ring_idx)
+{
+	struct dr_send_ring *send_ring =
+		dmn->send_ring[ring_idx % DR_MAX_SEND_RINGS];
+	int ret;
+
+	pthread_spin_lock(&send_ring->lock);
+	/* Keep the order with the writes queued before */
+	ret = dr_send_ring_post_queued(dmn, send_ring, true);
+	if (ret)
+		goto out_unlock;
+
+	ret = dr_handle_pending_wc(dmn, send_ring);
+	if (ret)
+		goto out_unlock;
+
+	dr_send_ring_post(dmn, send_ring, send_info);
+	send_ring->post_seq++;
+
+out_unlock:
+	pthread_spin_unlock(&send_ring->lock);
+	return ret;
+}
+
+/*
+ * Like dr_postsend_icm_data but never waits for the HW, when the ring is full
+ * the write is copied and queued, to be posted by a later postsend or poll.
+ */
+static int dr_postsend_icm_data_nowait(struct mlx5dv_dr_domain *dmn,
+				       struct postsend_info *send_info,
+				       int ring_idx)
+{
+	struct dr_send_ring *send_ring =
+		dmn->send_ring[ring_idx % DR_MAX_SEND_RINGS];
+	struct dr_send_ring_wr *wr;
+	int ret;
+
+	pthread_spin_lock(&send_ring->lock);
+	ret = dr_send_ring_reap(dmn, send_ring);
+	if (ret)
+		goto out_unlock;
+
+	ret = dr_send_ring_post_queued(dmn, send_ring, false);
+	if (ret)
+		goto out_unlock;
+
+	if (list_empty(&send_ring->wr_list) && dr_send_ring_has_room(send_ring)) {
+		dr_send_ring_post(dmn, send_ring, send_info);
+	} else {
+		wr = malloc(sizeof(*wr) + send_info->write.length);
+		if (!wr) {
+			ret = ENOMEM;
+			goto out_unlock;
+		}
+
+		memcpy(wr->data, (void *)(uintptr_t)send_info->write.addr,
+		       send_info->write.length);
+		wr->length = send_info->write.length;
+		wr->remote_addr = send_info->remote_addr;
+		wr->rkey = send_info->rkey;
+		list_add_tail(&send_ring->wr_list, &wr->list_node);
+	}
+	send_ring->post_seq++;
+
+out_unlock:
+	pthread_spin_unlock(&send_ring->lock);
+	if (ret)
+		errno = ret;
+	return ret;
+}
+
+/*
+ * dr_send_ring_get_seq: Return the sequence number of the last write issued
+ * on the ring, posted or queued. Writes are executed by the HW in this order.
+ */
+uint64_t dr_send_ring_get_seq(struct mlx5dv_dr_domain *dmn, uint8_t ring_idx)
+{
+	struct dr_send_ring *send_ring =
+		dmn->send_ring[ring_idx % DR_MAX_SEND_RINGS];
+	uint64_t seq;
+
+	pthread_spin_lock(&send_ring->lock);
+	seq = send_ring->post_seq;
+	pthread_spin_unlock(&send_ring->lock);
+
+	return seq;
+}
+
+/*
+ * dr_send_ring_poll: Make progress on the ring without waiting for the HW.
+ * Consume completions, post queued writes that fit and, when the writes up to
+ * wait_seq are posted but not covered by a signaled WQE yet, fill the ring up
+ * to the next signaled WQE with dummy writes.
+ *
+ * Input:
+ *     dmn      - Domain
+ *     ring_idx - Send ring index
+ *     wait_seq - Sequence number the caller waits for
+ *     done_seq - Output, sequence number of the last completed write
+ *
+ * Return: 0 on success.
+ */
+int dr_send_ring_poll(struct mlx5dv_dr_domain *dmn, uint8_t ring_idx,
+		      uint64_t wait_seq, uint64_t *done_seq)
+{
+	struct dr_send_ring *send_ring =
+		dmn->send_ring[ring_idx % DR_MAX_SEND_RINGS];
+	struct postsend_info send_info = {};
+	uint8_t data[DR_STE_SIZE] = {};
+	int ret;
+
+	pthread_spin_lock(&send_ring->lock);
+	if (dr_is_device_fatal(dmn)) {
+		*done_seq = send_ring->post_seq;
+		ret = 0;
+		goto out_unlock;
+	}
+
+	ret = dr_send_ring_reap(dmn, send_ring);
+	if (ret)
+		goto out_unlock;
+
+	ret = dr_send_ring_post_queued(dmn, send_ring, false);
+	if (ret)
+		goto out_unlock;
+
+	/* Each postsend is a write and a read WQE */
+	*done_seq = send_ring->posted - send_ring->pending_wqe / 2;
+	if (*done_seq >= wait_seq || wait_seq > send_ring->posted)
+		goto out_unlock;
+
+	send_info.write.addr	= (uintptr_t) data;
+	send_info.write.length	= DR_STE_SIZE;
+	send_info.write.lkey	= 0;
+	send_info.remote_addr	= (uintptr_t) send_ring->sync_mr->addr;
+	send_info.rkey		= send_ring->sync_mr->rkey;
+
+	while (send_ring->pending_wqe % send_ring->signal_th &&
+	       dr_send_ring_has_room(send_ring)) {
+		dr_send_ring_post(dmn, send_ring, &send_info);
+		send_ring->post_seq++;
+	}
 
 out_unlock:
 	pthread_spin_unlock(&send_ring->lock);
@@ -715,6 +925,56 @@ int dr_send_postsend_ste(struct mlx5dv_dr_domain *dmn, struct dr_ste *ste,
 	return dr_postsend_icm_data(dmn, &send_info, ring_idx);
 }
 
+int dr_send_postsend_ste_nowait(struct mlx5dv_dr_domain *dmn,
+				struct dr_ste *ste, uint8_t *data,
+				uint16_t size, uint16_t offset,
+				uint8_t ring_idx)
+{
+	struct postsend_info send_info = {};
+
+	dr_ste_prepare_for_postsend(dmn->ste_ctx, data, size);
+
+	send_info.write.addr    = (uintptr_t) data;
+	send_info.write.length  = size;
+	send_info.write.lkey    = 0;
+	send_info.remote_addr   = dr_ste_get_mr_addr(ste) + offset;
+	send_info.rkey          = ste->htbl->chunk->rkey;
+
+	return dr_postsend_icm_data_nowait(dmn, &send_info, ring_idx);
+}
+
+/*
+ * dr_send_postsend_ste_arr: write num_stes full STEs that are contiguous in
+ * the icm with a single postsend.
+ *
+ * Input:
+ *     dmn      - Domain
+ *     ste      - The first ste to write, the others follow it in the icm
+ *     data     - The STEs data back to back, prepared for HW in place
+ *     num_stes - Number of STEs, up to max_send_size bytes in total
+ *
+ * Return: 0 on success.
+ */
+int dr_send_postsend_ste_arr(struct mlx5dv_dr_domain *dmn, struct dr_ste *ste,
+			     uint8_t *data, uint32_t num_stes,
+			     uint8_t ring_idx)
+{
+	struct postsend_info send_info = {};
+	uint32_t i;
+
+	for (i = 0; i < num_stes; i++)
+		dr_ste_prepare_for_postsend(dmn->ste_ctx, data + i * DR_STE_SIZE,
+					    DR_STE_SIZE);
+
+	send_info.write.addr    = (uintptr_t) data;
+	send_info.write.length  = num_stes * DR_STE_SIZE;
+	send_info.write.lkey    = 0;
+	send_info.remote_addr   = dr_ste_get_mr_addr(ste);
+	send_info.rkey          = ste->htbl->chunk->rkey;
+
+	return dr_postsend_icm_data(dmn, &send_info, ring_idx);
+}
+
 int dr_send_postsend_htbl(struct mlx5dv_dr_domain *dmn, struct dr_ste_htbl *htbl,
 			  uint8_t *formated_ste, uint8_t *mask,
 			  uint8_t send_ring_idx)
@@ -722,7 +982,7 @@ int dr_send_postsend_htbl(struct mlx5dv_dr_domain *dmn, struct dr_ste_htbl *htbl
 	bool legacy_htbl = htbl->type == DR_STE_HTBL_TYPE_LEGACY;
 	uint32_t byte_size = htbl->chunk->byte_size;
 	int i, j, num_stes_per_iter, iterations;
-	uint8_t ste_sz = htbl->ste_arr->size;
+	uint8_t ste_sz = dr_ste_htbl_hw_ste_sz(htbl);
 	uint8_t *data;
 	int ret;
 
@@ -746,7 +1006,7 @@ int dr_send_postsend_htbl(struct mlx5dv_dr_domain *dmn, struct dr_ste_htbl *htbl
 			} else {
 				/* Copy data */
 				memcpy(data + (j * DR_STE_SIZE),
-				       htbl->ste_arr[ste_index + j].hw_ste,
+				       htbl->hw_ste_arr + (ste_index + j) * ste_sz,
 				       ste_sz);
 				/* Copy bit_mask on legacy tables */
 				if (legacy_htbl)
@@ -776,6 +1036,68 @@ out_free:
 	return ret;
 }
 
+/*
+ * dr_send_postsend_htbl_range: write num_stes entries of htbl from ste_index
+ * with a single postsend.  Used entries are written from their shadow, with
+ * the mask on legacy tables, unused ones as formated_ste.  While htbl is
+ * written to replace fwd_htbl, its unused entries miss to the fwd_htbl entry
+ * with the same hash index instead.
+ */
+int dr_send_postsend_htbl_range(struct mlx5dv_dr_domain *dmn,
+				struct dr_ste_htbl *htbl,
+				uint32_t ste_index, uint32_t num_stes,
+				uint8_t *formated_ste, uint8_t *mask,
+				struct dr_ste_htbl *fwd_htbl,
+				uint8_t send_ring_idx)
+{
+	bool legacy_htbl = htbl->type == DR_STE_HTBL_TYPE_LEGACY;
+	uint8_t ste_sz = dr_ste_htbl_hw_ste_sz(htbl);
+	struct postsend_info send_info = {};
+	uint32_t fwd_mask = 0;
+	struct dr_ste *ste;
+	uint8_t *data, *cur;
+	uint32_t i;
+	int ret;
+
+	data = calloc(num_stes, DR_STE_SIZE);
+	if (!data) {
+		errno = ENOMEM;
+		return errno;
+	}
+
+	if (fwd_htbl)
+		fwd_mask = fwd_htbl->chunk->num_of_entries - 1;
+
+	for (i = 0; i < num_stes; i++) {
+		ste = &htbl->ste_arr[ste_index + i];
+		cur = data + i * DR_STE_SIZE;
+
+		if (dr_ste_is_not_used(ste)) {
+			memcpy(cur, formated_ste, DR_STE_SIZE);
+			if (fwd_htbl)
+				dr_ste_set_miss_addr(dmn->ste_ctx, cur,
+						     dr_ste_get_icm_addr(&fwd_htbl->ste_arr[(ste_index + i) & fwd_mask]));
+		} else {
+			memcpy(cur, dr_ste_get_hw_ste(ste), ste_sz);
+			if (legacy_htbl)
+				memcpy(cur + ste_sz, mask, DR_STE_SIZE_MASK);
+		}
+
+		dr_ste_prepare_for_postsend(dmn->ste_ctx, cur, DR_STE_SIZE);
+	}
+
+	send_info.write.addr	= (uintptr_t) data;
+	send_info.write.length	= num_stes * DR_STE_SIZE;
+	send_info.write.lkey	= 0;
+	send_info.remote_addr	= dr_ste_get_mr_addr(htbl->ste_arr + ste_index);
+	send_info.rkey		= htbl->chunk->rkey;
+
+	ret = dr_postsend_icm_data(dmn, &send_info, send_ring_idx);
+
+	free(data);
+	return ret;
+}
+
 /* Initialize htble with default STEs */
 int dr_send_postsend_formated_htbl(struct mlx5dv_dr_domain *dmn,
 				   struct dr_ste_htbl *htbl,
@@ -783,6 +1105,7 @@ int dr_send_postsend_formated_htbl(struct mlx5dv_dr_domain *dmn,
 				   bool update_hw_ste,
 				   uint8_t send_ring_idx)
 {
+	uint8_t ste_sz = dr_ste_htbl_hw_ste_sz(htbl);
 	uint32_t byte_size = htbl->chunk->byte_size;
 	int i, num_stes, iterations, ret;
 	uint8_t *copy_dst;
@@ -796,8 +1119,8 @@ int dr_send_postsend_formated_htbl(struct mlx5dv_dr_domain *dmn,
 	if (update_hw_ste) {
 		/* Copy the STE to hash table ste_arr */
 		for (i = 0; i < num_stes; i++) {
-			copy_dst = htbl->hw_ste_arr + i * htbl->ste_arr->size;
-			memcpy(copy_dst, ste_init_data, htbl->ste_arr->size);
+			copy_dst = htbl->hw_ste_arr + i * ste_sz;
+			memcpy(copy_dst, ste_init_data, ste_sz);
 		}
 	}
 
@@ -931,6 +1254,11 @@ static int dr_prepare_qp_to_rts(struct mlx5dv_dr_domain *dmn,
 
 static void dr_send_ring_free_one(struct dr_send_ring *send_ring)
 {
+	struct dr_send_ring_wr *wr, *tmp_wr;
+
+	list_for_each_safe(&send_ring->wr_list, wr, tmp_wr, list_node)
+		free(wr);
+
 	dr_destroy_qp(send_ring->qp);
 	ibv_destroy_cq(send_ring->cq.ibv_cq);
 	ibv_dereg_mr(send_ring->sync_mr);
@@ -976,6 +1304,8 @@ static int dr_send_ring_alloc_one(struct mlx5dv_dr_domain *dmn,
 		goto free_send_ring;
 	}
 
+	list_head_init(&send_ring->wr_list);
+
 	cq_size = QUEUE_SIZE + 1;
 	send_ring->cq.ibv_cq = ibv_create_cq(dmn->ctx, cq_size, NULL, NULL, 0);
 	if (!send_ring->cq.ibv_cq) {
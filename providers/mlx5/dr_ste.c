@@ -30,9 +30,13 @@
  * SOFTWARE.
  */
 
+#include <assert.h>
 #include "mlx5dv_dr.h"
 #include "dr_ste.h"
 
+/* A host STE is kept for every ICM STE, see struct dr_ste */
+static_assert(sizeof(struct dr_ste) <= 48, "struct dr_ste grew");
+
 struct dr_hw_ste_format {
 	uint8_t ctrl[DR_STE_SIZE_CTRL];
 	uint8_t tag[DR_STE_SIZE_TAG];
@@ -42,12 +46,10 @@ struct dr_hw_ste_format {
 uint32_t dr_ste_calc_hash_index(uint8_t *hw_ste_p, struct dr_ste_htbl *htbl)
 {
 	struct dr_hw_ste_format *hw_ste = (struct dr_hw_ste_format *)hw_ste_p;
-	uint8_t masked[DR_STE_SIZE_TAG] = {};
+	uint8_t masked[DR_STE_SIZE_TAG];
 	uint32_t crc32, index;
 	uint8_t *p_masked;
-	uint16_t bit;
 	size_t len;
-	int i;
 
 	/* Don't calculate CRC if the result is predicted */
 	if (htbl->chunk->num_of_entries == 1)
@@ -59,20 +61,14 @@ uint32_t dr_ste_calc_hash_index(uint8_t *hw_ste_p, struct dr_ste_htbl *htbl)
 
 		len = DR_STE_SIZE_TAG;
 		/* Mask tag using byte mask, bit per byte */
-		bit = 1 << (DR_STE_SIZE_TAG - 1);
-		for (i = 0; i < DR_STE_SIZE_TAG; i++) {
-			if (htbl->byte_mask & bit)
-				masked[i] = hw_ste->tag[i];
-
-			bit = bit >> 1;
-		}
+		dr_crc32_mask_tag(masked, hw_ste->tag, htbl->byte_mask);
 		p_masked = masked;
 	} else {
 		len = DR_STE_SIZE_MATCH_TAG;
 		p_masked = hw_ste->tag;
 	}
 
-	crc32 = dr_crc32_slice8_calc(p_masked, len);
+	crc32 = dr_crc32_calc(p_masked, len);
 	index = crc32 % htbl->chunk->num_of_entries;
 
 	return index;
@@ -125,15 +121,13 @@ void dr_ste_set_miss_addr(struct dr_ste_ctx *ste_ctx, uint8_t *hw_ste_p,
 }
 
 static void dr_ste_always_miss_addr(struct dr_ste_ctx *ste_ctx,
-				    struct dr_ste *ste,
+				    uint8_t *hw_ste_p,
 				    uint64_t miss_addr,
 				    uint16_t gvmi)
 {
-	uint8_t *hw_ste_p = ste->hw_ste;
-
 	ste_ctx->set_ctrl_always_miss(hw_ste_p, miss_addr, gvmi);
 
-	dr_ste_set_always_miss((struct dr_hw_ste_format *)ste->hw_ste);
+	dr_ste_set_always_miss((struct dr_hw_ste_format *)hw_ste_p);
 }
 
 void dr_ste_set_hit_addr(struct dr_ste_ctx *ste_ctx, uint8_t *hw_ste_p,
@@ -185,12 +179,11 @@ struct dr_ste *dr_ste_get_miss_list_top(struct dr_ste *ste)
 }
 
 static void dr_ste_always_hit_htbl(struct dr_ste_ctx *ste_ctx,
-				   struct dr_ste *ste,
+				   uint8_t *hw_ste,
 				   struct dr_ste_htbl *next_htbl,
 				   uint16_t gvmi)
 {
 	struct dr_icm_chunk *chunk = next_htbl->chunk;
-	uint8_t *hw_ste = ste->hw_ste;
 
 	ste_ctx->set_ctrl_always_hit_htbl(hw_ste,
 					  next_htbl->byte_mask,
@@ -199,7 +192,7 @@ static void dr_ste_always_hit_htbl(struct dr_ste_ctx *ste_ctx,
 					  chunk->num_of_entries,
 					  gvmi);
 
-	dr_ste_set_always_hit((struct dr_hw_ste_format *)ste->hw_ste);
+	dr_ste_set_always_hit((struct dr_hw_ste_format *)hw_ste);
 }
 
 bool dr_ste_is_last_in_rule(struct dr_matcher_rx_tx *nic_matcher,
@@ -223,10 +216,11 @@ bool dr_ste_is_last_in_rule(struct dr_matcher_rx_tx *nic_matcher,
  */
 static void dr_ste_replace(struct dr_ste *dst, struct dr_ste *src)
 {
-	memcpy(dst->hw_ste, src->hw_ste, dst->size);
+	memcpy(dr_ste_get_hw_ste(dst), dr_ste_get_hw_ste(src),
+	       dr_ste_hw_ste_sz(dst));
 	dst->next_htbl = src->next_htbl;
 	if (dst->next_htbl)
-		dst->next_htbl->pointing_ste = dst;
+		dr_htbl_set_pointing_ste(dst->next_htbl, dst);
 
 	atomic_init(&dst->refcount, atomic_load(&src->refcount));
 }
@@ -253,7 +247,7 @@ dr_ste_remove_head_ste(struct dr_ste_ctx *ste_ctx,
 				ste->htbl,
 				formated_ste,
 				&info);
-	memcpy(ste->hw_ste, formated_ste, ste->size);
+	memcpy(dr_ste_get_hw_ste(ste), formated_ste, dr_ste_hw_ste_sz(ste));
 
 	list_del_init(&ste->miss_list_node);
 
@@ -299,7 +293,7 @@ dr_ste_replace_head_ste(struct dr_matcher_rx_tx *nic_matcher,
 	sb = &nic_matcher->ste_builder[sb_idx];
 
 	/* Copy all 64 hw_ste bytes */
-	memcpy(hw_ste, ste->hw_ste, ste->size);
+	memcpy(hw_ste, dr_ste_get_hw_ste(ste), dr_ste_hw_ste_sz(ste));
 	dr_ste_set_bit_mask(hw_ste, sb);
 
 	/*
@@ -334,11 +328,12 @@ static void dr_ste_remove_middle_ste(struct dr_ste_ctx *ste_ctx,
 	prev_ste = list_prev(dr_ste_get_miss_list(ste), ste, miss_list_node);
 	assert(prev_ste);
 
-	miss_addr = ste_ctx->get_miss_addr(ste->hw_ste);
-	ste_ctx->set_miss_addr(prev_ste->hw_ste, miss_addr);
+	miss_addr = ste_ctx->get_miss_addr(dr_ste_get_hw_ste(ste));
+	ste_ctx->set_miss_addr(dr_ste_get_hw_ste(prev_ste), miss_addr);
 
 	dr_send_fill_and_append_ste_send_info(prev_ste, DR_STE_SIZE_CTRL, 0,
-					      prev_ste->hw_ste, ste_info,
+					      dr_ste_get_hw_ste(prev_ste),
+					      ste_info,
 					      send_ste_list, true /* Copy data*/);
 
 	list_del_init(&ste->miss_list_node);
@@ -395,11 +390,18 @@ void dr_ste_free(struct dr_ste *ste,
 	/* Update HW */
 	list_for_each_safe(&send_ste_list, cur_ste_info, tmp_ste_info, send_list) {
 		list_del(&cur_ste_info->send_list);
-		dr_send_postsend_ste(dmn, cur_ste_info->ste,
-				     cur_ste_info->data,
-				     cur_ste_info->size,
-				     cur_ste_info->offset,
-				     nic_rule->lock_index);
+		if (rule->async)
+			dr_send_postsend_ste_nowait(dmn, cur_ste_info->ste,
+						    cur_ste_info->data,
+						    cur_ste_info->size,
+						    cur_ste_info->offset,
+						    nic_rule->lock_index);
+		else
+			dr_send_postsend_ste(dmn, cur_ste_info->ste,
+					     cur_ste_info->data,
+					     cur_ste_info->size,
+					     cur_ste_info->offset,
+					     nic_rule->lock_index);
 	}
 
 	if (put_on_origin_table)
@@ -439,15 +441,15 @@ void dr_ste_set_formated_ste(struct dr_ste_ctx *ste_ctx,
 			     struct dr_htbl_connect_info *connect_info)
 {
 	bool is_rx = nic_type == DR_DOMAIN_NIC_TYPE_RX;
-	struct dr_ste ste = {};
 
 	ste_ctx->ste_init(formated_ste, htbl->lu_type, is_rx, gvmi);
-	ste.hw_ste = formated_ste;
 
 	if (connect_info->type == CONNECT_HIT)
-		dr_ste_always_hit_htbl(ste_ctx, &ste, connect_info->hit_next_htbl, gvmi);
+		dr_ste_always_hit_htbl(ste_ctx, formated_ste,
+				       connect_info->hit_next_htbl, gvmi);
 	else
-		dr_ste_always_miss_addr(ste_ctx, &ste, connect_info->miss_icm_addr, gvmi);
+		dr_ste_always_miss_addr(ste_ctx, formated_ste,
+					connect_info->miss_icm_addr, gvmi);
 }
 
 int dr_ste_htbl_init_and_postsend(struct mlx5dv_dr_domain *dmn,
@@ -521,15 +523,36 @@ free_table:
 	return ENOENT;
 }
 
-struct dr_ste_htbl *dr_ste_htbl_alloc(struct dr_icm_pool *pool,
-				      enum dr_icm_chunk_size chunk_size,
-				      enum dr_ste_htbl_type type,
-				      uint16_t lu_type, uint16_t byte_mask)
+/* Set entries [first, first + num) of htbl as unused */
+void dr_ste_htbl_init_entries(struct dr_ste_htbl *htbl, uint32_t first,
+			      uint32_t num)
+{
+	uint32_t i;
+
+	for (i = first; i < first + num; i++) {
+		struct dr_ste *ste = &htbl->ste_arr[i];
+
+		ste->htbl = htbl;
+		atomic_init(&ste->refcount, 0);
+		list_node_init(&ste->miss_list_node);
+		list_head_init(&htbl->miss_list[i]);
+		ste->next_htbl = NULL;
+		ste->rule_rx_tx = NULL;
+		ste->ste_chain_location = 0;
+	}
+}
+
+/*
+ * Allocate a hash table whose entries are left to dr_ste_htbl_init_entries(),
+ * for a caller that sets them up a range at a time.
+ */
+struct dr_ste_htbl *dr_ste_htbl_alloc_lazy(struct dr_icm_pool *pool,
+					   enum dr_icm_chunk_size chunk_size,
+					   enum dr_ste_htbl_type type,
+					   uint16_t lu_type, uint16_t byte_mask)
 {
 	struct dr_icm_chunk *chunk;
 	struct dr_ste_htbl *htbl;
-	uint8_t ste_size;
-	int i;
 
 	htbl = calloc(1, sizeof(struct dr_ste_htbl));
 	if (!htbl) {
@@ -541,11 +564,6 @@ struct dr_ste_htbl *dr_ste_htbl_alloc(struct dr_icm_pool *pool,
 	if (!chunk)
 		goto out_free_htbl;
 
-	if (type == DR_STE_HTBL_TYPE_LEGACY)
-		ste_size = DR_STE_SIZE_REDUCED;
-	else
-		ste_size = DR_STE_SIZE;
-
 	htbl->type = type;
 	htbl->chunk = chunk;
 	htbl->lu_type = lu_type;
@@ -555,20 +573,6 @@ struct dr_ste_htbl *dr_ste_htbl_alloc(struct dr_icm_pool *pool,
 	htbl->miss_list = chunk->miss_list;
 	atomic_init(&htbl->refcount, 0);
 
-	for (i = 0; i < chunk->num_of_entries; i++) {
-		struct dr_ste *ste = &htbl->ste_arr[i];
-
-		ste->hw_ste = htbl->hw_ste_arr + i * ste_size;
-		ste->htbl = htbl;
-		ste->size = ste_size;
-		atomic_init(&ste->refcount, 0);
-		list_node_init(&ste->miss_list_node);
-		list_head_init(&htbl->miss_list[i]);
-		ste->next_htbl = NULL;
-		ste->rule_rx_tx = NULL;
-		ste->ste_chain_location = 0;
-	}
-
 	htbl->chunk_size = chunk_size;
 
 	return htbl;
@@ -578,11 +582,41 @@ out_free_htbl:
 	return NULL;
 }
 
+struct dr_ste_htbl *dr_ste_htbl_alloc(struct dr_icm_pool *pool,
+				      enum dr_icm_chunk_size chunk_size,
+				      enum dr_ste_htbl_type type,
+				      uint16_t lu_type, uint16_t byte_mask)
+{
+	struct dr_ste_htbl *htbl;
+
+	htbl = dr_ste_htbl_alloc_lazy(pool, chunk_size, type, lu_type,
+				      byte_mask);
+	if (htbl)
+		dr_ste_htbl_init_entries(htbl, 0, htbl->chunk->num_of_entries);
+
+	return htbl;
+}
+
 int dr_ste_htbl_free(struct dr_ste_htbl *htbl)
 {
+	struct dr_ste_htbl_grow *grow = htbl->grow;
+	struct dr_ste_htbl *other;
+
 	if (atomic_load(&htbl->refcount))
 		return EBUSY;
 
+	if (grow) {
+		/* Both tables of a growth go away with the last entry of either */
+		other = htbl == grow->old_htbl ? grow->new_htbl : grow->old_htbl;
+		if (atomic_load(&other->refcount))
+			return 0;
+
+		free(grow->migrated);
+		free(grow);
+		dr_icm_free_chunk(other->chunk);
+		free(other);
+	}
+
 	dr_icm_free_chunk(htbl->chunk);
 	free(htbl);
 	return 0;
@@ -765,6 +799,31 @@ int dr_ste_build_ste_arr(struct mlx5dv_dr_matcher *matcher,
 	return 0;
 }
 
+/*
+ * Rebuild the HW STE of the last match STE of a rule from its shadow, as
+ * dr_ste_build_ste_arr() built it, keeping the tag and the miss address but
+ * none of the actions applied on it.
+ */
+void dr_ste_rebuild_match_ste(struct mlx5dv_dr_matcher *matcher,
+			      struct dr_matcher_rx_tx *nic_matcher,
+			      struct dr_ste *ste,
+			      uint8_t *hw_ste)
+{
+	struct dr_domain_rx_tx *nic_dmn = nic_matcher->nic_tbl->nic_dmn;
+	bool is_rx = nic_dmn->type == DR_DOMAIN_NIC_TYPE_RX;
+	struct mlx5dv_dr_domain *dmn = matcher->tbl->dmn;
+	struct dr_ste_ctx *ste_ctx = dmn->ste_ctx;
+	struct dr_ste_build *sb;
+
+	sb = &nic_matcher->ste_builder[ste->ste_chain_location - 1];
+	ste_ctx->ste_init(hw_ste, sb->lu_type, is_rx, dmn->info.caps.gvmi);
+	dr_ste_set_bit_mask(hw_ste, sb);
+	memcpy(dr_ste_get_tag(hw_ste), dr_ste_get_tag(dr_ste_get_hw_ste(ste)),
+	       dr_ste_tag_sz(ste));
+	ste_ctx->set_miss_addr(hw_ste,
+			       ste_ctx->get_miss_addr(dr_ste_get_hw_ste(ste)));
+}
+
 static void dr_ste_copy_mask_misc(char *mask, struct dr_match_misc *spec, bool clear)
 {
 	spec->gre_c_present = DR_DEVX_GET_CLEAR(dr_match_set_misc, mask, gre_c_present, clear);
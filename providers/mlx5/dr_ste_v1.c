@@ -3325,15 +3325,15 @@ static int dr_ste_v1_aso_other_domain_link(struct mlx5dv_devx_obj *devx_obj,
 		action_ste = action_htbl[i]->ste_arr;
 		dr_ste_get(action_ste);
 
-		peer_dmn->ste_ctx->ste_init(action_ste->hw_ste,
+		peer_dmn->ste_ctx->ste_init(dr_ste_get_hw_ste(action_ste),
 					     DR_STE_LU_TYPE_DONT_CARE,
 					     0,
 					     peer_dmn->info.caps.gvmi);
 
-		peer_dmn->ste_ctx->set_hit_gvmi(action_ste->hw_ste,
+		peer_dmn->ste_ctx->set_hit_gvmi(dr_ste_get_hw_ste(action_ste),
 						 dmn->info.caps.gvmi);
 
-		peer_dmn->ste_ctx->set_aso_ct_cross_dmn(action_ste->hw_ste,
+		peer_dmn->ste_ctx->set_aso_ct_cross_dmn(dr_ste_get_hw_ste(action_ste),
 							devx_obj->object_id,
 							i,
 							return_reg_c,
@@ -3344,7 +3344,7 @@ static int dr_ste_v1_aso_other_domain_link(struct mlx5dv_devx_obj *devx_obj,
 
 		rule_ste = rule_htbl[i]->ste_arr;
 		dr_ste_get(rule_ste);
-		dmn->ste_ctx->ste_init(rule_ste->hw_ste,
+		dmn->ste_ctx->ste_init(dr_ste_get_hw_ste(rule_ste),
 				       DR_STE_LU_TYPE_DONT_CARE,
 				       0,
 				       dmn->info.caps.gvmi);
@@ -3352,7 +3352,7 @@ static int dr_ste_v1_aso_other_domain_link(struct mlx5dv_devx_obj *devx_obj,
 			      &rule_ste->miss_list_node);
 
 		dr_ste_set_hit_addr_by_next_htbl(peer_dmn->ste_ctx,
-						 action_ste->hw_ste,
+						 dr_ste_get_hw_ste(action_ste),
 						 rule_ste->htbl);
 		rule_htbl[i]->pointing_ste = action_ste;
 		action_ste->next_htbl = rule_htbl[i];
@@ -3365,8 +3365,8 @@ static int dr_ste_v1_aso_other_domain_link(struct mlx5dv_devx_obj *devx_obj,
 			goto free_rule_htbl_i;
 		}
 
-		memcpy(&action_hw_ste[i * DR_STE_SIZE], action_ste->hw_ste,
-		       DR_STE_SIZE_REDUCED);
+		memcpy(&action_hw_ste[i * DR_STE_SIZE],
+		       dr_ste_get_hw_ste(action_ste), DR_STE_SIZE_REDUCED);
 
 		dr_send_fill_and_append_ste_send_info(action_ste,
 						      DR_STE_SIZE, 0,
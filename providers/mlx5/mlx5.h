@@ -483,6 +483,22 @@ enum {
 	MLX5_CQ_FLAGS_RAW_WQE = 1 << 7,
 };
 
+enum {
+	MLX5_MINI_CQE_ARRAY_SIZE = 8,
+};
+
+/* One completion of a compressed CQE session, see cq.c */
+struct mlx5_mini_cqe8 {
+	union {
+		__be32		rx_hash_result;
+		struct {
+			__be16	checksum;
+			__be16	stridx;
+		};
+	};
+	__be32			byte_cnt;
+};
+
 struct mlx5_cq {
 	struct verbs_cq			verbs_cq;
 	struct mlx5_buf			buf_a;
@@ -511,6 +527,14 @@ struct mlx5_cq {
 	int				cached_opcode;
 	struct mlx5dv_clock_info	last_clock_info;
 	struct ibv_pd			*parent_domain;
+	/* enum mlx5dv_cqe_comp_res_format, 0 without CQE compression */
+	uint8_t				cqe_comp_format;
+	/* Compressed CQE session being expanded */
+	uint8_t				mini_idx;
+	uint16_t			mini_wqe_counter;
+	uint32_t			mini_left;
+	struct mlx5_cqe64		title;
+	struct mlx5_mini_cqe8		mini_arr[MLX5_MINI_CQE_ARRAY_SIZE];
 };
 
 struct mlx5_tag_entry {
@@ -896,6 +920,11 @@ struct mlx5dv_dek {
 	struct mlx5dv_devx_obj *devx_obj;
 };
 
+struct mlx5_devx_cmd_comp {
+	struct ibv_context *context;
+	struct mlx5dv_devx_cmd_comp dv_cmd_comp;
+};
+
 struct mlx5_devx_event_channel {
 	struct ibv_context *context;
 	struct mlx5dv_devx_event_channel dv_event_channel;
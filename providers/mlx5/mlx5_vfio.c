@@ -56,6 +56,8 @@ static int mlx5_vfio_post_cmd(struct mlx5_vfio_context *ctx, void *in,
 			      int ilen, void *out, int olen,
 			      unsigned int slot, bool async);
 
+static int mlx5_vfio_setup_cmd_slot(struct mlx5_vfio_context *ctx, int slot);
+
 static int mlx5_vfio_register_mem(struct mlx5_vfio_context *ctx,
 				  void *vaddr, uint64_t iova, uint64_t size)
 {
@@ -82,108 +84,246 @@ static void mlx5_vfio_unregister_mem(struct mlx5_vfio_context *ctx,
 		assert(false);
 }
 
-static struct page_block *mlx5_vfio_new_block(struct mlx5_vfio_context *ctx)
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+/* A hugetlb page of size, NULL if the system has none available */
+static void *mlx5_vfio_map_hugetlb(size_t size)
 {
-	struct page_block *page_block;
+	void *ptr;
+
+	ptr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB |
+		   ilog32(size - 1) << MAP_HUGE_SHIFT, -1, 0);
+	return ptr == MAP_FAILED ? NULL : ptr;
+}
+
+static void mlx5_vfio_free_block_mem(struct page_block *page_block)
+{
+	if (page_block->hugetlb)
+		munmap(page_block->page_ptr, page_block->size);
+	else
+		free(page_block->page_ptr);
+}
+
+/*
+ * Add a block for npages more pages.  Blocks are backed by a hugetlb page
+ * when the system has one, so the IOMMU maps them with a single entry, and
+ * a demand of half a huge block or more gets a huge block.
+ */
+static struct page_block *mlx5_vfio_new_block(struct mlx5_vfio_context *ctx,
+					      uint32_t npages)
+{
+	struct vfio_mem_allocator *alloc = &ctx->mem_alloc;
+	struct page_block *page_block, **blocks;
+	unsigned int i;
 	int err;
 
+	if (alloc->num_blocks == alloc->max_blocks) {
+		i = max(alloc->max_blocks * 2, 16U);
+		blocks = realloc(alloc->blocks, i * sizeof(*blocks));
+		if (!blocks) {
+			errno = ENOMEM;
+			return NULL;
+		}
+		alloc->blocks = blocks;
+		alloc->max_blocks = i;
+	}
+
 	page_block = calloc(1, sizeof(*page_block));
 	if (!page_block) {
 		errno = ENOMEM;
 		return NULL;
 	}
 
-	err = posix_memalign(&page_block->page_ptr, MLX5_VFIO_BLOCK_SIZE,
-			     MLX5_VFIO_BLOCK_SIZE);
-	if (err) {
-		errno = err;
-		goto err;
+	if (npages >= MLX5_VFIO_HUGE_BLOCK_NUM_PAGES / 2) {
+		page_block->size = MLX5_VFIO_HUGE_BLOCK_SIZE;
+		page_block->page_ptr = mlx5_vfio_map_hugetlb(page_block->size);
+	}
+
+	if (!page_block->page_ptr) {
+		page_block->size = MLX5_VFIO_BLOCK_SIZE;
+		page_block->page_ptr = mlx5_vfio_map_hugetlb(page_block->size);
+	}
+
+	page_block->hugetlb = page_block->page_ptr;
+	if (!page_block->hugetlb) {
+		err = posix_memalign(&page_block->page_ptr,
+				     MLX5_VFIO_BLOCK_SIZE,
+				     MLX5_VFIO_BLOCK_SIZE);
+		if (err) {
+			errno = err;
+			goto err;
+		}
+	}
+
+	page_block->num_pages = page_block->size / MLX5_ADAPTER_PAGE_SIZE;
+	page_block->num_free = page_block->num_pages;
+	page_block->free_pages = bitmap_alloc1(page_block->num_pages);
+	if (!page_block->free_pages) {
+		errno = ENOMEM;
+		goto err_bmp;
 	}
 
-	err = iset_alloc_range(ctx->iova_alloc, MLX5_VFIO_BLOCK_SIZE, &page_block->iova);
+	err = iset_alloc_range(ctx->iova_alloc, page_block->size, &page_block->iova);
 	if (err)
 		goto err_range;
 
-	bitmap_fill(page_block->free_pages, MLX5_VFIO_BLOCK_NUM_PAGES);
 	err = mlx5_vfio_register_mem(ctx, page_block->page_ptr, page_block->iova,
-				     MLX5_VFIO_BLOCK_SIZE);
+				     page_block->size);
 	if (err)
 		goto err_reg;
 
-	list_add(&ctx->mem_alloc.block_list, &page_block->next_block);
+	for (i = alloc->num_blocks;
+	     i && alloc->blocks[i - 1]->iova > page_block->iova; i--)
+		alloc->blocks[i] = alloc->blocks[i - 1];
+	alloc->blocks[i] = page_block;
+	alloc->num_blocks++;
+
+	list_add(&alloc->avail_list, &page_block->next_block);
 	return page_block;
 
 err_reg:
 	iset_insert_range(ctx->iova_alloc, page_block->iova,
-			  MLX5_VFIO_BLOCK_SIZE);
+			  page_block->size);
 err_range:
-	free(page_block->page_ptr);
+	free(page_block->free_pages);
+err_bmp:
+	mlx5_vfio_free_block_mem(page_block);
 err:
 	free(page_block);
 	return NULL;
 }
 
 static void mlx5_vfio_free_block(struct mlx5_vfio_context *ctx,
-				 struct page_block *page_block)
+				 unsigned int idx)
 {
-	mlx5_vfio_unregister_mem(ctx, page_block->iova, MLX5_VFIO_BLOCK_SIZE);
-	iset_insert_range(ctx->iova_alloc, page_block->iova, MLX5_VFIO_BLOCK_SIZE);
-	list_del(&page_block->next_block);
-	free(page_block->page_ptr);
+	struct vfio_mem_allocator *alloc = &ctx->mem_alloc;
+	struct page_block *page_block = alloc->blocks[idx];
+
+	mlx5_vfio_unregister_mem(ctx, page_block->iova, page_block->size);
+	iset_insert_range(ctx->iova_alloc, page_block->iova, page_block->size);
+	if (page_block->num_free)
+		list_del(&page_block->next_block);
+
+	alloc->num_blocks--;
+	memmove(&alloc->blocks[idx], &alloc->blocks[idx + 1],
+		(alloc->num_blocks - idx) * sizeof(*alloc->blocks));
+
+	free(page_block->free_pages);
+	mlx5_vfio_free_block_mem(page_block);
 	free(page_block);
 }
 
-static int mlx5_vfio_alloc_page(struct mlx5_vfio_context *ctx, uint64_t *iova)
+/* Index of the block holding iova, num_blocks if there is none */
+static unsigned int mlx5_vfio_find_block(struct vfio_mem_allocator *alloc,
+					 uint64_t iova)
 {
+	unsigned int lo = 0, hi = alloc->num_blocks, mid;
 	struct page_block *page_block;
-	unsigned long pg;
-	int ret = 0;
 
-	pthread_mutex_lock(&ctx->mem_alloc.block_list_mutex);
-	while (true) {
-		list_for_each(&ctx->mem_alloc.block_list, page_block, next_block) {
-			pg = bitmap_find_first_bit(page_block->free_pages, 0,
-						   MLX5_VFIO_BLOCK_NUM_PAGES);
-			if (pg != MLX5_VFIO_BLOCK_NUM_PAGES) {
-				bitmap_clear_bit(page_block->free_pages, pg);
-				*iova = page_block->iova + pg * MLX5_ADAPTER_PAGE_SIZE;
-				goto end;
-			}
-		}
-		if (!mlx5_vfio_new_block(ctx)) {
-			ret = -1;
-			goto end;
-		}
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (alloc->blocks[mid]->iova <= iova)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
-end:
-	pthread_mutex_unlock(&ctx->mem_alloc.block_list_mutex);
-	return ret;
+
+	if (!lo)
+		return alloc->num_blocks;
+
+	page_block = alloc->blocks[lo - 1];
+	if (iova >= page_block->iova + page_block->size)
+		return alloc->num_blocks;
+
+	return lo - 1;
 }
 
-static void mlx5_vfio_free_page(struct mlx5_vfio_context *ctx, uint64_t iova)
+static void __mlx5_vfio_free_pages(struct mlx5_vfio_context *ctx,
+				   const void *pas, uint32_t npages)
 {
+	struct vfio_mem_allocator *alloc = &ctx->mem_alloc;
+	const __be64 *iovas = pas;
 	struct page_block *page_block;
+	unsigned int idx;
 	unsigned long pg;
+	uint64_t iova;
+	uint32_t i;
 
-	pthread_mutex_lock(&ctx->mem_alloc.block_list_mutex);
-	list_for_each(&ctx->mem_alloc.block_list, page_block, next_block) {
-		if (page_block->iova > iova ||
-		    (page_block->iova + MLX5_VFIO_BLOCK_SIZE <= iova))
+	for (i = 0; i < npages; i++) {
+		iova = be64toh(iovas[i]);
+		idx = mlx5_vfio_find_block(alloc, iova);
+		if (idx == alloc->num_blocks) {
+			assert(false);
 			continue;
+		}
 
+		page_block = alloc->blocks[idx];
 		pg = (iova - page_block->iova) / MLX5_ADAPTER_PAGE_SIZE;
 		assert(!bitmap_test_bit(page_block->free_pages, pg));
 		bitmap_set_bit(page_block->free_pages, pg);
-		if (bitmap_full(page_block->free_pages, MLX5_VFIO_BLOCK_NUM_PAGES))
-			mlx5_vfio_free_block(ctx, page_block);
-		goto end;
+		if (!page_block->num_free++)
+			list_add(&alloc->avail_list, &page_block->next_block);
+		if (page_block->num_free == page_block->num_pages)
+			mlx5_vfio_free_block(ctx, idx);
 	}
+}
 
-	assert(false);
-end:
+/* Free the npages pages whose big endian IOVAs are in pas */
+static void mlx5_vfio_free_pages(struct mlx5_vfio_context *ctx,
+				 const void *pas, uint32_t npages)
+{
+	pthread_mutex_lock(&ctx->mem_alloc.block_list_mutex);
+	__mlx5_vfio_free_pages(ctx, pas, npages);
 	pthread_mutex_unlock(&ctx->mem_alloc.block_list_mutex);
 }
 
+/* Allocate npages pages, their IOVAs are written to pas in big endian */
+static int mlx5_vfio_alloc_pages(struct mlx5_vfio_context *ctx,
+				 void *pas, uint32_t npages)
+{
+	struct vfio_mem_allocator *alloc = &ctx->mem_alloc;
+	__be64 *iovas = pas;
+	struct page_block *page_block;
+	unsigned long pg;
+	uint32_t i = 0;
+	int err;
+
+	pthread_mutex_lock(&alloc->block_list_mutex);
+	while (i < npages) {
+		page_block = list_top(&alloc->avail_list, struct page_block,
+				      next_block);
+		if (!page_block) {
+			page_block = mlx5_vfio_new_block(ctx, npages - i);
+			if (!page_block)
+				goto err;
+		}
+
+		for (pg = 0; page_block->num_free && i < npages; pg++) {
+			pg = bitmap_find_first_bit(page_block->free_pages, pg,
+						   page_block->num_pages);
+			bitmap_clear_bit(page_block->free_pages, pg);
+			page_block->num_free--;
+			iovas[i++] = htobe64(page_block->iova +
+					   pg * MLX5_ADAPTER_PAGE_SIZE);
+		}
+
+		if (!page_block->num_free)
+			list_del(&page_block->next_block);
+	}
+	pthread_mutex_unlock(&alloc->block_list_mutex);
+	return 0;
+
+err:
+	err = errno;
+	__mlx5_vfio_free_pages(ctx, pas, i);
+	pthread_mutex_unlock(&alloc->block_list_mutex);
+	errno = err;
+	return err;
+}
+
 static const char *cmd_status_str(uint8_t status)
 {
 	switch (status) {
@@ -377,13 +517,28 @@ static inline uint32_t mlx5_eq_update_cc(struct mlx5_eq *eq, uint32_t cc)
 	return cc;
 }
 
+/* Release a queued page command that never reached the device */
+static void mlx5_vfio_drop_page_cmd(struct mlx5_vfio_context *ctx,
+				    struct cmd_async_data *cmd_data)
+{
+	void *in = cmd_data->buff_in;
+
+	if (DEVX_GET(manage_pages_in, in, op_mod) == MLX5_PAGES_GIVE)
+		mlx5_vfio_free_pages(ctx, DEVX_ADDR_OF(manage_pages_in, in, pas),
+				     DEVX_GET(manage_pages_in, in,
+					      input_num_entries));
+	free(cmd_data->buff_in);
+	free(cmd_data->buff_out);
+	free(cmd_data);
+}
+
 static int mlx5_vfio_process_page_request_comp(struct mlx5_vfio_context *ctx,
 					       unsigned long slot)
 {
 	struct mlx5_vfio_cmd_slot *cmd_slot = &ctx->cmd.cmds[slot];
 	struct cmd_async_data *cmd_data = &cmd_slot->curr;
 	int num_claimed;
-	int ret, i;
+	int ret, err;
 
 	ret = mlx5_copy_from_msg(cmd_data->buff_out, &cmd_slot->out,
 				 cmd_data->olen, cmd_slot->lay);
@@ -404,30 +559,81 @@ static int mlx5_vfio_process_page_request_comp(struct mlx5_vfio_context *ctx,
 		goto end;
 	}
 
-	for (i = 0; i < num_claimed; i++)
-		mlx5_vfio_free_page(ctx, DEVX_GET64(manage_pages_out, cmd_data->buff_out, pas[i]));
+	mlx5_vfio_free_pages(ctx, DEVX_ADDR_OF(manage_pages_out,
+					       cmd_data->buff_out, pas),
+			     num_claimed);
 
 end:
 	free(cmd_data->buff_in);
 	free(cmd_data->buff_out);
-	cmd_slot->in_use = false;
-	if (!ret && cmd_slot->is_pending) {
-		cmd_data = &cmd_slot->pending;
 
-		pthread_mutex_lock(&cmd_slot->lock);
-		cmd_slot->is_pending = false;
-		ret = mlx5_vfio_post_cmd(ctx, cmd_data->buff_in, cmd_data->ilen,
-					 cmd_data->buff_out, cmd_data->olen, slot, true);
-		pthread_mutex_unlock(&cmd_slot->lock);
+	/* A failed command doesn't hold back the ones queued behind it */
+	pthread_mutex_lock(&cmd_slot->lock);
+	cmd_slot->in_use = false;
+	while ((cmd_data = list_pop(&cmd_slot->pending, struct cmd_async_data,
+				    entry))) {
+		err = mlx5_vfio_post_cmd(ctx, cmd_data->buff_in, cmd_data->ilen,
+					 cmd_data->buff_out, cmd_data->olen,
+					 slot, true);
+		if (err) {
+			mlx5_vfio_drop_page_cmd(ctx, cmd_data);
+			if (!ret)
+				ret = err;
+			continue;
+		}
+		free(cmd_data);
+		break;
 	}
+	pthread_mutex_unlock(&cmd_slot->lock);
 	return ret;
 }
 
+static void mlx5_vfio_put_cmd_slot(struct mlx5_vfio_context *ctx,
+				   unsigned int slot)
+{
+	struct mlx5_vfio_cmd *cmd = &ctx->cmd;
+	uint64_t u = 1;
+
+	pthread_mutex_lock(&cmd->slots_lock);
+	cmd->free_slots |= 1 << slot;
+	if (cmd->slot_waiters &&
+	    write(cmd->slot_free_fd, &u, sizeof(uint64_t)) != sizeof(uint64_t))
+		mlx5_err(ctx->dbg_fp, "%s, write failed, errno=%d\n",
+			 __func__, errno);
+	pthread_mutex_unlock(&cmd->slots_lock);
+}
+
+/* Completion of a command from mlx5_vfio_cmd_exec_async() */
+static void mlx5_vfio_async_cmd_comp(struct mlx5_vfio_context *ctx,
+				     unsigned long slot)
+{
+	struct mlx5_vfio_cmd_slot *cmd_slot = &ctx->cmd.cmds[slot];
+	struct cmd_async_data *cmd_data = &cmd_slot->curr;
+	vfio_cmd_async_comp async_comp = cmd_slot->async_comp;
+	void *comp_data = cmd_slot->async_comp_data;
+	void *out = cmd_data->buff_out;
+	int err;
+
+	err = mlx5_copy_from_msg(out, &cmd_slot->out, cmd_data->olen,
+				 cmd_slot->lay);
+	if (!err && DEVX_GET(mbox_out, out, status) != MLX5_CMD_STAT_OK)
+		err = EREMOTEIO;
+
+	cmd_slot->async_comp = NULL;
+	mlx5_vfio_put_cmd_slot(ctx, slot);
+	async_comp(ctx, err, out, comp_data);
+}
+
 static int mlx5_vfio_cmd_comp(struct mlx5_vfio_context *ctx, unsigned long slot)
 {
 	uint64_t u = 1;
 	ssize_t s;
 
+	if (ctx->cmd.cmds[slot].async_comp) {
+		mlx5_vfio_async_cmd_comp(ctx, slot);
+		return 0;
+	}
+
 	s = write(ctx->cmd.cmds[slot].completion_event_fd, &u,
 		  sizeof(uint64_t));
 	if (s != sizeof(uint64_t))
@@ -636,22 +842,23 @@ static int mlx5_vfio_post_cmd(struct mlx5_vfio_context *ctx, void *in,
 
 	/* Lock was taken by caller */
 	if (async && ctx->cmd.cmds[slot].in_use) {
-		struct cmd_async_data *pending = &ctx->cmd.cmds[slot].pending;
-
-		if (ctx->cmd.cmds[slot].is_pending) {
-			assert(false);
-			return EINVAL;
-		}
+		struct cmd_async_data *pending;
 
-		/* We might get another PAGE EVENT before previous CMD was completed.
-		 * Save the new work and once get the CMD completion go and do the job.
+		/* We might get more PAGE EVENTs, or chunks of one, before the
+		 * previous CMD was completed. Queue the new work and post it
+		 * from the CMD completion.
 		 */
+		pending = calloc(1, sizeof(*pending));
+		if (!pending) {
+			errno = ENOMEM;
+			return errno;
+		}
 		pending->buff_in = in;
 		pending->buff_out = out;
 		pending->ilen = ilen;
 		pending->olen = olen;
 
-		ctx->cmd.cmds[slot].is_pending = true;
+		list_add_tail(&ctx->cmd.cmds[slot].pending, &pending->entry);
 		return 0;
 	}
 
@@ -678,19 +885,85 @@ static int mlx5_vfio_post_cmd(struct mlx5_vfio_context *ctx, void *in,
 	return 0;
 }
 
-static int mlx5_vfio_cmd_do(struct mlx5_vfio_context *ctx, void *in,
-			       int ilen, void *out, int olen,
-			       unsigned int slot)
+/*
+ * Take a general command slot for the caller, waiting if all are busy or
+ * failing with EAGAIN if !wait.  Lower slots are handed out first, so the
+ * mailboxes of a slot are set up only once that many commands were in
+ * flight together.
+ */
+static int mlx5_vfio_get_cmd_slot(struct mlx5_vfio_context *ctx,
+				  unsigned int *slot, bool wait)
+{
+	struct mlx5_vfio_cmd *cmd = &ctx->cmd;
+	struct pollfd fds[2] = {
+		{ .fd = cmd->slot_free_fd, .events = POLLIN },
+		{ .fd = ctx->cmd_comp_fd, .events = POLLIN }
+		};
+	uint64_t u;
+	ssize_t s;
+	int err;
+
+	pthread_mutex_lock(&cmd->slots_lock);
+	while (!cmd->free_slots) {
+		if (!wait) {
+			pthread_mutex_unlock(&cmd->slots_lock);
+			return EAGAIN;
+		}
+
+		cmd->slot_waiters++;
+		pthread_mutex_unlock(&cmd->slots_lock);
+
+		/*
+		 * The slots of async commands are freed as their completions
+		 * are processed, which may be up to us.
+		 */
+		err = poll(fds, ctx->have_eq ? 2 : 1, -1);
+		if (err < 0 && errno != EINTR) {
+			err = errno;
+			mlx5_err(ctx->dbg_fp, "%s, poll failed, errno=%d\n",
+				 __func__, err);
+			pthread_mutex_lock(&cmd->slots_lock);
+			cmd->slot_waiters--;
+			pthread_mutex_unlock(&cmd->slots_lock);
+			return err;
+		}
+		if (fds[0].revents & POLLIN) {
+			s = read(fds[0].fd, &u, sizeof(uint64_t));
+			if (s < 0 && errno != EAGAIN)
+				mlx5_err(ctx->dbg_fp, "%s, read failed, errno=%d\n",
+					 __func__, errno);
+		}
+		if (ctx->have_eq && (fds[1].revents & POLLIN))
+			mlx5dv_vfio_process_events(&ctx->vctx.context);
+
+		pthread_mutex_lock(&cmd->slots_lock);
+		cmd->slot_waiters--;
+	}
+
+	*slot = ffs(cmd->free_slots) - 1;
+	cmd->free_slots &= ~(1 << *slot);
+	pthread_mutex_unlock(&cmd->slots_lock);
+
+	if (cmd->cmds[*slot].lay)
+		return 0;
+
+	if (mlx5_vfio_setup_cmd_slot(ctx, *slot)) {
+		err = errno ? errno : ENOMEM;
+		mlx5_vfio_put_cmd_slot(ctx, *slot);
+		return err;
+	}
+
+	return 0;
+}
+
+/* Wait for the command posted on slot and release the slot */
+static int mlx5_vfio_cmd_wait(struct mlx5_vfio_context *ctx,
+			      unsigned int slot, void *out, int olen)
 {
 	struct mlx5_cmd_layout *cmd_lay = ctx->cmd.cmds[slot].lay;
 	struct mlx5_cmd_msg *cmd_out = &ctx->cmd.cmds[slot].out;
 	int err;
 
-	pthread_mutex_lock(&ctx->cmd.cmds[slot].lock);
-	err = mlx5_vfio_post_cmd(ctx, in, ilen, out, olen, slot, false);
-	if (err)
-		goto end;
-
 	if (ctx->have_eq) {
 		err = mlx5_vfio_wait_event(ctx, slot);
 		if (err)
@@ -710,23 +983,80 @@ static int mlx5_vfio_cmd_do(struct mlx5_vfio_context *ctx, void *in,
 		err = EREMOTEIO;
 
 end:
-	pthread_mutex_unlock(&ctx->cmd.cmds[slot].lock);
+	mlx5_vfio_put_cmd_slot(ctx, slot);
 	return err;
 }
 
+static int mlx5_vfio_cmd_do(struct mlx5_vfio_context *ctx, void *in,
+			       int ilen, void *out, int olen)
+{
+	unsigned int slot;
+	int err;
+
+	err = mlx5_vfio_get_cmd_slot(ctx, &slot, true);
+	if (err)
+		return err;
+
+	err = mlx5_vfio_post_cmd(ctx, in, ilen, out, olen, slot, false);
+	if (err) {
+		mlx5_vfio_put_cmd_slot(ctx, slot);
+		return err;
+	}
+
+	return mlx5_vfio_cmd_wait(ctx, slot, out, olen);
+}
+
 static int mlx5_vfio_cmd_exec(struct mlx5_vfio_context *ctx, void *in,
-			       int ilen, void *out, int olen,
-			       unsigned int slot)
+			       int ilen, void *out, int olen)
 {
 	int err;
 
-	err = mlx5_vfio_cmd_do(ctx, in, ilen, out, olen, slot);
+	err = mlx5_vfio_cmd_do(ctx, in, ilen, out, olen);
 	if (err != EREMOTEIO)
 		return err;
 
 	return mlx5_vfio_cmd_check(ctx, in, out);
 }
 
+/*
+ * Post a command and return without waiting for it.  async_comp is called
+ * with the output and the mlx5_vfio_cmd_do() result once the command EQE is
+ * processed, by whichever thread processes it and under eq_lock, so it must
+ * not execute commands itself.  in may be released on return, out must
+ * stay valid until the completion.
+ */
+static int mlx5_vfio_cmd_exec_async(struct mlx5_vfio_context *ctx, void *in,
+				    int ilen, void *out, int olen,
+				    vfio_cmd_async_comp async_comp,
+				    void *comp_data)
+{
+	struct mlx5_vfio_cmd_slot *cmd_slot;
+	unsigned int slot;
+	int err;
+
+	/* Nothing would process the completion */
+	if (!ctx->have_eq)
+		return EOPNOTSUPP;
+
+	err = mlx5_vfio_get_cmd_slot(ctx, &slot, true);
+	if (err)
+		return err;
+
+	cmd_slot = &ctx->cmd.cmds[slot];
+	cmd_slot->curr.buff_out = out;
+	cmd_slot->curr.olen = olen;
+	cmd_slot->async_comp_data = comp_data;
+	cmd_slot->async_comp = async_comp;
+
+	err = mlx5_vfio_post_cmd(ctx, in, ilen, out, olen, slot, false);
+	if (err) {
+		cmd_slot->async_comp = NULL;
+		mlx5_vfio_put_cmd_slot(ctx, slot);
+	}
+
+	return err;
+}
+
 static int mlx5_vfio_enable_pci_cmd(struct mlx5_vfio_context *ctx)
 {
 	struct vfio_region_info pci_config_reg = {};
@@ -858,6 +1188,14 @@ err_alloc:
 static void mlx5_vfio_free_cmd_slot(struct mlx5_vfio_context *ctx, int slot)
 {
 	struct mlx5_vfio_cmd_slot *cmd_slot = &ctx->cmd.cmds[slot];
+	struct cmd_async_data *pending;
+
+	while ((pending = list_pop(&cmd_slot->pending, struct cmd_async_data,
+				   entry))) {
+		free(pending->buff_in);
+		free(pending->buff_out);
+		free(pending);
+	}
 
 	mlx5_vfio_free_cmd_msg(ctx, &cmd_slot->in);
 	mlx5_vfio_free_cmd_msg(ctx, &cmd_slot->out);
@@ -871,6 +1209,7 @@ static int mlx5_vfio_setup_cmd_slot(struct mlx5_vfio_context *ctx, int slot)
 	struct mlx5_cmd_layout *cmd_lay;
 	int ret;
 
+	list_head_init(&cmd_slot->pending);
 	ret = mlx5_vfio_alloc_cmd_msg(ctx, 4096, &cmd_slot->in);
 	if (ret)
 		return ret;
@@ -935,12 +1274,22 @@ static int mlx5_vfio_init_cmd_interface(struct mlx5_vfio_context *ctx)
 		return -1;
 	}
 
+	/* The last slot is kept for the page request events */
+	cmd->free_slots = (1ULL << min(1 << cmd->log_sz,
+				       MLX5_MAX_COMMANDS - 1)) - 1;
+	cmd->slot_free_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK |
+				    EFD_SEMAPHORE);
+	if (cmd->slot_free_fd < 0)
+		return -1;
+
+	pthread_mutex_init(&cmd->slots_lock, NULL);
+
 	/* The initial address must be 4K aligned */
 	ret = posix_memalign(&cmd->vaddr, MLX5_ADAPTER_PAGE_SIZE,
 			     MLX5_ADAPTER_PAGE_SIZE);
 	if (ret) {
 		errno = ret;
-		return -1;
+		goto err_fd;
 	}
 
 	memset(cmd->vaddr, 0, MLX5_ADAPTER_PAGE_SIZE);
@@ -983,18 +1332,24 @@ err_reg:
 	iset_insert_range(ctx->iova_alloc, cmd->iova, MLX5_ADAPTER_PAGE_SIZE);
 err_free:
 	free(cmd->vaddr);
+err_fd:
+	close(cmd->slot_free_fd);
 	return ret;
 }
 
 static void mlx5_vfio_clean_cmd_interface(struct mlx5_vfio_context *ctx)
 {
 	struct mlx5_vfio_cmd *cmd = &ctx->cmd;
+	int slot;
 
-	mlx5_vfio_free_cmd_slot(ctx, 0);
-	mlx5_vfio_free_cmd_slot(ctx, MLX5_MAX_COMMANDS - 1);
+	/* Slots other than 0 and the page request one are set up on use */
+	for (slot = 0; slot < MLX5_MAX_COMMANDS; slot++)
+		if (cmd->cmds[slot].lay)
+			mlx5_vfio_free_cmd_slot(ctx, slot);
 	mlx5_vfio_unregister_mem(ctx, cmd->iova, MLX5_ADAPTER_PAGE_SIZE);
 	iset_insert_range(ctx->iova_alloc, cmd->iova, MLX5_ADAPTER_PAGE_SIZE);
 	free(cmd->vaddr);
+	close(cmd->slot_free_fd);
 }
 
 static void set_iova_min_page_size(struct mlx5_vfio_context *ctx,
@@ -1095,11 +1450,11 @@ end:
 
 static void mlx5_vfio_clean_device_dma(struct mlx5_vfio_context *ctx)
 {
-	struct page_block *page_block, *tmp;
+	struct vfio_mem_allocator *alloc = &ctx->mem_alloc;
 
-	list_for_each_safe(&ctx->mem_alloc.block_list, page_block,
-			   tmp, next_block)
-		mlx5_vfio_free_block(ctx, page_block);
+	while (alloc->num_blocks)
+		mlx5_vfio_free_block(ctx, alloc->num_blocks - 1);
+	free(alloc->blocks);
 
 	iset_destroy(ctx->iova_alloc);
 }
@@ -1110,18 +1465,19 @@ static int mlx5_vfio_init_device_dma(struct mlx5_vfio_context *ctx)
 	if (!ctx->iova_alloc)
 		return -1;
 
-	list_head_init(&ctx->mem_alloc.block_list);
+	list_head_init(&ctx->mem_alloc.avail_list);
 	pthread_mutex_init(&ctx->mem_alloc.block_list_mutex, NULL);
 
 	if (mlx5_vfio_get_iommu_info(ctx))
 		goto err;
 
 	/* create an initial block of DMA memory ready to be used */
-	if (!mlx5_vfio_new_block(ctx))
+	if (!mlx5_vfio_new_block(ctx, 0))
 		goto err;
 
 	return 0;
 err:
+	free(ctx->mem_alloc.blocks);
 	iset_destroy(ctx->iova_alloc);
 	return -1;
 }
@@ -1327,7 +1683,7 @@ static int mlx5_vfio_alloc_uar(struct mlx5_vfio_context *ctx, uint32_t *uarn)
 	int err;
 
 	DEVX_SET(alloc_uar_in, in, opcode, MLX5_CMD_OP_ALLOC_UAR);
-	err = mlx5_vfio_cmd_exec(ctx, in, sizeof(in), out, sizeof(out), 0);
+	err = mlx5_vfio_cmd_exec(ctx, in, sizeof(in), out, sizeof(out));
 	if (!err)
 		*uarn = DEVX_GET(alloc_uar_out, out, uar);
 
@@ -1341,7 +1697,7 @@ static void mlx5_vfio_dealloc_uar(struct mlx5_vfio_context *ctx, uint32_t uarn)
 
 	DEVX_SET(dealloc_uar_in, in, opcode, MLX5_CMD_OP_DEALLOC_UAR);
 	DEVX_SET(dealloc_uar_in, in, uar, uarn);
-	mlx5_vfio_cmd_exec(ctx, in, sizeof(in), out, sizeof(out), 0);
+	mlx5_vfio_cmd_exec(ctx, in, sizeof(in), out, sizeof(out));
 }
 
 static void mlx5_vfio_destroy_eq(struct mlx5_vfio_context *ctx, struct mlx5_eq *eq)
@@ -1352,7 +1708,7 @@ static void mlx5_vfio_destroy_eq(struct mlx5_vfio_context *ctx, struct mlx5_eq *
 	DEVX_SET(destroy_eq_in, in, opcode, MLX5_CMD_OP_DESTROY_EQ);
 	DEVX_SET(destroy_eq_in, in, eq_number, eq->eqn);
 
-	mlx5_vfio_cmd_exec(ctx, in, sizeof(in), out, sizeof(out), 0);
+	mlx5_vfio_cmd_exec(ctx, in, sizeof(in), out, sizeof(out));
 	mlx5_vfio_unregister_mem(ctx, eq->iova, eq->iova_size);
 	iset_insert_range(ctx->iova_alloc, eq->iova, eq->iova_size);
 	free(eq->vaddr);
@@ -1422,7 +1778,7 @@ create_map_eq(struct mlx5_vfio_context *ctx, struct mlx5_eq *eq,
 	DEVX_SET(eqc, eqc, intr, vecidx);
 	DEVX_SET(eqc, eqc, log_page_size, ilog32(eq->iova_size - 1) - MLX5_ADAPTER_PAGE_SHIFT);
 
-	err = mlx5_vfio_cmd_exec(ctx, in, inlen, out, sizeof(out), 0);
+	err = mlx5_vfio_cmd_exec(ctx, in, inlen, out, sizeof(out));
 	if (err)
 		goto err_cmd;
 
@@ -1488,8 +1844,16 @@ err:
 	return err;
 }
 
-static int mlx5_vfio_reclaim_pages(struct mlx5_vfio_context *ctx, uint32_t func_id,
-				   int npages)
+enum {
+	/* Pages given or reclaimed by one MANAGE_PAGES, 128 mailboxes of PAS */
+	MLX5_VFIO_GIVE_PAGES_CHUNK = 128 * MLX5_CMD_DATA_BLOCK_SIZE /
+				     sizeof(uint64_t),
+	/* Startup MANAGE_PAGES commands in flight */
+	MLX5_VFIO_GIVE_PAGES_DEPTH = 4,
+};
+
+static int mlx5_vfio_post_reclaim_chunk(struct mlx5_vfio_context *ctx,
+					uint32_t func_id, int npages)
 {
 	uint32_t inlen = DEVX_ST_SZ_BYTES(manage_pages_in);
 	int outlen;
@@ -1531,13 +1895,34 @@ out_free:
 	return err;
 }
 
+/*
+ * Reclaim the pages in chunks queued on the page slot. The slot keeps the
+ * mailboxes of its largest command, so a single command for all the pages
+ * would map one per 64 pages and keep them.
+ */
+static int mlx5_vfio_reclaim_pages(struct mlx5_vfio_context *ctx, uint32_t func_id,
+				   int npages)
+{
+	int err, n;
+
+	while (npages > 0) {
+		n = min_t(int, npages, MLX5_VFIO_GIVE_PAGES_CHUNK);
+		err = mlx5_vfio_post_reclaim_chunk(ctx, func_id, n);
+		if (err)
+			return err;
+		npages -= n;
+	}
+
+	return 0;
+}
+
 static int mlx5_vfio_enable_hca(struct mlx5_vfio_context *ctx)
 {
 	uint32_t in[DEVX_ST_SZ_DW(enable_hca_in)] = {};
 	uint32_t out[DEVX_ST_SZ_DW(enable_hca_out)] = {};
 
 	DEVX_SET(enable_hca_in, in, opcode, MLX5_CMD_OP_ENABLE_HCA);
-	return mlx5_vfio_cmd_exec(ctx, in, sizeof(in), out, sizeof(out), 0);
+	return mlx5_vfio_cmd_exec(ctx, in, sizeof(in), out, sizeof(out));
 }
 
 static int mlx5_vfio_set_issi(struct mlx5_vfio_context *ctx)
@@ -1551,7 +1936,7 @@ static int mlx5_vfio_set_issi(struct mlx5_vfio_context *ctx)
 
 	DEVX_SET(query_issi_in, query_in, opcode, MLX5_CMD_OP_QUERY_ISSI);
 	err = mlx5_vfio_cmd_exec(ctx, query_in, sizeof(query_in), query_out,
-				 sizeof(query_out), 0);
+				 sizeof(query_out));
 	if (err)
 		return err;
 
@@ -1565,21 +1950,124 @@ static int mlx5_vfio_set_issi(struct mlx5_vfio_context *ctx)
 	DEVX_SET(set_issi_in, set_in, opcode, MLX5_CMD_OP_SET_ISSI);
 	DEVX_SET(set_issi_in, set_in, current_issi, 1);
 	return mlx5_vfio_cmd_exec(ctx, set_in, sizeof(set_in), set_out,
-				  sizeof(set_out), 0);
+				  sizeof(set_out));
 }
 
-static int mlx5_vfio_give_pages(struct mlx5_vfio_context *ctx,
-				uint16_t func_id,
-				int32_t npages,
-				bool is_event)
+struct mlx5_vfio_give_chunk {
+	unsigned int slot;
+	void *in;
+	int inlen;
+	uint32_t out[DEVX_ST_SZ_DW(manage_pages_out)];
+};
+
+/* Allocate the pages of a chunk and post it on its slot */
+static int mlx5_vfio_post_give_chunk(struct mlx5_vfio_context *ctx,
+				     struct mlx5_vfio_give_chunk *chunk,
+				     uint16_t func_id, int32_t npages)
 {
-	int32_t out[DEVX_ST_SZ_DW(manage_pages_out)] = {};
+	int err;
+
+	chunk->inlen = DEVX_ST_SZ_BYTES(manage_pages_in) +
+		       npages * DEVX_FLD_SZ_BYTES(manage_pages_in, pas[0]);
+	chunk->in = calloc(1, chunk->inlen);
+	if (!chunk->in) {
+		errno = ENOMEM;
+		return errno;
+	}
+
+	err = mlx5_vfio_alloc_pages(ctx, DEVX_ADDR_OF(manage_pages_in,
+						      chunk->in, pas),
+				    npages);
+	if (err)
+		goto err_in;
+
+	DEVX_SET(manage_pages_in, chunk->in, opcode, MLX5_CMD_OP_MANAGE_PAGES);
+	DEVX_SET(manage_pages_in, chunk->in, op_mod, MLX5_PAGES_GIVE);
+	DEVX_SET(manage_pages_in, chunk->in, function_id, func_id);
+	DEVX_SET(manage_pages_in, chunk->in, input_num_entries, npages);
+
+	err = mlx5_vfio_post_cmd(ctx, chunk->in, chunk->inlen, chunk->out,
+				 sizeof(chunk->out), chunk->slot, false);
+	if (!err)
+		return 0;
+
+	mlx5_vfio_free_pages(ctx, DEVX_ADDR_OF(manage_pages_in, chunk->in, pas),
+			     npages);
+err_in:
+	free(chunk->in);
+	return err;
+}
+
+/*
+ * Give the startup pages in chunks on the general slots, a few in flight.
+ * A slot keeps the mailboxes of its largest command, so a single command
+ * for all the pages would map one per 64 pages and keep them.
+ */
+static int mlx5_vfio_give_startup_pages(struct mlx5_vfio_context *ctx,
+					uint16_t func_id, int32_t npages)
+{
+	struct mlx5_vfio_give_chunk chunks[MLX5_VFIO_GIVE_PAGES_DEPTH];
+	struct mlx5_vfio_give_chunk *chunk;
+	unsigned int head = 0, tail = 0;
+	int32_t given = 0, n;
+	int err = 0, ret;
+
+	while (true) {
+		while (!err && given < npages &&
+		       head - tail < MLX5_VFIO_GIVE_PAGES_DEPTH) {
+			chunk = &chunks[head % MLX5_VFIO_GIVE_PAGES_DEPTH];
+			ret = mlx5_vfio_get_cmd_slot(ctx, &chunk->slot,
+						     head == tail);
+			if (ret == EAGAIN)
+				break;
+
+			n = min_t(int32_t, npages - given,
+				  MLX5_VFIO_GIVE_PAGES_CHUNK);
+			if (!ret) {
+				ret = mlx5_vfio_post_give_chunk(ctx, chunk,
+								func_id, n);
+				if (ret)
+					mlx5_vfio_put_cmd_slot(ctx, chunk->slot);
+			}
+			if (ret) {
+				err = ret;
+				break;
+			}
+
+			given += n;
+			head++;
+		}
+
+		if (head == tail)
+			return err;
+
+		chunk = &chunks[tail++ % MLX5_VFIO_GIVE_PAGES_DEPTH];
+		ret = mlx5_vfio_cmd_wait(ctx, chunk->slot, chunk->out,
+					 sizeof(chunk->out));
+		if (ret == EREMOTEIO)
+			ret = mlx5_vfio_cmd_check(ctx, chunk->in, chunk->out);
+		if (ret) {
+			mlx5_vfio_free_pages(ctx,
+					     DEVX_ADDR_OF(manage_pages_in,
+							  chunk->in, pas),
+					     DEVX_GET(manage_pages_in, chunk->in,
+						      input_num_entries));
+			if (!err)
+				err = ret;
+		}
+		free(chunk->in);
+	}
+}
+
+static int mlx5_vfio_post_give_event_chunk(struct mlx5_vfio_context *ctx,
+					    uint16_t func_id, int32_t npages)
+{
+	int outlen = DEVX_ST_SZ_BYTES(manage_pages_out);
 	int inlen = DEVX_ST_SZ_BYTES(manage_pages_in);
 	int slot = MLX5_MAX_COMMANDS - 1;
-	void *outp = out;
-	int i, err;
 	int32_t *in;
-	uint64_t iova;
+	void *out;
+	int err;
 
 	inlen += npages * DEVX_FLD_SZ_BYTES(manage_pages_in, pas[0]);
 	in = calloc(1, inlen);
@@ -1588,51 +2076,61 @@ static int mlx5_vfio_give_pages(struct mlx5_vfio_context *ctx,
 		return errno;
 	}
 
-	if (is_event) {
-		outp = calloc(1, sizeof(out));
-		if (!outp) {
-			errno = ENOMEM;
-			err = errno;
-			goto end;
-		}
+	out = calloc(1, outlen);
+	if (!out) {
+		errno = ENOMEM;
+		err = errno;
+		goto end;
 	}
 
-	for (i = 0; i < npages; i++) {
-		err = mlx5_vfio_alloc_page(ctx, &iova);
-		if (err)
-			goto err;
-
-		DEVX_ARRAY_SET64(manage_pages_in, in, pas, i, iova);
-	}
+	err = mlx5_vfio_alloc_pages(ctx, DEVX_ADDR_OF(manage_pages_in, in, pas),
+				    npages);
+	if (err)
+		goto err;
 
 	DEVX_SET(manage_pages_in, in, opcode, MLX5_CMD_OP_MANAGE_PAGES);
 	DEVX_SET(manage_pages_in, in, op_mod, MLX5_PAGES_GIVE);
 	DEVX_SET(manage_pages_in, in, function_id, func_id);
 	DEVX_SET(manage_pages_in, in, input_num_entries, npages);
 
-	if (is_event) {
-		pthread_mutex_lock(&ctx->cmd.cmds[slot].lock);
-		err = mlx5_vfio_post_cmd(ctx, in, inlen, outp, sizeof(out), slot, true);
-		pthread_mutex_unlock(&ctx->cmd.cmds[slot].lock);
-	} else {
-		err = mlx5_vfio_cmd_exec(ctx, in, inlen, outp, sizeof(out), slot);
-	}
+	pthread_mutex_lock(&ctx->cmd.cmds[slot].lock);
+	err = mlx5_vfio_post_cmd(ctx, in, inlen, out, outlen, slot, true);
+	pthread_mutex_unlock(&ctx->cmd.cmds[slot].lock);
+	if (!err)
+		return 0;
 
-	if (!err) {
-		if (is_event)
-			return 0;
-		goto end;
-	}
+	mlx5_vfio_free_pages(ctx, DEVX_ADDR_OF(manage_pages_in, in, pas),
+			     npages);
 err:
-	if (is_event)
-		free(outp);
-	for (i--; i >= 0; i--)
-		mlx5_vfio_free_page(ctx, DEVX_GET64(manage_pages_in, in, pas[i]));
+	free(out);
 end:
 	free(in);
 	return err;
 }
 
+/* The pages of an event are given in chunks queued on the page slot */
+static int mlx5_vfio_give_pages(struct mlx5_vfio_context *ctx,
+				uint16_t func_id,
+				int32_t npages,
+				bool is_event)
+{
+	int32_t n;
+	int err;
+
+	if (!is_event)
+		return mlx5_vfio_give_startup_pages(ctx, func_id, npages);
+
+	while (npages > 0) {
+		n = min_t(int32_t, npages, MLX5_VFIO_GIVE_PAGES_CHUNK);
+		err = mlx5_vfio_post_give_event_chunk(ctx, func_id, n);
+		if (err)
+			return err;
+		npages -= n;
+	}
+
+	return 0;
+}
+
 static int mlx5_vfio_query_pages(struct mlx5_vfio_context *ctx, int boot,
 				 uint16_t *func_id, int32_t *npages)
 {
@@ -1644,7 +2142,7 @@ static int mlx5_vfio_query_pages(struct mlx5_vfio_context *ctx, int boot,
 	DEVX_SET(query_pages_in, query_pages_in, op_mod, boot ? 0x01 : 0x02);
 
 	ret = mlx5_vfio_cmd_exec(ctx, query_pages_in, sizeof(query_pages_in),
-				 query_pages_out, sizeof(query_pages_out), 0);
+				 query_pages_out, sizeof(query_pages_out));
 	if (ret)
 		return ret;
 
@@ -1694,7 +2192,7 @@ static int mlx5_vfio_access_reg(struct mlx5_vfio_context *ctx, void *data_in,
 	DEVX_SET(access_register_in, in, argument, arg);
 	DEVX_SET(access_register_in, in, register_id, reg_id);
 
-	err = mlx5_vfio_cmd_exec(ctx, in, inlen, out, outlen, 0);
+	err = mlx5_vfio_cmd_exec(ctx, in, inlen, out, outlen);
 	if (err)
 		goto out;
 
@@ -1725,7 +2223,7 @@ static int mlx5_vfio_get_caps_mode(struct mlx5_vfio_context *ctx,
 
 	DEVX_SET(query_hca_cap_in, in, opcode, MLX5_CMD_OP_QUERY_HCA_CAP);
 	DEVX_SET(query_hca_cap_in, in, op_mod, opmod);
-	err = mlx5_vfio_cmd_exec(ctx, in, sizeof(in), out, out_sz, 0);
+	err = mlx5_vfio_cmd_exec(ctx, in, sizeof(in), out, out_sz);
 	if (err)
 		goto query_ex;
 
@@ -1776,7 +2274,7 @@ static int mlx5_vfio_nic_vport_update_roce_state(struct mlx5_vfio_context *ctx,
 	DEVX_SET(modify_nic_vport_context_in, in, opcode,
 		 MLX5_CMD_OP_MODIFY_NIC_VPORT_CONTEXT);
 
-	err = mlx5_vfio_cmd_exec(ctx, in, inlen, out, sizeof(out), 0);
+	err = mlx5_vfio_cmd_exec(ctx, in, inlen, out, sizeof(out));
 
 	free(in);
 
@@ -1818,7 +2316,7 @@ static int handle_hca_cap_roce(struct mlx5_vfio_context *ctx, void *set_ctx,
 	DEVX_SET(roce_cap, set_hca_cap, sw_r_roce_src_udp_port, 1);
 	DEVX_SET(set_hca_cap_in, set_ctx, opcode, MLX5_CMD_OP_SET_HCA_CAP);
 	DEVX_SET(set_hca_cap_in, set_ctx, op_mod, MLX5_SET_HCA_CAP_OP_MOD_ROCE);
-	return mlx5_vfio_cmd_exec(ctx, set_ctx, ctx_size, out, sizeof(out), 0);
+	return mlx5_vfio_cmd_exec(ctx, set_ctx, ctx_size, out, sizeof(out));
 }
 
 static int handle_hca_cap(struct mlx5_vfio_context *ctx, void *set_ctx, int set_sz)
@@ -1852,7 +2350,7 @@ static int handle_hca_cap(struct mlx5_vfio_context *ctx, void *set_ctx, int set_
 	DEVX_SET(set_hca_cap_in, set_ctx, opcode, MLX5_CMD_OP_SET_HCA_CAP);
 	DEVX_SET(set_hca_cap_in, set_ctx, op_mod, MLX5_SET_HCA_CAP_OP_MOD_GENERAL_DEVICE);
 
-	return mlx5_vfio_cmd_exec(ctx, set_ctx, set_sz, out, sizeof(out), 0);
+	return mlx5_vfio_cmd_exec(ctx, set_ctx, set_sz, out, sizeof(out));
 }
 
 static int set_hca_cap(struct mlx5_vfio_context *ctx)
@@ -1895,7 +2393,7 @@ static int mlx5_vfio_init_hca(struct mlx5_vfio_context *ctx)
 	uint32_t out[DEVX_ST_SZ_DW(init_hca_out)] = {};
 
 	DEVX_SET(init_hca_in, in, opcode, MLX5_CMD_OP_INIT_HCA);
-	return mlx5_vfio_cmd_exec(ctx, in, sizeof(in), out, sizeof(out), 0);
+	return mlx5_vfio_cmd_exec(ctx, in, sizeof(in), out, sizeof(out));
 }
 
 static int fw_initializing(struct mlx5_init_seg *init_seg)
@@ -1927,7 +2425,7 @@ static int mlx5_vfio_teardown_hca_regular(struct mlx5_vfio_context *ctx)
 
 	DEVX_SET(teardown_hca_in, in, opcode, MLX5_CMD_OP_TEARDOWN_HCA);
 	DEVX_SET(teardown_hca_in, in, profile, MLX5_TEARDOWN_HCA_IN_PROFILE_GRACEFUL_CLOSE);
-	return mlx5_vfio_cmd_exec(ctx, in, sizeof(in), out, sizeof(out), 0);
+	return mlx5_vfio_cmd_exec(ctx, in, sizeof(in), out, sizeof(out));
 }
 
 enum mlx5_cmd_addr_l_sz_offset {
@@ -1965,7 +2463,7 @@ static int mlx5_vfio_teardown_hca_fast(struct mlx5_vfio_context *ctx)
 	DEVX_SET(teardown_hca_in, in, opcode, MLX5_CMD_OP_TEARDOWN_HCA);
 	DEVX_SET(teardown_hca_in, in, profile,
 		 MLX5_TEARDOWN_HCA_IN_PROFILE_PREPARE_FAST_TEARDOWN);
-	ret = mlx5_vfio_cmd_exec(ctx, in, sizeof(in), out, sizeof(out), 0);
+	ret = mlx5_vfio_cmd_exec(ctx, in, sizeof(in), out, sizeof(out));
 	if (ret)
 		return ret;
 
@@ -2228,7 +2726,7 @@ static struct ibv_pd *mlx5_vfio_alloc_pd(struct ibv_context *ibctx)
 		return NULL;
 
 	DEVX_SET(alloc_pd_in, in, opcode, MLX5_CMD_OP_ALLOC_PD);
-	err = mlx5_vfio_cmd_exec(ctx, in, sizeof(in), out, sizeof(out), 0);
+	err = mlx5_vfio_cmd_exec(ctx, in, sizeof(in), out, sizeof(out));
 
 	if (err)
 		goto err;
@@ -2252,7 +2750,7 @@ static int mlx5_vfio_dealloc_pd(struct ibv_pd *pd)
 	DEVX_SET(dealloc_pd_in, in, opcode, MLX5_CMD_OP_DEALLOC_PD);
 	DEVX_SET(dealloc_pd_in, in, pd, mpd->pdn);
 
-	ret = mlx5_vfio_cmd_exec(ctx, in, sizeof(in), out, sizeof(out), 0);
+	ret = mlx5_vfio_cmd_exec(ctx, in, sizeof(in), out, sizeof(out));
 	if (ret)
 		return ret;
 
@@ -2318,7 +2816,7 @@ static int mlx5_vfio_dereg_mr(struct verbs_mr *vmr)
 
 	DEVX_SET(destroy_mkey_in, in, opcode, MLX5_CMD_OP_DESTROY_MKEY);
 	DEVX_SET(destroy_mkey_in, in, mkey_index, mlx5_mkey_to_idx(vmr->ibv_mr.lkey));
-	ret = mlx5_vfio_cmd_exec(ctx, in, sizeof(in), out, sizeof(out), 0);
+	ret = mlx5_vfio_cmd_exec(ctx, in, sizeof(in), out, sizeof(out));
 	if (ret)
 		return ret;
 
@@ -2449,7 +2947,7 @@ static struct ibv_mr *mlx5_vfio_reg_mr(struct ibv_pd *pd, void *addr, size_t len
 	key = atomic_fetch_add(&dev->mkey_var, 1);
 	DEVX_SET(mkc, mkc, mkey_7_0, key);
 
-	ret = mlx5_vfio_cmd_exec(ctx, in, inlen, out, sizeof(out), 0);
+	ret = mlx5_vfio_cmd_exec(ctx, in, inlen, out, sizeof(out));
 	if (ret)
 		goto err_exec;
 
@@ -2610,7 +3108,7 @@ _vfio_devx_umem_reg(struct ibv_context *context,
 	mlx5_vfio_populate_pas(vfio_umem->iova, num_pas, (1ULL << iova_page_shift), mtt,
 			       (writeable ? MLX5_MTT_WRITE : 0) | MLX5_MTT_READ);
 
-	ret = mlx5_vfio_cmd_exec(ctx, in, inlen, out, sizeof(out), 0);
+	ret = mlx5_vfio_cmd_exec(ctx, in, inlen, out, sizeof(out));
 	if (ret)
 		goto err_exec;
 
@@ -2666,7 +3164,7 @@ static int vfio_devx_umem_dereg(struct mlx5dv_devx_umem *dv_devx_umem)
 	DEVX_SET(destroy_umem_in, in, opcode, MLX5_CMD_OP_DESTROY_UMEM);
 	DEVX_SET(destroy_umem_in, in, umem_id, dv_devx_umem->umem_id);
 
-	ret = mlx5_vfio_cmd_exec(ctx, in, sizeof(in), out, sizeof(out), 0);
+	ret = mlx5_vfio_cmd_exec(ctx, in, sizeof(in), out, sizeof(out));
 	if (ret)
 		return ret;
 
@@ -2696,7 +3194,7 @@ static int vfio_devx_general_cmd(struct ibv_context *context, const void *in,
 {
 	struct mlx5_vfio_context *ctx = to_mvfio_ctx(context);
 
-	return mlx5_vfio_cmd_do(ctx, (void *)in, inlen, out, outlen, 0);
+	return mlx5_vfio_cmd_do(ctx, (void *)in, inlen, out, outlen);
 }
 
 static bool devx_is_obj_create_cmd(const void *in)
@@ -3050,7 +3548,7 @@ vfio_devx_obj_create(struct ibv_context *context, const void *in,
 		return NULL;
 	}
 
-	ret = mlx5_vfio_cmd_do(ctx, (void *)in, inlen, out, outlen, 0);
+	ret = mlx5_vfio_cmd_do(ctx, (void *)in, inlen, out, outlen);
 	if (ret) {
 		errno = ret;
 		goto fail;
@@ -3071,7 +3569,7 @@ static int vfio_devx_obj_query(struct mlx5dv_devx_obj *obj, const void *in,
 {
 	struct mlx5_vfio_context *ctx = to_mvfio_ctx(obj->context);
 
-	return mlx5_vfio_cmd_do(ctx, (void *)in, inlen, out, outlen, 0);
+	return mlx5_vfio_cmd_do(ctx, (void *)in, inlen, out, outlen);
 }
 
 static int vfio_devx_obj_modify(struct mlx5dv_devx_obj *obj, const void *in,
@@ -3079,7 +3577,7 @@ static int vfio_devx_obj_modify(struct mlx5dv_devx_obj *obj, const void *in,
 {
 	struct mlx5_vfio_context *ctx = to_mvfio_ctx(obj->context);
 
-	return mlx5_vfio_cmd_do(ctx, (void *)in, inlen, out, outlen, 0);
+	return mlx5_vfio_cmd_do(ctx, (void *)in, inlen, out, outlen);
 }
 
 static int vfio_devx_obj_destroy(struct mlx5dv_devx_obj *obj)
@@ -3091,7 +3589,7 @@ static int vfio_devx_obj_destroy(struct mlx5dv_devx_obj *obj)
 	int ret;
 
 	ret = mlx5_vfio_cmd_exec(ctx, mobj->dinbox, mobj->dinlen,
-				 out, sizeof(out), 0);
+				 out, sizeof(out));
 	if (ret)
 		return ret;
 
@@ -3099,6 +3597,197 @@ static int vfio_devx_obj_destroy(struct mlx5dv_devx_obj *obj)
 	return 0;
 }
 
+static struct mlx5dv_devx_cmd_comp *
+vfio_devx_create_cmd_comp(struct ibv_context *context)
+{
+	struct mlx5_vfio_cmd_comp *comp;
+
+	comp = calloc(1, sizeof(*comp));
+	if (!comp) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	/* Counts the responses on the list, for the application to poll */
+	comp->devx_comp.dv_cmd_comp.fd = eventfd(0, EFD_CLOEXEC |
+						    EFD_SEMAPHORE);
+	if (comp->devx_comp.dv_cmd_comp.fd < 0) {
+		free(comp);
+		return NULL;
+	}
+
+	comp->devx_comp.context = context;
+	pthread_mutex_init(&comp->lock, NULL);
+	list_head_init(&comp->resps);
+	return &comp->devx_comp.dv_cmd_comp;
+}
+
+static void vfio_free_cmd_comp(struct mlx5_vfio_cmd_comp *comp)
+{
+	struct mlx5_vfio_cmd_resp *resp, *tmp;
+
+	list_for_each_safe(&comp->resps, resp, tmp, entry) {
+		list_del(&resp->entry);
+		free(resp);
+	}
+
+	close(comp->devx_comp.dv_cmd_comp.fd);
+	pthread_mutex_destroy(&comp->lock);
+	free(comp);
+}
+
+static void vfio_devx_destroy_cmd_comp(struct mlx5dv_devx_cmd_comp *dv_cmd_comp)
+{
+	struct mlx5_vfio_cmd_comp *comp = to_mvfio_cmd_comp(dv_cmd_comp);
+	bool inflight;
+
+	/* Commands still in flight free it as the last one completes */
+	pthread_mutex_lock(&comp->lock);
+	comp->destroyed = true;
+	inflight = comp->inflight;
+	pthread_mutex_unlock(&comp->lock);
+
+	if (!inflight)
+		vfio_free_cmd_comp(comp);
+}
+
+static void vfio_devx_async_cmd_comp(struct mlx5_vfio_context *ctx, int err,
+				     void *out, void *comp_data)
+{
+	struct mlx5_vfio_cmd_resp *resp = comp_data;
+	struct mlx5_vfio_cmd_comp *comp = resp->comp;
+	bool release = false;
+	uint64_t u = 1;
+
+	/* As from the kernel, a failed command is told by its output status */
+	if (err && err != EREMOTEIO &&
+	    resp->outlen >= DEVX_ST_SZ_BYTES(mbox_out))
+		DEVX_SET(mbox_out, out, status, MLX5_CMD_STAT_INT_ERR);
+
+	pthread_mutex_lock(&comp->lock);
+	comp->inflight--;
+	if (comp->destroyed) {
+		free(resp);
+		release = !comp->inflight;
+	} else {
+		list_add_tail(&comp->resps, &resp->entry);
+		if (write(comp->devx_comp.dv_cmd_comp.fd, &u,
+			  sizeof(uint64_t)) != sizeof(uint64_t))
+			mlx5_err(ctx->dbg_fp, "%s, write failed, errno=%d\n",
+				 __func__, errno);
+	}
+	pthread_mutex_unlock(&comp->lock);
+
+	if (release)
+		vfio_free_cmd_comp(comp);
+}
+
+static int vfio_devx_obj_query_async(struct mlx5dv_devx_obj *obj,
+				     const void *in, size_t inlen,
+				     size_t outlen, uint64_t wr_id,
+				     struct mlx5dv_devx_cmd_comp *dv_cmd_comp)
+{
+	struct mlx5_vfio_cmd_comp *comp = to_mvfio_cmd_comp(dv_cmd_comp);
+	struct mlx5_vfio_context *ctx = to_mvfio_ctx(obj->context);
+	struct mlx5_vfio_cmd_resp *resp;
+	int err;
+
+	resp = calloc(1, sizeof(*resp) + outlen);
+	if (!resp)
+		return ENOMEM;
+
+	resp->comp = comp;
+	resp->wr_id = wr_id;
+	resp->outlen = outlen;
+
+	pthread_mutex_lock(&comp->lock);
+	comp->inflight++;
+	pthread_mutex_unlock(&comp->lock);
+
+	err = mlx5_vfio_cmd_exec_async(ctx, (void *)in, inlen, resp->out,
+				       outlen, vfio_devx_async_cmd_comp, resp);
+	if (err) {
+		pthread_mutex_lock(&comp->lock);
+		comp->inflight--;
+		pthread_mutex_unlock(&comp->lock);
+		free(resp);
+	}
+
+	return err;
+}
+
+/* Pop a response to cmd_resp, EAGAIN if there is none */
+static int vfio_cmd_comp_pop(struct mlx5_vfio_cmd_comp *comp,
+			     struct mlx5dv_devx_async_cmd_hdr *cmd_resp,
+			     size_t cmd_resp_len)
+{
+	struct mlx5_vfio_cmd_resp *resp;
+	uint64_t u;
+	int err = 0;
+
+	pthread_mutex_lock(&comp->lock);
+	resp = list_top(&comp->resps, struct mlx5_vfio_cmd_resp, entry);
+	if (!resp) {
+		err = EAGAIN;
+		goto out;
+	}
+
+	if (cmd_resp_len < sizeof(*cmd_resp) + resp->outlen) {
+		err = ENOSPC;
+		goto out;
+	}
+
+	/* The counter is at least one, for this response */
+	if (read(comp->devx_comp.dv_cmd_comp.fd, &u, sizeof(uint64_t)) < 0) {
+		err = errno;
+		goto out;
+	}
+
+	list_del(&resp->entry);
+	cmd_resp->wr_id = resp->wr_id;
+	memcpy(cmd_resp->out_data, resp->out, resp->outlen);
+	free(resp);
+out:
+	pthread_mutex_unlock(&comp->lock);
+	return err;
+}
+
+static int vfio_devx_get_async_cmd_comp(struct mlx5dv_devx_cmd_comp *dv_cmd_comp,
+					struct mlx5dv_devx_async_cmd_hdr *cmd_resp,
+					size_t cmd_resp_len)
+{
+	struct mlx5_vfio_cmd_comp *comp = to_mvfio_cmd_comp(dv_cmd_comp);
+	struct ibv_context *context = comp->devx_comp.context;
+	struct mlx5_vfio_context *ctx = to_mvfio_ctx(context);
+	struct pollfd fds[2] = {
+		{ .fd = ctx->cmd_comp_fd, .events = POLLIN },
+		{ .fd = dv_cmd_comp->fd, .events = POLLIN }
+		};
+	bool nonblock;
+	int err;
+
+	nonblock = fcntl(dv_cmd_comp->fd, F_GETFL) & O_NONBLOCK;
+	while (true) {
+		err = vfio_cmd_comp_pop(comp, cmd_resp, cmd_resp_len);
+		if (err != EAGAIN)
+			return err;
+
+		/*
+		 * Responses are queued as the command EQ is processed, which
+		 * may be up to us as in mlx5_vfio_wait_event().
+		 */
+		if (!nonblock && poll(fds, 2, -1) < 0 && errno != EINTR)
+			return errno;
+
+		err = mlx5dv_vfio_process_events(context);
+		if (err)
+			return err;
+
+		if (nonblock)
+			return vfio_cmd_comp_pop(comp, cmd_resp, cmd_resp_len);
+	}
+}
+
 static struct mlx5dv_devx_msi_vector *
 vfio_devx_alloc_msi_vector(struct ibv_context *ibctx)
 {
@@ -3244,7 +3933,7 @@ vfio_devx_create_eq(struct ibv_context *ibctx, const void *in, size_t inlen,
 	pas = (__be64 *)DEVX_ADDR_OF(create_eq_in, in_pas, pas);
 	pas[0] = htobe64(eq->iova);
 
-	err = mlx5_vfio_cmd_do(ctx, in_pas, inlen_pas, out, outlen, 0);
+	err = mlx5_vfio_cmd_do(ctx, in_pas, inlen_pas, out, outlen);
 	if (err) {
 		errno = err;
 		goto err_cmd;
@@ -3280,7 +3969,7 @@ static int vfio_devx_destroy_eq(struct mlx5dv_devx_eq *dveq)
 	DEVX_SET(destroy_eq_in, in, opcode, MLX5_CMD_OP_DESTROY_EQ);
 	DEVX_SET(destroy_eq_in, in, eq_number, eq->eqn);
 
-	err = mlx5_vfio_cmd_exec(ctx, in, sizeof(in), out, sizeof(out), 0);
+	err = mlx5_vfio_cmd_exec(ctx, in, sizeof(in), out, sizeof(out));
 	if (err)
 		return err;
 
@@ -3297,6 +3986,10 @@ static struct mlx5_dv_context_ops mlx5_vfio_dv_ctx_ops = {
 	.devx_obj_query = vfio_devx_obj_query,
 	.devx_obj_modify = vfio_devx_obj_modify,
 	.devx_obj_destroy = vfio_devx_obj_destroy,
+	.devx_create_cmd_comp = vfio_devx_create_cmd_comp,
+	.devx_destroy_cmd_comp = vfio_devx_destroy_cmd_comp,
+	.devx_obj_query_async = vfio_devx_obj_query_async,
+	.devx_get_async_cmd_comp = vfio_devx_get_async_cmd_comp,
 	.devx_query_eqn = vfio_devx_query_eqn,
 	.devx_alloc_uar = vfio_devx_alloc_uar,
 	.devx_free_uar = vfio_devx_free_uar,
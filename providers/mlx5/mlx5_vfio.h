@@ -38,6 +38,8 @@ enum {
 enum {
 	MLX5_VFIO_BLOCK_SIZE = 2 * 1024 * 1024,
 	MLX5_VFIO_BLOCK_NUM_PAGES = MLX5_VFIO_BLOCK_SIZE / MLX5_ADAPTER_PAGE_SIZE,
+	MLX5_VFIO_HUGE_BLOCK_SIZE = 1024 * 1024 * 1024,
+	MLX5_VFIO_HUGE_BLOCK_NUM_PAGES = MLX5_VFIO_HUGE_BLOCK_SIZE / MLX5_ADAPTER_PAGE_SIZE,
 };
 
 struct mlx5_vfio_mr {
@@ -162,12 +164,23 @@ struct mlx5_cmd_block {
 struct page_block {
 	void *page_ptr;
 	uint64_t iova;
+	size_t size;
+	/* Backed by a hugetlb mapping rather than the heap */
+	bool hugetlb;
+	uint32_t num_pages;
+	uint32_t num_free;
+	/* On the avail_list while num_free */
 	struct list_node next_block;
-	BMP_DECLARE(free_pages, MLX5_VFIO_BLOCK_NUM_PAGES);
+	unsigned long *free_pages;
 };
 
 struct vfio_mem_allocator {
-	struct list_head block_list;
+	/* Blocks with free pages */
+	struct list_head avail_list;
+	/* All the blocks, sorted by IOVA for the lookup on free */
+	struct page_block **blocks;
+	unsigned int num_blocks;
+	unsigned int max_blocks;
 	pthread_mutex_t block_list_mutex;
 };
 
@@ -186,11 +199,16 @@ struct mlx5_cmd_msg {
 typedef int (*vfio_cmd_slot_comp)(struct mlx5_vfio_context *ctx,
 				  unsigned long slot);
 
+/* Called with the output of a command from mlx5_vfio_cmd_exec_async() */
+typedef void (*vfio_cmd_async_comp)(struct mlx5_vfio_context *ctx, int err,
+				    void *out, void *comp_data);
+
 struct cmd_async_data {
 	void *buff_in;
 	int ilen;
 	void *buff_out;
 	int olen;
+	struct list_node entry;
 };
 
 struct mlx5_vfio_cmd_slot {
@@ -203,8 +221,11 @@ struct mlx5_vfio_cmd_slot {
 	/* async cmd caller data */
 	bool in_use;
 	struct cmd_async_data curr;
-	bool is_pending;
-	struct cmd_async_data pending;
+	/* async cmds posted while in_use, in posting order */
+	struct list_head pending;
+	/* mlx5_vfio_cmd_exec_async() caller data */
+	vfio_cmd_async_comp async_comp;
+	void *async_comp_data;
 };
 
 struct mlx5_vfio_cmd {
@@ -212,9 +233,31 @@ struct mlx5_vfio_cmd {
 	uint64_t iova;
 	uint8_t log_sz;
 	uint8_t log_stride;
+	/* General slots not owned by a command, see mlx5_vfio_get_cmd_slot() */
+	pthread_mutex_t slots_lock;
+	uint32_t free_slots;
+	int slot_waiters;
+	int slot_free_fd;
 	struct mlx5_vfio_cmd_slot cmds[MLX5_MAX_COMMANDS];
 };
 
+struct mlx5_vfio_cmd_comp {
+	struct mlx5_devx_cmd_comp devx_comp;
+	pthread_mutex_t lock;
+	/* mlx5_vfio_cmd_resp completed and not read yet */
+	struct list_head resps;
+	int inflight;
+	bool destroyed;
+};
+
+struct mlx5_vfio_cmd_resp {
+	struct list_node entry;
+	struct mlx5_vfio_cmd_comp *comp;
+	uint64_t wr_id;
+	size_t outlen;
+	uint8_t out[];
+};
+
 struct mlx5_eq_param {
 	uint8_t irq_index;
 	int nent;
@@ -328,4 +371,11 @@ static inline struct mlx5_vfio_mr *to_mvfio_mr(struct ibv_mr *ibmr)
 	return container_of(ibmr, struct mlx5_vfio_mr, vmr.ibv_mr);
 }
 
+static inline struct mlx5_vfio_cmd_comp *
+to_mvfio_cmd_comp(struct mlx5dv_devx_cmd_comp *dv_cmd_comp)
+{
+	return container_of(dv_cmd_comp, struct mlx5_vfio_cmd_comp,
+			    devx_comp.dv_cmd_comp);
+}
+
 #endif
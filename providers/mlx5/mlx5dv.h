@@ -1946,8 +1946,47 @@ mlx5dv_dr_rule_create(struct mlx5dv_dr_matcher *matcher,
 		      size_t num_actions,
 		      struct mlx5dv_dr_action *actions[]);
 
+struct mlx5dv_dr_rule_bulk_entry {
+	struct mlx5dv_flow_match_parameters *value;
+	size_t num_actions;
+	struct mlx5dv_dr_action **actions;
+	struct mlx5dv_dr_rule *rule; /* set by mlx5dv_dr_rule_create_bulk */
+};
+
+int mlx5dv_dr_rule_create_bulk(struct mlx5dv_dr_matcher *matcher,
+			       size_t num_rules,
+			       struct mlx5dv_dr_rule_bulk_entry *entries);
+
 int mlx5dv_dr_rule_destroy(struct mlx5dv_dr_rule *rule);
 
+int mlx5dv_dr_rule_modify_actions(struct mlx5dv_dr_rule *rule,
+				  size_t num_actions,
+				  struct mlx5dv_dr_action *actions[]);
+
+enum mlx5dv_dr_rule_op {
+	MLX5DV_DR_RULE_OP_CREATE,
+	MLX5DV_DR_RULE_OP_DESTROY,
+};
+
+struct mlx5dv_dr_rule_completion {
+	struct mlx5dv_dr_rule *rule;
+	void *user_data;
+	enum mlx5dv_dr_rule_op op;
+};
+
+struct mlx5dv_dr_rule *
+mlx5dv_dr_rule_create_async(struct mlx5dv_dr_matcher *matcher,
+			    struct mlx5dv_flow_match_parameters *value,
+			    size_t num_actions,
+			    struct mlx5dv_dr_action *actions[],
+			    void *user_data);
+
+int mlx5dv_dr_rule_destroy_async(struct mlx5dv_dr_rule *rule, void *user_data);
+
+int mlx5dv_dr_domain_poll(struct mlx5dv_dr_domain *domain,
+			  struct mlx5dv_dr_rule_completion *comp,
+			  int num_comp);
+
 enum mlx5dv_dr_action_flags {
 	MLX5DV_DR_ACTION_FLAGS_ROOT_LEVEL	= 1 << 0,
 };
@@ -2066,6 +2105,13 @@ int mlx5dv_dump_dr_table(FILE *fout, struct mlx5dv_dr_table *table);
 int mlx5dv_dump_dr_matcher(FILE *fout, struct mlx5dv_dr_matcher *matcher);
 int mlx5dv_dump_dr_rule(FILE *fout, struct mlx5dv_dr_rule *rule);
 
+enum mlx5dv_dump_dr_flags {
+	MLX5DV_DUMP_DR_FLAGS_BINARY = 1 << 0,
+};
+
+int mlx5dv_dump_dr_domain_ex(FILE *fout, struct mlx5dv_dr_domain *domain,
+			     uint32_t flags);
+
 struct mlx5dv_pp {
 	uint16_t index;
 };
@@ -206,11 +206,14 @@ struct postsend_info {
 	uint32_t		rkey;
 };
 
+/*
+ * Host side shadow of an ICM STE, one per entry of every buddy, so it is
+ * kept small: the hardware STE and its size follow from htbl and the STE
+ * index, see dr_ste_get_hw_ste(). The remaining pointers cannot become
+ * indexes, a miss list chains collision STEs that each live in their own
+ * single entry htbl, and next_htbl and rule_rx_tx reach outside the htbl.
+ */
 struct dr_ste {
-	uint8_t			*hw_ste;
-	/* refcount: indicates the num of rules that using this ste */
-	atomic_int		refcount;
-
 	/* attached to the miss_list head at each htbl entry */
 	struct list_node	miss_list_node;
 
@@ -222,9 +225,11 @@ struct dr_ste {
 	/* The rule this STE belongs to */
 	struct dr_rule_rx_tx    *rule_rx_tx;
 
+	/* refcount: indicates the num of rules that using this ste */
+	atomic_int		refcount;
+
 	/* this ste is part of a rule, located in ste's chain */
 	uint8_t			ste_chain_location;
-	uint8_t			size;
 };
 
 struct dr_ste_htbl_ctrl {
@@ -257,6 +262,27 @@ struct dr_ste_htbl {
 	struct dr_ste		*pointing_ste;
 
 	struct dr_ste_htbl_ctrl ctrl;
+	/* Set on both tables while one replaces the other */
+	struct dr_ste_htbl_grow	*grow;
+};
+
+/*
+ * A hash table replaced by a larger one without stopping insertions.
+ * new_htbl is first set up and written a chunk per insertion, each entry
+ * missing to the old_htbl entry with the same hash index, while old_htbl
+ * still takes the new rules.  Once written, the pointing STE switches to new_htbl and
+ * the old buckets move over, on demand and a run per insertion or deletion.
+ */
+struct dr_ste_htbl_grow {
+	struct dr_ste_htbl	*old_htbl;
+	struct dr_ste_htbl	*new_htbl;
+	uint8_t			formated_ste[DR_STE_SIZE];
+	uint8_t			ste_location;
+	bool			connected;
+	uint32_t		init_pos;
+	uint32_t		migrate_pos;
+	uint32_t		num_migrated;
+	unsigned long		*migrated;
 };
 
 struct dr_ste_send_info {
@@ -300,6 +326,12 @@ struct dr_ste_htbl *dr_ste_htbl_alloc(struct dr_icm_pool *pool,
 				      enum dr_icm_chunk_size chunk_size,
 				      enum dr_ste_htbl_type type,
 				      uint16_t lu_type, uint16_t byte_mask);
+struct dr_ste_htbl *dr_ste_htbl_alloc_lazy(struct dr_icm_pool *pool,
+					   enum dr_icm_chunk_size chunk_size,
+					   enum dr_ste_htbl_type type,
+					   uint16_t lu_type, uint16_t byte_mask);
+void dr_ste_htbl_init_entries(struct dr_ste_htbl *htbl, uint32_t first,
+			      uint32_t num);
 int dr_ste_htbl_free(struct dr_ste_htbl *htbl);
 
 static inline void dr_htbl_put(struct dr_ste_htbl *htbl)
@@ -313,6 +345,15 @@ static inline void dr_htbl_get(struct dr_ste_htbl *htbl)
 	atomic_fetch_add(&htbl->refcount, 1);
 }
 
+static inline void dr_htbl_set_pointing_ste(struct dr_ste_htbl *htbl,
+					    struct dr_ste *ste)
+{
+	htbl->pointing_ste = ste;
+	/* The old table of a growth is reached through the same STE */
+	if (htbl->grow)
+		htbl->grow->old_htbl->pointing_ste = ste;
+}
+
 /* STE utils */
 uint32_t dr_ste_calc_hash_index(uint8_t *hw_ste_p, struct dr_ste_htbl *htbl);
 void dr_ste_set_miss_addr(struct dr_ste_ctx *ste_ctx, uint8_t *hw_ste_p,
@@ -332,6 +373,30 @@ uint64_t dr_ste_get_mr_addr(struct dr_ste *ste);
 struct list_head *dr_ste_get_miss_list(struct dr_ste *ste);
 struct dr_ste *dr_ste_get_miss_list_top(struct dr_ste *ste);
 
+/* The STE shadow is not referenced from dr_ste, one per host STE adds up
+ * over millions of rules. It lives in the htbl hw_ste_arr at the STE index.
+ */
+static inline uint8_t dr_ste_htbl_hw_ste_sz(struct dr_ste_htbl *htbl)
+{
+	if (htbl->type == DR_STE_HTBL_TYPE_LEGACY)
+		return DR_STE_SIZE_REDUCED;
+
+	return DR_STE_SIZE;
+}
+
+static inline uint8_t dr_ste_hw_ste_sz(struct dr_ste *ste)
+{
+	return dr_ste_htbl_hw_ste_sz(ste->htbl);
+}
+
+static inline uint8_t *dr_ste_get_hw_ste(struct dr_ste *ste)
+{
+	struct dr_ste_htbl *htbl = ste->htbl;
+
+	return htbl->hw_ste_arr +
+	       (ste - htbl->ste_arr) * dr_ste_htbl_hw_ste_sz(htbl);
+}
+
 static inline int dr_ste_tag_sz(struct dr_ste *ste)
 {
 	if (ste->htbl->type == DR_STE_HTBL_TYPE_LEGACY)
@@ -477,6 +542,10 @@ int dr_ste_build_ste_arr(struct mlx5dv_dr_matcher *matcher,
 			 struct dr_matcher_rx_tx *nic_matcher,
 			 struct dr_match_param *value,
 			 uint8_t *ste_arr);
+void dr_ste_rebuild_match_ste(struct mlx5dv_dr_matcher *matcher,
+			      struct dr_matcher_rx_tx *nic_matcher,
+			      struct dr_ste *ste,
+			      uint8_t *hw_ste);
 void dr_ste_build_eth_l2_src_dst(struct dr_ste_ctx *ste_ctx,
 				 struct dr_ste_build *sb,
 				 struct dr_match_param *mask,
@@ -660,6 +729,8 @@ int dr_actions_build_attr(struct mlx5dv_dr_matcher *matcher,
 			  size_t num_actions,
 			  struct mlx5dv_flow_action_attr *attr,
 			  struct mlx5_flow_action_attr_aux *attr_aux);
+int dr_action_cache_init(struct mlx5dv_dr_domain *dmn);
+void dr_action_cache_uninit(struct mlx5dv_dr_domain *dmn);
 
 struct dr_match_spec {
 	uint32_t smac_47_16;	/* Source MAC address of incoming packet */
@@ -1025,6 +1096,35 @@ enum dr_domain_flags {
 	 DR_DOMAIN_FLAG_DISABLE_DUPLICATE_RULES = 1 << 1,
 };
 
+/* Initial buckets, doubled whenever the entries outnumber them */
+#define DR_ACTION_CACHE_MIN_BUCKETS 64
+
+/* One shared modify header or reformat action, keyed by its content */
+struct dr_action_cache_entry {
+	struct list_node		list;
+	struct mlx5dv_dr_domain		*dmn;
+	struct mlx5dv_dr_action		*action;
+	uint32_t			hash;
+	uint32_t			users;
+	enum dr_action_type		action_type;
+	uint32_t			flags;
+	/* device memory a duplicate of the action would take */
+	size_t				mem_size;
+	size_t				data_sz;
+	uint8_t				data[];
+};
+
+struct dr_action_cache {
+	pthread_spinlock_t		lock;
+	struct list_head		*buckets;
+	/* a power of two */
+	uint32_t			num_buckets;
+	uint32_t			num_entries;
+	/* creations served by an existing action, and the memory saved */
+	uint64_t			num_dedup;
+	uint64_t			saved_bytes;
+};
+
 struct mlx5dv_dr_domain {
 	struct ibv_context		*ctx;
 	struct dr_ste_ctx		*ste_ctx;
@@ -1040,6 +1140,15 @@ struct mlx5dv_dr_domain {
 	uint32_t			flags;
 	/* protect debug lists of all tracked objects */
 	pthread_spinlock_t		debug_lock;
+	/* rules on the matcher rule lists, under debug_lock */
+	uint64_t			num_rules;
+	/* serializes dumps, which continue from dump_rule after unlocking */
+	pthread_mutex_t			dump_mutex;
+	struct mlx5dv_dr_rule		*dump_rule;
+	/* async rule operations waiting for the HW, in issue order */
+	struct list_head		async_list;
+	pthread_spinlock_t		async_lock;
+	struct dr_action_cache		action_cache;
 };
 
 static inline int dr_domain_nic_lock_init(struct dr_domain_rx_tx *nic_dmn)
@@ -1172,6 +1281,8 @@ struct dr_flow_sampler_restore_tbl {
 struct mlx5dv_dr_action {
 	enum dr_action_type		action_type;
 	atomic_int			refcount;
+	/* set while the action is shared through the domain action cache */
+	struct dr_action_cache_entry	*cache_entry;
 	union {
 		struct {
 			struct mlx5dv_dr_domain	*dmn;
@@ -1282,6 +1393,10 @@ struct mlx5dv_dr_rule {
 	struct list_node	rule_list;
 	struct mlx5dv_dr_action	**actions;
 	uint16_t		num_actions;
+	/* The current create or destroy doesn't wait for the send rings */
+	bool			async;
+	/* Create of mlx5dv_dr_rule_create_async() not polled yet */
+	struct dr_rule_async_op	*async_op;
 };
 
 static inline void
@@ -1519,6 +1634,8 @@ struct dr_icm_pool *dr_icm_pool_create(struct mlx5dv_dr_domain *dmn,
 				       enum dr_icm_type icm_type);
 void dr_icm_pool_destroy(struct dr_icm_pool *pool);
 int dr_icm_pool_sync_pool(struct dr_icm_pool *pool);
+void dr_icm_pool_get_ste_mem(struct dr_icm_pool *pool, uint64_t *icm_used,
+			     uint64_t *host_used, uint64_t *host_alloc);
 
 struct dr_icm_chunk *dr_icm_alloc_chunk(struct dr_icm_pool *pool,
 					enum dr_icm_chunk_size chunk_size);
@@ -1543,6 +1660,8 @@ void dr_ste_copy_param(uint8_t match_criteria,
 
 void dr_crc32_init_table(void);
 uint32_t dr_crc32_slice8_calc(const void *input_data, size_t length);
+uint32_t dr_crc32_calc(const void *input_data, size_t length);
+void dr_crc32_mask_tag(uint8_t *masked, const uint8_t *tag, uint16_t byte_mask);
 
 struct dr_wq {
 	unsigned	*wqe_head;
@@ -1602,6 +1721,11 @@ struct dr_send_ring {
 	uint32_t		buf_size;
 	void			*sync_buff;
 	struct ibv_mr		*sync_mr;
+	/* Writes issued, queued included, and writes posted to the QP */
+	uint64_t		post_seq;
+	uint64_t		posted;
+	/* Writes queued by nowait postsends while the ring was full */
+	struct list_head	wr_list;
 };
 
 int dr_send_ring_alloc(struct mlx5dv_dr_domain *dmn);
@@ -1611,9 +1735,25 @@ bool dr_send_allow_fl(struct dr_devx_caps *caps);
 int dr_send_postsend_ste(struct mlx5dv_dr_domain *dmn, struct dr_ste *ste,
 			 uint8_t *data, uint16_t size, uint16_t offset,
 			 uint8_t ring_idx);
+int dr_send_postsend_ste_nowait(struct mlx5dv_dr_domain *dmn,
+				struct dr_ste *ste, uint8_t *data,
+				uint16_t size, uint16_t offset,
+				uint8_t ring_idx);
+uint64_t dr_send_ring_get_seq(struct mlx5dv_dr_domain *dmn, uint8_t ring_idx);
+int dr_send_ring_poll(struct mlx5dv_dr_domain *dmn, uint8_t ring_idx,
+		      uint64_t wait_seq, uint64_t *done_seq);
+int dr_send_postsend_ste_arr(struct mlx5dv_dr_domain *dmn, struct dr_ste *ste,
+			     uint8_t *data, uint32_t num_stes,
+			     uint8_t ring_idx);
 int dr_send_postsend_htbl(struct mlx5dv_dr_domain *dmn, struct dr_ste_htbl *htbl,
 			  uint8_t *formated_ste, uint8_t *mask,
 			  uint8_t send_ring_idx);
+int dr_send_postsend_htbl_range(struct mlx5dv_dr_domain *dmn,
+				struct dr_ste_htbl *htbl,
+				uint32_t ste_index, uint32_t num_stes,
+				uint8_t *formated_ste, uint8_t *mask,
+				struct dr_ste_htbl *fwd_htbl,
+				uint8_t send_ring_idx);
 int dr_send_postsend_formated_htbl(struct mlx5dv_dr_domain *dmn,
 				   struct dr_ste_htbl *htbl,
 				   uint8_t *ste_init_data,
@@ -0,0 +1,585 @@
+/* GPLv2 or OpenIB.org BSD (MIT) See COPYING file */
+
+/*
+ * Compressed CQE test and microbenchmark for the mlx5 poll paths.  Plays the
+ * device on a synthetic CQ buffer, writing plain CQEs and compressed CQE
+ * sessions of random sizes for two receive QPs over many laps of the CQ, and
+ * checks that ibv_poll_cq and the lazy cq_ex readers return every completion
+ * with the fields it was written with, for each mini CQE format and CQE size.
+ * Also checks cleaning the CQ of a QP in the middle of a session.  Then
+ * reports the time per completion of polling plain and compressed CQEs.
+ *
+ * Needs no device.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <inttypes.h>
+
+#include <ccan/array_size.h>
+
+#include "../mlx5.h"
+
+#define CQ_TEST_NENT		256
+#define CQ_TEST_RQ_SIZE		(1 << 16)
+#define CQ_TEST_MAX_SESSION	40
+#define CQ_TEST_NQP		2
+
+/* Where the CQE fields that a mini CQE may carry are */
+#define CQ_TEST_HASH_OFFSET	12
+#define CQ_TEST_CSUM_OFFSET	20
+
+struct test_qp {
+	struct mlx5_qp		qp;
+	uint64_t		wrid[CQ_TEST_RQ_SIZE];
+	bool			destroyed;
+	/* Receives completed by the device and polled */
+	uint32_t		hw_done;
+	uint32_t		polled;
+};
+
+struct expect {
+	struct test_qp		*tqp;
+	uint32_t		byte_len;
+	uint32_t		aux;
+	uint16_t		wqe_counter;
+};
+
+static struct mlx5_context mctx;
+static struct mlx5_cq cq;
+static struct test_qp qps[CQ_TEST_NQP];
+static __be32 dbrec[2];
+static int cqe_sz = 64;
+static uint8_t format;
+static uint32_t prod;
+static uint64_t completions = 1000000;
+
+static struct expect expects[2 * CQ_TEST_NENT];
+static uint32_t expect_head, expect_tail;
+
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+struct mlx5_qp *mlx5_find_qp(struct mlx5_context *ctx, uint32_t qpn)
+{
+	int i;
+
+	for (i = 0; i < CQ_TEST_NQP; i++)
+		if (!qps[i].destroyed && qps[i].qp.rsc.rsn == qpn)
+			return &qps[i].qp;
+	return NULL;
+}
+
+/* Nothing else of the provider is reached by receive completions */
+struct mlx5_srq *mlx5_find_srq(struct mlx5_context *ctx, uint32_t srqn)
+{
+	return NULL;
+}
+
+struct mlx5_mkey *mlx5_find_mkey(struct mlx5_context *ctx, uint32_t mkeyn)
+{
+	return NULL;
+}
+
+void mlx5_free_srq_wqe(struct mlx5_srq *srq, int ind)
+{
+}
+
+void mlx5_complete_odp_fault(struct mlx5_srq *srq, int ind)
+{
+}
+
+int mlx5_copy_to_recv_wqe(struct mlx5_qp *qp, int idx, void *buf, int size)
+{
+	abort();
+}
+
+int mlx5_copy_to_send_wqe(struct mlx5_qp *qp, int idx, void *buf, int size)
+{
+	abort();
+}
+
+int mlx5_copy_to_recv_srq(struct mlx5_srq *srq, int idx, void *buf, int size)
+{
+	abort();
+}
+
+int mlx5_alloc_prefered_buf(struct mlx5_context *ctx, struct mlx5_buf *buf,
+			    size_t size, int page_size,
+			    enum mlx5_alloc_type alloc_type,
+			    const char *component)
+{
+	abort();
+}
+
+int mlx5_free_actual_buf(struct mlx5_context *ctx, struct mlx5_buf *buf)
+{
+	abort();
+}
+
+void mlx5_get_alloc_type(struct mlx5_context *context, struct ibv_pd *pd,
+			 const char *component, enum mlx5_alloc_type *alloc_type,
+			 enum mlx5_alloc_type default_type)
+{
+	abort();
+}
+
+int mlx5_use_huge(const char *key)
+{
+	return 0;
+}
+
+int mlx5dv_get_clock_info(struct ibv_context *context,
+			  struct mlx5dv_clock_info *clock_info)
+{
+	abort();
+}
+
+int mlx5_freeze_on_error_cqe;
+
+static struct mlx5_cqe64 *slot(uint32_t n)
+{
+	return cq.active_buf->buf + (n & (CQ_TEST_NENT - 1)) * cqe_sz +
+	       cqe_sz - 64;
+}
+
+static uint8_t owner(uint32_t n)
+{
+	return !!(n & CQ_TEST_NENT);
+}
+
+static void setup(void)
+{
+	struct ibv_cq_init_attr_ex attr = {
+		.wc_flags = IBV_WC_EX_WITH_BYTE_LEN | IBV_WC_EX_WITH_QP_NUM,
+	};
+	static struct mlx5_buf buf;
+	int i;
+
+	free(buf.buf);
+	memset(&cq, 0, sizeof(cq));
+	buf.buf = aligned_alloc(4096, CQ_TEST_NENT * cqe_sz);
+	memset(buf.buf, 0, CQ_TEST_NENT * cqe_sz);
+	cq.buf_a = buf;
+	cq.active_buf = &cq.buf_a;
+	cq.verbs_cq.cq.context = &mctx.ibv_ctx.context;
+	cq.verbs_cq.cq.cqe = CQ_TEST_NENT - 1;
+	cq.cqe_sz = cqe_sz;
+	cq.dbrec = dbrec;
+	cq.cqe_comp_format = format;
+	for (i = 0; i < CQ_TEST_NENT; i++)
+		slot(i)->op_own = MLX5_CQE_INVALID << 4;
+	mlx5_cq_fill_pfns(&cq, &attr, &mctx);
+
+	for (i = 0; i < CQ_TEST_NQP; i++) {
+		struct test_qp *tqp = &qps[i];
+		int j;
+
+		memset(&tqp->qp, 0, sizeof(tqp->qp));
+		tqp->qp.rsc.type = MLX5_RSC_TYPE_QP;
+		tqp->qp.rsc.rsn = 0x100 + i;
+		tqp->qp.rq.wrid = tqp->wrid;
+		tqp->qp.rq.wqe_cnt = CQ_TEST_RQ_SIZE;
+		for (j = 0; j < CQ_TEST_RQ_SIZE; j++)
+			tqp->wrid[j] = (uint64_t)tqp->qp.rsc.rsn << 32 | j;
+		tqp->destroyed = false;
+		tqp->hw_done = 0;
+		tqp->polled = 0;
+	}
+
+	prod = 0;
+	expect_head = expect_tail = 0;
+}
+
+static void fill_cqe(struct mlx5_cqe64 *cqe, struct test_qp *tqp,
+		     uint32_t byte_cnt, uint16_t wqe_counter, uint8_t op_own)
+{
+	memset((void *)cqe + 64 - cqe_sz, 0, cqe_sz);
+	cqe->sop_drop_qpn = htobe32(tqp->qp.rsc.rsn);
+	cqe->byte_cnt = htobe32(byte_cnt);
+	cqe->wqe_counter = htobe16(wqe_counter);
+	cqe->op_own = op_own;
+}
+
+static void set_aux(void *cqe, uint32_t aux)
+{
+	__be32 hash = htobe32(aux);
+	__be16 csum = htobe16(aux);
+
+	if (format == MLX5DV_CQE_RES_FORMAT_HASH)
+		memcpy(cqe + CQ_TEST_HASH_OFFSET, &hash, sizeof(hash));
+	else
+		memcpy(cqe + CQ_TEST_CSUM_OFFSET, &csum, sizeof(csum));
+}
+
+static void expect_push(struct test_qp *tqp, uint32_t byte_len, uint32_t aux,
+			uint16_t wqe_counter)
+{
+	struct expect *e = &expects[expect_tail++ % ARRAY_SIZE(expects)];
+
+	e->tqp = tqp;
+	e->byte_len = byte_len;
+	e->aux = aux;
+	e->wqe_counter = wqe_counter;
+	tqp->hw_done++;
+}
+
+static void post_plain(struct test_qp *tqp)
+{
+	struct mlx5_cqe64 *cqe = slot(prod);
+	uint32_t byte_len = random() % 9000;
+	uint32_t aux = random() & 0xffff;
+
+	fill_cqe(cqe, tqp, byte_len, tqp->hw_done,
+		 MLX5_CQE_RESP_SEND << 4 | owner(prod));
+	set_aux(cqe, aux);
+	expect_push(tqp, byte_len, aux, tqp->hw_done);
+	prod++;
+}
+
+/* A session of n completions, the device writes its title last */
+static void post_session(struct test_qp *tqp, uint32_t n)
+{
+	struct mlx5_mini_cqe8 *mini;
+	uint16_t wqe_counter = tqp->hw_done;
+	uint32_t byte_len, aux, i;
+
+	for (i = 0; i < n; i++) {
+		mini = (void *)slot(i < MLX5_MINI_CQE_ARRAY_SIZE ?
+				    prod + 1 :
+				    prod + (i & ~(MLX5_MINI_CQE_ARRAY_SIZE - 1)));
+		mini += i % MLX5_MINI_CQE_ARRAY_SIZE;
+
+		byte_len = random();
+		mini->byte_cnt = htobe32(byte_len);
+		switch (format) {
+		case MLX5DV_CQE_RES_FORMAT_HASH:
+			aux = random();
+			mini->rx_hash_result = htobe32(aux);
+			expect_push(tqp, byte_len, aux, wqe_counter + i);
+			break;
+		case MLX5DV_CQE_RES_FORMAT_CSUM_STRIDX:
+			aux = random() & 0xffff;
+			mini->checksum = htobe16(aux);
+			mini->stridx = htobe16(i * 3);
+			expect_push(tqp, byte_len, aux, i * 3);
+			break;
+		default:
+			aux = random() & 0xffff;
+			mini->checksum = htobe16(aux);
+			expect_push(tqp, byte_len, aux, wqe_counter + i);
+			break;
+		}
+	}
+
+	fill_cqe(slot(prod), tqp, n, wqe_counter,
+		 MLX5_CQE_RESP_SEND << 4 | 0x3 << 2 | owner(prod));
+	prod += n;
+}
+
+/* Write completions until the CQ is nearly full */
+static void produce(uint32_t max)
+{
+	struct test_qp *tqp;
+	uint32_t n;
+
+	while (max) {
+		tqp = &qps[random() % CQ_TEST_NQP];
+		if (tqp->destroyed)
+			continue;
+
+		n = random() % 3 ? 1 : 2 + random() % (CQ_TEST_MAX_SESSION - 1);
+		n = min(n, max);
+		if (prod + n - cq.cons_index > CQ_TEST_NENT)
+			return;
+
+		if (n == 1)
+			post_plain(tqp);
+		else
+			post_session(tqp, n);
+		max -= n;
+	}
+}
+
+static int check(struct expect *e, uint32_t qp_num, uint64_t wr_id,
+		 uint32_t byte_len, struct mlx5_cqe64 *cqe64)
+{
+	struct test_qp *tqp = e->tqp;
+	uint32_t aux;
+	__be32 hash;
+	__be16 csum;
+
+	if (qp_num != tqp->qp.rsc.rsn || byte_len != e->byte_len ||
+	    wr_id != tqp->wrid[tqp->polled % CQ_TEST_RQ_SIZE]) {
+		fprintf(stderr,
+			"completion %u: qp 0x%x wr_id 0x%" PRIx64 " len %u, expected qp 0x%x wr_id 0x%" PRIx64 " len %u\n",
+			expect_head, qp_num, wr_id, byte_len,
+			tqp->qp.rsc.rsn, tqp->wrid[tqp->polled % CQ_TEST_RQ_SIZE],
+			e->byte_len);
+		return 1;
+	}
+	tqp->polled++;
+
+	/* The lazy readers also give the whole expanded CQE */
+	if (!cqe64)
+		return 0;
+
+	if (format == MLX5DV_CQE_RES_FORMAT_HASH) {
+		memcpy(&hash, (void *)cqe64 + CQ_TEST_HASH_OFFSET, sizeof(hash));
+		aux = be32toh(hash);
+	} else {
+		memcpy(&csum, (void *)cqe64 + CQ_TEST_CSUM_OFFSET, sizeof(csum));
+		aux = be16toh(csum);
+	}
+	if (aux != e->aux || be16toh(cqe64->wqe_counter) != e->wqe_counter) {
+		fprintf(stderr,
+			"completion %u: aux 0x%x wqe_counter %u, expected aux 0x%x wqe_counter %u\n",
+			expect_head, aux, be16toh(cqe64->wqe_counter), e->aux,
+			e->wqe_counter);
+		return 1;
+	}
+
+	return 0;
+}
+
+static struct expect *expect_pop(void)
+{
+	struct expect *e;
+
+	do {
+		if (expect_head == expect_tail)
+			return NULL;
+		e = &expects[expect_head++ % ARRAY_SIZE(expects)];
+	} while (e->tqp->destroyed);
+
+	return e;
+}
+
+static int consume_verbs(uint32_t max)
+{
+	struct ibv_wc wc[16];
+	struct expect *e;
+	int ne, i;
+
+	ne = mlx5_poll_cq(&cq.verbs_cq.cq, min_t(uint32_t, max, 1 + random() % 16),
+			  wc);
+	if (ne < 0) {
+		fprintf(stderr, "poll_cq failed\n");
+		return -1;
+	}
+
+	for (i = 0; i < ne; i++) {
+		e = expect_pop();
+		if (!e || wc[i].status != IBV_WC_SUCCESS ||
+		    wc[i].opcode != IBV_WC_RECV ||
+		    check(e, wc[i].qp_num, wc[i].wr_id, wc[i].byte_len, NULL))
+			return -1;
+	}
+
+	return ne;
+}
+
+static int consume_lazy(uint32_t max)
+{
+	struct ibv_poll_cq_attr attr = {};
+	struct ibv_cq_ex *cq_ex = &cq.verbs_cq.cq_ex;
+	struct expect *e;
+	uint32_t n = 0;
+	int ret;
+
+	ret = ibv_start_poll(cq_ex, &attr);
+	if (ret == ENOENT)
+		return 0;
+
+	while (!ret) {
+		e = expect_pop();
+		if (!e || cq_ex->status != IBV_WC_SUCCESS ||
+		    ibv_wc_read_opcode(cq_ex) != IBV_WC_RECV ||
+		    check(e, ibv_wc_read_qp_num(cq_ex), cq_ex->wr_id,
+			  ibv_wc_read_byte_len(cq_ex), cq.cqe64)) {
+			ibv_end_poll(cq_ex);
+			return -1;
+		}
+
+		if (++n == max)
+			break;
+		ret = ibv_next_poll(cq_ex);
+	}
+
+	ibv_end_poll(cq_ex);
+	return ret && ret != ENOENT ? -1 : n;
+}
+
+static int run_stream(void)
+{
+	uint64_t done = 0;
+	bool drain;
+	int ne;
+
+	setup();
+
+	while (done < completions) {
+		produce(random() % (2 * CQ_TEST_MAX_SESSION));
+
+		/* Now and then poll the CQ empty, to look at stale slots */
+		drain = !(random() % 4);
+		do {
+			ne = random() % 2 ? consume_verbs(16) :
+					    consume_lazy(random() % 64 + 1);
+			if (ne < 0)
+				return 1;
+			done += ne;
+		} while (drain && ne);
+	}
+
+	return 0;
+}
+
+/* Clean one QP while a session of the other and its own are pending */
+static int run_clean(void)
+{
+	uint32_t i, polled = 0;
+	int ne;
+
+	setup();
+
+	post_session(&qps[0], 20);
+	post_plain(&qps[1]);
+	post_session(&qps[1], 11);
+	post_session(&qps[0], 9);
+	post_plain(&qps[0]);
+	post_session(&qps[1], 17);
+
+	/* Leave the first session half polled */
+	for (i = 0; i < 5; i++)
+		if (consume_lazy(1) != 1)
+			return 1;
+
+	qps[0].destroyed = true;
+	mlx5_cq_clean(&cq, qps[0].qp.rsc.rsn, NULL);
+
+	while ((ne = consume_verbs(16)) > 0)
+		polled += ne;
+
+	if (ne < 0 || polled != 1 + 11 + 17 || expect_pop()) {
+		fprintf(stderr, "clean left %u completions of the other QP\n",
+			polled);
+		return 1;
+	}
+
+	/* And the CQ keeps working */
+	qps[0].destroyed = false;
+	completions = min_t(uint64_t, completions, 100000);
+	expect_head = expect_tail = 0;
+	for (i = 0; i < CQ_TEST_NQP; i++) {
+		qps[i].qp.rq.tail = 0;
+		qps[i].polled = qps[i].hw_done = 0;
+	}
+	while (polled < completions) {
+		produce(CQ_TEST_MAX_SESSION);
+		ne = consume_verbs(16);
+		if (ne < 0)
+			return 1;
+		polled += ne;
+	}
+
+	return 0;
+}
+
+/* ns per completion polling a full CQ, in sessions of n or plain if 1 */
+static double bench(uint32_t n, unsigned int rounds)
+{
+	struct ibv_wc wc[16];
+	double start, total = 0;
+	unsigned int r;
+	uint32_t done;
+
+	setup();
+
+	for (r = 0; r < rounds; r++) {
+		while (prod + n - cq.cons_index <= CQ_TEST_NENT) {
+			if (n == 1)
+				post_plain(&qps[0]);
+			else
+				post_session(&qps[0], n);
+		}
+		expect_head = expect_tail;
+
+		done = 0;
+		start = now_ns();
+		while (cq.cons_index != prod)
+			done += mlx5_poll_cq(&cq.verbs_cq.cq, 16, wc);
+		total += (now_ns() - start) / done;
+	}
+
+	return total / rounds;
+}
+
+static void show_usage(char *program)
+{
+	printf("usage: %s [options]\n", program);
+	printf("   [-n completions] - completions per check (default 1000000)\n");
+}
+
+int main(int argc, char **argv)
+{
+	static const uint8_t formats[] = {
+		MLX5DV_CQE_RES_FORMAT_HASH,
+		MLX5DV_CQE_RES_FORMAT_CSUM,
+		MLX5DV_CQE_RES_FORMAT_CSUM_STRIDX,
+	};
+	static const char * const format_names[] = {
+		"hash", "csum", "csum_stridx",
+	};
+	uint64_t n;
+	int op, i;
+
+	while ((op = getopt(argc, argv, "n:")) != -1) {
+		switch (op) {
+		case 'n':
+			completions = strtoull(optarg, NULL, 0);
+			break;
+		default:
+			show_usage(argv[0]);
+			exit(1);
+		}
+	}
+
+	if (!completions) {
+		show_usage(argv[0]);
+		exit(1);
+	}
+
+	srandom(time(NULL));
+
+	n = completions;
+	for (cqe_sz = 64; cqe_sz <= 128; cqe_sz *= 2) {
+		for (i = 0; i < ARRAY_SIZE(formats); i++) {
+			format = formats[i];
+			completions = n;
+			if (run_stream() || run_clean()) {
+				fprintf(stderr, "%dB CQEs, %s mini CQEs failed\n",
+					cqe_sz, format_names[i]);
+				return 1;
+			}
+		}
+	}
+	printf("compressed CQEs poll as written\n");
+
+	cqe_sz = 64;
+	format = MLX5DV_CQE_RES_FORMAT_CSUM;
+	printf("%-14s %.1f ns per completion\n", "plain", bench(1, 1000));
+	printf("%-14s %.1f ns per completion\n", "sessions of 8", bench(8, 1000));
+	printf("%-14s %.1f ns per completion\n", "sessions of 64",
+	       bench(64, 1000));
+
+	return 0;
+}
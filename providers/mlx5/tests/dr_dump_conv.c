@@ -0,0 +1,60 @@
+/* GPLv2 or OpenIB.org BSD (MIT) See COPYING file */
+
+/*
+ * Converts a binary mlx5 software steering dump, as written by
+ * mlx5dv_dump_dr_domain_ex() with MLX5DV_DUMP_DR_FLAGS_BINARY, to the text
+ * format of mlx5dv_dump_dr_domain(), for the tools that parse that one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "../dr_dump.h"
+
+static void show_usage(char *program)
+{
+	printf("usage: %s [options] [binary dump]\n", program);
+	printf("   [-o file]        - text output (default stdout)\n");
+	printf("Reads stdin when no binary dump is given.\n");
+}
+
+int main(int argc, char **argv)
+{
+	FILE *in = stdin, *out = stdout;
+	int op, ret;
+
+	while ((op = getopt(argc, argv, "o:")) != -1) {
+		switch (op) {
+		case 'o':
+			out = fopen(optarg, "w");
+			if (!out) {
+				perror(optarg);
+				exit(1);
+			}
+			break;
+		default:
+			show_usage(argv[0]);
+			exit(1);
+		}
+	}
+
+	if (optind < argc) {
+		in = fopen(argv[optind], "r");
+		if (!in) {
+			perror(argv[optind]);
+			exit(1);
+		}
+	}
+
+	ret = dr_dump_bin_to_text(in, out);
+	if (ret)
+		fprintf(stderr, "conversion failed: %s\n", strerror(ret));
+
+	if (fclose(out) && !ret) {
+		perror("fclose");
+		ret = 1;
+	}
+	return ret ? 1 : 0;
+}
@@ -0,0 +1,812 @@
+/* GPLv2 or OpenIB.org BSD (MIT) See COPYING file */
+
+/*
+ * Mock device for mlx5 software steering.  Provides the verbs, DV and DEVX
+ * calls the dr_* sources make, backed by host memory, so domains, tables,
+ * matchers and rules can be created without hardware:
+ *
+ *  - QUERY_HCA_CAP answers with the caps of a NIC supporting SW steering in
+ *    the requested STE format, other general commands succeed or fail with
+ *    EOPNOTSUPP.
+ *  - Steering and modify header ICM is anonymous host memory, placed at
+ *    aligned fake ICM addresses and registered as zero based MRs.
+ *  - The send ring QPs and CQs live in host memory as usual.  Ringing a
+ *    doorbell executes the posted RDMA writes and reads with memcpy and
+ *    writes a CQE for every signaled WQE, so the rings see their completions
+ *    on the next poll.  A WQE whose key or range matches no MR completes in
+ *    error.
+ *
+ * A single device is supported at a time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+#include "dr_mock.h"
+#include "../mlx5dv_dr.h"
+#include "../mlx5_ifc.h"
+
+#define MOCK_MAX_MRS		1024
+#define MOCK_MAX_UMEMS		256
+#define MOCK_MAX_QPS		64
+#define MOCK_QPN_BASE		0x100
+#define MOCK_MAX_CQS		64
+#define MOCK_ICM_BASE		(1ULL << 40)
+
+/* Host memory registered under a key, addressed from va on */
+struct mock_mr {
+	void			*host;
+	uint64_t		va;
+	size_t			length;
+	bool			valid;
+};
+
+struct mock_umem {
+	struct mlx5dv_devx_umem	umem;
+	void			*addr;
+	size_t			size;
+};
+
+struct mock_cq {
+	struct ibv_cq		ibv_cq;
+	struct mlx5_cqe64	*buf;
+	__be32			dbrec[2];
+	uint32_t		cqn;
+	uint32_t		ncqe;
+	uint32_t		pi;
+};
+
+struct mock_qp {
+	void			*sq;
+	uint32_t		sq_size;
+	uint32_t		wqe_cnt;
+	__be32			*db;
+	struct mock_cq		*cq;
+	uint16_t		ci;
+	bool			valid;
+};
+
+struct mock_obj {
+	struct mlx5dv_devx_obj	obj;
+	uint16_t		opcode;
+	uint64_t		icm_root_0;
+	uint64_t		icm_root_1;
+};
+
+static struct mock_device {
+	struct mlx5_context	mctx;
+	struct ibv_device	device;
+	uint8_t			sw_format_ver;
+	uint64_t		next_icm;
+	uint32_t		next_obj_id;
+	uint64_t		wqe_errors;
+} *mock;
+
+static struct mock_mr mock_mrs[MOCK_MAX_MRS];
+static struct mock_umem *mock_umems[MOCK_MAX_UMEMS];
+static struct mock_qp mock_qps[MOCK_MAX_QPS];
+static struct mock_cq *mock_cqs[MOCK_MAX_CQS];
+
+static uint32_t mock_mr_add(void *host, uint64_t va, size_t length)
+{
+	uint32_t i;
+
+	/* Key 0 is the inline data of a WQE */
+	for (i = 1; i < MOCK_MAX_MRS; i++) {
+		if (mock_mrs[i].valid)
+			continue;
+
+		mock_mrs[i].host = host;
+		mock_mrs[i].va = va;
+		mock_mrs[i].length = length;
+		mock_mrs[i].valid = true;
+		return i;
+	}
+	return 0;
+}
+
+void *dr_mock_icm_ptr(uint32_t key, uint64_t addr, size_t len)
+{
+	struct mock_mr *mr;
+
+	if (!key || key >= MOCK_MAX_MRS)
+		return NULL;
+
+	mr = &mock_mrs[key];
+	if (!mr->valid || addr < mr->va || addr + len > mr->va + mr->length)
+		return NULL;
+
+	return mr->host + (addr - mr->va);
+}
+
+uint64_t dr_mock_wqe_errors(void)
+{
+	return mock->wqe_errors;
+}
+
+/* Copy out of the SQ, wrapping at its end like the inline data does */
+static void mock_sq_copy(struct mock_qp *qp, void *dst, uint32_t off,
+			 uint32_t len)
+{
+	uint32_t copy;
+
+	off &= qp->sq_size - 1;
+	copy = min_t(uint32_t, len, qp->sq_size - off);
+	memcpy(dst, qp->sq + off, copy);
+	memcpy(dst + copy, qp->sq, len - copy);
+}
+
+static void mock_post_cqe(struct mock_cq *cq, uint16_t wqe_counter,
+			  uint8_t opcode)
+{
+	struct mlx5_cqe64 *cqe = &cq->buf[cq->pi & (cq->ncqe - 1)];
+
+	memset(cqe, 0, sizeof(*cqe) - 1);
+	cqe->wqe_counter = htobe16(wqe_counter);
+	__atomic_store_n(&cqe->op_own,
+			 opcode << 4 | !!(cq->pi & cq->ncqe), __ATOMIC_RELEASE);
+	cq->pi++;
+}
+
+/* Execute one RDMA write or read WQE, returns false on a bad access */
+static bool mock_exec_wqe(struct mock_qp *qp, uint32_t off, uint8_t opcode)
+{
+	struct mlx5_wqe_raddr_seg raddr;
+	struct mlx5_wqe_data_seg dseg;
+	uint32_t byte_count, len;
+	void *remote, *local;
+
+	mock_sq_copy(qp, &raddr, off + sizeof(struct mlx5_wqe_ctrl_seg),
+		     sizeof(raddr));
+	off += sizeof(struct mlx5_wqe_ctrl_seg) + sizeof(raddr);
+	mock_sq_copy(qp, &byte_count, off, sizeof(byte_count));
+
+	if (be32toh(byte_count) & MLX5_INLINE_SEG) {
+		len = be32toh(byte_count) & ~MLX5_INLINE_SEG;
+		remote = dr_mock_icm_ptr(be32toh(raddr.rkey),
+					 be64toh(raddr.raddr), len);
+		if (!remote || opcode != MLX5_OPCODE_RDMA_WRITE)
+			return false;
+
+		mock_sq_copy(qp, remote, off + sizeof(byte_count), len);
+		return true;
+	}
+
+	mock_sq_copy(qp, &dseg, off, sizeof(dseg));
+	len = be32toh(dseg.byte_count);
+	remote = dr_mock_icm_ptr(be32toh(raddr.rkey), be64toh(raddr.raddr), len);
+	local = dr_mock_icm_ptr(be32toh(dseg.lkey), be64toh(dseg.addr), len);
+	if (!remote || !local)
+		return false;
+
+	if (opcode == MLX5_OPCODE_RDMA_WRITE)
+		memcpy(remote, local, len);
+	else if (opcode == MLX5_OPCODE_RDMA_READ)
+		memcpy(local, remote, len);
+	else
+		return false;
+
+	return true;
+}
+
+/* Run the WQEs posted up to the doorbell record */
+static void mock_qp_process(struct mock_qp *qp)
+{
+	struct mlx5_wqe_ctrl_seg ctrl;
+	uint32_t opmod_idx_opcode;
+	uint16_t pi;
+	uint32_t off;
+	bool ok;
+
+	pi = be32toh(__atomic_load_n(&qp->db[MLX5_SND_DBR],
+				     __ATOMIC_ACQUIRE)) & 0xffff;
+
+	while (qp->ci != pi) {
+		off = (qp->ci & (qp->wqe_cnt - 1)) * MLX5_SEND_WQE_BB;
+		memcpy(&ctrl, qp->sq + off, sizeof(ctrl));
+		opmod_idx_opcode = be32toh(ctrl.opmod_idx_opcode);
+
+		ok = mock_exec_wqe(qp, off, opmod_idx_opcode & 0xff);
+		if (!ok) {
+			mock->wqe_errors++;
+			fprintf(stderr, "mock: bad WQE 0x%x on QP %u\n",
+				qp->ci, be32toh(ctrl.qpn_ds) >> 8);
+		}
+
+		if (!ok || ctrl.fm_ce_se & MLX5_WQE_CTRL_CQ_UPDATE)
+			mock_post_cqe(qp->cq, opmod_idx_opcode >> 8,
+				      ok ? MLX5_CQE_REQ : MLX5_CQE_REQ_ERR);
+
+		qp->ci += DIV_ROUND_UP((be32toh(ctrl.qpn_ds) & 0x3f) * 16,
+				       MLX5_SEND_WQE_BB);
+	}
+}
+
+/* The doorbell carries the first 8 bytes of the last ctrl segment */
+void dr_mock_mmio_write64_be(void *addr, __be64 val)
+{
+	uint32_t qpn = (be64toh(val) & 0xffffffff) >> 8;
+
+	if (qpn < MOCK_QPN_BASE || qpn >= MOCK_QPN_BASE + MOCK_MAX_QPS ||
+	    !mock_qps[qpn - MOCK_QPN_BASE].valid) {
+		fprintf(stderr, "mock: doorbell on unknown QP %u\n", qpn);
+		abort();
+	}
+
+	mock_qp_process(&mock_qps[qpn - MOCK_QPN_BASE]);
+}
+
+static int mock_query_device_ex(struct ibv_context *context,
+				const struct ibv_query_device_ex_input *input,
+				struct ibv_device_attr_ex *attr,
+				size_t attr_size)
+{
+	memset(attr, 0, attr_size);
+	attr->orig_attr.phys_port_cnt = 1;
+	attr->phys_port_cnt_ex = 1;
+	return 0;
+}
+
+static int mock_query_port(struct ibv_context *context, uint8_t port_num,
+			   struct ibv_port_attr *port_attr, size_t port_attr_len)
+{
+	memset(port_attr, 0, port_attr_len);
+	port_attr->state = IBV_PORT_ACTIVE;
+	port_attr->link_layer = IBV_LINK_LAYER_ETHERNET;
+	return 0;
+}
+
+static struct ibv_mr *mock_reg_dm_mr(struct ibv_pd *pd, struct ibv_dm *ibdm,
+				     uint64_t dm_offset, size_t length,
+				     unsigned int access)
+{
+	struct mlx5_dm *dm = to_mdm(ibdm);
+	struct ibv_mr *mr;
+
+	if (dm_offset + length > dm->length) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	mr = calloc(1, sizeof(*mr));
+	if (!mr) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	/* Zero based, like DR registers its ICM */
+	mr->lkey = mr->rkey = mock_mr_add(dm->start_va + dm_offset, 0, length);
+	if (!mr->lkey) {
+		free(mr);
+		errno = ENOMEM;
+		return NULL;
+	}
+	mr->context = pd->context;
+	mr->pd = pd;
+	mr->length = length;
+	return mr;
+}
+
+struct ibv_context *dr_mock_open_device(uint8_t sw_format_ver)
+{
+	struct verbs_context *vctx;
+
+	if (mock || sw_format_ver > MLX5_HW_CONNECTX_7) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	mock = calloc(1, sizeof(*mock));
+	if (!mock) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	mock->sw_format_ver = sw_format_ver;
+	mock->next_icm = MOCK_ICM_BASE;
+	mock->next_obj_id = 1;
+	snprintf(mock->device.name, sizeof(mock->device.name), "mock0");
+	snprintf(mock->device.dev_name, sizeof(mock->device.dev_name), "mock0");
+
+	vctx = &mock->mctx.ibv_ctx;
+	vctx->sz = sizeof(*vctx);
+	vctx->context.device = &mock->device;
+	vctx->context.abi_compat = __VERBS_ABI_IS_EXTENDED;
+	vctx->query_device_ex = mock_query_device_ex;
+	vctx->query_port = mock_query_port;
+	vctx->reg_dm_mr = mock_reg_dm_mr;
+
+	return &vctx->context;
+}
+
+void dr_mock_close_device(struct ibv_context *ctx)
+{
+	free(mock);
+	mock = NULL;
+}
+
+int mlx5_get_cmd_status_err(int err, void *out)
+{
+	return err;
+}
+
+static void mock_query_hca_cap(uint16_t op_mod, void *out)
+{
+	void *cap = DEVX_ADDR_OF(query_hca_cap_out, out, capability);
+
+	switch (op_mod & ~HCA_CAP_OPMOD_GET_CUR) {
+	case MLX5_SET_HCA_CAP_OP_MOD_GENERAL_DEVICE:
+		DEVX_SET(cmd_hca_cap, cap, vhca_id, 1);
+		DEVX_SET(cmd_hca_cap, cap, roce, 1);
+		DEVX_SET(cmd_hca_cap, cap, steering_format_version,
+			 mock->sw_format_ver);
+		DEVX_SET(cmd_hca_cap, cap, flex_parser_protocols,
+			 MLX5_FLEX_PARSER_GTPU_ENABLED |
+			 MLX5_FLEX_PARSER_GTPU_TEID_ENABLED);
+		DEVX_SET(cmd_hca_cap, cap, flex_parser_id_gtpu_teid, 3);
+		break;
+	case MLX5_SET_HCA_CAP_OP_MOD_NIC_FLOW_TABLE:
+		DEVX_SET64(flow_table_nic_cap, cap,
+			   sw_steering_nic_rx_action_drop_icm_address,
+			   MOCK_ICM_BASE - 0x1000);
+		DEVX_SET64(flow_table_nic_cap, cap,
+			   sw_steering_nic_tx_action_drop_icm_address,
+			   MOCK_ICM_BASE - 0x2000);
+		DEVX_SET64(flow_table_nic_cap, cap,
+			   sw_steering_nic_tx_action_allow_icm_address,
+			   MOCK_ICM_BASE - 0x3000);
+		DEVX_SET(flow_table_nic_cap, cap,
+			 flow_table_properties_nic_receive.sw_owner, 1);
+		DEVX_SET(flow_table_nic_cap, cap,
+			 flow_table_properties_nic_transmit.sw_owner, 1);
+		DEVX_SET(flow_table_nic_cap, cap,
+			 flow_table_properties_nic_receive.max_ft_level, 64);
+		break;
+	case MLX5_SET_HCA_CAP_OP_MOD_DEVICE_MEMORY:
+		DEVX_SET(device_mem_cap, cap, log_steering_sw_icm_size, 32);
+		DEVX_SET64(device_mem_cap, cap,
+			   header_modify_sw_icm_start_address,
+			   MOCK_ICM_BASE / 2);
+		DEVX_SET(device_mem_cap, cap, log_header_modify_sw_icm_size,
+			 24);
+		break;
+	case MLX5_SET_HCA_CAP_OP_MOD_ROCE:
+		DEVX_SET(roce_cap, cap, fl_rc_qp_when_roce_enabled, 1);
+		break;
+	}
+}
+
+int mlx5dv_devx_general_cmd(struct ibv_context *context, const void *in,
+			    size_t inlen, void *out, size_t outlen)
+{
+	memset(out, 0, outlen);
+
+	switch (DEVX_GET(query_hca_cap_in, in, opcode)) {
+	case MLX5_CMD_OP_QUERY_HCA_CAP:
+		mock_query_hca_cap(DEVX_GET(query_hca_cap_in, in, op_mod), out);
+		return 0;
+	case MLX5_CMD_OP_QUERY_NIC_VPORT_CONTEXT:
+		DEVX_SET(query_nic_vport_context_out, out,
+			 nic_vport_context.roce_en, 1);
+		return 0;
+	case MLX5_CMD_OP_SYNC_STEERING:
+		return 0;
+	}
+
+	errno = EOPNOTSUPP;
+	return EOPNOTSUPP;
+}
+
+static int mock_qp_create(const void *in)
+{
+	const void *qpc = DEVX_ADDR_OF(create_qp_in, in, qpc);
+	uint32_t rq_size, cqn, i;
+	struct mock_umem *buf, *db;
+	struct mock_qp *qp;
+
+	buf = mock_umems[DEVX_GET(create_qp_in, in, wq_umem_id)];
+	db = mock_umems[DEVX_GET(qpc, qpc, dbr_umem_id)];
+	cqn = DEVX_GET(qpc, qpc, cqn_snd);
+	if (!buf || !db || cqn >= MOCK_MAX_CQS || !mock_cqs[cqn])
+		return -1;
+
+	for (i = 0; i < MOCK_MAX_QPS; i++)
+		if (!mock_qps[i].valid)
+			break;
+	if (i == MOCK_MAX_QPS)
+		return -1;
+
+	qp = &mock_qps[i];
+	memset(qp, 0, sizeof(*qp));
+	/* The RQ comes first, at least a WQE basic block */
+	rq_size = (1 << DEVX_GET(qpc, qpc, log_rq_size)) <<
+		  (DEVX_GET(qpc, qpc, log_rq_stride) + 4);
+	rq_size = max_t(uint32_t, rq_size, MLX5_SEND_WQE_BB);
+	qp->wqe_cnt = 1 << DEVX_GET(qpc, qpc, log_sq_size);
+	qp->sq_size = qp->wqe_cnt * MLX5_SEND_WQE_BB;
+	qp->sq = buf->addr + rq_size;
+	qp->db = db->addr;
+	qp->cq = mock_cqs[cqn];
+	qp->valid = true;
+
+	return MOCK_QPN_BASE + i;
+}
+
+struct mlx5dv_devx_obj *
+mlx5dv_devx_obj_create(struct ibv_context *context, const void *in,
+		       size_t inlen, void *out, size_t outlen)
+{
+	const void *ft_ctx;
+	struct mock_obj *mobj;
+	int qpn;
+
+	mobj = calloc(1, sizeof(*mobj));
+	if (!mobj) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	memset(out, 0, outlen);
+	mobj->obj.context = context;
+	mobj->opcode = DEVX_GET(query_hca_cap_in, in, opcode);
+	mobj->obj.object_id = mock->next_obj_id++;
+
+	switch (mobj->opcode) {
+	case MLX5_CMD_OP_CREATE_QP:
+		qpn = mock_qp_create(in);
+		if (qpn < 0) {
+			free(mobj);
+			errno = EINVAL;
+			return NULL;
+		}
+		mobj->obj.object_id = qpn;
+		break;
+	case MLX5_CMD_OP_CREATE_FLOW_TABLE:
+		ft_ctx = DEVX_ADDR_OF(create_flow_table_in, in,
+				      flow_table_context);
+		mobj->icm_root_0 = DEVX_GET64(flow_table_context, ft_ctx,
+					      sw_owner_icm_root_0);
+		mobj->icm_root_1 = DEVX_GET64(flow_table_context, ft_ctx,
+					      sw_owner_icm_root_1);
+		DEVX_SET(create_flow_table_out, out, table_id,
+			 mobj->obj.object_id);
+		break;
+	}
+
+	return &mobj->obj;
+}
+
+int mlx5dv_devx_obj_query(struct mlx5dv_devx_obj *obj, const void *in,
+			  size_t inlen, void *out, size_t outlen)
+{
+	struct mock_obj *mobj = container_of(obj, struct mock_obj, obj);
+
+	memset(out, 0, outlen);
+	if (mobj->opcode != MLX5_CMD_OP_CREATE_FLOW_TABLE)
+		return EOPNOTSUPP;
+
+	DEVX_SET64(query_flow_table_out, out,
+		   flow_table_context.sw_owner_icm_root_0, mobj->icm_root_0);
+	DEVX_SET64(query_flow_table_out, out,
+		   flow_table_context.sw_owner_icm_root_1, mobj->icm_root_1);
+	return 0;
+}
+
+int mlx5dv_devx_obj_modify(struct mlx5dv_devx_obj *obj, const void *in,
+			   size_t inlen, void *out, size_t outlen)
+{
+	memset(out, 0, outlen);
+	return 0;
+}
+
+int mlx5dv_devx_obj_destroy(struct mlx5dv_devx_obj *obj)
+{
+	struct mock_obj *mobj = container_of(obj, struct mock_obj, obj);
+
+	if (mobj->opcode == MLX5_CMD_OP_CREATE_QP)
+		mock_qps[obj->object_id - MOCK_QPN_BASE].valid = false;
+
+	free(mobj);
+	return 0;
+}
+
+struct mlx5dv_devx_umem *
+mlx5dv_devx_umem_reg(struct ibv_context *ctx, void *addr, size_t size,
+		     uint32_t access)
+{
+	struct mock_umem *umem;
+	uint32_t i;
+
+	/* Id 0 is never handed out */
+	for (i = 1; i < MOCK_MAX_UMEMS; i++)
+		if (!mock_umems[i])
+			break;
+	if (i == MOCK_MAX_UMEMS) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	umem = calloc(1, sizeof(*umem));
+	if (!umem) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	umem->umem.umem_id = i;
+	umem->addr = addr;
+	umem->size = size;
+	mock_umems[i] = umem;
+	return &umem->umem;
+}
+
+int mlx5dv_devx_umem_dereg(struct mlx5dv_devx_umem *dv_umem)
+{
+	struct mock_umem *umem = container_of(dv_umem, struct mock_umem, umem);
+
+	mock_umems[dv_umem->umem_id] = NULL;
+	free(umem);
+	return 0;
+}
+
+struct mlx5dv_devx_uar *mlx5dv_devx_alloc_uar(struct ibv_context *context,
+					      uint32_t flags)
+{
+	struct mlx5_bf *bf;
+
+	bf = calloc(1, sizeof(*bf));
+	if (!bf) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	/* Doorbells never reach the register, see dr_mock.h */
+	bf->nc_mode = 1;
+	bf->devx_uar.context = context;
+	bf->devx_uar.dv_devx_uar.page_id = 1;
+	return &bf->devx_uar.dv_devx_uar;
+}
+
+void mlx5dv_devx_free_uar(struct mlx5dv_devx_uar *devx_uar)
+{
+	free(container_of(devx_uar, struct mlx5_bf, devx_uar.dv_devx_uar));
+}
+
+struct ibv_dm *mlx5dv_alloc_dm(struct ibv_context *context,
+			       struct ibv_alloc_dm_attr *dm_attr,
+			       struct mlx5dv_alloc_dm_attr *mlx5_dm_attr)
+{
+	uint64_t icm_align = roundup_pow_of_two(dm_attr->length);
+	struct mlx5_dm *dm;
+
+	dm = calloc(1, sizeof(*dm));
+	if (!dm) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	/* Untouched ICM costs no host memory */
+	dm->start_va = mmap(NULL, dm_attr->length, PROT_READ | PROT_WRITE,
+			    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (dm->start_va == MAP_FAILED) {
+		free(dm);
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	dm->length = dm_attr->length;
+	dm->remote_va = align(mock->next_icm, icm_align);
+	mock->next_icm = dm->remote_va + dm->length;
+	dm->verbs_dm.dm.context = context;
+	return &dm->verbs_dm.dm;
+}
+
+int mlx5_free_dm(struct ibv_dm *ibdm)
+{
+	struct mlx5_dm *dm = to_mdm(ibdm);
+
+	munmap(dm->start_va, dm->length);
+	free(dm);
+	return 0;
+}
+
+struct ibv_pd *ibv_alloc_pd(struct ibv_context *context)
+{
+	struct ibv_pd *pd;
+
+	pd = calloc(1, sizeof(*pd));
+	if (!pd) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	pd->context = context;
+	pd->handle = 1;
+	return pd;
+}
+
+int ibv_dealloc_pd(struct ibv_pd *pd)
+{
+	free(pd);
+	return 0;
+}
+
+struct ibv_mr *(ibv_reg_mr)(struct ibv_pd *pd, void *addr, size_t length,
+			    int access)
+{
+	struct ibv_mr *mr;
+
+	mr = calloc(1, sizeof(*mr));
+	if (!mr) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	mr->lkey = mr->rkey = mock_mr_add(addr, (uintptr_t)addr, length);
+	if (!mr->lkey) {
+		free(mr);
+		errno = ENOMEM;
+		return NULL;
+	}
+	mr->context = pd->context;
+	mr->pd = pd;
+	mr->addr = addr;
+	mr->length = length;
+	return mr;
+}
+
+int ibv_dereg_mr(struct ibv_mr *mr)
+{
+	mock_mrs[mr->lkey].valid = false;
+	free(mr);
+	return 0;
+}
+
+struct ibv_cq *ibv_create_cq(struct ibv_context *context, int cqe,
+			     void *cq_context,
+			     struct ibv_comp_channel *channel,
+			     int comp_vector)
+{
+	struct mock_cq *cq;
+	uint32_t i, cqn;
+
+	/* CQN 0 is never handed out */
+	for (cqn = 1; cqn < MOCK_MAX_CQS; cqn++)
+		if (!mock_cqs[cqn])
+			break;
+	if (cqn == MOCK_MAX_CQS) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	cq = calloc(1, sizeof(*cq));
+	if (!cq) {
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	cq->ncqe = roundup_pow_of_two(cqe);
+	cq->buf = calloc(cq->ncqe, sizeof(*cq->buf));
+	if (!cq->buf) {
+		free(cq);
+		errno = ENOMEM;
+		return NULL;
+	}
+	for (i = 0; i < cq->ncqe; i++)
+		cq->buf[i].op_own = MLX5_CQE_INVALID << 4;
+
+	cq->cqn = cqn;
+	cq->ibv_cq.context = context;
+	cq->ibv_cq.cqe = cq->ncqe - 1;
+	mock_cqs[cqn] = cq;
+	return &cq->ibv_cq;
+}
+
+int ibv_destroy_cq(struct ibv_cq *ibcq)
+{
+	struct mock_cq *cq = container_of(ibcq, struct mock_cq, ibv_cq);
+
+	mock_cqs[cq->cqn] = NULL;
+	free(cq->buf);
+	free(cq);
+	return 0;
+}
+
+int mlx5dv_init_obj(struct mlx5dv_obj *obj, uint64_t obj_type)
+{
+	struct mock_cq *cq;
+
+	if (obj_type & MLX5DV_OBJ_CQ) {
+		cq = container_of(obj->cq.in, struct mock_cq, ibv_cq);
+		memset(obj->cq.out, 0, sizeof(*obj->cq.out));
+		obj->cq.out->buf = cq->buf;
+		obj->cq.out->dbrec = cq->dbrec;
+		obj->cq.out->cqe_cnt = cq->ncqe;
+		obj->cq.out->cqe_size = sizeof(*cq->buf);
+		obj->cq.out->cqn = cq->cqn;
+	}
+
+	if (obj_type & MLX5DV_OBJ_PD) {
+		memset(obj->pd.out, 0, sizeof(*obj->pd.out));
+		obj->pd.out->pdn = obj->pd.in->handle;
+	}
+
+	return 0;
+}
+
+const char *ibv_get_device_name(struct ibv_device *device)
+{
+	return device->name;
+}
+
+/* Only root tables use these, which need the kernel */
+
+int ibv_query_device(struct ibv_context *context,
+		     struct ibv_device_attr *device_attr)
+{
+	return EOPNOTSUPP;
+}
+
+int (ibv_query_port)(struct ibv_context *context, uint8_t port_num,
+		     struct _compat_ibv_port_attr *port_attr)
+{
+	return EOPNOTSUPP;
+}
+
+int _mlx5dv_query_port(struct ibv_context *context, uint32_t port_num,
+		       struct mlx5dv_port *info, size_t info_len)
+{
+	return EOPNOTSUPP;
+}
+
+struct mlx5dv_flow_matcher *
+mlx5dv_create_flow_matcher(struct ibv_context *context,
+			   struct mlx5dv_flow_matcher_attr *matcher_attr)
+{
+	errno = EOPNOTSUPP;
+	return NULL;
+}
+
+int mlx5dv_destroy_flow_matcher(struct mlx5dv_flow_matcher *matcher)
+{
+	return EOPNOTSUPP;
+}
+
+struct ibv_flow *
+_mlx5dv_create_flow(struct mlx5dv_flow_matcher *flow_matcher,
+		    struct mlx5dv_flow_match_parameters *match_value,
+		    size_t num_actions,
+		    struct mlx5dv_flow_action_attr actions_attr[],
+		    struct mlx5_flow_action_attr_aux actions_attr_aux[])
+{
+	errno = EOPNOTSUPP;
+	return NULL;
+}
+
+struct ibv_flow_action *
+mlx5dv_create_flow_action_modify_header(struct ibv_context *ctx,
+					size_t actions_sz,
+					uint64_t actions[],
+					enum mlx5dv_flow_table_type ft_type)
+{
+	errno = EOPNOTSUPP;
+	return NULL;
+}
+
+struct ibv_flow_action *
+mlx5dv_create_flow_action_packet_reformat(struct ibv_context *ctx,
+					  size_t data_sz,
+					  void *data,
+					  enum mlx5dv_flow_action_packet_reformat_type reformat_type,
+					  enum mlx5dv_flow_table_type ft_type)
+{
+	errno = EOPNOTSUPP;
+	return NULL;
+}
+
+int mlx5_destroy_flow_action(struct ibv_flow_action *action)
+{
+	return EOPNOTSUPP;
+}
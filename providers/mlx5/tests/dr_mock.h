@@ -0,0 +1,32 @@
+/* GPLv2 or OpenIB.org BSD (MIT) See COPYING file */
+
+/*
+ * Mock device for running mlx5 software steering without hardware, see
+ * dr_mock.c.  This header is force included in every source of the mock
+ * build, so the doorbell writes of the DR send rings reach the mock instead
+ * of a UAR page.
+ */
+
+#ifndef DR_MOCK_H
+#define DR_MOCK_H
+
+#include <config.h>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <util/mmio.h>
+
+struct ibv_context;
+
+struct ibv_context *dr_mock_open_device(uint8_t sw_format_ver);
+void dr_mock_close_device(struct ibv_context *ctx);
+
+/* Host memory behind an ICM range, NULL if no MR covers it */
+void *dr_mock_icm_ptr(uint32_t rkey, uint64_t addr, size_t len);
+/* Number of WQEs completed in error so far */
+uint64_t dr_mock_wqe_errors(void);
+
+void dr_mock_mmio_write64_be(void *addr, __be64 val);
+#define mmio_write64_be(addr, val) dr_mock_mmio_write64_be(addr, val)
+
+#endif
@@ -0,0 +1,458 @@
+/* GPLv2 or OpenIB.org BSD (MIT) See COPYING file */
+
+/*
+ * Offline benchmark for mlx5 software steering.  Runs the DR sources against
+ * the mock device of dr_mock.c, which keeps the steering ICM in host memory
+ * and executes the send ring WQEs when their doorbell is rung, so the whole
+ * insertion pipeline from the STE builders to the ICM writes runs on any
+ * machine, for any STE format.  Reports the matcher create and destroy rate,
+ * the insertion rate and latency percentiles for one of a few rule shapes,
+ * where the maximum covers the growth of the matcher hash table, and the
+ * deletion rate.  The latencies are also reported in thread CPU time, which
+ * leaves out the time the thread was not running on a loaded host.  With -c, checks before deleting that the ICM of every rule
+ * holds what the STE shadows say was written.  With -d, dumps the domain in
+ * the text and the binary format and reports the time and size of each.
+ *
+ * The numbers leave out the device, so they measure the host side only.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <ccan/array_size.h>
+
+#include "dr_mock.h"
+#include "../mlx5dv_dr.h"
+#include "../mlx5_ifc.h"
+
+enum bench_shape {
+	SHAPE_5TUPLE,
+	SHAPE_VXLAN,
+	SHAPE_GTPU,
+};
+
+static const char * const shape_names[] = {
+	[SHAPE_5TUPLE]	= "5tuple",
+	[SHAPE_VXLAN]	= "vxlan",
+	[SHAPE_GTPU]	= "gtpu",
+};
+
+static uint8_t sw_format_ver = MLX5_HW_CONNECTX_6DX;
+static enum bench_shape shape;
+static size_t num_rules = 100000;
+static size_t num_matchers = 1000;
+static bool check;
+static char *dump_prefix;
+
+static double clock_us(clockid_t clock)
+{
+	struct timespec ts;
+
+	clock_gettime(clock, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static double now_us(void)
+{
+	return clock_us(CLOCK_MONOTONIC);
+}
+
+static double cpu_us(void)
+{
+	return clock_us(CLOCK_THREAD_CPUTIME_ID);
+}
+
+/* The mask when mask is set, else the value of rule i */
+static struct mlx5dv_flow_match_parameters *alloc_match(bool mask, uint32_t i)
+{
+	struct mlx5dv_flow_match_parameters *match;
+	size_t sz = DEVX_ST_SZ_BYTES(dr_match_param);
+	void *outer, *inner, *misc, *misc3;
+
+	match = calloc(1, sizeof(*match) + sz);
+	if (!match)
+		return NULL;
+
+	match->match_sz = sz;
+	outer = DEVX_ADDR_OF(dr_match_param, match->match_buf, outer);
+	inner = DEVX_ADDR_OF(dr_match_param, match->match_buf, inner);
+	misc = DEVX_ADDR_OF(dr_match_param, match->match_buf, misc);
+	misc3 = DEVX_ADDR_OF(dr_match_param, match->match_buf, misc3);
+
+	/* IPv4 outer headers, mask and value alike */
+	DEVX_SET(dr_match_spec, outer, ip_version, 4);
+
+	switch (shape) {
+	case SHAPE_5TUPLE:
+		DEVX_SET(dr_match_spec, outer, ip_protocol, mask ? 0xff : 6);
+		DEVX_SET(dr_match_spec, outer, src_ip_31_0,
+			 mask ? 0xffffffff : 0x0a000000 + i);
+		DEVX_SET(dr_match_spec, outer, dst_ip_31_0,
+			 mask ? 0xffffffff : 0x0b000000 + (i >> 16));
+		DEVX_SET(dr_match_spec, outer, tcp_sport,
+			 mask ? 0xffff : 1024 + (i & 0x3ff));
+		DEVX_SET(dr_match_spec, outer, tcp_dport, mask ? 0xffff : 80);
+		break;
+	case SHAPE_VXLAN:
+		DEVX_SET(dr_match_spec, outer, ip_protocol, mask ? 0xff : 17);
+		DEVX_SET(dr_match_spec, outer, udp_dport, mask ? 0xffff : 4789);
+		DEVX_SET(dr_match_set_misc, misc, vxlan_vni,
+			 mask ? 0xffffff : i & 0xffffff);
+		DEVX_SET(dr_match_spec, inner, dmac_47_16,
+			 mask ? 0xffffffff : 0x0200);
+		DEVX_SET(dr_match_spec, inner, dmac_15_0,
+			 mask ? 0xffff : i >> 24);
+		break;
+	case SHAPE_GTPU:
+		DEVX_SET(dr_match_spec, outer, ip_protocol, mask ? 0xff : 17);
+		DEVX_SET(dr_match_spec, outer, udp_dport, mask ? 0xffff : 2152);
+		DEVX_SET(dr_match_set_misc3, misc3, gtpu_teid,
+			 mask ? 0xffffffff : i);
+		break;
+	}
+	return match;
+}
+
+static uint8_t match_criteria(void)
+{
+	switch (shape) {
+	case SHAPE_VXLAN:
+		return DR_MATCHER_CRITERIA_OUTER | DR_MATCHER_CRITERIA_MISC |
+		       DR_MATCHER_CRITERIA_INNER;
+	case SHAPE_GTPU:
+		return DR_MATCHER_CRITERIA_OUTER | DR_MATCHER_CRITERIA_MISC3;
+	default:
+		return DR_MATCHER_CRITERIA_OUTER;
+	}
+}
+
+static int bench_matchers(struct mlx5dv_dr_table *tbl,
+			  struct mlx5dv_flow_match_parameters *mask)
+{
+	struct mlx5dv_dr_matcher **matchers;
+	double start, create, destroy;
+	size_t i, done;
+
+	matchers = calloc(num_matchers, sizeof(*matchers));
+	if (!matchers)
+		return 1;
+
+	start = now_us();
+	for (done = 0; done < num_matchers; done++) {
+		matchers[done] = mlx5dv_dr_matcher_create(tbl, done + 1,
+							  match_criteria(),
+							  mask);
+		if (!matchers[done])
+			break;
+	}
+	create = now_us() - start;
+
+	start = now_us();
+	for (i = 0; i < done; i++)
+		mlx5dv_dr_matcher_destroy(matchers[i]);
+	destroy = now_us() - start;
+
+	printf("%-8s %zu matchers, create %.0f/s, destroy %.0f/s\n", "matcher",
+	       done, done * 1e6 / create, done * 1e6 / destroy);
+	if (done != num_matchers)
+		fprintf(stderr, "matcher creation failed at %zu: %s\n", done,
+			strerror(errno));
+
+	free(matchers);
+	return done != num_matchers;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Entries of the largest hash table a rule goes through */
+static uint32_t rule_htbl_size(struct mlx5dv_dr_rule *rule)
+{
+	struct dr_ste *ste_arr[DR_RULE_MAX_STES + DR_ACTION_MAX_STES +
+			       DR_ACTION_ASO_CROSS_GVMI_STES];
+	uint32_t size = 0;
+	int i, num;
+
+	dr_rule_get_reverse_rule_members(ste_arr, rule->rx.last_rule_ste, &num);
+	for (i = 0; i < num; i++)
+		size = max(size, ste_arr[i]->htbl->chunk->num_of_entries);
+	return size;
+}
+
+/* Compare the STEs of a rule with what the mock ICM holds */
+static int check_rule(struct mlx5dv_dr_rule *rule)
+{
+	struct dr_ste *ste_arr[DR_RULE_MAX_STES + DR_ACTION_MAX_STES +
+			       DR_ACTION_ASO_CROSS_GVMI_STES];
+	struct dr_ste *ste;
+	uint8_t *icm;
+	size_t len;
+	int i, num;
+
+	dr_rule_get_reverse_rule_members(ste_arr, rule->rx.last_rule_ste, &num);
+	if (!num)
+		return 1;
+
+	for (i = 0; i < num; i++) {
+		ste = ste_arr[i];
+		icm = dr_mock_icm_ptr(ste->htbl->chunk->rkey,
+				      dr_ste_get_mr_addr(ste), DR_STE_SIZE);
+		/*
+		 * The tag and mask of legacy STEs may be swapped on the way
+		 * to the device, the control is written as is.
+		 */
+		len = ste->htbl->type == DR_STE_HTBL_TYPE_MATCH ?
+		      DR_STE_SIZE : DR_STE_SIZE_CTRL;
+		if (!icm || memcmp(icm, dr_ste_get_hw_ste(ste), len))
+			return 1;
+	}
+	return 0;
+}
+
+static int check_rules(struct mlx5dv_dr_matcher *matcher)
+{
+	struct mlx5dv_dr_rule *rule;
+	size_t checked = 0;
+
+	list_for_each(&matcher->rule_list, rule, rule_list) {
+		if (check_rule(rule)) {
+			fprintf(stderr, "rule %zu differs from the ICM\n",
+				checked);
+			return 1;
+		}
+		checked++;
+	}
+
+	printf("%-8s %zu rules match the ICM\n", "check", checked);
+	return 0;
+}
+
+static int dump(struct mlx5dv_dr_domain *dmn, const char *suffix,
+		uint32_t flags)
+{
+	char path[4096];
+	double start;
+	FILE *f;
+	int ret;
+
+	snprintf(path, sizeof(path), "%s.%s", dump_prefix, suffix);
+	f = fopen(path, "w");
+	if (!f) {
+		perror(path);
+		return 1;
+	}
+
+	start = now_us();
+	ret = mlx5dv_dump_dr_domain_ex(f, dmn, flags);
+	if (fflush(f))
+		ret = ret ? ret : 1;
+	printf("%-8s %s %.1f ms, %ld bytes\n", "dump", suffix,
+	       (now_us() - start) / 1e3, ftell(f));
+	fclose(f);
+	if (ret)
+		fprintf(stderr, "dump to %s failed: %d\n", path, ret);
+	return ret != 0;
+}
+
+static int bench_rules(struct mlx5dv_dr_matcher *matcher,
+		       struct mlx5dv_dr_action *drop,
+		       struct mlx5dv_flow_match_parameters **values)
+{
+	struct mlx5dv_dr_rule **rules;
+	double start, insert, destroy;
+	double *latency, *cpu;
+	size_t i, done;
+	int failed = 0;
+
+	rules = calloc(num_rules, sizeof(*rules));
+	latency = calloc(num_rules, sizeof(*latency));
+	cpu = calloc(num_rules, sizeof(*cpu));
+	if (!rules || !latency || !cpu) {
+		free(rules);
+		free(latency);
+		free(cpu);
+		return 1;
+	}
+
+	start = now_us();
+	for (done = 0; done < num_rules; done++) {
+		latency[done] = now_us();
+		cpu[done] = cpu_us();
+		rules[done] = mlx5dv_dr_rule_create(matcher, values[done], 1,
+						    &drop);
+		cpu[done] = cpu_us() - cpu[done];
+		latency[done] = now_us() - latency[done];
+		if (!rules[done])
+			break;
+	}
+	insert = now_us() - start;
+
+	printf("%-8s %zu rules, %.0f rules/s, hash table %u entries\n",
+	       "insert", done, done * 1e6 / insert,
+	       done ? rule_htbl_size(rules[done - 1]) : 0);
+	if (done) {
+		qsort(latency, done, sizeof(*latency), cmp_double);
+		printf("%-8s latency p50 %.1f us, p99 %.1f us, max %.1f us\n",
+		       "insert", latency[done / 2], latency[done * 99 / 100],
+		       latency[done - 1]);
+		qsort(cpu, done, sizeof(*cpu), cmp_double);
+		printf("%-8s cpu     p50 %.1f us, p99 %.1f us, max %.1f us\n",
+		       "insert", cpu[done / 2], cpu[done * 99 / 100],
+		       cpu[done - 1]);
+	}
+	if (done != num_rules) {
+		fprintf(stderr, "insertion failed at rule %zu: %s\n", done,
+			strerror(errno));
+		failed = 1;
+	}
+
+	if (check)
+		failed |= check_rules(matcher);
+	if (dump_prefix) {
+		failed |= dump(matcher->tbl->dmn, "txt", 0);
+		failed |= dump(matcher->tbl->dmn, "bin",
+			       MLX5DV_DUMP_DR_FLAGS_BINARY);
+	}
+
+	start = now_us();
+	for (i = 0; i < done; i++)
+		mlx5dv_dr_rule_destroy(rules[i]);
+	destroy = now_us() - start;
+	printf("%-8s %zu rules, %.0f rules/s\n", "delete", done,
+	       done * 1e6 / destroy);
+
+	free(rules);
+	free(latency);
+	free(cpu);
+	return failed;
+}
+
+static void show_usage(char *program)
+{
+	printf("usage: %s [options]\n", program);
+	printf("   [-v version]     - STE format, 0 ConnectX-5, 1 ConnectX-6 Dx,\n");
+	printf("                      2 ConnectX-7 (default 1)\n");
+	printf("   [-s shape]       - rule shape, 5tuple, vxlan or gtpu\n");
+	printf("                      (default 5tuple)\n");
+	printf("   [-n rules]       - number of rules to insert (default 100000)\n");
+	printf("   [-m matchers]    - number of matchers to create (default 1000)\n");
+	printf("   [-c]             - check the ICM against the STE shadows\n");
+	printf("   [-d prefix]      - dump the domain to prefix.txt and prefix.bin\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct mlx5dv_flow_match_parameters **values, *mask;
+	struct mlx5dv_dr_matcher *matcher;
+	struct mlx5dv_dr_action *drop;
+	struct mlx5dv_dr_domain *dmn;
+	struct mlx5dv_dr_table *tbl;
+	struct ibv_context *ctx;
+	int op, failed = 0;
+	size_t i;
+
+	while ((op = getopt(argc, argv, "v:s:n:m:cd:")) != -1) {
+		switch (op) {
+		case 'v':
+			sw_format_ver = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			for (i = 0; i < ARRAY_SIZE(shape_names); i++)
+				if (!strcmp(optarg, shape_names[i]))
+					break;
+			if (i == ARRAY_SIZE(shape_names)) {
+				show_usage(argv[0]);
+				exit(1);
+			}
+			shape = i;
+			break;
+		case 'n':
+			num_rules = strtoul(optarg, NULL, 0);
+			break;
+		case 'm':
+			num_matchers = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			check = true;
+			break;
+		case 'd':
+			dump_prefix = optarg;
+			break;
+		default:
+			show_usage(argv[0]);
+			exit(1);
+		}
+	}
+
+	if (!num_rules || sw_format_ver > MLX5_HW_CONNECTX_7) {
+		show_usage(argv[0]);
+		exit(1);
+	}
+
+	ctx = dr_mock_open_device(sw_format_ver);
+	if (!ctx) {
+		perror("dr_mock_open_device");
+		exit(1);
+	}
+
+	dmn = mlx5dv_dr_domain_create(ctx, MLX5DV_DR_DOMAIN_TYPE_NIC_RX);
+	if (!dmn) {
+		perror("mlx5dv_dr_domain_create");
+		exit(1);
+	}
+
+	tbl = mlx5dv_dr_table_create(dmn, 1);
+	drop = mlx5dv_dr_action_create_drop();
+	mask = alloc_match(true, 0);
+	if (!tbl || !drop || !mask) {
+		perror("mlx5dv_dr_table_create");
+		exit(1);
+	}
+
+	values = calloc(num_rules, sizeof(*values));
+	if (!values) {
+		perror("calloc");
+		exit(1);
+	}
+	for (i = 0; i < num_rules; i++) {
+		values[i] = alloc_match(false, i);
+		if (!values[i]) {
+			perror("calloc");
+			exit(1);
+		}
+	}
+
+	printf("%s rules, STE format %u\n", shape_names[shape], sw_format_ver);
+
+	if (num_matchers)
+		failed |= bench_matchers(tbl, mask);
+
+	matcher = mlx5dv_dr_matcher_create(tbl, 0, match_criteria(), mask);
+	if (!matcher) {
+		perror("mlx5dv_dr_matcher_create");
+		exit(1);
+	}
+	failed |= bench_rules(matcher, drop, values);
+
+	printf("%-8s %" PRIu64 " WQEs completed in error\n", "mock",
+	       dr_mock_wqe_errors());
+	failed |= dr_mock_wqe_errors() != 0;
+
+	for (i = 0; i < num_rules; i++)
+		free(values[i]);
+	free(values);
+	free(mask);
+	mlx5dv_dr_matcher_destroy(matcher);
+	mlx5dv_dr_action_destroy(drop);
+	mlx5dv_dr_table_destroy(tbl);
+	mlx5dv_dr_domain_destroy(dmn);
+	dr_mock_close_device(ctx);
+	return failed;
+}
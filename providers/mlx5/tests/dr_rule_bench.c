@@ -0,0 +1,333 @@
+/* GPLv2 or OpenIB.org BSD (MIT) See COPYING file */
+
+/*
+ * Rule insertion rate benchmark for mlx5 software steering.  Creates a NIC RX
+ * domain with one matcher on the outer destination MAC, then inserts the same
+ * set of rules one by one with mlx5dv_dr_rule_create() and in batches with
+ * mlx5dv_dr_rule_create_bulk(), and asynchronously with
+ * mlx5dv_dr_rule_create_async(), destroying them in between.  Reports the
+ * insertion rate of each, the asynchronous one counted until every rule is
+ * reported live by mlx5dv_dr_domain_poll(), and the latency percentiles of
+ * single insertions, which cover the growth of the matcher hash table.  Then
+ * moves every rule from drop to a forward to another table and back with
+ * mlx5dv_dr_rule_modify_actions() and reports the rate of that.
+ *
+ * Needs a device with software steering support.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <time.h>
+#include <infiniband/mlx5dv.h>
+
+#include "../mlx5_ifc.h"
+
+static char *dev_name;
+static size_t num_rules = 100000;
+static size_t batch = 1024;
+
+static struct mlx5dv_dr_domain *dmn;
+static struct mlx5dv_flow_match_parameters **values;
+static struct mlx5dv_dr_rule_bulk_entry *entries;
+static double *latency;
+
+static double now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static struct mlx5dv_flow_match_parameters *alloc_match(uint64_t dmac)
+{
+	struct mlx5dv_flow_match_parameters *match;
+	size_t sz = DEVX_ST_SZ_BYTES(dr_match_param);
+	void *outer;
+
+	match = calloc(1, sizeof(*match) + sz);
+	if (!match)
+		return NULL;
+
+	match->match_sz = sz;
+	outer = DEVX_ADDR_OF(dr_match_param, match->match_buf, outer);
+	DEVX_SET(dr_match_spec, outer, dmac_47_16, dmac >> 16);
+	DEVX_SET(dr_match_spec, outer, dmac_15_0, dmac & 0xffff);
+	return match;
+}
+
+static void destroy_rules(void)
+{
+	size_t i;
+
+	for (i = 0; i < num_rules; i++) {
+		if (entries[i].rule)
+			mlx5dv_dr_rule_destroy(entries[i].rule);
+		entries[i].rule = NULL;
+	}
+}
+
+static size_t insert_single(struct mlx5dv_dr_matcher *matcher)
+{
+	double start;
+	size_t i;
+
+	for (i = 0; i < num_rules; i++) {
+		start = now_us();
+		entries[i].rule = mlx5dv_dr_rule_create(matcher, entries[i].value,
+							entries[i].num_actions,
+							entries[i].actions);
+		latency[i] = now_us() - start;
+		if (!entries[i].rule)
+			break;
+	}
+	return i;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void show_latency(size_t done)
+{
+	if (!done)
+		return;
+
+	qsort(latency, done, sizeof(*latency), cmp_double);
+	printf("%-8s latency p50 %.1f us, p99 %.1f us, p99.9 %.1f us, max %.1f us\n",
+	       "single", latency[done / 2], latency[done * 99 / 100],
+	       latency[done * 999 / 1000], latency[done - 1]);
+}
+
+static size_t insert_bulk(struct mlx5dv_dr_matcher *matcher)
+{
+	size_t i, n;
+
+	for (i = 0; i < num_rules; i += n) {
+		n = num_rules - i < batch ? num_rules - i : batch;
+		if (mlx5dv_dr_rule_create_bulk(matcher, n, &entries[i]))
+			break;
+	}
+	return i < num_rules ? i : num_rules;
+}
+
+static int poll_async(size_t *completed)
+{
+	struct mlx5dv_dr_rule_completion comp[64];
+	int i, ne;
+
+	ne = mlx5dv_dr_domain_poll(dmn, comp, 64);
+	if (ne < 0) {
+		errno = -ne;
+		return 1;
+	}
+	for (i = 0; i < ne; i++)
+		if (comp[i].op == MLX5DV_DR_RULE_OP_CREATE)
+			(*completed)++;
+	return 0;
+}
+
+static size_t insert_async(struct mlx5dv_dr_matcher *matcher)
+{
+	size_t i, completed = 0;
+
+	for (i = 0; i < num_rules; i++) {
+		entries[i].rule = mlx5dv_dr_rule_create_async(matcher,
+							      entries[i].value,
+							      entries[i].num_actions,
+							      entries[i].actions,
+							      &entries[i]);
+		if (!entries[i].rule || poll_async(&completed))
+			break;
+	}
+	while (completed < i)
+		if (poll_async(&completed))
+			break;
+	return completed;
+}
+
+static int run(const char *name, struct mlx5dv_dr_matcher *matcher,
+	       size_t (*insert)(struct mlx5dv_dr_matcher *matcher))
+{
+	double start, elapsed;
+	size_t done;
+
+	start = now_us();
+	done = insert(matcher);
+	elapsed = now_us() - start;
+
+	printf("%-8s %zu rules, %.0f rules/s\n", name, done,
+	       done * 1e6 / elapsed);
+	if (insert == insert_single)
+		show_latency(done);
+	if (done != num_rules)
+		fprintf(stderr, "%s insertion failed at rule %zu: %s\n", name,
+			done, strerror(errno));
+
+	destroy_rules();
+	return done != num_rules;
+}
+
+static int modify(struct mlx5dv_dr_matcher *matcher,
+		  struct mlx5dv_dr_action *drop, struct mlx5dv_dr_action *fwd)
+{
+	double start, elapsed;
+	size_t done, i;
+	int ret = 0;
+
+	done = insert_single(matcher);
+	if (done != num_rules) {
+		fprintf(stderr, "modify insertion failed at rule %zu: %s\n",
+			done, strerror(errno));
+		destroy_rules();
+		return 1;
+	}
+
+	start = now_us();
+	for (i = 0; i < 2 * num_rules && !ret; i++)
+		ret = mlx5dv_dr_rule_modify_actions(entries[i % num_rules].rule, 1,
+						    i < num_rules ? &fwd : &drop);
+	elapsed = now_us() - start;
+
+	printf("%-8s %zu rules, %.0f modifies/s\n", "modify", num_rules,
+	       i * 1e6 / elapsed);
+	if (ret)
+		fprintf(stderr, "modify failed at %zu: %s\n", i - 1,
+			strerror(ret));
+
+	destroy_rules();
+	return ret != 0;
+}
+
+static void show_usage(char *program)
+{
+	printf("usage: %s [options]\n", program);
+	printf("   [-d device]      - RDMA device (default first device)\n");
+	printf("   [-n rules]       - number of rules to insert (default 100000)\n");
+	printf("   [-b batch]       - rules per bulk call (default 1024)\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct mlx5dv_context_attr attr = { .flags = MLX5DV_CONTEXT_FLAGS_DEVX };
+	struct mlx5dv_flow_match_parameters *mask;
+	struct ibv_device **dev_list, *dev = NULL;
+	struct mlx5dv_dr_matcher *matcher;
+	struct mlx5dv_dr_action *drop, *fwd;
+	struct mlx5dv_dr_table *tbl, *next_tbl;
+	struct ibv_context *ctx;
+	int i, op, failed = 0;
+	size_t r;
+
+	while ((op = getopt(argc, argv, "d:n:b:")) != -1) {
+		switch (op) {
+		case 'd':
+			dev_name = optarg;
+			break;
+		case 'n':
+			num_rules = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			batch = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			show_usage(argv[0]);
+			exit(1);
+		}
+	}
+
+	if (!num_rules || !batch) {
+		show_usage(argv[0]);
+		exit(1);
+	}
+
+	dev_list = ibv_get_device_list(NULL);
+	if (!dev_list) {
+		perror("ibv_get_device_list");
+		exit(1);
+	}
+	for (i = 0; dev_list[i]; i++) {
+		if (!dev_name || !strcmp(ibv_get_device_name(dev_list[i]), dev_name)) {
+			dev = dev_list[i];
+			break;
+		}
+	}
+	if (!dev) {
+		fprintf(stderr, "device %s not found\n", dev_name ? dev_name : "");
+		exit(1);
+	}
+
+	ctx = mlx5dv_open_device(dev, &attr);
+	if (!ctx) {
+		perror("mlx5dv_open_device");
+		exit(1);
+	}
+
+	dmn = mlx5dv_dr_domain_create(ctx, MLX5DV_DR_DOMAIN_TYPE_NIC_RX);
+	if (!dmn) {
+		perror("mlx5dv_dr_domain_create");
+		exit(1);
+	}
+
+	tbl = mlx5dv_dr_table_create(dmn, 1);
+	mask = alloc_match(0xffffffffffffULL);
+	if (!tbl || !mask) {
+		perror("mlx5dv_dr_table_create");
+		exit(1);
+	}
+
+	/* Outer headers */
+	matcher = mlx5dv_dr_matcher_create(tbl, 0, 1, mask);
+	drop = mlx5dv_dr_action_create_drop();
+	next_tbl = mlx5dv_dr_table_create(dmn, 2);
+	fwd = next_tbl ? mlx5dv_dr_action_create_dest_table(next_tbl) : NULL;
+	if (!matcher || !drop || !fwd) {
+		perror("mlx5dv_dr_matcher_create");
+		exit(1);
+	}
+
+	values = calloc(num_rules, sizeof(*values));
+	entries = calloc(num_rules, sizeof(*entries));
+	latency = calloc(num_rules, sizeof(*latency));
+	if (!values || !entries || !latency) {
+		perror("calloc");
+		exit(1);
+	}
+	for (r = 0; r < num_rules; r++) {
+		values[r] = alloc_match(0x020000000000ULL | r);
+		if (!values[r]) {
+			perror("calloc");
+			exit(1);
+		}
+		entries[r].value = values[r];
+		entries[r].num_actions = 1;
+		entries[r].actions = &drop;
+	}
+
+	failed |= run("single", matcher, insert_single);
+	failed |= run("bulk", matcher, insert_bulk);
+	failed |= run("async", matcher, insert_async);
+	failed |= modify(matcher, drop, fwd);
+
+	for (r = 0; r < num_rules; r++)
+		free(values[r]);
+	free(values);
+	free(entries);
+	free(latency);
+	free(mask);
+	mlx5dv_dr_action_destroy(drop);
+	mlx5dv_dr_action_destroy(fwd);
+	mlx5dv_dr_matcher_destroy(matcher);
+	mlx5dv_dr_table_destroy(tbl);
+	mlx5dv_dr_table_destroy(next_tbl);
+	mlx5dv_dr_domain_destroy(dmn);
+	ibv_close_device(ctx);
+	ibv_free_device_list(dev_list);
+	return failed;
+}
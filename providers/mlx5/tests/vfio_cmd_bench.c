@@ -0,0 +1,282 @@
+/* GPLv2 or OpenIB.org BSD (MIT) See COPYING file */
+
+/*
+ * Command rate benchmark for the mlx5 VFIO driver.  Runs mlx5_vfio.c against
+ * the mock device of vfio_mock.c, whose firmware takes a fixed time per
+ * command and executes the commands of all slots in parallel, so the rate
+ * shows how many commands the driver keeps in flight.  Reports the MKey
+ * create and destroy rate of a few threads issuing synchronous commands, and
+ * the rate of a single thread keeping a queue of asynchronous object queries
+ * in flight through the DEVX async command completion.
+ *
+ * Checks that every query returned its own object and that no object is
+ * left alive on the device at the end.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "vfio_mock.h"
+#include "../mlx5_vfio.h"
+#include "../mlx5_ifc.h"
+
+#define BENCH_OBJ_TYPE	0x1
+
+struct bench_thread {
+	pthread_t thread;
+	struct ibv_context *ctx;
+	size_t num_cmds;
+	int err;
+};
+
+static double now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static struct mlx5_dv_context_ops *dv_ops(struct ibv_context *ctx)
+{
+	return to_mvfio_ctx(ctx)->dv_ctx_ops;
+}
+
+/* Create and destroy MKeys, num_cmds commands in total */
+static void *mkey_thread(void *arg)
+{
+	uint32_t out[DEVX_ST_SZ_DW(create_mkey_out)] = {};
+	uint32_t in[DEVX_ST_SZ_DW(create_mkey_in)] = {};
+	struct bench_thread *bt = arg;
+	struct mlx5dv_devx_obj *obj;
+	size_t i;
+
+	DEVX_SET(create_mkey_in, in, opcode, MLX5_CMD_OP_CREATE_MKEY);
+	for (i = 0; i < bt->num_cmds / 2; i++) {
+		obj = dv_ops(bt->ctx)->devx_obj_create(bt->ctx, in, sizeof(in),
+						       out, sizeof(out));
+		if (!obj) {
+			bt->err = errno;
+			return NULL;
+		}
+
+		bt->err = dv_ops(bt->ctx)->devx_obj_destroy(obj);
+		if (bt->err)
+			return NULL;
+	}
+
+	return NULL;
+}
+
+static int bench_sync(struct ibv_context *ctx, size_t num_cmds,
+		      unsigned int num_threads)
+{
+	struct bench_thread *threads;
+	struct vfio_mock_stats stats;
+	unsigned int i;
+	double start;
+	int err = 0;
+
+	threads = calloc(num_threads, sizeof(*threads));
+	if (!threads)
+		return ENOMEM;
+
+	start = now_us();
+	for (i = 0; i < num_threads; i++) {
+		threads[i].ctx = ctx;
+		threads[i].num_cmds = num_cmds / num_threads;
+		err = pthread_create(&threads[i].thread, NULL, mkey_thread,
+				     &threads[i]);
+		if (err)
+			break;
+	}
+
+	num_threads = i;
+	for (i = 0; i < num_threads; i++) {
+		pthread_join(threads[i].thread, NULL);
+		if (threads[i].err && !err)
+			err = threads[i].err;
+	}
+
+	if (!err) {
+		vfio_mock_get_stats(&stats);
+		printf("%-8s %2u threads, %.0f cmds/s, device in flight max %u\n",
+		       "sync", num_threads,
+		       num_cmds / num_threads * num_threads * 1e6 /
+		       (now_us() - start), stats.max_inflight);
+	}
+
+	free(threads);
+	return err;
+}
+
+static int bench_async(struct ibv_context *ctx, size_t num_cmds,
+		       unsigned int depth)
+{
+	uint32_t out[DEVX_ST_SZ_DW(general_obj_out_cmd_hdr)] = {};
+	uint32_t in[DEVX_ST_SZ_DW(general_obj_in_cmd_hdr)] = {};
+	uint8_t buf[sizeof(struct mlx5dv_devx_async_cmd_hdr) + sizeof(out)];
+	struct mlx5dv_devx_async_cmd_hdr *resp = (void *)buf;
+	struct mlx5dv_devx_cmd_comp *comp;
+	struct mlx5dv_devx_obj *obj;
+	struct vfio_mock_stats stats;
+	size_t posted = 0, done = 0;
+	uint32_t obj_id;
+	double start;
+	int err;
+
+	DEVX_SET(general_obj_in_cmd_hdr, in, opcode,
+		 MLX5_CMD_OP_CREATE_GENERAL_OBJECT);
+	DEVX_SET(general_obj_in_cmd_hdr, in, obj_type, BENCH_OBJ_TYPE);
+	obj = dv_ops(ctx)->devx_obj_create(ctx, in, sizeof(in), out,
+					   sizeof(out));
+	if (!obj)
+		return errno;
+
+	comp = dv_ops(ctx)->devx_create_cmd_comp(ctx);
+	if (!comp) {
+		err = errno;
+		goto out_obj;
+	}
+
+	obj_id = DEVX_GET(general_obj_out_cmd_hdr, out, obj_id);
+	DEVX_SET(general_obj_in_cmd_hdr, in, opcode,
+		 MLX5_CMD_OP_QUERY_GENERAL_OBJECT);
+	DEVX_SET(general_obj_in_cmd_hdr, in, obj_id, obj_id);
+
+	start = now_us();
+	while (done < num_cmds) {
+		if (posted < num_cmds && posted - done < depth) {
+			err = dv_ops(ctx)->devx_obj_query_async(obj, in,
+								sizeof(in),
+								sizeof(out),
+								posted, comp);
+			if (err)
+				goto out_comp;
+			posted++;
+			continue;
+		}
+
+		err = dv_ops(ctx)->devx_get_async_cmd_comp(comp, resp,
+							   sizeof(buf));
+		if (err)
+			goto out_comp;
+
+		if (resp->wr_id >= posted ||
+		    DEVX_GET(general_obj_out_cmd_hdr, resp->out_data, status) ||
+		    DEVX_GET(general_obj_out_cmd_hdr, resp->out_data,
+			     obj_id) != obj_id) {
+			fprintf(stderr, "bad response for query %llu\n",
+				(unsigned long long)resp->wr_id);
+			err = EIO;
+			goto out_comp;
+		}
+		done++;
+	}
+
+	vfio_mock_get_stats(&stats);
+	printf("%-8s depth %u, %.0f cmds/s, device in flight max %u\n",
+	       "async", depth, num_cmds * 1e6 / (now_us() - start),
+	       stats.max_inflight);
+
+out_comp:
+	/* Drain what is left in flight before destroying */
+	while (err && done < posted &&
+	       !dv_ops(ctx)->devx_get_async_cmd_comp(comp, resp, sizeof(buf)))
+		done++;
+	dv_ops(ctx)->devx_destroy_cmd_comp(comp);
+out_obj:
+	if (dv_ops(ctx)->devx_obj_destroy(obj) && !err)
+		err = EIO;
+	return err;
+}
+
+static void show_usage(char *program)
+{
+	printf("usage: %s [options]\n", program);
+	printf("   [-n cmds]        - commands per run (default 20000)\n");
+	printf("   [-l latency]     - device time per command in us (default 50)\n");
+	printf("   [-t threads]     - most threads issuing synchronous commands,\n");
+	printf("                      runs with 1, 2, 4... up to it (default 16)\n");
+	printf("   [-d depth]       - asynchronous commands in flight (default 64)\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct mlx5dv_vfio_context_attr attr = {
+		.pci_name = VFIO_MOCK_PCI_NAME,
+	};
+	struct vfio_mock_attr mock_attr = {
+		.cmd_latency_us = 50,
+	};
+	unsigned int max_threads = 16, depth = 64, threads;
+	struct vfio_mock_stats stats;
+	struct ibv_device **list;
+	struct ibv_context *ctx;
+	size_t num_cmds = 20000;
+	int op, err = 0;
+
+	while ((op = getopt(argc, argv, "n:l:t:d:")) != -1) {
+		switch (op) {
+		case 'n':
+			num_cmds = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			mock_attr.cmd_latency_us = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			max_threads = strtoul(optarg, NULL, 0);
+			break;
+		case 'd':
+			depth = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			show_usage(argv[0]);
+			exit(1);
+		}
+	}
+
+	if (!num_cmds || !max_threads || !depth) {
+		show_usage(argv[0]);
+		exit(1);
+	}
+
+	vfio_mock_init(&mock_attr);
+	list = mlx5dv_get_vfio_device_list(&attr);
+	if (!list) {
+		perror("mlx5dv_get_vfio_device_list");
+		return 1;
+	}
+
+	ctx = ibv_open_device(list[0]);
+	if (!ctx) {
+		perror("ibv_open_device");
+		ibv_free_device_list(list);
+		return 1;
+	}
+
+	for (threads = 1; threads <= max_threads && !err; threads *= 2)
+		err = bench_sync(ctx, num_cmds, threads);
+
+	if (!err)
+		err = bench_async(ctx, num_cmds, depth);
+
+	if (err)
+		fprintf(stderr, "benchmark failed: %s\n", strerror(err));
+
+	vfio_mock_get_stats(&stats);
+	if (stats.live_objs) {
+		fprintf(stderr, "%llu objects left on the device\n",
+			(unsigned long long)stats.live_objs);
+		err = EIO;
+	}
+
+	ibv_close_device(ctx);
+	ibv_free_device_list(list);
+	return err ? 1 : 0;
+}
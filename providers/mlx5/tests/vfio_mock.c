@@ -0,0 +1,856 @@
+/* GPLv2 or OpenIB.org BSD (MIT) See COPYING file */
+
+/*
+ * Mock VFIO device for the mlx5 VFIO driver.  Answers the VFIO container,
+ * group and device calls, the sysfs lookups of the PCI function and maps a
+ * host memory BAR, and plays the firmware behind it:
+ *
+ *  - Ringing the command doorbell starts the rung slots, each completes
+ *    cmd_latency_us later, independently of the others, like the firmware
+ *    executing commands in parallel.  The commands are read from and the
+ *    outputs written to the mailboxes through the IOMMU mappings.
+ *  - Completions are reported by an EQE and the MSI-X eventfd of the EQ
+ *    once the driver created one, the driver polls the slots before.
+ *  - The bring-up commands succeed, object creation hands out ids and
+ *    destroying an id that is not alive fails with a bad resource status.
+ *  - The pages given must be mapped, vfio_mock_page_request() raises a
+ *    page request event and the device returns the pages it is asked for.
+ *
+ * A single device is supported at a time.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include <time.h>
+#include <linux/vfio.h>
+#include <sys/eventfd.h>
+
+#include "vfio_mock.h"
+#include "../mlx5_vfio.h"
+#include "../mlx5_ifc.h"
+
+#undef open
+#undef ioctl
+#undef mmap
+#undef munmap
+#undef pread
+#undef pwrite
+#undef stat
+#undef readlink
+#undef mmio_write32_be
+
+#define MOCK_IOMMU_GROUP	42
+#define MOCK_BAR_SIZE		(1 << 20)
+#define MOCK_CONFIG_OFFSET	(1ULL << 40)
+#define MOCK_UAR_INDEX		16
+#define MOCK_NUM_VECS		4
+#define MOCK_LOG_CMDQ_SZ	5
+#define MOCK_LOG_CMDQ_STRIDE	6
+#define MOCK_MAX_MAPS		65536
+#define MOCK_MAX_OBJS		(1 << 24)
+#define MOCK_HEALTH_NS		100000000ULL
+
+const struct verbs_match_ent mlx5_hca_table[] = {
+	VERBS_PCI_MATCH(PCI_VENDOR_ID_MELLANOX, 0x1019, NULL),
+	{}
+};
+
+struct mock_map {
+	uint64_t iova;
+	uint64_t size;
+	void *vaddr;
+};
+
+struct mock_dev {
+	struct vfio_mock_attr attr;
+	int container_fd;
+	int group_fd;
+	int device_fd;
+	int irq_fds[MOCK_NUM_VECS];
+
+	pthread_mutex_t map_lock;
+	struct mock_map *maps;
+	unsigned int num_maps;
+	uint64_t mapped;
+
+	struct mlx5_init_seg *bar;
+	pthread_t fw_thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	bool stop;
+	/* Slots rung and not started yet */
+	uint32_t rung;
+	uint32_t busy;
+	uint64_t deadline[MLX5_MAX_COMMANDS];
+
+	struct mlx5_eqe *eq;
+	uint32_t eq_nent;
+	uint32_t eq_pi;
+	/* Consumer index the driver last wrote to the EQ doorbell */
+	uint32_t eq_ci;
+	uint8_t eq_intr;
+	/* Page request event to raise */
+	int32_t page_req;
+
+	/* The pages given, a stack of IOVAs */
+	uint64_t *pages;
+	uint64_t max_pages;
+
+	uint8_t *live;
+	uint32_t next_id;
+	struct vfio_mock_stats stats;
+};
+
+static struct mock_dev mock = {
+	.container_fd = -1,
+	.group_fd = -1,
+	.device_fd = -1,
+	.map_lock = PTHREAD_MUTEX_INITIALIZER,
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+void vfio_mock_init(const struct vfio_mock_attr *attr)
+{
+	mock.attr = *attr;
+}
+
+void vfio_mock_get_stats(struct vfio_mock_stats *stats)
+{
+	pthread_mutex_lock(&mock.lock);
+	*stats = mock.stats;
+	stats->idle = !mock.rung && !mock.busy &&
+		      !((mock.eq_pi - mock.eq_ci) & 0xffffff);
+	mock.stats.max_inflight = 0;
+	pthread_mutex_unlock(&mock.lock);
+
+	pthread_mutex_lock(&mock.map_lock);
+	stats->dma_maps = mock.num_maps;
+	stats->dma_mapped = mock.mapped;
+	pthread_mutex_unlock(&mock.map_lock);
+}
+
+void vfio_mock_page_request(int32_t npages)
+{
+	pthread_mutex_lock(&mock.lock);
+	mock.page_req = npages;
+	pthread_cond_signal(&mock.cond);
+	pthread_mutex_unlock(&mock.lock);
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Host address of len bytes at iova, aborts if no mapping covers them */
+static void *mock_iova_ptr(uint64_t iova, size_t len)
+{
+	unsigned int lo = 0, hi, mid;
+	struct mock_map *map;
+	void *ptr = NULL;
+
+	pthread_mutex_lock(&mock.map_lock);
+	hi = mock.num_maps;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (mock.maps[mid].iova <= iova)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo) {
+		map = &mock.maps[lo - 1];
+		if (iova + len <= map->iova + map->size)
+			ptr = map->vaddr + (iova - map->iova);
+	}
+	pthread_mutex_unlock(&mock.map_lock);
+
+	if (!ptr) {
+		fprintf(stderr, "mock: access to unmapped IOVA 0x%llx\n",
+			(unsigned long long)iova);
+		abort();
+	}
+	return ptr;
+}
+
+static int mock_map_dma(struct vfio_iommu_type1_dma_map *dma_map)
+{
+	unsigned int i;
+
+	pthread_mutex_lock(&mock.map_lock);
+	if (mock.num_maps == MOCK_MAX_MAPS) {
+		pthread_mutex_unlock(&mock.map_lock);
+		errno = ENOSPC;
+		return -1;
+	}
+
+	for (i = mock.num_maps; i && mock.maps[i - 1].iova > dma_map->iova;
+	     i--)
+		mock.maps[i] = mock.maps[i - 1];
+	mock.maps[i].iova = dma_map->iova;
+	mock.maps[i].size = dma_map->size;
+	mock.maps[i].vaddr = (void *)(uintptr_t)dma_map->vaddr;
+	mock.num_maps++;
+	mock.mapped += dma_map->size;
+	pthread_mutex_unlock(&mock.map_lock);
+	return 0;
+}
+
+static int mock_unmap_dma(struct vfio_iommu_type1_dma_unmap *dma_unmap)
+{
+	unsigned int i;
+
+	pthread_mutex_lock(&mock.map_lock);
+	for (i = 0; i < mock.num_maps; i++)
+		if (mock.maps[i].iova == dma_unmap->iova &&
+		    mock.maps[i].size == dma_unmap->size)
+			break;
+
+	if (i == mock.num_maps) {
+		pthread_mutex_unlock(&mock.map_lock);
+		errno = ENOENT;
+		return -1;
+	}
+
+	memmove(&mock.maps[i], &mock.maps[i + 1],
+		(mock.num_maps - i - 1) * sizeof(*mock.maps));
+	mock.num_maps--;
+	mock.mapped -= dma_unmap->size;
+	pthread_mutex_unlock(&mock.map_lock);
+	return 0;
+}
+
+/* Copy len bytes of a command message, the inline part first */
+static void mock_msg_copy(void *inline_data, uint64_t iova, void *buf,
+			  size_t len, bool to_msg)
+{
+	struct mlx5_cmd_block *block;
+	size_t copy;
+
+	copy = min_t(size_t, len, 16);
+	if (to_msg)
+		memcpy(inline_data, buf, copy);
+	else
+		memcpy(buf, inline_data, copy);
+
+	for (buf += copy, len -= copy; len; buf += copy, len -= copy) {
+		block = mock_iova_ptr(iova, sizeof(*block));
+		copy = min_t(size_t, len, MLX5_CMD_DATA_BLOCK_SIZE);
+		if (to_msg)
+			memcpy(block->data, buf, copy);
+		else
+			memcpy(buf, block->data, copy);
+		iova = be64toh(block->next);
+	}
+}
+
+static uint32_t mock_obj_alloc(void)
+{
+	uint32_t id;
+
+	pthread_mutex_lock(&mock.lock);
+	id = ++mock.next_id;
+	mock.live[id] = 1;
+	mock.stats.live_objs++;
+	pthread_mutex_unlock(&mock.lock);
+	return id;
+}
+
+static uint8_t mock_obj_free(uint32_t id)
+{
+	uint8_t status = MLX5_CMD_STAT_OK;
+
+	pthread_mutex_lock(&mock.lock);
+	if (id < MOCK_MAX_OBJS && mock.live[id]) {
+		mock.live[id] = 0;
+		mock.stats.live_objs--;
+	} else {
+		status = MLX5_CMD_STAT_BAD_RES_ERR;
+	}
+	pthread_mutex_unlock(&mock.lock);
+	return status;
+}
+
+static void mock_query_hca_cap(void *in, void *out)
+{
+	uint16_t op_mod = DEVX_GET(query_hca_cap_in, in, op_mod);
+	void *cap = DEVX_ADDR_OF(query_hca_cap_out, out, capability);
+
+	if (op_mod >> 1 != MLX5_CAP_GENERAL)
+		return;
+
+	DEVX_SET(cmd_hca_cap, cap, umem_uid_0, 1);
+	DEVX_SET(cmd_hca_cap, cap, port_type, MLX5_CAP_PORT_TYPE_IB);
+}
+
+static void mock_create_eq(void *in, void *out)
+{
+	void *eqc = DEVX_ADDR_OF(create_eq_in, in, eq_context_entry);
+	uint32_t nent = 1 << DEVX_GET(eqc, eqc, log_eq_size);
+
+	mock.eq = mock_iova_ptr(DEVX_GET64(create_eq_in, in, pas[0]),
+				nent * sizeof(*mock.eq));
+	mock.eq_nent = nent;
+	mock.eq_pi = 0;
+	mock.eq_intr = DEVX_GET(eqc, eqc, intr);
+	DEVX_SET(create_eq_out, out, eq_number, 1);
+}
+
+static uint8_t mock_manage_pages(void *in, void *out)
+{
+	uint32_t i, npages = DEVX_GET(manage_pages_in, in, input_num_entries);
+	uint64_t *pages;
+
+	pthread_mutex_lock(&mock.lock);
+	switch (DEVX_GET(manage_pages_in, in, op_mod)) {
+	case MLX5_PAGES_GIVE:
+		if (mock.stats.pages + npages > mock.max_pages) {
+			mock.max_pages = max(mock.max_pages * 2,
+					     mock.stats.pages + npages);
+			pages = realloc(mock.pages,
+					mock.max_pages * sizeof(*pages));
+			if (!pages)
+				abort();
+			mock.pages = pages;
+		}
+
+		for (i = 0; i < npages; i++) {
+			mock.pages[mock.stats.pages] =
+				DEVX_GET64(manage_pages_in, in, pas[i]);
+			mock_iova_ptr(mock.pages[mock.stats.pages++],
+				      MLX5_ADAPTER_PAGE_SIZE);
+		}
+		break;
+	case MLX5_PAGES_TAKE:
+		npages = min_t(uint64_t, npages, mock.stats.pages);
+		for (i = 0; i < npages; i++)
+			DEVX_SET64(manage_pages_out, out, pas[i],
+				   mock.pages[--mock.stats.pages]);
+		DEVX_SET(manage_pages_out, out, output_num_entries, npages);
+		break;
+	default:
+		pthread_mutex_unlock(&mock.lock);
+		return MLX5_CMD_STAT_BAD_OP_ERR;
+	}
+	pthread_mutex_unlock(&mock.lock);
+	return MLX5_CMD_STAT_OK;
+}
+
+/* Execute a command, returns its status */
+static uint8_t mock_exec(void *in, void *out)
+{
+	uint16_t opcode = DEVX_GET(mbox_in, in, opcode);
+	int32_t npages;
+
+	switch (opcode) {
+	case MLX5_CMD_OP_ENABLE_HCA:
+	case MLX5_CMD_OP_SET_ISSI:
+	case MLX5_CMD_OP_ACCESS_REG:
+	case MLX5_CMD_OP_SET_HCA_CAP:
+	case MLX5_CMD_OP_INIT_HCA:
+	case MLX5_CMD_OP_TEARDOWN_HCA:
+	case MLX5_CMD_OP_DEALLOC_UAR:
+	case MLX5_CMD_OP_DEALLOC_PD:
+		return MLX5_CMD_STAT_OK;
+	case MLX5_CMD_OP_QUERY_ISSI:
+		DEVX_SET(query_issi_out, out, supported_issi_dw0, 0x3);
+		return MLX5_CMD_STAT_OK;
+	case MLX5_CMD_OP_QUERY_PAGES:
+		npages = DEVX_GET(query_pages_in, in, op_mod) == 0x01 ?
+			 mock.attr.boot_pages : mock.attr.init_pages;
+		DEVX_SET(query_pages_out, out, num_pages, npages);
+		return MLX5_CMD_STAT_OK;
+	case MLX5_CMD_OP_MANAGE_PAGES:
+		return mock_manage_pages(in, out);
+	case MLX5_CMD_OP_QUERY_HCA_CAP:
+		mock_query_hca_cap(in, out);
+		return MLX5_CMD_STAT_OK;
+	case MLX5_CMD_OP_ALLOC_UAR:
+		DEVX_SET(alloc_uar_out, out, uar, MOCK_UAR_INDEX);
+		return MLX5_CMD_STAT_OK;
+	case MLX5_CMD_OP_CREATE_EQ:
+		mock_create_eq(in, out);
+		return MLX5_CMD_STAT_OK;
+	case MLX5_CMD_OP_DESTROY_EQ:
+		mock.eq = NULL;
+		return MLX5_CMD_STAT_OK;
+	case MLX5_CMD_OP_ALLOC_PD:
+		DEVX_SET(alloc_pd_out, out, pd, mock_obj_alloc());
+		return MLX5_CMD_STAT_OK;
+	case MLX5_CMD_OP_CREATE_MKEY:
+		DEVX_SET(create_mkey_out, out, mkey_index, mock_obj_alloc());
+		return MLX5_CMD_STAT_OK;
+	case MLX5_CMD_OP_DESTROY_MKEY:
+		return mock_obj_free(DEVX_GET(destroy_mkey_in, in, mkey_index));
+	case MLX5_CMD_OP_CREATE_GENERAL_OBJECT:
+		DEVX_SET(general_obj_out_cmd_hdr, out, obj_id,
+			 mock_obj_alloc());
+		return MLX5_CMD_STAT_OK;
+	case MLX5_CMD_OP_QUERY_GENERAL_OBJECT:
+		DEVX_SET(general_obj_out_cmd_hdr, out, obj_id,
+			 DEVX_GET(general_obj_in_cmd_hdr, in, obj_id));
+		return MLX5_CMD_STAT_OK;
+	case MLX5_CMD_OP_DESTROY_GENERAL_OBJECT:
+		return mock_obj_free(DEVX_GET(general_obj_in_cmd_hdr, in,
+					      obj_id));
+	default:
+		return MLX5_CMD_STAT_BAD_OP_ERR;
+	}
+}
+
+static struct mlx5_cmd_layout *mock_cmd_lay(unsigned int slot)
+{
+	uint64_t iova = (uint64_t)be32toh(mock.bar->cmdq_addr_h) << 32 |
+			(be32toh(mock.bar->cmdq_addr_l_sz) & ~0xfffU);
+
+	return mock_iova_ptr(iova, MLX5_ADAPTER_PAGE_SIZE) +
+	       (slot << MOCK_LOG_CMDQ_STRIDE);
+}
+
+/* Post an EQE of type with data, once the driver created its EQ */
+static void mock_post_eqe(uint8_t type, const union ev_data *data)
+{
+	struct mlx5_eqe *eqe;
+	uint64_t u = 1;
+
+	if (!mock.eq)
+		return;
+
+	pthread_mutex_lock(&mock.lock);
+	eqe = &mock.eq[mock.eq_pi & (mock.eq_nent - 1)];
+	memset(eqe, 0, sizeof(*eqe) - 1);
+	eqe->type = type;
+	eqe->data = *data;
+	__atomic_store_n(&eqe->owner, !!(mock.eq_pi & mock.eq_nent),
+			 __ATOMIC_RELEASE);
+	mock.eq_pi++;
+	pthread_mutex_unlock(&mock.lock);
+
+	if (mock.irq_fds[mock.eq_intr] >= 0 &&
+	    write(mock.irq_fds[mock.eq_intr], &u, sizeof(u)) != sizeof(u))
+		abort();
+}
+
+static void mock_complete(unsigned int slot)
+{
+	struct mlx5_cmd_layout *lay = mock_cmd_lay(slot);
+	uint32_t ilen = be32toh(lay->ilen), olen = be32toh(lay->olen);
+	union ev_data data = {};
+	void *in, *out;
+
+	/* Room for the status of outputs shorter than it */
+	in = calloc(1, ilen);
+	out = calloc(1, max_t(size_t, olen, DEVX_ST_SZ_BYTES(mbox_out)));
+	if (!in || !out)
+		abort();
+
+	mock_msg_copy(lay->in, be64toh(lay->iptr), in, ilen, false);
+	DEVX_SET(mbox_out, out, status, mock_exec(in, out));
+	mock_msg_copy(lay->out, be64toh(lay->optr), out, olen, true);
+	free(in);
+	free(out);
+	__atomic_store_n(&lay->status_own, 0, __ATOMIC_RELEASE);
+
+	data.cmd.vector = htobe32(1U << slot);
+	mock_post_eqe(MLX5_EVENT_TYPE_CMD, &data);
+}
+
+static void *mock_fw_thread(void *arg)
+{
+	uint64_t now, next, health = 0;
+	uint32_t done, inflight;
+	union ev_data data;
+	struct timespec ts;
+	unsigned int slot;
+	int32_t page_req;
+
+	pthread_mutex_lock(&mock.lock);
+	while (!mock.stop) {
+		now = now_ns();
+		for (; mock.rung; mock.rung &= mock.rung - 1) {
+			slot = __builtin_ctz(mock.rung);
+			mock.deadline[slot] = now + mock.attr.cmd_latency_us * 1000ULL;
+			mock.busy |= 1U << slot;
+		}
+
+		inflight = __builtin_popcount(mock.busy);
+		if (inflight > mock.stats.max_inflight)
+			mock.stats.max_inflight = inflight;
+
+		done = 0;
+		next = now + MOCK_HEALTH_NS;
+		for (slot = 0; slot < MLX5_MAX_COMMANDS; slot++) {
+			if (!(mock.busy & (1U << slot)))
+				continue;
+			if (mock.deadline[slot] <= now)
+				done |= 1U << slot;
+			else
+				next = min(next, mock.deadline[slot]);
+		}
+		mock.stats.cmds += __builtin_popcount(done);
+
+		/* Health counter, the driver checks it advances */
+		if (now - health >= MOCK_HEALTH_NS) {
+			mock.bar->health_counter =
+				htobe32(be32toh(mock.bar->health_counter) + 1);
+			health = now;
+		}
+
+		page_req = mock.page_req;
+		mock.page_req = 0;
+		if (done || page_req) {
+			pthread_mutex_unlock(&mock.lock);
+			for (slot = 0; slot < MLX5_MAX_COMMANDS; slot++)
+				if (done & (1U << slot))
+					mock_complete(slot);
+			if (page_req) {
+				memset(&data, 0, sizeof(data));
+				data.req_pages.num_pages = htobe32(page_req);
+				mock_post_eqe(MLX5_EVENT_TYPE_PAGE_REQUEST,
+					      &data);
+			}
+			pthread_mutex_lock(&mock.lock);
+			/* Busy until completed, for vfio_mock_stats.idle */
+			mock.busy &= ~done;
+			continue;
+		}
+
+		ts.tv_sec = next / 1000000000ULL;
+		ts.tv_nsec = next % 1000000000ULL;
+		pthread_cond_timedwait(&mock.cond, &mock.lock, &ts);
+	}
+	pthread_mutex_unlock(&mock.lock);
+	return NULL;
+}
+
+void vfio_mock_mmio_write32_be(void *addr, __be32 val)
+{
+	void *eq_dbell = (void *)mock.bar +
+			 MOCK_UAR_INDEX * MLX5_ADAPTER_PAGE_SIZE +
+			 MLX5_EQ_DOORBEL_OFFSET;
+
+	if (mock.bar && addr == &mock.bar->cmd_dbell) {
+		pthread_mutex_lock(&mock.lock);
+		mock.rung |= be32toh(val);
+		pthread_cond_signal(&mock.cond);
+		pthread_mutex_unlock(&mock.lock);
+		return;
+	}
+
+	/* The consumer index with or without arming */
+	if (mock.bar && (addr == eq_dbell || addr == eq_dbell + 8)) {
+		pthread_mutex_lock(&mock.lock);
+		mock.eq_ci = be32toh(val) & 0xffffff;
+		pthread_mutex_unlock(&mock.lock);
+	}
+
+	mmio_write32_be(addr, val);
+}
+
+static void *mock_map_bar(void)
+{
+	pthread_condattr_t attr;
+	void *bar;
+
+	if (posix_memalign(&bar, MLX5_ADAPTER_PAGE_SIZE, MOCK_BAR_SIZE))
+		return MAP_FAILED;
+	memset(bar, 0, MOCK_BAR_SIZE);
+
+	mock.live = calloc(MOCK_MAX_OBJS, 1);
+	mock.maps = calloc(MOCK_MAX_MAPS, sizeof(*mock.maps));
+	if (!mock.live || !mock.maps)
+		goto err;
+
+	mock.bar = bar;
+	mock.bar->cmdif_rev_fw_sub = htobe32(5 << 16);
+	mock.bar->cmdq_addr_l_sz = htobe32(MOCK_LOG_CMDQ_SZ << 4 |
+					   MOCK_LOG_CMDQ_STRIDE);
+	mock.bar->health.fw_ver = htobe32(1);
+
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&mock.cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	mock.stop = false;
+	if (pthread_create(&mock.fw_thread, NULL, mock_fw_thread, NULL))
+		goto err;
+
+	return bar;
+
+err:
+	free(mock.maps);
+	free(mock.live);
+	free(bar);
+	mock.bar = NULL;
+	return MAP_FAILED;
+}
+
+static void mock_unmap_bar(void)
+{
+	pthread_mutex_lock(&mock.lock);
+	mock.stop = true;
+	pthread_cond_signal(&mock.cond);
+	pthread_mutex_unlock(&mock.lock);
+	pthread_join(mock.fw_thread, NULL);
+
+	free(mock.bar);
+	mock.bar = NULL;
+	free(mock.maps);
+	mock.maps = NULL;
+	mock.num_maps = 0;
+	free(mock.live);
+	mock.live = NULL;
+	free(mock.pages);
+	mock.pages = NULL;
+	mock.max_pages = 0;
+	mock.stats.pages = 0;
+}
+
+/* An fd to hand out for a mock file, reads as data */
+static int mock_file_fd(const char *data)
+{
+	int fds[2];
+
+	if (pipe(fds))
+		return -1;
+
+	if (data && write(fds[1], data, strlen(data)) != strlen(data)) {
+		close(fds[0]);
+		fds[0] = -1;
+	}
+	close(fds[1]);
+	return fds[0];
+}
+
+/* Whether path is file in the sysfs directory of the mock device */
+static bool mock_sysfs_path(const char *path, const char *file)
+{
+	static const char dir[] = "/sys/bus/pci/devices/" VFIO_MOCK_PCI_NAME;
+
+	if (strncmp(path, dir, sizeof(dir) - 1))
+		return false;
+
+	for (path += sizeof(dir) - 1; *path == '/'; path++)
+		;
+	return !strcmp(path, file);
+}
+
+int vfio_mock_open(const char *path, int flags, ...)
+{
+	char group_path[32];
+	mode_t mode = 0;
+	va_list ap;
+
+	snprintf(group_path, sizeof(group_path), "/dev/vfio/%d",
+		 MOCK_IOMMU_GROUP);
+	if (!strcmp(path, "/dev/vfio/vfio"))
+		return mock.container_fd = mock_file_fd(NULL);
+	if (!strcmp(path, group_path))
+		return mock.group_fd = mock_file_fd(NULL);
+	if (mock_sysfs_path(path, "vendor"))
+		return mock_file_fd("0x15b3\n");
+	if (mock_sysfs_path(path, "device"))
+		return mock_file_fd("0x1019\n");
+
+	if (flags & O_CREAT) {
+		va_start(ap, flags);
+		mode = va_arg(ap, mode_t);
+		va_end(ap);
+	}
+	return open(path, flags, mode);
+}
+
+int vfio_mock_stat(const char *path, struct stat *buf)
+{
+	char group_path[32];
+
+	snprintf(group_path, sizeof(group_path), "/dev/vfio/%d",
+		 MOCK_IOMMU_GROUP);
+	if (mock_sysfs_path(path, "") || !strcmp(path, group_path)) {
+		memset(buf, 0, sizeof(*buf));
+		return 0;
+	}
+
+	return stat(path, buf);
+}
+
+ssize_t vfio_mock_readlink(const char *path, char *buf, size_t bufsiz)
+{
+	char link[64];
+	size_t len;
+
+	if (!mock_sysfs_path(path, "iommu_group"))
+		return readlink(path, buf, bufsiz);
+
+	len = snprintf(link, sizeof(link), "../../../kernel/iommu_groups/%d",
+		       MOCK_IOMMU_GROUP);
+	len = min(len, bufsiz);
+	memcpy(buf, link, len);
+	return len;
+}
+
+static int mock_container_ioctl(unsigned long request, void *arg)
+{
+	struct vfio_iommu_type1_info *info = arg;
+
+	switch (request) {
+	case VFIO_GET_API_VERSION:
+		return VFIO_API_VERSION;
+	case VFIO_CHECK_EXTENSION:
+		return 1;
+	case VFIO_SET_IOMMU:
+		return 0;
+	case VFIO_IOMMU_GET_INFO:
+		info->flags = VFIO_IOMMU_INFO_PGSIZES;
+		info->iova_pgsizes = (1ULL << 12) | (1ULL << 21) | (1ULL << 30);
+		return 0;
+	case VFIO_IOMMU_MAP_DMA:
+		return mock_map_dma(arg);
+	case VFIO_IOMMU_UNMAP_DMA:
+		return mock_unmap_dma(arg);
+	}
+
+	errno = ENOTTY;
+	return -1;
+}
+
+static int mock_device_ioctl(unsigned long request, void *arg)
+{
+	struct vfio_region_info *reg = arg;
+	struct vfio_irq_info *irq = arg;
+	struct vfio_irq_set *irq_set = arg;
+	int *fds = (int *)irq_set->data;
+	unsigned int i;
+
+	switch (request) {
+	case VFIO_DEVICE_GET_REGION_INFO:
+		if (reg->index == VFIO_PCI_BAR0_REGION_INDEX) {
+			reg->size = MOCK_BAR_SIZE;
+			reg->offset = 0;
+		} else {
+			reg->size = 256;
+			reg->offset = MOCK_CONFIG_OFFSET;
+		}
+		return 0;
+	case VFIO_DEVICE_GET_IRQ_INFO:
+		irq->flags = VFIO_IRQ_INFO_EVENTFD;
+		irq->count = MOCK_NUM_VECS;
+		return 0;
+	case VFIO_DEVICE_SET_IRQS:
+		if (irq_set->start + irq_set->count > MOCK_NUM_VECS) {
+			errno = EINVAL;
+			return -1;
+		}
+		for (i = 0; i < irq_set->count; i++)
+			mock.irq_fds[irq_set->start + i] = fds[i];
+		return 0;
+	}
+
+	errno = ENOTTY;
+	return -1;
+}
+
+int vfio_mock_ioctl(int fd, unsigned long request, ...)
+{
+	struct vfio_group_status *status;
+	va_list ap;
+	void *arg;
+
+	va_start(ap, request);
+	arg = va_arg(ap, void *);
+	va_end(ap);
+
+	if (fd >= 0 && fd == mock.container_fd)
+		return mock_container_ioctl(request, arg);
+
+	if (fd >= 0 && fd == mock.device_fd)
+		return mock_device_ioctl(request, arg);
+
+	if (fd < 0 || fd != mock.group_fd)
+		return ioctl(fd, request, arg);
+
+	switch (request) {
+	case VFIO_GROUP_GET_STATUS:
+		status = arg;
+		status->flags = VFIO_GROUP_FLAGS_VIABLE;
+		return 0;
+	case VFIO_GROUP_SET_CONTAINER:
+		return 0;
+	case VFIO_GROUP_GET_DEVICE_FD:
+		if (strcmp(arg, VFIO_MOCK_PCI_NAME)) {
+			errno = ENODEV;
+			return -1;
+		}
+		return mock.device_fd = mock_file_fd(NULL);
+	}
+
+	errno = ENOTTY;
+	return -1;
+}
+
+void *vfio_mock_mmap(void *addr, size_t length, int prot, int flags, int fd,
+		     off_t offset)
+{
+	if (fd < 0 || fd != mock.device_fd)
+		return mmap(addr, length, prot, flags, fd, offset);
+
+	if (length != MOCK_BAR_SIZE || offset || mock.bar) {
+		errno = EINVAL;
+		return MAP_FAILED;
+	}
+
+	return mock_map_bar();
+}
+
+int vfio_mock_munmap(void *addr, size_t length)
+{
+	if (!addr || addr != mock.bar)
+		return munmap(addr, length);
+
+	mock_unmap_bar();
+	return 0;
+}
+
+ssize_t vfio_mock_pread(int fd, void *buf, size_t count, off_t offset)
+{
+	if (fd < 0 || fd != mock.device_fd)
+		return pread(fd, buf, count, offset);
+
+	memset(buf, 0, count);
+	return count;
+}
+
+ssize_t vfio_mock_pwrite(int fd, const void *buf, size_t count, off_t offset)
+{
+	if (fd < 0 || fd != mock.device_fd)
+		return pwrite(fd, buf, count, offset);
+
+	return count;
+}
+
+/* The mlx5 provider calls of mlx5_vfio.c */
+int mlx5_cmd_status_to_err(uint8_t status)
+{
+	return status ? EIO : 0;
+}
+
+void mlx5_open_debug_file(FILE **dbg_fp)
+{
+	*dbg_fp = stderr;
+}
+
+void mlx5_close_debug_file(FILE *dbg_fp)
+{
+}
+
+void mlx5_set_debug_mask(void)
+{
+}
@@ -0,0 +1,78 @@
+/* GPLv2 or OpenIB.org BSD (MIT) See COPYING file */
+
+/*
+ * Mock VFIO device for running the mlx5 VFIO driver without hardware, see
+ * vfio_mock.c.  This header is force included in every source of the mock
+ * build, so the VFIO, sysfs and BAR accesses of mlx5_vfio.c reach the mock.
+ */
+
+#ifndef VFIO_MOCK_H
+#define VFIO_MOCK_H
+
+#define _GNU_SOURCE
+#include <config.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <util/mmio.h>
+
+#define VFIO_MOCK_PCI_NAME	"0000:08:00.0"
+
+struct vfio_mock_attr {
+	/* Time the device takes to execute a command */
+	unsigned int cmd_latency_us;
+	/* Pages the device asks for at boot and at init */
+	int32_t boot_pages;
+	int32_t init_pages;
+};
+
+struct vfio_mock_stats {
+	uint64_t cmds;
+	/* Most commands executing at once since the previous stats */
+	unsigned int max_inflight;
+	/* Pages given to the device and not reclaimed */
+	uint64_t pages;
+	uint64_t live_objs;
+	/* No command in flight and the driver consumed every EQE */
+	bool idle;
+	/* IOMMU mappings of the driver and the memory they map */
+	unsigned int dma_maps;
+	uint64_t dma_mapped;
+};
+
+/* Configure the device before mlx5dv_get_vfio_device_list() */
+void vfio_mock_init(const struct vfio_mock_attr *attr);
+void vfio_mock_get_stats(struct vfio_mock_stats *stats);
+/* Raise a page request event, for npages more or -npages fewer pages */
+void vfio_mock_page_request(int32_t npages);
+
+int vfio_mock_open(const char *path, int flags, ...);
+int vfio_mock_ioctl(int fd, unsigned long request, ...);
+void *vfio_mock_mmap(void *addr, size_t length, int prot, int flags, int fd,
+		     off_t offset);
+int vfio_mock_munmap(void *addr, size_t length);
+ssize_t vfio_mock_pread(int fd, void *buf, size_t count, off_t offset);
+ssize_t vfio_mock_pwrite(int fd, const void *buf, size_t count,
+			 off_t offset);
+int vfio_mock_stat(const char *path, struct stat *buf);
+ssize_t vfio_mock_readlink(const char *path, char *buf, size_t bufsiz);
+void vfio_mock_mmio_write32_be(void *addr, __be32 val);
+
+/* Undone by vfio_mock.c, which makes the real calls */
+#define open(...) vfio_mock_open(__VA_ARGS__)
+#define ioctl(...) vfio_mock_ioctl(__VA_ARGS__)
+#define mmap(...) vfio_mock_mmap(__VA_ARGS__)
+#define munmap(...) vfio_mock_munmap(__VA_ARGS__)
+#define pread(...) vfio_mock_pread(__VA_ARGS__)
+#define pwrite(...) vfio_mock_pwrite(__VA_ARGS__)
+#define stat(...) vfio_mock_stat(__VA_ARGS__)
+#define readlink(...) vfio_mock_readlink(__VA_ARGS__)
+#define mmio_write32_be(addr, val) vfio_mock_mmio_write32_be(addr, val)
+
+#endif
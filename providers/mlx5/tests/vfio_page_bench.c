@@ -0,0 +1,186 @@
+/* GPLv2 or OpenIB.org BSD (MIT) See COPYING file */
+
+/*
+ * Firmware page benchmark for the mlx5 VFIO driver.  Runs mlx5_vfio.c
+ * against the mock device of vfio_mock.c, which asks for the given number
+ * of boot and init pages, and reports the device bring-up time with the
+ * IOMMU mappings it took.  Then raises a page request event to reclaim
+ * pages and one to give them back, and reports the time the driver took to
+ * satisfy each.
+ *
+ * The pages are not touched, so large demands cost address space only.
+ * Checks that the device holds the expected pages after each step and that
+ * closing the device leaves no mapping behind.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <time.h>
+
+#include "vfio_mock.h"
+#include "../mlx5_vfio.h"
+
+#define EVENT_TIMEOUT_US	(10 * 1000 * 1000)
+
+static double now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void print_stats(const char *name, double time_us)
+{
+	struct vfio_mock_stats stats;
+
+	vfio_mock_get_stats(&stats);
+	printf("%-8s %.1f ms, device holds %llu pages, %u DMA maps of %llu MB\n",
+	       name, time_us / 1e3, (unsigned long long)stats.pages,
+	       stats.dma_maps, (unsigned long long)(stats.dma_mapped >> 20));
+}
+
+/*
+ * Raise a page request and process events until the device holds pages and
+ * the driver is done with the commands and events that got it there.
+ */
+static int page_request(struct ibv_context *ctx, int32_t npages,
+			uint64_t pages, const char *name)
+{
+	struct pollfd fd = {
+		.fd = mlx5dv_vfio_get_events_fd(ctx),
+		.events = POLLIN,
+	};
+	struct vfio_mock_stats stats;
+	double start = now_us();
+	int err;
+
+	vfio_mock_page_request(npages);
+	while (true) {
+		vfio_mock_get_stats(&stats);
+		if (stats.pages == pages && stats.idle)
+			break;
+
+		if (now_us() - start > EVENT_TIMEOUT_US) {
+			fprintf(stderr, "%s: device holds %llu pages, expected %llu\n",
+				name, (unsigned long long)stats.pages,
+				(unsigned long long)pages);
+			return ETIMEDOUT;
+		}
+
+		if (poll(&fd, 1, 1) < 0)
+			return errno;
+
+		err = mlx5dv_vfio_process_events(ctx);
+		if (err)
+			return err;
+	}
+
+	print_stats(name, now_us() - start);
+	return 0;
+}
+
+static void show_usage(char *program)
+{
+	printf("usage: %s [options]\n", program);
+	printf("   [-b pages]       - boot pages the device asks for (default 4096)\n");
+	printf("   [-i pages]       - init pages the device asks for (default 262144)\n");
+	printf("   [-r pages]       - pages to reclaim and give back by events\n");
+	printf("                      (default 65536)\n");
+	printf("   [-l latency]     - device time per command in us (default 50)\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct mlx5dv_vfio_context_attr attr = {
+		.pci_name = VFIO_MOCK_PCI_NAME,
+	};
+	struct vfio_mock_attr mock_attr = {
+		.cmd_latency_us = 50,
+		.boot_pages = 4096,
+		.init_pages = 262144,
+	};
+	struct vfio_mock_stats stats;
+	int32_t event_pages = 65536;
+	struct ibv_device **list;
+	struct ibv_context *ctx;
+	uint64_t pages;
+	double start;
+	int op, err;
+
+	while ((op = getopt(argc, argv, "b:i:r:l:")) != -1) {
+		switch (op) {
+		case 'b':
+			mock_attr.boot_pages = strtol(optarg, NULL, 0);
+			break;
+		case 'i':
+			mock_attr.init_pages = strtol(optarg, NULL, 0);
+			break;
+		case 'r':
+			event_pages = strtol(optarg, NULL, 0);
+			break;
+		case 'l':
+			mock_attr.cmd_latency_us = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			show_usage(argv[0]);
+			exit(1);
+		}
+	}
+
+	pages = (uint64_t)mock_attr.boot_pages + mock_attr.init_pages;
+	if (mock_attr.boot_pages < 0 || mock_attr.init_pages < 0 ||
+	    event_pages < 0 || event_pages > pages) {
+		show_usage(argv[0]);
+		exit(1);
+	}
+
+	vfio_mock_init(&mock_attr);
+	list = mlx5dv_get_vfio_device_list(&attr);
+	if (!list) {
+		perror("mlx5dv_get_vfio_device_list");
+		return 1;
+	}
+
+	start = now_us();
+	ctx = ibv_open_device(list[0]);
+	if (!ctx) {
+		perror("ibv_open_device");
+		ibv_free_device_list(list);
+		return 1;
+	}
+	print_stats("bringup", now_us() - start);
+
+	vfio_mock_get_stats(&stats);
+	if (stats.pages != pages) {
+		fprintf(stderr, "device holds %llu pages, expected %llu\n",
+			(unsigned long long)stats.pages,
+			(unsigned long long)pages);
+		err = EIO;
+	} else {
+		err = page_request(ctx, -event_pages, pages - event_pages,
+				   "reclaim");
+	}
+
+	if (!err)
+		err = page_request(ctx, event_pages, pages, "give");
+
+	if (err)
+		fprintf(stderr, "benchmark failed: %s\n", strerror(err));
+
+	ibv_close_device(ctx);
+	ibv_free_device_list(list);
+
+	vfio_mock_get_stats(&stats);
+	if (stats.dma_maps) {
+		fprintf(stderr, "%u DMA maps left after close\n",
+			stats.dma_maps);
+		err = EIO;
+	}
+
+	return err ? 1 : 0;
+}
@@ -1074,6 +1074,7 @@ static struct ibv_cq_ex *create_cq(struct ibv_context *context,
 			     mctx->cqe_comp_caps.supported_format)) {
 				cmd_drv->cqe_comp_en = 1;
 				cmd_drv->cqe_comp_res_format = mlx5cq_attr->cqe_comp_res_format;
+				cq->cqe_comp_format = mlx5cq_attr->cqe_comp_res_format;
 			} else {
 				mlx5_dbg(fp, MLX5_DBG_CQ, "CQE Compression is not supported\n");
 				errno = EINVAL;
@@ -6247,7 +6248,7 @@ _mlx5dv_devx_create_cmd_comp(struct ibv_context *context)
 			       MLX5_IB_METHOD_DEVX_ASYNC_CMD_FD_ALLOC,
 			       1);
 	struct ib_uverbs_attr *handle;
-	struct mlx5dv_devx_cmd_comp *cmd_comp;
+	struct mlx5_devx_cmd_comp *cmd_comp;
 	int ret;
 
 	cmd_comp = calloc(1, sizeof(*cmd_comp));
@@ -6264,9 +6265,10 @@ _mlx5dv_devx_create_cmd_comp(struct ibv_context *context)
 	if (ret)
 		goto err;
 
-	cmd_comp->fd = read_attr_fd(
+	cmd_comp->dv_cmd_comp.fd = read_attr_fd(
 		MLX5_IB_ATTR_DEVX_ASYNC_CMD_FD_ALLOC_HANDLE, handle);
-	return cmd_comp;
+	cmd_comp->context = context;
+	return &cmd_comp->dv_cmd_comp;
 err:
 	free(cmd_comp);
 	return NULL;
@@ -6286,16 +6288,28 @@ mlx5dv_devx_create_cmd_comp(struct ibv_context *context)
 }
 
 static void _mlx5dv_devx_destroy_cmd_comp(
-			struct mlx5dv_devx_cmd_comp *cmd_comp)
+			struct mlx5dv_devx_cmd_comp *dv_cmd_comp)
 {
-	close(cmd_comp->fd);
+	struct mlx5_devx_cmd_comp *cmd_comp =
+			container_of(dv_cmd_comp, struct mlx5_devx_cmd_comp,
+				     dv_cmd_comp);
+
+	close(dv_cmd_comp->fd);
 	free(cmd_comp);
 }
 
 void mlx5dv_devx_destroy_cmd_comp(
-			struct mlx5dv_devx_cmd_comp *cmd_comp)
+			struct mlx5dv_devx_cmd_comp *dv_cmd_comp)
 {
-	_mlx5dv_devx_destroy_cmd_comp(cmd_comp);
+	struct mlx5_devx_cmd_comp *cmd_comp =
+			container_of(dv_cmd_comp, struct mlx5_devx_cmd_comp,
+				     dv_cmd_comp);
+	struct mlx5_dv_context_ops *dvops = mlx5_get_dv_ops(cmd_comp->context);
+
+	if (!dvops || !dvops->devx_destroy_cmd_comp)
+		return;
+
+	dvops->devx_destroy_cmd_comp(dv_cmd_comp);
 }
 
 static struct mlx5dv_devx_event_channel *
@@ -6507,12 +6521,20 @@ static int _mlx5dv_devx_get_async_cmd_comp(struct mlx5dv_devx_cmd_comp *cmd_comp
 	return 0;
 }
 
-int mlx5dv_devx_get_async_cmd_comp(struct mlx5dv_devx_cmd_comp *cmd_comp,
+int mlx5dv_devx_get_async_cmd_comp(struct mlx5dv_devx_cmd_comp *dv_cmd_comp,
 				   struct mlx5dv_devx_async_cmd_hdr *cmd_resp,
 				   size_t cmd_resp_len)
 {
-	return _mlx5dv_devx_get_async_cmd_comp(cmd_comp, cmd_resp,
-					       cmd_resp_len);
+	struct mlx5_devx_cmd_comp *cmd_comp =
+			container_of(dv_cmd_comp, struct mlx5_devx_cmd_comp,
+				     dv_cmd_comp);
+	struct mlx5_dv_context_ops *dvops = mlx5_get_dv_ops(cmd_comp->context);
+
+	if (!dvops || !dvops->devx_get_async_cmd_comp)
+		return EOPNOTSUPP;
+
+	return dvops->devx_get_async_cmd_comp(dv_cmd_comp, cmd_resp,
+					      cmd_resp_len);
 }
 
 static int mlx5_destroy_sig_psvs(struct mlx5_sig_ctx *sig)
@@ -216,7 +216,7 @@ static int srpd_sys_read_uint64(const char *dir_name, const char *file_name,
 
 static void usage(const char *argv0)
 {
-	fprintf(stderr, "Usage: %s [-vVcaeon] [-d <umad device> | -i <infiniband device> [-p <port_num>]] [-t <timeout (ms)>] [-r <retries>] [-R <rescan time>] [-f <rules file>\n", argv0);
+	fprintf(stderr, "Usage: %s [-vVcaeon] [-d <umad device> | -i <infiniband device> [-p <port_num>]] [-t <timeout (ms)>] [-r <retries>] [-w <outstanding>] [-R <rescan time>] [-f <rules file>\n", argv0);
 	fprintf(stderr, "-v 			Verbose\n");
 	fprintf(stderr, "-V 			debug Verbose\n");
 	fprintf(stderr, "-c 			prints connection Commands\n");
@@ -233,36 +233,16 @@ static void usage(const char *argv0)
 	fprintf(stderr, "-f <rules file>	use rules File to set to which target(s) to connect (default: " SRP_DAEMON_CONFIG_FILE ")\n");
 	fprintf(stderr, "-t <timeout>		Timeout for mad response in milliseconds\n");
 	fprintf(stderr, "-r <retries>		number of send Retries for each mad\n");
+	fprintf(stderr, "-w <outstanding>	number of DM mads outstanding during a scan (default 32)\n");
 	fprintf(stderr, "-n 			New connection command format - use also initiator extension\n");
 	fprintf(stderr, "--systemd		Enable systemd integration.\n");
 	fprintf(stderr, "\nExample: srp_daemon -e -n -i mthca0 -p 1 -R 60\n");
 }
 
-static int
-check_equal_uint64(char *dir_name, const char *attr, uint64_t val)
-{
-	uint64_t attr_value;
-
-	if (srpd_sys_read_uint64(dir_name, attr, &attr_value))
-		return 0;
-
-	return attr_value == val;
-}
-
-static int
-check_equal_uint16(char *dir_name, const char *attr, uint16_t val)
-{
-	uint64_t attr_value;
-
-	if (srpd_sys_read_uint64(dir_name, attr, &attr_value))
-		return 0;
-
-	return val == (attr_value & 0xffff);
-}
-
 static int recalc(struct resources *res);
 
-static void pr_cmd(char *target_str, int not_connected)
+/* Returns 1 if the target was added through add_target */
+static int pr_cmd(char *target_str, int not_connected)
 {
 	int ret;
 
@@ -273,12 +253,15 @@ static void pr_cmd(char *target_str, int not_connected)
 		int fd = open(config->add_target_file, O_WRONLY);
 		if (fd < 0) {
 			pr_err("unable to open %s, maybe ib_srp is not loaded\n", config->add_target_file);
-			return;
+			return 0;
 		}
 		ret = write(fd, target_str, strlen(target_str));
 		pr_debug("Adding target returned %d\n", ret);
 		close(fd);
+		return ret == strlen(target_str);
 	}
+
+	return 0;
 }
 
 void pr_debug(const char *fmt, ...)
@@ -309,40 +292,6 @@ void pr_err(const char *fmt, ...)
 	va_end(args);
 }
 
-static int check_not_equal_str(const char *dir_name, const char *attr,
-			       const char *value)
-{
-	char attr_value[64];
-	int len = strlen(value);
-
-	if (len > sizeof(attr_value)) {
-		pr_err("string %s is too long\n", value);
-		return 1;
-	}
-
-	if (srpd_sys_read_string(dir_name, attr, attr_value,
-				 sizeof(attr_value)))
-		return 0;
-	if (strncmp(attr_value, value, len))
-		return 1;
-
-	return 0;
-}
-
-static int check_not_equal_int(const char *dir_name, const char *attr,
-			       int value)
-{
-	char attr_value[64];
-
-	if (srpd_sys_read_string(dir_name, attr, attr_value,
-				 sizeof(attr_value)))
-		return 0;
-	if (value != atoi(attr_value))
-		return 1;
-
-	return 0;
-}
-
 static int is_enabled_by_rules_file(struct target_details *target)
 {
 	int rule;
@@ -445,83 +394,247 @@ static bool imm_data_size_gt_send_size(unsigned int send_size)
 	return ret;
 }
 
-static int add_non_exist_target(struct target_details *target)
+/*
+ * Index of the SCSI hosts of the SRP targets that are already connected.
+ * /sys/class/scsi_host/ is read once per scan by refresh_target_index()
+ * instead of once for every target found, and target_is_connected() then
+ * applies the same matching rules to the index.  Accessed by the main and
+ * the retry threads, hence the lock.
+ */
+struct conn_target {
+	uint64_t		id_ext;
+	uint64_t		ioc_guid;
+	uint64_t		service_id;
+	union umad_gid		dgid;
+	int			has_pkey;
+	uint16_t		pkey;
+	int			has_local_ib_device;
+	char			local_ib_device[64];
+	int			local_ib_port;	/* -1 if not in sysfs */
+	struct conn_target     *next;
+};
+
+#define CONN_TARGET_HASH_SIZE 256
+
+static struct conn_target *conn_targets[CONN_TARGET_HASH_SIZE];
+static int conn_targets_valid;
+static pthread_mutex_t conn_targets_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned int conn_target_hash(uint64_t id_ext, uint64_t service_id,
+				     __be64 interface_id)
+{
+	uint64_t h = id_ext ^ (service_id * 0x9e3779b97f4a7c15ull) ^
+		     be64toh(interface_id);
+
+	h ^= h >> 29;
+	h *= 0xbf58476d1ce4e5b9ull;
+	return (h ^ (h >> 32)) & (CONN_TARGET_HASH_SIZE - 1);
+}
+
+static void conn_target_insert(struct conn_target *entry)
+{
+	unsigned int b = conn_target_hash(entry->id_ext, entry->service_id,
+					  entry->dgid.global.interface_id);
+
+	entry->next = conn_targets[b];
+	conn_targets[b] = entry;
+}
+
+static void free_target_index(void)
+{
+	struct conn_target *entry;
+	int i;
+
+	for (i = 0; i < CONN_TARGET_HASH_SIZE; i++) {
+		while ((entry = conn_targets[i])) {
+			conn_targets[i] = entry->next;
+			free(entry);
+		}
+	}
+	conn_targets_valid = 0;
+}
+
+/* Returns NULL for SCSI hosts that can never match a target */
+static struct conn_target *read_conn_target(const char *scsi_host_dir)
+{
+	struct conn_target *entry;
+	uint64_t val;
+	char str[64];
+
+	entry = calloc(1, sizeof(*entry));
+	if (!entry)
+		return NULL;
+
+	if (srpd_sys_read_uint64(scsi_host_dir, "id_ext", &entry->id_ext) ||
+	    srpd_sys_read_uint64(scsi_host_dir, "service_id",
+				 &entry->service_id) ||
+	    srpd_sys_read_uint64(scsi_host_dir, "ioc_guid", &entry->ioc_guid))
+		goto skip;
+
+	/*
+	 * In case this is an old kernel that does not have orig_dgid in
+	 * sysfs, use dgid instead (this is problematic when there is a dgid
+	 * redirection by the CM)
+	 */
+	if (srpd_sys_read_gid(scsi_host_dir, "orig_dgid", entry->dgid.raw) &&
+	    srpd_sys_read_gid(scsi_host_dir, "dgid", entry->dgid.raw))
+		goto skip;
+
+	if (!srpd_sys_read_uint64(scsi_host_dir, "pkey", &val)) {
+		entry->has_pkey = 1;
+		entry->pkey = val & 0xffff;
+	}
+
+	/* Old kernel modules have no local_ib_device and local_ib_port */
+	if (!srpd_sys_read_string(scsi_host_dir, "local_ib_device",
+				  entry->local_ib_device,
+				  sizeof(entry->local_ib_device)))
+		entry->has_local_ib_device = 1;
+	entry->local_ib_port = -1;
+	if (!srpd_sys_read_string(scsi_host_dir, "local_ib_port", str,
+				  sizeof(str)))
+		entry->local_ib_port = atoi(str);
+
+	return entry;
+
+skip:
+	free(entry);
+	return NULL;
+}
+
+static int refresh_target_index(void)
 {
 	char scsi_host_dir[256];
-	DIR *dir;
+	struct conn_target *entry;
 	struct dirent *subdir;
-	char *subdir_name_ptr;
-	int prefix_len;
-	union umad_gid dgid_val;
-	char target_config_str[255];
-	int len;
-	int not_connected = 1;
-	unsigned int send_size;
-
-	pr_debug("Found an SRP target with id_ext %s - check if it is already connected\n", target->id_ext);
+	int prefix_len, n = 0;
+	DIR *dir;
 
 	strcpy(scsi_host_dir, "/sys/class/scsi_host/");
-	dir=opendir(scsi_host_dir);
+	prefix_len = strlen(scsi_host_dir);
+
+	pthread_mutex_lock(&conn_targets_lock);
+	free_target_index();
+
+	dir = opendir(scsi_host_dir);
 	if (!dir) {
 		perror("opendir - /sys/class/scsi_host/");
+		pthread_mutex_unlock(&conn_targets_lock);
 		return -1;
 	}
-	prefix_len = strlen(scsi_host_dir);
-	subdir_name_ptr = scsi_host_dir + prefix_len;
-
-	subdir = (void *) 1; /* Dummy value to enter the loop */
-	while (subdir) {
-	        subdir = readdir(dir);
-
-		if (!subdir)
-			continue;
 
+	while ((subdir = readdir(dir))) {
 		if (subdir->d_name[0] == '.')
 			continue;
 
-		strncpy(subdir_name_ptr, subdir->d_name,
+		strncpy(scsi_host_dir + prefix_len, subdir->d_name,
 			sizeof(scsi_host_dir) - prefix_len);
-		if (!check_equal_uint64(scsi_host_dir, "id_ext",
-				        strtoull(target->id_ext, NULL, 16)))
-			continue;
-		if (!check_equal_uint16(scsi_host_dir, "pkey", target->pkey) &&
-		    !config->execute)
+		entry = read_conn_target(scsi_host_dir);
+		if (!entry)
 			continue;
+		conn_target_insert(entry);
+		n++;
+	}
+	closedir(dir);
+
+	conn_targets_valid = 1;
+	pthread_mutex_unlock(&conn_targets_lock);
 
-		if (!check_equal_uint64(scsi_host_dir, "service_id",
-					target->h_service_id))
+	pr_debug("%d connected SRP targets in sysfs\n", n);
+	return 0;
+}
+
+/* Record a target that was just connected, before the next refresh */
+static void add_to_target_index(struct target_details *target)
+{
+	struct conn_target *entry;
+
+	entry = calloc(1, sizeof(*entry));
+	if (!entry)
+		return;
+
+	entry->id_ext = strtoull(target->id_ext, NULL, 16);
+	entry->ioc_guid = be64toh(target->ioc_prof.guid);
+	entry->service_id = target->h_service_id;
+	entry->dgid.global.subnet_prefix = htobe64(target->subnet_prefix);
+	entry->dgid.global.interface_id = htobe64(target->h_guid);
+	entry->has_pkey = 1;
+	entry->pkey = target->pkey;
+	entry->has_local_ib_device = 1;
+	snprintf(entry->local_ib_device, sizeof(entry->local_ib_device), "%s",
+		 config->dev_name);
+	entry->local_ib_port = config->port_num;
+
+	pthread_mutex_lock(&conn_targets_lock);
+	if (conn_targets_valid)
+		conn_target_insert(entry);
+	else
+		free(entry);
+	pthread_mutex_unlock(&conn_targets_lock);
+}
+
+/*
+ * Returns 1 if the target is connected through the local port, 0 if not and
+ * -1 if the SCSI hosts could not be read.
+ */
+static int target_is_connected(struct target_details *target)
+{
+	uint64_t id_ext = strtoull(target->id_ext, NULL, 16);
+	int len = strlen(config->dev_name);
+	struct conn_target *entry;
+	union umad_gid dgid;
+	int ret = 0;
+
+	dgid.global.subnet_prefix = htobe64(target->subnet_prefix);
+	dgid.global.interface_id = htobe64(target->h_guid);
+
+	pthread_mutex_lock(&conn_targets_lock);
+	if (!conn_targets_valid) {
+		pthread_mutex_unlock(&conn_targets_lock);
+		return -1;
+	}
+
+	for (entry = conn_targets[conn_target_hash(id_ext,
+						   target->h_service_id,
+						   dgid.global.interface_id)];
+	     entry; entry = entry->next) {
+		if (entry->id_ext != id_ext ||
+		    entry->service_id != target->h_service_id ||
+		    entry->ioc_guid != be64toh(target->ioc_prof.guid) ||
+		    memcmp(&entry->dgid, &dgid, sizeof(dgid)))
 			continue;
-		if (!check_equal_uint64(scsi_host_dir, "ioc_guid",
-					be64toh(target->ioc_prof.guid)))
+		if ((!entry->has_pkey || entry->pkey != target->pkey) &&
+		    !config->execute)
 			continue;
-		if (srpd_sys_read_gid(scsi_host_dir, "orig_dgid",
-				      dgid_val.raw)) {
-			/*
-			 * In case this is an old kernel that does not have
-			 * orig_dgid in sysfs, use dgid instead (this is
-			 * problematic when there is a dgid redirection
-			 * by the CM)
-			 */
-			if (srpd_sys_read_gid(scsi_host_dir, "dgid",
-					      dgid_val.raw))
-				continue;
-		}
-		if (htobe64(target->subnet_prefix) !=
-		    dgid_val.global.subnet_prefix)
+		if (entry->has_local_ib_device &&
+		    (len > sizeof(entry->local_ib_device) ||
+		     strncmp(entry->local_ib_device, config->dev_name, len)))
 			continue;
-		if (htobe64(target->h_guid) != dgid_val.global.interface_id)
+		if (entry->local_ib_port >= 0 &&
+		    entry->local_ib_port != config->port_num)
 			continue;
 
-		/* If there is no local_ib_device in the scsi host dir (old kernel module), assumes it is equal */
-		if (check_not_equal_str(scsi_host_dir, "local_ib_device", config->dev_name))
-			continue;
+		ret = 1;
+		break;
+	}
+	pthread_mutex_unlock(&conn_targets_lock);
 
-		/* If there is no local_ib_port in the scsi host dir (old kernel module), assumes it is equal */
-		if (check_not_equal_int(scsi_host_dir, "local_ib_port", config->port_num))
-			continue;
+	return ret;
+}
+
+static int add_non_exist_target(struct target_details *target)
+{
+	char target_config_str[255];
+	int len;
+	int not_connected = 1;
+	unsigned int send_size;
 
-		/* there is a match - this target is already connected */
+	pr_debug("Found an SRP target with id_ext %s - check if it is already connected\n", target->id_ext);
 
+	switch (target_is_connected(target)) {
+	case -1:
+		return -1;
+	case 1:
 		/* There is a rare possibility of a race in the following
 		   scenario:
 			a. A link goes down,
@@ -539,8 +652,6 @@ static int add_non_exist_target(struct target_details *target)
 		   if this target exist in the near future.
 		*/
 
-
-
 		/* If there is a need to print all we will continue to pr_cmd.
 		   not_connected is set to zero to make sure that this target
 		   will be printed but not connected.
@@ -551,10 +662,7 @@ static int add_non_exist_target(struct target_details *target)
 		}
 
 		pr_debug("This target is already connected - skip\n");
-		closedir(dir);
-
 		return 0;
-
 	}
 
 	len = snprintf(target_config_str, sizeof(target_config_str), "id_ext=%s,"
@@ -570,7 +678,6 @@ static int add_non_exist_target(struct target_details *target)
 		(unsigned long long) target->h_service_id);
 	if (len >= sizeof(target_config_str)) {
 		pr_err("Target config string is too long, ignoring target\n");
-		closedir(dir);
 		return -1;
 	}
 
@@ -581,7 +688,6 @@ static int add_non_exist_target(struct target_details *target)
 
 		if (len >= sizeof(target_config_str)) {
 			pr_err("Target config string is too long, ignoring target\n");
-			closedir(dir);
 			return -1;
 		}
 	}
@@ -594,7 +700,6 @@ static int add_non_exist_target(struct target_details *target)
 
 		if (len >= sizeof(target_config_str)) {
 			pr_err("Target config string is too long, ignoring target\n");
-			closedir(dir);
 			return -1;
 		}
 	}
@@ -606,7 +711,6 @@ static int add_non_exist_target(struct target_details *target)
 
 		if (len >= sizeof(target_config_str)) {
 			pr_err("Target config string is too long, ignoring target\n");
-			closedir(dir);
 			return -1;
 		}
 	}
@@ -619,7 +723,6 @@ static int add_non_exist_target(struct target_details *target)
 
 		if (len >= sizeof(target_config_str)) {
 			pr_err("Target config string is too long, ignoring target\n");
-			closedir(dir);
 			return -1;
 		}
 	}
@@ -638,20 +741,29 @@ static int add_non_exist_target(struct target_details *target)
 
 		if (len >= sizeof(target_config_str)) {
 			pr_err("Target config string is too long, ignoring target\n");
-			closedir(dir);
 			return -1;
 		}
 	}
 
 	target_config_str[len] = '\0';
 
-	pr_cmd(target_config_str, not_connected);
-
-	closedir(dir);
+	if (pr_cmd(target_config_str, not_connected))
+		add_to_target_index(target);
 
 	return 1;
 }
 
+/* Shared by all the MADs sent, so that stale replies are always older */
+static uint32_t next_tid(void)
+{
+	static uint32_t tid;
+
+	/* Skip tid 0 because OpenSM ignores it. */
+	if (++tid == 0)
+		++tid;
+	return tid;
+}
+
 static int send_and_get(int portid, int agent, struct srp_ib_user_mad *out_mad,
 		 struct srp_ib_user_mad *in_mad, int in_mad_size)
 {
@@ -660,13 +772,10 @@ static int send_and_get(int portid, int agent, struct srp_ib_user_mad *out_mad,
 	int i, len;
 	int in_agent;
 	int ret;
-	static uint32_t tid;
-	uint32_t received_tid;
+	uint32_t tid, received_tid;
 
 	for (i = 0; i < config->mad_retries; ++i) {
-		/* Skip tid 0 because OpenSM ignores it. */
-		if (++tid == 0)
-			++tid;
+		tid = next_tid();
 		out_dm_mad->mad_hdr.tid = htobe64(tid);
 
 		ret = umad_send(portid, agent, out_mad, MAD_BLOCK_SIZE,
@@ -930,138 +1039,139 @@ static int set_class_port_info(struct umad_resources *umad_res, uint16_t dlid, u
 	return 0;
 }
 
-static int get_iou_info(struct umad_resources *umad_res, uint16_t dlid,
-			uint16_t h_pkey, struct srp_dm_iou_info *iou_info)
-{
-	struct srp_ib_user_mad		in_mad, out_mad;
-	struct umad_dm_packet	       *in_dm_mad;
+/*
+ * Pipelined DM discovery.  The DM queries of all the ports found by a scan
+ * share one window of up to config->mad_window outstanding MADs.  The
+ * IOUnitInfo reply of a port queues its IOControllerProfile queries and every
+ * profile queues its ServiceEntries queries; follow-up queries go to the head
+ * of the queue so that started ports finish first.  A port is reported once
+ * all of its queries completed, so its output is the same as when querying
+ * one MAD at a time.
+ */
+struct dm_ioc {
+	int				prof_valid;
+	struct srp_dm_ioc_prof		prof;
+	struct srp_dm_svc_entries      *svc;	/* 4 service entries each */
+	uint8_t			       *svc_valid;
+};
 
-	init_srp_dm_mad(&out_mad, umad_res->agent, dlid, SRP_DM_ATTR_IO_UNIT_INFO, 0);
-	if (pkey_to_pkey_index(umad_res, h_pkey, &out_mad.hdr.addr.pkey_index)
-	    < 0) {
-		pr_err("get_iou_info: Unable to find pkey_index for pkey %#x\n", h_pkey);
-		return -1;
-	}
+struct dm_port {
+	uint16_t		pkey;
+	uint16_t		dlid;
+	uint16_t		pkey_index;
+	uint64_t		subnet_prefix;
+	uint64_t		h_guid;
+	int			iou_valid;
+	struct srp_dm_iou_info	iou_info;
+	struct dm_ioc	       *ioc;	/* iou_info.max_controllers entries */
+	int			pending;
+};
 
-	if (send_and_get(umad_res->portid, umad_res->agent, &out_mad, &in_mad, 0) < 0)
-		return -1;
+struct dm_query {
+	struct dm_port	       *port;
+	uint16_t		attr_id;
+	uint32_t		attr_mod;
+	uint32_t		tid;
+	int			sends;
+	struct dm_query	       *next;
+};
 
-	in_dm_mad = get_data_ptr(in_mad);
-	if (in_dm_mad->mad_hdr.status) {
-		pr_err("IO Unit Info query returned status 0x%04x\n",
-			be16toh(in_dm_mad->mad_hdr.status));
-		return -1;
-	}
+struct dm_scan {
+	struct resources       *res;
+	struct dm_query	       *head;
+	struct dm_query	       *tail;
+	struct dm_query	      **inflight;
+	int			n_inflight;
+	int			n_ports;
+};
 
-	memcpy(iou_info, in_dm_mad->data, sizeof *iou_info);
-/*
-	pr_debug("iou_info->max_controllers is %d\n", iou_info->max_controllers);
-*/
-	return 0;
+static int ioc_present(struct srp_dm_iou_info *iou_info, int i)
+{
+	return ((iou_info->controller_list[i / 2] >> (4 * (1 - i % 2))) & 0xf) ==
+		SRP_DM_IOC_PRESENT;
 }
 
-static int get_ioc_prof(struct umad_resources *umad_res, uint16_t h_dlid, uint16_t h_pkey, int ioc,
-			struct srp_dm_ioc_prof *ioc_prof)
+static void free_dm_port(struct dm_port *port)
 {
-	struct srp_ib_user_mad		in_mad, out_mad;
-	struct umad_dm_packet	       *in_dm_mad;
-
-	init_srp_dm_mad(&out_mad, umad_res->agent, h_dlid, SRP_DM_ATTR_IO_CONTROLLER_PROFILE, ioc);
-
-	if (pkey_to_pkey_index(umad_res, h_pkey, &out_mad.hdr.addr.pkey_index)
-	    < 0) {
-		pr_err("get_ioc_prof: Unable to find pkey_index for pkey %#x\n",
-		       h_pkey);
-		return -1;
-	}
-
-	if (send_and_get(umad_res->portid, umad_res->agent, &out_mad, &in_mad, 0) < 0)
-		return -1;
+	int i;
 
-	in_dm_mad = get_data_ptr(in_mad);
-	if (in_dm_mad->mad_hdr.status) {
-		pr_err("IO Controller Profile query returned status 0x%04x for %d\n",
-			be16toh(in_dm_mad->mad_hdr.status), ioc);
-		return -1;
+	if (port->ioc) {
+		for (i = 0; i < port->iou_info.max_controllers; ++i) {
+			free(port->ioc[i].svc);
+			free(port->ioc[i].svc_valid);
+		}
+		free(port->ioc);
 	}
-
-	memcpy(ioc_prof, in_dm_mad->data, sizeof *ioc_prof);
-
-	return 0;
+	free(port);
 }
 
-static int get_svc_entries(struct umad_resources *umad_res, uint16_t dlid, uint16_t h_pkey, int ioc,
-			   int start, int end, struct srp_dm_svc_entries *svc_entries)
+/* Follow-up queries go first, they complete a port already started */
+static void dm_push(struct dm_scan *scan, struct dm_query *query,
+		    int follow_up)
 {
-	struct srp_ib_user_mad		in_mad, out_mad;
-	struct umad_dm_packet	       *in_dm_mad;
-
-	init_srp_dm_mad(&out_mad, umad_res->agent, dlid, SRP_DM_ATTR_SERVICE_ENTRIES,
-			(ioc << 16) | (end << 8) | start);
-
-	if (pkey_to_pkey_index(umad_res, h_pkey, &out_mad.hdr.addr.pkey_index)
-	    < 0) {
-		pr_err("get_svc_entries: Unable to find pkey_index for pkey %#x\n",
-		       h_pkey);
-		return -1;
+	if (follow_up) {
+		query->next = scan->head;
+		scan->head = query;
+		if (!scan->tail)
+			scan->tail = query;
+	} else {
+		if (scan->tail)
+			scan->tail->next = query;
+		else
+			scan->head = query;
+		scan->tail = query;
 	}
+}
 
-	if (send_and_get(umad_res->portid, umad_res->agent, &out_mad, &in_mad, 0) < 0)
-		return -1;
+static void dm_queue(struct dm_scan *scan, struct dm_port *port,
+		     uint16_t h_attr_id, uint32_t h_attr_mod, int follow_up)
+{
+	struct dm_query *query;
 
-	in_dm_mad = get_data_ptr(in_mad);
-	if (in_dm_mad->mad_hdr.status) {
-		pr_err("Service Entries query returned status 0x%04x\n",
-			be16toh(in_dm_mad->mad_hdr.status));
-		return -1;
+	query = calloc(1, sizeof(*query));
+	if (!query) {
+		pr_err("Couldn't allocate DM query for dlid %#x\n", port->dlid);
+		return;
 	}
 
-	memcpy(svc_entries, in_dm_mad->data, sizeof *svc_entries);
-
-	return 0;
+	query->port = port;
+	query->attr_id = h_attr_id;
+	query->attr_mod = h_attr_mod;
+	port->pending++;
+	dm_push(scan, query, follow_up);
 }
 
-static int do_port(struct resources *res, uint16_t pkey, uint16_t dlid,
-		   uint64_t subnet_prefix, uint64_t h_guid)
+static void report_dm_port(struct resources *res, struct dm_port *port)
 {
-	struct umad_resources 	       *umad_res = res->umad_res;
-	struct srp_dm_iou_info		iou_info;
-	struct srp_dm_svc_entries	svc_entries;
-	int				i, j, k, ret;
+	struct srp_dm_iou_info	       *iou_info = &port->iou_info;
+	struct srp_dm_svc_entries      *svc_entries;
+	struct target_details	       *target;
+	struct dm_ioc		       *ioc;
+	int				i, j, k;
 
-	static const uint64_t topspin_oui = 0x0005ad0000000000ull;
-	static const uint64_t oui_mask    = 0xffffff0000000000ull;
+	if (!port->iou_valid)
+		return;
 
-	struct target_details *target = (struct target_details *)
-		malloc(sizeof(struct target_details));
+	target = calloc(1, sizeof(*target));
+	if (!target)
+		return;
 
-	target->subnet_prefix = subnet_prefix;
-	target->h_guid = h_guid;
+	target->subnet_prefix = port->subnet_prefix;
+	target->h_guid = port->h_guid;
 	target->options = NULL;
 
- 	pr_debug("enter do_port\n");
-	if ((target->h_guid & oui_mask) == topspin_oui &&
-	    set_class_port_info(umad_res, dlid, pkey))
-		pr_err("Warning: set of ClassPortInfo failed\n");
-
-	ret = get_iou_info(umad_res, dlid, pkey, &iou_info);
-	if (ret < 0) {
-		pr_err("failed to get iou info for dlid %#x\n", dlid);
-		goto out;
-	}
-
 	pr_human("IO Unit Info:\n");
-	pr_human("    port LID:        %04x\n", dlid);
+	pr_human("    port LID:        %04x\n", port->dlid);
 	pr_human("    port GID:        %016llx%016llx\n",
 		 (unsigned long long) target->subnet_prefix,
 		 (unsigned long long) target->h_guid);
-	pr_human("    change ID:       %04x\n", be16toh(iou_info.change_id));
-	pr_human("    max controllers: 0x%02x\n", iou_info.max_controllers);
+	pr_human("    change ID:       %04x\n", be16toh(iou_info->change_id));
+	pr_human("    max controllers: 0x%02x\n", iou_info->max_controllers);
 
 	if (config->verbose > 0)
-		for (i = 0; i < iou_info.max_controllers; ++i) {
+		for (i = 0; i < iou_info->max_controllers; ++i) {
 			pr_human("    controller[%3d]: ", i + 1);
-			switch ((iou_info.controller_list[i / 2] >>
+			switch ((iou_info->controller_list[i / 2] >>
 				 (4 * (1 - i % 2))) & 0xf) {
 			case SRP_DM_NO_IOC:      pr_human("not installed\n"); break;
 			case SRP_DM_IOC_PRESENT: pr_human("present\n");       break;
@@ -1070,57 +1180,59 @@ static int do_port(struct resources *res, uint16_t pkey, uint16_t dlid,
 			}
 		}
 
-	for (i = 0; i < iou_info.max_controllers; ++i) {
-		if (((iou_info.controller_list[i / 2] >> (4 * (1 - i % 2))) & 0xf) ==
-		    SRP_DM_IOC_PRESENT) {
-			pr_human("\n");
+	for (i = 0; i < iou_info->max_controllers; ++i) {
+		if (!ioc_present(iou_info, i))
+			continue;
 
-			if (get_ioc_prof(umad_res, dlid, pkey, i + 1, &target->ioc_prof))
-				continue;
+		pr_human("\n");
 
-			pr_human("    controller[%3d]\n", i + 1);
+		ioc = &port->ioc[i];
+		if (!ioc->prof_valid)
+			continue;
+		target->ioc_prof = ioc->prof;
+
+		pr_human("    controller[%3d]\n", i + 1);
 
-			pr_human("        GUID:      %016llx\n",
-				 (unsigned long long) be64toh(target->ioc_prof.guid));
-			pr_human("        vendor ID: %06x\n", be32toh(target->ioc_prof.vendor_id) >> 8);
-			pr_human("        device ID: %06x\n", be32toh(target->ioc_prof.device_id));
-			pr_human("        IO class : %04hx\n", be16toh(target->ioc_prof.io_class));
-			pr_human("        Maximum size of Send Messages in bytes: %d\n",
-				 be32toh(target->ioc_prof.send_size));
-			pr_human("        ID:        %s\n", target->ioc_prof.id);
-			pr_human("        service entries: %d\n", target->ioc_prof.service_entries);
+		pr_human("        GUID:      %016llx\n",
+			 (unsigned long long) be64toh(target->ioc_prof.guid));
+		pr_human("        vendor ID: %06x\n", be32toh(target->ioc_prof.vendor_id) >> 8);
+		pr_human("        device ID: %06x\n", be32toh(target->ioc_prof.device_id));
+		pr_human("        IO class : %04hx\n", be16toh(target->ioc_prof.io_class));
+		pr_human("        Maximum size of Send Messages in bytes: %d\n",
+			 be32toh(target->ioc_prof.send_size));
+		pr_human("        ID:        %s\n", target->ioc_prof.id);
+		pr_human("        service entries: %d\n", target->ioc_prof.service_entries);
 
-			for (j = 0; j < target->ioc_prof.service_entries; j += 4) {
-				int n;
+		for (j = 0; j < target->ioc_prof.service_entries; j += 4) {
+			int n;
 
-				n = j + 3;
-				if (n >= target->ioc_prof.service_entries)
-					n = target->ioc_prof.service_entries - 1;
+			n = j + 3;
+			if (n >= target->ioc_prof.service_entries)
+				n = target->ioc_prof.service_entries - 1;
 
-				if (get_svc_entries(umad_res, dlid, pkey, i + 1,
-						    j, n, &svc_entries))
+			if (!ioc->svc_valid[j / 4])
+				continue;
+			svc_entries = &ioc->svc[j / 4];
+
+			for (k = 0; k <= n - j; ++k) {
+
+				if (sscanf(svc_entries->service[k].name,
+					   "SRP.T10:%16s",
+					   target->id_ext) != 1)
 					continue;
 
-				for (k = 0; k <= n - j; ++k) {
-
-					if (sscanf(svc_entries.service[k].name,
-						   "SRP.T10:%16s",
-						   target->id_ext) != 1)
-						continue;
-
-					pr_human("            service[%3d]: %016llx / %s\n",
-						 j + k,
-						 (unsigned long long) be64toh(svc_entries.service[k].id),
-						 svc_entries.service[k].name);
-
-					target->h_service_id = be64toh(svc_entries.service[k].id);
-					target->pkey = pkey;
-					if (is_enabled_by_rules_file(target)) {
-						if (!add_non_exist_target(target) && !config->once) {
-							target->retry_time =
-								time(NULL) + config->retry_timeout;
-							push_to_retry_list(res->sync_res, target);
-						}
+				pr_human("            service[%3d]: %016llx / %s\n",
+					 j + k,
+					 (unsigned long long) be64toh(svc_entries->service[k].id),
+					 svc_entries->service[k].name);
+
+				target->h_service_id = be64toh(svc_entries->service[k].id);
+				target->pkey = port->pkey;
+				if (is_enabled_by_rules_file(target)) {
+					if (!add_non_exist_target(target) && !config->once) {
+						target->retry_time =
+							time(NULL) + config->retry_timeout;
+						push_to_retry_list(res->sync_res, target);
 					}
 				}
 			}
@@ -1129,11 +1241,303 @@ static int do_port(struct resources *res, uint16_t pkey, uint16_t dlid,
 
 	pr_human("\n");
 
-out:
 	free(target);
+}
+
+static void dm_iou_info_done(struct dm_scan *scan, struct dm_port *port,
+			     struct umad_dm_packet *in_dm_mad)
+{
+	struct srp_dm_iou_info *iou_info = &port->iou_info;
+	int i;
+
+	if (!in_dm_mad) {
+		pr_err("failed to get iou info for dlid %#x\n", port->dlid);
+		return;
+	}
+	if (in_dm_mad->mad_hdr.status) {
+		pr_err("IO Unit Info query returned status 0x%04x\n",
+			be16toh(in_dm_mad->mad_hdr.status));
+		pr_err("failed to get iou info for dlid %#x\n", port->dlid);
+		return;
+	}
+
+	memcpy(iou_info, in_dm_mad->data, sizeof(*iou_info));
+	if (iou_info->max_controllers) {
+		port->ioc = calloc(iou_info->max_controllers,
+				   sizeof(*port->ioc));
+		if (!port->ioc) {
+			pr_err("failed to get iou info for dlid %#x\n",
+			       port->dlid);
+			return;
+		}
+	}
+	port->iou_valid = 1;
+
+	for (i = 0; i < iou_info->max_controllers; ++i)
+		if (ioc_present(iou_info, i))
+			dm_queue(scan, port, SRP_DM_ATTR_IO_CONTROLLER_PROFILE,
+				 i + 1, 1);
+}
+
+static void dm_ioc_prof_done(struct dm_scan *scan, struct dm_port *port,
+			     int ioc_num, struct umad_dm_packet *in_dm_mad)
+{
+	struct dm_ioc *ioc = &port->ioc[ioc_num - 1];
+	int j, n, blocks;
+
+	if (!in_dm_mad)
+		return;
+	if (in_dm_mad->mad_hdr.status) {
+		pr_err("IO Controller Profile query returned status 0x%04x for %d\n",
+			be16toh(in_dm_mad->mad_hdr.status), ioc_num);
+		return;
+	}
+
+	memcpy(&ioc->prof, in_dm_mad->data, sizeof(ioc->prof));
+	blocks = (ioc->prof.service_entries + 3) / 4;
+	if (blocks) {
+		ioc->svc = calloc(blocks, sizeof(*ioc->svc));
+		ioc->svc_valid = calloc(blocks, sizeof(*ioc->svc_valid));
+		if (!ioc->svc || !ioc->svc_valid) {
+			free(ioc->svc);
+			free(ioc->svc_valid);
+			ioc->svc = NULL;
+			ioc->svc_valid = NULL;
+			return;
+		}
+	}
+	ioc->prof_valid = 1;
+
+	for (j = 0; j < ioc->prof.service_entries; j += 4) {
+		n = j + 3;
+		if (n >= ioc->prof.service_entries)
+			n = ioc->prof.service_entries - 1;
+		dm_queue(scan, port, SRP_DM_ATTR_SERVICE_ENTRIES,
+			 (ioc_num << 16) | (n << 8) | j, 1);
+	}
+}
+
+static void dm_svc_entries_done(struct dm_port *port, uint32_t h_attr_mod,
+				struct umad_dm_packet *in_dm_mad)
+{
+	struct dm_ioc *ioc = &port->ioc[(h_attr_mod >> 16) - 1];
+	int block = (h_attr_mod & 0xff) / 4;
+
+	if (!in_dm_mad)
+		return;
+	if (in_dm_mad->mad_hdr.status) {
+		pr_err("Service Entries query returned status 0x%04x\n",
+			be16toh(in_dm_mad->mad_hdr.status));
+		return;
+	}
+
+	memcpy(&ioc->svc[block], in_dm_mad->data, sizeof(ioc->svc[block]));
+	ioc->svc_valid[block] = 1;
+}
+
+/* in_dm_mad is NULL if the query failed */
+static void dm_query_done(struct dm_scan *scan, struct dm_query *query,
+			  struct umad_dm_packet *in_dm_mad)
+{
+	struct dm_port *port = query->port;
+
+	switch (query->attr_id) {
+	case SRP_DM_ATTR_IO_UNIT_INFO:
+		dm_iou_info_done(scan, port, in_dm_mad);
+		break;
+	case SRP_DM_ATTR_IO_CONTROLLER_PROFILE:
+		dm_ioc_prof_done(scan, port, query->attr_mod, in_dm_mad);
+		break;
+	case SRP_DM_ATTR_SERVICE_ENTRIES:
+		dm_svc_entries_done(port, query->attr_mod, in_dm_mad);
+		break;
+	}
+	free(query);
+
+	if (--port->pending)
+		return;
+
+	report_dm_port(scan->res, port);
+	free_dm_port(port);
+}
+
+static int dm_send(struct dm_scan *scan, struct dm_query *query)
+{
+	struct umad_resources *umad_res = scan->res->umad_res;
+	struct srp_ib_user_mad out_mad;
+	struct umad_dm_packet *out_dm_mad = get_data_ptr(out_mad);
+	int ret;
+
+	init_srp_dm_mad(&out_mad, umad_res->agent, query->port->dlid,
+			query->attr_id, query->attr_mod);
+	out_mad.hdr.addr.pkey_index = query->port->pkey_index;
+	query->tid = next_tid();
+	out_dm_mad->mad_hdr.tid = htobe64(query->tid);
+	query->sends++;
+
+	ret = umad_send(umad_res->portid, umad_res->agent, &out_mad,
+			MAD_BLOCK_SIZE, config->timeout, 0);
+	if (ret < 0)
+		pr_err("umad_send to %u failed\n", query->port->dlid);
 	return ret;
 }
 
+static void dm_fill_window(struct dm_scan *scan)
+{
+	struct dm_query *query;
+	int i = 0;
+
+	while (scan->head && scan->n_inflight < config->mad_window) {
+		query = scan->head;
+		scan->head = query->next;
+		if (!scan->head)
+			scan->tail = NULL;
+		query->next = NULL;
+
+		if (dm_send(scan, query) < 0) {
+			dm_query_done(scan, query, NULL);
+			continue;
+		}
+
+		while (scan->inflight[i])
+			i++;
+		scan->inflight[i] = query;
+		scan->n_inflight++;
+	}
+}
+
+static void dm_recv(struct dm_scan *scan)
+{
+	struct umad_resources *umad_res = scan->res->umad_res;
+	struct umad_dm_packet *in_dm_mad;
+	struct srp_ib_user_mad in_mad;
+	struct dm_query *query;
+	uint32_t received_tid;
+	int i, len, in_agent, status;
+
+	len = MAD_BLOCK_SIZE;
+	/* The kernel reports a send that timed out as a receive */
+	in_agent = umad_recv(umad_res->portid, (struct ib_user_mad *) &in_mad,
+			     &len, 2 * config->timeout);
+	if (in_agent < 0) {
+		pr_err("umad_recv failed - %d\n", in_agent);
+		for (i = 0; i < config->mad_window; ++i) {
+			query = scan->inflight[i];
+			if (!query)
+				continue;
+			scan->inflight[i] = NULL;
+			scan->n_inflight--;
+			dm_query_done(scan, query, NULL);
+		}
+		return;
+	}
+	if (in_agent != umad_res->agent) {
+		pr_debug("umad_recv returned different agent\n");
+		return;
+	}
+
+	in_dm_mad = get_data_ptr(in_mad);
+	received_tid = be64toh(in_dm_mad->mad_hdr.tid);
+	for (i = 0; i < config->mad_window; ++i)
+		if (scan->inflight[i] && scan->inflight[i]->tid == received_tid)
+			break;
+	if (i == config->mad_window) {
+		pr_debug("umad_recv returned unknown transaction id %d\n",
+			 received_tid);
+		return;
+	}
+
+	query = scan->inflight[i];
+	scan->inflight[i] = NULL;
+	scan->n_inflight--;
+
+	/*
+	 * Each send gets a single timeout, so retry here rather than in the
+	 * kernel: its retries would hold the query longer than the receive
+	 * timeout above.  The retry goes out next, with a fresh tid.
+	 */
+	status = umad_status(&in_mad);
+	if (status == ETIMEDOUT && query->sends < config->mad_retries) {
+		pr_debug("query %#x:%#x to lid %#x timed out, retrying\n",
+			 query->attr_id, query->attr_mod, query->port->dlid);
+		dm_push(scan, query, 1);
+		return;
+	}
+	if (status) {
+		pr_err("bad MAD status (%u) from lid %#x\n", status,
+		       query->port->dlid);
+		in_dm_mad = NULL;
+	}
+	dm_query_done(scan, query, in_dm_mad);
+}
+
+static int init_dm_scan(struct dm_scan *scan, struct resources *res)
+{
+	memset(scan, 0, sizeof(*scan));
+	scan->res = res;
+	scan->inflight = calloc(config->mad_window, sizeof(*scan->inflight));
+	return scan->inflight ? 0 : -ENOMEM;
+}
+
+static void add_dm_port(struct dm_scan *scan, uint16_t pkey, uint16_t dlid,
+			uint64_t subnet_prefix, uint64_t h_guid)
+{
+	struct umad_resources *umad_res = scan->res->umad_res;
+	struct dm_port *port;
+
+	static const uint64_t topspin_oui = 0x0005ad0000000000ull;
+	static const uint64_t oui_mask    = 0xffffff0000000000ull;
+
+	pr_debug("enter add_dm_port\n");
+	port = calloc(1, sizeof(*port));
+	if (!port)
+		return;
+
+	port->pkey = pkey;
+	port->dlid = dlid;
+	port->subnet_prefix = subnet_prefix;
+	port->h_guid = h_guid;
+
+	if (pkey_to_pkey_index(umad_res, pkey, &port->pkey_index) < 0) {
+		pr_err("add_dm_port: Unable to find pkey_index for pkey %#x\n",
+		       pkey);
+		pr_err("failed to get iou info for dlid %#x\n", dlid);
+		free(port);
+		return;
+	}
+
+	/* Sent right away, no DM query of this scan is outstanding yet */
+	if ((h_guid & oui_mask) == topspin_oui &&
+	    set_class_port_info(umad_res, dlid, pkey))
+		pr_err("Warning: set of ClassPortInfo failed\n");
+
+	dm_queue(scan, port, SRP_DM_ATTR_IO_UNIT_INFO, 0, 0);
+	if (!port->pending) {
+		free(port);
+		return;
+	}
+	scan->n_ports++;
+}
+
+/* Runs the DM queries of all the ports added to the scan and frees it */
+static void run_dm_scan(struct dm_scan *scan)
+{
+	if (scan->n_ports) {
+		pr_debug("querying %d DM ports, up to %d MADs outstanding\n",
+			 scan->n_ports, config->mad_window);
+		refresh_target_index();
+	}
+
+	for (;;) {
+		dm_fill_window(scan);
+		if (!scan->n_inflight)
+			break;
+		dm_recv(scan);
+	}
+
+	free(scan->inflight);
+}
+
 int get_node(struct umad_resources *umad_res, uint16_t dlid, uint64_t *guid)
 {
 	struct srp_ib_user_mad		out_mad, in_mad;
@@ -1259,11 +1663,13 @@ static int do_dm_port_list(struct resources *res)
 	struct ib_user_mad	       *in_mad;
 	struct umad_sa_packet	       *out_sa_mad, *in_sa_mad;
 	struct srp_sa_port_info_rec    *port_info;
+	struct dm_scan			scan;
 	ssize_t len;
 	int size;
 	int i, j,num_pkeys;
 	uint16_t pkeys[SRP_MAX_SHARED_PKEYS];
 	uint64_t guid;
+	int ret = 0;
 
 	in_mad_buf = malloc(sizeof(struct ib_user_mad) +
 			    node_table_response_size);
@@ -1301,6 +1707,11 @@ static int do_dm_port_list(struct resources *res)
 		return 0;
 	}
 
+	if (init_dm_scan(&scan, res)) {
+		free(in_mad_buf);
+		return -ENOMEM;
+	}
+
 	for (i = 0; (i + 1) * size <= len - MAD_RMPP_HDR_SIZE; ++i) {
 		port_info = (void *) in_sa_mad->data + i * size;
 		if (get_node(umad_res, be16toh(port_info->endport_lid), &guid))
@@ -1311,22 +1722,26 @@ static int do_dm_port_list(struct resources *res)
 		if (num_pkeys < 0) {
 			pr_err("failed to get shared P_Keys with LID %#x\n",
 			       be16toh(port_info->endport_lid));
-			free(in_mad_buf);
-			return num_pkeys;
+			ret = num_pkeys;
+			break;
 		}
 
 		for (j = 0; j < num_pkeys; ++j)
-			do_port(res, pkeys[j], be16toh(port_info->endport_lid),
-				be64toh(port_info->subnet_prefix), guid);
+			add_dm_port(&scan, pkeys[j],
+				    be16toh(port_info->endport_lid),
+				    be64toh(port_info->subnet_prefix), guid);
 	}
 
+	/* The ports queried so far are still reported */
+	run_dm_scan(&scan);
 	free(in_mad_buf);
-	return 0;
+	return ret;
 }
 
-void handle_port(struct resources *res, uint16_t pkey, uint16_t lid, uint64_t h_guid)
+static void add_port(struct dm_scan *scan, uint16_t pkey, uint16_t lid,
+		     uint64_t h_guid)
 {
-	struct umad_resources *umad_res = res->umad_res;
+	struct umad_resources *umad_res = scan->res->umad_res;
 	uint64_t subnet_prefix;
 	int isdm;
 
@@ -1337,7 +1752,17 @@ void handle_port(struct resources *res, uint16_t pkey, uint16_t lid, uint64_t h_
 	if (!isdm)
 		return;
 
-	do_port(res, pkey, lid, subnet_prefix, h_guid);
+	add_dm_port(scan, pkey, lid, subnet_prefix, h_guid);
+}
+
+void handle_port(struct resources *res, uint16_t pkey, uint16_t lid, uint64_t h_guid)
+{
+	struct dm_scan scan;
+
+	if (init_dm_scan(&scan, res))
+		return;
+	add_port(&scan, pkey, lid, h_guid);
+	run_dm_scan(&scan);
 }
 
 
@@ -1349,10 +1774,12 @@ static int do_full_port_list(struct resources *res)
 	struct ib_user_mad	       *in_mad;
 	struct umad_sa_packet	       *out_sa_mad, *in_sa_mad;
 	struct srp_sa_node_rec	       *node;
+	struct dm_scan			scan;
 	ssize_t len;
 	int size;
 	int i, j, num_pkeys;
 	uint16_t pkeys[SRP_MAX_SHARED_PKEYS];
+	int ret = 0;
 
 	in_mad_buf = malloc(sizeof(struct ib_user_mad) +
 			    node_table_response_size);
@@ -1381,6 +1808,11 @@ static int do_full_port_list(struct resources *res)
 
 	size = be16toh(in_sa_mad->attr_offset) * 8;
 
+	if (init_dm_scan(&scan, res)) {
+		free(in_mad_buf);
+		return -ENOMEM;
+	}
+
 	for (i = 0; (i + 1) * size <= len - MAD_RMPP_HDR_SIZE; ++i) {
 		node = (void *) in_sa_mad->data + i * size;
 
@@ -1389,17 +1821,19 @@ static int do_full_port_list(struct resources *res)
 		if (num_pkeys < 0) {
 			pr_err("failed to get shared P_Keys with LID %#x\n",
 			       be16toh(node->lid));
-			free(in_mad_buf);
-			return num_pkeys;
+			ret = num_pkeys;
+			break;
 		}
 
 		for (j = 0; j < num_pkeys; ++j)
-			(void) handle_port(res, pkeys[j], be16toh(node->lid),
-					   be64toh(node->port_guid));
+			add_port(&scan, pkeys[j], be16toh(node->lid),
+				 be64toh(node->port_guid));
 	}
 
+	/* The ports queried so far are still reported */
+	run_dm_scan(&scan);
 	free(in_mad_buf);
-	return 0;
+	return ret;
 }
 
 struct config_t *config;
@@ -1413,6 +1847,7 @@ static void print_config(struct config_t *conf)
 	printf(" IB port                    		: %u\n", conf->port_num);
 	printf(" Mad Retries                		: %d\n", conf->mad_retries);
 	printf(" Number of outstanding WR   		: %u\n", conf->num_of_oust);
+	printf(" Number of outstanding DM MADs		: %d\n", conf->mad_window);
 	printf(" Mad timeout (msec)	     		: %u\n", conf->timeout);
 	printf(" Prints add target command  		: %d\n", conf->cmd);
  	printf(" Executes add target command		: %d\n", conf->execute);
@@ -1694,7 +2129,7 @@ static const struct option long_opts[] = {
 	{ "systemd",        0, NULL, 'S' },
 	{}
 };
-static const char short_opts[] = "caveod:i:j:p:t:r:R:T:l:Vhnf:";
+static const char short_opts[] = "caveod:i:j:p:t:r:w:R:T:l:Vhnf:";
 
 /* Check if the --systemd options was passed in very early so we can setup
  * logging properly.
@@ -1722,6 +2157,7 @@ static int get_config(struct config_t *conf, int argc, char *argv[])
 
 	conf->port_num			= 1;
 	conf->num_of_oust		= 10;
+	conf->mad_window		= 32;
 	conf->dev_name	 		= NULL;
 	conf->cmd	 		= 0;
 	conf->once	 		= 0;
@@ -1813,6 +2249,13 @@ static int get_config(struct config_t *conf, int argc, char *argv[])
 				return -1;
 			}
 			break;
+		case 'w':
+			conf->mad_window = atoi(optarg);
+			if (conf->mad_window <= 0) {
+				pr_err("Bad number of outstanding MADs - %s\n", optarg);
+				return -1;
+			}
+			break;
 		case 'R':
 			conf->recalc_time = atoi(optarg);
 			if (conf->recalc_time == 0) {
@@ -1977,7 +2420,8 @@ static void *run_thread_retry_to_connect(void *res_in)
 			if (sleep_time > 0)
 				srp_sleep(sleep_time, 0);
 
-			add_non_exist_target(target);
+			if (!refresh_target_index())
+				add_non_exist_target(target);
 			free(target);
 			pthread_mutex_lock(&res->sync_res->retry_mutex);
 		}
@@ -2147,6 +2591,7 @@ static int ibsrpdm(int argc, char *argv[])
 
 	config = calloc(1, sizeof(*config));
 	config->num_of_oust = 10;
+	config->mad_window = 32;
 	config->timeout = 5000;
 	config->mad_retries = 3;
 	config->all = 1;
@@ -197,6 +197,7 @@ struct config_t {
 	char	       *add_target_file;
 	int		mad_retries;
 	int		num_of_oust;
+	int		mad_window;
 	int		cmd;
 	int		once;
 	int		execute;